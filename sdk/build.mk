@@ -8,6 +8,7 @@ CC = $(CROSS_PREFIX)gcc
 CPP = $(CROSS_PREFIX)cpp
 AR = $(CROSS_PREFIX)gcc-ar
 OBJCOPY = $(CROSS_PREFIX)objcopy
+NM = $(CROSS_PREFIX)nm
 
 # Architecture and ABI
 AOPS = -march=rv64gc -mabi=lp64d -mcmodel=medany
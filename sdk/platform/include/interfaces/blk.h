@@ -0,0 +1,106 @@
+/*
+ * SPDX-FileType: SOURCE
+ *
+ * SPDX-FileCopyrightText: 2026 Nick Kossifidis <mick@ics.forth.gr>
+ * SPDX-FileCopyrightText: 2026 ICS/FORTH
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * Asynchronous block I/O on the platform's block device (see virtio_blk.c),
+ * e.g. for streaming input data from a disk image instead of linking it
+ * into the binary. Requests are owned by the caller (they also hold the
+ * driver's per-request state, so there are no allocations), data goes
+ * directly from / to the request's buffer, and many of them can be in
+ * flight at once:
+ *
+ *	struct blk_req req = { .op = BLK_OP_READ, .sector = 0,
+ *			       .buf = buf, .len = len, .done = cb };
+ *	blk_submit(&req);
+ *	...
+ *	blk_poll();	(calls cb for each completed request)
+ *
+ * With blk_enable_irq() completions are handled from the interrupt handler
+ * instead, so callbacks run in interrupt context (on hart 0) and may
+ * submit follow-up requests, e.g. to keep double buffering going while
+ * the other harts process the data:
+ *
+ *	cb(req): mark req->buf as full, wait for / pick the next free
+ *		 buffer, and submit a read for the next chunk into it
+ *
+ * blk_set_mode(DEVQ_MODE_ADAPTIVE) uses interrupts while the device is
+ * idle and switches to polling under load (see devq.h), for consumers
+ * that keep calling blk_poll() / blk_wait() anyway, blk_get_stats()
+ * shows how often it switched.
+ *
+ * blk_read() / blk_write() are blocking wrappers for simple cases.
+ */
+
+#ifndef _BLK_H
+#define _BLK_H
+
+#include <stddef.h>			/* For size_t */
+#include <stdint.h>			/* For typed integers */
+#include <stdbool.h>			/* For bool */
+#include <errno.h>			/* For EBUSY */
+#include <platform/utils/devq.h>	/* For enum devq_mode / struct devq_stats */
+
+#define BLK_SECTOR_SIZE	512
+
+enum blk_op {
+	BLK_OP_READ = 0,
+	BLK_OP_WRITE = 1,
+	BLK_OP_FLUSH = 4,
+};
+
+struct blk_info {
+	uint64_t num_sectors;	/* Capacity in BLK_SECTOR_SIZE sectors */
+	uint32_t block_size;	/* Optimal I/O granularity */
+	uint32_t max_xfer;	/* Maximum length of a single request */
+	uint16_t max_inflight;	/* Requests that can be queued at once */
+	bool read_only;
+};
+
+struct blk_req;
+typedef void (*blk_done_t)(struct blk_req *req);
+
+struct blk_req {
+	/* Set by the caller */
+	enum blk_op op;
+	uint64_t sector;
+	void *buf;
+	uint32_t len;		/* Multiple of BLK_SECTOR_SIZE */
+	blk_done_t done;	/* May be NULL */
+	void *priv;		/* For the caller's use */
+	/* -EBUSY while in flight, then 0 or -EIO / -ENOTSUP */
+	volatile int status;
+	/* Driver private */
+	struct {
+		uint32_t type;
+		uint32_t reserved;
+		uint64_t sector;
+	} hdr;
+	uint8_t dev_status;
+};
+
+int blk_init(void);
+int blk_get_info(struct blk_info *info);
+int blk_submit(struct blk_req *req);
+int blk_poll(void);
+int blk_wait(struct blk_req *req);
+int blk_read(uint64_t sector, void *buf, uint32_t len);
+int blk_write(uint64_t sector, const void *buf, uint32_t len);
+
+int blk_set_mode(enum devq_mode mode);
+int blk_get_stats(struct devq_stats *stats);
+void blk_enable_irq(void);
+void blk_disable_irq(void);
+
+static inline bool
+blk_req_done(const struct blk_req *req)
+{
+	return req->status != -EBUSY;
+}
+
+#endif /* _BLK_H */
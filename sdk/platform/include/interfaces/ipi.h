@@ -21,11 +21,19 @@ enum ipi_type {
 	IPI_WAKEUP_WITH_ADDR	= BIT(1),
 	IPI_ENABLE_EIID		= BIT(2),
 	IPI_DISABLE_EIID	= BIT(3),
+	IPI_CALL		= BIT(4),
 	IPI_MAX			= BIT(15)
 };
 
+/* One bit per hart_idx */
+typedef uint64_t hartmask_t;
+#define HARTMASK(_hart_idx)	(1ULL << (_hart_idx))
+
 void ipi_send(struct hart_state* target_hstate, enum ipi_type type);
+void ipi_send_mask(hartmask_t mask, enum ipi_type type);
 void ipi_self(enum ipi_type type);
 void ipi_clear(void);
+/* Called by the IPI handler for the ipi_mask it got (see ipi_common.c) */
+void ipi_forward(uint16_t ipi_mask);
 
 #endif /* _IPI_H */
\ No newline at end of file
@@ -10,7 +10,10 @@
 #ifndef _IRQ_H
 #define _IRQ_H
 
-#include <stdint.h>	/* For typed integers */
+#include <stdint.h>			/* For typed integers */
+#include <stdbool.h>			/* For bool */
+#include <stdatomic.h>			/* For atomic_uint */
+#include <platform/utils/percpu.h>	/* For __percpu / this_cpu_ptr() */
 
 /* Interrupt handler function type, implemented by
  * the driver, one for each interrupt mapping. */
@@ -113,9 +116,17 @@ struct irq_target_mapping {
 
 
 /* Common helpers in irq_common.c */
+void irq_build_srcmap(void);
 const struct irq_source_mapping * irq_get_srcmap(uint16_t source_id);
+uint16_t irq_get_target_hart(const struct irq_source_mapping *irq_sm);
 int irq_get_target_idx_for_hart(uint16_t target_hart);
 
+/* Runtime affinity, irq_set_affinity() overrides the target_hart of
+ * a source's mapping, irq_rebalance() moves sources around based on
+ * the IRQ_STATS histograms (-ENOTSUP without IRQ_STATS). */
+int irq_set_affinity(uint16_t source_id, uint16_t hart_idx);
+int irq_rebalance(void);
+
 
 /* Initialize interrupt subsystem */
 int irq_init(void);
@@ -124,9 +135,87 @@ int irq_init(void);
 void irq_source_enable(uint16_t source_id);
 void irq_source_disable(uint16_t source_id);
 
+/* Move an enabled source from one hart (by index) to another,
+ * used by irq_set_affinity(), -ENOTSUP if the controller can't. */
+int irq_source_retarget(uint16_t source_id, uint16_t from_hart, uint16_t to_hart);
+
 /* Main interrupt handler - called from trap handler
  * Note: eiid is only used when IMSIC is present to
  * avoid re-reading mtopei. */
 void irq_dispatch(uint16_t eiid);
 
+/*
+ * Nested interrupts (build with IRQ_NESTED): irq_dispatch() raises the
+ * hart's threshold on the interrupt controller to the priority of the
+ * source it claimed (PLIC threshold, APLIC ithreshold, IMSIC eithreshold
+ * where priority is the eiid itself), and calls its handler with MIE set,
+ * so that only the timer, IPIs and external sources of higher priority
+ * can preempt it. irq_nest_enter/exit() save / restore the trap state
+ * (mepc, mstatus.MPP/MPIE/MDT) the preempting trap would overwrite,
+ * they are also used for running deferred work (see below) so they are
+ * there without IRQ_NESTED too.
+ *
+ * A trap handler that wants to redirect the hart on mret (e.g. wakeup
+ * with addr) should use irq_set_trap_return() instead of writing mepc,
+ * if it preempted a handler it'll take effect when the outermost handler
+ * returns, instead of abandoning the preempted handlers mid-way.
+ */
+struct irq_nest_state {
+	uintptr_t mepc;
+	uint64_t mstatus;
+	uint64_t stats_entry;	/* For IRQ_STATS, see irq_stats.h */
+};
+
+void irq_nest_enter(struct irq_nest_state *ns);
+void irq_nest_exit(struct irq_nest_state *ns);
+void irq_set_trap_return(uintptr_t addr);
+
+/* Non-zero while a handler (or deferred work run on trap exit, see
+ * below) runs in its window, the interrupted code's state the trap
+ * handlers don't save (e.g. the vector registers) is still live, so it
+ * must be left alone even though MIE is set. */
+extern uint32_t irq_nest_depth __percpu;
+
+static inline bool
+irq_nested(void)
+{
+	return *this_cpu_ptr(&irq_nest_depth) != 0;
+}
+
+/*
+ * Deferred work (bottom halves): a handler that has more to do than
+ * acknowledging its device can queue a struct irq_work and return, the
+ * work runs on the same hart with interrupts enabled, right before the
+ * outermost trap handler returns (through irq_nest_enter/exit(), so it
+ * doesn't matter what the trap interrupted, and irq_nested() is true so
+ * it won't touch the vector registers either). Work queued outside trap
+ * context runs on the next trap, or from the idle loop (hart_idle()),
+ * or when the caller runs irq_work_run() itself.
+ *
+ * Queueing a work that's already pending does nothing, so a handler can
+ * queue it on every interrupt and the work will catch up with all of them
+ * when it runs. The pending flag is cleared right before func is called,
+ * so func may queue it again. Works run in the order they were queued.
+ *
+ * Usage in driver code:
+ *	static struct irq_work uart_rx_work = IRQ_WORK_INIT(uart_rx_process, &uart0);
+ *	...
+ *	irq_work_queue(&uart_rx_work);
+ */
+struct irq_work;
+typedef void (*irq_work_fn_t)(struct irq_work *work);
+
+struct irq_work {
+	irq_work_fn_t func;
+	void *arg;
+	struct irq_work *next;
+	atomic_uint pending;
+};
+
+#define IRQ_WORK_INIT(_func, _arg)	{ .func = (_func), .arg = (_arg) }
+
+bool irq_work_queue(struct irq_work *work);
+void irq_work_run(void);
+void irq_work_trap_exit(void);
+
 #endif /* _IRQ_H */
\ No newline at end of file
@@ -0,0 +1,70 @@
+/*
+ * SPDX-FileType: SOURCE
+ *
+ * SPDX-FileCopyrightText: 2026 Nick Kossifidis <mick@ics.forth.gr>
+ * SPDX-FileCopyrightText: 2026 ICS/FORTH
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * Raw ethernet frames in / out of the platform's network device (see
+ * virtio_net.c), without copies: frames live in buffers from a pool the
+ * driver sets up in net_init(), and are handed to the device / the
+ * application as they are.
+ *
+ * Transmit:
+ *	uint8_t *frame = net_tx_alloc();
+ *	(build up to NET_FRAME_MAX bytes in frame)
+ *	net_tx_submit(frame, len);	(the buffer now belongs to the driver)
+ *	...
+ *	net_tx_flush();			(one notification for the whole batch)
+ *
+ * Receive:
+ *	while (net_rx_poll(&frame, &len) == 0) {
+ *		(process frame)
+ *		net_rx_release(frame);	(back to the device)
+ *	}
+ *
+ * With interrupts enabled (net_enable_irq()) the handler from
+ * net_set_rx_handler() gets called when frames arrive, after which
+ * receive interrupts stay off until net_rx_poll() runs out of frames,
+ * so under load frames get processed in batches without an interrupt
+ * for each one. The handler runs in interrupt context, it may use
+ * net_rx_poll() / net_rx_release() but not net_tx_*().
+ */
+
+#ifndef _NET_H
+#define _NET_H
+
+#include <stddef.h>	/* For size_t */
+#include <stdint.h>	/* For typed integers */
+
+#define NET_MAC_LEN	6
+#define NET_MTU		1500
+/* Ethernet header + MTU, no FCS */
+#define NET_FRAME_MAX	(14 + NET_MTU)
+
+struct net_stats {
+	uint64_t rx_frames;
+	uint64_t tx_frames;
+	uint64_t tx_kicks;	/* Notifications actually sent to the device */
+	uint64_t rx_irqs;
+};
+
+typedef void (*net_rx_handler_t)(void);
+
+int net_init(void);
+int net_get_mac(uint8_t mac[NET_MAC_LEN]);
+void *net_tx_alloc(void);
+int net_tx_submit(void *frame, size_t len);
+void net_tx_flush(void);
+int net_rx_poll(void **frame, size_t *len);
+void net_rx_release(void *frame);
+void net_get_stats(struct net_stats *stats);
+
+void net_set_rx_handler(net_rx_handler_t handler);
+void net_enable_irq(void);
+void net_disable_irq(void);
+
+#endif /* _NET_H */
@@ -12,6 +12,7 @@
 
 #include <stdint.h>	/* For typed integers */
 #include <time.h>	/* For struct timespec */
+#include <stddef.h>	/* For NULL */
 
 /* Common API for both platform and cycle count - based timers.
  * Used by yalibc/time.c
@@ -35,4 +36,32 @@ uint64_t timer_get_num_ticks(timerid_t timer);
 uint64_t timer_nsecs_to_cycles(timerid_t timer, uint64_t nsecs);
 void timer_nanosleep(timerid_t timer, uint64_t nsecs);
 
+/* Software timers on top of the platform timer (see timer.c), each
+ * hart has its own set, handlers run in interrupt context on the hart
+ * that added them, and may add / cancel events. Events are owned by
+ * the caller, zero-initialize them before the first timer_add(). */
+struct timer_event;
+typedef void (*timer_handler_t)(struct timer_event *ev);
+
+struct timer_event {
+	/* Set by the caller */
+	timer_handler_t handler;
+	void *arg;
+	/* Timer wheel private */
+	struct timer_event *next;
+	struct timer_event **pprev;	/* NULL when not pending */
+	uint64_t expires;		/* In platform timer ticks */
+	uint64_t period;
+	uint16_t hart_idx;
+};
+
+int timer_add(struct timer_event *ev, uint64_t nsecs, uint64_t period_nsecs);
+int timer_cancel(struct timer_event *ev);
+
+static inline int
+timer_pending(const struct timer_event *ev)
+{
+	return ev->pprev != NULL;
+}
+
 #endif  /* _TIMER_H */
\ No newline at end of file
@@ -10,11 +10,17 @@
 #ifndef _UART_H
 #define _UART_H
 
+#include <stddef.h>	/* For size_t */
 #include <stdint.h>	/* For typed integers */
 
 void uart_init(void);
 int uart_getc(void);
 void uart_putc(unsigned char c);
+void uart_write_buf(const void *buff, size_t len);
+/* Non-blocking, buffered (see uart.c) */
+int uart_read(void *buff, size_t len);
+int uart_write(const void *buff, size_t len);
+void uart_flush(void);
 void uart_enable_irq(void);
 void uart_disable_irq(void);
 
@@ -0,0 +1,131 @@
+/*
+ * SPDX-FileType: SOURCE
+ *
+ * SPDX-FileCopyrightText: 2026 Nick Kossifidis <mick@ics.forth.gr>
+ * SPDX-FileCopyrightText: 2026 ICS/FORTH
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * Common code for virtio-mmio drivers (virtio 1.x, modern interface only,
+ * see run.sh's virtio-mmio.force-legacy=false), with split virtqueues. For
+ * more infos check out the spec:
+ * https://docs.oasis-open.org/virtio/virtio/v1.2/virtio-v1.2.html
+ *
+ * Drivers provide the memory for their queues (VIRTQ_MEM_SIZE bytes, e.g.
+ * from page_alloc(), or a static buffer for small queues), and a cookie
+ * for each buffer they add, that they get back when the device is done
+ * with it. There is no locking here, drivers need to serialize access
+ * to each queue (including from their interrupt handlers).
+ */
+
+#ifndef _VIRTIO_H
+#define _VIRTIO_H
+
+#include <stddef.h>	/* For size_t */
+#include <stdint.h>	/* For typed integers */
+#include <stdbool.h>	/* For bool */
+
+/* Device IDs */
+#define VIRTIO_ID_NET		1
+#define VIRTIO_ID_BLOCK		2
+#define VIRTIO_ID_CONSOLE	3
+
+/* Feature bits common to all devices */
+#define VIRTIO_F_RING_EVENT_IDX	29
+#define VIRTIO_F_VERSION_1	32
+
+/* Split virtqueue layout */
+#define VIRTQ_DESC_F_NEXT		1
+#define VIRTQ_DESC_F_WRITE		2
+#define VIRTQ_AVAIL_F_NO_INTERRUPT	1
+#define VIRTQ_USED_F_NO_NOTIFY		1
+
+struct virtq_desc {
+	uint64_t addr;
+	uint32_t len;
+	uint16_t flags;
+	uint16_t next;
+};
+
+/* Followed by used_event (with VIRTIO_F_RING_EVENT_IDX) */
+struct virtq_avail {
+	uint16_t flags;
+	uint16_t idx;
+	uint16_t ring[];
+};
+
+struct virtq_used_elem {
+	uint32_t id;
+	uint32_t len;
+};
+
+/* Followed by avail_event (with VIRTIO_F_RING_EVENT_IDX) */
+struct virtq_used {
+	uint16_t flags;
+	uint16_t idx;
+	struct virtq_used_elem ring[];
+};
+
+#define __VIRTQ_ALIGN8(x)	(((x) + 7) & ~((size_t) 7))
+/* Memory needed for a queue of num entries (descriptors, avail / used rings
+ * and cookies), num needs to be a power of two. */
+#define VIRTQ_MEM_SIZE(num)	((16 * (size_t)(num)) + \
+				 __VIRTQ_ALIGN8(6 + 2 * (size_t)(num)) + \
+				 __VIRTQ_ALIGN8(6 + 8 * (size_t)(num)) + \
+				 (sizeof(void*) * (size_t)(num)))
+
+struct virtq {
+	struct virtq_desc *desc;
+	struct virtq_avail *avail;
+	struct virtq_used *used;
+	void **cookies;		/* One for each chain, indexed by its head */
+	uint16_t num;
+	uint16_t idx;		/* Queue index on the device */
+	uint16_t free_head;	/* Free descriptors are chained through next */
+	uint16_t num_free;
+	uint16_t avail_idx;	/* Our copy of avail->idx */
+	uint16_t kicked_idx;	/* avail_idx when we last notified the device */
+	uint16_t last_used;	/* Next used ring entry to process */
+	bool event_idx;
+	bool irq_off;
+};
+
+struct virtio_dev {
+	uintptr_t base;
+	uint64_t features;	/* Negotiated features */
+};
+
+/* A buffer to add to a queue, addresses are physical */
+struct virtq_buf {
+	void *addr;
+	uint32_t len;
+};
+
+/* Device setup */
+int virtio_dev_init(struct virtio_dev *dev, uintptr_t base, uint32_t device_id, uint64_t features);
+void virtio_dev_ready(struct virtio_dev *dev);
+void virtio_dev_fail(struct virtio_dev *dev);
+uint32_t virtio_dev_ack_irq(struct virtio_dev *dev);
+uint8_t virtio_config_read8(struct virtio_dev *dev, uint32_t offset);
+uint16_t virtio_config_read16(struct virtio_dev *dev, uint32_t offset);
+uint32_t virtio_config_read32(struct virtio_dev *dev, uint32_t offset);
+
+static inline bool
+virtio_has_feature(const struct virtio_dev *dev, unsigned int bit)
+{
+	return (dev->features >> bit) & 1;
+}
+
+/* Queue operations */
+int virtq_init(struct virtio_dev *dev, struct virtq *vq, uint16_t idx, uint16_t num, void *mem);
+int virtq_add(struct virtq *vq, const struct virtq_buf *bufs, unsigned int num_out,
+	      unsigned int num_in, void *cookie);
+bool virtq_kick(struct virtio_dev *dev, struct virtq *vq);
+void *virtq_get(struct virtq *vq, uint32_t *len);
+bool virtq_has_used(const struct virtq *vq);
+void virtq_disable_irq(struct virtq *vq);
+bool virtq_enable_irq(struct virtq *vq);
+
+#endif /* _VIRTIO_H */
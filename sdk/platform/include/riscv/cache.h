@@ -0,0 +1,43 @@
+/*
+ * SPDX-FileType: SOURCE
+ *
+ * SPDX-FileCopyrightText: 2026 Nick Kossifidis <mick@ics.forth.gr>
+ * SPDX-FileCopyrightText: 2026 ICS/FORTH
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef _CACHE_H
+#define _CACHE_H
+
+#include <stddef.h>	/* For size_t */
+
+/*
+ * Cache maintenance for buffers shared with non-coherent DMA masters,
+ * through the Zicbom cbo.clean / cbo.inval / cbo.flush instructions.
+ *
+ * - cache_clean_range: Write back any dirty blocks of the range, so that
+ *   a device reading it sees what we wrote (before a device reads).
+ * - cache_inval_range: Drop the range from the cache, so that we see what
+ *   a device wrote to memory (after a device writes). Any dirty data on
+ *   partial blocks at the edges of the range may also be lost, so DMA
+ *   buffers should be aligned to / padded to cache_get_block_size().
+ * - cache_flush_range: Clean + invalidate.
+ *
+ * All of them cover every cache block that overlaps [addr, addr + len),
+ * and are ordered with the hart's loads/stores before and after them,
+ * including MMIO (so it's safe to ring a doorbell right after). They
+ * return 0 on success, -EINVAL on a NULL addr, or -ENOTSUP if Zicbom is
+ * not available, in which case the caller needs to use bounce buffers
+ * on non-cacheable memory instead.
+ *
+ * The block size comes from hart_probe_isa_caps() during boot (or from
+ * hart_probe_priv_caps()), and can be overridden by the platform through
+ * PLAT_CBOM_BLOCK_SIZE, it's 0 if Zicbom is not available.
+ */
+int cache_clean_range(const void *addr, size_t len);
+int cache_inval_range(void *addr, size_t len);
+int cache_flush_range(void *addr, size_t len);
+size_t cache_get_block_size(void);
+
+#endif /* _CACHE_H */
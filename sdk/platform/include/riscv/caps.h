@@ -63,6 +63,9 @@
 #define CAP_ZICBOM	BIT_ULL(2)
 #define CAP_ZICBOZ	BIT_ULL(3)
 #define CAP_ZKR		BIT_ULL(4)
+#define CAP_ZAWRS	BIT_ULL(5)
+#define CAP_ZBKC	BIT_ULL(6)	/* clmul / clmulh (also part of Zbc) */
+#define CAP_ZBC		BIT_ULL(7)
 
 /*
  * Capabilities / extensions that don't fit elsewhere
@@ -84,6 +87,7 @@
 #define CAP_UBE		BIT(11)
 #define CAP_ZICNTR	BIT(12)
 #define CAP_ZIHPM	BIT(13)
+#define CAP_ZICNTR_TIME	BIT(14)	/* time CSR readable on M-mode (not emulated) */
 
 /* Placeholder for the rest to keep track...
  *
@@ -99,11 +103,10 @@
  * Zi*nx -> float/double/half-double in x* regs
  * Zk* -> Scalar crypto (already tracking Zkr)
  * - Zkt -> Constant-time guarantees for crypto
- * Zbc, Zbk* -> Bitmanip for crypto
+ * Zbk* -> Bitmanip for crypto (already tracking Zbkc)
  * Zve* -> Vector for embedded
  * - Zicbop -> cache prefetch hints
  * Zvbb/c -> Bitmanip for vectors (extends V)
- * Zawrs -> Wait on reservation set (extends A)
  * - Ztso -> Total Store Ordering memory model
  * RV3264E -> Alternative base integer sets (mutex to RV32/64I)
  * Zca/b/d/e/f/mp/mt -> Code size reduction
@@ -131,6 +134,8 @@ struct rvcaps {
 	uint8_t num_asid_bits;
 	uint8_t vlenb_shift;	/* vlenb = 1 << vlenb_shift, range [4-13] */
 	uint64_t z_caps;
+	uint8_t cboz_block_shift;	/* cbo.zero block size = 1 << cboz_block_shift */
+	uint8_t cbom_block_shift;	/* cbo.clean/inval/flush block size */
 };
 
 #endif
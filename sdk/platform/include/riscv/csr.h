@@ -656,11 +656,35 @@ enum hart_counters {
 
 /* Machine Control Transfer Records (Smctr v1.0, v1.13) */
 #define CSR_MCTRCTL		0x34E	/* Machine CTR control */
+#define CSR_MCTRCTL_U		BIT(0)		/* Record in U-mode */
+#define CSR_MCTRCTL_S		BIT(1)		/* Record in S-mode */
+#define CSR_MCTRCTL_M		BIT(2)		/* Record in M-mode */
+#define CSR_MCTRCTL_RASEMU	BIT(7)		/* Return address stack emulation */
+#define CSR_MCTRCTL_STE 	BIT(8)		/* Record external traps to S-mode */
+#define CSR_MCTRCTL_MTE 	BIT(9)		/* Record external traps to M-mode */
+#define CSR_MCTRCTL_BPFRZ	BIT(11)		/* Freeze on breakpoint exceptions */
+#define CSR_MCTRCTL_LCOFIFRZ	BIT(12)		/* Freeze on counter overflow interrupts */
+#define CSR_MCTRCTL_EXCINH	BIT_ULL(33)	/* Don't record exceptions */
+#define CSR_MCTRCTL_INTRINH	BIT_ULL(34)	/* Don't record interrupts */
+#define CSR_MCTRCTL_TRETINH	BIT_ULL(35)	/* Don't record trap returns */
+#define CSR_MCTRCTL_NTBREN	BIT_ULL(36)	/* Record not taken branches */
+#define CSR_MCTRCTL_TKBRINH	BIT_ULL(37)	/* Don't record taken branches */
+#define CSR_MCTRCTL_INDCALLINH	BIT_ULL(40)	/* Don't record indirect calls */
+#define CSR_MCTRCTL_DIRCALLINH	BIT_ULL(41)	/* Don't record direct calls */
+#define CSR_MCTRCTL_INDJMPINH	BIT_ULL(42)	/* Don't record indirect jumps */
+#define CSR_MCTRCTL_DIRJMPINH	BIT_ULL(43)	/* Don't record direct jumps */
+#define CSR_MCTRCTL_CORSWAPINH	BIT_ULL(44)	/* Don't record co-routine swaps */
+#define CSR_MCTRCTL_RETINH	BIT_ULL(45)	/* Don't record returns */
+#define CSR_MCTRCTL_INDLJMPINH	BIT_ULL(46)	/* Don't record other indirect jumps */
+#define CSR_MCTRCTL_DIRLJMPINH	BIT_ULL(47)	/* Don't record other direct jumps */
 
 /* Supervisor Control Transfer Records (Ssctr v1.0, v1.13) */
 #define CSR_SCTRCTL		0x14E	/* Supervisor CTR control */
 #define CSR_SCTRSTATUS		0x14F	/* Supervisor CTR status (WRPTR, FROZEN) */
 #define CSR_SCTRDEPTH		0x15F	/* Supervisor CTR depth (16/32/64/128/256) */
+#define CSR_SCTRSTATUS_WRPTR	FIELD(7,0)	/* Next physical entry to write */
+#define CSR_SCTRSTATUS_FROZEN	BIT(31)		/* Recording frozen */
+#define CSR_SCTRDEPTH_DEPTH	FIELD(2,0)	/* 16 << DEPTH entries (WARL) */
 
 /* Virtual Supervisor Control Transfer Records (Ssctr v1.0 + H, v1.13) */
 #define CSR_VSCTRCTL		0x24E	/* Virtual supervisor CTR control */
@@ -670,7 +694,16 @@ enum hart_counters {
  *   sireg   -> ctrsource (source PC with valid bit)
  *   sireg2  -> ctrtarget (target PC with optional mispred bit)
  *   sireg3  -> ctrdata (transfer type and cycle count metadata)
+ * logical entry 0 is the most recent one, miselect / mireg* work the same
+ * from M-mode. The sctrclr instruction (0x10400073) invalidates them all.
  */
+#define CTR_ISELECT_BASE	0x200
+#define CTR_SOURCE_V		BIT(0)		/* Entry valid */
+#define CTR_TARGET_MISP 	BIT(0)		/* Mispredicted (optional) */
+#define CTR_DATA_TYPE		FIELD(3,0)	/* Transfer type */
+#define CTR_DATA_CCV		BIT(15)		/* Cycle count valid */
+#define CTR_DATA_CCM		FIELD(27,16)	/* Cycle count mantissa */
+#define CTR_DATA_CCE		FIELD(31,28)	/* Cycle count exponent */
 
 /***************************\
 * Vector extension (V v1.0) *
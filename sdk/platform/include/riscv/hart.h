@@ -14,9 +14,10 @@
 #include <stdatomic.h>			/* For C11 atomic types / accessors */
 #include <platform/utils/bitfield.h>	/* For BIT() macro */
 #include <stdbool.h>			/* For bool in hart_test_flags() */
-#include <stddef.h>			/* For size_t in hart_va_map_range() */
+#include <stddef.h>			/* For size_t in hart_va_*() */
 #include <platform/riscv/csr.h>		/* For CSRs and csr ops */
 #include <platform/riscv/caps.h>	/* For struct rvcaps */
+#include <platform/riscv/hart_flags.h>	/* For the flags word layout */
 
 /*
  * Used for to pass arguments on IPIs
@@ -60,11 +61,11 @@ struct hart_state {
 	 * flags (see below). */
 	_Atomic(uint32_t) flags;
 
-	/* Reserved for future use */
-	uint32_t reserved;
-
-	/* See timer.c */
-	uint64_t last_cyclecount_tval;
+	/* Cycle counter to / from nsecs multipliers, calibrated
+	 * against mtime during hart_init (see timer.c), zero
+	 * until then. */
+	uint32_t cycle_mult_ns2c;
+	uint64_t cycle_mult_c2ns;
 
 	/* Used for program's per-hart internal state */
 	void* internal;
@@ -72,21 +73,26 @@ struct hart_state {
 	/* Used for wakeup with addr IPI */
 	uintptr_t next_addr;
 	struct next_params *next_params;
-} __attribute__((aligned(8)));
+} __attribute__((aligned(64)));
 
 enum state_flags {
-	HS_FLAG_READY		= BIT(0),
-	HS_FLAG_RUNNING		= BIT(1),
-	HS_FLAG_SLEEPING	= BIT(2),
-	HS_FLAG_CAPS_IS_PTR	= BIT(3)
+	HS_FLAG_READY		= BIT(HS_FLAG_READY_BIT),
+	HS_FLAG_RUNNING		= BIT(HS_FLAG_RUNNING_BIT),
+	HS_FLAG_SLEEPING	= BIT(HS_FLAG_SLEEPING_BIT),
+	HS_FLAG_CAPS_IS_PTR	= BIT(HS_FLAG_CAPS_IS_PTR_BIT),
+	HS_FLAG_POOL		= BIT(HS_FLAG_POOL_BIT),	/* Parked in the worker pool (hart_parallel.c) */
+	HS_FLAG_ONLINE		= BIT(HS_FLAG_ONLINE_BIT),	/* Checked in during boot (see init.c) */
+	HS_FLAG_TIMERS		= BIT(HS_FLAG_TIMERS_BIT),	/* Timer wheel has events (see timer.c) */
+	HS_FLAG_PROBING		= BIT(HS_FLAG_PROBING_BIT)	/* Skip illegal instructions (see hart_probe.c) */
 };
 
-/* Static assert to ensure size */
+/* Static assert to ensure size, it's on its own cache line at the top of
+ * each hart's stack slot (the slots are cache line aligned, see bmbase.ld.tmpl) */
 _Static_assert(sizeof(struct hart_state) == 64, "hart_state must be 64 bytes");
-
-/* Clear macros for bit manipulation */
-#define IPI_BITS   16
-#define FLAG_BITS  16
+/* hart_fast.S accesses flags directly (see hart_flags.h) */
+_Static_assert(offsetof(struct hart_state, flags) == HS_FLAGS_OFFSET,
+	       "hart_fast.S expects flags at HS_FLAGS_OFFSET");
+_Static_assert(IPI_BITS + FLAG_BITS == 32, "flags is a 32bit word");
 
 extern uint64_t __stack_start;
 extern uint64_t __stack_size_shift;
@@ -282,7 +288,10 @@ static inline bool hart_test_flags(struct hart_state *hs, uint16_t flags)
 
 /* Weak handlers for applications to override */
 void hart_on_mswtrig(struct hart_state *hs);
-void hart_on_mtimer(struct hart_state *hs);
+void hart_on_mtimer(struct hart_state *hs);	/* Unless the timer wheel has events */
+/* From timer.c */
+bool timer_wheel_run(struct hart_state *hs);
+void timer_init_hart(struct hart_state *hs);
 void hart_on_mecall(struct hart_state *hs);
 
 /* Extended init functions in hart.S called by hart_init */
@@ -291,11 +300,46 @@ void hart_init_vpu(struct hart_state *hs, uint64_t misa);
 void hart_init_counters(struct hart_state *hs);
 void hart_init_sdtrig(struct hart_state *hs);
 
-/* VA mapping functions in hart_va.c */
+/* VA mapping functions in hart_va.c, R/W/X/U/G match the PTE bits */
+enum va_map_flags {
+	VA_MAP_R		= BIT(1),
+	VA_MAP_W		= BIT(2),
+	VA_MAP_X		= BIT(3),
+	VA_MAP_U		= BIT(4),	/* User accessible */
+	VA_MAP_G		= BIT(5),	/* Global */
+	VA_MAP_RW		= VA_MAP_R | VA_MAP_W,
+	VA_MAP_RWX		= VA_MAP_R | VA_MAP_W | VA_MAP_X,
+	VA_MAP_NAPOT		= BIT(8),	/* 64KB Svnapot pages instead of 4KB */
+	VA_MAP_NO_SUPERPAGES	= BIT(9),	/* Only 4KB / 64KB leaves */
+	/* Memory type (Svpbmt), the default is the PMA of the region */
+	VA_MAP_NC		= BIT(10),	/* Non-cacheable, idempotent, weakly-ordered */
+	VA_MAP_IO		= BIT(11),	/* Non-cacheable, non-idempotent, strongly-ordered */
+};
+
+int hart_va_init(uint64_t mode);
+int hart_va_map(uintptr_t va, uintptr_t pa, size_t size, uint32_t flags);
+int hart_va_unmap(uintptr_t va, size_t size);
+int hart_va_translate(uintptr_t va, uintptr_t *pa, size_t *leaf_size);
+size_t hart_va_num_tables(void);
+int hart_va_activate(void);
+void hart_va_deactivate(void);
+void hart_va_destroy(void);
 int hart_va_map_range(uintptr_t phys_addr, size_t *size, uint64_t mode, bool napot);
+/* Extra address spaces, each with its own ASID, VA_MAP_G mappings
+ * are expected to be the same on all of them (as for satp.ASID) */
+struct va_space;
+struct va_space *hart_va_space_create(uint64_t mode);
+int hart_va_space_destroy(struct va_space *vs);
+int hart_va_space_map(struct va_space *vs, uintptr_t va, uintptr_t pa, size_t size,
+		      uint32_t flags);
+int hart_va_space_unmap(struct va_space *vs, uintptr_t va, size_t size);
+int hart_va_space_translate(struct va_space *vs, uintptr_t va, uintptr_t *pa, size_t *leaf_size);
+int hart_va_space_activate(struct va_space *vs);
+uint16_t hart_va_space_asid(const struct va_space *vs);
 
 /* Hart probing facility in hart_probe.c */
 void hart_probe_priv_caps(struct rvcaps *caps);
+void hart_probe_isa_caps(struct rvcaps *caps);
 
 /* Entry points on hart.c */
 void hart_init(void);
@@ -304,6 +348,41 @@ void hart_wakeup_with_addr(uint16_t hart_idx, uintptr_t jump_addr, uint64_t arg0
 			   uint64_t arg1, uint64_t mtimer_cycles);
 void hart_wakeup_all_with_addr(uintptr_t jump_addr, uint64_t arg0, uint64_t arg1,
 			  uint64_t mtimer_cycles);
+/* Called from the IPI handler of the target harts, with interrupts off */
+typedef void (*hart_call_fn_t)(uint64_t arg0, uint64_t arg1);
+uint64_t hart_call_mask(uint64_t hart_mask, hart_call_fn_t fn, uint64_t arg0, uint64_t arg1);
+void hart_idle(void);
 void hart_hang(void);
 
+/* Worker pool and parallel ops in hart_parallel.c */
+struct work_item;
+typedef void (*work_fn_t)(struct work_item *work);
+
+enum work_state {
+	WORK_IDLE = 0,
+	WORK_QUEUED,
+	WORK_RUNNING,
+	WORK_DONE
+};
+
+struct work_item {
+	/* Set by the caller */
+	work_fn_t fn;
+	void *arg;
+	/* Work queue private */
+	struct work_item *next;
+	_Atomic(int) state;
+};
+
+typedef void (*parallel_for_fn_t)(void *ctx, size_t begin, size_t end);
+
+int workqueue_submit(struct work_item *work);
+int workqueue_cancel(struct work_item *work);
+void workqueue_wait(struct work_item *work);
+int task_spawn(struct work_item *work);
+void task_wait(struct work_item *work);
+int parallel_for(size_t begin, size_t end, size_t grain, parallel_for_fn_t fn, void *ctx);
+void *memcpy_parallel(void *restrict dst, const void *restrict src, size_t len);
+void *memset_parallel(void *dst, int c, size_t len);
+
 #endif /* _HART_H */
\ No newline at end of file
@@ -0,0 +1,37 @@
+/*
+ * SPDX-FileType: SOURCE
+ *
+ * SPDX-FileCopyrightText: 2026 Nick Kossifidis <mick@ics.forth.gr>
+ * SPDX-FileCopyrightText: 2026 ICS/FORTH
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * Layout of hart_state's flags word, shared between hart.h and the
+ * assembly fast paths (hart_fast.S), so that they can't get out of
+ * sync. The low IPI bits hold the ipi_mask (see ipi.h), the state
+ * flags (enum state_flags) are above them.
+ */
+
+#ifndef _HART_FLAGS_H
+#define _HART_FLAGS_H
+
+/* Offset of flags in struct hart_state */
+#define HS_FLAGS_OFFSET		24
+
+/* Width of the ipi_mask / state flags parts */
+#define IPI_BITS		16
+#define FLAG_BITS		16
+
+/* State flag bit numbers, within the state flags part */
+#define HS_FLAG_READY_BIT	0
+#define HS_FLAG_RUNNING_BIT	1
+#define HS_FLAG_SLEEPING_BIT	2
+#define HS_FLAG_CAPS_IS_PTR_BIT	3
+#define HS_FLAG_POOL_BIT	4
+#define HS_FLAG_ONLINE_BIT	5
+#define HS_FLAG_TIMERS_BIT	6
+#define HS_FLAG_PROBING_BIT	7
+
+#endif /* _HART_FLAGS_H */
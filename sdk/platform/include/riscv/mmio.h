@@ -77,4 +77,13 @@ write64(volatile void *addr, uint64_t val)
 	asm volatile("sd %0, 0(%1)" : : "r" (val), "r" (addr));
 }
 
+/* Without the barrier, for back to back stores to different
+ * registers that only need to be ordered against prior memory
+ * accesses once, with an explicit __io_bw() in front. */
+static inline void
+write32_relaxed(volatile void *addr, uint32_t val)
+{
+	asm volatile("sw %0, 0(%1)" : : "r" (val), "r" (addr));
+}
+
 #endif	/* _MMIO_H */
\ No newline at end of file
@@ -94,5 +94,42 @@ mtimer_disarm(void) {
 	write64(MTIMECMP_ADDR(hart_id), (uint64_t) -1);
 }
 
+/*
+ * The same through the time / stimecmp CSRs (Zicntr / Sstc), that are
+ * much cheaper than an uncached MMIO access, if the hart implements them
+ * (see timer.c). Note that stimecmp raises the supervisor timer interrupt
+ * instead, while menvcfg.STCE is set, which still traps to M-mode since
+ * we don't delegate it.
+ */
+static inline uint64_t
+mtimer_csr_get_num_ticks(void)
+{
+	return csr_read(CSR_TIME);
+}
+
+static inline void
+mtimer_csr_enable_irq(void)
+{
+	csr_set_bits(CSR_MIE, (1 << INTR_SUPERVISOR_TIMER));
+}
+
+static inline void
+mtimer_csr_disable_irq(void)
+{
+	csr_clear_bits(CSR_MIE, (1 << INTR_SUPERVISOR_TIMER));
+}
+
+static inline void
+mtimer_csr_arm_at(uint64_t cycles)
+{
+	csr_write(CSR_STIMECMP, cycles);
+}
+
+static inline void
+mtimer_csr_disarm(void)
+{
+	csr_write(CSR_STIMECMP, (uint64_t) -1);
+}
+
 #endif /* PLAT_NO_MTIMER */
 #endif /* _MTIMER_H */
\ No newline at end of file
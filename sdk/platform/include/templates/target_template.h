@@ -21,6 +21,30 @@
  * used for cycle counter - based timer. */
 #define	PLAT_HART_FREQ		10000000
 
+/*---=== Performance Counters ===---*/
+/* Named mhpmevent values for perf.h (cycles / instret are always
+ * there), these are implementation-specific, check the core's
+ * manual. Leave undefined if there are none, raw values can still
+ * be used with perf_group_add_raw(). */
+/*
+#define PLAT_PERF_EVENTS \
+	{ "l1d_miss",		0x0 }, \
+	{ "l1i_miss",		0x0 }, \
+	{ "branch_miss",	0x0 }, \
+	{ "stall_cycles",	0x0 }
+*/
+
+/* Named sets of the above, usable in place of event names */
+/*
+#define PLAT_PERF_SETS \
+	{ "cache",	"l1d_miss,l1i_miss" }, \
+	{ "pipeline",	"cycles,instret,branch_miss,stall_cycles" }
+*/
+
+/* Default event for the sampling profiler (perf_prof_start()), it
+ * needs one on the hpm counters, so not cycles / instret */
+/* #define PLAT_PERF_PROF_EVENT	"l1d_miss" */
+
 /*---=== Memory Layout ===---*/
 #define KB	1024
 #define MB	KB * 1024
@@ -36,6 +60,17 @@
 #define	PLAT_RAM_SIZE		2 * MB
 #define	PLAT_STACK_SIZE		8 * KB
 
+/* Define this if RAM is guaranteed to be zeroed on reset (and nothing
+ * else touches it before us), so that calloc() can skip clearing heap
+ * memory that was never used. Don't use it if the target may warm-reboot
+ * with RAM retaining its contents. */
+//#define PLAT_RAM_ZEROED_ON_RESET
+
+/* The cbo.zero block size, if the harts have Zicboz (and it's in
+ * -march), start.S uses it to clear .bss since it can't probe for it
+ * that early. */
+//#define PLAT_CBOZ_BLOCK_SIZE	64
+
 #if defined(LDSCRIPT)
 ___rom = PLAT_ROM_BASE;
 ___rom_size = PLAT_ROM_SIZE;
@@ -90,6 +125,15 @@ ___num_harts = PLAT_MAX_HARTS;
  * set it to -1 to use the boot lottery instead. */
 #define PLAT_BOOT_HART_ID	-1
 
+/* Mask of the hart_ids expected to come up, the boot hart stops
+ * waiting for secondary harts as soon as these checked in, leave
+ * it undefined to wait for PLAT_MAX_HARTS harts. */
+/* #define PLAT_HART_MASK	0xF */
+
+/* Upper bound on how long the boot hart waits for
+ * secondary harts to check in, in usecs. */
+#define PLAT_SMP_BOOT_TIMEOUT_US	100000
+
 /* Set to 1 to use vectored traps on mtvec, 0 for
  * direct (single trap handler with dispatch table). */
 #define PLAT_HART_VECTORED_TRAPS 1
@@ -98,9 +142,21 @@ ___num_harts = PLAT_MAX_HARTS;
  * leave it 0 to use MSWI instead. */
 #define PLAT_IMSIC_IPI_EIID 0
 
+/* Set to > 1 for multicast IPIs (ipi_send_mask) to fan out in
+ * a tree, with each hart forwarding them to up to that many
+ * others, instead of the sender doing all of them. */
+#ifndef PLAT_IPI_FANOUT	/* Or build with IPI_FANOUT=<n> */
+#define PLAT_IPI_FANOUT		0
+#endif
+
 /* Set to 1 to force APLIC direct mode, bypassing IMSIC */
 #define PLAT_APLIC_FORCE_DIRECT 0
 
+/* How many external interrupts to handle on a single trap, the
+ * dispatcher keeps claiming until there are none left or it hits
+ * this (set to 1 for a trap per interrupt). */
+#define PLAT_IRQ_DISPATCH_BUDGET	8
+
 /* Quirks */
 //#define PLAT_NO_WFI
 //#define PLAT_QUIRK_WFI_EPC
@@ -131,5 +187,30 @@ DEFINE_PLATFORM_INTC_MAP({
 #define PLAT_UART_REG_SHIFT	0
 #define	PLAT_UART_SHIFTED_IO	0
 #define PLAT_UART_IRQ		10
+/* Size of the Tx FIFO, once THRE is set the driver pushes that
+ * many bytes without polling the UART again (16 on a 16550A) */
+#define PLAT_UART_FIFO_DEPTH	16
+/* For UARTs that report how many bytes are in the Tx FIFO (e.g.
+ * DesignWare's TFL), its register index (offset >> REG_SHIFT), so
+ * that the driver can also use a partially drained FIFO */
+/* #define PLAT_UART_TX_FIFO_LEVEL_REG	0x20 */
+
+/*---=== VIRTIO Console ===---*/
+/* Set to the base address of a virtio-mmio slot with a virtio console
+ * (e.g. 0x10007000 on QEMU virt, see VIRTIO_CONSOLE in run.sh) to use
+ * it instead of the UART, set to 0 to disable */
+#define PLAT_VIRTIO_CONSOLE_BASE	0
+#define PLAT_VIRTIO_CONSOLE_IRQ		7
+
+/*---=== VIRTIO Net ===---*/
+/* Base address / interrupt of a virtio-mmio slot with a virtio-net
+ * device (see net.h), leave undefined or set to 0 to disable */
+#define PLAT_VIRTIO_NET_BASE_ADDR	0
+#define PLAT_VIRTIO_NET_IRQ		8
+
+/*---=== VIRTIO Block ===---*/
+/* Same for a virtio-blk device (see blk.h) */
+#define PLAT_VIRTIO_BLK_BASE_ADDR	0
+#define PLAT_VIRTIO_BLK_IRQ		6
 
 #endif /* _PLATFORM_H */
\ No newline at end of file
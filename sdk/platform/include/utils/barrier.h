@@ -0,0 +1,71 @@
+/*
+ * SPDX-FileType: SOURCE
+ *
+ * SPDX-FileCopyrightText: 2026 Nick Kossifidis <mick@ics.forth.gr>
+ * SPDX-FileCopyrightText: 2026 ICS/FORTH
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * Barriers for all harts (they size themselves from hart_get_count()
+ * at init, so every hart that came up has to take part), see barrier.c
+ * for the details:
+ *
+ * struct barrier: Centralized sense-reversing barrier, a shared counter
+ * and a generation number (the "sense"), each hart does one atomic add
+ * and then waits for the last one to flip the generation. Cheap at low
+ * hart counts, but everyone hits the same two cache lines.
+ *
+ * struct dissem_barrier: Dissemination barrier, log2(N) rounds where
+ * each hart signals one other hart and waits for another one, on
+ * per-hart cache line sized nodes, so there is no shared hot spot.
+ *
+ * Waiters either spin (using Zawrs' wrs.nto when the harts implement
+ * it, pause otherwise), or with BARRIER_WAIT_WFI sleep on wfi and get
+ * woken up with an IPI by whoever releases them.
+ */
+
+#ifndef _BARRIER_H
+#define _BARRIER_H
+
+#include <target_config.h>	/* For PLAT_MAX_HARTS */
+#include <stdatomic.h>		/* For C11 atomic types */
+#include <stdint.h>		/* For typed integers */
+
+/* Nodes are padded to this, to avoid false sharing */
+#define BARRIER_CACHE_LINE	64
+
+enum barrier_wait_mode {
+	BARRIER_WAIT_SPIN = 0,
+	BARRIER_WAIT_WFI = 1,
+};
+
+struct barrier {
+	_Alignas(BARRIER_CACHE_LINE) atomic_uint count;
+	_Alignas(BARRIER_CACHE_LINE) atomic_uint generation;
+	uint16_t num_harts;
+	uint8_t mode;
+};
+
+/* Enough rounds for 2^8 harts */
+#define BARRIER_MAX_ROUNDS	8
+
+struct dissem_barrier_node {
+	_Alignas(BARRIER_CACHE_LINE) atomic_uint flags[BARRIER_MAX_ROUNDS];
+	unsigned int episode;	/* Only touched by its hart */
+};
+
+struct dissem_barrier {
+	struct dissem_barrier_node nodes[PLAT_MAX_HARTS];
+	uint16_t num_harts;
+	uint8_t num_rounds;
+	uint8_t mode;
+};
+
+void barrier_init(struct barrier *b, enum barrier_wait_mode mode);
+void barrier_wait(struct barrier *b);
+void dissem_barrier_init(struct dissem_barrier *b, enum barrier_wait_mode mode);
+void dissem_barrier_wait(struct dissem_barrier *b);
+
+#endif /* _BARRIER_H */
@@ -0,0 +1,92 @@
+/*
+ * SPDX-FileType: SOURCE
+ *
+ * SPDX-FileCopyrightText: 2026 Nick Kossifidis <mick@ics.forth.gr>
+ * SPDX-FileCopyrightText: 2026 ICS/FORTH
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * Deferred binary logging, for tracing hot paths where even formatting a
+ * message is too much. BINLOG() places its format string in a dedicated
+ * linker section (.rodata.binlog_fmts, see bmbase.ld.tmpl) and at runtime
+ * only stores the string's offset in that section together with the raw
+ * argument words, the cycle counter and the hart index, in a fixed-size
+ * record of a shared ring. Formatting happens offline: binlog_dump() sends
+ * the records over the console in hex, and tools/binlog_decode.py renders
+ * them using the format strings from the ELF image.
+ *
+ * Usage:
+ *	BINLOG("irq %u on hart %i, took %lu cycles\n", source, hart, delta);
+ *
+ * Arguments are stored as 64bit words (integers / pointers converted,
+ * doubles as their bits), so the format string may use any of the integer,
+ * floating point or %p conversions. %s only works for strings that live in
+ * the image (e.g. string literals), since only the pointer is recorded.
+ */
+
+#ifndef _BINLOG_H
+#define _BINLOG_H
+
+#include <stddef.h>	/* For size_t */
+#include <stdint.h>	/* For typed integers */
+
+#define BINLOG_MAX_ARGS		5
+
+/* One cache line (assuming 64byte lines) per record */
+struct binlog_record {
+	uint64_t seq;		/* Sequence number, for ordering / detecting overwrites */
+	uint32_t fmt_id;	/* Offset of the format string in .rodata.binlog_fmts */
+	uint16_t hart_idx;
+	uint16_t nargs;
+	uint64_t cycles;	/* mcycle of the logging hart */
+	uint64_t args[BINLOG_MAX_ARGS];
+};
+
+int binlog_init(void *buff, size_t size);
+void binlog_write(const char *fmt, unsigned int nargs, const uint64_t *args);
+uint64_t binlog_count(void);
+int binlog_get(uint64_t seq, struct binlog_record *rec);
+void binlog_dump(void);
+
+/* Argument conversion, only the selected branch is evaluated
+ * but all of them need to be valid for any argument type. */
+static inline uint64_t
+__binlog_dbl_bits(double val)
+{
+	union { double d; uint64_t u; } bits = { .d = val };
+	return bits.u;
+}
+
+#define __BINLOG_AS_DBL(x)	_Generic((x), float: (x), double: (x), default: 0.0)
+#define __BINLOG_AS_INT(x)	_Generic((x), float: 0, double: 0, default: (x))
+#define __BINLOG_WORD(x)	_Generic((x), \
+				 float: __binlog_dbl_bits(__BINLOG_AS_DBL(x)), \
+				 double: __binlog_dbl_bits(__BINLOG_AS_DBL(x)), \
+				 default: (uint64_t) __BINLOG_AS_INT(x))
+
+#define __BINLOG_MAP_0()
+#define __BINLOG_MAP_1(a)		__BINLOG_WORD(a)
+#define __BINLOG_MAP_2(a, ...)		__BINLOG_WORD(a), __BINLOG_MAP_1(__VA_ARGS__)
+#define __BINLOG_MAP_3(a, ...)		__BINLOG_WORD(a), __BINLOG_MAP_2(__VA_ARGS__)
+#define __BINLOG_MAP_4(a, ...)		__BINLOG_WORD(a), __BINLOG_MAP_3(__VA_ARGS__)
+#define __BINLOG_MAP_5(a, ...)		__BINLOG_WORD(a), __BINLOG_MAP_4(__VA_ARGS__)
+
+#define __BINLOG_NARGS_(_0, _1, _2, _3, _4, _5, _6, _7, _8, n, ...)	n
+#define __BINLOG_NARGS(...)	__BINLOG_NARGS_(0, ##__VA_ARGS__, 8, 7, 6, 5, 4, 3, 2, 1, 0)
+#define __BINLOG_CAT_(a, b)	a##b
+#define __BINLOG_CAT(a, b)	__BINLOG_CAT_(a, b)
+
+#define BINLOG(fmt, ...) do { \
+	static const char __binlog_fmt[] \
+	__attribute__((used, section(".rodata.binlog_fmts"))) = fmt; \
+	_Static_assert(__BINLOG_NARGS(__VA_ARGS__) <= BINLOG_MAX_ARGS, \
+		       "Too many arguments for BINLOG()"); \
+	const uint64_t __binlog_args[BINLOG_MAX_ARGS] = { \
+		__BINLOG_CAT(__BINLOG_MAP_, __BINLOG_NARGS(__VA_ARGS__))(__VA_ARGS__) \
+	}; \
+	binlog_write(__binlog_fmt, __BINLOG_NARGS(__VA_ARGS__), __binlog_args); \
+} while (0)
+
+#endif /* _BINLOG_H */
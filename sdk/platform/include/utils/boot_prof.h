@@ -0,0 +1,50 @@
+/*
+ * SPDX-FileType: SOURCE
+ *
+ * SPDX-FileCopyrightText: 2026 Nick Kossifidis <mick@ics.forth.gr>
+ * SPDX-FileCopyrightText: 2026 ICS/FORTH
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * Boot phase timestamps. The boot hart stamps mcycle at the end of each
+ * phase between reset and main(), starting from start.S (that keeps the
+ * reset stamp in a register until .bss is cleared), into a small table
+ * that boot_prof_dump() prints as per-phase durations. Stamps before
+ * hart_init_counters() rely on mcycle counting from reset, which is the
+ * case on most harts (mcountinhibit is usually zero on reset).
+ */
+
+#ifndef _BOOT_PROF_H
+#define _BOOT_PROF_H
+
+#include <stdint.h>			/* For typed integers */
+#include <platform/riscv/csr.h>		/* For csr_read() */
+
+/* In the order they happen, start.S relies on the first two */
+enum boot_phase {
+	BOOT_PHASE_RESET = 0,	/* Entry to _start */
+	BOOT_PHASE_DATA_BSS,	/* Image expanded (LZ4_BOOT) / .data relocated / .bss cleared */
+	BOOT_PHASE_HART_INIT,	/* Stack / hart_state / percpu, entry to hart_init() */
+	BOOT_PHASE_UART,	/* uart_init() */
+	BOOT_PHASE_SMP,		/* Waiting for secondary harts */
+	BOOT_PHASE_IRQ,		/* irq_init() */
+	BOOT_PHASE_HART_SETUP,	/* FPU / VPU / counters / triggers */
+	BOOT_PHASE_ISA_CAPS,	/* hart_probe_isa_caps() */
+	BOOT_PHASE_INTR,	/* Interrupts and the hart's timer */
+	BOOT_PHASE_MAIN,	/* Entry to main() */
+	BOOT_PHASE_NUM
+};
+
+extern uint64_t boot_prof_cycles[BOOT_PHASE_NUM];
+
+static inline void
+boot_prof_mark(enum boot_phase phase)
+{
+	boot_prof_cycles[phase] = csr_read(CSR_MCYCLE);
+}
+
+void boot_prof_dump(void);
+
+#endif /* _BOOT_PROF_H */
@@ -0,0 +1,38 @@
+/*
+ * SPDX-FileType: SOURCE
+ *
+ * SPDX-FileCopyrightText: 2026 Nick Kossifidis <mick@ics.forth.gr>
+ * SPDX-FileCopyrightText: 2026 ICS/FORTH
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * Checksums and hashing for buffers, e.g. for checking images / packets
+ * or keying hash tables. crc32() is the CRC-32 of zlib / Ethernet and
+ * crc32c() the Castagnoli one (iSCSI / ext4 / virtio), both reflected,
+ * with the usual pre / post inversion done internally, so that they can
+ * be chained: crc32(crc32(0, a, la), b, lb) == crc32 of a followed by b.
+ *
+ * On RV64 harts with Zbc / Zbkc (see hart_probe.c) they use carry-less
+ * multiplication with Barrett reduction, 8 bytes at a time, else the
+ * slicing-by-8 tables (built when the probe runs, before that they go
+ * bit by bit).
+ *
+ * hash64() is a fast non-cryptographic hash (wyhash), don't use it for
+ * anything that needs to resist crafted inputs. crc32(), crc32c() and
+ * hash64() all read the buffer as little-endian words, so the results
+ * don't depend on the hart's byte order.
+ */
+
+#ifndef _CRC_H
+#define _CRC_H
+
+#include <stdint.h>	/* For typed integers */
+#include <stddef.h>	/* For size_t */
+
+uint32_t crc32(uint32_t crc, const void *buf, size_t len);
+uint32_t crc32c(uint32_t crc, const void *buf, size_t len);
+uint64_t hash64(const void *buf, size_t len, uint64_t seed);
+
+#endif /* _CRC_H */
@@ -0,0 +1,118 @@
+/*
+ * SPDX-FileType: SOURCE
+ *
+ * SPDX-FileCopyrightText: 2026 Nick Kossifidis <mick@ics.forth.gr>
+ * SPDX-FileCopyrightText: 2026 ICS/FORTH
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * Device request queues, the common glue between a driver's hardware
+ * queue and its users. The driver fills in a struct devq_ops (queue a
+ * request, notify the device, grab completed requests, turn the device's
+ * completion interrupt on / off) and embeds a struct devq, and the
+ * framework takes care of locking, counting requests in flight and
+ * running completions, so that every driver handles them the same way:
+ *
+ *	dev_submit() / dev_submit_batch()  queue requests, with a single
+ *					   notification per call
+ *	dev_poll()			   runs completions, up to DEVQ_BATCH
+ *					   at a time per lock hold, outside
+ *					   the lock so they may submit more
+ *	dev_irq()			   the same from the driver's
+ *					   interrupt handler
+ *
+ * Requests are opaque to the framework, drivers pass their own request
+ * structs around. Completions are delivered in one of three modes:
+ *
+ *	DEVQ_MODE_POLL		only through dev_poll() / dev_wait()
+ *	DEVQ_MODE_IRQ		from the interrupt handler
+ *	DEVQ_MODE_ADAPTIVE	starts on interrupts, switches to polling
+ *				when the interrupt handler gets a batch of
+ *				at least busy_thresh completions while
+ *				someone is calling dev_poll(), and back to
+ *				interrupts after idle_polls dev_poll() calls
+ *				in a row that found nothing
+ *
+ * so that a device under load doesn't pay for an interrupt per batch,
+ * and one that's mostly idle doesn't keep a hart spinning. In adaptive
+ * mode whoever has requests in flight should keep calling dev_poll()
+ * (or dev_wait()), since while polling nothing else will pick up their
+ * completions. busy_thresh / idle_polls may be changed after devq_init().
+ */
+
+#ifndef _DEVQ_H
+#define _DEVQ_H
+
+#include <stdint.h>			/* For typed integers */
+#include <stdbool.h>			/* For bool */
+#include <platform/utils/lock.h>	/* For sdk_lock_t */
+
+/* Completed requests grabbed per lock hold */
+#define DEVQ_BATCH		16
+/* Adaptive mode defaults */
+#define DEVQ_BUSY_THRESH	4
+#define DEVQ_IDLE_POLLS		64
+
+enum devq_mode {
+	DEVQ_MODE_POLL = 0,
+	DEVQ_MODE_IRQ,
+	DEVQ_MODE_ADAPTIVE,
+};
+
+struct devq;
+
+/* All called with the queue's lock held (and interrupts blocked),
+ * except complete() */
+struct devq_ops {
+	/* Queue a request on the device, -EAGAIN if it's full */
+	int (*submit)(struct devq *q, void *req);
+	/* Notify the device about new requests (may be NULL) */
+	void (*kick)(struct devq *q);
+	/* Grab up to max completed requests, returns how many */
+	int (*reap)(struct devq *q, void **reqs, int max);
+	/* Set the request's status and call its callback (without the lock) */
+	void (*complete)(struct devq *q, void *req);
+	/* Turn the completion interrupt on / off, when turning it on return
+	 * false if requests may have completed without triggering one
+	 * (may be NULL, in which case only DEVQ_MODE_POLL works) */
+	bool (*irq_ctl)(struct devq *q, bool on);
+	/* Acknowledge the device's interrupt (may be NULL) */
+	void (*ack_irq)(struct devq *q);
+};
+
+struct devq_stats {
+	uint64_t submitted;
+	uint64_t completed;
+	uint64_t polls;		/* dev_poll() calls */
+	uint64_t empty_polls;	/* ... that found nothing */
+	uint64_t irqs;		/* dev_irq() calls */
+	uint64_t to_poll;	/* Adaptive switches to polling */
+	uint64_t to_irq;	/* ... and back to interrupts */
+};
+
+struct devq {
+	const struct devq_ops *ops;
+	void *priv;		/* For the driver's use */
+	sdk_lock_t lock;
+	enum devq_mode mode;
+	bool irq_on;
+	bool polled;		/* dev_poll() was called since the last dev_irq() */
+	uint16_t busy_thresh;
+	uint16_t idle_polls;
+	uint16_t idle_count;
+	uint32_t inflight;
+	struct devq_stats stats;
+};
+
+void devq_init(struct devq *q, const struct devq_ops *ops, void *priv);
+int dev_set_mode(struct devq *q, enum devq_mode mode);
+int dev_submit(struct devq *q, void *req);
+int dev_submit_batch(struct devq *q, void * const *reqs, int num);
+int dev_poll(struct devq *q, int budget);
+int dev_wait(struct devq *q, const volatile int *status);
+void dev_irq(struct devq *q);
+void dev_get_stats(struct devq *q, struct devq_stats *stats);
+
+#endif /* _DEVQ_H */
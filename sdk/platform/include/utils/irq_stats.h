@@ -0,0 +1,82 @@
+/*
+ * SPDX-FileType: SOURCE
+ *
+ * SPDX-FileCopyrightText: 2026 Nick Kossifidis <mick@ics.forth.gr>
+ * SPDX-FileCopyrightText: 2026 ICS/FORTH
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * Interrupt latency / handler duration histograms. When built with
+ * IRQ_STATS, the timer, IPI and external interrupt paths stamp mcycle
+ * when they enter their trap handler, right before calling the handler
+ * for the interrupt (the timer wheel, hart_on_mswtrig(), or the handler
+ * registered for an external source), and when it returns. Each hart
+ * keeps, for each source, a log2 histogram of entry -> handler cycles
+ * (latency, including the claim from the interrupt controller) and of
+ * handler -> return cycles (duration). Only the hart itself updates its
+ * histograms, so there are no atomics on the hot path, readers on other
+ * harts may see them mid-update.
+ *
+ * Without IRQ_STATS the hooks compile to nothing.
+ */
+
+#ifndef _IRQ_STATS_H
+#define _IRQ_STATS_H
+
+#include <target_config.h>	/* For PLAT_NUM_IRQ_SOURCES */
+#include <stdint.h>		/* For typed integers */
+
+/* Bucket i counts samples in [2^i, 2^(i + 1)) cycles (bucket
+ * 0 also counts 0), the last one everything above */
+#define IRQ_STAT_BUCKETS	32
+
+struct irq_hist {
+	uint32_t count[IRQ_STAT_BUCKETS];
+	uint64_t max;
+};
+
+struct irq_stats {
+	struct irq_hist latency;
+	struct irq_hist duration;
+};
+
+/* External sources go by their source_id (wire id / eiid),
+ * followed by the core interrupts */
+#if !defined(PLAT_NUM_IRQ_SOURCES)
+	#define IRQ_STAT_TIMER	1
+#else
+	#define IRQ_STAT_TIMER	(PLAT_NUM_IRQ_SOURCES + 1)
+#endif
+#define IRQ_STAT_IPI		(IRQ_STAT_TIMER + 1)
+#define IRQ_STAT_NUM_SOURCES	(IRQ_STAT_IPI + 1)
+
+#if defined(IRQ_STATS)
+
+#include <platform/riscv/csr.h>		/* For csr_read() */
+#include <platform/utils/percpu.h>	/* For __percpu / this_cpu_ptr() */
+
+extern uint64_t irq_stats_entry_cycles __percpu;
+
+void irq_stats_init_hart(void);
+void irq_stats_record(uint16_t source, uint64_t dispatch);
+
+#define IRQ_STATS_ENTRY()	(*this_cpu_ptr(&irq_stats_entry_cycles) = csr_read(CSR_MCYCLE))
+#define IRQ_STATS_STAMP(_var)	const uint64_t _var = csr_read(CSR_MCYCLE)
+#define IRQ_STATS_RECORD(_src, _var)	irq_stats_record((_src), (_var))
+
+#else
+
+#define IRQ_STATS_ENTRY()		do {} while (0)
+#define IRQ_STATS_STAMP(_var)		do {} while (0)
+#define IRQ_STATS_RECORD(_src, _var)	do {} while (0)
+
+#endif /* IRQ_STATS */
+
+/* These return -ENOTSUP without IRQ_STATS */
+int irq_stats_get(uint16_t hart_idx, uint16_t source, struct irq_stats *out);
+int irq_stats_reset(uint16_t hart_idx);
+int irq_stats_dump(void);
+
+#endif /* _IRQ_STATS_H */
@@ -8,16 +8,58 @@
  */
  
 /*
- * Generic wrapper functions for acquiring and releasing a
- * spin-lock using C11 atomics.
+ * Generic wrapper functions for acquiring and releasing locks
+ * using C11 atomics: a simple spin-lock, a ticket lock (FIFO),
+ * and an MCS queue lock (FIFO, each waiter spins on its own node),
+ * plus sdk_lock_t that the SDK uses internally, and can be switched
+ * between them at build time. For read-mostly data there is also a
+ * reader-writer lock and a seqlock, where readers don't do any atomic
+ * read-modify-write operations. On harts with Zawrs waiters sleep on
+ * wrs.nto until the word they wait on changes, instead of polling it.
  */
 
 #ifndef _LOCK_H
 #define _LOCK_H
 
 #include <stdatomic.h>		/* For C11 atomic types / accessors */
+#include <stdbool.h>		/* For bool */
+#include <stddef.h>		/* For NULL */
+#include <stdint.h>		/* For typed integers */
 #include <platform/riscv/csr.h>	/* For pause() */
 
+/* Set at boot if the harts implement Zawrs (see lock.c) */
+extern bool lock_use_zawrs;
+
+/*
+ * Wait for a 32bit word to change from val. With Zawrs we grab a
+ * reservation on the word with lr.w and wrs.nto stalls the hart until
+ * someone writes to it (or an interrupt is pending, or for some
+ * implementation-defined time), else it's just a pause() hint, in both
+ * cases it may return without the word changing, so use it inside a
+ * loop that re-checks the condition.
+ */
+static inline void
+lock_wait_change(const volatile void *word, uint32_t val) {
+	#if defined(__riscv_atomic)
+		if (lock_use_zawrs) {
+			long cur;
+			/* lr.w sign-extends, so compare against
+			 * val sign-extended as well */
+			__asm__ __volatile__(
+				".option push\n"
+				".option arch, +zawrs\n"
+				"lr.w	%0, (%1)\n"
+				"bne	%0, %2, 1f\n"
+				"wrs.nto\n"
+				"1:\n"
+				".option pop\n"
+				: "=&r"(cur) : "r"(word), "r"((long)(int32_t) val) : "memory");
+			return;
+		}
+	#endif
+	pause();
+}
+
 /*
  * Acquire a spin-lock using a compare-and-swap loop on the provided variable.
  */
@@ -51,17 +93,34 @@ lock_acquire(atomic_int *lock) {
 						      1,
 						      memory_order_acquire,
 						      memory_order_relaxed)) {
+		/* Wait for the holder to release it (expected has the value we
+		 * saw), on wrs.nto if we have Zawrs, else give it some time to
+		 * breathe using the pause instruction from the Zihintpause
+		 * extension, since it's a hint it'll end up being a nop in case
+		 * it's not supported by hw */
+		lock_wait_change(lock, (uint32_t) expected);
+
 		/* Reset expected to 0 (since it gets updated on failure)
 		 * and re-try */
 		expected = 0;
-
-		/* Give it some time to breathe using the pause instruction
-		 * from the Zihintpause extension, since it's a hint it'll
-		 * end up being a nop in case it's not supported by hw */
-		pause();
 	}
 }
 
+/*
+ * Try to acquire the spin-lock once without spinning, returns true
+ * if we got it. Here we use the strong version, since a spurious
+ * failure would mean reporting the lock as taken while it wasn't.
+ */
+static inline bool
+lock_try_acquire(atomic_int *lock) {
+	int expected = 0;
+	return atomic_compare_exchange_strong_explicit(lock,
+						       &expected,
+						       1,
+						       memory_order_acquire,
+						       memory_order_relaxed);
+}
+
 /*
  * Releases the spin-lock built around the provided variable
  */
@@ -72,4 +131,348 @@ lock_release(atomic_int *lock) {
 	atomic_store_explicit(lock, 0, memory_order_release);
 }
 
+/*
+ * Ticket lock: each waiter takes a ticket (an atomic increment of next) and
+ * waits for owner to reach it, so the lock is handed over in FIFO order and
+ * nobody starves. Waiters still all poll the same cache line, but they only
+ * read it, and the only write on release is the owner's.
+ */
+struct ticket_lock {
+	atomic_uint next;
+	atomic_uint owner;
+};
+
+#define TICKET_LOCK_INIT	{ 0, 0 }
+
+static inline void
+ticket_lock_acquire(struct ticket_lock *lock) {
+	const unsigned int ticket = atomic_fetch_add_explicit(&lock->next, 1,
+							      memory_order_relaxed);
+	while (1) {
+		const unsigned int owner = atomic_load_explicit(&lock->owner,
+								memory_order_acquire);
+		if (owner == ticket)
+			return;
+		/* Sleep until owner moves if we can, or else
+		 * back off in proportion to the number of
+		 * waiters ahead of us */
+		if (lock_use_zawrs) {
+			lock_wait_change(&lock->owner, owner);
+			continue;
+		}
+		for (unsigned int i = ticket - owner; i > 0; i--)
+			pause();
+	}
+}
+
+/*
+ * Only take a ticket if it would be served right away, i.e. if next
+ * is still equal to owner.
+ */
+static inline bool
+ticket_lock_try_acquire(struct ticket_lock *lock) {
+	unsigned int expected = atomic_load_explicit(&lock->owner, memory_order_relaxed);
+	return atomic_compare_exchange_strong_explicit(&lock->next,
+						       &expected,
+						       expected + 1,
+						       memory_order_acquire,
+						       memory_order_relaxed);
+}
+
+static inline void
+ticket_lock_release(struct ticket_lock *lock) {
+	/* Only the holder writes owner */
+	const unsigned int owner = atomic_load_explicit(&lock->owner, memory_order_relaxed);
+	atomic_store_explicit(&lock->owner, owner + 1, memory_order_release);
+}
+
+/*
+ * MCS lock: waiters form a queue of nodes they provide (e.g. on their stack),
+ * the lock itself only points to the tail. Each waiter spins on its
+ * own node's locked flag, and the holder hands the lock over by clearing
+ * its successor's flag, so under contention a release only touches the
+ * cache line of the next waiter. The node must stay around until
+ * mcs_lock_release().
+ */
+struct mcs_node {
+	_Atomic(struct mcs_node *) next;
+	atomic_int locked;
+};
+
+struct mcs_lock {
+	_Atomic(struct mcs_node *) tail;
+};
+
+#define MCS_LOCK_INIT	{ NULL }
+
+static inline void
+mcs_lock_acquire(struct mcs_lock *lock, struct mcs_node *node) {
+	atomic_store_explicit(&node->next, NULL, memory_order_relaxed);
+	atomic_store_explicit(&node->locked, 1, memory_order_relaxed);
+
+	/* Queue ourselves, release so that our predecessor sees
+	 * the node initialized, acquire in case we got it right away */
+	struct mcs_node *prev = atomic_exchange_explicit(&lock->tail, node,
+							 memory_order_acq_rel);
+	if (!prev)
+		return;
+
+	atomic_store_explicit(&prev->next, node, memory_order_release);
+	while (atomic_load_explicit(&node->locked, memory_order_acquire))
+		lock_wait_change(&node->locked, 1);
+}
+
+static inline bool
+mcs_lock_try_acquire(struct mcs_lock *lock, struct mcs_node *node) {
+	struct mcs_node *expected = NULL;
+	atomic_store_explicit(&node->next, NULL, memory_order_relaxed);
+	atomic_store_explicit(&node->locked, 0, memory_order_relaxed);
+	return atomic_compare_exchange_strong_explicit(&lock->tail,
+						       &expected,
+						       node,
+						       memory_order_acq_rel,
+						       memory_order_relaxed);
+}
+
+static inline void
+mcs_lock_release(struct mcs_lock *lock, struct mcs_node *node) {
+	struct mcs_node *next = atomic_load_explicit(&node->next, memory_order_acquire);
+
+	if (!next) {
+		/* No one queued behind us, try to mark the lock as free */
+		struct mcs_node *expected = node;
+		if (atomic_compare_exchange_strong_explicit(&lock->tail,
+							    &expected,
+							    NULL,
+							    memory_order_release,
+							    memory_order_relaxed))
+			return;
+		/* Someone swapped the tail but didn't link
+		 * to us yet, wait for it */
+		while (!(next = atomic_load_explicit(&node->next, memory_order_acquire)))
+			pause();
+	}
+	atomic_store_explicit(&next->locked, 0, memory_order_release);
+}
+
+/*
+ * Reader-writer lock: each hart has its own reader count on its own cache
+ * line, so readers only ever store to a line that no other hart touches
+ * (no atomic RMW, no bouncing lines), and the writers pay for it instead:
+ * a writer takes the writer flag and then waits for every hart's count to
+ * drop to zero. A reader bumps its count and then checks the writer flag,
+ * and a writer sets the flag and then checks the counts, with a full fence
+ * in between on both sides, so at least one of them always sees the other.
+ * If a writer got there first the reader backs off and waits for it, so
+ * writers don't starve.
+ *
+ * Read sections may nest on the same hart (e.g. from an interrupt handler),
+ * a nested reader doesn't back off since the writer would wait for us
+ * anyway. A hart must not try to write while it holds the lock for reading.
+ *
+ * Since it's sized by PLAT_MAX_HARTS, it's only available to code built for
+ * a target (that included target_config.h before this), yalibc is built
+ * target-independent.
+ */
+#if defined(PLAT_MAX_HARTS)
+
+#include <platform/riscv/hart.h>	/* For hart_get_hstate_self/count() */
+
+struct rwlock {
+	_Alignas(64) atomic_int writer;
+	struct {
+		_Alignas(64) atomic_uint count;
+	} readers[PLAT_MAX_HARTS];
+};
+
+static inline void
+rwlock_read_acquire(struct rwlock *rw) {
+	atomic_uint *count = &rw->readers[hart_get_hstate_self()->hart_idx].count;
+
+	while (1) {
+		/* Only this hart writes to count, an interrupt handler
+		 * in between the load and the store puts it back the
+		 * way it found it */
+		const unsigned int nested = atomic_load_explicit(count, memory_order_relaxed);
+		atomic_store_explicit(count, nested + 1, memory_order_relaxed);
+		atomic_thread_fence(memory_order_seq_cst);
+		if (nested || !atomic_load_explicit(&rw->writer, memory_order_relaxed))
+			return;
+
+		/* A writer is in, get out of its way */
+		atomic_store_explicit(count, nested, memory_order_release);
+		while (atomic_load_explicit(&rw->writer, memory_order_relaxed))
+			lock_wait_change(&rw->writer, 1);
+	}
+}
+
+static inline void
+rwlock_read_release(struct rwlock *rw) {
+	atomic_uint *count = &rw->readers[hart_get_hstate_self()->hart_idx].count;
+	const unsigned int nested = atomic_load_explicit(count, memory_order_relaxed);
+	atomic_store_explicit(count, nested - 1, memory_order_release);
+}
+
+static inline void
+rwlock_write_acquire(struct rwlock *rw) {
+	lock_acquire(&rw->writer);
+	atomic_thread_fence(memory_order_seq_cst);
+	for (int i = 0; i < hart_get_count(); i++) {
+		unsigned int count;
+		while ((count = atomic_load_explicit(&rw->readers[i].count, memory_order_acquire)))
+			lock_wait_change(&rw->readers[i].count, count);
+	}
+}
+
+static inline void
+rwlock_write_release(struct rwlock *rw) {
+	lock_release(&rw->writer);
+}
+
+#endif /* PLAT_MAX_HARTS */
+
+/*
+ * Seqlock: the writer bumps seq to an odd value before updating the data
+ * and back to even when done, readers copy the data out and retry if seq
+ * was odd or changed in the meantime. Readers don't write anything at all
+ * so they never slow down each other or the writer, but they may have to
+ * retry, so this is for small data that is read much more often than it
+ * is written, and readers must not follow pointers they read inside the
+ * section before it's validated. Writers are serialized with a spin-lock.
+ *
+ *	unsigned int seq;
+ *	do {
+ *		seq = seqlock_read_begin(&sl);
+ *		copy = shared;
+ *	} while (seqlock_read_retry(&sl, seq));
+ */
+struct seqlock {
+	atomic_uint seq;
+	atomic_int lock;
+};
+
+#define SEQLOCK_INIT	{ 0, 0 }
+
+static inline unsigned int
+seqlock_read_begin(const struct seqlock *sl) {
+	unsigned int seq;
+	while ((seq = atomic_load_explicit((atomic_uint *) &sl->seq, memory_order_acquire)) & 1)
+		lock_wait_change(&sl->seq, seq);
+	return seq;
+}
+
+static inline bool
+seqlock_read_retry(const struct seqlock *sl, unsigned int seq) {
+	/* Order the data reads before re-checking seq */
+	atomic_thread_fence(memory_order_acquire);
+	return atomic_load_explicit((atomic_uint *) &sl->seq, memory_order_relaxed) != seq;
+}
+
+static inline void
+seqlock_write_begin(struct seqlock *sl) {
+	lock_acquire(&sl->lock);
+	const unsigned int seq = atomic_load_explicit(&sl->seq, memory_order_relaxed);
+	atomic_store_explicit(&sl->seq, seq + 1, memory_order_relaxed);
+	/* Make the odd seq visible before any of the data writes */
+	atomic_thread_fence(memory_order_release);
+}
+
+static inline void
+seqlock_write_end(struct seqlock *sl) {
+	const unsigned int seq = atomic_load_explicit(&sl->seq, memory_order_relaxed);
+	atomic_store_explicit(&sl->seq, seq + 1, memory_order_release);
+	lock_release(&sl->lock);
+}
+
+/*
+ * The lock type used for the SDK's internal locks (stdout / allocator /
+ * uart etc), build with SDK_LOCK_TICKET or SDK_LOCK_MCS defined to switch
+ * them from the spin-lock. The spin-lock is the smallest and fastest when
+ * uncontended, the other two are fair and scale better with many harts.
+ *
+ * For the MCS version the nodes come from a small per-hart pool (see
+ * lock.c), so that callers don't need to carry one around, and the
+ * holder's node is kept on the lock for sdk_lock_release().
+ */
+#if defined(SDK_LOCK_MCS)
+
+struct sdk_mcs_lock {
+	struct mcs_lock lock;
+	struct mcs_node *holder;
+};
+
+typedef struct sdk_mcs_lock sdk_lock_t;
+#define SDK_LOCK_INIT	{ MCS_LOCK_INIT, NULL }
+
+/* In lock.c */
+struct mcs_node *lock_get_mcs_node(void);
+void lock_put_mcs_node(struct mcs_node *node);
+
+static inline void
+sdk_lock_acquire(sdk_lock_t *lock) {
+	struct mcs_node *node = lock_get_mcs_node();
+	mcs_lock_acquire(&lock->lock, node);
+	lock->holder = node;
+}
+
+static inline bool
+sdk_lock_try_acquire(sdk_lock_t *lock) {
+	struct mcs_node *node = lock_get_mcs_node();
+	if (!mcs_lock_try_acquire(&lock->lock, node)) {
+		lock_put_mcs_node(node);
+		return false;
+	}
+	lock->holder = node;
+	return true;
+}
+
+static inline void
+sdk_lock_release(sdk_lock_t *lock) {
+	struct mcs_node *node = lock->holder;
+	mcs_lock_release(&lock->lock, node);
+	lock_put_mcs_node(node);
+}
+
+#elif defined(SDK_LOCK_TICKET)
+
+typedef struct ticket_lock sdk_lock_t;
+#define SDK_LOCK_INIT	TICKET_LOCK_INIT
+
+static inline void
+sdk_lock_acquire(sdk_lock_t *lock) {
+	ticket_lock_acquire(lock);
+}
+
+static inline bool
+sdk_lock_try_acquire(sdk_lock_t *lock) {
+	return ticket_lock_try_acquire(lock);
+}
+
+static inline void
+sdk_lock_release(sdk_lock_t *lock) {
+	ticket_lock_release(lock);
+}
+
+#else
+
+typedef atomic_int sdk_lock_t;
+#define SDK_LOCK_INIT	0
+
+static inline void
+sdk_lock_acquire(sdk_lock_t *lock) {
+	lock_acquire(lock);
+}
+
+static inline bool
+sdk_lock_try_acquire(sdk_lock_t *lock) {
+	return lock_try_acquire(lock);
+}
+
+static inline void
+sdk_lock_release(sdk_lock_t *lock) {
+	lock_release(lock);
+}
+
+#endif
+
 #endif /* _LOCK_H */
\ No newline at end of file
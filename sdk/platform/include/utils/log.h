@@ -0,0 +1,53 @@
+/*
+ * SPDX-FileType: SOURCE
+ *
+ * SPDX-FileCopyrightText: 2026 Nick Kossifidis <mick@ics.forth.gr>
+ * SPDX-FileCopyrightText: 2026 ICS/FORTH
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * Per-hart log rings, for logging from hot paths without waiting on the
+ * UART. Each hart formats its messages into its own ring (an SPSC ring,
+ * the hart being the only producer), and a designated hart sends them
+ * out by calling log_drain(), e.g. from its idle / polling loop. Messages
+ * that don't fit in the ring get dropped, and longer than LOG_MSG_MAX
+ * get truncated, both are counted and reported by log_drain().
+ *
+ * When built with LOG_RINGS the INF/DBG/ANN/WRN macros from utils.h go
+ * through log_printf(), and each hart gets its ring during hart_init(),
+ * otherwise log_printf() can still be called directly, on harts that
+ * called log_init_hart() first (else it's a plain printf()).
+ */
+
+#ifndef _LOG_H
+#define _LOG_H
+
+#include <stdarg.h>	/* For va_list */
+#include <stdint.h>	/* For typed integers */
+
+/* Size of each hart's ring (a power of two) */
+#ifndef LOG_RING_SIZE
+	#define LOG_RING_SIZE	4096
+#endif
+
+/* Longest message, formatted on the caller's stack */
+#ifndef LOG_MSG_MAX
+	#define LOG_MSG_MAX	128
+#endif
+
+struct log_stats {
+	uint32_t used;		/* Bytes waiting to be drained */
+	unsigned long msgs;	/* Messages that made it to the ring */
+	unsigned long dropped;	/* Messages dropped because the ring was full */
+	unsigned long truncated;/* Messages longer than LOG_MSG_MAX */
+};
+
+int log_init_hart(void);
+int log_printf(const char *fmt, ...) __attribute__((format(printf, 1, 2)));
+int log_vprintf(const char *fmt, va_list va);
+int log_drain(void);
+int log_get_stats(uint16_t hart_idx, struct log_stats *stats);
+
+#endif /* _LOG_H */
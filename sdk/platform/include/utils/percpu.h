@@ -0,0 +1,58 @@
+/*
+ * SPDX-FileType: SOURCE
+ *
+ * SPDX-FileCopyrightText: 2026 Nick Kossifidis <mick@ics.forth.gr>
+ * SPDX-FileCopyrightText: 2026 ICS/FORTH
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * Per-hart variables: anything defined with __percpu goes to the .percpu
+ * section (see bmbase.ld.tmpl), that's only a template, each hart gets its
+ * own copy of it during boot, right below its hart_state (so on its own
+ * cache lines and close to its stack), initialized from the template.
+ * Since mscratch points to hart_state, getting to this hart's copy of a
+ * variable is just an offset from mscratch:
+ *
+ *	static uint64_t __percpu num_events = 0;
+ *	...
+ *	(*this_cpu_ptr(&num_events))++;
+ *
+ * The template itself is on rom, so don't access a __percpu variable
+ * directly, always go through this_cpu_ptr() / per_cpu_ptr(). Note that
+ * the copies live in the stack slots, so they take space from the stack.
+ */
+
+#ifndef _PERCPU_H
+#define _PERCPU_H
+
+#include <stdint.h>			/* For typed integers */
+#include <platform/riscv/hart.h>	/* For hart_get_hstate_self/by_idx() */
+
+#define __percpu	__attribute__((section(".percpu")))
+
+/* Linker variable copies (see start.S) */
+extern uint64_t __percpu_start;
+extern uint64_t __percpu_size;
+
+/* A hart's copy of the .percpu section */
+static inline uintptr_t
+percpu_base(const struct hart_state *hs)
+{
+	return (uintptr_t) hs - __percpu_size;
+}
+
+static inline void *
+__per_cpu_ptr(const struct hart_state *hs, const void *ptr)
+{
+	return (void *)(percpu_base(hs) + ((uintptr_t) ptr - __percpu_start));
+}
+
+/* Pointer to the current / a given hart's copy of a __percpu variable */
+#define this_cpu_ptr(_ptr)	\
+	((__typeof__(_ptr)) __per_cpu_ptr(hart_get_hstate_self(), (_ptr)))
+#define per_cpu_ptr(_ptr, _hart_idx)	\
+	((__typeof__(_ptr)) __per_cpu_ptr(hart_get_hstate_by_idx(_hart_idx), (_ptr)))
+
+#endif /* _PERCPU_H */
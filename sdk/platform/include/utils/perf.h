@@ -0,0 +1,165 @@
+/*
+ * SPDX-FileType: SOURCE
+ *
+ * SPDX-FileCopyrightText: 2026 Nick Kossifidis <mick@ics.forth.gr>
+ * SPDX-FileCopyrightText: 2026 ICS/FORTH
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * Hardware performance counter groups. A group is a set of events counted
+ * together: "cycles" / "instret" come from mcycle / minstret, everything
+ * else is programmed on the mhpmcounters (mhpmevent3+) by its name on the
+ * target's PLAT_PERF_EVENTS table, or by its raw mhpmevent value through
+ * perf_group_add_raw(). Targets may also define named sets of events on
+ * PLAT_PERF_SETS, that can be used in place of event names (see
+ * target_template.h).
+ *
+ * A group can be started / stopped on any number of harts (each one runs
+ * at most one group at a time, on its own counters), on stop each hart adds
+ * what it counted to the group's totals, so e.g. a group started / stopped
+ * on every hart of a parallel loop ends up with the counts of all of them.
+ * The hpm counters of a group are started / stopped together with a single
+ * mcountinhibit write.
+ *
+ * With Sscofpmf there is also a sampling profiler, perf_prof_start() arms
+ * the hart's last hpm counter to overflow every period events, and the
+ * overflow interrupt records mepc on a per-hart table of PC -> hits, that
+ * perf_prof_top() / perf_prof_dump() sort by hits. Since interrupts are
+ * masked on trap handlers, samples that land there are attributed to
+ * where they return.
+ *
+ * With Smctr the hart can also record its last control transfers (taken
+ * branches, calls, returns, jumps, traps) on the CTR buffer (16 - 256
+ * entries), without any instrumentation: perf_ctr_start() / perf_ctr_stop()
+ * around a region and perf_ctr_read() to get what it recorded (the last
+ * depth transfers before stopping, oldest first), with the cycles since the
+ * previous record and the mispredict bit where the hart provides them. For
+ * finding hot paths, perf_ctr_edges_add() aggregates the records of many
+ * runs on a table of source -> target edges, that perf_ctr_edges_dump()
+ * prints hottest first.
+ */
+
+#ifndef _PERF_H
+#define _PERF_H
+
+#include <stdint.h>	/* For typed integers */
+#include <stdatomic.h>	/* For C11 atomics */
+#include <stdbool.h>	/* For bool */
+
+/* Max events per group, there are at most 29 hpm counters
+ * but most harts implement a handful of them. */
+#define PERF_MAX_EVENTS		8
+
+struct perf_event_desc {
+	const char *name;
+	uint64_t event;		/* mhpmevent value */
+};
+
+/* A set of events, by name (comma separated) */
+struct perf_event_set {
+	const char *name;
+	const char *events;
+};
+
+struct perf_group {
+	const char *names[PERF_MAX_EVENTS];
+	uint64_t events[PERF_MAX_EVENTS];
+	uint8_t counters[PERF_MAX_EVENTS];	/* 0 / 2 for cycles / instret, 3+ for hpm */
+	uint8_t num_events;
+	uint32_t hpm_mask;			/* mcountinhibit bits of our hpm counters */
+	/* Sum of what each hart counted between start / stop */
+	_Atomic(uint64_t) totals[PERF_MAX_EVENTS];
+	atomic_uint num_harts;			/* Harts that added to the totals */
+};
+
+int perf_group_init(struct perf_group *group, const char *events);
+int perf_group_add_raw(struct perf_group *group, const char *name, uint64_t event);
+int perf_group_start(struct perf_group *group);
+int perf_group_stop(struct perf_group *group);
+int perf_group_read(const struct perf_group *group, uint64_t *values);
+void perf_group_totals(struct perf_group *group, uint64_t *values);
+void perf_group_reset(struct perf_group *group);
+void perf_group_print(struct perf_group *group);
+int perf_event_lookup(const char *name, uint64_t *event);
+
+struct perf_prof_entry {
+	uintptr_t pc;
+	uint64_t hits;
+};
+
+int perf_prof_start(const char *event, uint64_t period);
+int perf_prof_stop(void);
+uint64_t perf_prof_samples(uint16_t hart_idx);
+int perf_prof_top(uint16_t hart_idx, struct perf_prof_entry *out, unsigned int num);
+void perf_prof_dump(uint16_t hart_idx, unsigned int num);
+void perf_prof_reset(uint16_t hart_idx);
+/* Called by the counter overflow interrupt handler in hart.c */
+void perf_prof_on_overflow(uintptr_t pc);
+
+/* Control transfer record types (ctrdata.TYPE) */
+enum perf_ctr_type {
+	PERF_CTR_TYPE_NONE = 0,
+	PERF_CTR_TYPE_EXC = 1,
+	PERF_CTR_TYPE_INTR = 2,
+	PERF_CTR_TYPE_TRET = 3,
+	PERF_CTR_TYPE_NTBR = 4,		/* Not taken branch */
+	PERF_CTR_TYPE_TKBR = 5,		/* Taken branch */
+	PERF_CTR_TYPE_INDCALL = 8,
+	PERF_CTR_TYPE_DIRCALL = 9,
+	PERF_CTR_TYPE_INDJMP = 10,
+	PERF_CTR_TYPE_DIRJMP = 11,
+	PERF_CTR_TYPE_CORSWAP = 12,	/* Co-routine swap */
+	PERF_CTR_TYPE_RET = 13,
+	PERF_CTR_TYPE_INDLJMP = 14,	/* Other indirect jump */
+	PERF_CTR_TYPE_DIRLJMP = 15,	/* Other direct jump */
+};
+
+/* What to record, for perf_ctr_start() */
+#define PERF_CTR_BRANCHES	(1U << 0)	/* Taken conditional branches */
+#define PERF_CTR_NOT_TAKEN	(1U << 1)	/* Not taken ones too */
+#define PERF_CTR_CALLS		(1U << 2)	/* Calls / returns / co-routine swaps */
+#define PERF_CTR_JUMPS		(1U << 3)	/* Other direct / indirect jumps */
+#define PERF_CTR_TRAPS		(1U << 4)	/* Exceptions / interrupts / trap returns */
+#define PERF_CTR_ALL		0x1F
+
+struct perf_ctr_record {
+	uintptr_t source;
+	uintptr_t target;
+	uint32_t cycles;	/* Since the previous record, 0 if unknown */
+	uint8_t type;		/* enum perf_ctr_type */
+	bool mispredicted;
+};
+
+/* An aggregated source -> target edge */
+struct perf_ctr_edge {
+	uintptr_t source;
+	uintptr_t target;
+	uint64_t hits;
+	uint64_t mispredicts;
+	uint64_t cycles;	/* Sum of the known cycles before taking it */
+	uint8_t type;
+};
+
+struct perf_ctr_edges {
+	struct perf_ctr_edge *slots;
+	unsigned int num_slots;		/* Power of two */
+	uint64_t records;
+	uint64_t dropped;		/* Records that didn't fit */
+};
+
+int perf_ctr_start(unsigned int what);
+int perf_ctr_stop(void);
+unsigned int perf_ctr_depth(void);
+int perf_ctr_read(struct perf_ctr_record *out, unsigned int num);
+void perf_ctr_dump(const struct perf_ctr_record *recs, unsigned int num);
+int perf_ctr_edges_init(struct perf_ctr_edges *edges, unsigned int num_slots);
+void perf_ctr_edges_free(struct perf_ctr_edges *edges);
+void perf_ctr_edges_add(struct perf_ctr_edges *edges, const struct perf_ctr_record *recs,
+			unsigned int num);
+int perf_ctr_edges_top(const struct perf_ctr_edges *edges, struct perf_ctr_edge *out,
+		       unsigned int num);
+void perf_ctr_edges_dump(const struct perf_ctr_edges *edges, unsigned int num);
+
+#endif /* _PERF_H */
@@ -19,6 +19,17 @@
 	#error "PLAT_HART_FREQ not defined"
 #endif
 
+/* start.S clears .bss in whole cbo.zero blocks */
+#if defined(PLAT_CBOZ_BLOCK_SIZE) && \
+    ((PLAT_CBOZ_BLOCK_SIZE < 8) || (PLAT_CBOZ_BLOCK_SIZE & (PLAT_CBOZ_BLOCK_SIZE - 1)))
+	#error "PLAT_CBOZ_BLOCK_SIZE must be a power of 2, at least 8"
+#endif
+
+/* How long the boot hart waits for secondary harts */
+#if !defined(PLAT_SMP_BOOT_TIMEOUT_US)
+	#define PLAT_SMP_BOOT_TIMEOUT_US	100000
+#endif
+
 /*
  * Note: ACLINT is backwards compatible with CLINT, basically
  * CLINT is MSWI + MTIMER, so we treat it like a specific
@@ -143,6 +154,26 @@
 	#define PLAT_BYPASS_IMSIC
 #endif
 
+#if !defined(PLAT_IRQ_DISPATCH_BUDGET)
+	#define PLAT_IRQ_DISPATCH_BUDGET 8
+#elif (PLAT_IRQ_DISPATCH_BUDGET < 1)
+	#undef PLAT_IRQ_DISPATCH_BUDGET
+	#define PLAT_IRQ_DISPATCH_BUDGET 1
+#endif
+
+/* Hand-written entries for the common timer / IPI cases (see hart_fast.S),
+ * define NO_FAST_TRAPS to always go through the C handlers, IRQ_STATS
+ * and TRAP_TRACE need them to see every interrupt. */
+#if !defined(NO_FAST_TRAPS) && !defined(IRQ_STATS) && !defined(TRAP_TRACE)
+	#if !defined(PLAT_NO_MTIMER)
+		#define HART_FAST_MTIMER
+	#endif
+	#if defined(PLAT_HAS_MSWI) && (PLAT_IMSIC_IPI_EIID == 0) && \
+	    !(defined(PLAT_IPI_FANOUT) && (PLAT_IPI_FANOUT > 1))
+		#define HART_FAST_MSWTRIG
+	#endif
+#endif
+
 /*******************\
 * PERIPHERAL CHECKS *
 \*******************/
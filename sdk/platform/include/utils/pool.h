@@ -0,0 +1,32 @@
+/*
+ * SPDX-FileType: SOURCE
+ *
+ * SPDX-FileCopyrightText: 2026 Nick Kossifidis <mick@ics.forth.gr>
+ * SPDX-FileCopyrightText: 2026 ICS/FORTH
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * Fixed-size object pools, for objects allocated at a high rate and
+ * passed between harts (e.g. message descriptors). Each hart keeps a
+ * local cache (magazine) of free objects, it can allocate / free its
+ * own objects without any atomics, and objects freed by another hart
+ * go back to their owner's magazine with a single atomic push, without
+ * going through malloc's lock. Pools shouldn't be used from interrupt
+ * handlers.
+ */
+
+#ifndef _POOL_H
+#define _POOL_H
+
+#include <stddef.h>	/* For size_t */
+
+struct pool;
+
+struct pool *pool_create(size_t obj_size, size_t count);
+void pool_destroy(struct pool *pool);
+void *pool_alloc(struct pool *pool);
+void pool_free(struct pool *pool, void *obj);
+
+#endif /* _POOL_H */
@@ -0,0 +1,60 @@
+/*
+ * SPDX-FileType: SOURCE
+ *
+ * SPDX-FileCopyrightText: 2026 Nick Kossifidis <mick@ics.forth.gr>
+ * SPDX-FileCopyrightText: 2026 ICS/FORTH
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * Lock-free ring queues of pointers, for passing messages between harts
+ * (e.g. between the stages of a pipeline). Depending on the flags given
+ * to ring_create() a ring may have one or many producers (RING_MP) and
+ * one or many consumers (RING_MC), the single producer / consumer sides
+ * skip the atomic read-modify-write operations. Objects are enqueued /
+ * dequeued in bursts, ring_enqueue_burst() / ring_dequeue_burst() move
+ * as many as fit / are there and return how many they moved.
+ *
+ * With ring_set_consumer() the producers send an IPI to the consumer
+ * hart when the ring goes from empty to non-empty, so that it can wait
+ * on wfi (see ring_wait()) instead of polling.
+ */
+
+#ifndef _RING_H
+#define _RING_H
+
+#include <stdint.h>	/* For typed integers */
+#include <errno.h>	/* For error codes */
+
+enum ring_flags {
+	RING_SPSC	= 0,
+	RING_MP		= (1 << 0),	/* Multiple producers */
+	RING_MC		= (1 << 1),	/* Multiple consumers */
+	RING_MPSC	= RING_MP,
+	RING_MPMC	= RING_MP | RING_MC,
+};
+
+struct ring;
+
+struct ring *ring_create(unsigned int size, unsigned int flags);
+void ring_destroy(struct ring *ring);
+void ring_set_consumer(struct ring *ring, int hart_idx);
+unsigned int ring_enqueue_burst(struct ring *ring, void * const *objs, unsigned int num);
+unsigned int ring_dequeue_burst(struct ring *ring, void **objs, unsigned int num);
+unsigned int ring_count(const struct ring *ring);
+void ring_wait(struct ring *ring);
+
+static inline int
+ring_enqueue(struct ring *ring, void *obj)
+{
+	return ring_enqueue_burst(ring, &obj, 1) ? 0 : -ENOBUFS;
+}
+
+static inline int
+ring_dequeue(struct ring *ring, void **obj)
+{
+	return ring_dequeue_burst(ring, obj, 1) ? 0 : -EAGAIN;
+}
+
+#endif /* _RING_H */
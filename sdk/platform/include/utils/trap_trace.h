@@ -0,0 +1,84 @@
+/*
+ * SPDX-FileType: SOURCE
+ *
+ * SPDX-FileCopyrightText: 2026 Nick Kossifidis <mick@ics.forth.gr>
+ * SPDX-FileCopyrightText: 2026 ICS/FORTH
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * Per-hart trap / event trace. When built with TRAP_TRACE, the trap
+ * handlers (exceptions, timer, IPI and external interrupts), the timer
+ * wheel's handlers and the IPI senders write a fixed-size binary record
+ * on their hart's ring (TRAP_TRACE_ENTRIES of them, the oldest ones get
+ * overwritten), with the mtime tick when it was written, what it was
+ * (event / source) and how many mcycle cycles it took. Since mtime is
+ * shared, trap_trace_dump() can merge the rings of all harts in a single
+ * timeline, e.g. to see what was going on around a latency spike.
+ *
+ * Only the hart itself writes on its ring (claiming a slot is a single
+ * atomic add, so a nested trap can't take the same one), dumping pauses
+ * recording on all harts while it reads them.
+ *
+ * Without TRAP_TRACE the hooks compile to nothing.
+ */
+
+#ifndef _TRAP_TRACE_H
+#define _TRAP_TRACE_H
+
+#include <stdint.h>	/* For typed integers */
+
+/* Per hart, power of two */
+#if !defined(TRAP_TRACE_ENTRIES)
+	#define TRAP_TRACE_ENTRIES	256
+#endif
+
+enum trap_trace_event {
+	TRAP_TRACE_NONE = 0,
+	TRAP_TRACE_EXC,		/* Exception, source: mcause, arg: mepc */
+	TRAP_TRACE_TIMER,	/* Timer interrupt, source: 0 mtimecmp / 1 stimecmp */
+	TRAP_TRACE_TIMER_FIRE,	/* Timer wheel event, arg: its handler */
+	TRAP_TRACE_IPI,		/* IPI, source: the ipi_type mask we got */
+	TRAP_TRACE_IPI_SEND,	/* Sent IPI, source: ipi_type, arg: target hart mask */
+	TRAP_TRACE_IRQ,		/* External interrupt, source: source_id, arg: its handler */
+	TRAP_TRACE_NUM_EVENTS
+};
+
+struct trap_trace_rec {
+	uint64_t time;		/* mtime ticks when it was recorded (its end) */
+	uint64_t arg;
+	uint32_t cycles;	/* Duration, 0 for instant events */
+	uint32_t source;
+	uint16_t event;
+	uint16_t hart_idx;
+	uint32_t reserved;
+};
+
+#if defined(TRAP_TRACE)
+
+#include <platform/riscv/csr.h>		/* For csr_read() */
+
+void trap_trace_init_hart(void);
+void trap_trace_record(uint16_t event, uint32_t source, uint64_t arg, uint64_t start);
+
+#define TRAP_TRACE_STAMP(_var)		const uint64_t _var = csr_read(CSR_MCYCLE)
+#define TRAP_TRACE_RECORD(_ev, _src, _arg, _var)	\
+	trap_trace_record((_ev), (uint32_t)(_src), (uint64_t)(uintptr_t)(_arg), (_var))
+#define TRAP_TRACE_EVENT(_ev, _src, _arg)	\
+	trap_trace_record((_ev), (uint32_t)(_src), (uint64_t)(uintptr_t)(_arg), 0)
+
+#else
+
+#define TRAP_TRACE_STAMP(_var)				do {} while (0)
+#define TRAP_TRACE_RECORD(_ev, _src, _arg, _var)	do {} while (0)
+#define TRAP_TRACE_EVENT(_ev, _src, _arg)		do {} while (0)
+
+#endif /* TRAP_TRACE */
+
+/* These return -ENOTSUP without TRAP_TRACE */
+int trap_trace_read(uint16_t hart_idx, struct trap_trace_rec *out, unsigned int num);
+int trap_trace_reset(void);
+int trap_trace_dump(unsigned int num);
+
+#endif /* _TRAP_TRACE_H */
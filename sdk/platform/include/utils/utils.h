@@ -41,8 +41,17 @@
 	#define WHITE	""
 #endif
 
+/* With LOG_RINGS messages go to per-hart rings instead (see log.h),
+ * except for errors that are usually followed by a hang / abort */
+#if defined(LOG_RINGS)
+	#include <platform/utils/log.h>	/* For log_printf() */
+	#define LOG_PRINTF	log_printf
+#else
+	#define LOG_PRINTF	printf
+#endif
+
 #if defined(DEBUG)
-	#define DBG(fmt, ...)	printf(MAGENTA fmt NORMAL, ##__VA_ARGS__)
+	#define DBG(fmt, ...)	LOG_PRINTF(MAGENTA fmt NORMAL, ##__VA_ARGS__)
 #else
 	/* Instead of defining an empty DBG, this will still check
 	*  printf() syntax/arguments even if it's not called. */
@@ -50,16 +59,30 @@
 #endif
 
 #if defined(NET_DEBUG)
-	#define DBG_NET(fmt, ...)	printf(BLUE fmt NORMAL, ##__VA_ARGS__)
+	#define DBG_NET(fmt, ...)	LOG_PRINTF(BLUE fmt NORMAL, ##__VA_ARGS__)
 #else
 	/* Instead of defining an empty DBG, this will still check
 	*  printf() syntax/arguments even if it's not called. */
 	#define DBG_NET(fmt, ...)	do { if (0) printf(fmt, ##__VA_ARGS__); } while(0)
 #endif
 
-#define INF(fmt, ...)	printf(CYAN fmt NORMAL, ##__VA_ARGS__)
-#define ANN(fmt, ...)	printf(GREEN fmt NORMAL, ##__VA_ARGS__)
-#define WRN(fmt, ...)	printf(BRIGHT YELLOW "Warning: " fmt NORMAL, ##__VA_ARGS__)
+#define INF(fmt, ...)	LOG_PRINTF(CYAN fmt NORMAL, ##__VA_ARGS__)
+#define ANN(fmt, ...)	LOG_PRINTF(GREEN fmt NORMAL, ##__VA_ARGS__)
+#define WRN(fmt, ...)	LOG_PRINTF(BRIGHT YELLOW "Warning: " fmt NORMAL, ##__VA_ARGS__)
 #define ERR(fmt, ...)	printf(BRIGHT RED "Error: " fmt NORMAL, ##__VA_ARGS__)
 
+
+/*************\
+* CODE LAYOUT *
+\*************/
+
+/* Hot code (trap / irq paths, locks, string ops) is packed together on its
+ * own cache lines at the start of .text, and cold code (probing, tests) goes
+ * to the end of it, see bmbase.ld.tmpl. We use the same sections as GCC does
+ * for hot / cold functions with -freorder-functions, so anything it finds on
+ * its own (e.g. functions only called from __cold ones, or the cold parts of
+ * split functions) ends up in the same groups. */
+#define __hot	__attribute__((hot, section(".text.hot")))
+#define __cold	__attribute__((cold, section(".text.unlikely")))
+
 #endif /* _UTILS_H */
\ No newline at end of file
@@ -95,4 +95,72 @@ __atomic_compare_exchange_4(volatile void *ptr, void *expected,
 	return false;
 }
 
+/* 64-bit atomics (pointers / size_t, e.g. in pool.c) */
+
+uint64_t
+__atomic_load_8(const volatile void *ptr, int memorder)
+{
+	(void)memorder;
+	__asm__ __volatile__("" ::: "memory");
+	uint64_t val = *(const volatile uint64_t *)ptr;
+	__asm__ __volatile__("" ::: "memory");
+	return val;
+}
+
+void
+__atomic_store_8(volatile void *ptr, uint64_t val, int memorder)
+{
+	(void)memorder;
+	__asm__ __volatile__("" ::: "memory");
+	*(volatile uint64_t *)ptr = val;
+	__asm__ __volatile__("" ::: "memory");
+}
+
+uint64_t
+__atomic_exchange_8(volatile void *ptr, uint64_t val, int memorder)
+{
+	(void)memorder;
+	__asm__ __volatile__("" ::: "memory");
+	uint64_t old = *(volatile uint64_t *)ptr;
+	*(volatile uint64_t *)ptr = val;
+	__asm__ __volatile__("" ::: "memory");
+	return old;
+}
+
+uint64_t
+__atomic_fetch_add_8(volatile void *ptr, uint64_t val, int memorder)
+{
+	(void)memorder;
+	__asm__ __volatile__("" ::: "memory");
+	uint64_t old = *(volatile uint64_t *)ptr;
+	*(volatile uint64_t *)ptr = old + val;
+	__asm__ __volatile__("" ::: "memory");
+	return old;
+}
+
+bool
+__atomic_compare_exchange_8(volatile void *ptr, void *expected,
+			   uint64_t desired, bool weak,
+			   int success_memorder, int failure_memorder)
+{
+	(void)weak;
+	(void)success_memorder;
+	(void)failure_memorder;
+
+	__asm__ __volatile__("" ::: "memory");
+
+	uint64_t old = *(volatile uint64_t *)ptr;
+	uint64_t exp = *(uint64_t *)expected;
+
+	if (old == exp) {
+		*(volatile uint64_t *)ptr = desired;
+		__asm__ __volatile__("" ::: "memory");
+		return true;
+	}
+
+	*(uint64_t *)expected = old;
+	__asm__ __volatile__("" ::: "memory");
+	return false;
+}
+
 #endif
@@ -0,0 +1,137 @@
+/*
+ * SPDX-FileType: SOURCE
+ *
+ * SPDX-FileCopyrightText: 2026 Nick Kossifidis <mick@ics.forth.gr>
+ * SPDX-FileCopyrightText: 2026 ICS/FORTH
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <target_config.h>		/* For PLAT_MAX_HARTS */
+#include <platform/utils/barrier.h>	/* For struct barrier / dissem_barrier */
+#include <platform/interfaces/ipi.h>	/* For ipi_send/send_mask() */
+#include <platform/riscv/hart.h>	/* For hart_get_hstate_self/count() */
+#include <platform/riscv/csr.h>		/* For wfi() / pause() */
+#include <platform/utils/lock.h>	/* For lock_wait_change() */
+#include <string.h>			/* For memset() */
+
+/*
+ * Both barriers only ever move their counters forward (the generation
+ * of the centralized one, and each node's flags of the dissemination
+ * one get the number of the episode they signal), so there's nothing
+ * to reset in between episodes, and a waiter is released once the word
+ * it waits on reaches its target, even if a fast hart already moved
+ * it further for the next episode.
+ */
+
+_Static_assert(PLAT_MAX_HARTS <= (1 << BARRIER_MAX_ROUNDS), "Too many harts for BARRIER_MAX_ROUNDS");
+
+static inline bool
+barrier_reached(unsigned int val, unsigned int target)
+{
+	return (int) (val - target) >= 0;
+}
+
+static void
+barrier_wait_until(atomic_uint *word, unsigned int target, uint8_t mode)
+{
+	unsigned int val;
+	while (!barrier_reached(val = atomic_load_explicit(word, memory_order_acquire), target)) {
+		if (mode == BARRIER_WAIT_WFI) {
+			/* With interrupts blocked the wakeup IPI can't get
+			 * consumed by the handler in between the check and
+			 * wfi, wfi still wakes up on it. */
+			const bool irqs_on = csr_read(CSR_MSTATUS) & CSR_MSTATUS_MIE;
+			hart_block_interrupts();
+			if (!barrier_reached(atomic_load_explicit(word, memory_order_relaxed), target))
+				wfi();
+			if (irqs_on)
+				hart_allow_interrupts();
+			continue;
+		}
+		/* Sleep until someone writes to word on Zawrs
+		 * (or for an implementation-defined time) */
+		lock_wait_change(word, val);
+	}
+}
+
+static inline hartmask_t
+barrier_others_mask(uint16_t num_harts, uint16_t self)
+{
+	const hartmask_t all = (num_harts >= 64) ? ~0ULL : (HARTMASK(num_harts) - 1);
+	return all & ~HARTMASK(self);
+}
+
+/*********************\
+* CENTRALIZED BARRIER *
+\*********************/
+
+void
+barrier_init(struct barrier *b, enum barrier_wait_mode mode)
+{
+	atomic_init(&b->count, 0);
+	atomic_init(&b->generation, 0);
+	b->num_harts = hart_get_count();
+	b->mode = (uint8_t) mode;
+}
+
+void
+barrier_wait(struct barrier *b)
+{
+	if (b->num_harts <= 1)
+		return;
+
+	/* We can't be here before the previous episode
+	 * is over, so this is the current one */
+	const unsigned int gen = atomic_load_explicit(&b->generation, memory_order_acquire);
+
+	if (atomic_fetch_add_explicit(&b->count, 1, memory_order_acq_rel) == b->num_harts - 1u) {
+		/* Last one in, reset the counter before letting
+		 * anyone through, for the next episode */
+		atomic_store_explicit(&b->count, 0, memory_order_relaxed);
+		atomic_store_explicit(&b->generation, gen + 1, memory_order_release);
+		if (b->mode == BARRIER_WAIT_WFI)
+			ipi_send_mask(barrier_others_mask(b->num_harts,
+					hart_get_hstate_self()->hart_idx), IPI_WAKEUP);
+		return;
+	}
+	barrier_wait_until(&b->generation, gen + 1, b->mode);
+}
+
+/***********************\
+* DISSEMINATION BARRIER *
+\***********************/
+
+/*
+ * On round r, hart i signals hart (i + 2^r) mod N and waits for a signal
+ * from hart (i - 2^r) mod N, after ceil(log2(N)) rounds every hart has
+ * (transitively) heard from everyone else. Each hart waits on its own
+ * node, so the only cache line transfers are the signals themselves.
+ */
+
+void
+dissem_barrier_init(struct dissem_barrier *b, enum barrier_wait_mode mode)
+{
+	memset(b->nodes, 0, sizeof(b->nodes));
+	b->num_harts = hart_get_count();
+	b->num_rounds = 0;
+	while ((1U << b->num_rounds) < b->num_harts)
+		b->num_rounds++;
+	b->mode = (uint8_t) mode;
+}
+
+void
+dissem_barrier_wait(struct dissem_barrier *b)
+{
+	const uint16_t self = hart_get_hstate_self()->hart_idx;
+	struct dissem_barrier_node *node = &b->nodes[self];
+	const unsigned int episode = ++node->episode;
+
+	for (int r = 0; r < b->num_rounds; r++) {
+		const uint16_t partner = (self + (1U << r)) % b->num_harts;
+		atomic_store_explicit(&b->nodes[partner].flags[r], episode, memory_order_release);
+		if (b->mode == BARRIER_WAIT_WFI)
+			ipi_send(hart_get_hstate_by_idx(partner), IPI_WAKEUP);
+		barrier_wait_until(&node->flags[r], episode, b->mode);
+	}
+}
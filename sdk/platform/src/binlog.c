@@ -0,0 +1,152 @@
+/*
+ * SPDX-FileType: SOURCE
+ *
+ * SPDX-FileCopyrightText: 2026 Nick Kossifidis <mick@ics.forth.gr>
+ * SPDX-FileCopyrightText: 2026 ICS/FORTH
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <target_config.h>		/* For PLAT_MAX_HARTS */
+#include <platform/riscv/hart.h>	/* For hart_get_hstate_self() */
+#include <platform/riscv/csr.h>		/* For csr_read() */
+#include <platform/utils/binlog.h>	/* For the binlog API */
+#include <stdatomic.h>			/* For C11 atomics */
+#include <stdint.h>			/* For typed integers */
+#include <stdio.h>			/* For printf() */
+#include <string.h>			/* For memcpy() */
+#include <errno.h>			/* For error codes */
+
+/*
+ * The ring is an array of records (a power of two of them), provided by
+ * the caller so that it can come from wherever it fits, e.g. page_alloc().
+ * Writers reserve a record by bumping seq, so any number of harts (or
+ * interrupt handlers) can log at the same time without a lock, and when
+ * the ring wraps around the oldest records get overwritten. A record's
+ * seq field is set to BINLOG_SEQ_BUSY while it's being filled, and to its
+ * sequence number when it's done, so that readers can tell records that
+ * were overwritten (or are still being written) while copying them out.
+ */
+
+#define BINLOG_SEQ_BUSY		(~(uint64_t)0)
+
+static struct binlog_record *binlog_ring = NULL;
+static uint64_t binlog_mask = 0;
+static atomic_uint_fast64_t binlog_next_seq = 0;
+
+/* Defined in the linker script, the format IDs are offsets from here */
+extern const char __binlog_fmts_start[];
+
+/* Passing a NULL buffer stops logging */
+int
+binlog_init(void *buff, size_t size)
+{
+	if (!buff) {
+		binlog_ring = NULL;
+		return 0;
+	}
+
+	size_t num_recs = size / sizeof(struct binlog_record);
+	if (!num_recs || ((uintptr_t) buff % sizeof(uint64_t)))
+		return -EINVAL;
+
+	/* Round down to a power of two */
+	while (num_recs & (num_recs - 1))
+		num_recs &= num_recs - 1;
+
+	struct binlog_record *ring = buff;
+	for (size_t i = 0; i < num_recs; i++)
+		ring[i].seq = BINLOG_SEQ_BUSY;
+
+	binlog_ring = NULL;
+	atomic_thread_fence(memory_order_release);
+	binlog_mask = num_recs - 1;
+	atomic_store_explicit(&binlog_next_seq, 0, memory_order_relaxed);
+	atomic_thread_fence(memory_order_release);
+	binlog_ring = ring;
+	return 0;
+}
+
+void
+binlog_write(const char *fmt, unsigned int nargs, const uint64_t *args)
+{
+	struct binlog_record *ring = binlog_ring;
+	if (!ring)
+		return;
+
+	uint64_t seq = atomic_fetch_add_explicit(&binlog_next_seq, 1, memory_order_relaxed);
+	struct binlog_record *rec = &ring[seq & binlog_mask];
+
+	/* Mark it busy before touching anything else, so that a
+	 * reader doesn't mix our words with the old record's */
+	__atomic_store_n(&rec->seq, BINLOG_SEQ_BUSY, __ATOMIC_RELAXED);
+	atomic_thread_fence(memory_order_release);
+
+	rec->fmt_id = (uint32_t)(fmt - __binlog_fmts_start);
+	#if (PLAT_MAX_HARTS > 1)
+		rec->hart_idx = hart_get_hstate_self()->hart_idx;
+	#else
+		rec->hart_idx = 0;
+	#endif
+	rec->nargs = (uint16_t) nargs;
+	rec->cycles = csr_read(CSR_MCYCLE);
+	for (unsigned int i = 0; i < nargs; i++)
+		rec->args[i] = args[i];
+
+	/* Release so that readers see the record when they see seq */
+	__atomic_store_n(&rec->seq, seq, __ATOMIC_RELEASE);
+}
+
+/* Number of records written so far (including overwritten ones) */
+uint64_t
+binlog_count(void)
+{
+	return atomic_load_explicit(&binlog_next_seq, memory_order_relaxed);
+}
+
+/* Copy out record seq, if it's still in the ring */
+int
+binlog_get(uint64_t seq, struct binlog_record *rec)
+{
+	struct binlog_record *ring = binlog_ring;
+	if (!rec)
+		return -EINVAL;
+	if (!ring)
+		return -ENODATA;
+	atomic_thread_fence(memory_order_acquire);
+
+	struct binlog_record *src = &ring[seq & binlog_mask];
+	if (__atomic_load_n(&src->seq, __ATOMIC_ACQUIRE) != seq)
+		return -ENOMSG;
+	memcpy(rec, src, sizeof(struct binlog_record));
+	/* Make sure nobody started overwriting it while we were copying */
+	atomic_thread_fence(memory_order_acquire);
+	if (__atomic_load_n(&src->seq, __ATOMIC_RELAXED) != seq)
+		return -ENOMSG;
+	rec->seq = seq;
+	return 0;
+}
+
+/* Send whatever is in the ring over the console, oldest record first,
+ * for tools/binlog_decode.py to pick up. */
+void
+binlog_dump(void)
+{
+	struct binlog_record rec;
+	uint64_t end = binlog_count();
+	uint64_t start = (end > binlog_mask + 1) ? end - (binlog_mask + 1) : 0;
+
+	if (!binlog_ring)
+		return;
+
+	printf("BINLOG 1 %lu %lu\n", start, end);
+	for (uint64_t seq = start; seq < end; seq++) {
+		if (binlog_get(seq, &rec) < 0)
+			continue;
+		printf("BL %lx %x %x %lx", rec.seq, rec.fmt_id, rec.hart_idx, rec.cycles);
+		for (int i = 0; i < rec.nargs && i < BINLOG_MAX_ARGS; i++)
+			printf(" %lx", rec.args[i]);
+		printf("\n");
+	}
+	printf("BINLOG END\n");
+}
@@ -0,0 +1,51 @@
+/*
+ * SPDX-FileType: SOURCE
+ *
+ * SPDX-FileCopyrightText: 2026 Nick Kossifidis <mick@ics.forth.gr>
+ * SPDX-FileCopyrightText: 2026 ICS/FORTH
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <target_config.h>		/* For PLAT_HART_FREQ */
+#include <platform/utils/boot_prof.h>	/* For enum boot_phase */
+#include <platform/utils/utils.h>	/* For console output */
+
+#define BOOT_PROF_US(_cycles)	((_cycles) * 1000000 / PLAT_HART_FREQ)
+
+/* Written by the boot hart only, start.S fills in the first two */
+uint64_t boot_prof_cycles[BOOT_PHASE_NUM] = { 0 };
+
+static const char *boot_prof_names[BOOT_PHASE_NUM] = {
+	[BOOT_PHASE_RESET] = "reset",
+	[BOOT_PHASE_DATA_BSS] = ".data / .bss",
+	[BOOT_PHASE_HART_INIT] = "hart setup (asm)",
+	[BOOT_PHASE_UART] = "uart_init",
+	[BOOT_PHASE_SMP] = "smp wait",
+	[BOOT_PHASE_IRQ] = "irq_init",
+	[BOOT_PHASE_HART_SETUP] = "fpu / vpu / counters",
+	[BOOT_PHASE_ISA_CAPS] = "isa caps probe",
+	[BOOT_PHASE_INTR] = "interrupts / timer",
+	[BOOT_PHASE_MAIN] = "up to main",
+};
+
+/* Print how many cycles each phase took, and the total from reset */
+void
+boot_prof_dump(void)
+{
+	const uint64_t start = boot_prof_cycles[BOOT_PHASE_RESET];
+	uint64_t prev = start;
+
+	INF("Boot phases (mcycle, from reset at %lu):\n", start);
+	for (int i = BOOT_PHASE_DATA_BSS; i < BOOT_PHASE_NUM; i++) {
+		const uint64_t now = boot_prof_cycles[i];
+		/* Not reached (e.g. custom platform_init()) */
+		if (!now)
+			continue;
+		INF("  %-22s %12lu cycles (%lu us)\n", boot_prof_names[i], now - prev,
+		    BOOT_PROF_US(now - prev));
+		prev = now;
+	}
+	INF("  %-22s %12lu cycles (%lu us)\n", "total", prev - start,
+	    BOOT_PROF_US(prev - start));
+}
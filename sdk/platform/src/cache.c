@@ -0,0 +1,77 @@
+/*
+ * SPDX-FileType: SOURCE
+ *
+ * SPDX-FileCopyrightText: 2026 Nick Kossifidis <mick@ics.forth.gr>
+ * SPDX-FileCopyrightText: 2026 ICS/FORTH
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <platform/riscv/cache.h>	/* For the cache_* prototypes */
+#include <platform/riscv/caps.h>	/* For struct rvcaps / CAP_ZICBOM */
+#include <stdint.h>			/* For uintptr_t */
+#include <errno.h>			/* For error codes */
+
+/* Set through __cache_set_caps() by hart_probe, 0 means no Zicbom */
+static size_t cbom_block_size = 0;
+
+void
+__cache_set_caps(const struct rvcaps *caps)
+{
+	if ((caps->z_caps & CAP_ZICBOM) && caps->cbom_block_shift)
+		cbom_block_size = 1UL << caps->cbom_block_shift;
+	else
+		cbom_block_size = 0;
+}
+
+size_t
+cache_get_block_size(void)
+{
+	return cbom_block_size;
+}
+
+/* The CMO spec treats cbo.* as stores for ordering purposes w.r.t.
+ * other memory accesses of this hart, but devices only see their
+ * effect once they reach memory, so we need a full fence (including
+ * I/O) on both sides to order them with the DMA setup / doorbell
+ * writes that follow, and with the stores / loads before them. Note
+ * that on M-mode the cbo.* instructions are always allowed, menvcfg
+ * only controls lower privilege modes. */
+#define CACHE_OP_RANGE(_op, _addr, _len)				\
+do {									\
+	size_t block_size = cbom_block_size;				\
+	if (!block_size)						\
+		return -ENOTSUP;					\
+	if (!(_addr))							\
+		return -EINVAL;						\
+	uintptr_t start = (uintptr_t)(_addr) & ~(block_size - 1);	\
+	uintptr_t end = (uintptr_t)(_addr) + (_len);			\
+	__asm__ __volatile__("fence iorw, iorw" : : : "memory");	\
+	for (uintptr_t blk = start; blk < end; blk += block_size)	\
+		__asm__ __volatile__(					\
+			".option push\n"				\
+			".option arch, +zicbom\n"			\
+			_op " (%0)\n"					\
+			".option pop\n"					\
+			: : "r"(blk) : "memory");			\
+	__asm__ __volatile__("fence iorw, iorw" : : : "memory");	\
+	return 0;							\
+} while (0)
+
+int
+cache_clean_range(const void *addr, size_t len)
+{
+	CACHE_OP_RANGE("cbo.clean", addr, len);
+}
+
+int
+cache_inval_range(void *addr, size_t len)
+{
+	CACHE_OP_RANGE("cbo.inval", addr, len);
+}
+
+int
+cache_flush_range(void *addr, size_t len)
+{
+	CACHE_OP_RANGE("cbo.flush", addr, len);
+}
@@ -0,0 +1,369 @@
+/*
+ * SPDX-FileType: SOURCE
+ *
+ * SPDX-FileCopyrightText: 2026 Nick Kossifidis <mick@ics.forth.gr>
+ * SPDX-FileCopyrightText: 2026 ICS/FORTH
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <platform/utils/crc.h>		/* For crc32() / crc32c() / hash64() */
+#include <platform/riscv/caps.h>	/* For struct rvcaps / CAP_ZBKC */
+#include <stdbool.h>			/* For bool */
+#include <stdlib.h>			/* For malloc() */
+#include <string.h>			/* For memcpy() */
+
+/*********\
+* Helpers *
+\*********/
+
+static inline uint64_t
+crc_load_le64(const uint8_t *p)
+{
+	uint64_t val;
+	memcpy(&val, p, sizeof(val));
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+	val = __builtin_bswap64(val);
+#endif
+	return val;
+}
+
+static inline uint64_t
+crc_load_le32(const uint8_t *p)
+{
+	uint32_t val;
+	memcpy(&val, p, sizeof(val));
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+	val = __builtin_bswap32(val);
+#endif
+	return val;
+}
+
+
+/**************\
+* CRC variants *
+\**************/
+
+/*
+ * Both are reflected, so bit i of a word is the coefficient of x^(31 - i)
+ * (or x^(63 - i) for 64bit words), and the first byte of the message holds
+ * the highest ones. The Barrett constant is floor(x^96 / P) without its
+ * x^64 term, reflected as a 64bit word.
+ */
+enum crc_variant_idx {
+	CRC_IDX_32 = 0,
+	CRC_IDX_32C,
+	CRC_NUM_VARIANTS
+};
+
+struct crc_variant {
+	uint32_t poly;		/* Without its x^32 term */
+	uint64_t barrett;
+};
+
+static const struct crc_variant crc_variants[CRC_NUM_VARIANTS] = {
+	[CRC_IDX_32] = { .poly = 0xEDB88320, .barrett = 0x5A72D812FB808B20ULL },
+	[CRC_IDX_32C] = { .poly = 0x82F63B78, .barrett = 0xA434F61C6F5389F8ULL },
+};
+
+/* Slicing-by-8 tables, table[0] is the usual byte-at-a-time one and
+ * table[k][i] is the CRC of byte i followed by k zero bytes. They're
+ * 16KB so they go on the heap (see the README about .data / .bss). */
+typedef uint32_t crc_table_t[8][256];
+static crc_table_t *crc_tables = NULL;
+
+/* Set through __crc_set_caps() by hart_probe, like string.c
+ * we may as well use clmul from the start if the compiler
+ * already targets it. */
+#if (__riscv_xlen == 64)
+#if defined(__riscv_zbc) || defined(__riscv_zbkc)
+static bool crc_use_clmul = true;
+#else
+static bool crc_use_clmul = false;
+#endif
+#endif
+
+static uint32_t
+crc_bitwise(const struct crc_variant *cv, uint32_t crc, const uint8_t *p, size_t len)
+{
+	while (len--) {
+		crc ^= *p++;
+		for (int i = 0; i < 8; i++)
+			crc = (crc >> 1) ^ (cv->poly & -(crc & 1));
+	}
+	return crc;
+}
+
+static void
+crc_build_tables(crc_table_t *tables)
+{
+	for (int v = 0; v < CRC_NUM_VARIANTS; v++) {
+		uint32_t (*table)[256] = tables[v];
+		for (int i = 0; i < 256; i++) {
+			const uint8_t byte = (uint8_t) i;
+			table[0][i] = crc_bitwise(&crc_variants[v], 0, &byte, 1);
+		}
+		for (int k = 1; k < 8; k++)
+			for (int i = 0; i < 256; i++)
+				table[k][i] = (table[k - 1][i] >> 8) ^
+					      table[0][table[k - 1][i] & 0xFF];
+	}
+}
+
+/* All harts are assumed to be the same, so the boot hart's probe
+ * covers them all. The tables are also used for the unaligned head /
+ * tail of the clmul path, so build them in any case. */
+void
+__crc_set_caps(const struct rvcaps *caps)
+{
+#if (__riscv_xlen == 64)
+	crc_use_clmul = (caps->z_caps & CAP_ZBKC) != 0;
+#else
+	(void) caps;
+#endif
+	if (crc_tables)
+		return;
+
+	/* Without them we just stay on crc_bitwise() */
+	crc_table_t *tables = malloc(CRC_NUM_VARIANTS * sizeof(crc_table_t));
+	if (!tables)
+		return;
+	crc_build_tables(tables);
+	crc_tables = tables;
+}
+
+
+/*******************\
+* Slicing-by-8 CRCs *
+\*******************/
+
+static inline uint32_t
+crc_bytes(const uint32_t (*table)[256], uint32_t crc, const uint8_t *p, size_t len)
+{
+	while (len--)
+		crc = table[0][(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+	return crc;
+}
+
+static uint32_t
+crc_slice8(const uint32_t (*table)[256], uint32_t crc, const uint8_t *p, size_t len)
+{
+	const size_t head = (-(uintptr_t) p) & 7;
+	if (len < head)
+		return crc_bytes(table, crc, p, len);
+	crc = crc_bytes(table, crc, p, head);
+	p += head;
+	len -= head;
+
+	for (; len >= 8; p += 8, len -= 8) {
+		const uint64_t val = crc_load_le64(p) ^ crc;
+		crc = table[7][val & 0xFF] ^
+		      table[6][(val >> 8) & 0xFF] ^
+		      table[5][(val >> 16) & 0xFF] ^
+		      table[4][(val >> 24) & 0xFF] ^
+		      table[3][(val >> 32) & 0xFF] ^
+		      table[2][(val >> 40) & 0xFF] ^
+		      table[1][(val >> 48) & 0xFF] ^
+		      table[0][val >> 56];
+	}
+
+	return crc_bytes(table, crc, p, len);
+}
+
+
+/********************************\
+* Carry-less multiplication CRCs *
+\********************************/
+
+#if (__riscv_xlen == 64)
+
+/* Same approach as string.c with Zbb, use ".option arch" so that the
+ * rv64gc build can use clmul / clmulh on harts that have them. Zbkc
+ * has both, so it's enough for harts with either of Zbc / Zbkc. */
+static inline uint64_t
+crc_clmul(uint64_t a, uint64_t b)
+{
+	uint64_t res;
+	__asm__ (".option push\n"
+		 ".option arch, +zbkc\n"
+		 "clmul %0, %1, %2\n"
+		 ".option pop\n"
+		 : "=r"(res) : "r"(a), "r"(b));
+	return res;
+}
+
+static inline uint64_t
+crc_clmulh(uint64_t a, uint64_t b)
+{
+	uint64_t res;
+	__asm__ (".option push\n"
+		 ".option arch, +zbkc\n"
+		 "clmulh %0, %1, %2\n"
+		 ".option pop\n"
+		 : "=r"(res) : "r"(a), "r"(b));
+	return res;
+}
+
+/*
+ * For each word, with the CRC xored in, we need (M * x^32) mod P where M is
+ * the word's polynomial. With mu = floor(x^96 / P) = x^64 + mu', Barrett gives
+ * us the quotient q = M + floor(M * mu' / x^64) and the remainder as the low
+ * 32 bits of q * P (without its x^32 term that only affects the high bits).
+ * On reflected words the product of clmul / clmulh comes out one bit short
+ * of the 128bit reflected product, hence the shifts.
+ */
+static uint32_t
+crc_clmul_words(const struct crc_variant *cv, const uint32_t (*table)[256],
+		uint32_t crc, const uint8_t *p, size_t len)
+{
+	const size_t head = (-(uintptr_t) p) & 7;
+	if (len < head)
+		return crc_bytes(table, crc, p, len);
+	crc = crc_bytes(table, crc, p, head);
+	p += head;
+	len -= head;
+
+	const uint64_t poly = (uint64_t) cv->poly << 32;
+	for (; len >= 8; p += 8, len -= 8) {
+		const uint64_t val = crc_load_le64(p) ^ crc;
+		const uint64_t quot = val ^ (crc_clmul(val, cv->barrett) << 1);
+		crc = (uint32_t) (crc_clmulh(quot, poly) >> 31);
+	}
+
+	return crc_bytes(table, crc, p, len);
+}
+
+#endif
+
+
+/**************\
+* Entry points *
+\**************/
+
+static uint32_t
+crc_update(enum crc_variant_idx idx, uint32_t crc, const void *buf, size_t len)
+{
+	const struct crc_variant *cv = &crc_variants[idx];
+	const uint8_t *p = buf;
+
+	if (!crc_tables)
+		return ~crc_bitwise(cv, ~crc, p, len);
+
+	const uint32_t (*table)[256] = (const uint32_t (*)[256]) crc_tables[idx];
+#if (__riscv_xlen == 64)
+	if (crc_use_clmul)
+		return ~crc_clmul_words(cv, table, ~crc, p, len);
+#endif
+	return ~crc_slice8(table, ~crc, p, len);
+}
+
+uint32_t
+crc32(uint32_t crc, const void *buf, size_t len)
+{
+	return crc_update(CRC_IDX_32, crc, buf, len);
+}
+
+uint32_t
+crc32c(uint32_t crc, const void *buf, size_t len)
+{
+	return crc_update(CRC_IDX_32C, crc, buf, len);
+}
+
+
+/*********\
+* Hashing *
+\*********/
+
+/*
+ * wyhash (final version 4, by Wang Yi, released to the public domain), it
+ * mixes 48 bytes per round in three independent lanes, each folding a 64x64
+ * multiplication's high and low halves together. The secret is the default
+ * one.
+ */
+static const uint64_t hash_secret[4] = {
+	0x2d358dccaa6c78a5ULL, 0x8bb84b93962eacc9ULL,
+	0x4b33a62ed433d4a3ULL, 0x4d5a2da51de1aa47ULL
+};
+
+static inline void
+hash_mum(uint64_t *a, uint64_t *b)
+{
+#if (__riscv_xlen == 64)
+	const __uint128_t res = (__uint128_t) *a * *b;
+	*a = (uint64_t) res;
+	*b = (uint64_t) (res >> 64);
+#else
+	const uint64_t ha = *a >> 32, la = (uint32_t) *a;
+	const uint64_t hb = *b >> 32, lb = (uint32_t) *b;
+	const uint64_t rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+	const uint64_t t = rl + (rm0 << 32);
+	uint64_t lo = t + (rm1 << 32);
+	uint64_t hi = rh + (rm0 >> 32) + (rm1 >> 32) + (t < rl) + (lo < t);
+	*a = lo;
+	*b = hi;
+#endif
+}
+
+static inline uint64_t
+hash_mix(uint64_t a, uint64_t b)
+{
+	hash_mum(&a, &b);
+	return a ^ b;
+}
+
+/* 1 - 3 bytes, first / middle / last */
+static inline uint64_t
+hash_load3(const uint8_t *p, size_t len)
+{
+	return ((uint64_t) p[0] << 16) | ((uint64_t) p[len >> 1] << 8) | p[len - 1];
+}
+
+uint64_t
+hash64(const void *buf, size_t len, uint64_t seed)
+{
+	const uint8_t *p = buf;
+	uint64_t a, b;
+
+	seed ^= hash_mix(seed ^ hash_secret[0], hash_secret[1]);
+	if (len <= 16) {
+		if (len >= 4) {
+			const size_t mid = (len >> 3) << 2;
+			a = (crc_load_le32(p) << 32) | crc_load_le32(p + mid);
+			b = (crc_load_le32(p + len - 4) << 32) | crc_load_le32(p + len - 4 - mid);
+		} else if (len > 0) {
+			a = hash_load3(p, len);
+			b = 0;
+		} else
+			a = b = 0;
+	} else {
+		size_t left = len;
+		if (left >= 48) {
+			uint64_t seed1 = seed, seed2 = seed;
+			do {
+				seed = hash_mix(crc_load_le64(p) ^ hash_secret[1],
+						crc_load_le64(p + 8) ^ seed);
+				seed1 = hash_mix(crc_load_le64(p + 16) ^ hash_secret[2],
+						 crc_load_le64(p + 24) ^ seed1);
+				seed2 = hash_mix(crc_load_le64(p + 32) ^ hash_secret[3],
+						 crc_load_le64(p + 40) ^ seed2);
+				p += 48;
+				left -= 48;
+			} while (left >= 48);
+			seed ^= seed1 ^ seed2;
+		}
+		while (left > 16) {
+			seed = hash_mix(crc_load_le64(p) ^ hash_secret[1],
+					crc_load_le64(p + 8) ^ seed);
+			p += 16;
+			left -= 16;
+		}
+		/* The last 16 bytes, may overlap with the ones above */
+		a = crc_load_le64(p + left - 16);
+		b = crc_load_le64(p + left - 8);
+	}
+
+	a ^= hash_secret[1];
+	b ^= seed;
+	hash_mum(&a, &b);
+	return hash_mix(a ^ hash_secret[0] ^ len, b ^ hash_secret[1]);
+}
@@ -0,0 +1,252 @@
+/*
+ * SPDX-FileType: SOURCE
+ *
+ * SPDX-FileCopyrightText: 2026 Nick Kossifidis <mick@ics.forth.gr>
+ * SPDX-FileCopyrightText: 2026 ICS/FORTH
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <platform/utils/devq.h>	/* For the devq API */
+#include <platform/riscv/hart.h>	/* For hart_block/allow_interrupts() */
+#include <platform/riscv/csr.h>		/* For csr_read() / pause() */
+#include <errno.h>			/* For error codes */
+
+/*********\
+* Helpers *
+\*********/
+
+/* Completions may be run from the interrupt handler, so block interrupts
+ * while holding the lock, or the handler may spin on it forever */
+static inline bool
+devq_lock_acquire(struct devq *q)
+{
+	const bool irqs_on = csr_read(CSR_MSTATUS) & CSR_MSTATUS_MIE;
+	hart_block_interrupts();
+	sdk_lock_acquire(&q->lock);
+	return irqs_on;
+}
+
+static inline void
+devq_lock_release(struct devq *q, bool irqs_on)
+{
+	sdk_lock_release(&q->lock);
+	if (irqs_on)
+		hart_allow_interrupts();
+}
+
+/* Called with the lock held, returns true if the interrupt was
+ * turned on and completions may have been missed */
+static bool
+devq_irq_ctl(struct devq *q, bool on)
+{
+	if (q->irq_on == on)
+		return false;
+	q->irq_on = on;
+	if (!on) {
+		q->ops->irq_ctl(q, false);
+		return false;
+	}
+	return !q->ops->irq_ctl(q, true);
+}
+
+/* Called with the lock held at the end of a dev_poll() in adaptive mode,
+ * a poll that hit its budget means there's more work, so that one
+ * doesn't count as idle */
+static bool
+devq_adapt_poll(struct devq *q, int reaped, bool exhausted)
+{
+	q->polled = true;
+	if (reaped || exhausted) {
+		q->idle_count = 0;
+		return false;
+	}
+	if (q->irq_on || ++q->idle_count < q->idle_polls)
+		return false;
+
+	q->idle_count = 0;
+	q->stats.to_irq++;
+	return devq_irq_ctl(q, true);
+}
+
+/* Called with the lock held at the end of a dev_irq() in adaptive mode,
+ * only switch to polling if someone's actually polling, else nobody
+ * would pick up the next completions */
+static void
+devq_adapt_irq(struct devq *q, int reaped)
+{
+	if (q->irq_on && q->polled && reaped >= q->busy_thresh) {
+		q->idle_count = 0;
+		q->stats.to_poll++;
+		devq_irq_ctl(q, false);
+	}
+	q->polled = false;
+}
+
+/* Grab completed requests in batches of up to DEVQ_BATCH, and run their
+ * completions outside the lock, until there are none left or budget
+ * (if > 0) is reached. Returns the number of requests completed. */
+static int
+devq_run(struct devq *q, int budget, bool from_irq)
+{
+	void *reqs[DEVQ_BATCH];
+	int count = 0;
+	bool more = true;
+
+	while (more) {
+		int max = DEVQ_BATCH;
+		if (budget > 0 && budget - count < max)
+			max = budget - count;
+
+		bool irqs_on = devq_lock_acquire(q);
+		const int num = q->ops->reap(q, reqs, max);
+		q->inflight -= num;
+		q->stats.completed += num;
+		more = (num == max) && (budget <= 0 || count + num < budget);
+		if (!more) {
+			const bool exhausted = (budget > 0 && count + num == budget);
+			if (from_irq) {
+				q->stats.irqs++;
+				if (q->mode == DEVQ_MODE_ADAPTIVE)
+					devq_adapt_irq(q, count + num);
+			} else {
+				q->stats.polls++;
+				if (!count && !num)
+					q->stats.empty_polls++;
+				if (q->mode == DEVQ_MODE_ADAPTIVE)
+					more = devq_adapt_poll(q, count + num, exhausted);
+			}
+		}
+		devq_lock_release(q, irqs_on);
+
+		/* Outside the lock, completions may submit more */
+		for (int i = 0; i < num; i++)
+			q->ops->complete(q, reqs[i]);
+		count += num;
+	}
+	return count;
+}
+
+/**************\
+* Entry points *
+\**************/
+
+/* Starts in DEVQ_MODE_POLL, the driver should keep the device's
+ * interrupt off until dev_set_mode() */
+void
+devq_init(struct devq *q, const struct devq_ops *ops, void *priv)
+{
+	*q = (struct devq) {
+		.ops = ops,
+		.priv = priv,
+		.lock = SDK_LOCK_INIT,
+		.mode = DEVQ_MODE_POLL,
+		.busy_thresh = DEVQ_BUSY_THRESH,
+		.idle_polls = DEVQ_IDLE_POLLS,
+	};
+}
+
+/* Adaptive mode starts on interrupts */
+int
+dev_set_mode(struct devq *q, enum devq_mode mode)
+{
+	if (mode != DEVQ_MODE_POLL && mode != DEVQ_MODE_IRQ &&
+	    mode != DEVQ_MODE_ADAPTIVE)
+		return -EINVAL;
+	if (mode != DEVQ_MODE_POLL && !q->ops->irq_ctl)
+		return -ENOTSUP;
+
+	bool irqs_on = devq_lock_acquire(q);
+	q->mode = mode;
+	q->idle_count = 0;
+	q->polled = false;
+	bool missed = devq_irq_ctl(q, mode != DEVQ_MODE_POLL);
+	devq_lock_release(q, irqs_on);
+
+	/* Anything that completed before won't trigger an interrupt */
+	if (missed)
+		devq_run(q, 0, false);
+	return 0;
+}
+
+/* Returns -EAGAIN if the device's queue is full, on success the
+ * request belongs to the driver until it's completed */
+int
+dev_submit(struct devq *q, void *req)
+{
+	bool irqs_on = devq_lock_acquire(q);
+	int ret = q->ops->submit(q, req);
+	if (ret == 0) {
+		q->inflight++;
+		q->stats.submitted++;
+		if (q->ops->kick)
+			q->ops->kick(q);
+	}
+	devq_lock_release(q, irqs_on);
+	return ret;
+}
+
+/* Queue as many of the requests as fit, with a single notification,
+ * returns how many were queued (or the error if none were) */
+int
+dev_submit_batch(struct devq *q, void * const *reqs, int num)
+{
+	int ret = 0;
+	int count = 0;
+
+	bool irqs_on = devq_lock_acquire(q);
+	for (; count < num; count++) {
+		ret = q->ops->submit(q, reqs[count]);
+		if (ret < 0)
+			break;
+	}
+	q->inflight += count;
+	q->stats.submitted += count;
+	if (count && q->ops->kick)
+		q->ops->kick(q);
+	devq_lock_release(q, irqs_on);
+
+	return (count || !num) ? count : ret;
+}
+
+/* Run completions for up to budget requests (no limit if <= 0),
+ * returns the number of requests completed */
+int
+dev_poll(struct devq *q, int budget)
+{
+	return devq_run(q, budget, false);
+}
+
+/* Wait for a request's status (as updated by the driver's complete())
+ * to change from -EBUSY, polling unless it's up to the interrupt
+ * handler, returns the final status */
+int
+dev_wait(struct devq *q, const volatile int *status)
+{
+	while (*status == -EBUSY) {
+		if (q->mode != DEVQ_MODE_IRQ)
+			dev_poll(q, 0);
+		pause();
+	}
+	return *status;
+}
+
+/* For the driver's interrupt handler */
+void
+dev_irq(struct devq *q)
+{
+	if (q->ops->ack_irq) {
+		bool irqs_on = devq_lock_acquire(q);
+		q->ops->ack_irq(q);
+		devq_lock_release(q, irqs_on);
+	}
+	devq_run(q, 0, true);
+}
+
+void
+dev_get_stats(struct devq *q, struct devq_stats *stats)
+{
+	bool irqs_on = devq_lock_acquire(q);
+	*stats = q->stats;
+	devq_lock_release(q, irqs_on);
+}
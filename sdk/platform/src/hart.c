@@ -9,13 +9,19 @@
 
 #include <target_config.h>		/* For PLAT_* constants */
 #include <platform/interfaces/ipi.h>	/* For ipi_clear/self/send() */
-#include <platform/interfaces/irq.h>	/* For irq_dispatch() */
+#include <platform/interfaces/irq.h>	/* For irq_dispatch/set_trap_return/work_*() */
 #include <platform/riscv/csr.h>		/* For CSR numbers and ops */
 #include <platform/riscv/hart.h>	/* For hart_state and definitions */
 #include <platform/riscv/mtimer.h>	/* For mtimer_disarm() */
 #include <platform/utils/utils.h>	/* For console output */
+#include <platform/utils/percpu.h>	/* For __percpu / this_cpu_ptr() */
+#include <platform/utils/irq_stats.h>	/* For IRQ_STATS_* hooks */
+#include <platform/utils/trap_trace.h>	/* For TRAP_TRACE_* hooks */
+#include <platform/utils/boot_prof.h>	/* For boot_prof_mark() */
+#include <platform/utils/log.h>		/* For log_init_hart() */
 #include <platform/riscv/caps.h>	/* For CAP_* macros */
 #include <platform/interfaces/rng.h>	/* For rng_get_seed() */
+#include <platform/utils/perf.h>	/* For perf_prof_on_overflow() */
 
 #include <errno.h>			/* For errno and error constants */
 
@@ -32,14 +38,15 @@
  * become part of the direct trap handler. Weak handlers are functions called by
  * trap handlers that applications can override. Since trap handlers are not
  * called from other functions, we need to declare them as used otherwise LTO
- * and / or --gc-sections may throw them away.
+ * and / or --gc-sections may throw them away. They go to .text.trap_handlers,
+ * that the linker script packs together with the rest of the hot code.
  */
 #define __weak_handler	__attribute__((weak))
 #if (PLAT_HART_VECTORED_TRAPS == 1)
 	#define __trap_handler	static __attribute__((used, interrupt("machine"), optimize("align-functions=8"), section(".text.trap_handlers")))
 #else
 	#define __trap_handler	static inline
-	#define __direct_trap_handler static __attribute__((used, interrupt("machine"), optimize("align-functions=8")))
+	#define __direct_trap_handler static __attribute__((used, interrupt("machine"), optimize("align-functions=8"), section(".text.trap_handlers")))
 #endif
 #define __empty_trap_handler	__trap_handler __attribute__((alias("hart_default_trap_handler")))
 
@@ -64,6 +71,118 @@ void __empty_trap_handler hart_handle_supervisor_swtrig(void);
 void __empty_trap_handler hart_handle_guest_swtrig(void);
 
 #ifndef PLAT_NO_IPI
+/*
+ * Each hart has a mailbox for IPIs that carry arguments, a bounded
+ * lock-free MPSC queue, so that any number of harts can send messages
+ * to the same hart back to back, without waiting for it to consume
+ * the previous ones, and without overwriting each other's arguments.
+ * Senders claim a slot by bumping tail, fill it in and then publish it
+ * through the slot's turn counter. The target hart is the only consumer,
+ * it drains its mailbox from the IPI handler.
+ *
+ * For slot i, turn is 2 * lap when it's free for the lap-th message that
+ * maps to it (position lap * HART_MBOX_SLOTS + i), and 2 * lap + 1 once
+ * that message is there, so a zeroed mailbox is an empty one. Mailboxes
+ * are per-hart data (see percpu.h), set up along with hart_state when
+ * the hart boots.
+ */
+#define HART_MBOX_SLOTS	8
+
+struct hart_msg {
+	_Atomic(uint64_t) turn;
+	uint16_t type;
+	uintptr_t addr;
+	struct next_params params;
+};
+
+struct hart_mbox {
+	struct hart_msg slots[HART_MBOX_SLOTS];
+	_Atomic(uint64_t) tail;
+	uint64_t head;
+	/* Arguments of the last wakeup with addr, for hart_jump_with_args */
+	struct next_params jump_params;
+};
+
+static struct hart_mbox hart_mbox __percpu = { 0 };
+
+static inline uint64_t
+hart_mbox_turn(uint64_t pos)
+{
+	return 2 * (pos / HART_MBOX_SLOTS);
+}
+
+/* Post a message to hs (without sending it the IPI), if its
+ * mailbox is full wait for it to make room, unless it's us. */
+static int
+hart_mbox_post(struct hart_state *hs, enum ipi_type type, uintptr_t addr,
+	       const struct next_params *params)
+{
+	struct hart_mbox *mbox = per_cpu_ptr(&hart_mbox, hs->hart_idx);
+	const bool self = (hs == hart_get_hstate_self());
+	uint64_t pos = atomic_load_explicit(&mbox->tail, memory_order_relaxed);
+	struct hart_msg *msg = NULL;
+
+	while (1 == 1) {
+		msg = &mbox->slots[pos % HART_MBOX_SLOTS];
+		const uint64_t turn = atomic_load_explicit(&msg->turn, memory_order_acquire);
+		const int64_t diff = (int64_t) (turn - hart_mbox_turn(pos));
+		if (diff == 0) {
+			if (atomic_compare_exchange_weak_explicit(&mbox->tail, &pos, pos + 1,
+								  memory_order_relaxed,
+								  memory_order_relaxed))
+				break;
+		} else if (diff < 0) {
+			/* Still holds the previous lap's message */
+			if (self) {
+				ERR("Mailbox of hart %i is full\n", hs->hart_idx);
+				return -EAGAIN;
+			}
+			pause();
+			pos = atomic_load_explicit(&mbox->tail, memory_order_relaxed);
+		} else
+			pos = atomic_load_explicit(&mbox->tail, memory_order_relaxed);
+	}
+
+	msg->type = (uint16_t) type;
+	msg->addr = addr;
+	msg->params = *params;
+	atomic_store_explicit(&msg->turn, hart_mbox_turn(pos) + 1, memory_order_release);
+	return 0;
+}
+
+static int
+hart_mbox_send(struct hart_state *hs, enum ipi_type type, uintptr_t addr,
+	       const struct next_params *params)
+{
+	int ret = hart_mbox_post(hs, type, addr, params);
+	if (ret < 0)
+		return ret;
+	if (hs == hart_get_hstate_self())
+		ipi_self(type);
+	else
+		ipi_send(hs, type);
+	return 0;
+}
+
+/* Only called by the mailbox owner */
+static bool
+hart_mbox_get(struct hart_state *hs, struct hart_msg *out)
+{
+	struct hart_mbox *mbox = per_cpu_ptr(&hart_mbox, hs->hart_idx);
+	struct hart_msg *msg = &mbox->slots[mbox->head % HART_MBOX_SLOTS];
+	const uint64_t turn = hart_mbox_turn(mbox->head);
+
+	if (atomic_load_explicit(&msg->turn, memory_order_acquire) != turn + 1)
+		return false;
+	out->type = msg->type;
+	out->addr = msg->addr;
+	out->params = msg->params;
+	/* Free for the next lap */
+	atomic_store_explicit(&msg->turn, turn + 2, memory_order_release);
+	mbox->head++;
+	return true;
+}
+
 static void __attribute__((noreturn))
 hart_jump_with_args(void)
 {
@@ -100,6 +219,11 @@ hart_jump_with_args(void)
 	__asm__ __volatile__("fence.i");
 	__asm__ __volatile__("fence");
 
+	/* Mark ourselves busy until the payload calls hart_idle(),
+	 * if we were in the worker pool we just left it. */
+	hart_clear_flags(hs, HS_FLAG_POOL);
+	hart_set_flags(hs, HS_FLAG_RUNNING);
+
 	/* Jump to payload with arguments */
 	void (*__attribute__((noreturn)) entry)(uint64_t, uint64_t) = (void *)hs->next_addr;
 	entry(arg0, arg1);
@@ -131,23 +255,48 @@ hart_set_imsic_eiid_status(struct hart_state *hs, uint16_t eiid, bool enable)
 }
 #endif
 
+/* Messages are handled in order, a wakeup with addr redirects the
+ * hart (whatever it was doing) so if there are more than one queued
+ * the last one wins, as if each one was handled on its own IPI. With
+ * HART_FAST_MSWTRIG plain wakeups don't get here (see hart_fast.S). */
 void __weak_handler
 hart_on_mswtrig(struct hart_state *hs)
 {
+	struct hart_mbox *mbox = per_cpu_ptr(&hart_mbox, hs->hart_idx);
+	struct hart_msg msg;
+
+	TRAP_TRACE_STAMP(trace_start);
 	ipi_clear();
-	uint16_t ipi_mask = hart_get_ipi_mask(hs);
+	uint16_t ipi_mask = hart_clear_ipi_mask(hs);
 	DBG("Got IPI on hart %i, id: %li, mask: 0x%x\n", hs->hart_idx, hs->hart_id, ipi_mask);
-	if (ipi_mask & IPI_WAKEUP_WITH_ADDR) {
-		/* Set MEPC to our trampoline function */
-		csr_write(CSR_MEPC, (uintptr_t)hart_jump_with_args);
-	}
-	#if defined(PLAT_HAS_IMSIC) && !defined(PLAT_BYPASS_IMSIC)
-		if (ipi_mask & (IPI_ENABLE_EIID|IPI_DISABLE_EIID)) {
-			uint16_t eiid = (uint16_t) hs->next_params->arg0;
-			bool enable = (bool) hs->next_params->arg1;
-			hart_set_imsic_eiid_status(hs, eiid, enable);
+	/* Pass it on first if it's part of a multicast tree */
+	ipi_forward(ipi_mask);
+	while (hart_mbox_get(hs, &msg)) {
+		switch (msg.type) {
+		case IPI_WAKEUP_WITH_ADDR:
+			hs->next_addr = msg.addr;
+			mbox->jump_params = msg.params;
+			hs->next_params = &mbox->jump_params;
+			/* Set MEPC to our trampoline function, or
+			 * let the preempted handler do it on its exit */
+			irq_set_trap_return((uintptr_t)hart_jump_with_args);
+			break;
+		case IPI_CALL:
+			((hart_call_fn_t) msg.addr)(msg.params.arg0, msg.params.arg1);
+			break;
+		#if defined(PLAT_HAS_IMSIC) && !defined(PLAT_BYPASS_IMSIC)
+		case IPI_ENABLE_EIID:
+		case IPI_DISABLE_EIID:
+			hart_set_imsic_eiid_status(hs, (uint16_t) msg.params.arg0,
+						   msg.type == IPI_ENABLE_EIID);
+			break;
+		#endif
+		default:
+			WRN("Unknown message type 0x%x\n", msg.type);
+			break;
 		}
-	#endif
+	}
+	TRAP_TRACE_RECORD(TRAP_TRACE_IPI, ipi_mask, 0, trace_start);
 	return;
 }
 
@@ -158,8 +307,12 @@ hart_on_mswtrig(struct hart_state *hs)
 void __trap_handler
 hart_handle_machine_swtrig(void)
 {
+	IRQ_STATS_ENTRY();
 	struct hart_state *hs = hart_get_hstate_self();
+	IRQ_STATS_STAMP(dispatch);
 	hart_on_mswtrig(hs);
+	IRQ_STATS_RECORD(IRQ_STAT_IPI, dispatch);
+	irq_work_trap_exit();
 	return;
 }
 #endif
@@ -169,9 +322,12 @@ hart_handle_machine_swtrig(void)
 
 /* Timer interrupt */
 
-void __empty_trap_handler hart_handle_supervisor_timer(void);
 void __empty_trap_handler hart_handle_guest_timer(void);
 
+/* Only called for timer interrupts the timer wheel didn't claim, the
+ * wheel owns mtimecmp (see timer.c), so while it has events pending an
+ * application that arms mtimecmp itself will lose its deadline to the
+ * wheel's, use timer_add() instead. */
 void __weak_handler
 hart_on_mtimer(struct hart_state *hs) {
 	WRN("Got timer interrupt out of sleep !\n");
@@ -181,16 +337,46 @@ hart_on_mtimer(struct hart_state *hs) {
 void __trap_handler
 hart_handle_machine_timer(void)
 {
+	IRQ_STATS_ENTRY();
+	TRAP_TRACE_STAMP(trace_start);
 	struct hart_state *hs = hart_get_hstate_self();
-	if (hart_test_flags(hs, HS_FLAG_SLEEPING))
-		hart_clear_flags(hs, HS_FLAG_SLEEPING);
-	else
-		hart_on_mtimer(hs);
+	/* Disarm first, the timer wheel re-arms it
+	 * for its next deadline (if any). */
 	mtimer_disarm();
+	IRQ_STATS_STAMP(dispatch);
+	if (!timer_wheel_run(hs)) {
+		if (hart_test_flags(hs, HS_FLAG_SLEEPING))
+			hart_clear_flags(hs, HS_FLAG_SLEEPING);
+		else
+			hart_on_mtimer(hs);
+	}
+	IRQ_STATS_RECORD(IRQ_STAT_TIMER, dispatch);
+	TRAP_TRACE_RECORD(TRAP_TRACE_TIMER, 0, 0, trace_start);
+	irq_work_trap_exit();
+	return;
+}
+
+/* With Sstc timer.c uses stimecmp instead, which raises
+ * the supervisor timer interrupt (not delegated, so it
+ * comes here). */
+void __trap_handler
+hart_handle_supervisor_timer(void)
+{
+	IRQ_STATS_ENTRY();
+	TRAP_TRACE_STAMP(trace_start);
+	struct hart_state *hs = hart_get_hstate_self();
+	mtimer_csr_disarm();
+	IRQ_STATS_STAMP(dispatch);
+	if (!timer_wheel_run(hs))
+		DBG("Spurious supervisor timer interrupt\n");
+	IRQ_STATS_RECORD(IRQ_STAT_TIMER, dispatch);
+	TRAP_TRACE_RECORD(TRAP_TRACE_TIMER, 1, 0, trace_start);
+	irq_work_trap_exit();
 	return;
 }
 #else
 void __empty_trap_handler hart_handle_machine_timer(void);
+void __empty_trap_handler hart_handle_supervisor_timer(void);
 #endif
 
 /* External interrupt */
@@ -202,27 +388,44 @@ void __empty_trap_handler hart_handle_guest_eintr(void);
 void __trap_handler
 hart_handle_machine_eintr(void)
 {
+	/* irq_dispatch() records the source once it knows it */
+	IRQ_STATS_ENTRY();
 	DBG("Got external interrupt, calling dispatcher\n");
 	#if defined(PLAT_HAS_IMSIC) && !defined(PLAT_BYPASS_IMSIC)
-		uint64_t mtopei = 0;
-		/* Claim top interrupt in a single instruction as
-		 * suggested in chapter 3.10 of AIA spec. */
-		__asm__ __volatile__("csrrw %0, %1, x0"	\
-				     : "=r"(mtopei)	\
-				     : "i"(CSR_MTOPEI)	\
-				     : "memory");	\
-		uint16_t source_id = (uint16_t)mtopei;
-		#if (PLAT_IMSIC_IPI_EIID > 0)
-			if (source_id == PLAT_IMSIC_IPI_EIID) {
-				struct hart_state *hs = hart_get_hstate_self();
-				hart_on_mswtrig(hs);
-				return;
-			}
-		#endif
-		irq_dispatch(source_id);
+		/* Keep claiming until there is nothing left, or we handled
+		 * PLAT_IRQ_DISPATCH_BUDGET of them, so that a burst of
+		 * interrupts is handled on a single trap (as irq_dispatch()
+		 * does for PLIC / APLIC direct mode). */
+		for (int handled = 0; handled < PLAT_IRQ_DISPATCH_BUDGET; handled++) {
+			uint64_t mtopei = 0;
+			/* Claim top interrupt in a single instruction as
+			 * suggested in chapter 3.10 of AIA spec. */
+			__asm__ __volatile__("csrrw %0, %1, x0"	\
+					     : "=r"(mtopei)	\
+					     : "i"(CSR_MTOPEI)	\
+					     : "memory");	\
+			uint16_t source_id = (uint16_t)mtopei;
+			if (source_id == 0)
+				break;
+			/* Latency of the ones after the first is from their claim */
+			if (handled)
+				IRQ_STATS_ENTRY();
+			#if (PLAT_IMSIC_IPI_EIID > 0)
+				if (source_id == PLAT_IMSIC_IPI_EIID) {
+					struct hart_state *hs = hart_get_hstate_self();
+					IRQ_STATS_STAMP(dispatch);
+					hart_on_mswtrig(hs);
+					IRQ_STATS_RECORD(IRQ_STAT_IPI, dispatch);
+					continue;
+				}
+			#endif
+			irq_dispatch(source_id);
+		}
 	#else
 		irq_dispatch(0);
 	#endif
+	/* Bottom halves of the handler (if any) */
+	irq_work_trap_exit();
 	return;
 }
 #else
@@ -231,9 +434,16 @@ void __empty_trap_handler hart_handle_machine_eintr(void);
 
 void __empty_trap_handler hart_handle_hypervisor_eintr(void);
 
-/* Counter overflow interrupt */
+/* Counter overflow interrupt (Sscofpmf), only
+ * enabled while the sampling profiler runs */
 
-void __empty_trap_handler hart_handle_counter_ovf(void);
+void __trap_handler
+hart_handle_counter_ovf(void)
+{
+	perf_prof_on_overflow(csr_read(CSR_MEPC));
+	irq_work_trap_exit();
+	return;
+}
 
 /* Exceptions */
 
@@ -271,11 +481,12 @@ hart_exception_handler(void) {
 		ERR("Exception handler called for interrupt ! mcause: 0x%lx !\n", mcause);
 		goto hang;
 	}
+	TRAP_TRACE_EVENT(TRAP_TRACE_EXC, mcause, mepc);
 
 	switch(mcause) {
 		case CAUSE_INST_ILLEGAL:
 			/* We only handle access to unimplemented SYSTEM instructions
-			 * here and report the rest. */
+			 * here (or anything while probing) and report the rest. */
 
 			/* MTVAL should contain the illegal instruction but
 			 * this is an optional feature so we may need to grab
@@ -301,6 +512,12 @@ hart_exception_handler(void) {
 				hs->error = ENOSYS;
 				goto skip;
 			}
+			/* Probing for an extension without a CSR to check */
+			if (hart_test_flags(hs, HS_FLAG_PROBING)) {
+				DBG("Unimplemented instruction: %#.8x\n", ill_inst);
+				hs->error = ENOSYS;
+				goto skip;
+			}
 			ERR("Illegal instruction at 0x%lx, mtval: 0x%lx\n", mepc, mtval);
 			break;
 		case CAUSE_INST_ACCESS_FAULT:
@@ -361,6 +578,27 @@ hart_exception_handler(void) {
 	return;
 }
 
+/*
+ * The fast paths in hart_fast.S continue to the C handlers for anything
+ * besides the common cases, give them a global name to jump to.
+ */
+#if (PLAT_HART_VECTORED_TRAPS == 1)
+	#if defined(HART_FAST_MTIMER)
+		extern void hart_fast_mtimer(void);
+		void hart_slow_mtimer(void) __attribute__((alias("hart_handle_machine_timer")));
+		#define HART_MTIMER_ENTRY	"hart_fast_mtimer"
+	#else
+		#define HART_MTIMER_ENTRY	"hart_handle_machine_timer"
+	#endif
+	#if defined(HART_FAST_MSWTRIG)
+		extern void hart_fast_mswtrig(void);
+		void hart_slow_mswtrig(void) __attribute__((alias("hart_handle_machine_swtrig")));
+		#define HART_MSWTRIG_ENTRY	"hart_fast_mswtrig"
+	#else
+		#define HART_MSWTRIG_ENTRY	"hart_handle_machine_swtrig"
+	#endif
+#endif
+
 #if (PLAT_HART_VECTORED_TRAPS == 1)
 /*
  * RISC-V M-mode trap vector table
@@ -389,7 +627,7 @@ __asm__(
 
 	/* Entry 3: Machine software interrupt */
 	".org hart_trap_vector_table + 3*4\n"
-	"jal   zero, hart_handle_machine_swtrig\n"
+	"jal   zero, " HART_MSWTRIG_ENTRY "\n"
 
 	/* Entry 4: Reserved */
 	".org hart_trap_vector_table + 4*4\n"
@@ -405,7 +643,7 @@ __asm__(
 
 	/* Entry 7: Machine timer interrupt */
 	".org hart_trap_vector_table + 7*4\n"
-	"jal   zero, hart_handle_machine_timer\n"
+	"jal   zero, " HART_MTIMER_ENTRY "\n"
 
 	/* Entry 8: Reserved */
 	".org hart_trap_vector_table + 8*4\n"
@@ -459,9 +697,15 @@ hart_direct_trap_handler(void)
 	case INTR_MACHINE_TIMER:
 		hart_handle_machine_timer();
 		break;
+	case INTR_SUPERVISOR_TIMER:
+		hart_handle_supervisor_timer();
+		break;
 	case INTR_MACHINE_EXTERNAL:
 		hart_handle_machine_eintr();
 		break;
+	case INTR_LOCAL_COUNT_OVERFLOW:
+		hart_handle_counter_ovf();
+		break;
 	default:
 		ERR("Got unhandled exception, cause: %lx\n", mcause);
 		uint64_t mepc = (uintptr_t)hart_hang;
@@ -470,6 +714,11 @@ hart_direct_trap_handler(void)
 	};
 	return;
 }
+
+#if defined(HART_FAST_MTIMER) || defined(HART_FAST_MSWTRIG)
+	extern void hart_fast_trap_entry(void);
+	void hart_slow_trap(void) __attribute__((alias("hart_direct_trap_handler")));
+#endif
 #endif
 
 
@@ -492,16 +741,11 @@ void
 hart_configure_imsic_eiid(uint16_t hart_idx, uint16_t eiid, bool enable)
 {
 	#if defined(PLAT_HAS_IMSIC) && !defined(PLAT_BYPASS_IMSIC)
-		static struct next_params params = {0};
-		params.arg0 = (uint64_t) eiid;
-		params.arg1 = (uint64_t) enable;
-
-		struct hart_state *hs = hart_get_hstate_by_idx(hart_idx);
-		hs->next_params = &params;
-		if (enable)
-			ipi_send(hs, IPI_ENABLE_EIID);
-		else
-			ipi_send(hs, IPI_DISABLE_EIID);
+		const struct next_params params = {
+			.arg0 = (uint64_t) eiid,
+		};
+		hart_mbox_send(hart_get_hstate_by_idx(hart_idx),
+			       enable ? IPI_ENABLE_EIID : IPI_DISABLE_EIID, 0, &params);
 	#endif
 }
 
@@ -509,42 +753,150 @@ void
 hart_wakeup_with_addr(uint16_t hart_idx, uintptr_t jump_addr, uint64_t arg0, 
 		      uint64_t arg1, uint64_t mtimer_cycles)
 {
-	static struct next_params params = {0};
-	params.arg0 = arg0;
-	params.arg1 = arg1;
-	params.mtimer_cycles = mtimer_cycles;
-
-	struct hart_state *hs = hart_get_hstate_by_idx(hart_idx);
-	hs->next_addr = jump_addr;
-	hs->next_params = &params;
-	ipi_send(hs, IPI_WAKEUP_WITH_ADDR);
+	#ifndef PLAT_NO_IPI
+		const struct next_params params = {
+			.arg0 = arg0,
+			.arg1 = arg1,
+			.mtimer_cycles = mtimer_cycles
+		};
+		hart_mbox_send(hart_get_hstate_by_idx(hart_idx),
+			       IPI_WAKEUP_WITH_ADDR, jump_addr, &params);
+	#endif
 }
 
 void
 hart_wakeup_all_with_addr(uintptr_t jump_addr, uint64_t arg0, uint64_t arg1,
 			  uint64_t mtimer_cycles)
 {
-	static struct next_params params = {0};
-	params.arg0 = arg0;
-	params.arg1 = arg1;
-	params.mtimer_cycles = mtimer_cycles;
-	int num_harts = hart_get_count();
-	struct hart_state *this_hs = hart_get_hstate_self();
-
-	/* First send IPI to all other harts */
-	for (int i = 0; i < num_harts; i++) {
-		struct hart_state *hs = hart_get_hstate_by_idx(i);
-		if (hs == this_hs)
-			continue;
-		hs->next_addr = jump_addr;
-		hs->next_params = &params;
-		ipi_send(hs, IPI_WAKEUP_WITH_ADDR);
+	#ifndef PLAT_NO_IPI
+		const struct next_params params = {
+			.arg0 = arg0,
+			.arg1 = arg1,
+			.mtimer_cycles = mtimer_cycles
+		};
+		int num_harts = hart_get_count();
+		struct hart_state *this_hs = hart_get_hstate_self();
+		hartmask_t targets = 0;
+
+		/* First send IPI to all other harts, with
+		 * a single multicast once they all got
+		 * their message. */
+		for (int i = 0; i < num_harts; i++) {
+			struct hart_state *hs = hart_get_hstate_by_idx(i);
+			if (hs == this_hs)
+				continue;
+			if (!hart_mbox_post(hs, IPI_WAKEUP_WITH_ADDR, jump_addr, &params))
+				targets |= HARTMASK(i);
+		}
+		ipi_send_mask(targets, IPI_WAKEUP_WITH_ADDR);
+
+		/* Finaly to self */
+		hart_mbox_send(this_hs, IPI_WAKEUP_WITH_ADDR, jump_addr, &params);
+	#endif
+}
+
+/*
+ * Have the harts on hart_mask (one bit per hart_idx) call fn(arg0, arg1)
+ * from their IPI handler, with a single multicast IPI. We are skipped if
+ * we are on the mask, and this doesn't wait for fn to run, fn should let
+ * the caller know if it needs to. Returns the mask of harts that got the
+ * call (0 without IPIs).
+ */
+uint64_t
+hart_call_mask(uint64_t hart_mask, hart_call_fn_t fn, uint64_t arg0, uint64_t arg1)
+{
+	hartmask_t targets = 0;
+	#ifndef PLAT_NO_IPI
+		const struct next_params params = {
+			.arg0 = arg0,
+			.arg1 = arg1,
+		};
+		const uint16_t self_idx = hart_get_hstate_self()->hart_idx;
+		hart_mask &= ~HARTMASK(self_idx);
+
+		while (hart_mask) {
+			const int idx = __builtin_ctzll(hart_mask);
+			hart_mask &= hart_mask - 1;
+			if (idx >= hart_get_count())
+				break;
+			if (!hart_mbox_post(hart_get_hstate_by_idx(idx), IPI_CALL,
+					    (uintptr_t) fn, &params))
+				targets |= HARTMASK(idx);
+		}
+		if (targets)
+			ipi_send_mask(targets, IPI_CALL);
+	#endif
+	return targets;
+}
+
+static void __attribute__((noreturn))
+hart_wait_for_ipi(void)
+{
+	while(1 == 1) {
+		/* Work queued before going idle, the
+		 * trap handlers run the rest on exit. */
+		irq_work_run();
+		wfi();
 	}
+}
+
+/* The jump targets of hart_wakeup_with_addr can't return, they run on
+ * the stack of the interrupted wfi loop, so this is how they go back to
+ * idle. Reset sp to the top of our stack (right below hart_state and the
+ * per-hart data, see start.S) so that we don't stack up frames on each
+ * wakeup, and wait for the next IPI as in hart_init. */
+void __attribute__((noreturn))
+hart_idle(void)
+{
+	struct hart_state *hs = hart_get_hstate_self();
+	hart_clear_flags(hs, HS_FLAG_RUNNING);
+	__asm__ __volatile__("mv	sp, %0\n"
+			     "jr	%1\n"
+			     : : "r"(percpu_base(hs)), "r"(hart_wait_for_ipi) : "memory");
+	__builtin_unreachable();
+}
 
-	/* Finaly to self */
-	this_hs->next_addr = jump_addr;
-	this_hs->next_params = &params;
-	ipi_self(IPI_WAKEUP_WITH_ADDR);
+/* Per-hart slot for yalibc's heap arena (see stdlib.c), with a
+ * single hart there's no lock contention so we don't bother. */
+void**
+__heap_arena_location(void)
+{
+	#if (PLAT_MAX_HARTS > 1)
+		static void *heap_arena __percpu = NULL;
+		return this_cpu_ptr(&heap_arena);
+	#else
+		return NULL;
+	#endif
+}
+
+/* Per-hart slot for yalibc's thread scheduler (see threads.c) */
+void**
+__thrd_sched_location(void)
+{
+	static void *thrd_sched __percpu = NULL;
+	return this_cpu_ptr(&thrd_sched);
+}
+
+/* Per-hart slot for yalibc's rand() state (see stdlib.c), also
+ * returns the hart's index so that it can pick its own stream. */
+void*
+__rand_state_location(uint16_t *hart_idx)
+{
+	static uint64_t rand_state[6] __percpu = { 0 };
+	*hart_idx = hart_get_hstate_self()->hart_idx;
+	return this_cpu_ptr(&rand_state);
+}
+
+/* Lets yalibc know if the heap is still zeroed from reset, so that
+ * calloc() can skip clearing memory that was never handed out. */
+bool
+__heap_zeroed_on_boot(void)
+{
+	#if defined(PLAT_RAM_ZEROED_ON_RESET)
+		return true;
+	#else
+		return false;
+	#endif
 }
 
 /* Main without arguments as per C spec */
@@ -560,10 +912,18 @@ hart_init(void)
 		/* Reference the vector table symbol - only visible in this function */
 		extern char hart_trap_vector_table[];
 		uintptr_t mtvec_val = (uintptr_t)hart_trap_vector_table | 1;
+	#elif defined(HART_FAST_MTIMER) || defined(HART_FAST_MSWTRIG)
+		uintptr_t mtvec_val = (uintptr_t)hart_fast_trap_entry & ~1;
 	#else
 		uintptr_t mtvec_val = (uintptr_t)hart_direct_trap_handler & ~1;
 	#endif
 	csr_write(CSR_MTVEC, mtvec_val);
+	if (hs->hart_idx == 0)
+		boot_prof_mark(BOOT_PHASE_HART_INIT);
+
+	/* Check in with the boot hart, it waits for us in
+	 * platform_init_default() before counting us in. */
+	hart_set_flags(hs, HS_FLAG_ONLINE);
 
 	if (hs->hart_idx == 0)
 		platform_init();
@@ -574,6 +934,16 @@ hart_init(void)
 	hart_init_counters(hs);
 	hart_init_sdtrig(hs);
 
+	/* Let the boot hart pick the string kernels yalibc will use and
+	 * the cbo.* block sizes, we do this after hart_init_vpu so that
+	 * mstatus.VS is set. */
+	if (hs->hart_idx == 0) {
+		struct rvcaps caps;
+		boot_prof_mark(BOOT_PHASE_HART_SETUP);
+		hart_probe_isa_caps(&caps);
+		boot_prof_mark(BOOT_PHASE_ISA_CAPS);
+	}
+
 	#if defined(PLAT_HAS_IMSIC) && defined(PLAT_BYPASS_IMSIC)
 		/* Make sure EIDELIVERY @0x70 is set to 0x40000000 on reset
 		 * to bypass IMSIC, otherwise IMSIC bypass is not supported ! */
@@ -582,12 +952,28 @@ hart_init(void)
 		if (eidelivery != 0x40000000)
 			ERR("IMSIC bypass is not supported (eidelivery: 0x%lx) !\n", eidelivery);
 	#endif
+	#if defined(IRQ_STATS)
+		/* Needs the heap and mcycle, before interrupts */
+		irq_stats_init_hart();
+	#endif
+	#if defined(TRAP_TRACE)
+		trap_trace_init_hart();
+	#endif
+	#if defined(LOG_RINGS)
+		/* Up front, logging can't allocate (see log.c) */
+		log_init_hart();
+	#endif
 	hart_allow_interrupts();
 	hart_enable_intr(INTR_MACHINE_SOFTWARE_TRIG);
 	#if (PLAT_IMSIC_IPI_EIID > 0)
 		hart_set_imsic_eiid_status(hs, PLAT_IMSIC_IPI_EIID, 1);
 	#endif
 
+	/* Needs the timer interrupt, after hart_allow_interrupts() */
+	timer_init_hart(hs);
+	if (hs->hart_idx == 0)
+		boot_prof_mark(BOOT_PHASE_INTR);
+
 	/* For each hart we have the following infos:
 	 * a) hart_id from mhartid, an XLEN id that can be anything as long as it's unique in the system, a physical hart id
 	 * b) hart_idx, an index we assigned to this hart based on the order it came up, it's the logical hart id under our control
@@ -632,13 +1018,12 @@ hart_init(void)
 	/* Good to go, if this is the boot hart jump to main() */
 	if (hs->hart_idx == 0) {
 		hart_set_flags(hs, HS_FLAG_RUNNING);
+		boot_prof_mark(BOOT_PHASE_MAIN);
 		main();
 	} else {
 		/* If this is a secondary hart wait for an IPI, note that jumping
 		 * to a function is handled by the IPI handler. */
-		while(1 == 1) {
-			wfi();
-		}
+		hart_wait_for_ipi();
 	}
 
 	DBG("HART %li done\n", hs->hart_idx);
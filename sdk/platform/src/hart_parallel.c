@@ -0,0 +1,697 @@
+/*
+ * SPDX-FileType: SOURCE
+ *
+ * SPDX-FileCopyrightText: 2026 Nick Kossifidis <mick@ics.forth.gr>
+ * SPDX-FileCopyrightText: 2026 ICS/FORTH
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <target_config.h>		/* For PLAT_MAX_HARTS / PLAT_NO_IPI */
+#include <platform/riscv/hart.h>	/* For hart_state and wakeup functions */
+#include <platform/riscv/cache.h>	/* For cache_get_block_size() */
+#include <platform/riscv/csr.h>		/* For wfi() / pause() */
+#include <platform/interfaces/ipi.h>	/* For ipi_send_mask() */
+#include <platform/utils/lock.h>	/* For sdk_lock_* / lock_try_acquire/wait_change() */
+#include <stdatomic.h>			/* For C11 atomics */
+#include <stdint.h>			/* For typed integers */
+#include <stdlib.h>			/* For aligned_alloc() / free() */
+#include <string.h>			/* For memcpy/memset */
+#include <errno.h>			/* For error codes */
+
+/*
+ * A persistent worker pool: the first time work gets submitted, idle
+ * harts (READY and not RUNNING) are sent to par_pool_worker() through
+ * the wakeup with addr IPI, and from then on they stay there, parked
+ * on wfi, with HS_FLAG_POOL set. Work items are owned by the caller,
+ * and go to a single FIFO shared by all harts. Submitting one sends
+ * a plain wakeup IPI to the parked harts, and the first one to get
+ * to the queue runs it.
+ *
+ * Note that sending a pool hart somewhere else with hart_wakeup_*()
+ * takes it out of the pool (it loses HS_FLAG_POOL), and if it was
+ * running an item at the time, that item never completes, so skip
+ * harts with HS_FLAG_POOL set when doing so.
+ *
+ * parallel_for() splits a range into chunks that are claimed
+ * dynamically, the caller also participates, and it submits one work
+ * item per other hart that just helps claiming chunks. When the caller
+ * runs out of chunks it cancels any helper items that didn't start
+ * yet, and waits for the rest, so slow / busy harts don't hold
+ * everyone back, and nesting (calling parallel_for() from a work item)
+ * can't deadlock.
+ *
+ * For recursive (fork-join) work there are also tasks, task_spawn()
+ * pushes an item to the calling hart's own deque instead of the shared
+ * queue, and task_wait() runs items from that deque (newest first) until
+ * the one it waits for is done, or steals from other harts' deques if
+ * it runs out. Pool harts steal too (oldest first, i.e. the largest
+ * pieces of work) once the shared queue is empty, and park on wfi only
+ * when there's nothing to steal. The deques are Chase-Lev work-stealing
+ * deques, the owner pushes / takes at the bottom without contention,
+ * and thieves race on the top with a CAS. Tasks must be waited for by
+ * the hart that spawned them, before their work item goes away. The
+ * deques (one per hart) are allocated by the first task_spawn(), if
+ * that fails tasks just run in place.
+ *
+ * Without other harts (or IPIs) everything runs on the calling hart,
+ * workqueue_submit() / task_spawn() run the item before returning.
+ */
+
+/* How many chunks to aim for per hart when no grain is given */
+#define PAR_CHUNKS_PER_HART	4
+
+/* Per-hart task deque size, spawning more than that
+ * without waiting runs them in place */
+#define TASK_DEQUE_SIZE		128
+
+#if (PLAT_MAX_HARTS > 1) && !defined(PLAT_NO_IPI)
+
+static struct work_item *wq_head = NULL;
+static struct work_item *wq_tail = NULL;
+static sdk_lock_t wq_lock = SDK_LOCK_INIT;
+
+/* The queue is also used from interrupt handlers (e.g. timer
+ * callbacks), so block interrupts while holding the lock. */
+static inline bool
+wq_lock_acquire(void)
+{
+	const bool irqs_on = csr_read(CSR_MSTATUS) & CSR_MSTATUS_MIE;
+	hart_block_interrupts();
+	sdk_lock_acquire(&wq_lock);
+	return irqs_on;
+}
+
+static inline void
+wq_lock_release(bool irqs_on)
+{
+	sdk_lock_release(&wq_lock);
+	if (irqs_on)
+		hart_allow_interrupts();
+}
+
+static void
+wq_push(struct work_item *work)
+{
+	work->next = NULL;
+	atomic_store_explicit(&work->state, WORK_QUEUED, memory_order_relaxed);
+	if (wq_tail)
+		wq_tail->next = work;
+	else
+		wq_head = work;
+	wq_tail = work;
+}
+
+static bool
+wq_remove(struct work_item *work)
+{
+	struct work_item *prev = NULL;
+	for (struct work_item *cur = wq_head; cur; prev = cur, cur = cur->next) {
+		if (cur != work)
+			continue;
+		if (prev)
+			prev->next = cur->next;
+		else
+			wq_head = cur->next;
+		if (wq_tail == cur)
+			wq_tail = prev;
+		return true;
+	}
+	return false;
+}
+
+static struct work_item *
+wq_pop(void)
+{
+	const bool irqs_on = wq_lock_acquire();
+	struct work_item *work = wq_head;
+	if (work) {
+		wq_head = work->next;
+		if (!wq_head)
+			wq_tail = NULL;
+		atomic_store_explicit(&work->state, WORK_RUNNING, memory_order_relaxed);
+	}
+	wq_lock_release(irqs_on);
+	return work;
+}
+
+static inline void
+wq_run(struct work_item *work)
+{
+	work->fn(work);
+	/* Last access to the item, the owner may re-use it after that */
+	atomic_store_explicit(&work->state, WORK_DONE, memory_order_release);
+}
+
+/* top and bottom go on different cache lines, since
+ * thieves write the first and the owner the second */
+struct task_deque {
+	_Alignas(64) atomic_long top;
+	_Alignas(64) atomic_long bottom;
+	_Atomic(struct work_item *) items[TASK_DEQUE_SIZE];
+};
+
+static _Atomic(struct task_deque *) task_deques = NULL;
+
+/* Pool harts that are (about to be) parked on wfi */
+static _Atomic(hartmask_t) par_idle_mask = 0;
+static atomic_bool task_pool_started = false;
+
+/* Owner only, returns false if the deque is full */
+static bool
+task_push(struct task_deque *dq, struct work_item *work)
+{
+	const long b = atomic_load_explicit(&dq->bottom, memory_order_relaxed);
+	const long t = atomic_load_explicit(&dq->top, memory_order_acquire);
+	if (b - t >= TASK_DEQUE_SIZE)
+		return false;
+	atomic_store_explicit(&dq->items[b % TASK_DEQUE_SIZE], work, memory_order_relaxed);
+	atomic_thread_fence(memory_order_release);
+	atomic_store_explicit(&dq->bottom, b + 1, memory_order_relaxed);
+	return true;
+}
+
+/* Owner only, takes the newest item */
+static struct work_item *
+task_take(struct task_deque *dq)
+{
+	const long b = atomic_load_explicit(&dq->bottom, memory_order_relaxed) - 1;
+	atomic_store_explicit(&dq->bottom, b, memory_order_relaxed);
+	atomic_thread_fence(memory_order_seq_cst);
+	long t = atomic_load_explicit(&dq->top, memory_order_relaxed);
+
+	if (t > b) {
+		/* Empty */
+		atomic_store_explicit(&dq->bottom, b + 1, memory_order_relaxed);
+		return NULL;
+	}
+
+	struct work_item *work = atomic_load_explicit(&dq->items[b % TASK_DEQUE_SIZE],
+						      memory_order_relaxed);
+	if (t == b) {
+		/* Last one, race with the thieves for it */
+		if (!atomic_compare_exchange_strong_explicit(&dq->top, &t, t + 1,
+							     memory_order_seq_cst,
+							     memory_order_relaxed))
+			work = NULL;
+		atomic_store_explicit(&dq->bottom, b + 1, memory_order_relaxed);
+	}
+	return work;
+}
+
+/* Any hart, takes the oldest item */
+static struct work_item *
+task_steal(struct task_deque *dq)
+{
+	long t = atomic_load_explicit(&dq->top, memory_order_acquire);
+	atomic_thread_fence(memory_order_seq_cst);
+	const long b = atomic_load_explicit(&dq->bottom, memory_order_acquire);
+	if (t >= b)
+		return NULL;
+
+	struct work_item *work = atomic_load_explicit(&dq->items[t % TASK_DEQUE_SIZE],
+						      memory_order_relaxed);
+	if (!atomic_compare_exchange_strong_explicit(&dq->top, &t, t + 1,
+						     memory_order_seq_cst,
+						     memory_order_relaxed))
+		return NULL;
+	return work;
+}
+
+static inline bool
+task_deque_empty(struct task_deque *dq)
+{
+	return atomic_load_explicit(&dq->top, memory_order_relaxed) >=
+	       atomic_load_explicit(&dq->bottom, memory_order_relaxed);
+}
+
+/* Returns NULL if no task was spawned yet */
+static inline struct task_deque *
+task_get_deques(void)
+{
+	return atomic_load_explicit(&task_deques, memory_order_acquire);
+}
+
+/* Called by the spawners until one of them gets to set them,
+ * returns NULL if we are out of memory */
+static struct task_deque *
+task_alloc_deques(void)
+{
+	const size_t size = hart_get_count() * sizeof(struct task_deque);
+	struct task_deque *dqs = aligned_alloc(_Alignof(struct task_deque), size);
+	if (!dqs)
+		return NULL;
+	memset(dqs, 0, size);
+
+	struct task_deque *cur = NULL;
+	if (!atomic_compare_exchange_strong_explicit(&task_deques, &cur, dqs,
+						     memory_order_acq_rel,
+						     memory_order_acquire)) {
+		free(dqs);
+		return cur;
+	}
+	return dqs;
+}
+
+/* Try everyone else's deque once, starting from our neighbour */
+static struct work_item *
+task_steal_any(uint16_t self)
+{
+	struct task_deque *dqs = task_get_deques();
+	const int num_harts = hart_get_count();
+	if (!dqs)
+		return NULL;
+	for (int i = 1; i < num_harts; i++) {
+		struct work_item *work = task_steal(&dqs[(self + i) % num_harts]);
+		if (work) {
+			atomic_store_explicit(&work->state, WORK_RUNNING, memory_order_relaxed);
+			return work;
+		}
+	}
+	return NULL;
+}
+
+static bool
+task_any_queued(void)
+{
+	struct task_deque *dqs = task_get_deques();
+	if (!dqs)
+		return false;
+	for (int i = 0; i < hart_get_count(); i++) {
+		if (!task_deque_empty(&dqs[i]))
+			return true;
+	}
+	return false;
+}
+
+static void __attribute__((noreturn))
+par_pool_worker(uint64_t arg0, uint64_t arg1)
+{
+	struct hart_state *hs = hart_get_hstate_self();
+	(void) arg0;
+	(void) arg1;
+
+	hart_set_flags(hs, HS_FLAG_POOL);
+	hart_clear_flags(hs, HS_FLAG_RUNNING);
+
+	while (1 == 1) {
+		struct work_item *work = wq_pop();
+		if (!work)
+			work = task_steal_any(hs->hart_idx);
+		if (work) {
+			wq_run(work);
+			continue;
+		}
+		/* With interrupts blocked an IPI that comes after we
+		 * checked the queues can't be consumed by the handler
+		 * before we go to wfi. wfi still wakes up on it, and
+		 * we take it once we allow interrupts again. Spawners
+		 * push and then check par_idle_mask, we set our bit
+		 * and then check the deques, so one of us sees the
+		 * other. */
+		hart_block_interrupts();
+		atomic_fetch_or_explicit(&par_idle_mask, HARTMASK(hs->hart_idx),
+					 memory_order_seq_cst);
+		if (!__atomic_load_n(&wq_head, __ATOMIC_RELAXED) && !task_any_queued())
+			wfi();
+		atomic_fetch_and_explicit(&par_idle_mask, ~HARTMASK(hs->hart_idx),
+					  memory_order_relaxed);
+		hart_allow_interrupts();
+	}
+}
+
+/* Pull any idle harts into the pool, and wake up the parked ones */
+static void
+par_pool_kick(void)
+{
+	struct hart_state *this_hs = hart_get_hstate_self();
+	static atomic_int join_lock = 0;
+	int num_harts = hart_get_count();
+	hartmask_t parked = 0;
+
+	for (int i = 0; i < num_harts; i++) {
+		struct hart_state *hs = hart_get_hstate_by_idx(i);
+		if (hs == this_hs)
+			continue;
+		if (hart_test_flags(hs, HS_FLAG_POOL)) {
+			parked |= HARTMASK(i);
+			continue;
+		}
+		if (!hart_test_flags(hs, HS_FLAG_READY) ||
+		    hart_test_flags(hs, HS_FLAG_RUNNING))
+			continue;
+		/* Claim it before someone else does */
+		if (!lock_try_acquire(&join_lock))
+			continue;
+		if (!hart_test_flags(hs, HS_FLAG_RUNNING) &&
+		    !hart_test_flags(hs, HS_FLAG_POOL)) {
+			hart_set_flags(hs, HS_FLAG_RUNNING);
+			hart_wakeup_with_addr(i, (uintptr_t) par_pool_worker, 0, 0, 0);
+		}
+		lock_release(&join_lock);
+	}
+	ipi_send_mask(parked, IPI_WAKEUP);
+}
+
+#endif
+
+/**************\
+* ENTRY POINTS *
+\**************/
+
+/* Returns -EBUSY if the item is still queued / running */
+int
+workqueue_submit(struct work_item *work)
+{
+	if (!work || !work->fn)
+		return -EINVAL;
+
+	const int state = atomic_load_explicit(&work->state, memory_order_acquire);
+	if (state == WORK_QUEUED || state == WORK_RUNNING)
+		return -EBUSY;
+
+	#if (PLAT_MAX_HARTS > 1) && !defined(PLAT_NO_IPI)
+		if (hart_get_count() > 1) {
+			const bool irqs_on = wq_lock_acquire();
+			wq_push(work);
+			wq_lock_release(irqs_on);
+			par_pool_kick();
+			return 0;
+		}
+	#endif
+	atomic_store_explicit(&work->state, WORK_RUNNING, memory_order_relaxed);
+	work->fn(work);
+	atomic_store_explicit(&work->state, WORK_DONE, memory_order_release);
+	return 0;
+}
+
+/* Removes the item from the queue if it didn't start yet,
+ * returns -EBUSY if it's running and -EINVAL if it's not
+ * queued at all (e.g. already done). */
+int
+workqueue_cancel(struct work_item *work)
+{
+	if (!work)
+		return -EINVAL;
+
+	#if (PLAT_MAX_HARTS > 1) && !defined(PLAT_NO_IPI)
+		int ret = -EINVAL;
+		const bool irqs_on = wq_lock_acquire();
+		const int state = atomic_load_explicit(&work->state, memory_order_relaxed);
+		if (state == WORK_RUNNING)
+			ret = -EBUSY;
+		else if (state == WORK_QUEUED && wq_remove(work)) {
+			atomic_store_explicit(&work->state, WORK_IDLE, memory_order_relaxed);
+			ret = 0;
+		}
+		wq_lock_release(irqs_on);
+		return ret;
+	#else
+		return -EINVAL;
+	#endif
+}
+
+/* Wait for the item to complete, if no hart picked it
+ * up yet, run it here instead of waiting. */
+void
+workqueue_wait(struct work_item *work)
+{
+	if (!work)
+		return;
+
+	#if (PLAT_MAX_HARTS > 1) && !defined(PLAT_NO_IPI)
+		if (!workqueue_cancel(work)) {
+			atomic_store_explicit(&work->state, WORK_RUNNING, memory_order_relaxed);
+			wq_run(work);
+			return;
+		}
+		while (atomic_load_explicit(&work->state, memory_order_acquire) == WORK_RUNNING)
+			lock_wait_change(&work->state, WORK_RUNNING);
+	#endif
+}
+
+/* Returns -EBUSY if the item is still queued / running. The item
+ * stays owned by the caller, who must task_wait() for it. */
+int
+task_spawn(struct work_item *work)
+{
+	if (!work || !work->fn)
+		return -EINVAL;
+
+	const int state = atomic_load_explicit(&work->state, memory_order_acquire);
+	if (state == WORK_QUEUED || state == WORK_RUNNING)
+		return -EBUSY;
+
+	#if (PLAT_MAX_HARTS > 1) && !defined(PLAT_NO_IPI)
+		struct hart_state *hs = hart_get_hstate_self();
+		struct task_deque *dqs = NULL;
+		if (hart_get_count() > 1 &&
+		    ((dqs = task_get_deques()) || (dqs = task_alloc_deques()))) {
+			atomic_store_explicit(&work->state, WORK_QUEUED, memory_order_relaxed);
+			if (task_push(&dqs[hs->hart_idx], work)) {
+				/* The first time around pull idle
+				 * harts into the pool, after that just
+				 * wake up one of the parked ones */
+				if (!atomic_exchange_explicit(&task_pool_started, true,
+							      memory_order_relaxed)) {
+					par_pool_kick();
+					return 0;
+				}
+				atomic_thread_fence(memory_order_seq_cst);
+				hartmask_t idle = atomic_load_explicit(&par_idle_mask,
+								       memory_order_relaxed);
+				if (idle)
+					ipi_send_mask(idle & -idle, IPI_WAKEUP);
+				return 0;
+			}
+			/* Deque full, run it here */
+		}
+	#endif
+	atomic_store_explicit(&work->state, WORK_RUNNING, memory_order_relaxed);
+	work->fn(work);
+	atomic_store_explicit(&work->state, WORK_DONE, memory_order_release);
+	return 0;
+}
+
+/* Wait for a spawned item to complete, running other
+ * tasks (ours first, then stolen ones) in the meantime */
+void
+task_wait(struct work_item *work)
+{
+	if (!work)
+		return;
+
+	#if (PLAT_MAX_HARTS > 1) && !defined(PLAT_NO_IPI)
+		struct hart_state *hs = hart_get_hstate_self();
+		struct task_deque *dqs = task_get_deques();
+		while (atomic_load_explicit(&work->state, memory_order_acquire) != WORK_DONE) {
+			/* No deques, nothing was spawned (it ran in place) */
+			struct work_item *next = dqs ? task_take(&dqs[hs->hart_idx]) : NULL;
+			if (next)
+				atomic_store_explicit(&next->state, WORK_RUNNING, memory_order_relaxed);
+			else
+				next = task_steal_any(hs->hart_idx);
+			if (next)
+				wq_run(next);
+			else
+				pause();
+		}
+	#endif
+}
+
+struct par_job {
+	parallel_for_fn_t fn;
+	void *ctx;
+	size_t begin;
+	size_t end;
+	size_t grain;
+	size_t num_chunks;
+	atomic_size_t next_chunk;
+};
+
+static void
+par_run_chunks(struct par_job *job)
+{
+	size_t idx;
+	while ((idx = atomic_fetch_add_explicit(&job->next_chunk, 1, memory_order_relaxed))
+	       < job->num_chunks) {
+		size_t start = job->begin + idx * job->grain;
+		size_t end = (job->end - start > job->grain) ? start + job->grain : job->end;
+		job->fn(job->ctx, start, end);
+	}
+}
+
+#if (PLAT_MAX_HARTS > 1) && !defined(PLAT_NO_IPI)
+static void
+par_helper(struct work_item *work)
+{
+	par_run_chunks((struct par_job *) work->arg);
+}
+#endif
+
+/* Calls fn(ctx, start, end) for consecutive [start, end) chunks of up
+ * to grain items covering [begin, end), on all harts in parallel, and
+ * returns once they are all done. With a zero grain we pick one that
+ * gives each hart a few chunks. */
+int
+parallel_for(size_t begin, size_t end, size_t grain, parallel_for_fn_t fn, void *ctx)
+{
+	if (!fn || begin > end)
+		return -EINVAL;
+	if (begin == end)
+		return 0;
+
+	const size_t len = end - begin;
+	const int num_harts = hart_get_count();
+	if (!grain) {
+		grain = len / (num_harts * PAR_CHUNKS_PER_HART);
+		if (!grain)
+			grain = 1;
+	}
+
+	struct par_job job = {
+		.fn = fn,
+		.ctx = ctx,
+		.begin = begin,
+		.end = end,
+		.grain = grain,
+		.num_chunks = (len / grain) + ((len % grain) ? 1 : 0),
+	};
+	atomic_init(&job.next_chunk, 0);
+
+	#if (PLAT_MAX_HARTS > 1) && !defined(PLAT_NO_IPI)
+		struct work_item helpers[PLAT_MAX_HARTS - 1] = { 0 };
+		size_t num_helpers = num_harts - 1;
+		if (num_helpers > job.num_chunks - 1)
+			num_helpers = job.num_chunks - 1;
+
+		if (num_helpers) {
+			const bool irqs_on = wq_lock_acquire();
+			for (size_t i = 0; i < num_helpers; i++) {
+				helpers[i].fn = par_helper;
+				helpers[i].arg = &job;
+				wq_push(&helpers[i]);
+			}
+			wq_lock_release(irqs_on);
+			par_pool_kick();
+		}
+	#endif
+
+	par_run_chunks(&job);
+
+	#if (PLAT_MAX_HARTS > 1) && !defined(PLAT_NO_IPI)
+		/* job is on our stack, make sure no one still uses it */
+		for (size_t i = 0; i < num_helpers; i++) {
+			if (workqueue_cancel(&helpers[i]) == 0)
+				continue;
+			int state;
+			while ((state = atomic_load_explicit(&helpers[i].state, memory_order_acquire)) != WORK_DONE)
+				lock_wait_change(&helpers[i].state, state);
+		}
+	#endif
+	return 0;
+}
+
+/*
+ * Multi-hart memcpy / memset for large buffers, where a single hart
+ * can't saturate the memory system, on top of parallel_for(). The
+ * range is split into chunks that start on a cache line boundary (so
+ * that two harts never write the same line).
+ */
+
+/* Below this it's not worth waking up other harts */
+#define PAR_MIN_LEN		(256 * 1024)
+/* Minimum chunk size */
+#define PAR_MIN_CHUNK		(32 * 1024)
+/* If Zicbom is not there to tell us, assume 64byte cache lines */
+#define PAR_DEFAULT_LINE	64
+
+#if (PLAT_MAX_HARTS > 1) && !defined(PLAT_NO_IPI)
+
+struct par_mem_job {
+	uint8_t *dst;
+	const uint8_t *src;	/* NULL for memset */
+	int byte;
+	size_t len;
+	size_t chunk_size;
+	size_t line_size;
+};
+
+static inline uintptr_t
+par_chunk_start(const struct par_mem_job *job, size_t idx)
+{
+	uintptr_t start = (uintptr_t) job->dst;
+	uintptr_t end = start + job->len;
+	if (!idx)
+		return start;
+
+	uintptr_t ret = start + idx * job->chunk_size;
+	ret = (ret + job->line_size - 1) & ~(job->line_size - 1);
+	return (ret > end) ? end : ret;
+}
+
+static void
+par_mem_chunks(void *ctx, size_t first, size_t last)
+{
+	const struct par_mem_job *job = ctx;
+	uintptr_t start = par_chunk_start(job, first);
+	uintptr_t end = par_chunk_start(job, last);
+	size_t offt = start - (uintptr_t) job->dst;
+
+	if (job->src)
+		memcpy((void*)start, job->src + offt, end - start);
+	else
+		memset((void*)start, job->byte, end - start);
+}
+
+static void
+par_do(void *dst, const void *src, int c, size_t len)
+{
+	int num_harts = hart_get_count();
+
+	size_t line_size = cache_get_block_size();
+	if (!line_size)
+		line_size = PAR_DEFAULT_LINE;
+
+	size_t chunk_size = len / (num_harts * PAR_CHUNKS_PER_HART);
+	if (chunk_size < PAR_MIN_CHUNK)
+		chunk_size = PAR_MIN_CHUNK;
+	chunk_size = (chunk_size + line_size - 1) & ~(line_size - 1);
+
+	struct par_mem_job job = {
+		.dst = dst,
+		.src = src,
+		.byte = c,
+		.len = len,
+		.chunk_size = chunk_size,
+		.line_size = line_size,
+	};
+	parallel_for(0, (len + chunk_size - 1) / chunk_size, 1, par_mem_chunks, &job);
+}
+
+#endif
+
+void*
+memcpy_parallel(void *restrict dst, const void *restrict src, size_t len)
+{
+#if (PLAT_MAX_HARTS > 1) && !defined(PLAT_NO_IPI)
+	if (dst && src && dst != src && len >= PAR_MIN_LEN &&
+	    hart_get_count() > 1) {
+		par_do(dst, src, 0, len);
+		return dst;
+	}
+#endif
+	return memcpy(dst, src, len);
+}
+
+void*
+memset_parallel(void *dst, int c, size_t len)
+{
+#if (PLAT_MAX_HARTS > 1) && !defined(PLAT_NO_IPI)
+	if (dst && len >= PAR_MIN_LEN && hart_get_count() > 1) {
+		par_do(dst, NULL, (unsigned char) c, len);
+		return dst;
+	}
+#endif
+	return memset(dst, c, len);
+}
@@ -7,13 +7,15 @@
  * SPDX-License-Identifier: Apache-2.0
  */
 
+#include <target_config.h>		/* For PLAT_CBOM_BLOCK_SIZE */
 #include <platform/riscv/caps.h>	/* For CAP_* macros */
 #include <platform/riscv/csr.h>		/* For CSR numbers and ops */
 #include <platform/riscv/hart.h>	/* For hart_state and definitions */
-#include <platform/utils/utils.h>	/* For DBG() */
+#include <platform/utils/utils.h>	/* For DBG() / __cold */
 #include <stddef.h>			/* For size_t */
 #include <stdbool.h>			/* For bool */
 #include <string.h>			/* For memset() */
+#include <stdlib.h>			/* For malloc()/free() */
 
 /*********\
 * Helpers *
@@ -239,6 +241,28 @@ hart_probe_svpbmt(struct hart_state *hs)
 	hart_probe_cap_by_csr_bit(CSR_MENVCFG, CSR_MENVCFG_PBMTE, caps->s_caps, CAP_SVPBMT);
 }
 
+/* Svinval adds fine-grained TLB invalidation instructions: sinval.vma,
+ * sfence.w.inval, and sfence.inval.ir. We test by executing sinval.vma x0, x0
+ * (encoding: 0x16000073). Like sfence.vma, this is an S-mode instruction
+ * that can be executed in M-mode. If not implemented, it will trap with
+ * illegal instruction, but since it's a SYSTEM instruction our trap handler
+ * will just ignore it and set hs->error to ENOSYS. */
+static void
+hart_probe_svinval(struct hart_state *hs)
+{
+	struct rvcaps *caps = hs->caps;
+	if (caps->s_caps & CAP_SVINVAL)
+		return;
+	hs->error = 0;
+	asm volatile(".word 0x16000073" ::: "memory");  /* sinval.vma x0, x0 */
+	if (hs->error == 0) {
+		caps->s_caps |= CAP_SVINVAL;
+		DBG("VA: SVINVAL extension detected\n");
+	}
+	/* Clear error so it doesn't interfere with later probes */
+	hs->error = 0;
+}
+
 static void
 hart_probe_svadu(struct hart_state *hs)
 {
@@ -334,6 +358,15 @@ hart_probe_zicntr(struct hart_state *hs)
 	hart_probe_cap_by_csr_existence(CSR_CYCLE, caps->r_caps, CAP_ZICNTR);
 }
 
+/* The time CSR may be emulated by M-mode software on top of
+ * mtime, in which case reading it here traps. */
+static void
+hart_probe_zicntr_time(struct hart_state *hs)
+{
+	struct rvcaps *caps = hs->caps;
+	hart_probe_cap_by_csr_existence(CSR_TIME, caps->r_caps, CAP_ZICNTR_TIME);
+}
+
 static void
 hart_probe_zihpm(struct hart_state *hs)
 {
@@ -426,20 +459,88 @@ hart_probe_zicfilp(struct hart_state *hs)
 	hart_probe_cap_by_csr_bit(CSR_MSECCFG, CSR_MSECCFG_MLPE, caps->z_caps, CAP_ZICFILP);
 }
 
+/* Upper bound for cache block sizes, the CMO spec allows any power of 2
+ * but in practice they are a cache line, and can't be larger than a page. */
+#define CBO_MAX_BLOCK_SIZE	4096
+
 static void
-hart_probe_zicbom(struct hart_state *hs)
+hart_probe_zicboz(struct hart_state *hs)
 {
 	/* TODO: Check without MENVCFG */
 	struct rvcaps *caps = hs->caps;
-	hart_probe_cap_by_csr_field(CSR_MENVCFG, CSR_MENVCFG_CBIE, 1, caps->z_caps, CAP_ZICBOM);
+	hart_probe_cap_by_csr_bit(CSR_MENVCFG, CSR_MENVCFG_CBZE, caps->z_caps, CAP_ZICBOZ);
+	if (!(caps->z_caps & CAP_ZICBOZ))
+		return;
+
+	/* There is no CSR for the cbo.zero block size (it's provided through
+	 * the device tree), but since cbo.zero zeroes the whole block that
+	 * contains its address, we can just zero a block at the start of a
+	 * CBO_MAX_BLOCK_SIZE-aligned buffer that's filled with ones, and count
+	 * the zeroed bytes. Note that on M-mode cbo.zero is always allowed,
+	 * menvcfg.CBZE only controls lower privilege modes. */
+	uint8_t *buf = malloc(2 * CBO_MAX_BLOCK_SIZE);
+	if (!buf) {
+		DBG("Zicboz: no memory for probing block size\n");
+		return;
+	}
+	uint8_t *block = (uint8_t*)(((uintptr_t)buf + CBO_MAX_BLOCK_SIZE - 1) &
+				    ~((uintptr_t)CBO_MAX_BLOCK_SIZE - 1));
+	memset(block, 0xFF, CBO_MAX_BLOCK_SIZE);
+
+	__asm__ __volatile__(
+		".option push\n"
+		".option arch, +zicboz\n"
+		"cbo.zero (%0)\n"
+		".option pop\n"
+		: : "r"(block) : "memory");
+
+	size_t block_size = 0;
+	while (block_size < CBO_MAX_BLOCK_SIZE && block[block_size] == 0)
+		block_size++;
+	free(buf);
+
+	/* Block size must be a power of 2, store it as a shift
+	 * like we do for vlenb. */
+	if (!block_size || (block_size & (block_size - 1))) {
+		DBG("Zicboz: invalid block size %lu\n", block_size);
+		caps->z_caps &= ~CAP_ZICBOZ;
+		return;
+	}
+	uint8_t shift = 0;
+	while (block_size > 1) {
+		block_size >>= 1;
+		shift++;
+	}
+	caps->cboz_block_shift = shift;
 }
 
+/* Unlike cbo.zero, clean/inval/flush have no visible effect we could use
+ * to measure their block size, so unless the platform tells us, assume
+ * it's the same as the cbo.zero block size (they're both a cache line
+ * in practice), or a 64byte cache line. Has to run after the Zicboz
+ * probe. */
+#define CBOM_DEFAULT_BLOCK_SHIFT	6
+
 static void
-hart_probe_zicboz(struct hart_state *hs)
+hart_probe_zicbom(struct hart_state *hs)
 {
 	/* TODO: Check without MENVCFG */
 	struct rvcaps *caps = hs->caps;
-	hart_probe_cap_by_csr_bit(CSR_MENVCFG, CSR_MENVCFG_CBZE, caps->z_caps, CAP_ZICBOZ);
+	hart_probe_cap_by_csr_field(CSR_MENVCFG, CSR_MENVCFG_CBIE, 1, caps->z_caps, CAP_ZICBOM);
+	if (!(caps->z_caps & CAP_ZICBOM))
+		return;
+
+#if defined(PLAT_CBOM_BLOCK_SIZE)
+	_Static_assert(PLAT_CBOM_BLOCK_SIZE > 0 &&
+		       !(PLAT_CBOM_BLOCK_SIZE & (PLAT_CBOM_BLOCK_SIZE - 1)),
+		       "PLAT_CBOM_BLOCK_SIZE must be a power of 2");
+	caps->cbom_block_shift = (uint8_t) __builtin_ctz(PLAT_CBOM_BLOCK_SIZE);
+#else
+	if (caps->cboz_block_shift)
+		caps->cbom_block_shift = caps->cboz_block_shift;
+	else
+		caps->cbom_block_shift = CBOM_DEFAULT_BLOCK_SHIFT;
+#endif
 }
 
 static void
@@ -457,6 +558,57 @@ hart_probe_zkr(struct hart_state *hs)
 	hart_probe_cap_by_csr_bit(CSR_MSECCFG, CSR_MSECCFG_SSEED, caps->z_caps, CAP_ZKR);
 }
 
+/* There is no CSR for Zawrs, so just try wrs.nto, it's a SYSTEM
+ * instruction so if it's not implemented the trap handler will skip
+ * it and set hs->error. Without a reservation held it won't stall. */
+static void
+hart_probe_zawrs(struct hart_state *hs)
+{
+	struct rvcaps *caps = hs->caps;
+	hs->error = 0;
+	__asm__ __volatile__(
+		".option push\n"
+		".option arch, +zawrs\n"
+		"wrs.nto\n"
+		".option pop\n"
+		: : : "memory");
+	if (hs->error == 0)
+		caps->z_caps |= CAP_ZAWRS;
+}
+
+/* There is no CSR for Zbc / Zbkc either, and they're not SYSTEM
+ * instructions, so try clmul (in both) and clmulr (Zbc only) with
+ * HS_FLAG_PROBING set for the trap handler to skip them. */
+static void
+hart_probe_zbc(struct hart_state *hs)
+{
+	struct rvcaps *caps = hs->caps;
+	unsigned long val = 3;
+
+	hart_set_flags(hs, HS_FLAG_PROBING);
+	hs->error = 0;
+	__asm__ __volatile__(
+		".option push\n"
+		".option arch, +zbkc\n"
+		"clmul %0, %0, %0\n"
+		".option pop\n"
+		: "+r"(val) : : "memory");
+	/* 0b11 x 0b11 = 0b101 */
+	if (hs->error == 0 && val == 5) {
+		caps->z_caps |= CAP_ZBKC;
+		hs->error = 0;
+		__asm__ __volatile__(
+			".option push\n"
+			".option arch, +zbc\n"
+			"clmulr %0, %0, %0\n"
+			".option pop\n"
+			: "+r"(val) : : "memory");
+		if (hs->error == 0)
+			caps->z_caps |= CAP_ZBC;
+	}
+	hart_clear_flags(hs, HS_FLAG_PROBING);
+}
+
 
 /**************************\
 * Virtual Memory extensions *
@@ -504,23 +656,7 @@ hart_test_mmu_mode(struct hart_state *hs, uint64_t mode, bool napot)
 		return false;
 	}
 
-	/* Test for SVINVAL extension support, SVINVAL adds fine-grained TLB
-	 * invalidation instructions: sinval.vma, sfence.w.inval, and sfence.inval.ir.
-	 * We test by executing sinval.vma x0, x0 (encoding: 0x16000073).
-	 * Like sfence.vma, this is an S-mode instruction that can be executed
-	 * in M-mode. If not implemented, it will trap with illegal instruction, but
-	 * since it's a SYSTEM instruction our trap handler will just ignore it
-	 * and set hs->error to ENOSYS. */
-	if (!(caps->s_caps & CAP_SVINVAL)) {
-		hs->error = 0;
-		asm volatile(".word 0x16000073" ::: "memory");  /* sinval.vma x0, x0 */
-		if (hs->error == 0) {
-			caps->s_caps |= CAP_SVINVAL;
-			DBG("VA: SVINVAL extension detected\n");
-		}
-		/* Clear error so it doesn't interfere with page fault detection below */
-		hs->error = 0;
-	}
+	hart_probe_svinval(hs);
 
 	/* Try to access VA 0 using MPRV (load with U-mode privilege and translation).
 	 * Do this in a single asm block to avoid any compiler-generated
@@ -619,28 +755,12 @@ hart_probe_sv57(struct hart_state *hs)
 }
 
 
-/**************\
-* Entry points *
-\**************/
-
-void
-hart_probe_priv_caps(struct rvcaps *caps)
+/* Probe MISA bits */
+static void
+hart_probe_misa(struct hart_state *hs, uint64_t misa)
 {
-	memset(caps, 0, sizeof(struct rvcaps));
-
-	/* Instead of passing rvcaps as provided
-	 * by the user, pass it via hs->caps so that
-	 * we can also retrieve hs for free and save
-	 * a few function arguments and extra code
-	 * along the way. We'll keep a copy of
-	 * hs->early_caps and restore it when done. */
-	struct hart_state *hs = hart_get_hstate_self();
-	uint64_t saved_early_caps = hs->early_caps;
-	hs->caps = caps;
-
-	uint64_t misa = csr_read(CSR_MISA);
+	struct rvcaps *caps = hs->caps;
 
-	/* Probe MISA bits */
 	if (misa & CSR_MISA_A)
 		caps->r_caps |= CAP_A;
 	if (misa & CSR_MISA_B)
@@ -663,6 +783,43 @@ hart_probe_priv_caps(struct rvcaps *caps)
 	}
 	if (misa & CSR_MISA_X)
 		caps->r_caps |= CAP_X;
+}
+
+
+/**************\
+* Entry points *
+\**************/
+
+/* Provided by string.c / cache.c / timer.c / lock.c / hart_va.c / perf.c, so that they can use the probed caps */
+extern void __string_set_caps(const struct rvcaps *caps);
+extern void __cache_set_caps(const struct rvcaps *caps);
+extern void __timer_set_caps(const struct rvcaps *caps);
+extern void __lock_set_caps(const struct rvcaps *caps);
+extern void __va_set_caps(const struct rvcaps *caps);
+extern void __perf_set_caps(const struct rvcaps *caps);
+extern void __rng_set_caps(const struct rvcaps *caps);
+extern void __crc_set_caps(const struct rvcaps *caps);
+
+void __cold
+hart_probe_priv_caps(struct rvcaps *caps)
+{
+	memset(caps, 0, sizeof(struct rvcaps));
+
+	/* Instead of passing rvcaps as provided
+	 * by the user, pass it via hs->caps so that
+	 * we can also retrieve hs for free and save
+	 * a few function arguments and extra code
+	 * along the way. We'll keep a copy of
+	 * hs->early_caps and restore it when done,
+	 * HS_FLAG_CAPS_IS_PTR marks the window where
+	 * hs->caps points to the caller's struct. */
+	struct hart_state *hs = hart_get_hstate_self();
+	uint64_t saved_early_caps = hs->early_caps;
+	hs->caps = caps;
+	hart_set_flags(hs, HS_FLAG_CAPS_IS_PTR);
+
+	uint64_t misa = csr_read(CSR_MISA);
+	hart_probe_misa(hs, misa);
 
 	/* Probe M-mode caps, on top of existing
 	 * early_caps */
@@ -681,10 +838,13 @@ hart_probe_priv_caps(struct rvcaps *caps)
 	/* Probe Z* extensions with CSRs mentioned
 	 * in the priv. spec. */
 	hart_probe_zicfilp(hs);
-	hart_probe_zicbom(hs);
 	hart_probe_zicboz(hs);
+	hart_probe_zicbom(hs);
 	hart_probe_zicfiss(hs);
 	hart_probe_zkr(hs);
+	hart_probe_zawrs(hs);
+	hart_probe_zbc(hs);
+	hart_probe_zicntr_time(hs);
 
 	if (misa & CSR_MISA_U) {
 		hart_probe_ube(hs);
@@ -725,6 +885,63 @@ hart_probe_priv_caps(struct rvcaps *caps)
 		}
 	}
 
-	/* Restore early_caps */
+	/* Restore early_caps, caps may live on the
+	 * caller's stack so don't leave a pointer to it */
+	hs->early_caps = saved_early_caps;
+	hart_clear_flags(hs, HS_FLAG_CAPS_IS_PTR);
+
+	/* Let string.c / cache.c / timer.c / lock.c / hart_va.c / perf.c / rng.c / crc.c know about the features they can use */
+	__string_set_caps(caps);
+	__cache_set_caps(caps);
+	__timer_set_caps(caps);
+	__lock_set_caps(caps);
+	__va_set_caps(caps);
+	__perf_set_caps(caps);
+	__rng_set_caps(caps);
+	__crc_set_caps(caps);
+}
+
+/* A lightweight version of the above for the boot path, only probes
+ * the ISA features yalibc / cache.c / timer.c / lock.c / hart_va.c / perf.c / rng.c / crc.c can use
+ * (misa, vlenb, Zicboz, Zicbom, Zawrs, Zkr, Zbc / Zbkc, the time CSR, Sstc, Svpbmt, Svinval, Sscofpmf,
+ * Smctr and the number of hpm counters), without poking
+ * PMP / satp etc, and passes them along */
+void __cold
+hart_probe_isa_caps(struct rvcaps *caps)
+{
+	memset(caps, 0, sizeof(struct rvcaps));
+
+	struct hart_state *hs = hart_get_hstate_self();
+	uint64_t saved_early_caps = hs->early_caps;
+	hs->caps = caps;
+	hart_set_flags(hs, HS_FLAG_CAPS_IS_PTR);
+
+	const uint64_t misa = csr_read(CSR_MISA);
+	hart_probe_misa(hs, misa);
+	hart_probe_zicboz(hs);
+	hart_probe_zicbom(hs);
+	hart_probe_zawrs(hs);
+	hart_probe_zkr(hs);
+	hart_probe_zbc(hs);
+	hart_probe_zicntr_time(hs);
+	hart_count_hpm(hs);
+	hart_probe_smctr(hs);
+	if (misa & CSR_MISA_S) {
+		hart_probe_sstc(hs);
+		hart_probe_svpbmt(hs);
+		hart_probe_svinval(hs);
+		hart_probe_sscofpmf(hs);
+	}
+
 	hs->early_caps = saved_early_caps;
+	hart_clear_flags(hs, HS_FLAG_CAPS_IS_PTR);
+
+	__string_set_caps(caps);
+	__cache_set_caps(caps);
+	__timer_set_caps(caps);
+	__lock_set_caps(caps);
+	__va_set_caps(caps);
+	__perf_set_caps(caps);
+	__rng_set_caps(caps);
+	__crc_set_caps(caps);
 }
\ No newline at end of file
@@ -10,22 +10,58 @@
 #include <stdint.h>		/* For typed ints */
 #include <stddef.h>		/* For size_t / NULL */
 #include <stdbool.h>		/* For bool */
+#include <stdatomic.h>		/* For C11 atomics */
+#include <stdlib.h>		/* For malloc/free() */
 #include <string.h>		/* For memset() */
+#include <malloc.h>		/* For page_alloc/free() */
 #include <errno.h>		/* For error codes */
 #include <platform/riscv/csr.h>	/* For CSR definitions / SATP_MODE_* */
+#include <platform/riscv/hart.h>	/* For VA_MAP_* flags / hart_call_mask() */
+#include <platform/riscv/caps.h>	/* For struct rvcaps / CAP_SVPBMT / CAP_SVINVAL */
+#include <platform/utils/lock.h>	/* For sdk_lock_t */
+#include <platform/utils/percpu.h>	/* For __percpu / this_cpu_ptr() */
 #include <platform/utils/utils.h>	/* For DBG() */
 
-/* External values from start.S */
-extern const uintptr_t __ram_end;
-
-/* Heap management - from stdlib.c */
-extern uintptr_t __adjust_heap_end(uintptr_t new_heap_end);
+/*
+ * A simple page table mapper for Sv39/48/57: one set of page tables,
+ * built on demand from the page-frame allocator as mappings are added
+ * (with hart_va_map()) at any VA, each hart that wants to use it loads
+ * it on satp with hart_va_activate(). Each mapping uses the largest
+ * leaves its alignment / size allow (2MB megapages, 1GB gigapages,
+ * 512GB terapages under Sv48/57), so that large regions only need a
+ * few TLB entries, the rest is covered with 4KB pages (or 64KB Svnapot
+ * pages with VA_MAP_NAPOT). With Svpbmt a mapping can override the memory
+ * type of its region (VA_MAP_NC / VA_MAP_IO), e.g. for mapping DMA / frame
+ * buffers non-cacheable, without having to flush them from the caches.
+ *
+ * Besides the default set of tables (hart_va_*()), more address spaces can
+ * be created with hart_va_space_create(), each one gets its own ASID (as
+ * many as the hart's satp.ASID bits allow), so that switching between them
+ * doesn't need to flush the TLB. Changes are flushed per page (sfence.vma
+ * with the page's VA and the space's ASID, or batched with Svinval) on the
+ * calling hart, and on any other hart that had the space active since it
+ * may still have its translations cached, through an IPI (hart_call_mask).
+ * Only changes that touch more than VA_FLUSH_BATCH leaves flush the whole
+ * address space, and only spaces without an ASID (including the default
+ * one) flush the whole TLB when activated. Since the caller waits for the
+ * other harts to flush, map / unmap can't be called with interrupts off.
+ */
 
 /* Page sizes */
-#define PAGE_SIZE		4096
+#define PAGE_SHIFT		12
+#define PAGE_SIZE		(1UL << PAGE_SHIFT)
 #define NAPOT_64KB_SIZE		65536
-#define MEGAPAGE_SIZE		(2 * 1024 * 1024)
-#define GIGAPAGE_SIZE		(1024 * 1024 * 1024)
+#define NAPOT_64KB_PTES		(NAPOT_64KB_SIZE / PAGE_SIZE)
+
+/* Each level resolves 9 bits of the VA */
+#define PT_INDEX_BITS		9
+#define PT_ENTRIES		(1UL << PT_INDEX_BITS)
+#define LEVEL_SHIFT(_lvl)	(PAGE_SHIFT + (_lvl) * PT_INDEX_BITS)
+#define LEVEL_SIZE(_lvl)	(1UL << LEVEL_SHIFT(_lvl))
+
+/* Largest leaf we use, level 3 (512GB), Sv57's level 4
+ * leaves (256TB) are larger than any RAM we'll see. */
+#define MAX_LEAF_LEVEL		3
 
 /* PTE flags */
 #define PTE_V			(1ULL << 0)	/* Valid */
@@ -36,221 +72,903 @@ extern uintptr_t __adjust_heap_end(uintptr_t new_heap_end);
 #define PTE_G			(1ULL << 5)	/* Global */
 #define PTE_A			(1ULL << 6)	/* Accessed */
 #define PTE_D			(1ULL << 7)	/* Dirty */
+#define PTE_PBMT_NC		(1ULL << 61)	/* Svpbmt non-cacheable */
+#define PTE_PBMT_IO		(2ULL << 61)	/* Svpbmt I/O */
 #define PTE_N			(1ULL << 63)	/* Svnapot */
-
-/* Page table metadata - stored in .data (minimal space) */
-static uint8_t g_num_levels = 0;		/* Number of PT levels allocated */
-static uint64_t g_current_mode = 0;		/* Current SATP mode */
-static uintptr_t g_pt_base = 0;			/* Base address of page tables */
-
-/* Helper to get page table address for a given level */
-static inline uint64_t *get_pt_level(uint8_t level)
+#define PTE_PPN			(0xFFFFFFFFFFFULL << 10)
+#define PTE_LEAF		(PTE_R | PTE_W | PTE_X)
+/* Permission bits that come from VA_MAP_* as is */
+#define PTE_PERM_MASK		(PTE_R | PTE_W | PTE_X | PTE_U | PTE_G)
+
+#define PTE_TO_PA(_pte)		((((_pte) & PTE_PPN) >> 10) << PAGE_SHIFT)
+#define PA_TO_PTE(_pa)		((((uint64_t)(_pa)) >> PAGE_SHIFT) << 10)
+
+_Static_assert(VA_MAP_R == PTE_R && VA_MAP_W == PTE_W && VA_MAP_X == PTE_X &&
+	       VA_MAP_U == PTE_U && VA_MAP_G == PTE_G, "VA_MAP_* must match the PTE bits");
+
+/* An address space, level 0 is the leaf level (4KB pages),
+ * levels - 1 is the root table that satp points to. */
+struct va_space {
+	uint64_t *root;
+	uint64_t mode;
+	uint8_t levels;
+	uint16_t asid;		/* 0 if we ran out of ASIDs (or for the default space) */
+	size_t num_tables;	/* Including the root */
+	bool has_global;	/* Has VA_MAP_G leaves */
+	/* Harts that had it on satp at some point and may still have
+	 * its translations cached (one bit per hart_idx) */
+	_Atomic(uint64_t) tlb_harts;
+	/* Harts that currently have it on satp */
+	_Atomic(uint64_t) active_harts;
+};
+
+static struct va_space va_default;
+static sdk_lock_t va_lock = SDK_LOCK_INIT;
+
+/* The space on this hart's satp, NULL for Bare mode */
+static struct va_space *va_current __percpu = NULL;
+
+/* ASID 0 is left for the default space (and the ones that didn't get one),
+ * we don't need more than a few of them here, so keep the bitmap small. */
+#define VA_MAX_ASIDS		256
+static uint64_t va_asid_map[VA_MAX_ASIDS / 64] = { 1 };
+static uint16_t va_num_asids = 0;	/* 0 until we know the ASID bits */
+
+/* Up to this many leaves are flushed one by one,
+ * larger changes flush the whole address space. */
+#define VA_FLUSH_BATCH		16
+
+/* Invalidations for a map / unmap, shared with the harts that
+ * flush them on our behalf (see va_flush_ipi()) */
+struct va_flush {
+	uint16_t asid;
+	bool global;		/* Touched VA_MAP_G leaves, flush them on all ASIDs */
+	bool all;		/* Overflowed, flush the whole address space */
+	uint8_t num;
+	uintptr_t va[VA_FLUSH_BATCH];
+	atomic_uint pending;	/* Harts that haven't flushed yet */
+};
+
+/* Set through __va_set_caps() by hart_probe */
+static bool va_has_svpbmt = false;
+static bool va_has_svinval = false;
+
+void
+__va_set_caps(const struct rvcaps *caps)
 {
-	if (level >= g_num_levels || g_pt_base == 0)
-		return NULL;
-	return (uint64_t *)(g_pt_base + level * PAGE_SIZE);
+	va_has_svpbmt = (caps->s_caps & CAP_SVPBMT);
+	va_has_svinval = (caps->s_caps & CAP_SVINVAL);
+	/* Only the full probe knows, otherwise we'll check on our own */
+	if (caps->num_asid_bits) {
+		const uint32_t num = 1U << caps->num_asid_bits;
+		va_num_asids = (num > VA_MAX_ASIDS) ? VA_MAX_ASIDS : num;
+	}
 }
 
-/*
- * Map a physical address range to virtual address 0
- *
- * phys_addr: Physical address to map (must be aligned to PAGE_SIZE/NAPOT_64KB_SIZE)
- * size: Pointer to size in bytes, updated with actual VA space mapped
- * mode: SATP mode (SATP_MODE_SV39/48/57)
- * napot: Use 64KB NAPOT pages if true, otherwise 4KB pages
- *
- * Returns: 0 on success, -errno on failure
- *
- * Notes:
- * - Always maps to VA 0
- * - Creates multi-level page table hierarchy (3 levels for Sv39, 4 for Sv48, 5 for Sv57)
- * - Leaf PTEs are created at the last level for 4KB or 64KB NAPOT pages
- * - If size is 0, frees the page table and restores heap
- * - If mode changes, frees old page table and creates new one
- * - Page tables allocated from end of RAM backwards
- */
-int hart_va_map_range(uintptr_t phys_addr, size_t *size, uint64_t mode, bool napot)
+/*********\
+* Helpers *
+\*********/
+
+static uint8_t
+va_mode_levels(uint64_t mode)
 {
-	/* Determine number of levels based on mode */
-	uint8_t num_levels;
 	switch (mode) {
 	case SATP_MODE_SV39:
-		num_levels = 3;
-		break;
+		return 3;
 	case SATP_MODE_SV48:
-		num_levels = 4;
-		break;
+		return 4;
 	case SATP_MODE_SV57:
-		num_levels = 5;
-		break;
+		return 5;
 	default:
-		num_levels = 0;
-		break;
+		return 0;
 	}
+}
 
-	/* Handle cleanup/free request */
-	if (*size == 0 || (g_num_levels > 0 && g_current_mode != mode)) {
-		if (g_num_levels > 0) {
-			DBG("VA: Freeing %u-level page table, restoring heap_end to 0x%lx\n",
-			    g_num_levels, __ram_end);
-			/* Clear SATP */
-			csr_write(CSR_SATP, 0);
-			/* Sync TLB */
-			asm volatile("sfence.vma zero, zero" ::: "memory");
+static inline unsigned int
+va_index(uintptr_t va, uint8_t level)
+{
+	return (va >> LEVEL_SHIFT(level)) & (PT_ENTRIES - 1);
+}
 
-			/* Clear all page table levels */
-			size_t total_size = g_num_levels * PAGE_SIZE;
-			memset((void *)g_pt_base, 0, total_size);
+static inline uint64_t *
+va_next_table(uint64_t pte)
+{
+	return (uint64_t *) PTE_TO_PA(pte);
+}
 
-			g_pt_base = 0;
-			g_num_levels = 0;
-			g_current_mode = 0;
-			__adjust_heap_end(__ram_end);
-		}
-		if (*size == 0)
-			return 0;
-	}
+/* VAs must be sign-extended from the top bit the mode translates,
+ * and the range can't cross from the lower to the upper half. */
+static bool
+va_range_valid(const struct va_space *vs, uintptr_t va, size_t size)
+{
+	const unsigned int top_bit = LEVEL_SHIFT(vs->levels) - 1;
+	const uintptr_t last = va + size - 1;
+	if (last < va)
+		return false;
+	const intptr_t first_top = (intptr_t) va >> top_bit;
+	const intptr_t last_top = (intptr_t) last >> top_bit;
+	return (first_top == 0 || first_top == -1) && (first_top == last_top);
+}
 
-	/* Validate alignment based on page type */
-	uintptr_t page_size = napot ? NAPOT_64KB_SIZE : PAGE_SIZE;
-	if (phys_addr & (page_size - 1)) {
-		DBG("VA: Physical address 0x%lx not aligned to %lu bytes\n",
-		    phys_addr, page_size);
-		return -EADDRNOTAVAIL;
+static uint64_t *
+va_alloc_table(struct va_space *vs)
+{
+	uint64_t *table = page_alloc(1, 0);
+	if (!table)
+		return NULL;
+	memset(table, 0, PAGE_SIZE);
+	vs->num_tables++;
+	return table;
+}
+
+static void
+va_free_table(struct va_space *vs, uint64_t *table)
+{
+	page_free(table, 1);
+	vs->num_tables--;
+}
+
+static bool
+va_table_empty(const uint64_t *table)
+{
+	for (unsigned int i = 0; i < PT_ENTRIES; i++) {
+		if (table[i] & PTE_V)
+			return false;
 	}
+	return true;
+}
 
-	/* Allocate and initialize page table hierarchy if needed */
-	if (g_num_levels == 0) {
-		/* Calculate space needed */
-		size_t space_needed = num_levels * PAGE_SIZE;
-		uintptr_t pt_base = (__ram_end - space_needed) & ~(PAGE_SIZE - 1);
+/* Free all tables below table (at level), not table itself */
+static void
+va_free_subtree(struct va_space *vs, uint64_t *table, uint8_t level)
+{
+	if (level == 0)
+		return;
+	for (unsigned int i = 0; i < PT_ENTRIES; i++) {
+		const uint64_t pte = table[i];
+		if (!(pte & PTE_V) || (pte & PTE_LEAF))
+			continue;
+		uint64_t *next = va_next_table(pte);
+		va_free_subtree(vs, next, level - 1);
+		va_free_table(vs, next);
+		table[i] = 0;
+	}
+}
 
-		/* Make sure we have enough space */
-		if (pt_base + space_needed > __ram_end) {
-			DBG("VA: Not enough space for %u-level page table\n", num_levels);
-			return -ENOMEM;
+/* Get the PTE for va at level, allocating any missing tables on the way,
+ * NULL if that part of the VA space is covered by a larger leaf or if we
+ * are out of memory (*err says which). */
+static uint64_t *
+va_walk_alloc(struct va_space *vs, uintptr_t va, uint8_t level, int *err)
+{
+	uint64_t *table = vs->root;
+	for (uint8_t cur = vs->levels - 1; cur > level; cur--) {
+		uint64_t *pte = &table[va_index(va, cur)];
+		if (!(*pte & PTE_V)) {
+			uint64_t *next = va_alloc_table(vs);
+			if (!next) {
+				*err = -ENOMEM;
+				return NULL;
+			}
+			/* Non-leaf PTE: V=1, but no RWX bits */
+			*pte = PA_TO_PTE(next) | PTE_V;
+		} else if (*pte & PTE_LEAF) {
+			*err = -EEXIST;
+			return NULL;
 		}
+		table = va_next_table(*pte);
+	}
+	return &table[va_index(va, level)];
+}
 
-		/* Try to adjust heap end to prevent malloc from using this space.
-		 * __adjust_heap_end will check for overlap with existing allocations. */
-		uintptr_t actual_heap_end = __adjust_heap_end(pt_base);
-		if (actual_heap_end != pt_base) {
-			DBG("VA: Page table would overlap with heap (pt_base=0x%lx, heap_end=0x%lx)\n",
-			    pt_base, actual_heap_end);
-			return -ENOMEM;
+/* Find the leaf PTE that maps va, along with the tables on the way
+ * there (path[level] is the table that holds the PTE at level) */
+static uint64_t *
+va_walk_leaf(const struct va_space *vs, uintptr_t va, uint64_t **path, uint8_t *level)
+{
+	uint64_t *table = vs->root;
+	for (int cur = vs->levels - 1; cur >= 0; cur--) {
+		uint64_t *pte = &table[va_index(va, cur)];
+		if (path)
+			path[cur] = table;
+		if (!(*pte & PTE_V))
+			return NULL;
+		if (*pte & PTE_LEAF) {
+			*level = cur;
+			return pte;
 		}
+		table = va_next_table(*pte);
+	}
+	return NULL;
+}
+
+/* Largest leaf level we can use for the next chunk of the mapping */
+static uint8_t
+va_pick_level(const struct va_space *vs, uintptr_t va, uintptr_t pa, size_t remaining,
+	      uint32_t flags)
+{
+	if (flags & VA_MAP_NO_SUPERPAGES)
+		return 0;
+	int level = vs->levels - 1;
+	if (level > MAX_LEAF_LEVEL)
+		level = MAX_LEAF_LEVEL;
+	for (; level > 0; level--) {
+		const size_t size = LEVEL_SIZE(level);
+		if (!((va | pa) & (size - 1)) && remaining >= size)
+			return level;
+	}
+	return 0;
+}
 
-		g_pt_base = pt_base;
-		g_num_levels = num_levels;
-		g_current_mode = mode;
+static inline uint64_t
+va_self_mask(void)
+{
+	return 1ULL << hart_get_hstate_self()->hart_idx;
+}
 
-		DBG("VA: Allocating %u-level page table at 0x%lx (mode=%lu)\n",
-		    num_levels, pt_base, mode);
+static void
+va_flush_add(struct va_flush *f, uintptr_t va, uint64_t pte)
+{
+	if (pte & PTE_G)
+		f->global = true;
+	if (f->num < VA_FLUSH_BATCH)
+		f->va[f->num++] = va;
+	else
+		f->all = true;
+}
 
-		/* Zero out all levels */
-		memset((void *)pt_base, 0, space_needed);
+/* A NAPOT range may be cached as 4KB translations, one per PTE */
+static void
+va_flush_add_napot(struct va_flush *f, uintptr_t va, uint64_t pte)
+{
+	for (unsigned int i = 0; i < NAPOT_64KB_PTES; i++)
+		va_flush_add(f, va + i * PAGE_SIZE, pte);
+}
 
-		/* Initialize the hierarchy: each non-leaf level points to the next level
-		 * We only need entry [0] at each level since we're mapping VA 0 */
-		for (uint8_t level = 0; level < num_levels - 1; level++) {
-			uint64_t *pt = get_pt_level(level);
-			uintptr_t next_pt_addr = (uintptr_t)get_pt_level(level + 1);
-			uint64_t next_ppn = next_pt_addr >> 12;
-			/* Non-leaf PTE: V=1, but no RWX bits */
-			uint64_t pte = (next_ppn << 10) | PTE_V;
-			pt[0] = pte;
-			DBG("VA:   Level %u[0] -> Level %u: PTE=0x%016lx\n",
-			    level, level + 1, pte);
+/* rs2 = x0 covers all ASIDs, which is what global leaves need, since
+ * an ASID-specific fence leaves them alone. */
+static void
+va_flush_local(const struct va_flush *f)
+{
+	const uint64_t asid = f->asid;
+
+	if (f->all) {
+		if (f->global)
+			asm volatile("sfence.vma zero, zero" ::: "memory");
+		else
+			asm volatile("sfence.vma zero, %0" : : "r"(asid) : "memory");
+		return;
+	}
+
+	if (!va_has_svinval) {
+		for (unsigned int i = 0; i < f->num; i++) {
+			if (f->global)
+				asm volatile("sfence.vma %0, zero" : : "r"(f->va[i]) : "memory");
+			else
+				asm volatile("sfence.vma %0, %1" : : "r"(f->va[i]), "r"(asid) : "memory");
 		}
+		return;
 	}
 
-	/* Now add leaf PTEs at the last level */
-	uint8_t leaf_level = g_num_levels - 1;
-	uint64_t *leaf_pt = get_pt_level(leaf_level);
+	/* With Svinval the invalidations don't order memory accesses on their
+	 * own, so that they can be pipelined, instead sfence.w.inval orders our
+	 * PTE stores before them and sfence.inval.ir orders them before any
+	 * implicit accesses that follow. Spelled out since not all assemblers
+	 * know about them. */
+	asm volatile(".word 0x18000073" ::: "memory");	/* sfence.w.inval */
+	for (unsigned int i = 0; i < f->num; i++) {
+		/* sinval.vma va, asid / va, x0 */
+		if (f->global)
+			asm volatile(".insn r 0x73, 0, 0x0b, x0, %0, x0" : : "r"(f->va[i]) : "memory");
+		else
+			asm volatile(".insn r 0x73, 0, 0x0b, x0, %0, %1"
+				     : : "r"(f->va[i]), "r"(asid) : "memory");
+	}
+	asm volatile(".word 0x18100073" ::: "memory");	/* sfence.inval.ir */
+}
 
-	if (leaf_pt == NULL) {
-		DBG("VA: Failed to get leaf page table\n");
-		return -EADDRNOTAVAIL;
+static void
+va_flush_local_all(void)
+{
+	asm volatile("sfence.vma zero, zero" ::: "memory");
+}
+
+/* Called through hart_call_mask() on the harts we shoot down */
+static void
+va_flush_ipi(uint64_t arg0, uint64_t arg1)
+{
+	struct va_flush *f = (struct va_flush *)(uintptr_t) arg0;
+	(void) arg1;
+	va_flush_local(f);
+	atomic_fetch_sub_explicit(&f->pending, 1, memory_order_release);
+}
+
+/* Flush f here, and on the other harts that may have translations of vs
+ * cached, with a single multicast IPI, waiting for them to finish. */
+static void
+va_flush_commit(const struct va_space *vs, struct va_flush *f)
+{
+	if (!f->num && !f->all)
+		return;
+
+	/* Order our PTE stores before reading the mask, against
+	 * hart_va_space_activate() setting it before loading satp. */
+	atomic_thread_fence(memory_order_seq_cst);
+	const uint64_t others = atomic_load_explicit(&vs->tlb_harts, memory_order_relaxed) &
+				~va_self_mask();
+	uint64_t targets = 0;
+	if (others) {
+		atomic_store_explicit(&f->pending, __builtin_popcountll(others),
+				      memory_order_relaxed);
+		targets = hart_call_mask(others, va_flush_ipi, (uintptr_t) f, 0);
+		/* The ones that didn't get it won't ack */
+		atomic_fetch_sub_explicit(&f->pending, __builtin_popcountll(others & ~targets),
+					  memory_order_relaxed);
 	}
 
-	/* Calculate how many PTEs we need */
-	size_t num_ptes = (*size + page_size - 1) / page_size;
-	size_t max_ptes = PAGE_SIZE / sizeof(uint64_t);
+	va_flush_local(f);
 
-	if (num_ptes > max_ptes)
-		num_ptes = max_ptes;
+	if (targets) {
+		while (atomic_load_explicit(&f->pending, memory_order_acquire))
+			pause();
+		DBG("VA: Shot down %u pages (asid=%u) on harts 0x%lx\n", f->all ? 0 : f->num,
+		    f->asid, targets);
+	}
+}
 
-	/* Update size with actual VA space we'll map */
-	*size = num_ptes * page_size;
+static int
+va_unmap_locked(struct va_space *vs, uintptr_t va, size_t size, struct va_flush *f)
+{
+	uint64_t *path[5] = { 0 };
+	const uintptr_t end = va + size;
+	uint8_t level = 0;
+
+	while (va < end) {
+		uint64_t *pte = va_walk_leaf(vs, va, path, &level);
+		if (pte == NULL) {
+			/* Nothing mapped here, skip to the next page */
+			va += PAGE_SIZE;
+			continue;
+		}
 
-	DBG("VA: Mapping PA 0x%lx -> VA 0x0 at level %u (%lu %s, %lu bytes total)\n",
-	    phys_addr, leaf_level, num_ptes, napot ? "64KB pages" : "4KB pages", *size);
+		/* We don't split superpages / NAPOT ranges */
+		size_t leaf_size = LEVEL_SIZE(level);
+		if (level == 0 && (*pte & PTE_N))
+			leaf_size = NAPOT_64KB_SIZE;
+		if ((va & (leaf_size - 1)) || (end - va) < leaf_size) {
+			DBG("VA: Can't unmap part of a %lu byte leaf at 0x%lx\n", leaf_size, va);
+			return -EINVAL;
+		}
 
-	/* Create leaf PTEs */
-	for (size_t i = 0; i < num_ptes; i++) {
-		uintptr_t pte_phys = phys_addr + (i * page_size);
-		uint64_t ppn = pte_phys >> 12;
-		uint64_t pte = (ppn << 10) | PTE_V | PTE_R | PTE_W | PTE_U | PTE_A | PTE_D;
+		if (leaf_size == NAPOT_64KB_SIZE) {
+			va_flush_add_napot(f, va, *pte);
+			memset(pte, 0, NAPOT_64KB_PTES * sizeof(uint64_t));
+		} else {
+			va_flush_add(f, va, *pte);
+			*pte = 0;
+		}
+
+		/* Release any tables this left empty, on the way up */
+		for (uint8_t cur = level; cur < vs->levels - 1; cur++) {
+			uint64_t *table = path[cur];
+			if (!va_table_empty(table))
+				break;
+			path[cur + 1][va_index(va, cur + 1)] = 0;
+			va_free_table(vs, table);
+		}
+		va += leaf_size;
+	}
+	return 0;
+}
+
+static int
+va_map_locked(struct va_space *vs, uintptr_t va, uintptr_t pa, size_t size, uint32_t flags,
+	      struct va_flush *f)
+{
+	const uintptr_t start = va;
+	const uintptr_t end = va + size;
+	uint64_t perms = (flags & PTE_PERM_MASK) | PTE_V | PTE_A | PTE_D;
+	int ret = 0;
+
+	if (flags & VA_MAP_IO)
+		perms |= PTE_PBMT_IO;
+	else if (flags & VA_MAP_NC)
+		perms |= PTE_PBMT_NC;
+
+	while (va < end) {
+		const size_t remaining = end - va;
+		uint8_t level = va_pick_level(vs, va, pa, remaining, flags);
+		bool napot = false;
+
+		if (level == 0 && (flags & VA_MAP_NAPOT) &&
+		    !((va | pa) & (NAPOT_64KB_SIZE - 1)) && remaining >= NAPOT_64KB_SIZE)
+			napot = true;
+
+		uint64_t *pte = va_walk_alloc(vs, va, level, &ret);
+		if (pte == NULL)
+			goto fail;
 
-		/* For NAPOT 64KB pages, set N bit and encode size in PPN[3:0] */
 		if (napot) {
-			/* Clear PPN[3:0] and set bit 3 for 64KB encoding */
-			pte &= ~(0xFULL << 10);
-			pte |= (0x8ULL << 10);
-			pte |= PTE_N;
+			/* All 16 PTEs of the range are identical, with the
+			 * N bit set and 0b1000 on the low 4 bits of the PPN */
+			for (unsigned int i = 0; i < NAPOT_64KB_PTES; i++) {
+				if (pte[i] & PTE_V) {
+					ret = -EEXIST;
+					goto fail;
+				}
+			}
+			uint64_t leaf = PA_TO_PTE(pa) | perms | PTE_N;
+			leaf &= ~(0xFULL << 10);
+			leaf |= (0x8ULL << 10);
+			for (unsigned int i = 0; i < NAPOT_64KB_PTES; i++)
+				pte[i] = leaf;
+			va_flush_add_napot(f, va, leaf);
+			va += NAPOT_64KB_SIZE;
+			pa += NAPOT_64KB_SIZE;
+			continue;
 		}
 
-		leaf_pt[i] = pte;
-		DBG("VA:   PTE[%lu] = 0x%016lx (PA 0x%lx)\n", i, pte, pte_phys);
+		if (*pte & PTE_V) {
+			ret = -EEXIST;
+			goto fail;
+		}
+		*pte = PA_TO_PTE(pa) | perms;
+		va_flush_add(f, va, *pte);
+		va += LEVEL_SIZE(level);
+		pa += LEVEL_SIZE(level);
 	}
 
-	/* Set SATP with the root page table and mode */
-	uint64_t *root_pt = get_pt_level(0);
-	uintptr_t root_pt_addr = (uintptr_t)root_pt;
-	uint64_t root_ppn = root_pt_addr >> 12;
-	uint64_t satp = (mode << 60) | root_ppn;
-
-	DBG("VA: Setting SATP to 0x%016lx (mode=%lu, root_ppn=0x%lx)\n", satp, mode, root_ppn);
-
-	/* Dump page table hierarchy for verification */
-	DBG("VA: Page table hierarchy dump:\n");
-	for (uint8_t level = 0; level < g_num_levels; level++) {
-		uint64_t *pt = get_pt_level(level);
-		uint64_t pte = pt[0];
-		DBG("VA:   Level %u @ PA 0x%lx:\n", level, (uintptr_t)pt);
-		DBG("VA:     PTE[0] = 0x%016lx\n", pte);
-		DBG("VA:     V=%d R=%d W=%d X=%d U=%d\n",
-		    !!(pte & PTE_V), !!(pte & PTE_R), !!(pte & PTE_W),
-		    !!(pte & PTE_X), !!(pte & PTE_U));
-		if (level < g_num_levels - 1) {
-			/* Non-leaf PTE */
-			uint64_t next_ppn = (pte >> 10) & 0xFFFFFFFFFFF;
-			DBG("VA:     Points to PA 0x%lx\n", next_ppn << 12);
-		} else {
-			/* Leaf PTE */
-			uint64_t ppn = (pte >> 10) & 0xFFFFFFFFFFF;
-			DBG("VA:     Maps to PA 0x%lx\n", ppn << 12);
+	/* The PTEs we filled were invalid, but an implementation
+	 * is still allowed to have them cached (see va_flush_commit). */
+	return 0;
+
+ fail:
+	DBG("VA: Mapping 0x%lx failed at 0x%lx (%i)\n", start, va, ret);
+	if (va > start)
+		va_unmap_locked(vs, start, va - start, f);
+	return ret;
+}
+
+/* Flushes the whole address space on every hart that may have it
+ * cached before freeing the tables, the ASID is then clean for reuse. */
+static void
+va_destroy_locked(struct va_space *vs)
+{
+	if (vs->root == NULL)
+		return;
+
+	struct va_flush f = {
+		.asid = vs->asid,
+		.global = vs->has_global,
+		.all = true,
+	};
+	va_flush_commit(vs, &f);
+	atomic_store_explicit(&vs->tlb_harts, 0, memory_order_relaxed);
+
+	DBG("VA: Freeing %lu page tables (mode=%lu, asid=%u)\n", vs->num_tables, vs->mode,
+	    vs->asid);
+	va_free_subtree(vs, vs->root, vs->levels - 1);
+	va_free_table(vs, vs->root);
+	vs->root = NULL;
+	vs->mode = 0;
+	vs->levels = 0;
+	vs->has_global = false;
+}
+
+static int
+va_setup_locked(struct va_space *vs, uint64_t mode)
+{
+	const uint8_t levels = va_mode_levels(mode);
+	if (!levels)
+		return -EINVAL;
+
+	va_destroy_locked(vs);
+	vs->root = va_alloc_table(vs);
+	if (vs->root == NULL)
+		return -ENOMEM;
+	vs->mode = mode;
+	vs->levels = levels;
+	DBG("VA: %u-level root table at 0x%lx (mode=%lu)\n", levels,
+	    (uintptr_t) vs->root, mode);
+	return 0;
+}
+
+/* satp.ASID is WARL, the bits that stick are the ones the hart implements
+ * (from the bottom), with the new space's tables so that mode sticks too.
+ * We are in M-mode so nothing gets translated in the meantime. */
+static void
+va_probe_asids(const struct va_space *vs)
+{
+	const uint64_t saved_satp = csr_read(CSR_SATP);
+	const uint64_t test_satp = FIELD_PREP_ULL(CSR_SATP_MODE, vs->mode) |
+				   FIELD_PREP_ULL(CSR_SATP_ASID, 0xFFFF) |
+				   FIELD_PREP_ULL(CSR_SATP_PPN, (uintptr_t) vs->root >> PAGE_SHIFT);
+	csr_write(CSR_SATP, test_satp);
+	const uint64_t readback = csr_read(CSR_SATP);
+	csr_write(CSR_SATP, saved_satp);
+
+	/* Try again with the next space if the mode isn't supported */
+	if (FIELD_GET_ULL(CSR_SATP_MODE, readback) != vs->mode)
+		return;
+	const uint32_t num = (uint32_t) FIELD_GET_ULL(CSR_SATP_ASID, readback) + 1;
+	va_num_asids = (num > VA_MAX_ASIDS) ? VA_MAX_ASIDS : num;
+	DBG("VA: %u ASIDs available\n", va_num_asids);
+}
+
+/* Returns 0 if we are out of them */
+static uint16_t
+va_asid_alloc(void)
+{
+	for (uint16_t asid = 1; asid < va_num_asids; asid++) {
+		uint64_t *word = &va_asid_map[asid / 64];
+		if (!(*word & (1ULL << (asid % 64)))) {
+			*word |= (1ULL << (asid % 64));
+			return asid;
 		}
 	}
+	return 0;
+}
 
-	csr_write(CSR_SATP, satp);
+static void
+va_asid_free(uint16_t asid)
+{
+	if (asid)
+		va_asid_map[asid / 64] &= ~(1ULL << (asid % 64));
+}
 
-	/* Sync TLB */
-	asm volatile("sfence.vma zero, zero" ::: "memory");
+static int
+va_space_map(struct va_space *vs, uintptr_t va, uintptr_t pa, size_t size, uint32_t flags)
+{
+	struct va_flush f = { 0 };
+	int ret = 0;
+
+	if (!size || ((va | pa | size) & (PAGE_SIZE - 1)))
+		return -EINVAL;
+	if (!(flags & (VA_MAP_R | VA_MAP_X)))
+		return -EINVAL;
+	if ((flags & (VA_MAP_NC | VA_MAP_IO)) == (VA_MAP_NC | VA_MAP_IO))
+		return -EINVAL;
+	/* Without Svpbmt these bits are reserved, and would fault */
+	if ((flags & (VA_MAP_NC | VA_MAP_IO)) && !va_has_svpbmt)
+		return -ENOTSUP;
 
-	/* Read back and verify mode stuck */
-	uint64_t satp_readback = csr_read(CSR_SATP);
-	uint64_t mode_readback = satp_readback >> 60;
+	sdk_lock_acquire(&va_lock);
+	if (vs->root == NULL)
+		ret = -ENODEV;
+	else if (!va_range_valid(vs, va, size))
+		ret = -EFAULT;
+	else {
+		f.asid = vs->asid;
+		ret = va_map_locked(vs, va, pa, size, flags, &f);
+		if (!ret && (flags & VA_MAP_G))
+			vs->has_global = true;
+		va_flush_commit(vs, &f);
+	}
+	sdk_lock_release(&va_lock);
 
-	DBG("VA: SATP readback: 0x%016lx\n", satp_readback);
+	DBG("VA: Map 0x%lx -> PA 0x%lx (%lu bytes, flags: 0x%x): %i\n",
+	    va, pa, size, flags, ret);
+	return ret;
+}
 
-	if (mode_readback != mode) {
-		DBG("VA: SATP mode %lu didn't stick (got %lu)\n", mode, mode_readback);
-		/* Clean up */
-		size_t zero_size = 0;
-		hart_va_map_range(0, &zero_size, 0, false);
+static int
+va_space_unmap(struct va_space *vs, uintptr_t va, size_t size)
+{
+	struct va_flush f = { 0 };
+	int ret = 0;
+
+	if (!size || ((va | size) & (PAGE_SIZE - 1)))
+		return -EINVAL;
+
+	sdk_lock_acquire(&va_lock);
+	if (vs->root == NULL)
+		ret = -ENODEV;
+	else if (!va_range_valid(vs, va, size))
+		ret = -EFAULT;
+	else {
+		f.asid = vs->asid;
+		/* Flush whatever we removed, even if we stopped half-way */
+		ret = va_unmap_locked(vs, va, size, &f);
+		va_flush_commit(vs, &f);
+	}
+	sdk_lock_release(&va_lock);
+	return ret;
+}
+
+static int
+va_space_translate(struct va_space *vs, uintptr_t va, uintptr_t *pa, size_t *leaf_size)
+{
+	uint8_t level = 0;
+	int ret = 0;
+
+	sdk_lock_acquire(&va_lock);
+	uint64_t *pte = (vs->root && va_range_valid(vs, va, 1)) ?
+			va_walk_leaf(vs, va, NULL, &level) : NULL;
+	if (pte == NULL)
+		ret = -ENOENT;
+	else {
+		size_t size = LEVEL_SIZE(level);
+		uintptr_t base = PTE_TO_PA(*pte);
+		if (level == 0 && (*pte & PTE_N)) {
+			size = NAPOT_64KB_SIZE;
+			base &= ~(NAPOT_64KB_SIZE - 1);
+		}
+		*pa = base + (va & (size - 1));
+		if (leaf_size)
+			*leaf_size = size;
+	}
+	sdk_lock_release(&va_lock);
+	return ret;
+}
+
+static void
+va_set_current(struct va_space *vs)
+{
+	struct va_space **cur = this_cpu_ptr(&va_current);
+	const uint64_t self = va_self_mask();
+	if (*cur == vs)
+		return;
+	if (*cur)
+		atomic_fetch_and(&(*cur)->active_harts, ~self);
+	if (vs)
+		atomic_fetch_or(&vs->active_harts, self);
+	*cur = vs;
+}
+
+static int
+va_space_activate(struct va_space *vs)
+{
+	if (vs->root == NULL)
+		return -ENODEV;
+
+	const uint64_t root_ppn = (uintptr_t) vs->root >> PAGE_SHIFT;
+	const uint64_t satp = FIELD_PREP_ULL(CSR_SATP_MODE, vs->mode) |
+			      FIELD_PREP_ULL(CSR_SATP_ASID, vs->asid) |
+			      FIELD_PREP_ULL(CSR_SATP_PPN, root_ppn);
+	DBG("VA: Setting SATP to 0x%016lx (mode=%lu, asid=%u, root_ppn=0x%lx)\n", satp,
+	    vs->mode, vs->asid, root_ppn);
+	/* PBMT bits are only honored with menvcfg.PBMTE set */
+	if (va_has_svpbmt)
+		csr_set_bits(CSR_MENVCFG, CSR_MENVCFG_PBMTE);
+	/* From now on changes to vs get flushed here too */
+	atomic_fetch_or(&vs->tlb_harts, va_self_mask());
+	csr_write(CSR_SATP, satp);
+
+	/* Read back and verify mode stuck */
+	const uint64_t mode_readback = FIELD_GET_ULL(CSR_SATP_MODE, csr_read(CSR_SATP));
+	if (mode_readback != vs->mode) {
+		DBG("VA: SATP mode %lu didn't stick (got %lu)\n", vs->mode, mode_readback);
+		csr_write(CSR_SATP, 0);
+		va_flush_local_all();
+		va_set_current(NULL);
 		return -ENOTSUP;
 	}
 
+	/* Spaces without an ASID share ASID 0, what's cached
+	 * for it may come from another one. */
+	if (vs->asid == 0)
+		va_flush_local_all();
+	va_set_current(vs);
 	return 0;
 }
+
+/**************\
+* Entry points *
+\**************/
+
+/*
+ * Start a new (empty) set of page tables for mode (SATP_MODE_SV39/48/57),
+ * replacing the previous one if any. Returns -EINVAL for other modes,
+ * -ENOMEM if we couldn't get a page for the root table.
+ */
+int
+hart_va_init(uint64_t mode)
+{
+	sdk_lock_acquire(&va_lock);
+	int ret = va_setup_locked(&va_default, mode);
+	sdk_lock_release(&va_lock);
+	return ret;
+}
+
+/*
+ * Map [va, va + size) to [pa, pa + size) with the given VA_MAP_* flags,
+ * va / pa / size must be 4KB aligned. Fails with -EEXIST if part of the
+ * range is already mapped, -ENOMEM if we ran out of pages for the tables,
+ * in which case nothing gets mapped, or -ENOTSUP for VA_MAP_NC / VA_MAP_IO
+ * without Svpbmt.
+ */
+int
+hart_va_map(uintptr_t va, uintptr_t pa, size_t size, uint32_t flags)
+{
+	return va_space_map(&va_default, va, pa, size, flags);
+}
+
+/*
+ * Remove any mappings in [va, va + size), superpages / NAPOT ranges must be
+ * removed as a whole (-EINVAL otherwise), page tables left empty are freed.
+ */
+int
+hart_va_unmap(uintptr_t va, size_t size)
+{
+	return va_space_unmap(&va_default, va, size);
+}
+
+/*
+ * Walk the tables in software, returns the physical address va is mapped
+ * to on *pa, and the size of the leaf that maps it on *leaf_size (if not
+ * NULL), -ENOENT if it isn't mapped.
+ */
+int
+hart_va_translate(uintptr_t va, uintptr_t *pa, size_t *leaf_size)
+{
+	return va_space_translate(&va_default, va, pa, leaf_size);
+}
+
+/* Number of page frames used for the tables, including the root */
+size_t
+hart_va_num_tables(void)
+{
+	return va_default.num_tables;
+}
+
+/*
+ * Load the tables on this hart's satp, returns -ENOTSUP if the
+ * hart doesn't support the mode (it's left in Bare mode then).
+ */
+int
+hart_va_activate(void)
+{
+	return va_space_activate(&va_default);
+}
+
+/* Switch this hart back to Bare mode, whatever space it had active,
+ * its translations stay cached (tagged) for when it comes back. */
+void
+hart_va_deactivate(void)
+{
+	csr_write(CSR_SATP, 0);
+	va_set_current(NULL);
+}
+
+/* Switch this hart to Bare mode and free all page tables,
+ * other harts should have switched to Bare mode already. */
+void
+hart_va_destroy(void)
+{
+	hart_va_deactivate();
+	sdk_lock_acquire(&va_lock);
+	va_destroy_locked(&va_default);
+	sdk_lock_release(&va_lock);
+}
+
+/*
+ * Create a new (empty) address space for mode (SATP_MODE_SV39/48/57), with
+ * its own ASID if there are any left. Returns NULL for other modes or if
+ * we are out of memory. Use the hart_va_space_*() variants of the above
+ * with it.
+ */
+struct va_space *
+hart_va_space_create(uint64_t mode)
+{
+	struct va_space *vs = malloc(sizeof(struct va_space));
+	if (vs == NULL)
+		return NULL;
+	memset(vs, 0, sizeof(struct va_space));
+
+	sdk_lock_acquire(&va_lock);
+	int ret = va_setup_locked(vs, mode);
+	if (!ret) {
+		if (!va_num_asids)
+			va_probe_asids(vs);
+		vs->asid = va_asid_alloc();
+	}
+	sdk_lock_release(&va_lock);
+
+	if (ret) {
+		free(vs);
+		return NULL;
+	}
+	DBG("VA: New address space with asid %u\n", vs->asid);
+	return vs;
+}
+
+/*
+ * Free vs, its page tables and its ASID, switching this hart to Bare mode
+ * if it has it active. Returns -EBUSY if another hart has it active.
+ */
+int
+hart_va_space_destroy(struct va_space *vs)
+{
+	if (vs == NULL)
+		return -EINVAL;
+	if (atomic_load(&vs->active_harts) & ~va_self_mask())
+		return -EBUSY;
+	if (*this_cpu_ptr(&va_current) == vs)
+		hart_va_deactivate();
+
+	sdk_lock_acquire(&va_lock);
+	va_destroy_locked(vs);
+	va_asid_free(vs->asid);
+	sdk_lock_release(&va_lock);
+	free(vs);
+	return 0;
+}
+
+int
+hart_va_space_map(struct va_space *vs, uintptr_t va, uintptr_t pa, size_t size,
+		  uint32_t flags)
+{
+	return va_space_map(vs, va, pa, size, flags);
+}
+
+int
+hart_va_space_unmap(struct va_space *vs, uintptr_t va, size_t size)
+{
+	return va_space_unmap(vs, va, size);
+}
+
+int
+hart_va_space_translate(struct va_space *vs, uintptr_t va, uintptr_t *pa, size_t *leaf_size)
+{
+	return va_space_translate(vs, va, pa, leaf_size);
+}
+
+/* Switch this hart to vs, without flushing the TLB if it has an ASID */
+int
+hart_va_space_activate(struct va_space *vs)
+{
+	return va_space_activate(vs);
+}
+
+/* The ASID vs got, 0 if it shares ASID 0 with the default space */
+uint16_t
+hart_va_space_asid(const struct va_space *vs)
+{
+	return vs->asid;
+}
+
+/*
+ * Map a physical address range to virtual address 0 (user accessible,
+ * read/write) and activate it on this hart, replacing any previous
+ * mappings, used by the MMU probe (see hart_probe.c).
+ *
+ * phys_addr: Physical address to map (must be aligned to 4KB / 64KB)
+ * size: Pointer to size in bytes, updated with actual VA space mapped
+ * mode: SATP mode (SATP_MODE_SV39/48/57)
+ * napot: Use 64KB NAPOT pages if true, otherwise 4KB pages / superpages
+ *
+ * If size is 0, frees the page tables and goes back to Bare mode.
+ *
+ * Returns: 0 on success, -errno on failure
+ */
+int
+hart_va_map_range(uintptr_t phys_addr, size_t *size, uint64_t mode, bool napot)
+{
+	if (*size == 0) {
+		hart_va_destroy();
+		return 0;
+	}
+
+	const uintptr_t page_size = napot ? NAPOT_64KB_SIZE : PAGE_SIZE;
+	if (phys_addr & (page_size - 1)) {
+		DBG("VA: Physical address 0x%lx not aligned to %lu bytes\n",
+		    phys_addr, page_size);
+		return -EADDRNOTAVAIL;
+	}
+	*size = (*size + page_size - 1) & ~(page_size - 1);
+
+	hart_va_deactivate();
+	int ret = hart_va_init(mode);
+	if (ret)
+		return (ret == -EINVAL) ? -ENOTSUP : ret;
+
+	ret = hart_va_map(0, phys_addr, *size, VA_MAP_RW | VA_MAP_U |
+			  (napot ? VA_MAP_NAPOT : 0));
+	if (!ret)
+		ret = hart_va_activate();
+	if (ret) {
+		hart_va_destroy();
+		*size = 0;
+	}
+	return ret;
+}
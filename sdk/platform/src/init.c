@@ -17,60 +17,107 @@
 #include <platform/interfaces/uart.h>	/* For uart_init() */
 #include <platform/riscv/csr.h>		/* For csr_read()/pause() */
 #include <platform/riscv/hart.h>	/* For hart_get_count/state() */
+#include <platform/riscv/mtimer.h>	/* For mtimer_get_num_ticks() */
 #include <platform/utils/utils.h>	/* For console output */
+#include <platform/utils/boot_prof.h>	/* For boot_prof_mark() */
 
-void
-platform_init_default(void)
+#if (PLAT_MAX_HARTS > 1)
+
+#if defined(PLAT_HART_MASK)
+	#define PLAT_BOOT_HARTS	__builtin_popcountll(PLAT_HART_MASK)
+	_Static_assert(__builtin_popcountll(PLAT_HART_MASK) <= PLAT_MAX_HARTS,
+		       "PLAT_HART_MASK has more harts than PLAT_MAX_HARTS");
+#else
+	#define PLAT_BOOT_HARTS	PLAT_MAX_HARTS
+#endif
+
+/* Secondary harts check in by grabbing an index through the hart counter
+ * in start.S, initializing their hart_state, and setting HS_FLAG_ONLINE
+ * on entry to hart_init(). We count them in in index order, as soon as we
+ * have all the harts we expect (PLAT_HART_MASK, or PLAT_MAX_HARTS) we are
+ * done, else we give up at PLAT_SMP_BOOT_TIMEOUT_US, on mtime if we have
+ * it (mcycle may still be inhibited here), or else on a bounded number of
+ * pause() iterations, each of them takes at least a cycle. */
+static void
+platform_wait_for_harts(void)
 {
-	uart_init();
-	ANN("BareMetal loader (c) FORTH/CARV 2026\n\r");
-	ANN("------------------------------------\n\r");
-	DBG("Boot hart_id: %li\n", csr_read(CSR_MHARTID));
+	#if defined(PLAT_HAS_MTIMER)
+		const uint64_t timeout = (uint64_t) PLAT_MTIMER_FREQ * PLAT_SMP_BOOT_TIMEOUT_US / 1000000;
+		const uint64_t start = mtimer_get_num_ticks();
+		#define PLAT_BOOT_ELAPSED()	(mtimer_get_num_ticks() - start)
+	#else
+		const uint64_t timeout = (uint64_t) PLAT_HART_FREQ / 1000000 * PLAT_SMP_BOOT_TIMEOUT_US;
+		uint64_t iterations = 0;
+		#define PLAT_BOOT_ELAPSED()	(iterations++)
+	#endif
+	uint16_t online = 1;
 
-	#if (PLAT_MAX_HARTS > 1)
-		/* Give some time for secondary harts to reach Lcounter_ready in start.S */
-		uint32_t current_count = hart_get_count();
-		uint32_t last_count = 0;
-		uint32_t stable_checks = 0;
-		uint32_t max_stable_checks = PLAT_MAX_HARTS * 10000000;
-
-		/* Wait until we either get PLAT_MAX_HARTS registered or
-		 * the counter remains stable for max_stable_checks checks. */
-		while (stable_checks < max_stable_checks) {
-			current_count = hart_get_count();
-
-			if (current_count == PLAT_MAX_HARTS)
+	while (1) {
+		uint16_t count = hart_get_count();
+		if (count > PLAT_MAX_HARTS)
+			count = PLAT_MAX_HARTS;
+
+		while (online < count) {
+			struct hart_state *hs = hart_get_hstate_by_idx(online);
+			if (!hart_test_flags(hs, HS_FLAG_ONLINE) || hs->hart_idx != online)
 				break;
+			online++;
+		}
 
-			if (current_count == last_count)
-				stable_checks ++;
-			else {
-				stable_checks = 0;
-				last_count = current_count;
-			}
+		if (online >= PLAT_BOOT_HARTS || PLAT_BOOT_ELAPSED() >= timeout)
+			break;
 
-			/* Give boot hart some room to breathe */
-			pause();
-		}
+		/* Give boot hart some room to breathe */
+		pause();
+	}
+	#undef PLAT_BOOT_ELAPSED
 
-		/* Verify consistency of hart_state structs */
-		for (int i = 0; i < current_count; i++) {
-			struct hart_state *hs = hart_get_hstate_by_idx(i);
-			if (hs->hart_idx != i) {
-				hart_set_count(i + 1);
-				current_count = hart_get_count();
-				WRN("Hart initialization for idx: %i incomplete, truncated counter to: %i\n",
-				    i, current_count);
-				break;
-			}
+	/* Harts that got an index but didn't make it in time are left out */
+	if (hart_get_count() != online) {
+		WRN("Only harts up to idx %i checked in, truncated counter to: %i\n",
+		    online - 1, online);
+		hart_set_count(online);
+	}
+
+	#if defined(PLAT_HART_MASK)
+		uint64_t missing = PLAT_HART_MASK;
+		for (int i = 0; i < online; i++) {
+			const uint64_t hart_id = hart_get_hstate_by_idx(i)->hart_id;
+			if (hart_id >= 64 || !(missing & (1ULL << hart_id)))
+				WRN("Unexpected hart_id %li at idx %i\n", hart_id, i);
+			else
+				missing &= ~(1ULL << hart_id);
 		}
+		for (int i = 0; missing; i++, missing >>= 1)
+			if (missing & 1)
+				WRN("Hart with hart_id %i didn't check in\n", i);
+	#endif
+
+	/* Clean up boot counter_status (on __data_end[0])to prevent warm reboot issues
+	 * in case our ram retains the "ready" value. */
+	atomic_store((uint32_t*)((uintptr_t)__data_end), 0);
+	#if defined(LZ4_BOOT)
+		/* Same for the boot stage's "image ready" word */
+		atomic_store((uint32_t*)((uintptr_t)__data_end + 8), 0);
+	#endif
 
-		/* Clean up boot counter_status (on __data_end[0])to prevent warm reboot issues
-		 * in case our ram retains the "ready" value. */
-		atomic_store((uint32_t*)((uintptr_t)__data_end), 0);
+	INF("Got %i secondary harts out of %i maximum\n", online - 1, PLAT_MAX_HARTS);
+}
+#endif
+
+void
+platform_init_default(void)
+{
+	uart_init();
+	boot_prof_mark(BOOT_PHASE_UART);
+	ANN("BareMetal loader (c) FORTH/CARV 2026\n\r");
+	ANN("------------------------------------\n\r");
+	DBG("Boot hart_id: %li\n", csr_read(CSR_MHARTID));
 
-		INF("Got %i secondary harts out of %i maximum\n", current_count, PLAT_MAX_HARTS);
+	#if (PLAT_MAX_HARTS > 1)
+		platform_wait_for_harts();
 	#endif
+	boot_prof_mark(BOOT_PHASE_SMP);
 
 	#if defined(DEBUG)
 		/* Platform interrupt controller mapping */
@@ -92,6 +139,7 @@ platform_init_default(void)
 
 	DBG("Calling irq_init()...\n");
 	irq_init();
+	boot_prof_mark(BOOT_PHASE_IRQ);
 }
 
 /* Platform-specific code may override this and use a custom platform_init().
@@ -0,0 +1,110 @@
+/*
+ * SPDX-FileType: SOURCE
+ *
+ * SPDX-FileCopyrightText: 2026 Nick Kossifidis <mick@ics.forth.gr>
+ * SPDX-FileCopyrightText: 2026 ICS/FORTH
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <target_config.h>		/* For PLAT_MAX_HARTS / PLAT_IPI_FANOUT */
+#include <platform/interfaces/ipi.h>	/* For IPI interface definitions */
+#include <platform/riscv/hart.h>	/* For hart state and macros (includes stdatomic.h) */
+
+#ifndef PLAT_NO_IPI
+
+_Static_assert(PLAT_MAX_HARTS <= 64, "hartmask_t only covers 64 harts");
+
+/* In ipi_mswi.c / ipi_imsic.c */
+extern void __ipi_send_batch(hartmask_t mask, enum ipi_type type);
+
+/*
+ * Multicast IPIs: by default the sender sets every target's ipi_mask and
+ * then does all the MMIO writes back to back (see __ipi_send_batch), that
+ * is still one uncached store per target. With PLAT_IPI_FANOUT set (> 1)
+ * in target_config.h, when there are more targets than that, the sender
+ * only sends the IPI to PLAT_IPI_FANOUT of them, and they forward it to
+ * the rest from their IPI handler (ipi_forward()), in a tree, so that a
+ * broadcast to N harts takes ~log(N) steps of PLAT_IPI_FANOUT stores.
+ *
+ * The targets are split in PLAT_IPI_FANOUT groups of consecutive hart
+ * indices, the first hart of each group gets the IPI, and the rest of
+ * its group in its per-type forwarding mask. Forwarding masks are only
+ * ever OR-ed in and swapped out, so concurrent multicasts through the
+ * same hart just get merged. Note that forwarding happens in interrupt
+ * context, so a hart with interrupts blocked also delays its subtree.
+ */
+
+#if defined(PLAT_IPI_FANOUT) && (PLAT_IPI_FANOUT > 1)
+
+#define IPI_NUM_TYPES	16
+
+static _Atomic(hartmask_t) ipi_fwd_masks[PLAT_MAX_HARTS][IPI_NUM_TYPES];
+
+static void
+ipi_send_tree(hartmask_t mask, enum ipi_type type)
+{
+	const int type_idx = __builtin_ctz((unsigned int) type);
+	const int num_targets = __builtin_popcountll(mask);
+	const int group_size = (num_targets + PLAT_IPI_FANOUT - 1) / PLAT_IPI_FANOUT;
+	hartmask_t children = 0;
+
+	while (mask) {
+		hartmask_t group = 0;
+		for (int i = 0; i < group_size && mask; i++) {
+			group |= mask & -mask;
+			mask &= mask - 1;
+		}
+		const int child = __builtin_ctzll(group);
+		group &= ~HARTMASK(child);
+		/* Make it visible before the IPI */
+		if (group)
+			atomic_fetch_or_explicit(&ipi_fwd_masks[child][type_idx], group,
+						 memory_order_release);
+		children |= HARTMASK(child);
+	}
+	__ipi_send_batch(children, type);
+}
+
+#endif
+
+/**************\
+* ENTRY POINTS *
+\**************/
+
+void
+ipi_send_mask(hartmask_t mask, enum ipi_type type)
+{
+	#if (PLAT_MAX_HARTS < 64)
+		mask &= HARTMASK(PLAT_MAX_HARTS) - 1;
+	#endif
+	if (!mask)
+		return;
+
+	#if defined(PLAT_IPI_FANOUT) && (PLAT_IPI_FANOUT > 1)
+		if (__builtin_popcountll(mask) > PLAT_IPI_FANOUT) {
+			ipi_send_tree(mask, type);
+			return;
+		}
+	#endif
+	__ipi_send_batch(mask, type);
+}
+
+void
+ipi_forward(uint16_t ipi_mask)
+{
+	#if defined(PLAT_IPI_FANOUT) && (PLAT_IPI_FANOUT > 1)
+		struct hart_state *hs = hart_get_hstate_self();
+		for (uint16_t m = ipi_mask; m; m &= m - 1) {
+			const int type_idx = __builtin_ctz(m);
+			hartmask_t rest = atomic_exchange_explicit(&ipi_fwd_masks[hs->hart_idx][type_idx],
+								   0, memory_order_acquire);
+			if (rest)
+				ipi_send_mask(rest, (enum ipi_type) (1U << type_idx));
+		}
+	#else
+		(void) ipi_mask;
+	#endif
+}
+
+#endif /* PLAT_NO_IPI */
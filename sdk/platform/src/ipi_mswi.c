@@ -12,6 +12,7 @@
 #include <platform/riscv/csr.h>		/* For csr_read/write() */
 #include <platform/riscv/hart.h>	/* For hart state and macros (includes stdatomic.h) */
 #include <platform/riscv/mmio.h>	/* For mmio access to remote hstate/MSIP */
+#include <platform/utils/trap_trace.h>	/* For TRAP_TRACE_* hooks */
 
 #if defined(PLAT_HAS_MSWI) && (PLAT_IMSIC_IPI_EIID == 0)
 
@@ -24,15 +25,32 @@
 void
 ipi_send(struct hart_state* target_hs, enum ipi_type type)
 {
+	TRAP_TRACE_EVENT(TRAP_TRACE_IPI_SEND, type, HARTMASK(target_hs->hart_idx));
 	hart_set_ipi(target_hs, (uint16_t) type);
 	write32(MSIP_BASE(target_hs->hart_id), 1);
 }
 
+/* Set everyone's ipi_mask first, and then hit their MSIP registers
+ * back to back, with a single barrier in front. */
+void
+__ipi_send_batch(hartmask_t mask, enum ipi_type type)
+{
+	TRAP_TRACE_EVENT(TRAP_TRACE_IPI_SEND, type, mask);
+	for (hartmask_t m = mask; m; m &= m - 1)
+		hart_set_ipi(hart_get_hstate_by_idx(__builtin_ctzll(m)), (uint16_t) type);
+	__io_bw();
+	for (hartmask_t m = mask; m; m &= m - 1) {
+		struct hart_state *hs = hart_get_hstate_by_idx(__builtin_ctzll(m));
+		write32_relaxed(MSIP_BASE(hs->hart_id), 1);
+	}
+}
+
 /* Same for self-ipis */
 void
 ipi_self(enum ipi_type type)
 {
 	struct hart_state *hs = hart_get_hstate_self();
+	TRAP_TRACE_EVENT(TRAP_TRACE_IPI_SEND, type, HARTMASK(hs->hart_idx));
 	hart_set_ipi(hs, (uint16_t) type);
 	write32(MSIP_BASE(hs->hart_id), 1);
 }
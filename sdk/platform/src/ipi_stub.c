@@ -14,7 +14,9 @@
 
 void ipi_init(void) { return; }
 void ipi_send(struct hart_state* target_hstate, enum ipi_type type) { return; }
+void ipi_send_mask(hartmask_t mask, enum ipi_type type) { return; }
 void ipi_self(enum ipi_type type) { return; }
+void ipi_forward(uint16_t ipi_mask) { return; }
 void ipi_clear(void) { return; }
 
 #endif
\ No newline at end of file
@@ -12,6 +12,8 @@
 #include <platform/riscv/hart.h>	/* For hart state and operations */
 #include <platform/riscv/mmio.h>	/* For APLIC register access */
 #include <platform/utils/utils.h>	/* For console output */
+#include <platform/utils/irq_stats.h>	/* For IRQ_STATS_* hooks */
+#include <platform/utils/trap_trace.h>	/* For TRAP_TRACE_* hooks */
 #include <platform/utils/bitfield.h>	/* For BIT/FIELD macros */
 
 #include <errno.h>			/* For error constants */
@@ -171,6 +173,7 @@ int __attribute__((weak))
 irq_init(void)
 {
 	DBG("APLIC irq_init starting (mode=%s)\n", APLIC_USES_IMSIC ? "IMSIC" : "direct");
+	irq_build_srcmap();
 
 	/*
 	 * Initialize APLIC to clean state
@@ -324,10 +327,10 @@ irq_source_enable(uint16_t source_id)
 	if (irq_sm == NULL)
 		return;
 
-	int target_idx = irq_get_target_idx_for_hart(irq_sm->target_hart);
+	int target_idx = irq_get_target_idx_for_hart(irq_get_target_hart(irq_sm));
 	if (target_idx < 0) {
 		ERR("Attempted to enable interrupt for unmapped target (source: %i, target: %i)\n",
-		    source_id, irq_sm->target_hart);
+		    source_id, irq_get_target_hart(irq_sm));
 		return;
 	}
 
@@ -353,7 +356,7 @@ irq_source_enable(uint16_t source_id)
 		write32(TARGET(source_id), target_val);
 
 		/* Also enable the eeid on target hart's IMSIC */
-		hart_configure_imsic_eiid(irq_sm->target_hart, source_id, 1);
+		hart_configure_imsic_eiid(irq_get_target_hart(irq_sm), source_id, 1);
 	#else
 		/*
 		 * Direct delivery mode: Set target register with IDC index and priority
@@ -398,7 +401,7 @@ irq_source_disable(uint16_t source_id)
 
 	#if !APLIC_USES_IMSIC
 		/* In direct mode, also clear the target priority */
-		int target_idx = irq_get_target_idx_for_hart(irq_sm->target_hart);
+		int target_idx = irq_get_target_idx_for_hart(irq_get_target_hart(irq_sm));
 		if (target_idx < 0)
 			return;
 
@@ -407,19 +410,106 @@ irq_source_disable(uint16_t source_id)
 		write32(TARGET(source_id), target_val);
 	#else
 		/* Also disable the eeid on target hart's IMSIC */
-		hart_configure_imsic_eiid(irq_sm->target_hart, source_id, 0);
+		hart_configure_imsic_eiid(irq_get_target_hart(irq_sm), source_id, 0);
 	#endif
 }
 
+/* Point an enabled source to another hart, the source stays pending
+ * on APLIC while it's disabled, so nothing gets lost in between. */
+int __attribute__((weak))
+irq_source_retarget(uint16_t source_id, uint16_t from_hart, uint16_t to_hart)
+{
+	if (source_id == 0 || source_id > PLAT_NUM_IRQ_SOURCES)
+		return -EINVAL;
+
+	int target_idx = irq_get_target_idx_for_hart(to_hart);
+	if (target_idx < 0)
+		return -ENODEV;
+
+	/* Not enabled, irq_source_enable() will handle it */
+	if (!(read32(SETIE(source_id)) & BIT(source_id & 31)))
+		return 0;
+
+	write32(CLRIENUM, source_id);
+	#if APLIC_USES_IMSIC
+		/* Enable the eiid on the new hart before it can get an MSI, we
+		 * leave it enabled on the old one so that it still handles any
+		 * MSI that was on its way, it won't get any more of them. */
+		hart_configure_imsic_eiid(to_hart, source_id, 1);
+		write32(TARGET(source_id), FIELD_PREP(TARGET_EIID, source_id) |
+					   FIELD_PREP(TARGET_HIDX, target_idx));
+	#else
+		uint32_t target_val = read32(TARGET(source_id));
+		target_val &= ~TARGET_HIDX;
+		target_val |= FIELD_PREP(TARGET_HIDX, target_idx);
+		write32(TARGET(source_id), target_val);
+		write32(IDC_IDELIVERY(target_idx), 1);
+	#endif
+	write32(SETIENUM, source_id);
+	DBG("Moved source %i from hart %i to hart %i\n", source_id, from_hart, to_hart);
+	return 0;
+}
+
+/* Call the handler of a claimed source, idc is only used in direct mode */
+static inline void
+aplic_handle_source(uint16_t idc, uint16_t source_id)
+{
+	const struct irq_source_mapping *irq_sm = irq_get_srcmap(source_id);
+	if (irq_sm == NULL) {
+		ERR("Got interrupt from unmapped source: %i\n", source_id);
+		return;
+	}
+
+	DBG("Calling handler for interrupt source: %i\n", source_id);
+
+	/* Got mapping, call the associated interrupt handler */
+	IRQ_STATS_STAMP(dispatch);
+	TRAP_TRACE_STAMP(trace_start);
+	#if defined(IRQ_NESTED)
+		struct irq_nest_state ns;
+		#if APLIC_USES_IMSIC
+			/* On IMSIC the eiid is the priority, only lower
+			 * eiids get through (eithreshold is inclusive). */
+			csr_write(CSR_MISELECT, 0x72);
+			const uint64_t threshold = csr_read(CSR_MIREG);
+			csr_write(CSR_MIREG, source_id);
+		#else
+			/* Only sources with a lower priority number
+			 * get through (ithreshold is inclusive). */
+			const uint32_t threshold = read32(IDC_ITHRESHOLD(idc));
+			write32(IDC_ITHRESHOLD(idc), aplic_map_priority(irq_sm->priority));
+		#endif
+		irq_nest_enter(&ns);
+		irq_sm->handler((uint16_t) source_id);
+		irq_nest_exit(&ns);
+		#if APLIC_USES_IMSIC
+			/* A preempting handler may have used miselect */
+			csr_write(CSR_MISELECT, 0x72);
+			csr_write(CSR_MIREG, threshold);
+		#else
+			write32(IDC_ITHRESHOLD(idc), threshold);
+		#endif
+	#else
+		irq_sm->handler((uint16_t) source_id);
+	#endif
+	IRQ_STATS_RECORD(source_id, dispatch);
+	TRAP_TRACE_RECORD(TRAP_TRACE_IRQ, source_id, irq_sm->handler, trace_start);
+}
+
 /*
  * Main interrupt dispatch handler - called from trap handler
  * This is called when an external interrupt is pending
  *
  * APLIC direct mode uses CLAIMI register to atomically claim
  * and clear pending interrupts. Unlike PLIC, there's no separate
- * completion step - the interrupt is completed when claimed.
+ * completion step - the interrupt is completed when claimed. We keep
+ * claiming until there's nothing left or we handled PLAT_IRQ_DISPATCH_BUDGET
+ * sources, so that a burst of interrupts is handled on a single trap.
+ *
+ * In MSI mode the trap handler claims the eiid from IMSIC (and does
+ * the same loop there, see hart.c), so we only handle that one.
  */
-void __attribute__((weak))
+void __hot __attribute__((weak))
 irq_dispatch(uint16_t eiid)
 {
 	struct hart_state* hs = hart_get_hstate_self();
@@ -430,30 +520,30 @@ irq_dispatch(uint16_t eiid)
 
 	#if !APLIC_USES_IMSIC
 		uint16_t idc = platform_intc_map[hs->irq_map_idx].target.idc_idx;
-		/*
-		 * Claim the interrupt from APLIC
-		 * This returns the highest priority pending interrupt source
-		 * and atomically clears the corresponding pending bit
-		 */
-		uint32_t claimi = read32(IDC_CLAIMI(idc));
-		uint16_t source_id = (uint16_t)FIELD_GET(IDC_TOPI_ID, claimi);
+		for (int handled = 0; handled < PLAT_IRQ_DISPATCH_BUDGET; handled++) {
+			/*
+			 * Claim the interrupt from APLIC
+			 * This returns the highest priority pending interrupt source
+			 * and atomically clears the corresponding pending bit
+			 */
+			uint32_t claimi = read32(IDC_CLAIMI(idc));
+			uint16_t source_id = (uint16_t)FIELD_GET(IDC_TOPI_ID, claimi);
+			if (source_id == 0) {
+				if (!handled)
+					DBG("Got spurious interrupt from APLIC\n");
+				return;
+			}
+			DBG("Claimed interrupt source: %i\n", source_id);
+
+			/* Latency of the ones after the first is from their claim */
+			if (handled)
+				IRQ_STATS_ENTRY();
+			aplic_handle_source(idc, source_id);
+		}
 	#else
-		uint16_t source_id = eiid;
+		DBG("Claimed interrupt source: %i\n", eiid);
+		aplic_handle_source(0, eiid);
 	#endif
-
-	DBG("Claimed interrupt source: %i\n", source_id);
-
-	const struct irq_source_mapping *irq_sm = irq_get_srcmap(source_id);
-	if (irq_sm == NULL) {
-		ERR("Got interrupt from unmapped source: %i\n", source_id);
-		return;
-	}
-
-	DBG("Calling handler for interrupt source: %i\n", source_id);
-
-	/* Got mapping, call the associated interrupt handler */
-	irq_sm->handler((uint16_t) source_id);
-	return;
 }
 
 #endif /* defined(PLAT_HAS_APLIC) */
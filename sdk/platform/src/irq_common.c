@@ -10,6 +10,12 @@
 #include <platform/riscv/hart.h>	/* For hart state and operations */
 #include <platform/interfaces/irq.h>	/* For IRQ interface definitions */
 #include <platform/utils/utils.h>	/* For console output */
+#include <platform/utils/percpu.h>	/* For __percpu / this_cpu_ptr() */
+#include <platform/utils/irq_stats.h>	/* For irq_stats_entry_cycles/get/reset() */
+#include <platform/utils/lock.h>	/* For sdk_lock_t */
+
+#include <errno.h>			/* For error constants */
+#include <stdlib.h>			/* For malloc()/free() */
 
 /*********\
 * Helpers *
@@ -18,27 +24,72 @@
 /* Platform interrupt controller mapping */
 extern const volatile struct irq_target_mapping platform_intc_map[PLAT_MAX_HARTS];
 
-/* Find source mapping for the given source_id */
-const struct irq_source_mapping *
-irq_get_srcmap(uint16_t source_id)
+/* Declare as const - these point to read-only data in .rodata section
+ * This both prevents compiler optimization issues and is semantically correct */
+extern const struct irq_source_mapping __irq_sources_start;
+extern const struct irq_source_mapping __irq_sources_end;
+
+/* Direct-indexed by source_id, so that irq_dispatch() doesn't have to
+ * walk .rodata.irq_sources on every interrupt. Each entry is the index
+ * of the source's mapping in .rodata.irq_sources + 1 (0 for unmapped
+ * sources), that's a few bytes per source instead of a pointer, since
+ * this goes to .bss and we only have 4KB for .data/.bss. */
+#define IRQ_SRCMAP_SIZE	(PLAT_NUM_IRQ_SOURCES + 1)
+static uint16_t irq_srcmap_table[IRQ_SRCMAP_SIZE];
+
+/* Runtime target of each source (see irq_set_affinity()), as its
+ * hart_idx + 1, 0 for the target_hart of its mapping */
+static uint16_t irq_affinity_table[IRQ_SRCMAP_SIZE];
+static sdk_lock_t irq_affinity_lock = SDK_LOCK_INIT;
+
+/* Fill in irq_srcmap_table, called by irq_init() (so also by any
+ * target-specific one, before it looks up a source) */
+void
+irq_build_srcmap(void)
 {
-	/* Declare as const - these point to read-only data in .rodata section
-	 * This both prevents compiler optimization issues and is semantically correct */
-	extern const struct irq_source_mapping __irq_sources_start;
-	extern const struct irq_source_mapping __irq_sources_end;
 	const struct irq_source_mapping *first = &__irq_sources_start;
 	const struct irq_source_mapping *last = &__irq_sources_end;
 	DBG("Num sources: %li\n", last - first);
+
+	for (int i = 0; i < IRQ_SRCMAP_SIZE; i++)
+		irq_srcmap_table[i] = 0;
+
 	for (const struct irq_source_mapping *current = first; current < last; current++) {
-		DBG("Got mapping with wire_id: %i\n", current->source.wire_id);
-		if (current->source.wire_id == source_id) {
-			DBG("Got mapping for source: %i, target_hart: %i\n", source_id, current->target_hart);
-			return current;
+		const uint16_t source_id = current->source.wire_id;
+		if (source_id >= IRQ_SRCMAP_SIZE) {
+			ERR("IRQ source mapping for id %i out of range (max: %i)\n",
+			    source_id, PLAT_NUM_IRQ_SOURCES);
+			continue;
 		}
+		/* Keep the first one, as the linear scan did */
+		if (irq_srcmap_table[source_id]) {
+			WRN("Duplicate IRQ source mapping for id: %i, ignored\n", source_id);
+			continue;
+		}
+		DBG("Got mapping for source: %i, target_hart: %i\n", source_id, current->target_hart);
+		irq_srcmap_table[source_id] = (uint16_t)(current - first + 1);
 	}
+}
 
-	ERR("Couldn't find IRQ source mapping for id: %i\n", source_id);
-	return NULL;
+/* Find source mapping for the given source_id */
+const struct irq_source_mapping * __hot
+irq_get_srcmap(uint16_t source_id)
+{
+	const uint16_t idx = (source_id < IRQ_SRCMAP_SIZE) ? irq_srcmap_table[source_id] : 0;
+	if (!idx) {
+		ERR("Couldn't find IRQ source mapping for id: %i\n", source_id);
+		return NULL;
+	}
+	return &__irq_sources_start + (idx - 1);
+}
+
+/* Hart (by index) that should handle irq_sm's source */
+uint16_t
+irq_get_target_hart(const struct irq_source_mapping *irq_sm)
+{
+	const uint16_t source_id = irq_sm->source.wire_id;
+	const uint16_t hart = (source_id < IRQ_SRCMAP_SIZE) ? irq_affinity_table[source_id] : 0;
+	return hart ? (hart - 1) : irq_sm->target_hart;
 }
 
 /* Get target index (IDC index or hart index) for target_hart */
@@ -50,4 +101,257 @@ irq_get_target_idx_for_hart(uint16_t target_hart)
 		return -1;
 	/* Works also for ctx_idx and idc_idx since they're the same union field */
 	return platform_intc_map[hs->irq_map_idx].target.hart_idx;
-}
\ No newline at end of file
+}
+
+/**************\
+* Entry points *
+\**************/
+
+/* Route source_id to hart_idx from now on, instead of the target_hart
+ * of its mapping, the controller reprograms it if it's enabled, or
+ * irq_source_enable() will use the new target later on. */
+int
+irq_set_affinity(uint16_t source_id, uint16_t hart_idx)
+{
+	const struct irq_source_mapping *irq_sm = irq_get_srcmap(source_id);
+	if (irq_sm == NULL)
+		return -EINVAL;
+	if (hart_idx >= hart_get_count())
+		return -EINVAL;
+	if (irq_get_target_idx_for_hart(hart_idx) < 0) {
+		ERR("Hart %i has no IRQ target mapping\n", hart_idx);
+		return -ENODEV;
+	}
+
+	sdk_lock_acquire(&irq_affinity_lock);
+	const uint16_t current = irq_get_target_hart(irq_sm);
+	int ret = 0;
+	if (current != hart_idx) {
+		ret = irq_source_retarget(source_id, current, hart_idx);
+		if (!ret)
+			irq_affinity_table[source_id] = hart_idx + 1;
+	}
+	sdk_lock_release(&irq_affinity_lock);
+	DBG("Source %i: hart %i -> %i (%i)\n", source_id, current, hart_idx, ret);
+	return ret;
+}
+
+/*
+ * Spread the external sources over the harts that can take interrupts,
+ * based on the time each one spent in its handler (from the IRQ_STATS
+ * duration histograms, at the lower bound of each bucket) since the
+ * previous call. Heaviest sources go first, each to the least loaded
+ * hart so far, preferring the one it's already on in case of a tie,
+ * sources with no interrupts stay where they are. The histograms get
+ * reset afterwards so that the next call only sees the new load. Note
+ * that this doesn't take the timer / IPIs into account.
+ *
+ * Returns the number of sources it moved.
+ */
+int
+irq_rebalance(void)
+{
+	#if defined(IRQ_STATS)
+		const uint16_t num_harts = hart_get_count();
+		uint64_t hart_load[PLAT_MAX_HARTS] = { 0 };
+		bool hart_ok[PLAT_MAX_HARTS] = { 0 };
+		struct irq_stats stats;
+		int moved = 0;
+
+		uint64_t *src_load = malloc(IRQ_SRCMAP_SIZE * sizeof(uint64_t));
+		if (!src_load)
+			return -ENOMEM;
+
+		for (int i = 0; i < num_harts; i++)
+			hart_ok[i] = (irq_get_target_idx_for_hart(i) >= 0);
+
+		src_load[0] = 0;
+		for (int src = 1; src < IRQ_SRCMAP_SIZE; src++) {
+			src_load[src] = 0;
+			if (!irq_srcmap_table[src])
+				continue;
+			for (int i = 0; i < num_harts; i++) {
+				if (irq_stats_get(i, src, &stats))
+					continue;
+				for (int b = 0; b < IRQ_STAT_BUCKETS; b++)
+					src_load[src] += (uint64_t) stats.duration.count[b] << b;
+			}
+		}
+
+		while (1 == 1) {
+			int heaviest = 0;
+			for (int src = 1; src < IRQ_SRCMAP_SIZE; src++) {
+				if (src_load[src] > src_load[heaviest])
+					heaviest = src;
+			}
+			if (!heaviest)
+				break;
+
+			const struct irq_source_mapping *irq_sm = irq_get_srcmap(heaviest);
+			const uint16_t current = irq_get_target_hart(irq_sm);
+			int target = (current < num_harts && hart_ok[current]) ? current : -1;
+			for (int i = 0; i < num_harts; i++) {
+				if (hart_ok[i] && (target < 0 || hart_load[i] < hart_load[target]))
+					target = i;
+			}
+			if (target >= 0) {
+				hart_load[target] += src_load[heaviest];
+				if (target != current && !irq_set_affinity(heaviest, target))
+					moved++;
+			}
+			src_load[heaviest] = 0;
+		}
+
+		free(src_load);
+		for (int i = 0; i < num_harts; i++)
+			irq_stats_reset(i);
+		return moved;
+	#else
+		return -ENOTSUP;
+	#endif
+}
+
+/* How many handlers (or deferred works, see irq_work.c) run preemptible
+ * on this hart, and where to go once the outermost one returns (0 for
+ * where it was). */
+uint32_t irq_nest_depth __percpu = 0;
+static uintptr_t irq_nest_return __percpu = 0;
+
+/* mstatus fields the preempting trap overwrites, MDT is set on
+ * trap entry with Smdbltrp and MIE can't be set while it is. */
+#define IRQ_NEST_MSTATUS_MASK	(CSR_MSTATUS_MPIE | CSR_MSTATUS_MPP | CSR_MSTATUS_MDT)
+
+/* Called by irq_dispatch() after raising the threshold, right before
+ * the source's handler, opens the window for higher priority traps.
+ * Also called by irq_work_trap_exit() before running deferred work. */
+void __hot
+irq_nest_enter(struct irq_nest_state *ns)
+{
+	ns->mepc = csr_read(CSR_MEPC);
+	ns->mstatus = csr_read(CSR_MSTATUS) & IRQ_NEST_MSTATUS_MASK;
+	#if defined(IRQ_STATS)
+		ns->stats_entry = *this_cpu_ptr(&irq_stats_entry_cycles);
+	#endif
+	(*this_cpu_ptr(&irq_nest_depth))++;
+	csr_clear_bits(CSR_MSTATUS, CSR_MSTATUS_MDT);
+	hart_allow_interrupts();
+}
+
+/* Called when the handler returns, before restoring the threshold */
+void __hot
+irq_nest_exit(struct irq_nest_state *ns)
+{
+	uint32_t *depth = this_cpu_ptr(&irq_nest_depth);
+	uintptr_t *ret = this_cpu_ptr(&irq_nest_return);
+
+	hart_block_interrupts();
+	(*depth)--;
+	csr_clear_bits(CSR_MSTATUS, IRQ_NEST_MSTATUS_MASK);
+	csr_set_bits(CSR_MSTATUS, ns->mstatus);
+	#if defined(IRQ_STATS)
+		*this_cpu_ptr(&irq_stats_entry_cycles) = ns->stats_entry;
+	#endif
+	/* A preempting trap asked to redirect the hart, we
+	 * can only do that when unwinding the outermost one */
+	if (*depth == 0 && *ret != 0) {
+		csr_write(CSR_MEPC, *ret);
+		*ret = 0;
+	} else
+		csr_write(CSR_MEPC, ns->mepc);
+}
+
+void
+irq_set_trap_return(uintptr_t addr)
+{
+	/* Interrupts are off in here, so if any handler is in its
+	 * window, it's the one we preempted. */
+	if (*this_cpu_ptr(&irq_nest_depth) > 0)
+		*this_cpu_ptr(&irq_nest_return) = addr;
+	else
+		csr_write(CSR_MEPC, addr);
+}
+
+/***************\
+* Deferred work *
+\***************/
+
+/* Works queued on this hart, most recent first */
+static struct irq_work *irq_work_list __percpu = NULL;
+
+/* Queue work to run on this hart, returns false if it was already pending */
+bool
+irq_work_queue(struct irq_work *work)
+{
+	if (atomic_exchange_explicit(&work->pending, 1, memory_order_acquire))
+		return false;
+
+	/* A preempting handler may also queue work */
+	const bool irqs_on = csr_read(CSR_MSTATUS) & CSR_MSTATUS_MIE;
+	hart_block_interrupts();
+	struct irq_work **list = this_cpu_ptr(&irq_work_list);
+	work->next = *list;
+	*list = work;
+	if (irqs_on)
+		hart_allow_interrupts();
+	return true;
+}
+
+/* Take all queued works off the list, in the order they were queued */
+static struct irq_work *
+irq_work_take_all(void)
+{
+	struct irq_work **list = this_cpu_ptr(&irq_work_list);
+	struct irq_work *work = NULL;
+	struct irq_work *prev = NULL;
+
+	const bool irqs_on = csr_read(CSR_MSTATUS) & CSR_MSTATUS_MIE;
+	hart_block_interrupts();
+	work = *list;
+	*list = NULL;
+	if (irqs_on)
+		hart_allow_interrupts();
+
+	while (work != NULL) {
+		struct irq_work *next = work->next;
+		work->next = prev;
+		prev = work;
+		work = next;
+	}
+	return prev;
+}
+
+/* Run this hart's queued works, including the ones they (or
+ * interrupts in the meantime) queue, until there are none left. */
+void
+irq_work_run(void)
+{
+	struct irq_work *work = NULL;
+	while ((work = irq_work_take_all()) != NULL) {
+		while (work != NULL) {
+			struct irq_work *next = work->next;
+			atomic_store_explicit(&work->pending, 0, memory_order_release);
+			work->func(work);
+			work = next;
+		}
+	}
+}
+
+/* Called by the trap handlers in hart.c right before they return, if
+ * there is work queued and this is the outermost trap, run it with
+ * interrupts enabled. The inner traps leave theirs for the outermost
+ * one, which picks them up before it returns, so the stack doesn't grow
+ * with each one. */
+void
+irq_work_trap_exit(void)
+{
+	struct irq_nest_state ns;
+
+	if (*this_cpu_ptr(&irq_work_list) == NULL)
+		return;
+	if (*this_cpu_ptr(&irq_nest_depth) > 0)
+		return;
+
+	irq_nest_enter(&ns);
+	irq_work_run();
+	irq_nest_exit(&ns);
+}
@@ -12,6 +12,8 @@
 #include <platform/riscv/hart.h>	/* For hart state and operations */
 #include <platform/riscv/mmio.h>	/* For PLIC register access */
 #include <platform/utils/utils.h>	/* For console output */
+#include <platform/utils/irq_stats.h>	/* For IRQ_STATS_* hooks */
+#include <platform/utils/trap_trace.h>	/* For TRAP_TRACE_* hooks */
 
 #include <errno.h>			/* For error constants */
 #include <stdbool.h>			/* For bool type */
@@ -70,6 +72,8 @@ plic_map_priority(enum irq_priority priority)
 int __attribute__((weak))
 irq_init(void)
 {
+	irq_build_srcmap();
+
 	/* 
 	 * Initialize PLIC to clean state
 	 * Disable all interrupts by setting priority to 0
@@ -103,9 +107,9 @@ irq_source_enable(uint16_t source_id)
 	if (irq_sm == NULL)
 		return;
 
-	int ctx = irq_get_target_idx_for_hart(irq_sm->target_hart);
+	int ctx = irq_get_target_idx_for_hart(irq_get_target_hart(irq_sm));
 	if (ctx < 0) {
-		ERR("Attempted to enable interrupt for unmapped target (source: %i, target: %i)\n", source_id, irq_sm->target_hart);
+		ERR("Attempted to enable interrupt for unmapped target (source: %i, target: %i)\n", source_id, irq_get_target_hart(irq_sm));
 		return;
 	}
 	DBG("Interrupt source %i mapped to ctx %i\n", source_id, ctx);
@@ -129,9 +133,9 @@ irq_source_disable(uint16_t source_id)
 	if (irq_sm == NULL)
 		return;
 
-	int ctx = irq_get_target_idx_for_hart(irq_sm->target_hart);
+	int ctx = irq_get_target_idx_for_hart(irq_get_target_hart(irq_sm));
 	if (ctx < 0) {
-		ERR("Attempted to disable interrupt for unmapped target (source: %i, target: %i)\n", source_id, irq_sm->target_hart);
+		ERR("Attempted to disable interrupt for unmapped target (source: %i, target: %i)\n", source_id, irq_get_target_hart(irq_sm));
 		return;
 	}
 	DBG("Interrupt source %i mapped to ctx %i\n", source_id, ctx);
@@ -143,11 +147,63 @@ irq_source_disable(uint16_t source_id)
 	write32(PRIORITY_REG(source_id), 0);
 }
 
+/* PLIC ignores a completion from a context the source is no longer
+ * enabled on, so moving a source while the old hart is in its handler
+ * would leave its gateway closed for good. Sources can still be moved
+ * while they are disabled, irq_source_enable() picks the new target. */
+int __attribute__((weak))
+irq_source_retarget(uint16_t source_id, uint16_t from_hart, uint16_t to_hart)
+{
+	int ctx = irq_get_target_idx_for_hart(from_hart);
+	if (ctx < 0)
+		return -ENODEV;
+	if (read32(ENABLE_REG(ctx, source_id)) & (1 << (source_id & 31)))
+		return -ENOTSUP;
+	return 0;
+}
+
+/* Call the handler of a claimed source */
+static inline void
+plic_handle_source(uint16_t ctx, uint32_t source_id)
+{
+	const struct irq_source_mapping *irq_sm = irq_get_srcmap(source_id);
+	if (irq_sm == NULL) {
+		ERR("Got interrupt from unmapped source: %i\n", source_id);
+		return;
+	}
+
+	DBG("Calling handler for interrupt source: %i\n", source_id);
+
+	/* Got mapping, call the associated interrupt handler */
+	IRQ_STATS_STAMP(dispatch);
+	TRAP_TRACE_STAMP(trace_start);
+	#if defined(IRQ_NESTED)
+		/* Only sources above this one's priority get through
+		 * while its handler runs (PLIC masks priority <= threshold). */
+		struct irq_nest_state ns;
+		const uint32_t threshold = read32(PRIORITY_THR_REG(ctx));
+		write32(PRIORITY_THR_REG(ctx), plic_map_priority(irq_sm->priority));
+		irq_nest_enter(&ns);
+		irq_sm->handler((uint16_t) source_id);
+		irq_nest_exit(&ns);
+		write32(PRIORITY_THR_REG(ctx), threshold);
+	#else
+		irq_sm->handler((uint16_t) source_id);
+	#endif
+	IRQ_STATS_RECORD(source_id, dispatch);
+	TRAP_TRACE_RECORD(TRAP_TRACE_IRQ, source_id, irq_sm->handler, trace_start);
+}
+
 /*
  * Main interrupt dispatch handler - called from trap handler
  * This is called when an external interrupt is pending
+ *
+ * Keeps claiming until there is nothing pending for this context,
+ * or it handled PLAT_IRQ_DISPATCH_BUDGET sources, so that a burst
+ * of interrupts is handled on a single trap. If there is still
+ * something pending after that, the hart traps again right away.
  */
-void __attribute__((weak))
+void __hot __attribute__((weak))
 irq_dispatch(uint16_t)
 {
 	struct hart_state* hs = hart_get_hstate_self();
@@ -157,33 +213,27 @@ irq_dispatch(uint16_t)
 	}
 
 	uint16_t ctx = platform_intc_map[hs->irq_map_idx].target.ctx_idx;
-	/* 
-	 * Claim the interrupt from PLIC
-	 * This returns the highest priority pending interrupt source
-	 * and atomically clears the corresponding pending bit
-	 */
-	uint32_t source_id = read32(CLAIM_REG(ctx));
-
-	if (source_id == 0) {
-		WRN("Got spurious interrupt from PLIC !\n");
-		goto complete;
-	}
-
-	const struct irq_source_mapping *irq_sm = irq_get_srcmap(source_id);
-	if (irq_sm == NULL) {
-		ERR("Got interrupt from unmapped source: %i\n", source_id);
-		goto complete;
+	for (int handled = 0; handled < PLAT_IRQ_DISPATCH_BUDGET; handled++) {
+		/* 
+		 * Claim the interrupt from PLIC
+		 * This returns the highest priority pending interrupt source
+		 * and atomically clears the corresponding pending bit
+		 */
+		uint32_t source_id = read32(CLAIM_REG(ctx));
+		if (source_id == 0) {
+			if (!handled)
+				WRN("Got spurious interrupt from PLIC !\n");
+			return;
+		}
+
+		/* Latency of the ones after the first is from their claim */
+		if (handled)
+			IRQ_STATS_ENTRY();
+		plic_handle_source(ctx, source_id);
+
+		/*  Notify PLIC we are done handling that interrupt */
+		write32(CLAIM_REG(ctx), source_id);
 	}
-
-	DBG("Calling handler for interrupt source: %i\n", source_id);
-
-	/* Got mapping, call the associated interrupt handler */
-	irq_sm->handler((uint16_t) source_id);
-
- complete:
-	/*  Notify PLIC we are done handling that interrupt */
-	write32(CLAIM_REG(ctx), source_id);
-	return;
 }
 
 #endif /* defined(PLAT_HAS_PLIC) */
\ No newline at end of file
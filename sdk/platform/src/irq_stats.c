@@ -0,0 +1,171 @@
+/*
+ * SPDX-FileType: SOURCE
+ *
+ * SPDX-FileCopyrightText: 2026 Nick Kossifidis <mick@ics.forth.gr>
+ * SPDX-FileCopyrightText: 2026 ICS/FORTH
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <target_config.h>		/* For PLAT_MAX_HARTS */
+#include <platform/riscv/hart.h>	/* For hart_get_count() */
+#include <platform/utils/irq_stats.h>	/* For the irq_stats API */
+#include <platform/utils/utils.h>	/* For console output */
+#include <stdint.h>			/* For typed integers */
+#include <string.h>			/* For memcpy/memset() */
+#include <errno.h>			/* For error codes */
+#include <malloc.h>			/* For page_alloc() */
+
+#if defined(IRQ_STATS)
+
+#include <platform/utils/percpu.h>	/* For __percpu / this_cpu_ptr() */
+
+/* Set by IRQ_STATS_ENTRY() on trap entry, one per hart is enough
+ * since with IRQ_NESTED irq_nest_exit() restores the preempted one */
+uint64_t irq_stats_entry_cycles __percpu = 0;
+
+/* Each hart's table of IRQ_STAT_NUM_SOURCES entries, that's
+ * too large for .bss or the per-hart area in the stack slot,
+ * so it comes from the page allocator in hart_init(). */
+static struct irq_stats *irq_stats_table __percpu = NULL;
+
+#define IRQ_STATS_TABLE_PAGES	\
+	((IRQ_STAT_NUM_SOURCES * sizeof(struct irq_stats) + PAGE_FRAME_SIZE - 1) / PAGE_FRAME_SIZE)
+
+static inline void
+irq_hist_add(struct irq_hist *hist, uint64_t cycles)
+{
+	unsigned int bucket = cycles ? 63 - __builtin_clzll(cycles) : 0;
+	if (bucket >= IRQ_STAT_BUCKETS)
+		bucket = IRQ_STAT_BUCKETS - 1;
+	hist->count[bucket]++;
+	if (cycles > hist->max)
+		hist->max = cycles;
+}
+
+/* Called by each hart before it enables interrupts */
+void
+irq_stats_init_hart(void)
+{
+	struct irq_stats *table = page_alloc(IRQ_STATS_TABLE_PAGES, 0);
+	if (!table) {
+		WRN("No memory for IRQ stats, not recording them on this hart\n");
+		return;
+	}
+	memset(table, 0, IRQ_STAT_NUM_SOURCES * sizeof(struct irq_stats));
+	*this_cpu_ptr(&irq_stats_table) = table;
+}
+
+/* Called from the trap handler, after the handler for source returned */
+void
+irq_stats_record(uint16_t source, uint64_t dispatch)
+{
+	const uint64_t now = csr_read(CSR_MCYCLE);
+	struct irq_stats *table = *this_cpu_ptr(&irq_stats_table);
+	if (!table || source >= IRQ_STAT_NUM_SOURCES)
+		return;
+	irq_hist_add(&table[source].latency, dispatch - *this_cpu_ptr(&irq_stats_entry_cycles));
+	irq_hist_add(&table[source].duration, now - dispatch);
+}
+
+static struct irq_stats *
+irq_stats_get_table(uint16_t hart_idx)
+{
+	if (hart_idx >= hart_get_count())
+		return NULL;
+	return *per_cpu_ptr(&irq_stats_table, hart_idx);
+}
+
+static uint32_t
+irq_hist_samples(const struct irq_hist *hist)
+{
+	uint32_t samples = 0;
+	for (int i = 0; i < IRQ_STAT_BUCKETS; i++)
+		samples += hist->count[i];
+	return samples;
+}
+
+static void
+irq_hist_print(const char *name, const struct irq_hist *hist)
+{
+	INF("    %s (max: %lu cycles):\n", name, hist->max);
+	for (int i = 0; i < IRQ_STAT_BUCKETS; i++) {
+		if (!hist->count[i])
+			continue;
+		if (i == IRQ_STAT_BUCKETS - 1)
+			INF("      >= 2^%i: %u\n", i, hist->count[i]);
+		else
+			INF("      2^%i - 2^%i: %u\n", i, i + 1, hist->count[i]);
+	}
+}
+
+#endif /* IRQ_STATS */
+
+
+/**************\
+* ENTRY POINTS *
+\**************/
+
+/* Copy out the histograms of a hart's source */
+int
+irq_stats_get(uint16_t hart_idx, uint16_t source, struct irq_stats *out)
+{
+	#if defined(IRQ_STATS)
+		struct irq_stats *table = irq_stats_get_table(hart_idx);
+		if (!table)
+			return -ENODEV;
+		if (source >= IRQ_STAT_NUM_SOURCES)
+			return -EINVAL;
+		memcpy(out, &table[source], sizeof(struct irq_stats));
+		return 0;
+	#else
+		(void) hart_idx;
+		(void) source;
+		(void) out;
+		return -ENOTSUP;
+	#endif
+}
+
+int
+irq_stats_reset(uint16_t hart_idx)
+{
+	#if defined(IRQ_STATS)
+		struct irq_stats *table = irq_stats_get_table(hart_idx);
+		if (!table)
+			return -ENODEV;
+		memset(table, 0, IRQ_STAT_NUM_SOURCES * sizeof(struct irq_stats));
+		return 0;
+	#else
+		(void) hart_idx;
+		return -ENOTSUP;
+	#endif
+}
+
+/* Print all non-empty histograms of all harts */
+int
+irq_stats_dump(void)
+{
+	#if defined(IRQ_STATS)
+		for (int i = 0; i < hart_get_count(); i++) {
+			const struct irq_stats *table = irq_stats_get_table(i);
+			if (!table)
+				continue;
+			for (int src = 0; src < IRQ_STAT_NUM_SOURCES; src++) {
+				const uint32_t samples = irq_hist_samples(&table[src].duration);
+				if (!samples)
+					continue;
+				if (src == IRQ_STAT_TIMER)
+					INF("Hart %i, timer: %u interrupts\n", i, samples);
+				else if (src == IRQ_STAT_IPI)
+					INF("Hart %i, IPI: %u interrupts\n", i, samples);
+				else
+					INF("Hart %i, source %i: %u interrupts\n", i, src, samples);
+				irq_hist_print("latency", &table[src].latency);
+				irq_hist_print("duration", &table[src].duration);
+			}
+		}
+		return 0;
+	#else
+		return -ENOTSUP;
+	#endif
+}
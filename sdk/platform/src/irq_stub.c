@@ -8,12 +8,14 @@
  */
 
 #include <platform/interfaces/irq.h>
+#include <errno.h>
 
 #ifdef PLAT_NO_IRQ
 
 int irq_init(void) { return 0; };
 void irq_source_enable(uint16_t source_id) { return; }
 void irq_source_disable(uint16_t source_id) { return; }
+int irq_source_retarget(uint16_t source_id, uint16_t from_hart, uint16_t to_hart) { return -ENOTSUP; }
 void irq_dispatch(uint16_t eiid) { return; };
 
 #endif
\ No newline at end of file
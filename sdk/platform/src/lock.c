@@ -0,0 +1,71 @@
+/*
+ * SPDX-FileType: SOURCE
+ *
+ * SPDX-FileCopyrightText: 2026 Nick Kossifidis <mick@ics.forth.gr>
+ * SPDX-FileCopyrightText: 2026 ICS/FORTH
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <target_config.h>		/* For PLAT_MAX_HARTS */
+#include <platform/utils/lock.h>	/* For struct mcs_node / lock_use_zawrs */
+#include <platform/riscv/hart.h>	/* For hart_get_hstate_self() */
+#include <platform/riscv/caps.h>	/* For struct rvcaps / CAP_ZAWRS */
+#include <platform/utils/utils.h>	/* For __hot */
+
+/* All harts are assumed to be the same, so the boot hart's
+ * probe (see hart_probe.c) covers them all, until then we
+ * stick to pause(). */
+bool lock_use_zawrs = false;
+
+void
+__lock_set_caps(const struct rvcaps *caps)
+{
+	lock_use_zawrs = (caps->z_caps & CAP_ZAWRS) != 0;
+}
+
+#if defined(SDK_LOCK_MCS)
+
+/*
+ * Queue nodes for sdk_lock_t, a hart may hold a few internal locks at
+ * once (e.g. the stdout lock and then the uart lock, or one more from
+ * an interrupt handler), so each hart gets a few of them. Nodes are
+ * claimed with an atomic swap, so that an interrupt handler on the
+ * same hart can't grab the one we are about to use. Each hart's nodes
+ * go on their own cache line, since they are what waiters spin on.
+ */
+#define LOCK_MCS_NODES_PER_HART	4
+
+struct lock_mcs_hart_nodes {
+	_Alignas(64) struct mcs_node nodes[LOCK_MCS_NODES_PER_HART];
+	atomic_int in_use[LOCK_MCS_NODES_PER_HART];
+};
+
+static struct lock_mcs_hart_nodes lock_mcs_nodes[PLAT_MAX_HARTS];
+
+struct mcs_node * __hot
+lock_get_mcs_node(void)
+{
+	struct hart_state *hs = hart_get_hstate_self();
+	struct lock_mcs_hart_nodes *hn = &lock_mcs_nodes[hs->hart_idx];
+
+	for (int i = 0; i < LOCK_MCS_NODES_PER_HART; i++) {
+		if (!atomic_exchange_explicit(&hn->in_use[i], 1, memory_order_relaxed))
+			return &hn->nodes[i];
+	}
+
+	/* Internal locks nested deeper than LOCK_MCS_NODES_PER_HART,
+	 * nobody else will give us one back, and we can't print
+	 * anything either (we may hold the stdout lock) */
+	__builtin_trap();
+}
+
+void __hot
+lock_put_mcs_node(struct mcs_node *node)
+{
+	struct hart_state *hs = hart_get_hstate_self();
+	struct lock_mcs_hart_nodes *hn = &lock_mcs_nodes[hs->hart_idx];
+	atomic_store_explicit(&hn->in_use[node - hn->nodes], 0, memory_order_relaxed);
+}
+
+#endif /* SDK_LOCK_MCS */
@@ -0,0 +1,221 @@
+/*
+ * SPDX-FileType: SOURCE
+ *
+ * SPDX-FileCopyrightText: 2026 Nick Kossifidis <mick@ics.forth.gr>
+ * SPDX-FileCopyrightText: 2026 ICS/FORTH
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <target_config.h>		/* For PLAT_MAX_HARTS */
+#include <platform/riscv/hart.h>	/* For hart_get_hstate_self() / interrupt helpers */
+#include <platform/utils/lock.h>	/* For lock_try_acquire/release() */
+#include <platform/utils/utils.h>	/* For console output */
+#include <platform/utils/log.h>		/* For the log API */
+#include <stdatomic.h>			/* For C11 atomics */
+#include <stdint.h>			/* For typed integers */
+#include <stdio.h>			/* For printf/vprintf/vsnprintf */
+#include <string.h>			/* For memcpy() */
+#include <errno.h>			/* For error codes */
+#include <malloc.h>			/* For page_alloc() */
+
+/*
+ * Each hart's ring is allocated from the page allocator by log_init_hart()
+ * during hart_init() (so that we don't eat up .bss), and until then (or
+ * if that fails) log_printf() falls back to printf(). Logging itself
+ * never allocates, since the allocator logs while holding its lock. head
+ * is only written by the ring's hart and tail only by the hart that
+ * drains, on separate cache lines. The counters are free-running, so head - tail is
+ * what's waiting in the ring. A message is copied in with interrupts
+ * blocked, so that a handler logging on the same hart doesn't break the
+ * single-producer rule, and becomes visible to log_drain() in one go
+ * when head moves, so messages never get split.
+ */
+
+_Static_assert((LOG_RING_SIZE & (LOG_RING_SIZE - 1)) == 0, "LOG_RING_SIZE must be a power of two");
+
+#define LOG_RING_MASK		(LOG_RING_SIZE - 1)
+#define LOG_LINE_ALIGN		64
+
+struct log_ring {
+	/* Producer side */
+	_Atomic(uint32_t) head;
+	_Atomic(unsigned long) msgs;
+	_Atomic(unsigned long) dropped;
+	_Atomic(unsigned long) truncated;
+
+	/* Consumer side */
+	_Atomic(uint32_t) tail __attribute__((aligned(LOG_LINE_ALIGN)));
+	unsigned long reported_dropped;
+	unsigned long reported_truncated;
+
+	char data[LOG_RING_SIZE] __attribute__((aligned(LOG_LINE_ALIGN)));
+};
+
+#define LOG_RING_PAGES	((sizeof(struct log_ring) + PAGE_FRAME_SIZE - 1) / PAGE_FRAME_SIZE)
+
+static struct log_ring *log_rings[PLAT_MAX_HARTS] = { 0 };
+static atomic_int log_drain_lock = 0;
+
+static inline void
+log_counter_inc(_Atomic(unsigned long) *cntr)
+{
+	/* Only the producer writes those */
+	atomic_store_explicit(cntr, atomic_load_explicit(cntr, memory_order_relaxed) + 1,
+			      memory_order_relaxed);
+}
+
+static inline struct log_ring*
+log_get_ring(void)
+{
+	return log_rings[hart_get_hstate_self()->hart_idx];
+}
+
+/* Called by each hart during hart_init() with LOG_RINGS, or
+ * by the hart itself before it starts logging */
+int
+log_init_hart(void)
+{
+	uint16_t hart_idx = hart_get_hstate_self()->hart_idx;
+	if (log_rings[hart_idx])
+		return 0;
+
+	/* Anything the allocator logs meanwhile goes to printf */
+	struct log_ring *ring = page_alloc(LOG_RING_PAGES, 0);
+	if (!ring)
+		return -ENOMEM;
+
+	atomic_init(&ring->head, 0);
+	atomic_init(&ring->msgs, 0);
+	atomic_init(&ring->dropped, 0);
+	atomic_init(&ring->truncated, 0);
+	atomic_init(&ring->tail, 0);
+	ring->reported_dropped = 0;
+	ring->reported_truncated = 0;
+	/* Publish the initialized ring to log_drain() */
+	atomic_thread_fence(memory_order_release);
+	log_rings[hart_idx] = ring;
+	return 0;
+}
+
+int
+log_vprintf(const char *fmt, va_list va)
+{
+	struct log_ring *ring = log_get_ring();
+	if (!ring)
+		return vprintf(fmt, va);
+
+	char msg[LOG_MSG_MAX];
+	int ret = vsnprintf(msg, LOG_MSG_MAX, fmt, va);
+	if (ret < 0)
+		return ret;
+
+	uint32_t len = (uint32_t) ret;
+	if (ret >= LOG_MSG_MAX) {
+		len = LOG_MSG_MAX - 1;
+		log_counter_inc(&ring->truncated);
+	}
+
+	const bool irqs_on = csr_read(CSR_MSTATUS) & CSR_MSTATUS_MIE;
+	hart_block_interrupts();
+
+	/* Acquire so that we don't overwrite anything before
+	 * log_drain() is done with it */
+	uint32_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+	uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+	if (LOG_RING_SIZE - (head - tail) < len) {
+		log_counter_inc(&ring->dropped);
+		goto done;
+	}
+
+	/* Copy it in, wrapping around the end of the ring */
+	uint32_t offt = head & LOG_RING_MASK;
+	uint32_t first = (len < LOG_RING_SIZE - offt) ? len : LOG_RING_SIZE - offt;
+	memcpy(ring->data + offt, msg, first);
+	memcpy(ring->data, msg + first, len - first);
+
+	/* Release so that log_drain() sees the message when it sees head */
+	atomic_store_explicit(&ring->head, head + len, memory_order_release);
+	log_counter_inc(&ring->msgs);
+
+ done:
+	if (irqs_on)
+		hart_allow_interrupts();
+	return ret;
+}
+
+int
+log_printf(const char *fmt, ...)
+{
+	va_list va;
+	va_start(va, fmt);
+	int ret = log_vprintf(fmt, va);
+	va_end(va);
+	return ret;
+}
+
+/* Send out whatever is waiting in all rings, returns the number of bytes
+ * sent. Only one hart drains at a time, if another hart is already at it
+ * we just return. */
+int
+log_drain(void)
+{
+	int total = 0;
+
+	if (!lock_try_acquire(&log_drain_lock))
+		return 0;
+
+	for (int i = 0; i < PLAT_MAX_HARTS; i++) {
+		struct log_ring *ring = log_rings[i];
+		if (!ring)
+			continue;
+		atomic_thread_fence(memory_order_acquire);
+
+		uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+		uint32_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+		while (tail != head) {
+			uint32_t offt = tail & LOG_RING_MASK;
+			uint32_t len = head - tail;
+			if (len > LOG_RING_SIZE - offt)
+				len = LOG_RING_SIZE - offt;
+			printf("%.*s", (int) len, ring->data + offt);
+			tail += len;
+			total += len;
+			/* Release so that the producer doesn't
+			 * overwrite this before we are done */
+			atomic_store_explicit(&ring->tail, tail, memory_order_release);
+		}
+
+		unsigned long dropped = atomic_load_explicit(&ring->dropped, memory_order_relaxed);
+		unsigned long truncated = atomic_load_explicit(&ring->truncated, memory_order_relaxed);
+		if (dropped != ring->reported_dropped || truncated != ring->reported_truncated) {
+			printf(BRIGHT YELLOW "Warning: hart %i log ring dropped %lu, truncated %lu messages"
+			       NORMAL "\n", i, dropped - ring->reported_dropped,
+			       truncated - ring->reported_truncated);
+			ring->reported_dropped = dropped;
+			ring->reported_truncated = truncated;
+		}
+	}
+
+	lock_release(&log_drain_lock);
+	return total;
+}
+
+int
+log_get_stats(uint16_t hart_idx, struct log_stats *stats)
+{
+	if (hart_idx >= PLAT_MAX_HARTS || !stats)
+		return -EINVAL;
+
+	struct log_ring *ring = log_rings[hart_idx];
+	if (!ring)
+		return -ENODATA;
+	atomic_thread_fence(memory_order_acquire);
+
+	stats->used = atomic_load_explicit(&ring->head, memory_order_acquire) -
+		      atomic_load_explicit(&ring->tail, memory_order_relaxed);
+	stats->msgs = atomic_load_explicit(&ring->msgs, memory_order_relaxed);
+	stats->dropped = atomic_load_explicit(&ring->dropped, memory_order_relaxed);
+	stats->truncated = atomic_load_explicit(&ring->truncated, memory_order_relaxed);
+	return 0;
+}
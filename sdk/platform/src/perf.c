@@ -0,0 +1,815 @@
+/*
+ * SPDX-FileType: SOURCE
+ *
+ * SPDX-FileCopyrightText: 2026 Nick Kossifidis <mick@ics.forth.gr>
+ * SPDX-FileCopyrightText: 2026 ICS/FORTH
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <target_config.h>		/* For PLAT_PERF_EVENTS / PLAT_PERF_SETS */
+#include <platform/riscv/csr.h>		/* For counter CSRs / csr_*() */
+#include <platform/riscv/caps.h>	/* For struct rvcaps / CAP_SSCOFPMF / CAP_SMCTR */
+#include <platform/riscv/hart.h>	/* For hart_enable/disable_intr() */
+#include <platform/utils/perf.h>	/* For the perf API */
+#include <platform/utils/percpu.h>	/* For __percpu / this_cpu_ptr() */
+#include <platform/utils/utils.h>	/* For console output */
+#include <stdint.h>			/* For typed integers */
+#include <stddef.h>			/* For size_t / NULL */
+#include <stdbool.h>			/* For bool */
+#include <string.h>			/* For memset/strlen/strncmp() */
+#include <errno.h>			/* For error codes */
+#include <malloc.h>			/* For page_alloc() */
+#include <stdlib.h>			/* For malloc() / free() */
+
+/* Fixed counters, the event is the counter's index */
+static const struct perf_event_desc perf_fixed_events[] = {
+	{ "cycles", HC_CYCLES },
+	{ "instret", HC_INSTRET },
+	{ NULL, 0 }
+};
+
+static const struct perf_event_desc perf_events[] = {
+	#if defined(PLAT_PERF_EVENTS)
+		PLAT_PERF_EVENTS,
+	#endif
+	{ NULL, 0 }
+};
+
+static const struct perf_event_set perf_sets[] = {
+	#if defined(PLAT_PERF_SETS)
+		PLAT_PERF_SETS,
+	#endif
+	{ NULL, NULL }
+};
+
+/* The group running on this hart, and where its counters were when it started */
+struct perf_hart {
+	struct perf_group *group;
+	uint64_t start[PERF_MAX_EVENTS];
+};
+
+static struct perf_hart perf_hart_state __percpu = { 0 };
+
+/* The profiler's PC -> hits table, open addressing with linear probing,
+ * allocated on the first perf_prof_start() of each hart. */
+#define PERF_PROF_SLOTS_SHIFT	9
+#define PERF_PROF_SLOTS		(1U << PERF_PROF_SLOTS_SHIFT)
+#define PERF_PROF_PAGES		\
+	((PERF_PROF_SLOTS * sizeof(struct perf_prof_entry) + PAGE_FRAME_SIZE - 1) / PAGE_FRAME_SIZE)
+/* How far we look for a free slot before dropping a sample */
+#define PERF_PROF_MAX_PROBES	16
+
+struct perf_prof {
+	struct perf_prof_entry *slots;
+	uint64_t event;
+	uint64_t period;
+	uint64_t samples;
+	uint64_t dropped;
+	uint8_t counter;
+	bool running;
+};
+
+static struct perf_prof perf_prof_state __percpu = { 0 };
+
+/* CTR buffer depth and whether we are recording on this hart */
+struct perf_ctr {
+	uint16_t depth;
+	bool running;
+};
+
+static struct perf_ctr perf_ctr_state __percpu = { 0 };
+
+/* How far we look for a free slot on an edges table before dropping a record */
+#define PERF_CTR_MAX_PROBES	16
+
+/* Set through __perf_set_caps() by hart_probe */
+static uint8_t perf_num_hpm = 0;
+static bool perf_has_sscofpmf = false;
+static bool perf_has_smctr = false;
+
+void
+__perf_set_caps(const struct rvcaps *caps)
+{
+	perf_num_hpm = caps->num_hpmcounters;
+	perf_has_sscofpmf = (caps->s_caps & CAP_SSCOFPMF);
+	perf_has_smctr = (caps->m_caps & CAP_SMCTR);
+}
+
+/*********\
+* Helpers *
+\*********/
+
+/* CSR numbers have to be immediates, so for
+ * run-time indices we go through a switch. */
+#define PERF_HPM_LIST(_x)	\
+	_x(3) _x(4) _x(5) _x(6) _x(7) _x(8) _x(9) _x(10) _x(11) _x(12)		\
+	_x(13) _x(14) _x(15) _x(16) _x(17) _x(18) _x(19) _x(20) _x(21) _x(22)	\
+	_x(23) _x(24) _x(25) _x(26) _x(27) _x(28) _x(29) _x(30) _x(31)
+
+static uint64_t
+perf_read_counter(uint8_t idx)
+{
+	#define PERF_READ_CASE(_n)	case _n: return csr_read(CSR_MHPMCOUNTER(_n));
+	switch (idx) {
+	case HC_CYCLES:
+		return csr_read(CSR_MCYCLE);
+	case HC_INSTRET:
+		return csr_read(CSR_MINSTRET);
+	PERF_HPM_LIST(PERF_READ_CASE)
+	default:
+		return 0;
+	}
+	#undef PERF_READ_CASE
+}
+
+static void
+perf_write_counter(uint8_t idx, uint64_t value)
+{
+	#define PERF_WRITE_CASE(_n)	case _n: csr_write(CSR_MHPMCOUNTER(_n), value); break;
+	switch (idx) {
+	PERF_HPM_LIST(PERF_WRITE_CASE)
+	default:
+		break;
+	}
+	#undef PERF_WRITE_CASE
+}
+
+static void
+perf_write_event(uint8_t idx, uint64_t event)
+{
+	#define PERF_EVENT_CASE(_n)	case _n: csr_write(CSR_MHPMEVENT(_n), event); break;
+	switch (idx) {
+	PERF_HPM_LIST(PERF_EVENT_CASE)
+	default:
+		break;
+	}
+	#undef PERF_EVENT_CASE
+}
+
+static const struct perf_event_desc *
+perf_find_event(const struct perf_event_desc *table, const char *name, size_t len)
+{
+	for (; table->name != NULL; table++) {
+		if (strlen(table->name) == len && !strncmp(table->name, name, len))
+			return table;
+	}
+	return NULL;
+}
+
+static const struct perf_event_set *
+perf_find_set(const char *name, size_t len)
+{
+	for (const struct perf_event_set *set = perf_sets; set->name != NULL; set++) {
+		if (strlen(set->name) == len && !strncmp(set->name, name, len))
+			return set;
+	}
+	return NULL;
+}
+
+static int
+perf_group_add(struct perf_group *group, const char *name, uint64_t event, bool fixed)
+{
+	if (group->num_events >= PERF_MAX_EVENTS)
+		return -ENOSPC;
+
+	uint8_t counter = (uint8_t) event;
+	if (!fixed) {
+		if (!perf_num_hpm)
+			return -ENOTSUP;
+		/* The next free hpm counter */
+		counter = 3 + __builtin_popcount(group->hpm_mask);
+		if (counter >= 3 + perf_num_hpm)
+			return -ENOSPC;
+		group->hpm_mask |= (1U << counter);
+	}
+
+	const uint8_t i = group->num_events++;
+	group->names[i] = name;
+	group->events[i] = fixed ? 0 : event;
+	group->counters[i] = counter;
+	return 0;
+}
+
+/* Add a comma separated list of event / set names, sets
+ * may only contain events (nesting is 1 level deep). */
+static int
+perf_group_add_list(struct perf_group *group, const char *list, bool allow_sets)
+{
+	const char *cur = list;
+	while (*cur != '\0') {
+		while (*cur == ' ' || *cur == ',')
+			cur++;
+		const char *end = cur;
+		while (*end != '\0' && *end != ',' && *end != ' ')
+			end++;
+		const size_t len = end - cur;
+		if (!len)
+			break;
+
+		const struct perf_event_desc *desc = NULL;
+		const struct perf_event_set *set = NULL;
+		int ret = 0;
+		if ((desc = perf_find_event(perf_fixed_events, cur, len)) != NULL)
+			ret = perf_group_add(group, desc->name, desc->event, true);
+		else if ((desc = perf_find_event(perf_events, cur, len)) != NULL)
+			ret = perf_group_add(group, desc->name, desc->event, false);
+		else if (allow_sets && (set = perf_find_set(cur, len)) != NULL)
+			ret = perf_group_add_list(group, set->events, false);
+		else {
+			ERR("Unknown perf event: %.*s\n", (int) len, cur);
+			ret = -ENOENT;
+		}
+		if (ret)
+			return ret;
+		cur = end;
+	}
+	return 0;
+}
+
+/**************\
+* Entry points *
+\**************/
+
+/*
+ * Initialize group with a comma separated list of event names (cycles,
+ * instret, or the ones on PLAT_PERF_EVENTS) and / or set names (from
+ * PLAT_PERF_SETS). Returns -ENOENT for unknown names, -ENOSPC if we
+ * run out of counters, -ENOTSUP if the hart has no hpm counters.
+ */
+int
+perf_group_init(struct perf_group *group, const char *events)
+{
+	memset(group, 0, sizeof(struct perf_group));
+	if (events == NULL)
+		return 0;
+	return perf_group_add_list(group, events, true);
+}
+
+/* Add an event by its raw mhpmevent value, for events the target
+ * doesn't have a name for, name is only used for printing. */
+int
+perf_group_add_raw(struct perf_group *group, const char *name, uint64_t event)
+{
+	return perf_group_add(group, name, event, false);
+}
+
+/*
+ * Start counting group's events on this hart, -EBUSY if it's already
+ * running a group (this one or another). The hpm counters are programmed
+ * while inhibited and all start together.
+ */
+int
+perf_group_start(struct perf_group *group)
+{
+	struct perf_hart *ph = this_cpu_ptr(&perf_hart_state);
+	const struct perf_prof *pp = this_cpu_ptr(&perf_prof_state);
+	if (ph->group != NULL)
+		return -EBUSY;
+	if (!group->num_events)
+		return -EINVAL;
+	/* The profiler has the last counter */
+	if (pp->running && (group->hpm_mask & (1U << pp->counter)))
+		return -EBUSY;
+
+	csr_set_bits(CSR_MCOUNTINHIBIT, group->hpm_mask);
+	for (uint8_t i = 0; i < group->num_events; i++) {
+		if (group->counters[i] >= 3)
+			perf_write_event(group->counters[i], group->events[i]);
+		ph->start[i] = perf_read_counter(group->counters[i]);
+	}
+	ph->group = group;
+	csr_clear_bits(CSR_MCOUNTINHIBIT, group->hpm_mask);
+	return 0;
+}
+
+/*
+ * Stop counting on this hart, and add what it counted to the group's
+ * totals, -EINVAL if it isn't running group.
+ */
+int
+perf_group_stop(struct perf_group *group)
+{
+	struct perf_hart *ph = this_cpu_ptr(&perf_hart_state);
+	if (ph->group != group)
+		return -EINVAL;
+
+	csr_set_bits(CSR_MCOUNTINHIBIT, group->hpm_mask);
+	for (uint8_t i = 0; i < group->num_events; i++) {
+		const uint64_t count = perf_read_counter(group->counters[i]) - ph->start[i];
+		atomic_fetch_add_explicit(&group->totals[i], count, memory_order_relaxed);
+		if (group->counters[i] >= 3)
+			perf_write_event(group->counters[i], 0);
+	}
+	atomic_fetch_add_explicit(&group->num_harts, 1, memory_order_release);
+	ph->group = NULL;
+	return 0;
+}
+
+/* What this hart counted since it started group, while it's running */
+int
+perf_group_read(const struct perf_group *group, uint64_t *values)
+{
+	const struct perf_hart *ph = this_cpu_ptr(&perf_hart_state);
+	if (ph->group != group)
+		return -EINVAL;
+	for (uint8_t i = 0; i < group->num_events; i++)
+		values[i] = perf_read_counter(group->counters[i]) - ph->start[i];
+	return 0;
+}
+
+/* What all harts that stopped group counted */
+void
+perf_group_totals(struct perf_group *group, uint64_t *values)
+{
+	atomic_load_explicit(&group->num_harts, memory_order_acquire);
+	for (uint8_t i = 0; i < group->num_events; i++)
+		values[i] = atomic_load_explicit(&group->totals[i], memory_order_relaxed);
+}
+
+void
+perf_group_reset(struct perf_group *group)
+{
+	for (uint8_t i = 0; i < group->num_events; i++)
+		atomic_store_explicit(&group->totals[i], 0, memory_order_relaxed);
+	atomic_store_explicit(&group->num_harts, 0, memory_order_release);
+}
+
+void
+perf_group_print(struct perf_group *group)
+{
+	uint64_t values[PERF_MAX_EVENTS];
+	perf_group_totals(group, values);
+	INF("Perf counters (%u harts):\n", atomic_load(&group->num_harts));
+	for (uint8_t i = 0; i < group->num_events; i++)
+		INF("  %-24s %lu\n", group->names[i], values[i]);
+}
+
+/* The mhpmevent value of one of the target's named events */
+int
+perf_event_lookup(const char *name, uint64_t *event)
+{
+	const struct perf_event_desc *desc = perf_find_event(perf_events, name, strlen(name));
+	if (desc == NULL)
+		return -ENOENT;
+	*event = desc->event;
+	return 0;
+}
+
+/*******************\
+* Sampling profiler *
+\*******************/
+
+static inline unsigned int
+perf_prof_hash(uintptr_t pc)
+{
+	/* Instructions are at least 2 byte aligned */
+	return (unsigned int) (((pc >> 1) * 0x9E3779B97F4A7C15ULL) >> (64 - PERF_PROF_SLOTS_SHIFT));
+}
+
+/* Next overflow in period events, clearing OF re-enables the interrupt */
+static void
+perf_prof_arm(const struct perf_prof *pp)
+{
+	perf_write_counter(pp->counter, -pp->period);
+	perf_write_event(pp->counter, pp->event & ~CSR_MHPMEVENT_OF);
+	csr_clear_bits(CSR_MIP, BIT(INTR_LOCAL_COUNT_OVERFLOW));
+}
+
+void
+perf_prof_on_overflow(uintptr_t pc)
+{
+	struct perf_prof *pp = this_cpu_ptr(&perf_prof_state);
+	if (!pp->running) {
+		csr_clear_bits(CSR_MIP, BIT(INTR_LOCAL_COUNT_OVERFLOW));
+		hart_disable_intr(INTR_LOCAL_COUNT_OVERFLOW);
+		return;
+	}
+
+	unsigned int slot = perf_prof_hash(pc);
+	bool recorded = false;
+	for (int i = 0; i < PERF_PROF_MAX_PROBES; i++) {
+		struct perf_prof_entry *entry = &pp->slots[slot];
+		if (entry->pc == pc || entry->hits == 0) {
+			entry->pc = pc;
+			entry->hits++;
+			recorded = true;
+			break;
+		}
+		slot = (slot + 1) & (PERF_PROF_SLOTS - 1);
+	}
+	pp->samples++;
+	if (!recorded)
+		pp->dropped++;
+	perf_prof_arm(pp);
+}
+
+/*
+ * Sample mepc every period occurrences of event (one of the target's named
+ * events, NULL for PLAT_PERF_PROF_EVENT) on this hart, adding to what it
+ * sampled before. Returns -ENOTSUP without Sscofpmf / hpm counters, -ENOENT
+ * for unknown events, -EBUSY if it's already profiling, or its running perf
+ * group uses the last hpm counter.
+ */
+int
+perf_prof_start(const char *event, uint64_t period)
+{
+	struct perf_prof *pp = this_cpu_ptr(&perf_prof_state);
+	const struct perf_hart *ph = this_cpu_ptr(&perf_hart_state);
+	uint64_t event_val = 0;
+
+	if (!perf_has_sscofpmf || !perf_num_hpm)
+		return -ENOTSUP;
+	if (!period)
+		return -EINVAL;
+	#if defined(PLAT_PERF_PROF_EVENT)
+		if (event == NULL)
+			event = PLAT_PERF_PROF_EVENT;
+	#endif
+	if (event == NULL || perf_event_lookup(event, &event_val))
+		return -ENOENT;
+
+	const uint8_t counter = 3 + perf_num_hpm - 1;
+	if (pp->running)
+		return -EBUSY;
+	if (ph->group && (ph->group->hpm_mask & (1U << counter)))
+		return -EBUSY;
+
+	if (pp->slots == NULL) {
+		pp->slots = page_alloc(PERF_PROF_PAGES, 0);
+		if (pp->slots == NULL)
+			return -ENOMEM;
+		memset(pp->slots, 0, PERF_PROF_SLOTS * sizeof(struct perf_prof_entry));
+	}
+
+	csr_set_bits(CSR_MCOUNTINHIBIT, BIT(counter));
+	pp->counter = counter;
+	pp->event = event_val;
+	pp->period = period;
+	perf_prof_arm(pp);
+	pp->running = true;
+	hart_enable_intr(INTR_LOCAL_COUNT_OVERFLOW);
+	csr_clear_bits(CSR_MCOUNTINHIBIT, BIT(counter));
+	DBG("Profiling %s every %lu events on hpm counter %u\n", event, period, counter);
+	return 0;
+}
+
+/* Stop profiling on this hart, its samples stay there until perf_prof_reset() */
+int
+perf_prof_stop(void)
+{
+	struct perf_prof *pp = this_cpu_ptr(&perf_prof_state);
+	if (!pp->running)
+		return -EINVAL;
+
+	csr_set_bits(CSR_MCOUNTINHIBIT, BIT(pp->counter));
+	hart_disable_intr(INTR_LOCAL_COUNT_OVERFLOW);
+	perf_write_event(pp->counter, 0);
+	csr_clear_bits(CSR_MIP, BIT(INTR_LOCAL_COUNT_OVERFLOW));
+	pp->running = false;
+	if (pp->dropped)
+		WRN("Profiler dropped %lu of %lu samples, table full\n", pp->dropped, pp->samples);
+	return 0;
+}
+
+/* Total samples taken on hart_idx */
+uint64_t
+perf_prof_samples(uint16_t hart_idx)
+{
+	return per_cpu_ptr(&perf_prof_state, hart_idx)->samples;
+}
+
+/*
+ * Fill out with hart_idx's num PCs with the most hits, highest first,
+ * returns how many there were. Meant to be called once the hart stopped
+ * profiling, otherwise the table may change under us.
+ */
+int
+perf_prof_top(uint16_t hart_idx, struct perf_prof_entry *out, unsigned int num)
+{
+	if (hart_idx >= hart_get_count())
+		return -EINVAL;
+	const struct perf_prof *pp = per_cpu_ptr(&perf_prof_state, hart_idx);
+	unsigned int found = 0;
+	if (pp->slots == NULL)
+		return 0;
+
+	/* Insertion into out, it's only a handful of entries */
+	for (unsigned int s = 0; s < PERF_PROF_SLOTS; s++) {
+		const struct perf_prof_entry *entry = &pp->slots[s];
+		if (!entry->hits)
+			continue;
+		unsigned int pos = (found < num) ? found : num;
+		while (pos > 0 && out[pos - 1].hits < entry->hits) {
+			if (pos < num)
+				out[pos] = out[pos - 1];
+			pos--;
+		}
+		if (pos < num) {
+			out[pos] = *entry;
+			if (found < num)
+				found++;
+		}
+	}
+	return found;
+}
+
+/* Print hart_idx's num hottest PCs, use addr2line on the ELF to map them */
+void
+perf_prof_dump(uint16_t hart_idx, unsigned int num)
+{
+	struct perf_prof_entry top[16];
+	if (num > sizeof(top) / sizeof(top[0]))
+		num = sizeof(top) / sizeof(top[0]);
+
+	const uint64_t samples = perf_prof_samples(hart_idx);
+	const int found = perf_prof_top(hart_idx, top, num);
+	INF("Hart %u profile, %lu samples:\n", hart_idx, samples);
+	for (int i = 0; i < found; i++)
+		INF("  0x%016lx %8lu (%lu%%)\n", top[i].pc, top[i].hits,
+		    samples ? (top[i].hits * 100) / samples : 0);
+}
+
+void
+perf_prof_reset(uint16_t hart_idx)
+{
+	struct perf_prof *pp = per_cpu_ptr(&perf_prof_state, hart_idx);
+	if (pp->slots)
+		memset(pp->slots, 0, PERF_PROF_SLOTS * sizeof(struct perf_prof_entry));
+	pp->samples = 0;
+	pp->dropped = 0;
+}
+
+/****************************\
+* Control transfer records *
+\****************************/
+
+static const char *perf_ctr_type_names[16] = {
+	[PERF_CTR_TYPE_NONE] = "none",
+	[PERF_CTR_TYPE_EXC] = "exc",
+	[PERF_CTR_TYPE_INTR] = "intr",
+	[PERF_CTR_TYPE_TRET] = "tret",
+	[PERF_CTR_TYPE_NTBR] = "ntbr",
+	[PERF_CTR_TYPE_TKBR] = "tkbr",
+	[6] = "rsvd",
+	[7] = "rsvd",
+	[PERF_CTR_TYPE_INDCALL] = "indcall",
+	[PERF_CTR_TYPE_DIRCALL] = "call",
+	[PERF_CTR_TYPE_INDJMP] = "indjmp",
+	[PERF_CTR_TYPE_DIRJMP] = "jmp",
+	[PERF_CTR_TYPE_CORSWAP] = "corswap",
+	[PERF_CTR_TYPE_RET] = "ret",
+	[PERF_CTR_TYPE_INDLJMP] = "indljmp",
+	[PERF_CTR_TYPE_DIRLJMP] = "ljmp",
+};
+
+/* mctrctl for a PERF_CTR_* mask, we only record while in M-mode */
+static uint64_t
+perf_ctr_ctl(unsigned int what)
+{
+	uint64_t ctl = CSR_MCTRCTL_M;
+	#if __riscv_xlen == 64
+		if (!(what & PERF_CTR_BRANCHES))
+			ctl |= CSR_MCTRCTL_TKBRINH;
+		if (what & PERF_CTR_NOT_TAKEN)
+			ctl |= CSR_MCTRCTL_NTBREN;
+		if (!(what & PERF_CTR_CALLS))
+			ctl |= CSR_MCTRCTL_INDCALLINH | CSR_MCTRCTL_DIRCALLINH |
+			       CSR_MCTRCTL_CORSWAPINH | CSR_MCTRCTL_RETINH;
+		if (!(what & PERF_CTR_JUMPS))
+			ctl |= CSR_MCTRCTL_INDJMPINH | CSR_MCTRCTL_DIRJMPINH |
+			       CSR_MCTRCTL_INDLJMPINH | CSR_MCTRCTL_DIRLJMPINH;
+		if (!(what & PERF_CTR_TRAPS))
+			ctl |= CSR_MCTRCTL_EXCINH | CSR_MCTRCTL_INTRINH | CSR_MCTRCTL_TRETINH;
+	#endif
+	/* On RV32 the filters are out of reach, we record everything */
+	return ctl;
+}
+
+/* Decode ctrdata's cycle count, 12bit mantissa / 4bit exponent */
+static inline uint32_t
+perf_ctr_cycles(uintptr_t data)
+{
+	if (!(data & CTR_DATA_CCV))
+		return 0;
+	const uint32_t ccm = FIELD_GET(CTR_DATA_CCM, data);
+	const uint32_t cce = FIELD_GET(CTR_DATA_CCE, data);
+	return cce ? (BIT(12) + ccm) << (cce - 1) : ccm;
+}
+
+/*
+ * Start recording the control transfers of this hart (PERF_CTR_* on what),
+ * from an empty buffer. Returns -ENOTSUP without Smctr, -EBUSY if we are
+ * already recording.
+ */
+int
+perf_ctr_start(unsigned int what)
+{
+	struct perf_ctr *pc = this_cpu_ptr(&perf_ctr_state);
+	if (!perf_has_smctr)
+		return -ENOTSUP;
+	if (!(what & PERF_CTR_ALL))
+		return -EINVAL;
+	if (pc->running)
+		return -EBUSY;
+
+	/* Ask for the deepest buffer, sctrdepth is WARL */
+	if (!pc->depth) {
+		csr_write(CSR_SCTRDEPTH, FIELD_PREP(CSR_SCTRDEPTH_DEPTH, 4));
+		pc->depth = 16U << FIELD_GET(CSR_SCTRDEPTH_DEPTH, csr_read(CSR_SCTRDEPTH));
+		DBG("CTR buffer has %u entries\n", pc->depth);
+	}
+
+	csr_write(CSR_MCTRCTL, 0);
+	__asm__ __volatile__(".word 0x10400073" ::: "memory");	/* sctrclr */
+	csr_write(CSR_SCTRSTATUS, 0);
+	pc->running = true;
+	csr_write(CSR_MCTRCTL, perf_ctr_ctl(what));
+	return 0;
+}
+
+/* Stop recording, what was recorded stays there until the next start */
+int
+perf_ctr_stop(void)
+{
+	struct perf_ctr *pc = this_cpu_ptr(&perf_ctr_state);
+	if (!pc->running)
+		return -EINVAL;
+	csr_write(CSR_MCTRCTL, 0);
+	pc->running = false;
+	return 0;
+}
+
+/* Entries on this hart's CTR buffer, 0 before the first perf_ctr_start() */
+unsigned int
+perf_ctr_depth(void)
+{
+	return this_cpu_ptr(&perf_ctr_state)->depth;
+}
+
+/*
+ * Fill out with up to the num most recent records of this hart, oldest
+ * first, returns how many there were. The last few are the call to
+ * perf_ctr_stop() and its return.
+ */
+int
+perf_ctr_read(struct perf_ctr_record *out, unsigned int num)
+{
+	const struct perf_ctr *pc = this_cpu_ptr(&perf_ctr_state);
+	unsigned int found = 0;
+
+	if (!perf_has_smctr)
+		return -ENOTSUP;
+	if (pc->running)
+		return -EBUSY;
+	if (num > pc->depth)
+		num = pc->depth;
+
+	/* Interrupt handlers may use miselect for the IMSIC */
+	const bool mie = (csr_read(CSR_MSTATUS) & CSR_MSTATUS_MIE);
+	hart_block_interrupts();
+	for (; found < num; found++) {
+		csr_write(CSR_MISELECT, CTR_ISELECT_BASE + found);
+		const uintptr_t source = csr_read(CSR_MIREG);
+		if (!(source & CTR_SOURCE_V))
+			break;
+		const uintptr_t target = csr_read(CSR_MIREG2);
+		const uintptr_t data = csr_read(CSR_MIREG3);
+
+		struct perf_ctr_record *rec = &out[found];
+		rec->source = source & ~CTR_SOURCE_V;
+		rec->target = target & ~CTR_TARGET_MISP;
+		rec->mispredicted = (target & CTR_TARGET_MISP);
+		rec->type = FIELD_GET(CTR_DATA_TYPE, data);
+		rec->cycles = perf_ctr_cycles(data);
+	}
+	if (mie)
+		hart_allow_interrupts();
+
+	/* Logical entry 0 is the most recent one */
+	for (unsigned int i = 0; i < found / 2; i++) {
+		struct perf_ctr_record tmp = out[i];
+		out[i] = out[found - 1 - i];
+		out[found - 1 - i] = tmp;
+	}
+	return found;
+}
+
+void
+perf_ctr_dump(const struct perf_ctr_record *recs, unsigned int num)
+{
+	INF("%u control transfers:\n", num);
+	for (unsigned int i = 0; i < num; i++)
+		INF("  0x%016lx -> 0x%016lx %-8s %8u%s\n", recs[i].source, recs[i].target,
+		    perf_ctr_type_names[recs[i].type & 0xF], recs[i].cycles,
+		    recs[i].mispredicted ? " mispredicted" : "");
+}
+
+/* A table of edges with num_slots (power of two) entries */
+int
+perf_ctr_edges_init(struct perf_ctr_edges *edges, unsigned int num_slots)
+{
+	if (!num_slots || (num_slots & (num_slots - 1)))
+		return -EINVAL;
+	edges->slots = malloc(num_slots * sizeof(struct perf_ctr_edge));
+	if (edges->slots == NULL)
+		return -ENOMEM;
+	memset(edges->slots, 0, num_slots * sizeof(struct perf_ctr_edge));
+	edges->num_slots = num_slots;
+	edges->records = 0;
+	edges->dropped = 0;
+	return 0;
+}
+
+void
+perf_ctr_edges_free(struct perf_ctr_edges *edges)
+{
+	free(edges->slots);
+	edges->slots = NULL;
+	edges->num_slots = 0;
+}
+
+static inline unsigned int
+perf_ctr_edge_hash(uintptr_t source, uintptr_t target)
+{
+	const uint64_t key = (source >> 1) ^ ((uint64_t) target << 31);
+	return (unsigned int) ((key * 0x9E3779B97F4A7C15ULL) >> 32);
+}
+
+/* Add records (e.g. from perf_ctr_read() after each run of a region) to edges */
+void
+perf_ctr_edges_add(struct perf_ctr_edges *edges, const struct perf_ctr_record *recs,
+		   unsigned int num)
+{
+	const unsigned int mask = edges->num_slots - 1;
+	for (unsigned int i = 0; i < num; i++) {
+		const struct perf_ctr_record *rec = &recs[i];
+		unsigned int slot = perf_ctr_edge_hash(rec->source, rec->target) & mask;
+		bool recorded = false;
+		for (int p = 0; p < PERF_CTR_MAX_PROBES; p++) {
+			struct perf_ctr_edge *edge = &edges->slots[slot];
+			if (edge->hits == 0) {
+				edge->source = rec->source;
+				edge->target = rec->target;
+				edge->type = rec->type;
+			}
+			if (edge->source == rec->source && edge->target == rec->target) {
+				edge->hits++;
+				edge->mispredicts += rec->mispredicted;
+				edge->cycles += rec->cycles;
+				recorded = true;
+				break;
+			}
+			slot = (slot + 1) & mask;
+		}
+		edges->records++;
+		if (!recorded)
+			edges->dropped++;
+	}
+}
+
+/* Fill out with the num edges with the most hits, highest first */
+int
+perf_ctr_edges_top(const struct perf_ctr_edges *edges, struct perf_ctr_edge *out,
+		   unsigned int num)
+{
+	unsigned int found = 0;
+
+	/* Insertion into out, it's only a handful of entries */
+	for (unsigned int s = 0; s < edges->num_slots; s++) {
+		const struct perf_ctr_edge *edge = &edges->slots[s];
+		if (!edge->hits)
+			continue;
+		unsigned int pos = (found < num) ? found : num;
+		while (pos > 0 && out[pos - 1].hits < edge->hits) {
+			if (pos < num)
+				out[pos] = out[pos - 1];
+			pos--;
+		}
+		if (pos < num) {
+			out[pos] = *edge;
+			if (found < num)
+				found++;
+		}
+	}
+	return found;
+}
+
+/* Print the num hottest edges, with their mispredicts and average cycles
+ * before them (the block from the previous record's target up to the edge) */
+void
+perf_ctr_edges_dump(const struct perf_ctr_edges *edges, unsigned int num)
+{
+	struct perf_ctr_edge top[16];
+	if (num > sizeof(top) / sizeof(top[0]))
+		num = sizeof(top) / sizeof(top[0]);
+
+	const int found = perf_ctr_edges_top(edges, top, num);
+	INF("Hot edges, %lu records (%lu dropped):\n", edges->records, edges->dropped);
+	INF("  %-18s    %-18s %-8s %10s %10s %10s\n", "source", "target", "type",
+	    "hits", "mispred", "cycles");
+	for (int i = 0; i < found; i++)
+		INF("  0x%016lx -> 0x%016lx %-8s %10lu %10lu %10lu\n", top[i].source,
+		    top[i].target, perf_ctr_type_names[top[i].type & 0xF], top[i].hits,
+		    top[i].mispredicts, top[i].cycles / top[i].hits);
+}
@@ -0,0 +1,211 @@
+/*
+ * SPDX-FileType: SOURCE
+ *
+ * SPDX-FileCopyrightText: 2026 Nick Kossifidis <mick@ics.forth.gr>
+ * SPDX-FileCopyrightText: 2026 ICS/FORTH
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <target_config.h>		/* For PLAT_MAX_HARTS */
+#include <platform/riscv/hart.h>	/* For hart_get_hstate_self() */
+#include <platform/utils/utils.h>	/* For console output */
+#include <platform/utils/pool.h>	/* For the pool API */
+#include <stdatomic.h>			/* For C11 atomics */
+#include <stdint.h>			/* For typed integers */
+#include <stdlib.h>			/* For abort() */
+#include <malloc.h>			/* For page_alloc/free() */
+
+/*
+ * The pool is a single run of page frames, with struct pool at its
+ * start followed by the objects. Each object has a header word right
+ * before it, with the index of the hart that owns it (the one that
+ * allocated it last) and a tag for catching double / invalid frees.
+ * While free, the object's first word links it to the next free one.
+ *
+ * Each hart's magazine has two free lists, a local one that only the
+ * owner touches, and a remote one where other harts push the objects
+ * they free, that the owner grabs as a whole with an atomic exchange
+ * when its local list runs out. Since nobody ever pops a single object
+ * from the remote list we don't have to worry about ABA. Objects that
+ * haven't been handed out yet come from a shared bump index, and if
+ * both are empty we also try to grab another hart's remote list, so
+ * that objects freed by a consumer hart that never allocates don't get
+ * stuck there.
+ *
+ * On single-hart targets built without the A extension, the atomics
+ * end up in atomics_stub.c.
+ */
+
+#define POOL_OBJ_ALIGN		16
+#define POOL_HDR_SIZE		sizeof(uintptr_t)
+#define POOL_MAG_ALIGN		64
+
+#define POOL_TAG_MASK		0xFFFFFFFF00000000UL
+#define POOL_TAG_USED		0xB0C1ED0000000000UL
+#define POOL_TAG_FREE		0xF5EE000000000000UL
+#define POOL_OWNER_MASK		0xFFFFUL
+
+struct pool_obj {
+	struct pool_obj *next;
+};
+
+/* Keep each magazine on its own cache line (assuming 64byte
+ * lines), so that pushes from other harts don't bounce the
+ * owner's local list around */
+struct pool_magazine {
+	struct pool_obj *local;
+	_Atomic(struct pool_obj *) remote;
+} __attribute__((aligned(POOL_MAG_ALIGN)));
+
+struct pool {
+	uintptr_t objs;
+	size_t obj_stride;
+	size_t count;
+	size_t num_pages;
+	atomic_size_t next_fresh;
+	struct pool_magazine mags[PLAT_MAX_HARTS];
+};
+
+static inline uintptr_t*
+pool_obj_hdr(void *obj)
+{
+	return (uintptr_t*)((uintptr_t) obj - POOL_HDR_SIZE);
+}
+
+static inline struct pool_magazine*
+pool_get_magazine(struct pool *pool, uint16_t *hart_idx)
+{
+	#if (PLAT_MAX_HARTS > 1)
+		*hart_idx = hart_get_hstate_self()->hart_idx;
+	#else
+		*hart_idx = 0;
+	#endif
+	return &pool->mags[*hart_idx];
+}
+
+struct pool*
+pool_create(size_t obj_size, size_t count)
+{
+	if (!obj_size || !count)
+		return NULL;
+
+	if (obj_size < sizeof(struct pool_obj))
+		obj_size = sizeof(struct pool_obj);
+	if (obj_size > SIZE_MAX / 2)
+		return NULL;
+
+	/* Each object's header goes at the end of the previous slot, so that
+	 * the objects remain aligned */
+	size_t stride = (obj_size + POOL_HDR_SIZE + POOL_OBJ_ALIGN - 1) &
+			~((size_t) POOL_OBJ_ALIGN - 1);
+	size_t objs_offt = (sizeof(struct pool) + POOL_HDR_SIZE + POOL_OBJ_ALIGN - 1) &
+			   ~((size_t) POOL_OBJ_ALIGN - 1);
+	if (count > (SIZE_MAX - objs_offt - PAGE_FRAME_SIZE) / stride)
+		return NULL;
+
+	size_t num_pages = (objs_offt + count * stride + PAGE_FRAME_SIZE - 1) / PAGE_FRAME_SIZE;
+	struct pool *pool = page_alloc(num_pages, 0);
+	if (!pool) {
+		ERR("Could not allocate pool for %lu objects of %lu bytes\n",
+		    count, obj_size);
+		return NULL;
+	}
+
+	pool->objs = (uintptr_t) pool + objs_offt;
+	pool->obj_stride = stride;
+	pool->count = count;
+	pool->num_pages = num_pages;
+	atomic_init(&pool->next_fresh, 0);
+	for (int i = 0; i < PLAT_MAX_HARTS; i++) {
+		pool->mags[i].local = NULL;
+		atomic_init(&pool->mags[i].remote, NULL);
+	}
+
+	DBG("Created pool at %p, %lu objects of %lu bytes\n", pool, count, obj_size);
+	return pool;
+}
+
+/* All objects should have been freed by now, and no
+ * other hart should be using the pool */
+void
+pool_destroy(struct pool *pool)
+{
+	if (!pool)
+		return;
+	page_free(pool, pool->num_pages);
+}
+
+void*
+pool_alloc(struct pool *pool)
+{
+	uint16_t hart_idx;
+	struct pool_magazine *mag = pool_get_magazine(pool, &hart_idx);
+	struct pool_obj *obj = mag->local;
+
+	/* Grab whatever other harts gave back to us, acquire
+	 * so that we see their writes to the objects' links */
+	if (!obj)
+		obj = atomic_exchange_explicit(&mag->remote, NULL, memory_order_acquire);
+
+	/* Objects never handed out before */
+	if (!obj && atomic_load_explicit(&pool->next_fresh, memory_order_relaxed) < pool->count) {
+		size_t idx = atomic_fetch_add_explicit(&pool->next_fresh, 1, memory_order_relaxed);
+		if (idx < pool->count) {
+			obj = (struct pool_obj*)(pool->objs + idx * pool->obj_stride);
+			obj->next = NULL;
+		}
+	}
+
+	/* Take over another hart's returned objects */
+	for (int i = 0; !obj && i < PLAT_MAX_HARTS; i++) {
+		if (i == hart_idx)
+			continue;
+		obj = atomic_exchange_explicit(&pool->mags[i].remote, NULL, memory_order_acquire);
+	}
+
+	if (!obj)
+		return NULL;
+
+	mag->local = obj->next;
+	*pool_obj_hdr(obj) = POOL_TAG_USED | hart_idx;
+	return obj;
+}
+
+void
+pool_free(struct pool *pool, void *ptr)
+{
+	if (!ptr)
+		return;
+
+	uintptr_t addr = (uintptr_t) ptr;
+	uintptr_t *hdr = pool_obj_hdr(ptr);
+	if (addr < pool->objs || addr >= pool->objs + pool->count * pool->obj_stride ||
+	    (addr - pool->objs) % pool->obj_stride ||
+	    (*hdr & POOL_TAG_MASK) != POOL_TAG_USED) {
+		ERR("Invalid / double free of pool object %p (pool: %p)\n", ptr, pool);
+		abort();
+	}
+
+	uint16_t hart_idx;
+	struct pool_magazine *mag = pool_get_magazine(pool, &hart_idx);
+	uint16_t owner = *hdr & POOL_OWNER_MASK;
+	struct pool_obj *obj = ptr;
+	*hdr = POOL_TAG_FREE | owner;
+
+	if (owner == hart_idx) {
+		obj->next = mag->local;
+		mag->local = obj;
+		return;
+	}
+
+	/* Push it to the owner's remote list, release so that
+	 * the owner sees our writes when it grabs the list */
+	struct pool_magazine *owner_mag = &pool->mags[owner];
+	struct pool_obj *head = atomic_load_explicit(&owner_mag->remote, memory_order_relaxed);
+	do {
+		obj->next = head;
+	} while (!atomic_compare_exchange_weak_explicit(&owner_mag->remote, &head, obj,
+							memory_order_release,
+							memory_order_relaxed));
+}
@@ -0,0 +1,223 @@
+/*
+ * SPDX-FileType: SOURCE
+ *
+ * SPDX-FileCopyrightText: 2026 Nick Kossifidis <mick@ics.forth.gr>
+ * SPDX-FileCopyrightText: 2026 ICS/FORTH
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <target_config.h>		/* For PLAT_NO_IPI */
+#include <platform/utils/ring.h>	/* For the ring API */
+#include <platform/utils/utils.h>	/* For console output */
+#include <platform/interfaces/ipi.h>	/* For ipi_send() */
+#include <platform/riscv/hart.h>	/* For hart_get_hstate_by_idx() */
+#include <platform/riscv/csr.h>		/* For wfi() / pause() */
+#include <stdatomic.h>			/* For C11 atomics */
+#include <stdint.h>			/* For typed integers */
+#include <malloc.h>			/* For page_alloc/free() */
+
+/*
+ * Each side of the ring (producers / consumers) has a head and a tail
+ * index, head is where the next enqueue / dequeue will start, tail is
+ * up to where the previous ones are done. A multi-producer enqueue
+ * reserves its slots by moving prod.head with a CAS, fills them in,
+ * waits for any earlier producers to publish theirs, and then moves
+ * prod.tail past its slots, same for multi-consumer dequeues with the
+ * cons indices. Producers only look at cons.tail to see how much room
+ * there is, and consumers at prod.tail to see what's there, so each
+ * side's indices go on their own cache line. The indices are free
+ * running 32bit counters, masked with the (power of two) size when
+ * accessing the slots.
+ *
+ * For the consumer kick, after publishing its slots a producer checks
+ * if the consumers had caught up with everything before them (cons.tail
+ * at the start of its slots), if so they may be on their way to wfi and
+ * get an IPI. The consumer side in ring_wait() checks for objects after
+ * its last dequeue, with a full fence on both sides in between, so if
+ * the producer didn't see it caught up it will see the new objects.
+ */
+
+struct ring_side {
+	_Alignas(64) atomic_uint head;
+	atomic_uint tail;
+};
+
+struct ring {
+	struct ring_side prod;
+	struct ring_side cons;
+	_Alignas(64) uint32_t mask;
+	uint32_t flags;
+	atomic_int consumer;
+	size_t num_pages;
+	void *slots[];
+};
+
+struct ring *
+ring_create(unsigned int size, unsigned int flags)
+{
+	if (size < 2 || (size & (size - 1))) {
+		ERR("Ring size must be a power of two\n");
+		return NULL;
+	}
+
+	const size_t bytes = sizeof(struct ring) + size * sizeof(void *);
+	const size_t num_pages = (bytes + PAGE_FRAME_SIZE - 1) / PAGE_FRAME_SIZE;
+	struct ring *ring = page_alloc(num_pages, 0);
+	if (!ring) {
+		ERR("Could not allocate ring with %u slots\n", size);
+		return NULL;
+	}
+
+	atomic_init(&ring->prod.head, 0);
+	atomic_init(&ring->prod.tail, 0);
+	atomic_init(&ring->cons.head, 0);
+	atomic_init(&ring->cons.tail, 0);
+	ring->mask = size - 1;
+	ring->flags = flags;
+	atomic_init(&ring->consumer, -1);
+	ring->num_pages = num_pages;
+	return ring;
+}
+
+void
+ring_destroy(struct ring *ring)
+{
+	if (ring)
+		page_free(ring, ring->num_pages);
+}
+
+/* Kick hart_idx with an IPI when the ring goes from empty to
+ * non-empty, -1 to stop */
+void
+ring_set_consumer(struct ring *ring, int hart_idx)
+{
+	#ifndef PLAT_NO_IPI
+		if (hart_idx >= hart_get_count())
+			return;
+		atomic_store_explicit(&ring->consumer, hart_idx, memory_order_relaxed);
+	#else
+		(void) ring;
+		(void) hart_idx;
+	#endif
+}
+
+/* Returns the number of objects enqueued, up to num */
+unsigned int
+ring_enqueue_burst(struct ring *ring, void * const *objs, unsigned int num)
+{
+	const uint32_t size = ring->mask + 1;
+	uint32_t head = atomic_load_explicit(&ring->prod.head, memory_order_relaxed);
+	uint32_t next;
+
+	/* Acquire on cons.tail, so that we don't overwrite
+	 * slots the consumers are still reading */
+	do {
+		const uint32_t free = size - (head - atomic_load_explicit(&ring->cons.tail,
+									  memory_order_acquire));
+		if (num > free)
+			num = free;
+		if (!num)
+			return 0;
+		next = head + num;
+		if (!(ring->flags & RING_MP)) {
+			atomic_store_explicit(&ring->prod.head, next, memory_order_relaxed);
+			break;
+		}
+	} while (!atomic_compare_exchange_weak_explicit(&ring->prod.head, &head, next,
+							memory_order_relaxed,
+							memory_order_relaxed));
+
+	for (unsigned int i = 0; i < num; i++)
+		ring->slots[(head + i) & ring->mask] = objs[i];
+
+	/* Publish in order, after any earlier producers */
+	if (ring->flags & RING_MP) {
+		while (atomic_load_explicit(&ring->prod.tail, memory_order_relaxed) != head)
+			pause();
+	}
+	atomic_store_explicit(&ring->prod.tail, next, memory_order_release);
+
+	const int consumer = atomic_load_explicit(&ring->consumer, memory_order_relaxed);
+	if (consumer >= 0) {
+		atomic_thread_fence(memory_order_seq_cst);
+		if (atomic_load_explicit(&ring->cons.tail, memory_order_relaxed) == head)
+			ipi_send(hart_get_hstate_by_idx(consumer), IPI_WAKEUP);
+	}
+	return num;
+}
+
+/* Returns the number of objects dequeued, up to num */
+unsigned int
+ring_dequeue_burst(struct ring *ring, void **objs, unsigned int num)
+{
+	uint32_t head = atomic_load_explicit(&ring->cons.head, memory_order_relaxed);
+	uint32_t next;
+
+	/* Acquire on prod.tail, so that we see the slots' contents */
+	do {
+		const uint32_t avail = atomic_load_explicit(&ring->prod.tail,
+							    memory_order_acquire) - head;
+		if (num > avail)
+			num = avail;
+		if (!num)
+			return 0;
+		next = head + num;
+		if (!(ring->flags & RING_MC)) {
+			atomic_store_explicit(&ring->cons.head, next, memory_order_relaxed);
+			break;
+		}
+	} while (!atomic_compare_exchange_weak_explicit(&ring->cons.head, &head, next,
+							memory_order_relaxed,
+							memory_order_relaxed));
+
+	for (unsigned int i = 0; i < num; i++)
+		objs[i] = ring->slots[(head + i) & ring->mask];
+
+	if (ring->flags & RING_MC) {
+		while (atomic_load_explicit(&ring->cons.tail, memory_order_relaxed) != head)
+			pause();
+	}
+	/* Release so that producers don't overwrite the
+	 * slots before we are done reading them */
+	atomic_store_explicit(&ring->cons.tail, next, memory_order_release);
+	return num;
+}
+
+unsigned int
+ring_count(const struct ring *ring)
+{
+	const uint32_t cons_tail = atomic_load_explicit(&ring->cons.tail, memory_order_relaxed);
+	return atomic_load_explicit(&ring->prod.tail, memory_order_acquire) - cons_tail;
+}
+
+/* Consumer side, wait for the ring to become non-empty, on wfi if
+ * we get kicked (see ring_set_consumer()), polling otherwise. */
+void
+ring_wait(struct ring *ring)
+{
+	const int self = hart_get_hstate_self()->hart_idx;
+
+	while (1) {
+		if (atomic_load_explicit(&ring->consumer, memory_order_relaxed) != self) {
+			if (ring_count(ring))
+				return;
+			pause();
+			continue;
+		}
+
+		/* With interrupts blocked the kick can't get consumed
+		 * by the handler in between the check and wfi, wfi
+		 * still wakes up on it. */
+		const bool irqs_on = csr_read(CSR_MSTATUS) & CSR_MSTATUS_MIE;
+		hart_block_interrupts();
+		atomic_thread_fence(memory_order_seq_cst);
+		const bool empty = !ring_count(ring);
+		if (empty)
+			wfi();
+		if (irqs_on)
+			hart_allow_interrupts();
+		if (!empty)
+			return;
+	}
+}
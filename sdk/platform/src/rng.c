@@ -11,7 +11,9 @@
 #include <platform/riscv/mtimer.h>
 #include <platform/riscv/csr.h>
 #include <platform/riscv/hart.h>
+#include <platform/riscv/caps.h>
 #include <platform/utils/lock.h>
+#include <stdbool.h>
 
 /* Murmurhash3-inspired mixer
  * (Mix13 from https://zimbry.blogspot.com/2011/09/better-bit-mixing-improving-on.html
@@ -28,9 +30,43 @@ static inline uint64_t avalanche_mix(uint64_t h)
 }
 
 /* This acts as a simple accumulator */
-static atomic_int rng_lock = 0;
+static sdk_lock_t rng_lock = SDK_LOCK_INIT;
 static uint64_t rng_state = 0;
 
+/* Set through __rng_set_caps() by hart_probe, until then
+ * we try the seed CSR once and let the trap handler skip it */
+static bool rng_caps_known = false;
+static bool rng_has_zkr = false;
+
+/* How many times we poll the seed CSR for each 16 bits,
+ * it may be in WAIT / BIST for a while */
+#define RNG_SEED_POLLS	64
+
+void
+__rng_set_caps(const struct rvcaps *caps)
+{
+	rng_has_zkr = (caps->z_caps & CAP_ZKR);
+	rng_caps_known = true;
+}
+
+/* Poll the seed CSR until it gives us 16 bits, returns false
+ * if it's dead or doesn't get out of WAIT / BIST in time */
+static bool
+rng_read_es16(uint32_t *out)
+{
+	for (int i = 0; i < RNG_SEED_POLLS; i++) {
+		const uint32_t seed_val = (uint32_t) csr_read(CSR_SEED);
+		const uint32_t opstat = seed_val >> 30;
+		if (opstat == 2) {
+			*out = seed_val & 0xFFFF;
+			return true;
+		}
+		if (opstat == 3)
+			return false;
+	}
+	return false;
+}
+
 /*
  * Gather 32 bits of entropy from available hardware sources
  *
@@ -38,7 +74,9 @@ static uint64_t rng_state = 0;
  * 1. MCYCLE - Always available in M-mode
  * 2. MINSTRET - Always available in M-mode
  * 3. mtime - If PLAT_MTIMER_FREQ is defined and non-zero
- * 4. CSR_SEED - If Zkr extension present (checks hs->error for availability)
+ * 4. CSR_SEED - If Zkr extension present, polled for 32 bits of entropy
+ *    once hart_probe told us about it (before that it's read once and
+ *    the trap handler skips it on harts without it)
  *
  * Note: CSR_SEED returns entropy in bits [15:0] with status in bits [31:30]:
  *   00 = BIST  (ignore, running Built-In Self Test)
@@ -58,18 +96,24 @@ uint32_t rng_get_seed(void)
 		seed ^= mtimer_get_num_ticks();
 	#endif
 	/* Try to get hardware entropy from CSR_SEED (Zkr extension) */
-	volatile uint32_t seed_val = 0;
-	seed_val = (uint32_t)csr_read(CSR_SEED);
-	uint32_t opstat = seed_val >> 30;
-	/* ES16 (10) = valid entropy */
-	if (opstat == 2)
-		seed ^= (uint64_t)(seed_val & 0xFFFF);
+	if (rng_has_zkr) {
+		uint32_t lo = 0, hi = 0;
+		if (rng_read_es16(&lo) && rng_read_es16(&hi))
+			seed ^= ((uint64_t) hi << 48) | ((uint64_t) lo << 32);
+	} else if (!rng_caps_known) {
+		volatile uint32_t seed_val = 0;
+		seed_val = (uint32_t)csr_read(CSR_SEED);
+		uint32_t opstat = seed_val >> 30;
+		/* ES16 (10) = valid entropy */
+		if (opstat == 2)
+			seed ^= (uint64_t)(seed_val & 0xFFFF);
+	}
 
 	/* Update global state with lock protection for multi-hart safety */
-	lock_acquire(&rng_lock);
+	sdk_lock_acquire(&rng_lock);
 	rng_state ^= avalanche_mix(seed);
 	uint32_t result = (uint32_t)rng_state;
-	lock_release(&rng_lock);
+	sdk_lock_release(&rng_lock);
 
 	return result;
 }
@@ -12,7 +12,14 @@
 #include <platform/riscv/csr.h>		/* For wfi() */
 #include <platform/riscv/hart.h>	/* For hart_get_hstate_self(), hart_*_counter() */
 #include <platform/riscv/mtimer.h>	/* For mtimer_*() functions */
+#include <platform/riscv/caps.h>	/* For struct rvcaps / CAP_* */
 #include <platform/utils/utils.h>	/* For console output */
+#include <platform/utils/trap_trace.h>	/* For TRAP_TRACE_* hooks */
+#include <platform/utils/percpu.h>	/* For __percpu / this_cpu_ptr() */
+#include <stdbool.h>			/* For bool */
+#include <string.h>			/* For memset() */
+#include <malloc.h>			/* For page_alloc() */
+#include <errno.h>			/* For error codes */
 
 /*********\
 * HELPERS *
@@ -20,193 +27,583 @@
 
 #define NSECS_IN_SEC 1000000000UL
 
-/* Note: We assume all harts run at the same frequency
- * so we don't need to have different timer parameters
- * per part. Hence we only have two sets of parameters,
- * one for the platform-level timer (mtimer), and one
- * for the timer based on each hart's cycle counter. */
+/* Note: We have two sets of parameters, one for the
+ * platform-level timer (mtimer), and one for the timer
+ * based on each hart's cycle counter. The latter uses
+ * PLAT_HART_FREQ, until each hart calibrates its cycle
+ * counter against mtime during hart_init, since the real
+ * core clock may differ (DVFS, FPGA builds etc), and
+ * keeps its own multipliers in its hart_state (see
+ * CALIBRATION below).
+ *
+ * Both clocks are free-running, we never reset mtime
+ * or mcycle and we don't keep any state in between
+ * reads, so any hart may read them at any time (mtime
+ * is shared, mcycle is per-hart, so PLAT_TIMER_CYCLES
+ * only makes sense when compared on the same hart).
+ *
+ * In order to calculate nsecs from ticks we need to calculate
+ * nsecs = (ticks / clock_freq) * NSECS_IN_SEC, however we don't
+ * want to use floats/doubles, and we also want to avoid division.
+ * So instead we use a fixed point multiplier with TIMER_SHIFT
+ * fractional bits, and do the multiplication in 128bits (that's
+ * mul + mulhu on rv64), so that the result doesn't overflow for
+ * any number of ticks, unlike Linux's clocks_calc_mult_shift()
+ * that needs to limit the maximum interval it can convert. The
+ * multipliers only depend on the clock frequencies, so they are
+ * computed at build time. */
+#define TIMER_SHIFT	32
+#define TIMER_MULT(_to, _from)	\
+	((((uint64_t)(_to) << TIMER_SHIFT) + ((uint64_t)(_from) >> 1)) / (uint64_t)(_from))
+
 struct timer_spec {
 	struct timespec res;
-	uint32_t clock_freq;
-	uint32_t mult_c2ns;
-	uint32_t shift_c2ns;
-	uint32_t mult_ns2c;
-	uint32_t shift_ns2c;
-	uint32_t mult_c2c;
-	uint32_t shift_c2c;
+	uint64_t mult_c2ns;	/* ticks -> nsecs */
+	uint64_t mult_ns2c;	/* nsecs -> ticks */
+	uint64_t mult_c2clk;	/* ticks -> clock() ticks */
 };
 
-static struct timer_spec cyclecount_timer = {0};
+#define TIMER_SPEC_INIT(_freq) {					\
+	.res.tv_sec = 0,						\
+	.res.tv_nsec = (NSECS_IN_SEC + (_freq) - 1) / (_freq),		\
+	.mult_c2ns = TIMER_MULT(NSECS_IN_SEC, _freq),			\
+	.mult_ns2c = TIMER_MULT(_freq, NSECS_IN_SEC),			\
+	.mult_c2clk = TIMER_MULT(CLOCKS_PER_SEC, _freq),		\
+}
+
+/* Clocks up to 4GHz, so that (freq << TIMER_SHIFT) fits in 64bits */
+_Static_assert((uint64_t) PLAT_HART_FREQ < (1ULL << 32), "PLAT_HART_FREQ too high");
+static const struct timer_spec cyclecount_timer = TIMER_SPEC_INIT(PLAT_HART_FREQ);
 
 #ifndef PLAT_NO_MTIMER
-static struct timer_spec platform_timer = {0};
-/* We track the last measurement of each hart's cyclecount_timer
- * in the hart's hart_state, and here we track the last count of
- * the (global) platform_timer. */
-static uint64_t last_platform_tval = 0;
+static const struct timer_spec platform_timer = TIMER_SPEC_INIT(PLAT_MTIMER_FREQ);
 #endif
 
-/* Initialize a timer parameters for the given clock frequency,
- * and/or return the cached version. Note: We could init params
- * on e.g. platform_init or hart_init, but this way if a program
- * never uses a timer, this function will also be optimized-out
- * since it'll never get called. */
+static inline uint64_t
+timer_convert(uint64_t val, uint64_t mult)
+{
+	return (uint64_t) (((unsigned __int128) val * mult) >> TIMER_SHIFT);
+}
+
+/* hart_state only has 32bits for the calibrated nsecs -> cycles
+ * multiplier, so it has less fractional bits, enough for up to 8GHz */
+#define TIMER_NS2C_SHIFT	29
+
+static const uint64_t timer_mult_ns2clk = TIMER_MULT(CLOCKS_PER_SEC, NSECS_IN_SEC);
+
 static const struct timer_spec *
 timer_get_spec(timerid_t timerid)
 {
-	struct timer_spec *timer = NULL;
-	uint32_t clock_freq = 0;
 	switch (timerid) {
 	case PLAT_TIMER_RTC:
 	case PLAT_TIMER_MTIMER:
 		#ifndef PLAT_NO_MTIMER
-			timer = &platform_timer;
-			clock_freq = PLAT_MTIMER_FREQ;
-			break;
+			return &platform_timer;
 		#endif
 		/* Fallthrough */
 	case PLAT_TIMER_CYCLES:
-		timer = &cyclecount_timer;
-		clock_freq = PLAT_HART_FREQ;
-		break;
+		return &cyclecount_timer;
 	default:
 		return NULL;
 	}
+}
 
-	/* Already initialized */
-	if (timer->clock_freq > 0)
-		return timer;
+#ifndef PLAT_NO_MTIMER
+/* Go through the time / stimecmp CSRs instead of mtime / mtimecmp over
+ * MMIO when the harts support them (a few cycles instead of a bus round
+ * trip), set by __timer_set_caps() during the boot hart's init. Define
+ * PLAT_MTIMER_MMIO_ONLY in target_config.h to always use MMIO. */
+#ifndef PLAT_MTIMER_MMIO_ONLY
+static bool timer_use_time_csr = false;
+static bool timer_use_sstc = false;
+#else
+#define timer_use_time_csr	false
+#define timer_use_sstc		false
+#endif
 
-	uint32_t divisor = 0;
-	timer->res.tv_sec = 0;
-	timer->res.tv_nsec = 0;
+void
+__timer_set_caps(const struct rvcaps *caps)
+{
+	#ifndef PLAT_MTIMER_MMIO_ONLY
+		timer_use_time_csr = (caps->r_caps & CAP_ZICNTR_TIME);
+		/* stimecmp compares against time, make sure
+		 * we get the same value through the CSR */
+		timer_use_sstc = timer_use_time_csr && (caps->s_caps & CAP_SSTC);
+	#endif
+}
 
-	/* Start with nanoseconds and go down to 100msec */
-	for (divisor = NSECS_IN_SEC; divisor >= 100; divisor /= 10) {
-		if (clock_freq >= divisor) {
-			timer->res.tv_nsec = NSECS_IN_SEC / divisor;
-			break;
-		}
+static inline uint64_t
+timer_read_mtime(void)
+{
+	if (timer_use_time_csr)
+		return mtimer_csr_get_num_ticks();
+	return mtimer_get_num_ticks();
+}
+#else
+void __timer_set_caps(const struct rvcaps *caps) { return; }
+#endif
+
+/* Cycle counter conversions go through the calling
+ * hart's multipliers, once it's calibrated. */
+static inline uint64_t
+timer_to_nsecs(const struct timer_spec *timer, uint64_t ticks)
+{
+	if (timer == &cyclecount_timer) {
+		const struct hart_state *hs = hart_get_hstate_self();
+		if (hs->cycle_mult_c2ns)
+			return timer_convert(ticks, hs->cycle_mult_c2ns);
 	}
+	return timer_convert(ticks, timer->mult_c2ns);
+}
 
-	/* This shouldn't happen, I mean the clock should at least
-	 * run at a few KHz or else is kinda useless, if we are here
-	 * it's less than 100Hz. */
-	if (!timer->res.tv_nsec)
-		timer->res.tv_sec = 1;
-
-	/* In order to calculate nsecs from cycles we need to calculate
-	 * nsecs = (cycles/clock_freq) * NSECS_IN_SEC, however we don't
-	 * want to use floats/doubles, and we also want to avoid division.
-	 * So instead of division we'll use shifts and look for a pair of
-	 * multiplier/shifter that would allow us to calculate the above
-	 * much faster. This comes from Linux's clocks_calc_mult_shift(). */
-	timer->clock_freq = clock_freq;
-	const uint32_t maxdelay_secs = 10;
-
-	/* Make sure a multiplication between maxdelay_secs and freq won't
-	 * overflow a 64bit integer. This assumes that the maximum
-	 * interval we'll measure will be up to maxdelay_secs. Larger intervals
-	 * may overflow. */
-	uint64_t tmp = ((uint64_t) maxdelay_secs * clock_freq) >> 32;
-	uint32_t shift_accumulator = 32;
-	while (tmp) {
-		tmp >>= 1;
-		shift_accumulator--;
+static inline uint64_t
+timer_from_nsecs(const struct timer_spec *timer, uint64_t nsecs)
+{
+	if (timer == &cyclecount_timer) {
+		const struct hart_state *hs = hart_get_hstate_self();
+		if (hs->cycle_mult_ns2c)
+			return (uint64_t) (((unsigned __int128) nsecs * hs->cycle_mult_ns2c) >> TIMER_NS2C_SHIFT);
 	}
+	return timer_convert(nsecs, timer->mult_ns2c);
+}
 
-	uint64_t mult = 0;
-	uint32_t shift = 0;
-	/* Multiplier / shifter for (NSECS_IN_SEC / clock_freq) */
-	for (shift = 32; shift > 0; shift--) {
-		mult = ((uint64_t) NSECS_IN_SEC) << shift;
-		mult += timer->clock_freq >> 1;
-		mult /= timer->clock_freq;
-		if ((mult >> shift_accumulator) == 0)
-			break;
+/* Read-only, no MMIO / CSR writes */
+static inline uint64_t
+timer_read_ticks(timerid_t timerid)
+{
+	switch (timerid) {
+	case PLAT_TIMER_RTC:
+	case PLAT_TIMER_MTIMER:
+		#ifndef PLAT_NO_MTIMER
+			return timer_read_mtime();
+		#endif
+		/* Fallthrough */
+	case PLAT_TIMER_CYCLES:
+		return hart_get_counter(HC_CYCLES);
+	default:
+		return 0;
 	}
+}
 
-	timer->mult_c2ns = mult;
-	timer->shift_c2ns = shift;
+/*************\
+* TIMER WHEEL *
+\*************/
 
-	/* Same as above but for converting nsecs to cycles, so now we want
-	 * cycles = (nsecs / NSECS_IN_SEC) * clock_freq. */
-	tmp = ((uint64_t) maxdelay_secs * NSECS_IN_SEC) >> 32;
-	shift_accumulator = 32;
-	while (tmp) {
-		tmp >>= 1;
-		shift_accumulator--;
+#ifndef PLAT_NO_MTIMER
+/*
+ * Each hart has its own hierarchical timer wheel, multiplexed on its
+ * mtimecmp, and only touched by that hart (with interrupts blocked),
+ * so no locking is needed. Level 0 has TW_SLOTS slots, one wheel tick
+ * each, and each level above it has slots TW_SLOTS times as wide as the
+ * level below. Events go to the lowest level that can hold their
+ * deadline, and each slot is a doubly linked list, so adding or
+ * cancelling an event is O(1). Events in higher levels get moved
+ * ("cascaded") to lower levels as their deadline gets closer.
+ *
+ * It's tickless, mtimecmp is only armed for the next slot that has
+ * events (for higher levels that's the start of the slot, where its
+ * events get cascaded), and when the interrupt comes we process all
+ * slots we went through since the last time, instead of one per tick.
+ *
+ * A wheel tick is ~1usec (mtime ticks rounded down to a power of two),
+ * so with 5 levels of 64 slots the wheel covers ~18 minutes, events
+ * further away wait at the last slot of the top level. The wheel itself
+ * (~2.6KB) is allocated by timer_init_hart(), until then (or if that
+ * fails) timer_add() returns -ENOMEM.
+ */
+
+#define TW_LEVELS	5
+#define TW_SLOT_BITS	6
+#define TW_SLOTS	(1 << TW_SLOT_BITS)
+#define TW_SLOT_MASK	(TW_SLOTS - 1)
+#define TW_GRAN_SHIFT	((PLAT_MTIMER_FREQ >= 2000000) ? \
+			 (63 - __builtin_clzll(PLAT_MTIMER_FREQ / 1000000)) : 0)
+#define TW_LVL_SHIFT(_lvl)	((_lvl) * TW_SLOT_BITS)
+
+struct timer_wheel {
+	uint64_t clk;			/* Last wheel tick processed */
+	uint64_t occupied[TW_LEVELS];	/* Non-empty slots */
+	struct timer_event *slots[TW_LEVELS][TW_SLOTS];
+	bool stce;			/* menvcfg.STCE set on this hart */
+};
+
+#define TW_PAGES	((sizeof(struct timer_wheel) + PAGE_FRAME_SIZE - 1) / PAGE_FRAME_SIZE)
+
+static struct timer_wheel *timer_wheel __percpu = NULL;
+
+static inline uint64_t
+tw_now(void)
+{
+	return timer_read_mtime() >> TW_GRAN_SHIFT;
+}
+
+/* Round up, so that events never fire early */
+static inline uint64_t
+tw_event_tick(const struct timer_event *ev)
+{
+	return (ev->expires + (1ULL << TW_GRAN_SHIFT) - 1) >> TW_GRAN_SHIFT;
+}
+
+static inline bool
+tw_is_empty(const struct timer_wheel *tw)
+{
+	uint64_t occupied = 0;
+	for (int i = 0; i < TW_LEVELS; i++)
+		occupied |= tw->occupied[i];
+	return !occupied;
+}
+
+static inline void
+tw_link(struct timer_event **head, struct timer_event *ev)
+{
+	ev->next = *head;
+	if (ev->next)
+		ev->next->pprev = &ev->next;
+	ev->pprev = head;
+	*head = ev;
+}
+
+static void
+tw_unlink(struct timer_wheel *tw, struct timer_event *ev)
+{
+	struct timer_event **pprev = ev->pprev;
+	*pprev = ev->next;
+	if (ev->next)
+		ev->next->pprev = pprev;
+	ev->next = NULL;
+	ev->pprev = NULL;
+
+	/* If it was the last one on its slot, mark the slot as empty */
+	const uintptr_t offt = (uintptr_t) pprev - (uintptr_t) &tw->slots[0][0];
+	if (offt < sizeof(tw->slots) && !*pprev) {
+		const size_t slot_idx = offt / sizeof(struct timer_event *);
+		tw->occupied[slot_idx / TW_SLOTS] &= ~(1ULL << (slot_idx & TW_SLOT_MASK));
 	}
+}
 
-	for (shift = 32; shift > 0; shift--) {
-		mult = ((uint64_t) timer->clock_freq) << shift;
-		mult += NSECS_IN_SEC >> 1;
-		mult /= NSECS_IN_SEC;
-		if ((mult >> shift_accumulator) == 0)
+static void
+tw_insert(struct timer_wheel *tw, struct timer_event *ev)
+{
+	uint64_t tick = tw_event_tick(ev);
+	if (tick <= tw->clk)
+		tick = tw->clk + 1;
+
+	int lvl = 0;
+	for (; lvl < TW_LEVELS - 1; lvl++) {
+		if ((tick >> TW_LVL_SHIFT(lvl)) - (tw->clk >> TW_LVL_SHIFT(lvl)) < TW_SLOTS)
 			break;
 	}
 
-	timer->mult_ns2c = mult;
-	timer->shift_ns2c = shift;
+	uint64_t idx = tick >> TW_LVL_SHIFT(lvl);
+	const uint64_t max_idx = (tw->clk >> TW_LVL_SHIFT(lvl)) + TW_SLOTS - 1;
+	if (idx > max_idx)
+		idx = max_idx;
+
+	const unsigned int slot = idx & TW_SLOT_MASK;
+	tw_link(&tw->slots[lvl][slot], ev);
+	tw->occupied[lvl] |= 1ULL << slot;
+}
+
+/* Bring the wheel up to now, expired events go to the expired list,
+ * the rest of the events on the slots we went through get cascaded. */
+static void
+tw_advance(struct timer_wheel *tw, uint64_t now, struct timer_event **expired)
+{
+	const uint64_t old = tw->clk;
+	if (now <= old)
+		return;
+	tw->clk = now;
 
-	/* Same but for nsecs to clock() cycles, so it's
-	 * cycles = (nsecs / NSECS_IN_SEC) * CLOCKS_PER_SEC */
-	for (shift = 32; shift > 0; shift--) {
-		mult = ((uint64_t) CLOCKS_PER_SEC) << shift;
-		mult += NSECS_IN_SEC >> 1;
-		mult /= NSECS_IN_SEC;
-		if ((mult >> shift_accumulator) == 0)
+	for (int lvl = 0; lvl < TW_LEVELS; lvl++) {
+		const uint64_t from = (old >> TW_LVL_SHIFT(lvl)) + 1;
+		const uint64_t to = now >> TW_LVL_SHIFT(lvl);
+		/* If we didn't go through any slots here, we didn't
+		 * go through any slots on the levels above either */
+		if (to < from)
 			break;
+
+		uint64_t mask = ~0ULL;
+		if (to - from < TW_SLOTS - 1) {
+			const unsigned int rot = from & TW_SLOT_MASK;
+			mask = (1ULL << (to - from + 1)) - 1;
+			mask = (mask << rot) | (rot ? (mask >> (TW_SLOTS - rot)) : 0);
+		}
+
+		uint64_t due = tw->occupied[lvl] & mask;
+		tw->occupied[lvl] &= ~due;
+		while (due) {
+			const unsigned int slot = __builtin_ctzll(due);
+			due &= due - 1;
+			struct timer_event *ev = tw->slots[lvl][slot];
+			tw->slots[lvl][slot] = NULL;
+			while (ev) {
+				struct timer_event *next = ev->next;
+				if (tw_event_tick(ev) <= now)
+					tw_link(expired, ev);
+				else
+					tw_insert(tw, ev);
+				ev = next;
+			}
+		}
 	}
+}
+
+/* Arm mtimecmp for the next slot with events, or disarm it */
+static void
+tw_program(struct hart_state *hs, struct timer_wheel *tw)
+{
+	uint64_t next = UINT64_MAX;
 
-	timer->mult_c2c = mult;
-	timer->shift_c2c = shift;
+	for (int lvl = 0; lvl < TW_LEVELS; lvl++) {
+		const uint64_t occupied = tw->occupied[lvl];
+		if (!occupied)
+			continue;
+		const uint64_t first = (tw->clk >> TW_LVL_SHIFT(lvl)) + 1;
+		const unsigned int rot = first & TW_SLOT_MASK;
+		const uint64_t rotated = rot ? ((occupied >> rot) | (occupied << (TW_SLOTS - rot))) : occupied;
+		const uint64_t tick = (first + __builtin_ctzll(rotated)) << TW_LVL_SHIFT(lvl);
+		if (tick < next)
+			next = tick;
+	}
 
-	return timer;
+	/* Let the fast path of the timer interrupt (see hart_fast.S)
+	 * know it has to go through timer_wheel_run() */
+	const bool busy = (next != UINT64_MAX);
+	if (busy != hart_test_flags(hs, HS_FLAG_TIMERS)) {
+		if (busy)
+			hart_set_flags(hs, HS_FLAG_TIMERS);
+		else
+			hart_clear_flags(hs, HS_FLAG_TIMERS);
+	}
+
+	if (timer_use_sstc) {
+		if (!tw->stce) {
+			csr_set_bits(CSR_MENVCFG, CSR_MENVCFG_STCE);
+			tw->stce = true;
+		}
+		if (next == UINT64_MAX) {
+			mtimer_csr_disarm();
+			mtimer_csr_disable_irq();
+			return;
+		}
+		mtimer_csr_arm_at(next << TW_GRAN_SHIFT);
+		mtimer_csr_enable_irq();
+		return;
+	}
+
+	if (next == UINT64_MAX) {
+		mtimer_disarm();
+		mtimer_disable_irq();
+		return;
+	}
+	mtimer_arm_at(next << TW_GRAN_SHIFT);
+	mtimer_enable_irq();
 }
 
-static uint64_t __attribute__((noinline))
-timer_sample(timerid_t timerid, const struct timer_spec **_Nullable tspec)
+/* Called from the machine (or supervisor, with Sstc) timer interrupt
+ * handler (see hart.c), with the timer disarmed, returns false if the
+ * wheel had no events (so the interrupt wasn't for us) */
+bool
+timer_wheel_run(struct hart_state *hs)
 {
-	const struct timer_spec *timer = NULL;
-	uint64_t cycles = 0;
-	uint64_t tval = 0;
-	switch (timerid) {
-		case PLAT_TIMER_RTC:
-		case PLAT_TIMER_MTIMER:
-			#ifndef PLAT_NO_MTIMER
-				timer = timer_get_spec(timerid);
-				if (last_platform_tval == 0)
-					mtimer_reset_num_ticks();
-				cycles = mtimer_get_num_ticks();
-				mtimer_reset_num_ticks();
-				tval = (cycles * timer->mult_c2ns) >> timer->shift_c2ns;
-				tval += last_platform_tval;
-				last_platform_tval = tval;
-				break;
-			#else
-				/* Fallthrough */
-			#endif
-		case PLAT_TIMER_CYCLES:
-			timer = timer_get_spec(timerid);
-			struct hart_state *hs = hart_get_hstate_self();
-			if (hs->last_cyclecount_tval == 0) {
-				hart_reset_counter(HC_CYCLES);
-				hart_enable_counter(HC_CYCLES);
-			}
-			cycles = hart_get_counter(HC_CYCLES);
-			hart_reset_counter(HC_CYCLES);
-			tval = (cycles * timer->mult_c2ns) >> timer->shift_c2ns;
-			tval += hs->last_cyclecount_tval;
-			hs->last_cyclecount_tval = tval;
-			break;
-		default:
-			ERR("Tried to sample unknown timerid: %i\n", timerid);
-			return 0;
+	struct timer_wheel *tw = *this_cpu_ptr(&timer_wheel);
+	struct timer_event *expired = NULL;
+	struct timer_event *ev = NULL;
+
+	if (!tw || tw_is_empty(tw))
+		return false;
+
+	const uint64_t now = tw_now();
+	tw_advance(tw, now, &expired);
+
+	/* Handlers may add / cancel events, including
+	 * the ones still on the expired list. */
+	while ((ev = expired) != NULL) {
+		tw_unlink(tw, ev);
+		if (ev->period) {
+			ev->expires += ev->period;
+			if (tw_event_tick(ev) <= now)
+				ev->expires = (now << TW_GRAN_SHIFT) + ev->period;
+			tw_insert(tw, ev);
+		}
+		/* The handler may free / reuse ev */
+		#if defined(TRAP_TRACE)
+			const timer_handler_t handler = ev->handler;
+		#endif
+		TRAP_TRACE_STAMP(trace_start);
+		ev->handler(ev);
+		TRAP_TRACE_RECORD(TRAP_TRACE_TIMER_FIRE, 0, handler, trace_start);
+	}
+
+	tw_program(hs, tw);
+	return true;
+}
+
+static void
+timer_sleep_done(struct timer_event *ev)
+{
+	hart_clear_flags((struct hart_state *) ev->arg, HS_FLAG_SLEEPING);
+}
+
+/* Sleep on wfi until the timer wheel wakes us up */
+static void
+timer_sleep_wfi(struct hart_state *hs, uint64_t nsecs)
+{
+	struct timer_event sleep_ev = {
+		.handler = timer_sleep_done,
+		.arg = hs
+	};
+	hart_set_flags(hs, HS_FLAG_SLEEPING);
+	/* No timer wheel, let the caller spin instead */
+	if (timer_add(&sleep_ev, nsecs, 0) < 0) {
+		hart_clear_flags(hs, HS_FLAG_SLEEPING);
+		return;
+	}
+	/* Wait for the timer wheel to clear
+	 * the HS_FLAG_SLEEPING flag. */
+	while (hart_test_flags(hs, HS_FLAG_SLEEPING)) {
+		wfi();
 	}
-	if (tspec)
-		*tspec = timer;
-	return tval;
+}
+#endif /* PLAT_NO_MTIMER */
+
+/*************\
+* CALIBRATION *
+\*************/
+
+/*
+ * Going through the timer wheel costs an interrupt round trip, a
+ * wfi wakeup, and the wheel's rounding, which for short delays is
+ * much longer than the delay itself, while spinning on the cycle
+ * counter is accurate but keeps the hart busy. So timer_nanosleep()
+ * spins for delays below that cost, and for longer ones it sleeps on
+ * wfi until that much before the deadline, and spins for the rest.
+ *
+ * The cost is measured at boot by the boot hart (all harts are
+ * assumed to be the same), by sleeping for a few wheel ticks a few
+ * times and averaging how late we woke up. The first round is not
+ * counted, it warms up the caches.
+ */
+
+#define TIMER_CAL_ROUNDS	8
+
+static uint64_t timer_wakeup_nsecs = 0;
+
+#ifndef PLAT_NO_MTIMER
+/*
+ * Each hart also counts its cycles for TIMER_CAL_NSECS of mtime, a few
+ * times, and derives its cycle counter's multipliers from the median
+ * sample, so that an interrupt between reading mtime and the cycle
+ * counter doesn't throw it off. We start and stop right after mtime
+ * ticks, so that the error is a few cycles (the time it takes to read
+ * mtime) instead of up to an mtime tick at each end, which lets us keep
+ * the samples short, since the boot hart's one is on the boot time.
+ */
+#define TIMER_CAL_NSECS		100000UL
+#define TIMER_CAL_SAMPLES	3
+
+struct timer_cal_sample {
+	uint64_t cycles;
+	uint64_t nsecs;
+};
+
+static void
+timer_sample_cycles(uint64_t ticks, struct timer_cal_sample *sample)
+{
+	const uint64_t prev = timer_read_mtime();
+	uint64_t start = 0;
+	uint64_t end = 0;
+
+	while ((start = timer_read_mtime()) == prev)
+		;
+	const uint64_t start_cycles = hart_get_counter(HC_CYCLES);
+	while ((end = timer_read_mtime()) < start + ticks)
+		;
+	sample->cycles = hart_get_counter(HC_CYCLES) - start_cycles;
+	sample->nsecs = timer_convert(end - start, platform_timer.mult_c2ns);
+}
+
+/* If a counted less cycles per nsec than b */
+static inline bool
+timer_sample_lt(const struct timer_cal_sample *a, const struct timer_cal_sample *b)
+{
+	return a->cycles * b->nsecs < b->cycles * a->nsecs;
+}
+
+static void
+timer_calibrate_cycles(struct hart_state *hs)
+{
+	uint64_t ticks = timer_convert(TIMER_CAL_NSECS, platform_timer.mult_ns2c);
+	struct timer_cal_sample samples[TIMER_CAL_SAMPLES];
+
+	if (!ticks)
+		ticks = 1;
+
+	/* Insertion sort as we go, there are only a few of them */
+	for (int i = 0; i < TIMER_CAL_SAMPLES; i++) {
+		struct timer_cal_sample sample;
+		timer_sample_cycles(ticks, &sample);
+		int j = i;
+		for (; j > 0 && timer_sample_lt(&sample, &samples[j - 1]); j--)
+			samples[j] = samples[j - 1];
+		samples[j] = sample;
+	}
+
+	const uint64_t cycles = samples[TIMER_CAL_SAMPLES / 2].cycles;
+	const uint64_t nsecs = samples[TIMER_CAL_SAMPLES / 2].nsecs;
+	const uint64_t mult_ns2c = ((cycles << TIMER_NS2C_SHIFT) + (nsecs >> 1)) / nsecs;
+	if (!cycles || mult_ns2c > UINT32_MAX) {
+		WRN("Could not calibrate cycle counter (%lu cycles in %lu nsecs)\n",
+		    cycles, nsecs);
+		return;
+	}
+	hs->cycle_mult_c2ns = ((nsecs << TIMER_SHIFT) + (cycles >> 1)) / cycles;
+	hs->cycle_mult_ns2c = (uint32_t) mult_ns2c;
+	DBG("Hart %i cycle counter at %lu Hz (PLAT_HART_FREQ: %lu Hz)\n",
+	    hs->hart_idx, (cycles * NSECS_IN_SEC) / nsecs, (uint64_t) PLAT_HART_FREQ);
+}
+
+static void
+timer_calibrate_wakeup(struct hart_state *hs)
+{
+	const uint64_t delay = timer_convert(4ULL << TW_GRAN_SHIFT, platform_timer.mult_c2ns);
+	uint64_t total = 0;
+
+	for (int i = 0; i <= TIMER_CAL_ROUNDS; i++) {
+		const uint64_t start = timer_convert(timer_read_mtime(), platform_timer.mult_c2ns);
+		timer_sleep_wfi(hs, delay);
+		const uint64_t end = timer_convert(timer_read_mtime(), platform_timer.mult_c2ns);
+		if (i > 0 && (end - start) > delay)
+			total += (end - start) - delay;
+	}
+	timer_wakeup_nsecs = total / TIMER_CAL_ROUNDS;
+	DBG("Timer wakeup latency: %lu nsecs\n", timer_wakeup_nsecs);
+}
+#endif
+
+static void
+timer_spin_cycles(uint64_t cycles)
+{
+	const uint64_t start = hart_get_counter(HC_CYCLES);
+	while ((hart_get_counter(HC_CYCLES) - start) < cycles)
+		;
+}
+
+/* Called by hart_init() on each hart, with interrupts allowed */
+void
+timer_init_hart(struct hart_state *hs)
+{
+	#ifndef PLAT_NO_MTIMER
+		struct timer_wheel *tw = page_alloc(TW_PAGES, 0);
+		if (tw) {
+			memset(tw, 0, sizeof(struct timer_wheel));
+			*this_cpu_ptr(&timer_wheel) = tw;
+		} else
+			WRN("No memory for the timer wheel, timer_add() won't work on this hart\n");
+		timer_calibrate_cycles(hs);
+		if (hs->hart_idx == 0)
+			timer_calibrate_wakeup(hs);
+	#endif
 }
 
 /**************\
@@ -226,18 +623,23 @@ timer_get_resolution(timerid_t timerid)
 uint64_t
 timer_get_nsecs(timerid_t timerid)
 {
-	return timer_sample(timerid, NULL);
+	const struct timer_spec *timer = timer_get_spec(timerid);
+	if (!timer) {
+		ERR("Tried to sample unknown timerid: %i\n", timerid);
+		return 0;
+	}
+	return timer_to_nsecs(timer, timer_read_ticks(timerid));
 }
 
 uint64_t
 timer_get_num_ticks(timerid_t timerid)
 {
-	const struct timer_spec *timer = NULL;
-	uint64_t nsecs = timer_sample(timerid, &timer);
+	const struct timer_spec *timer = timer_get_spec(timerid);
 	if (!timer)
 		return 0;
-	uint64_t cycles = (nsecs * timer->mult_c2c) >> timer->shift_c2c;
-	return cycles;
+	if (timer == &cyclecount_timer)
+		return timer_convert(timer_to_nsecs(timer, timer_read_ticks(timerid)), timer_mult_ns2clk);
+	return timer_convert(timer_read_ticks(timerid), timer->mult_c2clk);
 }
 
 uint64_t
@@ -246,7 +648,7 @@ timer_nsecs_to_cycles(timerid_t timerid, uint64_t nsecs)
 	const struct timer_spec *timer = timer_get_spec(timerid);
 	if (!timer)
 		return 0;
-	return (nsecs * timer->mult_ns2c) >> timer->shift_ns2c;
+	return timer_from_nsecs(timer, nsecs);
 }
 
 void
@@ -256,35 +658,100 @@ timer_nanosleep(timerid_t timerid, uint64_t nsecs)
 	const struct timer_spec *timer = timer_get_spec(timerid);
 	if (!timer)
 		return;
-	uint64_t cycles_to_wait = (nsecs * timer->mult_ns2c) >> timer->shift_ns2c;
-
-	switch (timerid) {
-	case PLAT_TIMER_RTC:
-	case PLAT_TIMER_MTIMER:
-		#ifndef PLAT_NO_MTIMER
-			hart_set_flags(hs, HS_FLAG_SLEEPING);
-			mtimer_arm_after_ticks(cycles_to_wait);
-			mtimer_enable_irq();
-			/* Wait for the trap handler to clear the
-			 * HS_FLAG_SLEEPING flag and disarm the timer. */
-			while (hart_test_flags(hs, HS_FLAG_SLEEPING)) {
-				wfi();
-			}
-			mtimer_disable_irq();
-			break;
-		#endif
-		/* Fallthrough */
-	case PLAT_TIMER_CYCLES:
-		uint64_t curr_cycles = hart_get_counter(HC_CYCLES);
-		uint64_t tot_cycles = curr_cycles + cycles_to_wait;
+	const uint64_t end = timer_read_ticks(timerid) + timer_from_nsecs(timer, nsecs);
 
-		hart_set_flags(hs, HS_FLAG_SLEEPING);
-		while (tot_cycles > curr_cycles)
-			curr_cycles = hart_get_counter(HC_CYCLES);
+	/* Long enough to be worth going through the timer interrupt,
+	 * wake up early to make up for its latency. With interrupts
+	 * blocked (e.g. from an interrupt handler) we can only spin. */
+	#ifndef PLAT_NO_MTIMER
+		if (nsecs > timer_wakeup_nsecs && (csr_read(CSR_MSTATUS) & CSR_MSTATUS_MIE))
+			timer_sleep_wfi(hs, nsecs - timer_wakeup_nsecs);
+	#endif
 
-		hart_clear_flags(hs, HS_FLAG_SLEEPING);
-		break;
-	default:
+	/* Spin for the rest on the cycle counter */
+	const uint64_t now = timer_read_ticks(timerid);
+	if (now >= end)
 		return;
-	}
+	uint64_t cycles = end - now;
+	if (timer != &cyclecount_timer)
+		cycles = timer_from_nsecs(&cyclecount_timer, timer_to_nsecs(timer, cycles));
+
+	hart_set_flags(hs, HS_FLAG_SLEEPING);
+	timer_spin_cycles(cycles);
+	hart_clear_flags(hs, HS_FLAG_SLEEPING);
+}
+
+/* Call ev->handler after nsecs, and then every period_nsecs if non-zero,
+ * from the machine timer interrupt on the calling hart. The event must
+ * stay around until it fires (one-shot) or gets cancelled. */
+int
+timer_add(struct timer_event *ev, uint64_t nsecs, uint64_t period_nsecs)
+{
+	#ifndef PLAT_NO_MTIMER
+		if (!ev || !ev->handler)
+			return -EINVAL;
+
+		const bool irqs_on = csr_read(CSR_MSTATUS) & CSR_MSTATUS_MIE;
+		hart_block_interrupts();
+
+		struct hart_state *hs = hart_get_hstate_self();
+		struct timer_wheel *tw = *this_cpu_ptr(&timer_wheel);
+		if (!tw || ev->pprev) {
+			if (irqs_on)
+				hart_allow_interrupts();
+			return tw ? -EBUSY : -ENOMEM;
+		}
+
+		/* Nothing to cascade, start counting from now */
+		const uint64_t now = timer_read_mtime();
+		if (tw_is_empty(tw))
+			tw->clk = now >> TW_GRAN_SHIFT;
+
+		ev->expires = now + timer_convert(nsecs, platform_timer.mult_ns2c);
+		ev->period = timer_convert(period_nsecs, platform_timer.mult_ns2c);
+		if (period_nsecs && !ev->period)
+			ev->period = 1;
+		ev->hart_idx = hs->hart_idx;
+		tw_insert(tw, ev);
+		tw_program(hs, tw);
+
+		if (irqs_on)
+			hart_allow_interrupts();
+		return 0;
+	#else
+		return -ENOTSUP;
+	#endif
+}
+
+/* Returns -EINVAL if the event wasn't pending (already fired, or never
+ * added), or -EPERM when called from a different hart than the one that
+ * added it. */
+int
+timer_cancel(struct timer_event *ev)
+{
+	#ifndef PLAT_NO_MTIMER
+		if (!ev)
+			return -EINVAL;
+
+		const bool irqs_on = csr_read(CSR_MSTATUS) & CSR_MSTATUS_MIE;
+		hart_block_interrupts();
+
+		struct hart_state *hs = hart_get_hstate_self();
+		int ret = 0;
+		if (!ev->pprev)
+			ret = -EINVAL;
+		else if (ev->hart_idx != hs->hart_idx)
+			ret = -EPERM;
+		else {
+			struct timer_wheel *tw = *this_cpu_ptr(&timer_wheel);
+			tw_unlink(tw, ev);
+			tw_program(hs, tw);
+		}
+
+		if (irqs_on)
+			hart_allow_interrupts();
+		return ret;
+	#else
+		return -ENOTSUP;
+	#endif
 }
@@ -0,0 +1,221 @@
+/*
+ * SPDX-FileType: SOURCE
+ *
+ * SPDX-FileCopyrightText: 2026 Nick Kossifidis <mick@ics.forth.gr>
+ * SPDX-FileCopyrightText: 2026 ICS/FORTH
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <target_config.h>		/* For PLAT_MAX_HARTS */
+#include <platform/riscv/hart.h>	/* For hart_get_count() */
+#include <platform/utils/trap_trace.h>	/* For the trap_trace API */
+#include <platform/utils/utils.h>	/* For console output */
+#include <stdint.h>			/* For typed integers */
+#include <string.h>			/* For memset() */
+#include <errno.h>			/* For error codes */
+#include <malloc.h>			/* For page_alloc() */
+
+#if defined(TRAP_TRACE)
+
+#include <platform/utils/percpu.h>	/* For __percpu / this_cpu_ptr() */
+#include <platform/interfaces/timer.h>	/* For timer_get_num_ticks() */
+#include <stdatomic.h>			/* For C11 atomics */
+#include <stdbool.h>			/* For bool */
+
+_Static_assert((TRAP_TRACE_ENTRIES & (TRAP_TRACE_ENTRIES - 1)) == 0,
+	       "TRAP_TRACE_ENTRIES must be a power of two");
+
+/* Each hart's ring, the records come from the page allocator in
+ * hart_init(), head counts all records ever written on it. */
+struct trap_trace_ring {
+	struct trap_trace_rec *recs;
+	_Atomic(uint64_t) head;
+	uint16_t hart_idx;
+};
+
+static struct trap_trace_ring trap_trace_rings __percpu = { 0 };
+
+/* Set while dumping / resetting */
+static atomic_bool trap_trace_paused = false;
+
+#define TRAP_TRACE_MASK		(TRAP_TRACE_ENTRIES - 1)
+#define TRAP_TRACE_PAGES	\
+	((TRAP_TRACE_ENTRIES * sizeof(struct trap_trace_rec) + PAGE_FRAME_SIZE - 1) / PAGE_FRAME_SIZE)
+
+static const char *trap_trace_event_names[TRAP_TRACE_NUM_EVENTS] = {
+	[TRAP_TRACE_NONE] = "none",
+	[TRAP_TRACE_EXC] = "exception",
+	[TRAP_TRACE_TIMER] = "timer",
+	[TRAP_TRACE_TIMER_FIRE] = "timer_fire",
+	[TRAP_TRACE_IPI] = "ipi",
+	[TRAP_TRACE_IPI_SEND] = "ipi_send",
+	[TRAP_TRACE_IRQ] = "irq",
+};
+
+/* Called by each hart before it enables interrupts */
+void
+trap_trace_init_hart(void)
+{
+	struct trap_trace_ring *ring = this_cpu_ptr(&trap_trace_rings);
+	struct trap_trace_rec *recs = page_alloc(TRAP_TRACE_PAGES, 0);
+	if (!recs) {
+		WRN("No memory for the trap trace, not recording on this hart\n");
+		return;
+	}
+	memset(recs, 0, TRAP_TRACE_ENTRIES * sizeof(struct trap_trace_rec));
+	ring->hart_idx = hart_get_hstate_self()->hart_idx;
+	atomic_store_explicit(&ring->head, 0, memory_order_relaxed);
+	ring->recs = recs;
+}
+
+/* start is the mcycle value from TRAP_TRACE_STAMP(), 0 for instant events */
+void
+trap_trace_record(uint16_t event, uint32_t source, uint64_t arg, uint64_t start)
+{
+	const uint64_t now = csr_read(CSR_MCYCLE);
+	struct trap_trace_ring *ring = this_cpu_ptr(&trap_trace_rings);
+	if (!ring->recs || atomic_load_explicit(&trap_trace_paused, memory_order_relaxed))
+		return;
+
+	const uint64_t idx = atomic_fetch_add_explicit(&ring->head, 1, memory_order_relaxed);
+	struct trap_trace_rec *rec = &ring->recs[idx & TRAP_TRACE_MASK];
+	rec->time = timer_get_num_ticks(PLAT_TIMER_MTIMER);
+	rec->arg = arg;
+	rec->cycles = start ? (uint32_t) (now - start) : 0;
+	rec->source = source;
+	rec->event = event;
+	rec->hart_idx = ring->hart_idx;
+}
+
+static struct trap_trace_ring *
+trap_trace_get_ring(uint16_t hart_idx)
+{
+	if (hart_idx >= hart_get_count())
+		return NULL;
+	return per_cpu_ptr(&trap_trace_rings, hart_idx);
+}
+
+/* Valid records on a ring, up to TRAP_TRACE_ENTRIES */
+static inline uint64_t
+trap_trace_avail(uint64_t head)
+{
+	return (head < TRAP_TRACE_ENTRIES) ? head : TRAP_TRACE_ENTRIES;
+}
+
+static void
+trap_trace_print(const struct trap_trace_rec *rec, uint64_t prev_time)
+{
+	const char *name = (rec->event < TRAP_TRACE_NUM_EVENTS) ?
+			   trap_trace_event_names[rec->event] : "unknown";
+	INF("%14lu %+10ld  hart %-3u %-10s src 0x%-6x arg 0x%016lx %10u cycles\n",
+	    rec->time, (int64_t) (rec->time - prev_time), rec->hart_idx, name,
+	    rec->source, rec->arg, rec->cycles);
+}
+
+#endif /* TRAP_TRACE */
+
+
+/**************\
+* ENTRY POINTS *
+\**************/
+
+/* Copy out hart_idx's num most recent records, oldest first,
+ * returns how many there were */
+int
+trap_trace_read(uint16_t hart_idx, struct trap_trace_rec *out, unsigned int num)
+{
+	#if defined(TRAP_TRACE)
+		struct trap_trace_ring *ring = trap_trace_get_ring(hart_idx);
+		if (!ring)
+			return -EINVAL;
+		if (!ring->recs)
+			return 0;
+		const uint64_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+		if (num > trap_trace_avail(head))
+			num = trap_trace_avail(head);
+		for (unsigned int i = 0; i < num; i++)
+			out[i] = ring->recs[(head - num + i) & TRAP_TRACE_MASK];
+		return num;
+	#else
+		(void) hart_idx;
+		(void) out;
+		(void) num;
+		return -ENOTSUP;
+	#endif
+}
+
+int
+trap_trace_reset(void)
+{
+	#if defined(TRAP_TRACE)
+		atomic_store(&trap_trace_paused, true);
+		for (int i = 0; i < hart_get_count(); i++) {
+			struct trap_trace_ring *ring = trap_trace_get_ring(i);
+			if (!ring->recs)
+				continue;
+			atomic_store_explicit(&ring->head, 0, memory_order_relaxed);
+			memset(ring->recs, 0, TRAP_TRACE_ENTRIES * sizeof(struct trap_trace_rec));
+		}
+		atomic_store(&trap_trace_paused, false);
+		return 0;
+	#else
+		return -ENOTSUP;
+	#endif
+}
+
+/*
+ * Print the last num records (0 for all of them) of all harts, merged by
+ * their mtime timestamps, with the ticks since the previous one. Records
+ * written while we dump are lost.
+ */
+int
+trap_trace_dump(unsigned int num)
+{
+	#if defined(TRAP_TRACE)
+		static uint64_t cur[PLAT_MAX_HARTS];
+		static uint64_t end[PLAT_MAX_HARTS];
+		const int num_harts = hart_get_count();
+		uint64_t total = 0;
+
+		atomic_store(&trap_trace_paused, true);
+		for (int i = 0; i < num_harts; i++) {
+			struct trap_trace_ring *ring = trap_trace_get_ring(i);
+			end[i] = ring->recs ? atomic_load(&ring->head) : 0;
+			cur[i] = end[i] - trap_trace_avail(end[i]);
+			total += end[i] - cur[i];
+		}
+
+		uint64_t skip = (num && total > num) ? total - num : 0;
+		uint64_t prev_time = 0;
+		INF("Trap trace, %lu records (time in mtime ticks, delta from the previous one):\n",
+		    total - skip);
+		for (uint64_t n = 0; n < total; n++) {
+			const struct trap_trace_rec *next = NULL;
+			int next_hart = 0;
+			for (int i = 0; i < num_harts; i++) {
+				if (cur[i] == end[i])
+					continue;
+				const struct trap_trace_rec *rec =
+					&trap_trace_get_ring(i)->recs[cur[i] & TRAP_TRACE_MASK];
+				if (!next || rec->time < next->time) {
+					next = rec;
+					next_hart = i;
+				}
+			}
+			cur[next_hart]++;
+			if (skip) {
+				skip--;
+				prev_time = next->time;
+				continue;
+			}
+			trap_trace_print(next, prev_time ? prev_time : next->time);
+			prev_time = next->time;
+		}
+		atomic_store(&trap_trace_paused, false);
+		return 0;
+	#else
+		(void) num;
+		return -ENOTSUP;
+	#endif
+}
@@ -8,13 +8,18 @@
  */
 
 #include <target_config.h>		/* For PLAT_UART_* / PLAT_NO_IRQ */
-#include <platform/interfaces/irq.h>	/* For REGISTER_IRQ_SOURCE */
+#include <platform/interfaces/irq.h>	/* For REGISTER_IRQ_SOURCE / irq_work_queue() */
 #include <platform/interfaces/uart.h>	/* For uart interface definitions */
 #include <platform/riscv/mmio.h>	/* For register access */
+#include <platform/riscv/hart.h>	/* For hart_block/allow_interrupts() */
+#include <platform/utils/lock.h>	/* For sdk_lock_acquire/release() */
 #include <platform/utils/utils.h>	/* For DBG */
+#include <stdbool.h>			/* For bool */
+#include <stdlib.h>			/* For malloc() */
 #include <errno.h>			/* For EAGAIN, EIO */
 
-#if defined(PLAT_UART_BASE) && (PLAT_UART_BASE > 0)
+#if defined(PLAT_UART_BASE) && (PLAT_UART_BASE > 0) && \
+    !(defined(PLAT_VIRTIO_CONSOLE_BASE) && (PLAT_VIRTIO_CONSOLE_BASE > 0))
 
 /*
  * This is a simple driver for an 8250/16550A compatible UART, for more
@@ -40,6 +45,17 @@
 #define UART_SCR_OFFSET		0x7	/* I/O: Scratch Register */
 #define UART_MDR1_OFFSET	0x8	/* I/O:  Mode Register */
 
+#define UART_IER_RDI		0x01	/* Receiver data interrupt */
+#define UART_IER_THRI		0x02	/* Transmit-hold-register empty interrupt */
+
+#define UART_IIR_NO_INT		0x01	/* No interrupt pending */
+#define UART_IIR_ID_MASK	0x0E	/* Mask for the interrupt ID */
+#define UART_IIR_MSI		0x00	/* Modem status interrupt */
+#define UART_IIR_THRI		0x02	/* Transmit-hold-register empty */
+#define UART_IIR_RDI		0x04	/* Receiver data available */
+#define UART_IIR_RLSI		0x06	/* Receiver line status interrupt */
+#define UART_IIR_CTI		0x0C	/* Character timeout (data in RX FIFO) */
+
 #define UART_LSR_FIFOE		0x80    /* Fifo error */
 #define UART_LSR_TEMT		0x40    /* Transmitter empty */
 #define UART_LSR_THRE		0x20    /* Transmit-hold-register empty */
@@ -56,12 +72,55 @@
 #define	UART_FCR_DMA_MODE	0x8	/* Enable DMA mode (RXRDY/TXRDY) */
 #define	UART_FCR_FIFO_TRIG_LVL	0x60	/* Mask for FIFO Trigger level */
 
+/* Tx FIFO size, from target_config.h (a 16550A has a 16byte FIFO).
+ * New lines go out as "\n\r", so it needs at least two slots. */
+#ifndef PLAT_UART_FIFO_DEPTH
+	#define PLAT_UART_FIFO_DEPTH	16
+#endif
+#if (PLAT_UART_FIFO_DEPTH < 2)
+	#error "PLAT_UART_FIFO_DEPTH must be at least 2"
+#endif
+
+/*
+ * Software rings on top of the FIFOs, so that a hart can queue a message
+ * with uart_write() and go back to work, instead of spinning at the line
+ * rate. The Tx ring is drained by the THRE interrupt (enabled while there
+ * is something to send), or, when interrupts are off / not available, by
+ * the next call that touches the Tx path (see uart_flush()). The Rx ring
+ * is filled by the receive interrupt, uart_getc()/uart_read() check it
+ * before polling the UART. Both are protected by uart_lock, taken with
+ * interrupts blocked on the local hart, since the interrupt handler
+ * also needs it. The rings are allocated by uart_init() (to keep .bss
+ * small), without them uart_write() goes straight to the FIFO and
+ * received characters that nobody polled for get dropped.
+ */
+#define UART_TX_RING_SIZE	1024
+#define UART_TX_RING_MASK	(UART_TX_RING_SIZE - 1)
+#define UART_RX_RING_SIZE	256
+#define UART_RX_RING_MASK	(UART_RX_RING_SIZE - 1)
+
+static struct {
+	uint32_t tx_head;
+	uint32_t tx_tail;
+	uint32_t rx_head;
+	uint32_t rx_tail;
+	uint32_t rx_dropped;
+	int tx_room;		/* Free Tx FIFO slots, last time we checked */
+	uint8_t ier;		/* Shadow of IER */
+	bool tx_cr;		/* A carriage return is due for the last '\n' */
+	bool irq_on;		/* uart_enable_irq() was called */
+	uint8_t *tx_ring;
+	uint8_t *rx_ring;
+} uart_state;
+
+static sdk_lock_t uart_lock = SDK_LOCK_INIT;
+
 /*********\
 * Helpers *
 \*********/
 
 static inline void
-uart_write(int reg, uint8_t val)
+uart_reg_write(int reg, uint8_t val)
 {
 	uintptr_t addr = (uintptr_t)(PLAT_UART_BASE + (reg << PLAT_UART_REG_SHIFT));
 	#if defined(PLAT_UART_SHIFTED_IO) && (PLAT_UART_REG_SHIFT == 4)
@@ -74,7 +133,7 @@ uart_write(int reg, uint8_t val)
 }
 
 static inline uint8_t
-uart_read(int reg)
+uart_reg_read(int reg)
 {
 	uintptr_t addr = (uintptr_t)(PLAT_UART_BASE + (reg << PLAT_UART_REG_SHIFT));
 	#if defined(PLAT_UART_SHIFTED_IO) && (PLAT_UART_REG_SHIFT == 4)
@@ -86,6 +145,122 @@ uart_read(int reg)
 	#endif
 }
 
+static inline bool
+uart_lock_acquire(void)
+{
+	const bool irqs_on = csr_read(CSR_MSTATUS) & CSR_MSTATUS_MIE;
+	hart_block_interrupts();
+	sdk_lock_acquire(&uart_lock);
+	return irqs_on;
+}
+
+static inline void
+uart_lock_release(bool irqs_on)
+{
+	sdk_lock_release(&uart_lock);
+	if (irqs_on)
+		hart_allow_interrupts();
+}
+
+/* How many bytes we can push to the Tx FIFO without overflowing it. The
+ * FIFO only drains while we aren't looking, so what was left the last
+ * time we checked is a lower bound, and we only need to ask the UART
+ * again when that's not enough. Without a Tx FIFO level register, THRE
+ * is all we can tell (the FIFO is empty), so once we see it we can push
+ * a whole PLAT_UART_FIFO_DEPTH worth of bytes without polling again.
+ * Writers update tx_room for what they pushed.
+ * Called with uart_lock held. */
+static int
+uart_tx_room(int needed)
+{
+	if (uart_state.tx_room >= needed)
+		return uart_state.tx_room;
+
+	#if defined(PLAT_UART_TX_FIFO_LEVEL_REG)
+		int level = uart_reg_read(PLAT_UART_TX_FIFO_LEVEL_REG);
+		uart_state.tx_room = (level < PLAT_UART_FIFO_DEPTH) ? PLAT_UART_FIFO_DEPTH - level : 0;
+	#else
+		if (uart_reg_read(UART_LSR_OFFSET) & UART_LSR_THRE)
+			uart_state.tx_room = PLAT_UART_FIFO_DEPTH;
+	#endif
+	return uart_state.tx_room;
+}
+
+static inline bool
+uart_tx_pending(void)
+{
+	return (uart_state.tx_head != uart_state.tx_tail) || uart_state.tx_cr;
+}
+
+static void
+uart_set_ier(uint8_t ier)
+{
+	if (ier == uart_state.ier)
+		return;
+	uart_state.ier = ier;
+	uart_reg_write(UART_IER_OFFSET, ier);
+}
+
+/* Move as much as we can from the Tx ring to the Tx FIFO,
+ * and ask for an interrupt when it drains if there is more to send.
+ * Called with uart_lock held. */
+static void
+uart_tx_fill(void)
+{
+	if (!uart_tx_pending())
+		goto done;
+
+	int room = uart_tx_room(1);
+	if (!room)
+		goto done;
+
+	if (uart_state.tx_cr) {
+		uart_reg_write(UART_THR_OFFSET, '\r');
+		uart_state.tx_cr = false;
+		room--;
+	}
+
+	while (room > 0 && uart_state.tx_tail != uart_state.tx_head) {
+		uint8_t c = uart_state.tx_ring[uart_state.tx_tail++ & UART_TX_RING_MASK];
+		uart_reg_write(UART_THR_OFFSET, c);
+		room--;
+		/* Same as uart_putc, new lines also get a carriage return */
+		if (c == '\n') {
+			if (room > 0) {
+				uart_reg_write(UART_THR_OFFSET, '\r');
+				room--;
+			} else
+				uart_state.tx_cr = true;
+		}
+	}
+	uart_state.tx_room = room;
+
+ done:
+	if (uart_state.irq_on && uart_tx_pending())
+		uart_set_ier(uart_state.ier | UART_IER_THRI);
+	else
+		uart_set_ier(uart_state.ier & ~UART_IER_THRI);
+}
+
+/* Move whatever is in the Rx FIFO to the Rx ring, dropping
+ * characters when it's full. Called with uart_lock held. */
+static bool
+uart_rx_drain(void)
+{
+	bool got_data = false;
+	while (uart_reg_read(UART_LSR_OFFSET) & UART_LSR_DR) {
+		uint8_t c = uart_reg_read(UART_RBR_OFFSET);
+		got_data = true;
+		if (!uart_state.rx_ring ||
+		    uart_state.rx_head - uart_state.rx_tail == UART_RX_RING_SIZE) {
+			uart_state.rx_dropped++;
+			continue;
+		}
+		uart_state.rx_ring[uart_state.rx_head++ & UART_RX_RING_MASK] = c;
+	}
+	return got_data;
+}
+
 /**************\
 * Entry points *
 \**************/
@@ -96,33 +271,39 @@ uart_init(void)
 	uint8_t uart_divisor = (uint8_t) (PLAT_UART_CLOCK_HZ / (PLAT_UART_BAUD_RATE << 4));
 
 	/* Disable interrupts */
-	uart_write(UART_IER_OFFSET, 0);
+	uart_reg_write(UART_IER_OFFSET, 0);
 
 	/* Enable DLAB */
-	uart_write(UART_LCR_OFFSET, 0x80);
+	uart_reg_write(UART_LCR_OFFSET, 0x80);
 
 	/* Set divisor low/high bytes*/
 	/* Example: 50MHz / (115200 << 4) = 27.1... -> 0x1b */
-	uart_write(UART_DLL_OFFSET, uart_divisor);
+	uart_reg_write(UART_DLL_OFFSET, uart_divisor);
 
 	/* Set Line Control Register:
 	 * 8 bits, no parity, one stop bit */
-	uart_write(UART_LCR_OFFSET, 0x3);
+	uart_reg_write(UART_LCR_OFFSET, 0x3);
 
 	/* No modem control DTR/RTS */
-	uart_write(UART_MCR_OFFSET, 0x0);
+	uart_reg_write(UART_MCR_OFFSET, 0x0);
 
 	/* Set scratchpad */
-	uart_write(UART_SCR_OFFSET, 0x0);
+	uart_reg_write(UART_SCR_OFFSET, 0x0);
 
 	/* Enable and clear FIFO */
-	uart_write(UART_FCR_OFFSET, 0x07);
+	uart_reg_write(UART_FCR_OFFSET, 0x07);
 
 	/* Clear any pending RX */
-	uart_read(UART_RBR_OFFSET);
+	uart_reg_read(UART_RBR_OFFSET);
 
 	/* Clear any pending errors */
-	uart_read(UART_LSR_OFFSET);
+	uart_reg_read(UART_LSR_OFFSET);
+
+	/* After the UART is up, the allocator may log */
+	if (!uart_state.tx_ring)
+		uart_state.tx_ring = malloc(UART_TX_RING_SIZE);
+	if (!uart_state.rx_ring)
+		uart_state.rx_ring = malloc(UART_RX_RING_SIZE);
 
 	return;
 }
@@ -130,7 +311,18 @@ uart_init(void)
 int
 uart_getc(void)
 {
-	uint8_t lsr = uart_read(UART_LSR_OFFSET);
+	/* Anything the interrupt handler got goes first */
+	if (uart_state.rx_head != uart_state.rx_tail) {
+		int ret = -EAGAIN;
+		bool irqs_on = uart_lock_acquire();
+		if (uart_state.rx_head != uart_state.rx_tail)
+			ret = uart_state.rx_ring[uart_state.rx_tail++ & UART_RX_RING_MASK];
+		uart_lock_release(irqs_on);
+		if (ret >= 0)
+			return ret;
+	}
+
+	uint8_t lsr = uart_reg_read(UART_LSR_OFFSET);
 
 	/* Check for errors */
 	if (lsr & UART_LSR_BRK_ERROR_BITS)
@@ -138,42 +330,155 @@ uart_getc(void)
 
 	/* We have data available, read the next character in FIFO */
 	if(lsr & UART_LSR_DR)
-		return uart_read(UART_RBR_OFFSET);
+		return uart_reg_read(UART_RBR_OFFSET);
 
 	/* No data yet, caller should try again */
 	return -EAGAIN;
 }
 
+/* Non-blocking, read up to len bytes of whatever has been received so
+ * far, returns the number of bytes read or -EAGAIN if there was nothing */
+int
+uart_read(void *buff, size_t len)
+{
+	uint8_t *data = (uint8_t*) buff;
+	size_t i = 0;
+
+	bool irqs_on = uart_lock_acquire();
+	uart_rx_drain();
+	while (i < len && uart_state.rx_head != uart_state.rx_tail)
+		data[i++] = uart_state.rx_ring[uart_state.rx_tail++ & UART_RX_RING_MASK];
+	uart_lock_release(irqs_on);
+
+	if (len && !i)
+		return -EAGAIN;
+	return (int) i;
+}
+
+/* Non-blocking, queue up to len bytes for transmission, returns
+ * the number of bytes queued or -EAGAIN if the Tx ring is full */
+int
+uart_write(const void *buff, size_t len)
+{
+	const uint8_t *data = (const uint8_t*) buff;
+
+	if (!uart_state.tx_ring) {
+		uart_write_buf(buff, len);
+		return (int) len;
+	}
+
+	bool irqs_on = uart_lock_acquire();
+	uint32_t room = UART_TX_RING_SIZE - (uart_state.tx_head - uart_state.tx_tail);
+	if (len > room)
+		len = room;
+	for (size_t i = 0; i < len; i++)
+		uart_state.tx_ring[uart_state.tx_head++ & UART_TX_RING_MASK] = data[i];
+	uart_tx_fill();
+	uart_lock_release(irqs_on);
+
+	if (!len && room == 0)
+		return -EAGAIN;
+	return (int) len;
+}
+
+/* Wait until everything queued with uart_write() is in the Tx FIFO */
 void
-uart_putc(uint8_t c)
+uart_flush(void)
 {
-	uint8_t lsr = 0;
+	while (uart_tx_pending()) {
+		bool irqs_on = uart_lock_acquire();
+		uart_tx_fill();
+		uart_lock_release(irqs_on);
+		pause();
+	}
+}
 
-	/* Wait for transmit register to be flushed */
-	do {
-		lsr = uart_read(UART_LSR_OFFSET);
-	} while(!(lsr & UART_LSR_THRE));
+void
+uart_putc(uint8_t c)
+{
+	/* Don't get ahead of anything queued with uart_write() */
+	uart_flush();
+
+	/* Wait for room in the Tx FIFO, if we got a new line
+	 * we'll also print a carriage return */
+	const int needed = (c == '\n') ? 2 : 1;
+	bool irqs_on;
+	while (1) {
+		irqs_on = uart_lock_acquire();
+		if (uart_tx_room(needed) >= needed)
+			break;
+		uart_lock_release(irqs_on);
+		pause();
+	}
 
 	/* Write byte to the Tx buffer */
-	uart_write(UART_THR_OFFSET, c);
-	/* If we got a new line, also print a carriage return */
+	uart_reg_write(UART_THR_OFFSET, c);
 	if (c == '\n')
-		uart_write(UART_THR_OFFSET, '\r');
+		uart_reg_write(UART_THR_OFFSET, '\r');
+	uart_state.tx_room -= needed;
 
+	uart_lock_release(irqs_on);
 	return;
 }
 
+/* Send a whole buffer (e.g. a formatted line), instead of polling LSR
+ * for each character fill up the Tx FIFO whenever there's room. */
+void
+uart_write_buf(const void *buff, size_t len)
+{
+	const uint8_t *data = (const uint8_t*) buff;
+	size_t i = 0;
+
+	uart_flush();
+
+	while (i < len) {
+		bool irqs_on = uart_lock_acquire();
+		int room = uart_tx_room(2);
+		if (room < 2) {
+			/* Wait for the Tx FIFO to drain */
+			uart_lock_release(irqs_on);
+			pause();
+			continue;
+		}
+
+		for (; room > 0 && i < len; i++) {
+			/* Same as uart_putc, new lines also get a carriage
+			 * return, so they need two slots in the FIFO */
+			if (data[i] == '\n') {
+				if (room < 2)
+					break;
+				uart_reg_write(UART_THR_OFFSET, '\n');
+				uart_reg_write(UART_THR_OFFSET, '\r');
+				room -= 2;
+			} else {
+				uart_reg_write(UART_THR_OFFSET, data[i]);
+				room--;
+			}
+		}
+		uart_state.tx_room = room;
+		uart_lock_release(irqs_on);
+	}
+}
+
 #ifndef PLAT_NO_IRQ
 void
 uart_enable_irq(void)
 {
-	uart_write(UART_IER_OFFSET, 1);
+	bool irqs_on = uart_lock_acquire();
+	uart_state.irq_on = true;
+	uart_set_ier(uart_state.ier | UART_IER_RDI);
+	/* Also enables the THRE interrupt if there's something queued */
+	uart_tx_fill();
+	uart_lock_release(irqs_on);
 }
 
 void
 uart_disable_irq(void)
 {
-	uart_write(UART_IER_OFFSET, 0);
+	bool irqs_on = uart_lock_acquire();
+	uart_state.irq_on = false;
+	uart_set_ier(0);
+	uart_lock_release(irqs_on);
 }
 
 static uart_irq_handler_t uart_irq_handler = NULL;
@@ -187,14 +492,63 @@ void uart_set_irq_handler(uart_irq_handler_t new_handler)
 	}
 }
 
+/* The user's handler runs as deferred work (see irq.h), with interrupts
+ * enabled, the trampoline below only drains the FIFO. A single run may
+ * cover more than one interrupt, so as in virtio_console.c keep calling
+ * the handler as long as it reads something. */
 static void
-uart_irq_trampoline(uint16_t source_id)
+uart_irq_work_fn(struct irq_work *work)
 {
-	/* Safety check in case someone sets NULL */
-	if (uart_irq_handler != NULL)
-		uart_irq_handler(source_id);
-	else
+	const uint16_t source_id = (uint16_t)(uintptr_t) work->arg;
+	uint32_t rx_tail = 0;
+
+	if (uart_irq_handler == NULL) {
 		DBG("UART interrupt received but no handler installed\n");
+		return;
+	}
+	do {
+		rx_tail = uart_state.rx_tail;
+		uart_irq_handler(source_id);
+	} while (uart_state.rx_head != uart_state.rx_tail && uart_state.rx_tail != rx_tail);
+}
+
+static struct irq_work uart_irq_work = IRQ_WORK_INIT(uart_irq_work_fn,
+						     (void *)(uintptr_t) PLAT_UART_IRQ);
+
+static void
+uart_irq_trampoline(uint16_t source_id)
+{
+	bool got_data = false;
+	uint8_t iir;
+
+	sdk_lock_acquire(&uart_lock);
+	while (!((iir = uart_reg_read(UART_IIR_OFFSET)) & UART_IIR_NO_INT)) {
+		switch (iir & UART_IIR_ID_MASK) {
+		case UART_IIR_RLSI:
+			/* Reading LSR clears it, uart_getc will report
+			 * any errors on the next character */
+			uart_reg_read(UART_LSR_OFFSET);
+			break;
+		case UART_IIR_RDI:
+		case UART_IIR_CTI:
+			got_data |= uart_rx_drain();
+			break;
+		case UART_IIR_THRI:
+			/* Reading IIR cleared it, refill the FIFO
+			 * (or disable it if there is nothing left) */
+			uart_tx_fill();
+			break;
+		default:
+			uart_reg_read(UART_MSR_OFFSET);
+			break;
+		}
+	}
+	sdk_lock_release(&uart_lock);
+
+	/* Let the user know there is new data (uart_getc will
+	 * return it from the Rx ring) */
+	if (got_data)
+		irq_work_queue(&uart_irq_work);
 }
 
 REGISTER_IRQ_SOURCE(uart0_rx, {
@@ -211,4 +565,4 @@ void uart_disable_irq(void) { return; }
 void uart_set_irq_handler(uart_irq_handler_t new_handler) { return; }
 
 #endif /* PLAT_NO_IRQ */
-#endif /* defined(PLAT_UART_BASE) && (PLAT_UART_BASE > 0) */
\ No newline at end of file
+#endif /* PLAT_UART_BASE && !PLAT_VIRTIO_CONSOLE_BASE */
\ No newline at end of file
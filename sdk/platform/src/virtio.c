@@ -0,0 +1,385 @@
+/*
+ * SPDX-FileType: SOURCE
+ *
+ * SPDX-FileCopyrightText: 2026 Nick Kossifidis <mick@ics.forth.gr>
+ * SPDX-FileCopyrightText: 2026 ICS/FORTH
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <platform/interfaces/virtio.h>	/* For the virtio API */
+#include <platform/riscv/mmio.h>	/* For register access */
+#include <platform/riscv/csr.h>		/* For pause() */
+#include <platform/utils/utils.h>	/* For console output */
+#include <stdatomic.h>			/* For atomic_thread_fence() */
+#include <string.h>			/* For memset() */
+#include <errno.h>			/* For error codes */
+
+/******************\
+* Register offsets *
+\******************/
+
+#define VIRTIO_MMIO_MAGIC_VALUE		0x000
+#define VIRTIO_MMIO_VERSION		0x004
+#define VIRTIO_MMIO_DEVICE_ID		0x008
+#define VIRTIO_MMIO_VENDOR_ID		0x00c
+#define VIRTIO_MMIO_DEVICE_FEATURES	0x010
+#define VIRTIO_MMIO_DEVICE_FEATURES_SEL	0x014
+#define VIRTIO_MMIO_DRIVER_FEATURES	0x020
+#define VIRTIO_MMIO_DRIVER_FEATURES_SEL	0x024
+#define VIRTIO_MMIO_QUEUE_SEL		0x030
+#define VIRTIO_MMIO_QUEUE_NUM_MAX	0x034
+#define VIRTIO_MMIO_QUEUE_NUM		0x038
+#define VIRTIO_MMIO_QUEUE_READY		0x044
+#define VIRTIO_MMIO_QUEUE_NOTIFY	0x050
+#define VIRTIO_MMIO_INTERRUPT_STATUS	0x060
+#define VIRTIO_MMIO_INTERRUPT_ACK	0x064
+#define VIRTIO_MMIO_STATUS		0x070
+#define VIRTIO_MMIO_QUEUE_DESC_LOW	0x080
+#define VIRTIO_MMIO_QUEUE_DESC_HIGH	0x084
+#define VIRTIO_MMIO_QUEUE_DRIVER_LOW	0x090
+#define VIRTIO_MMIO_QUEUE_DRIVER_HIGH	0x094
+#define VIRTIO_MMIO_QUEUE_DEVICE_LOW	0x0a0
+#define VIRTIO_MMIO_QUEUE_DEVICE_HIGH	0x0a4
+#define VIRTIO_MMIO_CONFIG		0x100
+
+#define VIRTIO_MMIO_MAGIC		0x74726976	/* "virt" */
+
+#define VIRTIO_STATUS_ACKNOWLEDGE	0x01
+#define VIRTIO_STATUS_DRIVER		0x02
+#define VIRTIO_STATUS_DRIVER_OK		0x04
+#define VIRTIO_STATUS_FEATURES_OK	0x08
+#define VIRTIO_STATUS_FAILED		0x80
+
+/*********\
+* Helpers *
+\*********/
+
+static inline uint32_t
+virtio_read(const struct virtio_dev *dev, uint32_t reg)
+{
+	return read32((uint32_t*)(dev->base + reg));
+}
+
+static inline void
+virtio_write(const struct virtio_dev *dev, uint32_t reg, uint32_t val)
+{
+	write32((uint32_t*)(dev->base + reg), val);
+}
+
+static inline void
+virtio_set_status(const struct virtio_dev *dev, uint32_t bits)
+{
+	virtio_write(dev, VIRTIO_MMIO_STATUS, virtio_read(dev, VIRTIO_MMIO_STATUS) | bits);
+}
+
+/* With VIRTIO_F_RING_EVENT_IDX, used_event sits at the end of the
+ * avail ring, and avail_event at the end of the used ring */
+static inline uint16_t*
+virtq_used_event(const struct virtq *vq)
+{
+	return &vq->avail->ring[vq->num];
+}
+
+static inline uint16_t*
+virtq_avail_event(const struct virtq *vq)
+{
+	return (uint16_t*) &vq->used->ring[vq->num];
+}
+
+/***********************\
+* Device initialization *
+\***********************/
+
+/* Reset the device at base, make sure it's the one we expect, and negotiate
+ * features (VIRTIO_F_VERSION_1 is always requested). After this drivers
+ * should set up their queues and call virtio_dev_ready(). */
+int
+virtio_dev_init(struct virtio_dev *dev, uintptr_t base, uint32_t device_id, uint64_t features)
+{
+	dev->base = base;
+	dev->features = 0;
+
+	if (virtio_read(dev, VIRTIO_MMIO_MAGIC_VALUE) != VIRTIO_MMIO_MAGIC)
+		return -ENODEV;
+
+	/* Legacy devices use a different queue layout */
+	if (virtio_read(dev, VIRTIO_MMIO_VERSION) != 2) {
+		DBG("virtio@0x%lx: legacy device, not supported\n", base);
+		return -ENOTSUP;
+	}
+
+	/* An ID of 0 means an empty slot */
+	if (virtio_read(dev, VIRTIO_MMIO_DEVICE_ID) != device_id)
+		return -ENODEV;
+
+	/* Reset and wait for it to complete */
+	virtio_write(dev, VIRTIO_MMIO_STATUS, 0);
+	while (virtio_read(dev, VIRTIO_MMIO_STATUS) != 0)
+		pause();
+
+	virtio_set_status(dev, VIRTIO_STATUS_ACKNOWLEDGE);
+	virtio_set_status(dev, VIRTIO_STATUS_DRIVER);
+
+	uint64_t dev_features = 0;
+	virtio_write(dev, VIRTIO_MMIO_DEVICE_FEATURES_SEL, 1);
+	dev_features = virtio_read(dev, VIRTIO_MMIO_DEVICE_FEATURES);
+	dev_features <<= 32;
+	virtio_write(dev, VIRTIO_MMIO_DEVICE_FEATURES_SEL, 0);
+	dev_features |= virtio_read(dev, VIRTIO_MMIO_DEVICE_FEATURES);
+
+	features |= (1ULL << VIRTIO_F_VERSION_1);
+	features &= dev_features;
+	if (!(features & (1ULL << VIRTIO_F_VERSION_1))) {
+		virtio_dev_fail(dev);
+		return -ENOTSUP;
+	}
+
+	virtio_write(dev, VIRTIO_MMIO_DRIVER_FEATURES_SEL, 1);
+	virtio_write(dev, VIRTIO_MMIO_DRIVER_FEATURES, (uint32_t)(features >> 32));
+	virtio_write(dev, VIRTIO_MMIO_DRIVER_FEATURES_SEL, 0);
+	virtio_write(dev, VIRTIO_MMIO_DRIVER_FEATURES, (uint32_t) features);
+
+	/* The device may still refuse them */
+	virtio_set_status(dev, VIRTIO_STATUS_FEATURES_OK);
+	if (!(virtio_read(dev, VIRTIO_MMIO_STATUS) & VIRTIO_STATUS_FEATURES_OK)) {
+		virtio_dev_fail(dev);
+		return -EIO;
+	}
+
+	dev->features = features;
+	DBG("virtio@0x%lx: device %u, features 0x%lx\n", base, device_id, features);
+	return 0;
+}
+
+void
+virtio_dev_ready(struct virtio_dev *dev)
+{
+	virtio_set_status(dev, VIRTIO_STATUS_DRIVER_OK);
+}
+
+void
+virtio_dev_fail(struct virtio_dev *dev)
+{
+	virtio_set_status(dev, VIRTIO_STATUS_FAILED);
+}
+
+/* Acknowledge the device's interrupt, returns its status
+ * (bit 0 for used buffers, bit 1 for configuration changes) */
+uint32_t
+virtio_dev_ack_irq(struct virtio_dev *dev)
+{
+	uint32_t status = virtio_read(dev, VIRTIO_MMIO_INTERRUPT_STATUS);
+	if (status)
+		virtio_write(dev, VIRTIO_MMIO_INTERRUPT_ACK, status);
+	return status;
+}
+
+uint8_t
+virtio_config_read8(struct virtio_dev *dev, uint32_t offset)
+{
+	return read8((uint8_t*)(dev->base + VIRTIO_MMIO_CONFIG + offset));
+}
+
+uint16_t
+virtio_config_read16(struct virtio_dev *dev, uint32_t offset)
+{
+	return read16((uint16_t*)(dev->base + VIRTIO_MMIO_CONFIG + offset));
+}
+
+uint32_t
+virtio_config_read32(struct virtio_dev *dev, uint32_t offset)
+{
+	return read32((uint32_t*)(dev->base + VIRTIO_MMIO_CONFIG + offset));
+}
+
+/******************\
+* Queue operations *
+\******************/
+
+/* Set up queue idx with num entries (a power of two, it gets clamped
+ * to what the device supports) on mem, that should be VIRTQ_MEM_SIZE(num)
+ * bytes, 16byte aligned. */
+int
+virtq_init(struct virtio_dev *dev, struct virtq *vq, uint16_t idx, uint16_t num, void *mem)
+{
+	if (!num || (num & (num - 1)) || ((uintptr_t) mem & 15))
+		return -EINVAL;
+
+	virtio_write(dev, VIRTIO_MMIO_QUEUE_SEL, idx);
+	if (virtio_read(dev, VIRTIO_MMIO_QUEUE_READY))
+		return -EBUSY;
+
+	uint32_t num_max = virtio_read(dev, VIRTIO_MMIO_QUEUE_NUM_MAX);
+	if (!num_max)
+		return -ENODEV;
+	while (num > num_max)
+		num >>= 1;
+
+	uint8_t *ptr = (uint8_t*) mem;
+	memset(mem, 0, VIRTQ_MEM_SIZE(num));
+	vq->desc = (struct virtq_desc*) ptr;
+	ptr += 16 * (size_t) num;
+	vq->avail = (struct virtq_avail*) ptr;
+	ptr += __VIRTQ_ALIGN8(6 + 2 * (size_t) num);
+	vq->used = (struct virtq_used*) ptr;
+	ptr += __VIRTQ_ALIGN8(6 + 8 * (size_t) num);
+	vq->cookies = (void**) ptr;
+
+	for (uint16_t i = 0; i < num - 1; i++)
+		vq->desc[i].next = i + 1;
+
+	vq->num = num;
+	vq->idx = idx;
+	vq->free_head = 0;
+	vq->num_free = num;
+	vq->avail_idx = 0;
+	vq->kicked_idx = 0;
+	vq->last_used = 0;
+	vq->event_idx = virtio_has_feature(dev, VIRTIO_F_RING_EVENT_IDX);
+	vq->irq_off = false;
+
+	virtio_write(dev, VIRTIO_MMIO_QUEUE_NUM, num);
+	virtio_write(dev, VIRTIO_MMIO_QUEUE_DESC_LOW, (uint32_t)(uintptr_t) vq->desc);
+	virtio_write(dev, VIRTIO_MMIO_QUEUE_DESC_HIGH, (uint32_t)((uintptr_t) vq->desc >> 32));
+	virtio_write(dev, VIRTIO_MMIO_QUEUE_DRIVER_LOW, (uint32_t)(uintptr_t) vq->avail);
+	virtio_write(dev, VIRTIO_MMIO_QUEUE_DRIVER_HIGH, (uint32_t)((uintptr_t) vq->avail >> 32));
+	virtio_write(dev, VIRTIO_MMIO_QUEUE_DEVICE_LOW, (uint32_t)(uintptr_t) vq->used);
+	virtio_write(dev, VIRTIO_MMIO_QUEUE_DEVICE_HIGH, (uint32_t)((uintptr_t) vq->used >> 32));
+	virtio_write(dev, VIRTIO_MMIO_QUEUE_READY, 1);
+	return 0;
+}
+
+/* Add a chain of num_out device-readable buffers followed by num_in
+ * device-writable ones, the device sees it on the next virtq_kick().
+ * Returns -ENOSPC if there aren't enough free descriptors. */
+int
+virtq_add(struct virtq *vq, const struct virtq_buf *bufs, unsigned int num_out,
+	  unsigned int num_in, void *cookie)
+{
+	const unsigned int total = num_out + num_in;
+	if (!total)
+		return -EINVAL;
+	if (total > vq->num_free)
+		return -ENOSPC;
+
+	const uint16_t head = vq->free_head;
+	uint16_t i = head;
+	for (unsigned int n = 0; n < total; n++) {
+		struct virtq_desc *desc = &vq->desc[i];
+		desc->addr = (uintptr_t) bufs[n].addr;
+		desc->len = bufs[n].len;
+		desc->flags = ((n >= num_out) ? VIRTQ_DESC_F_WRITE : 0) |
+			      ((n + 1 < total) ? VIRTQ_DESC_F_NEXT : 0);
+		i = desc->next;
+	}
+	vq->free_head = i;
+	vq->num_free -= total;
+	vq->cookies[head] = cookie;
+
+	vq->avail->ring[vq->avail_idx & (vq->num - 1)] = head;
+	/* The device may look at it as soon as it sees the new index */
+	atomic_thread_fence(memory_order_release);
+	vq->avail_idx++;
+	__atomic_store_n(&vq->avail->idx, vq->avail_idx, __ATOMIC_RELAXED);
+	return 0;
+}
+
+/* Notify the device about anything added since the last notification,
+ * unless it told us that it doesn't need one (it's already processing
+ * the queue), so a batch of buffers only costs a single notification.
+ * Returns true if the device was notified. */
+bool
+virtq_kick(struct virtio_dev *dev, struct virtq *vq)
+{
+	const uint16_t old_idx = vq->kicked_idx;
+	const uint16_t new_idx = vq->avail_idx;
+	bool notify = false;
+
+	if (old_idx == new_idx)
+		return false;
+	vq->kicked_idx = new_idx;
+
+	/* Make sure the device sees the new avail->idx before
+	 * we look at its flags / avail_event */
+	atomic_thread_fence(memory_order_seq_cst);
+
+	if (vq->event_idx) {
+		const uint16_t event = __atomic_load_n(virtq_avail_event(vq), __ATOMIC_RELAXED);
+		notify = (uint16_t)(new_idx - event - 1) < (uint16_t)(new_idx - old_idx);
+	} else
+		notify = !(__atomic_load_n(&vq->used->flags, __ATOMIC_RELAXED) & VIRTQ_USED_F_NO_NOTIFY);
+
+	if (notify)
+		virtio_write(dev, VIRTIO_MMIO_QUEUE_NOTIFY, vq->idx);
+	return notify;
+}
+
+bool
+virtq_has_used(const struct virtq *vq)
+{
+	return __atomic_load_n(&vq->used->idx, __ATOMIC_ACQUIRE) != vq->last_used;
+}
+
+/* Get the next chain the device is done with, returns its cookie
+ * (and the number of bytes the device wrote in len), or NULL
+ * if there is nothing new. */
+void*
+virtq_get(struct virtq *vq, uint32_t *len)
+{
+	if (!virtq_has_used(vq))
+		return NULL;
+
+	const struct virtq_used_elem *elem = &vq->used->ring[vq->last_used & (vq->num - 1)];
+	const uint16_t head = (uint16_t) elem->id;
+	if (len)
+		*len = elem->len;
+	vq->last_used++;
+
+	/* Ask for an interrupt when the next one is used */
+	if (vq->event_idx && !vq->irq_off)
+		__atomic_store_n(virtq_used_event(vq), vq->last_used, __ATOMIC_RELAXED);
+
+	/* Put the chain back to the free list */
+	uint16_t i = head;
+	uint16_t count = 1;
+	while (vq->desc[i].flags & VIRTQ_DESC_F_NEXT) {
+		i = vq->desc[i].next;
+		count++;
+	}
+	vq->desc[i].next = vq->free_head;
+	vq->free_head = head;
+	vq->num_free += count;
+
+	return vq->cookies[head];
+}
+
+/* Interrupt suppression, it's only a hint so the device
+ * may still send an interrupt after this. With event idx the
+ * device ignores the flag and only looks at used_event, so
+ * point it just behind what we've already seen, the device
+ * won't reach it again until its index wraps around (and
+ * virtq_get() leaves it alone while interrupts are off). */
+void
+virtq_disable_irq(struct virtq *vq)
+{
+	vq->irq_off = true;
+	vq->avail->flags |= VIRTQ_AVAIL_F_NO_INTERRUPT;
+	if (vq->event_idx)
+		__atomic_store_n(virtq_used_event(vq), (uint16_t)(vq->last_used - 1),
+				 __ATOMIC_RELAXED);
+}
+
+/* Returns false if there are used buffers already, that
+ * came in while interrupts were off, so that the caller
+ * processes them instead of waiting for an interrupt. */
+bool
+virtq_enable_irq(struct virtq *vq)
+{
+	vq->irq_off = false;
+	vq->avail->flags &= ~VIRTQ_AVAIL_F_NO_INTERRUPT;
+	if (vq->event_idx)
+		__atomic_store_n(virtq_used_event(vq), vq->last_used, __ATOMIC_RELAXED);
+	atomic_thread_fence(memory_order_seq_cst);
+	return !virtq_has_used(vq);
+}
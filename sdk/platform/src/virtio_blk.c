@@ -0,0 +1,386 @@
+/*
+ * SPDX-FileType: SOURCE
+ *
+ * SPDX-FileCopyrightText: 2026 Nick Kossifidis <mick@ics.forth.gr>
+ * SPDX-FileCopyrightText: 2026 ICS/FORTH
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <target_config.h>		/* For PLAT_VIRTIO_BLK_* / PLAT_NO_IRQ */
+#include <platform/interfaces/irq.h>	/* For REGISTER_IRQ_SOURCE */
+#include <platform/interfaces/blk.h>	/* For the blk API */
+#include <platform/interfaces/virtio.h>	/* For virtio-mmio / virtqueues */
+#include <platform/utils/devq.h>	/* For the device queue */
+#include <platform/utils/utils.h>	/* For console output */
+#include <stdbool.h>			/* For bool */
+#include <stdatomic.h>			/* For atomic_thread_fence() */
+#include <malloc.h>			/* For page_alloc/free() */
+#include <errno.h>			/* For error codes */
+
+#if defined(PLAT_VIRTIO_BLK_BASE_ADDR) && (PLAT_VIRTIO_BLK_BASE_ADDR > 0)
+
+/*
+ * Each request is a chain of three descriptors: the request header, the
+ * data buffer and the status byte, where the header and status byte live
+ * in the caller's struct blk_req, so requests go to the device as they
+ * are. The device may complete them out of order, each one carries its
+ * own completion callback. Notifications are suppressed through event
+ * idx while the device is busy with the queue, so queueing a batch of
+ * requests back to back only costs a single trap. Locking, completions
+ * and switching between polling / interrupts go through a device queue
+ * (see devq.h).
+ *
+ * To use it run with VIRTIO_BLK=<image> (see run.sh) so that QEMU adds
+ * the device on PLAT_VIRTIO_BLK_BASE_ADDR.
+ */
+
+#define VBLK_F_SIZE_MAX		1
+#define VBLK_F_RO		5
+#define VBLK_F_BLK_SIZE		6
+#define VBLK_F_FLUSH		9
+
+#define VBLK_CFG_CAPACITY	0
+#define VBLK_CFG_SIZE_MAX	8
+#define VBLK_CFG_BLK_SIZE	20
+
+#define VBLK_S_OK		0
+#define VBLK_S_IOERR		1
+#define VBLK_S_UNSUPP		2
+
+#define VBLK_QUEUE_SIZE		64
+#define VBLK_DESCS_PER_REQ	3
+#define VBLK_QUEUE_PAGES	((VIRTQ_MEM_SIZE(VBLK_QUEUE_SIZE) + PAGE_FRAME_SIZE - 1) / PAGE_FRAME_SIZE)
+/* A descriptor's length is 32bits, keep it sector aligned */
+#define VBLK_MAX_XFER		(UINT32_MAX & ~(BLK_SECTOR_SIZE - 1))
+
+static struct {
+	struct virtio_dev dev;
+	struct virtq vq;
+	void *vq_mem;
+	struct blk_info info;
+	struct devq q;
+	bool ready;
+} vblk;
+
+/******************\
+* Device queue ops *
+\******************/
+
+static int
+vblk_q_submit(struct devq *q, void *r)
+{
+	struct blk_req *req = r;
+	struct virtq_buf bufs[VBLK_DESCS_PER_REQ] = { 0 };
+	unsigned int num_out = 1;
+	unsigned int num_in = 1;
+
+	bufs[0].addr = &req->hdr;
+	bufs[0].len = sizeof(req->hdr);
+	if (req->op != BLK_OP_FLUSH) {
+		bufs[1].addr = req->buf;
+		bufs[1].len = req->len;
+		if (req->op == BLK_OP_READ)
+			num_in++;
+		else
+			num_out++;
+	}
+	bufs[num_out + num_in - 1].addr = &req->dev_status;
+	bufs[num_out + num_in - 1].len = 1;
+
+	int ret = virtq_add(&vblk.vq, bufs, num_out, num_in, req);
+	return (ret == -ENOSPC) ? -EAGAIN : ret;
+}
+
+static void
+vblk_q_kick(struct devq *q)
+{
+	virtq_kick(&vblk.dev, &vblk.vq);
+}
+
+static int
+vblk_q_reap(struct devq *q, void **reqs, int max)
+{
+	int num = 0;
+	while (num < max && (reqs[num] = virtq_get(&vblk.vq, NULL)) != NULL)
+		num++;
+	return num;
+}
+
+static void
+vblk_q_complete(struct devq *q, void *r)
+{
+	struct blk_req *req = r;
+	int status = 0;
+	switch (req->dev_status) {
+	case VBLK_S_OK:
+		break;
+	case VBLK_S_UNSUPP:
+		status = -ENOTSUP;
+		break;
+	default:
+		status = -EIO;
+	}
+
+	/* Make sure the caller sees the data before the status */
+	atomic_thread_fence(memory_order_acquire);
+	req->status = status;
+	if (req->done)
+		req->done(req);
+}
+
+#ifndef PLAT_NO_IRQ
+static bool
+vblk_q_irq_ctl(struct devq *q, bool on)
+{
+	if (on)
+		return virtq_enable_irq(&vblk.vq);
+	virtq_disable_irq(&vblk.vq);
+	return true;
+}
+
+static void
+vblk_q_ack_irq(struct devq *q)
+{
+	virtio_dev_ack_irq(&vblk.dev);
+}
+#endif
+
+static const struct devq_ops vblk_q_ops = {
+	.submit = vblk_q_submit,
+	.kick = vblk_q_kick,
+	.reap = vblk_q_reap,
+	.complete = vblk_q_complete,
+#ifndef PLAT_NO_IRQ
+	.irq_ctl = vblk_q_irq_ctl,
+	.ack_irq = vblk_q_ack_irq,
+#endif
+};
+
+/**************\
+* Entry points *
+\**************/
+
+int
+blk_init(void)
+{
+	int ret = 0;
+
+	if (vblk.ready)
+		return 0;
+
+	ret = virtio_dev_init(&vblk.dev, PLAT_VIRTIO_BLK_BASE_ADDR, VIRTIO_ID_BLOCK,
+			      (1ULL << VBLK_F_SIZE_MAX) | (1ULL << VBLK_F_RO) |
+			      (1ULL << VBLK_F_BLK_SIZE) | (1ULL << VBLK_F_FLUSH) |
+			      (1ULL << VIRTIO_F_RING_EVENT_IDX));
+	if (ret < 0)
+		return ret;
+
+	vblk.vq_mem = page_alloc(VBLK_QUEUE_PAGES, 0);
+	if (!vblk.vq_mem) {
+		ret = -ENOMEM;
+		goto fail;
+	}
+	ret = virtq_init(&vblk.dev, &vblk.vq, 0, VBLK_QUEUE_SIZE, vblk.vq_mem);
+	if (ret < 0)
+		goto fail;
+
+	/* The capacity is a 64bit field, but config space
+	 * accesses are 32bits wide */
+	uint32_t cap_hi = 0;
+	uint32_t cap_lo = 0;
+	do {
+		cap_hi = virtio_config_read32(&vblk.dev, VBLK_CFG_CAPACITY + 4);
+		cap_lo = virtio_config_read32(&vblk.dev, VBLK_CFG_CAPACITY);
+	} while (cap_hi != virtio_config_read32(&vblk.dev, VBLK_CFG_CAPACITY + 4));
+	vblk.info.num_sectors = ((uint64_t) cap_hi << 32) | cap_lo;
+
+	vblk.info.block_size = BLK_SECTOR_SIZE;
+	if (virtio_has_feature(&vblk.dev, VBLK_F_BLK_SIZE))
+		vblk.info.block_size = virtio_config_read32(&vblk.dev, VBLK_CFG_BLK_SIZE);
+
+	vblk.info.max_xfer = VBLK_MAX_XFER;
+	if (virtio_has_feature(&vblk.dev, VBLK_F_SIZE_MAX)) {
+		uint32_t size_max = virtio_config_read32(&vblk.dev, VBLK_CFG_SIZE_MAX);
+		if (size_max >= BLK_SECTOR_SIZE)
+			vblk.info.max_xfer = size_max & ~(BLK_SECTOR_SIZE - 1);
+	}
+
+	vblk.info.max_inflight = VBLK_QUEUE_SIZE / VBLK_DESCS_PER_REQ;
+	vblk.info.read_only = virtio_has_feature(&vblk.dev, VBLK_F_RO);
+
+	/* Interrupts stay off until blk_set_mode() */
+	virtq_disable_irq(&vblk.vq);
+	devq_init(&vblk.q, &vblk_q_ops, NULL);
+	virtio_dev_ready(&vblk.dev);
+	vblk.ready = true;
+
+	INF("virtio-blk: %lu sectors%s\n", vblk.info.num_sectors,
+	    vblk.info.read_only ? " (read-only)" : "");
+	return 0;
+
+ fail:
+	virtio_dev_fail(&vblk.dev);
+	if (vblk.vq_mem)
+		page_free(vblk.vq_mem, VBLK_QUEUE_PAGES);
+	vblk.vq_mem = NULL;
+	return ret;
+}
+
+int
+blk_get_info(struct blk_info *info)
+{
+	if (!vblk.ready)
+		return -ENODEV;
+	*info = vblk.info;
+	return 0;
+}
+
+/* Queue a request and notify the device (if needed), returns -EAGAIN if
+ * there are already max_inflight requests queued. On success the request
+ * belongs to the driver until its status changes from -EBUSY. */
+int
+blk_submit(struct blk_req *req)
+{
+	if (!vblk.ready)
+		return -ENODEV;
+	if (!req)
+		return -EINVAL;
+
+	switch (req->op) {
+	case BLK_OP_WRITE:
+		if (vblk.info.read_only)
+			return -ENOTSUP;
+		/* Fallthrough */
+	case BLK_OP_READ:
+		if (!req->buf || !req->len || req->len % BLK_SECTOR_SIZE ||
+		    req->len > vblk.info.max_xfer)
+			return -EINVAL;
+		if (req->sector >= vblk.info.num_sectors ||
+		    req->len / BLK_SECTOR_SIZE > vblk.info.num_sectors - req->sector)
+			return -EINVAL;
+		break;
+	case BLK_OP_FLUSH:
+		if (!virtio_has_feature(&vblk.dev, VBLK_F_FLUSH))
+			return -ENOTSUP;
+		break;
+	default:
+		return -EINVAL;
+	}
+
+	req->hdr.type = req->op;
+	req->hdr.reserved = 0;
+	req->hdr.sector = (req->op == BLK_OP_FLUSH) ? 0 : req->sector;
+	req->dev_status = 0xff;
+	req->status = -EBUSY;
+
+	int ret = dev_submit(&vblk.q, req);
+	if (ret < 0)
+		req->status = ret;
+	return ret;
+}
+
+/* Process completed requests (calling their callbacks), returns
+ * the number of requests completed */
+int
+blk_poll(void)
+{
+	if (!vblk.ready)
+		return -ENODEV;
+	return dev_poll(&vblk.q, 0);
+}
+
+int
+blk_wait(struct blk_req *req)
+{
+	if (!vblk.ready)
+		return -ENODEV;
+	return dev_wait(&vblk.q, &req->status);
+}
+
+static int
+vblk_rw_sync(enum blk_op op, uint64_t sector, void *buf, uint32_t len)
+{
+	int ret = 0;
+
+	if (!vblk.ready)
+		return -ENODEV;
+
+	while (len) {
+		struct blk_req req = { .op = op, .sector = sector, .buf = buf };
+		req.len = (len > vblk.info.max_xfer) ? vblk.info.max_xfer : len;
+
+		while ((ret = blk_submit(&req)) == -EAGAIN)
+			blk_poll();
+		if (ret < 0)
+			return ret;
+		ret = blk_wait(&req);
+		if (ret < 0)
+			return ret;
+
+		sector += req.len / BLK_SECTOR_SIZE;
+		buf = (uint8_t*) buf + req.len;
+		len -= req.len;
+	}
+	return 0;
+}
+
+int
+blk_read(uint64_t sector, void *buf, uint32_t len)
+{
+	return vblk_rw_sync(BLK_OP_READ, sector, buf, len);
+}
+
+int
+blk_write(uint64_t sector, const void *buf, uint32_t len)
+{
+	return vblk_rw_sync(BLK_OP_WRITE, sector, (void*) buf, len);
+}
+
+/* Interrupt / adaptive modes need PLAT_NO_IRQ unset, and the source
+ * enabled on the irq controller */
+int
+blk_set_mode(enum devq_mode mode)
+{
+	if (!vblk.ready)
+		return -ENODEV;
+	return dev_set_mode(&vblk.q, mode);
+}
+
+void
+blk_enable_irq(void)
+{
+	blk_set_mode(DEVQ_MODE_IRQ);
+}
+
+void
+blk_disable_irq(void)
+{
+	blk_set_mode(DEVQ_MODE_POLL);
+}
+
+int
+blk_get_stats(struct devq_stats *stats)
+{
+	if (!vblk.ready)
+		return -ENODEV;
+	dev_get_stats(&vblk.q, stats);
+	return 0;
+}
+
+#ifndef PLAT_NO_IRQ
+static void
+vblk_irq_trampoline(uint16_t source_id)
+{
+	dev_irq(&vblk.q);
+}
+
+REGISTER_IRQ_SOURCE(virtio_blk, {
+	.source.wire_id = PLAT_VIRTIO_BLK_IRQ,
+	.handler = vblk_irq_trampoline,
+	.target_hart = 0,
+	.priority = IRQ_PRIORITY_HIGH,
+	.flags = IRQ_TRIGGER_LEVEL_HIGH,
+});
+#endif /* PLAT_NO_IRQ */
+#endif /* defined(PLAT_VIRTIO_BLK_BASE_ADDR) && (PLAT_VIRTIO_BLK_BASE_ADDR > 0) */
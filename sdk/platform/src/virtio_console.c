@@ -0,0 +1,386 @@
+/*
+ * SPDX-FileType: SOURCE
+ *
+ * SPDX-FileCopyrightText: 2026 Nick Kossifidis <mick@ics.forth.gr>
+ * SPDX-FileCopyrightText: 2026 ICS/FORTH
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <target_config.h>		/* For PLAT_VIRTIO_CONSOLE_* / PLAT_NO_IRQ */
+#include <platform/interfaces/irq.h>	/* For REGISTER_IRQ_SOURCE / irq_work_queue() */
+#include <platform/interfaces/uart.h>	/* For uart interface definitions */
+#include <platform/interfaces/virtio.h>	/* For virtio-mmio / virtqueues */
+#include <platform/riscv/hart.h>	/* For hart_block/allow_interrupts() */
+#include <platform/utils/lock.h>	/* For sdk_lock_acquire/release() */
+#include <platform/utils/utils.h>	/* For DBG */
+#include <stdbool.h>			/* For bool */
+#include <malloc.h>			/* For page_alloc() */
+#include <errno.h>			/* For EAGAIN, ENODEV */
+
+#if defined(PLAT_VIRTIO_CONSOLE_BASE) && (PLAT_VIRTIO_CONSOLE_BASE > 0)
+
+/*
+ * A virtio console (virtio-serial with a single port, no multiport
+ * feature) behind the uart.h interface, for QEMU targets where each
+ * byte sent to the emulated 16550 is a trap to the host. Here output
+ * is copied to one of a few Tx buffers and the device gets notified once
+ * for the whole buffer, so a printf'd line goes out in one notification.
+ * Completed Tx buffers are reclaimed by polling (Tx interrupts stay off),
+ * and uart_enable_irq() only enables the receive interrupt. The buffers
+ * and both virtqueues share a page, allocated by uart_init().
+ *
+ * To use it set PLAT_VIRTIO_CONSOLE_BASE in target_config.h, and run
+ * with VIRTIO_CONSOLE=1 (see run.sh) so that QEMU adds the device.
+ */
+
+#define VCON_RXQ		0
+#define VCON_TXQ		1
+#define VCON_QUEUE_SIZE		16
+#define VCON_TX_BUFS		8
+#define VCON_TX_BUF_SIZE	256
+#define VCON_TX_BUFS_ALL	((1U << VCON_TX_BUFS) - 1)
+#define VCON_RX_BUFS		4
+#define VCON_RX_BUF_SIZE	64
+#define VCON_RX_BUFS_OFFT	(VCON_TX_BUFS * VCON_TX_BUF_SIZE)
+#define VCON_RXQ_OFFT		(VCON_RX_BUFS_OFFT + VCON_RX_BUFS * VCON_RX_BUF_SIZE)
+#define VCON_TXQ_OFFT		(VCON_RXQ_OFFT + VIRTQ_MEM_SIZE(VCON_QUEUE_SIZE))
+#define VCON_MEM_SIZE		(VCON_TXQ_OFFT + VIRTQ_MEM_SIZE(VCON_QUEUE_SIZE))
+#define VCON_MEM_PAGES		((VCON_MEM_SIZE + PAGE_FRAME_SIZE - 1) / PAGE_FRAME_SIZE)
+
+static struct {
+	struct virtio_dev dev;
+	struct virtq rxq;
+	struct virtq txq;
+	uint32_t tx_free;	/* Bitmap of free Tx buffers */
+	uint8_t *rx_cur;	/* Rx buffer we are reading from */
+	uint32_t rx_len;
+	uint32_t rx_offt;
+	uint32_t rx_count;	/* Characters read so far */
+	bool ready;
+	uint8_t *mem;		/* Tx / Rx buffers, then the virtqueues */
+} vcon;
+
+static sdk_lock_t vcon_lock = SDK_LOCK_INIT;
+
+/*********\
+* Helpers *
+\*********/
+
+static inline bool
+vcon_lock_acquire(void)
+{
+	const bool irqs_on = csr_read(CSR_MSTATUS) & CSR_MSTATUS_MIE;
+	hart_block_interrupts();
+	sdk_lock_acquire(&vcon_lock);
+	return irqs_on;
+}
+
+static inline void
+vcon_lock_release(bool irqs_on)
+{
+	sdk_lock_release(&vcon_lock);
+	if (irqs_on)
+		hart_allow_interrupts();
+}
+
+/* Give an Rx buffer back to the device, called with vcon_lock held */
+static void
+vcon_rx_post(uint8_t *buf)
+{
+	struct virtq_buf vbuf = { .addr = buf, .len = VCON_RX_BUF_SIZE };
+	virtq_add(&vcon.rxq, &vbuf, 0, 1, buf);
+	virtq_kick(&vcon.dev, &vcon.rxq);
+}
+
+/* Get the next received character, called with vcon_lock held */
+static int
+vcon_rx_getc(void)
+{
+	while (!vcon.rx_cur) {
+		vcon.rx_cur = virtq_get(&vcon.rxq, &vcon.rx_len);
+		vcon.rx_offt = 0;
+		if (!vcon.rx_cur)
+			return -EAGAIN;
+		if (!vcon.rx_len) {
+			vcon_rx_post(vcon.rx_cur);
+			vcon.rx_cur = NULL;
+		}
+	}
+
+	int c = vcon.rx_cur[vcon.rx_offt++];
+	vcon.rx_count++;
+	if (vcon.rx_offt >= vcon.rx_len) {
+		vcon_rx_post(vcon.rx_cur);
+		vcon.rx_cur = NULL;
+	}
+	return c;
+}
+
+static void
+vcon_tx_reclaim(void)
+{
+	uint8_t *buf = NULL;
+	while ((buf = virtq_get(&vcon.txq, NULL)) != NULL)
+		vcon.tx_free |= 1U << ((buf - vcon.mem) / VCON_TX_BUF_SIZE);
+}
+
+/* Copy as much of data as fits in a free Tx buffer and queue it (without
+ * notifying the device), returns the number of bytes consumed, or 0 if
+ * there was no free buffer. Called with vcon_lock held. */
+static size_t
+vcon_tx_queue(const uint8_t *data, size_t len)
+{
+	vcon_tx_reclaim();
+	if (!vcon.tx_free)
+		return 0;
+
+	const int slot = __builtin_ctz(vcon.tx_free);
+	uint8_t *buf = vcon.mem + slot * VCON_TX_BUF_SIZE;
+	uint32_t used = 0;
+	size_t i = 0;
+	for (; i < len && used < VCON_TX_BUF_SIZE; i++) {
+		/* Same as the 16550 driver, new lines also
+		 * get a carriage return */
+		if (data[i] == '\n') {
+			if (used + 2 > VCON_TX_BUF_SIZE)
+				break;
+			buf[used++] = '\n';
+			buf[used++] = '\r';
+		} else
+			buf[used++] = data[i];
+	}
+
+	struct virtq_buf vbuf = { .addr = buf, .len = used };
+	if (virtq_add(&vcon.txq, &vbuf, 1, 0, buf) < 0)
+		return 0;
+	vcon.tx_free &= ~(1U << slot);
+	return i;
+}
+
+/**************\
+* Entry points *
+\**************/
+
+void
+uart_init(void)
+{
+	int ret = virtio_dev_init(&vcon.dev, PLAT_VIRTIO_CONSOLE_BASE, VIRTIO_ID_CONSOLE, 0);
+	if (ret < 0)
+		return;
+
+	if (!vcon.mem)
+		vcon.mem = page_alloc(VCON_MEM_PAGES, 0);
+	if (!vcon.mem ||
+	    virtq_init(&vcon.dev, &vcon.rxq, VCON_RXQ, VCON_QUEUE_SIZE, vcon.mem + VCON_RXQ_OFFT) < 0 ||
+	    virtq_init(&vcon.dev, &vcon.txq, VCON_TXQ, VCON_QUEUE_SIZE, vcon.mem + VCON_TXQ_OFFT) < 0) {
+		virtio_dev_fail(&vcon.dev);
+		return;
+	}
+
+	/* We poll for Tx completions, and Rx interrupts
+	 * are off until uart_enable_irq() */
+	virtq_disable_irq(&vcon.txq);
+	virtq_disable_irq(&vcon.rxq);
+	virtio_dev_ready(&vcon.dev);
+
+	for (int i = 0; i < VCON_RX_BUFS; i++)
+		vcon_rx_post(vcon.mem + VCON_RX_BUFS_OFFT + i * VCON_RX_BUF_SIZE);
+	vcon.tx_free = VCON_TX_BUFS_ALL;
+	vcon.ready = true;
+}
+
+int
+uart_getc(void)
+{
+	if (!vcon.ready)
+		return -ENODEV;
+
+	bool irqs_on = vcon_lock_acquire();
+	int ret = vcon_rx_getc();
+	vcon_lock_release(irqs_on);
+	return ret;
+}
+
+int
+uart_read(void *buff, size_t len)
+{
+	uint8_t *data = (uint8_t*) buff;
+	size_t i = 0;
+
+	if (!vcon.ready)
+		return -ENODEV;
+
+	bool irqs_on = vcon_lock_acquire();
+	for (int c = 0; i < len && (c = vcon_rx_getc()) >= 0; i++)
+		data[i] = (uint8_t) c;
+	vcon_lock_release(irqs_on);
+
+	if (len && !i)
+		return -EAGAIN;
+	return (int) i;
+}
+
+int
+uart_write(const void *buff, size_t len)
+{
+	const uint8_t *data = (const uint8_t*) buff;
+	size_t done = 0;
+	size_t ret = 0;
+
+	if (!vcon.ready)
+		return -ENODEV;
+
+	bool irqs_on = vcon_lock_acquire();
+	while (done < len && (ret = vcon_tx_queue(data + done, len - done)) > 0)
+		done += ret;
+	virtq_kick(&vcon.dev, &vcon.txq);
+	vcon_lock_release(irqs_on);
+
+	if (len && !done)
+		return -EAGAIN;
+	return (int) done;
+}
+
+void
+uart_flush(void)
+{
+	if (!vcon.ready)
+		return;
+
+	while (1) {
+		bool irqs_on = vcon_lock_acquire();
+		vcon_tx_reclaim();
+		bool done = (vcon.tx_free == VCON_TX_BUFS_ALL);
+		vcon_lock_release(irqs_on);
+		if (done)
+			break;
+		pause();
+	}
+}
+
+void
+uart_write_buf(const void *buff, size_t len)
+{
+	const uint8_t *data = (const uint8_t*) buff;
+	size_t done = 0;
+
+	if (!vcon.ready)
+		return;
+
+	while (done < len) {
+		bool irqs_on = vcon_lock_acquire();
+		size_t ret = vcon_tx_queue(data + done, len - done);
+		/* Out of buffers, let the device know about
+		 * what we have so far, and wait for it */
+		if (!ret)
+			virtq_kick(&vcon.dev, &vcon.txq);
+		vcon_lock_release(irqs_on);
+		if (!ret)
+			pause();
+		done += ret;
+	}
+
+	bool irqs_on = vcon_lock_acquire();
+	virtq_kick(&vcon.dev, &vcon.txq);
+	vcon_lock_release(irqs_on);
+}
+
+void
+uart_putc(uint8_t c)
+{
+	uart_write_buf(&c, 1);
+}
+
+#ifndef PLAT_NO_IRQ
+void
+uart_enable_irq(void)
+{
+	if (!vcon.ready)
+		return;
+	bool irqs_on = vcon_lock_acquire();
+	virtq_enable_irq(&vcon.rxq);
+	vcon_lock_release(irqs_on);
+}
+
+void
+uart_disable_irq(void)
+{
+	if (!vcon.ready)
+		return;
+	bool irqs_on = vcon_lock_acquire();
+	virtq_disable_irq(&vcon.rxq);
+	vcon_lock_release(irqs_on);
+}
+
+static uart_irq_handler_t uart_irq_handler = NULL;
+
+void uart_set_irq_handler(uart_irq_handler_t new_handler)
+{
+	if (new_handler != NULL) {
+		uart_irq_handler = new_handler;
+		/* Memory barrier to ensure the write is visible */
+		__asm__ volatile("fence rw,rw" ::: "memory");
+	}
+}
+
+static inline bool
+vcon_rx_pending(void)
+{
+	return vcon.rx_cur || virtq_has_used(&vcon.rxq);
+}
+
+/* Runs as deferred work (see irq.h), with interrupts enabled */
+static void
+vcon_irq_work_fn(struct irq_work *work)
+{
+	const uint16_t source_id = (uint16_t)(uintptr_t) work->arg;
+
+	if (!vcon_rx_pending())
+		return;
+	if (uart_irq_handler == NULL) {
+		DBG("UART interrupt received but no handler installed\n");
+		return;
+	}
+
+	/* Same as the 16550 driver, let the user know there is new
+	 * data, uart_getc() will return it from the Rx buffers. We
+	 * got a single interrupt for a whole buffer though, unlike
+	 * the 16550 that keeps it asserted while there's data, so
+	 * keep calling the handler as long as it reads something. */
+	uint32_t rx_count = 0;
+	do {
+		rx_count = vcon.rx_count;
+		uart_irq_handler(source_id);
+	} while (vcon_rx_pending() && vcon.rx_count != rx_count);
+}
+
+static struct irq_work vcon_irq_work = IRQ_WORK_INIT(vcon_irq_work_fn,
+						     (void *)(uintptr_t) PLAT_VIRTIO_CONSOLE_IRQ);
+
+static void
+vcon_irq_trampoline(uint16_t source_id)
+{
+	sdk_lock_acquire(&vcon_lock);
+	virtio_dev_ack_irq(&vcon.dev);
+	sdk_lock_release(&vcon_lock);
+
+	if (vcon_rx_pending())
+		irq_work_queue(&vcon_irq_work);
+}
+
+REGISTER_IRQ_SOURCE(virtio_console, {
+	.source.wire_id = PLAT_VIRTIO_CONSOLE_IRQ,
+	.handler = vcon_irq_trampoline,
+	.target_hart = 0,
+	.priority = IRQ_PRIORITY_HIGH,
+	.flags = IRQ_TRIGGER_LEVEL_HIGH,
+});
+#else
+
+void uart_enable_irq(void) { return; }
+void uart_disable_irq(void) { return; }
+void uart_set_irq_handler(uart_irq_handler_t new_handler) { return; }
+
+#endif /* PLAT_NO_IRQ */
+#endif /* defined(PLAT_VIRTIO_CONSOLE_BASE) && (PLAT_VIRTIO_CONSOLE_BASE > 0) */
@@ -0,0 +1,406 @@
+/*
+ * SPDX-FileType: SOURCE
+ *
+ * SPDX-FileCopyrightText: 2026 Nick Kossifidis <mick@ics.forth.gr>
+ * SPDX-FileCopyrightText: 2026 ICS/FORTH
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <target_config.h>		/* For PLAT_VIRTIO_NET_* / PLAT_NO_IRQ */
+#include <platform/interfaces/irq.h>	/* For REGISTER_IRQ_SOURCE */
+#include <platform/interfaces/net.h>	/* For the net API */
+#include <platform/interfaces/rng.h>	/* For rng_get_seed() */
+#include <platform/interfaces/virtio.h>	/* For virtio-mmio / virtqueues */
+#include <platform/riscv/hart.h>	/* For hart_block/allow_interrupts() */
+#include <platform/utils/lock.h>	/* For sdk_lock_acquire/release() */
+#include <platform/utils/pool.h>	/* For the buffer pool */
+#include <platform/utils/utils.h>	/* For console output */
+#include <stdbool.h>			/* For bool */
+#include <string.h>			/* For memset() */
+#include <malloc.h>			/* For page_alloc/free() */
+#include <errno.h>			/* For error codes */
+
+#if defined(PLAT_VIRTIO_NET_BASE_ADDR) && (PLAT_VIRTIO_NET_BASE_ADDR > 0)
+
+/*
+ * Each buffer holds the virtio-net header followed by the frame, so that
+ * both go to the device with a single descriptor, and the application
+ * only sees the frame. The header starts at VNET_HDR_OFFT so that the
+ * frame's payload (e.g. an IP header) ends up 4byte aligned. Receive
+ * buffers cycle between the device and the application without going
+ * back to the pool, transmit buffers come from the pool and go back to
+ * it when the device is done with them (we check for that on the next
+ * net_tx_* call, Tx interrupts stay off). We don't negotiate mergeable
+ * Rx buffers or any offloads, so each frame fits in a single buffer.
+ */
+
+#define VNET_F_MAC		5
+
+#define VNET_RXQ		0
+#define VNET_TXQ		1
+#define VNET_QUEUE_SIZE		64
+#define VNET_RX_BUFS		32
+#define VNET_TX_BUFS		32
+/* Notify the device at least this often while submitting */
+#define VNET_TX_BATCH		16
+
+#define VNET_HDR_OFFT		2
+#define VNET_HDR_LEN		12
+#define VNET_FRAME_OFFT		(VNET_HDR_OFFT + VNET_HDR_LEN)
+#define VNET_BUF_SIZE		(VNET_FRAME_OFFT + NET_FRAME_MAX)
+#define VNET_QUEUE_PAGES	((VIRTQ_MEM_SIZE(VNET_QUEUE_SIZE) + PAGE_FRAME_SIZE - 1) / PAGE_FRAME_SIZE)
+
+struct virtio_net_hdr {
+	uint8_t flags;
+	uint8_t gso_type;
+	uint16_t hdr_len;
+	uint16_t gso_size;
+	uint16_t csum_start;
+	uint16_t csum_offset;
+	uint16_t num_buffers;
+};
+
+static struct {
+	struct virtio_dev dev;
+	struct virtq rxq;
+	struct virtq txq;
+	struct pool *bufs;
+	void *rxq_mem;
+	void *txq_mem;
+	unsigned int tx_unkicked;	/* Submitted since the last notification */
+	struct net_stats stats;
+	net_rx_handler_t rx_handler;
+	uint8_t mac[NET_MAC_LEN];
+	bool irq_on;
+	bool ready;
+} vnet;
+
+static sdk_lock_t vnet_rx_lock = SDK_LOCK_INIT;
+static sdk_lock_t vnet_tx_lock = SDK_LOCK_INIT;
+
+/*********\
+* Helpers *
+\*********/
+
+static inline bool
+vnet_lock_acquire(sdk_lock_t *lock)
+{
+	const bool irqs_on = csr_read(CSR_MSTATUS) & CSR_MSTATUS_MIE;
+	hart_block_interrupts();
+	sdk_lock_acquire(lock);
+	return irqs_on;
+}
+
+static inline void
+vnet_lock_release(sdk_lock_t *lock, bool irqs_on)
+{
+	sdk_lock_release(lock);
+	if (irqs_on)
+		hart_allow_interrupts();
+}
+
+/* Called with vnet_rx_lock held */
+static int
+vnet_rx_post(uint8_t *buf)
+{
+	struct virtq_buf vbuf = {
+		.addr = buf + VNET_HDR_OFFT,
+		.len = VNET_BUF_SIZE - VNET_HDR_OFFT
+	};
+	int ret = virtq_add(&vnet.rxq, &vbuf, 0, 1, buf);
+	if (ret < 0)
+		return ret;
+	/* Mostly a no-op, the device only asks for a
+	 * notification when it runs out of buffers */
+	virtq_kick(&vnet.dev, &vnet.rxq);
+	return 0;
+}
+
+/* Give completed Tx buffers back to the pool, called with vnet_tx_lock held */
+static void
+vnet_tx_reclaim(void)
+{
+	void *buf = NULL;
+	while ((buf = virtq_get(&vnet.txq, NULL)) != NULL)
+		pool_free(vnet.bufs, buf);
+}
+
+/* Called with vnet_tx_lock held */
+static void
+vnet_tx_kick(void)
+{
+	if (virtq_kick(&vnet.dev, &vnet.txq))
+		vnet.stats.tx_kicks++;
+	vnet.tx_unkicked = 0;
+}
+
+static void
+vnet_cleanup(void)
+{
+	if (vnet.bufs)
+		pool_destroy(vnet.bufs);
+	if (vnet.rxq_mem)
+		page_free(vnet.rxq_mem, VNET_QUEUE_PAGES);
+	if (vnet.txq_mem)
+		page_free(vnet.txq_mem, VNET_QUEUE_PAGES);
+	vnet.bufs = NULL;
+	vnet.rxq_mem = NULL;
+	vnet.txq_mem = NULL;
+}
+
+/**************\
+* Entry points *
+\**************/
+
+int
+net_init(void)
+{
+	int ret = 0;
+
+	if (vnet.ready)
+		return 0;
+
+	ret = virtio_dev_init(&vnet.dev, PLAT_VIRTIO_NET_BASE_ADDR, VIRTIO_ID_NET,
+			      (1ULL << VNET_F_MAC) | (1ULL << VIRTIO_F_RING_EVENT_IDX));
+	if (ret < 0)
+		return ret;
+
+	vnet.rxq_mem = page_alloc(VNET_QUEUE_PAGES, 0);
+	vnet.txq_mem = page_alloc(VNET_QUEUE_PAGES, 0);
+	vnet.bufs = pool_create(VNET_BUF_SIZE, VNET_RX_BUFS + VNET_TX_BUFS);
+	if (!vnet.rxq_mem || !vnet.txq_mem || !vnet.bufs) {
+		ret = -ENOMEM;
+		goto fail;
+	}
+
+	ret = virtq_init(&vnet.dev, &vnet.rxq, VNET_RXQ, VNET_QUEUE_SIZE, vnet.rxq_mem);
+	if (ret < 0)
+		goto fail;
+	ret = virtq_init(&vnet.dev, &vnet.txq, VNET_TXQ, VNET_QUEUE_SIZE, vnet.txq_mem);
+	if (ret < 0)
+		goto fail;
+
+	if (virtio_has_feature(&vnet.dev, VNET_F_MAC)) {
+		for (int i = 0; i < NET_MAC_LEN; i++)
+			vnet.mac[i] = virtio_config_read8(&vnet.dev, i);
+	} else {
+		/* Make up a locally administered, unicast one */
+		uint32_t seed = rng_get_seed();
+		vnet.mac[0] = 0x02;
+		vnet.mac[1] = 0x00;
+		memcpy(&vnet.mac[2], &seed, 4);
+	}
+
+	virtq_disable_irq(&vnet.txq);
+	virtq_disable_irq(&vnet.rxq);
+	virtio_dev_ready(&vnet.dev);
+
+	for (int i = 0; i < VNET_RX_BUFS; i++) {
+		uint8_t *buf = pool_alloc(vnet.bufs);
+		if (!buf || vnet_rx_post(buf) < 0) {
+			pool_free(vnet.bufs, buf);
+			break;
+		}
+	}
+
+	vnet.ready = true;
+	INF("virtio-net: %02x:%02x:%02x:%02x:%02x:%02x\n",
+	    vnet.mac[0], vnet.mac[1], vnet.mac[2], vnet.mac[3], vnet.mac[4], vnet.mac[5]);
+	return 0;
+
+ fail:
+	virtio_dev_fail(&vnet.dev);
+	vnet_cleanup();
+	return ret;
+}
+
+int
+net_get_mac(uint8_t mac[NET_MAC_LEN])
+{
+	if (!vnet.ready)
+		return -ENODEV;
+	memcpy(mac, vnet.mac, NET_MAC_LEN);
+	return 0;
+}
+
+/* Returns a buffer for a frame of up to NET_FRAME_MAX bytes, or NULL
+ * if they are all in flight (try again after net_tx_flush()) */
+void*
+net_tx_alloc(void)
+{
+	if (!vnet.ready)
+		return NULL;
+
+	bool irqs_on = vnet_lock_acquire(&vnet_tx_lock);
+	vnet_tx_reclaim();
+	vnet_lock_release(&vnet_tx_lock, irqs_on);
+
+	uint8_t *buf = pool_alloc(vnet.bufs);
+	if (!buf)
+		return NULL;
+	return buf + VNET_FRAME_OFFT;
+}
+
+/* Hand a frame from net_tx_alloc() to the device, it goes out after the
+ * next notification (every VNET_TX_BATCH frames, or net_tx_flush()).
+ * On error the frame still belongs to the caller. */
+int
+net_tx_submit(void *frame, size_t len)
+{
+	if (!vnet.ready)
+		return -ENODEV;
+	if (!frame || len > NET_FRAME_MAX)
+		return -EINVAL;
+
+	uint8_t *buf = (uint8_t*) frame - VNET_FRAME_OFFT;
+	memset(buf + VNET_HDR_OFFT, 0, sizeof(struct virtio_net_hdr));
+	struct virtq_buf vbuf = {
+		.addr = buf + VNET_HDR_OFFT,
+		.len = (uint32_t)(VNET_HDR_LEN + len)
+	};
+
+	bool irqs_on = vnet_lock_acquire(&vnet_tx_lock);
+	int ret = virtq_add(&vnet.txq, &vbuf, 1, 0, buf);
+	if (ret == -ENOSPC) {
+		vnet_tx_kick();
+		vnet_tx_reclaim();
+		ret = virtq_add(&vnet.txq, &vbuf, 1, 0, buf);
+	}
+	if (ret == 0) {
+		vnet.stats.tx_frames++;
+		if (++vnet.tx_unkicked >= VNET_TX_BATCH)
+			vnet_tx_kick();
+	}
+	vnet_lock_release(&vnet_tx_lock, irqs_on);
+
+	return (ret == -ENOSPC) ? -EAGAIN : ret;
+}
+
+void
+net_tx_flush(void)
+{
+	if (!vnet.ready)
+		return;
+
+	bool irqs_on = vnet_lock_acquire(&vnet_tx_lock);
+	vnet_tx_kick();
+	vnet_tx_reclaim();
+	vnet_lock_release(&vnet_tx_lock, irqs_on);
+}
+
+/* Get the next received frame, it belongs to the caller until it's given
+ * back with net_rx_release(). Returns -EAGAIN if there is nothing new,
+ * in which case receive interrupts get re-enabled (if net_enable_irq()
+ * was called). */
+int
+net_rx_poll(void **frame, size_t *len)
+{
+	if (!vnet.ready)
+		return -ENODEV;
+
+	uint32_t used_len = 0;
+	bool irqs_on = vnet_lock_acquire(&vnet_rx_lock);
+	uint8_t *buf = virtq_get(&vnet.rxq, &used_len);
+	/* Nothing left, go back to interrupts, unless something
+	 * came in just before we enabled them. */
+	if (!buf && vnet.irq_on && !virtq_enable_irq(&vnet.rxq)) {
+		virtq_disable_irq(&vnet.rxq);
+		buf = virtq_get(&vnet.rxq, &used_len);
+	}
+	if (buf)
+		vnet.stats.rx_frames++;
+	vnet_lock_release(&vnet_rx_lock, irqs_on);
+
+	if (!buf)
+		return -EAGAIN;
+
+	*frame = buf + VNET_FRAME_OFFT;
+	*len = (used_len > VNET_HDR_LEN) ? used_len - VNET_HDR_LEN : 0;
+	return 0;
+}
+
+void
+net_rx_release(void *frame)
+{
+	if (!vnet.ready || !frame)
+		return;
+
+	uint8_t *buf = (uint8_t*) frame - VNET_FRAME_OFFT;
+	bool irqs_on = vnet_lock_acquire(&vnet_rx_lock);
+	/* There are never more Rx buffers than queue entries */
+	vnet_rx_post(buf);
+	vnet_lock_release(&vnet_rx_lock, irqs_on);
+}
+
+void
+net_get_stats(struct net_stats *stats)
+{
+	*stats = vnet.stats;
+}
+
+#ifndef PLAT_NO_IRQ
+void
+net_set_rx_handler(net_rx_handler_t handler)
+{
+	vnet.rx_handler = handler;
+	/* Memory barrier to ensure the write is visible */
+	__asm__ volatile("fence rw,rw" ::: "memory");
+}
+
+/* Frames that were already there don't trigger an interrupt,
+ * call net_rx_poll() after this to get them */
+void
+net_enable_irq(void)
+{
+	if (!vnet.ready)
+		return;
+	bool irqs_on = vnet_lock_acquire(&vnet_rx_lock);
+	vnet.irq_on = true;
+	virtq_enable_irq(&vnet.rxq);
+	vnet_lock_release(&vnet_rx_lock, irqs_on);
+}
+
+void
+net_disable_irq(void)
+{
+	if (!vnet.ready)
+		return;
+	bool irqs_on = vnet_lock_acquire(&vnet_rx_lock);
+	vnet.irq_on = false;
+	virtq_disable_irq(&vnet.rxq);
+	vnet_lock_release(&vnet_rx_lock, irqs_on);
+}
+
+static void
+vnet_irq_trampoline(uint16_t source_id)
+{
+	sdk_lock_acquire(&vnet_rx_lock);
+	virtio_dev_ack_irq(&vnet.dev);
+	const bool got_frames = virtq_has_used(&vnet.rxq);
+	/* Stay off until net_rx_poll() runs out of frames */
+	if (got_frames) {
+		virtq_disable_irq(&vnet.rxq);
+		vnet.stats.rx_irqs++;
+	}
+	sdk_lock_release(&vnet_rx_lock);
+
+	if (got_frames && vnet.rx_handler != NULL)
+		vnet.rx_handler();
+}
+
+REGISTER_IRQ_SOURCE(virtio_net, {
+	.source.wire_id = PLAT_VIRTIO_NET_IRQ,
+	.handler = vnet_irq_trampoline,
+	.target_hart = 0,
+	.priority = IRQ_PRIORITY_HIGH,
+	.flags = IRQ_TRIGGER_LEVEL_HIGH,
+});
+#else
+
+void net_set_rx_handler(net_rx_handler_t handler) { return; }
+void net_enable_irq(void) { return; }
+void net_disable_irq(void) { return; }
+
+#endif /* PLAT_NO_IRQ */
+#endif /* defined(PLAT_VIRTIO_NET_BASE_ADDR) && (PLAT_VIRTIO_NET_BASE_ADDR > 0) */
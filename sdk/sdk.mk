@@ -15,6 +15,30 @@ PLATFORM_OBJ_DIR = $(OBJ_DIR)/platform
 # SDK CFLAGS (SDK includes already in CFLAGS from build.mk)
 SDK_CFLAGS = $(CFLAGS) -DDEBUG
 
+# Build the testsuite with BENCH_AUTORUN=1 to have it run all benchmarks
+# on boot and print their results as CSV, before showing the menu
+TESTSUITE_CFLAGS =
+ifeq ($(BENCH_AUTORUN),1)
+TESTSUITE_CFLAGS += -DBENCH_AUTORUN
+endif
+
+# Build with LZ4_BOOT=1 to run everything but start.S's boot stage from
+# ram, and store it LZ4-compressed on rom, for the boot stage to expand
+# it on boot (see the linker script and tools/lz4_pack.py). Do a clean
+# build when switching, the linker scripts / objects don't track this.
+LDSCRIPT_DEFS =
+ifeq ($(LZ4_BOOT),1)
+SDK_CFLAGS += -DLZ4_BOOT
+LDSCRIPT_DEFS += -DLZ4_BOOT
+endif
+
+# Build with IPI_FANOUT=<n> (> 1) to have multicast IPIs fan out in a tree
+# of up to n children per hart (see ipi_common.c), overriding the target's
+# PLAT_IPI_FANOUT, e.g. to run the testsuite's IPI multicast test on it.
+ifneq ($(IPI_FANOUT),)
+SDK_CFLAGS += -DPLAT_IPI_FANOUT=$(IPI_FANOUT)
+endif
+
 # Source files
 YALIBC_SOURCES = $(wildcard yalibc/src/*.c)
 PLATFORM_C_SOURCES = $(wildcard platform/src/*.c)
@@ -44,7 +68,8 @@ LIBS = $(foreach target,$(ALL_TARGETS),$(BUILD_DIR)/libplatform_$(target).a)
 LDSCRIPTS = $(foreach target,$(ALL_TARGETS),$(LDSCRIPT_DIR)/bmmap.$(target).ld)
 TESTSUITE_BINS = $(foreach target,$(ALL_TARGETS),$(BUILD_DIR)/bm_testsuite.$(target))
 
-# Testsuite linker script
+# Testsuite linker script, it INSERTs its sections into the main one,
+# so it has to come first
 TESTSUITE_LDSCRIPT = testsuite/test_sections.ld
 
 .PHONY: all clean libs ldscripts testsuite test dtb help
@@ -68,6 +93,9 @@ help:
 	@echo "  TFTPROOT=<path>  - Enable TFTP support in QEMU (optional)"
 	@echo "  DTB_PATH=<path>  - Directory to dump device tree (default: current directory)"
 	@echo "  V=1              - Verbose build output"
+	@echo "  BENCH_AUTORUN=1  - Testsuite runs all benchmarks on boot, CSV output"
+	@echo "  LZ4_BOOT=1       - Run from ram, with an LZ4-compressed image on rom"
+	@echo "  IPI_FANOUT=<n>   - Multicast IPIs fan out in a tree, n children per hart"
 	@echo ""
 	@echo "Available hardware targets: $(ALL_TARGETS)"
 
@@ -126,7 +154,7 @@ $(TESTSUITE_OBJ_DIR): | $(OBJ_DIR)
 # Generate linker scripts - pattern rule for any target
 $(LDSCRIPT_DIR)/bmmap.%.ld: $(LDSCRIPT_TEMPLATE) | $(LDSCRIPT_DIR)
 	$(MSG) "  [CPP]  $@"
-	$(Q)$(CPP) -I $(SDK_PLATFORM_INCLUDE) -I $(SDK_TARGETS_DIR)/$* -P -o $@ $<
+	$(Q)$(CPP) -I $(SDK_PLATFORM_INCLUDE) -I $(SDK_TARGETS_DIR)/$* $(LDSCRIPT_DEFS) -P -o $@ $<
 
 # Build yalibc objects (platform-independent)
 $(YALIBC_OBJ_DIR)/%.o: yalibc/src/%.c | $(YALIBC_OBJ_DIR) $(BUILD_DIR)
@@ -139,15 +167,15 @@ TESTSUITE_OBJS_$(1) = $$(patsubst %.c,$$(TESTSUITE_OBJ_DIR)/%.$(1).o,$$(notdir $
 
 $$(TESTSUITE_OBJ_DIR)/%.$(1).o: testsuite/%.c | $$(TESTSUITE_OBJ_DIR) $$(BUILD_DIR)
 	$$(MSG) "  [CC]   $$@"
-	$$(Q)$$(CC) $$(SDK_CFLAGS) -I $$(SDK_TARGETS_DIR)/$(1) -I testsuite/include -DDEBUG -c $$< -o $$@
+	$$(Q)$$(CC) $$(SDK_CFLAGS) -I $$(SDK_TARGETS_DIR)/$(1) -I testsuite/include -DDEBUG $$(TESTSUITE_CFLAGS) -c $$< -o $$@
 
 $$(TESTSUITE_OBJ_DIR)/%.$(1).o: testsuite/yalibc/%.c | $$(TESTSUITE_OBJ_DIR) $$(BUILD_DIR)
 	$$(MSG) "  [CC]   $$@"
-	$$(Q)$$(CC) $$(SDK_CFLAGS) -I $$(SDK_TARGETS_DIR)/$(1) -I testsuite/include -DDEBUG -c $$< -o $$@
+	$$(Q)$$(CC) $$(SDK_CFLAGS) -I $$(SDK_TARGETS_DIR)/$(1) -I testsuite/include -DDEBUG $$(TESTSUITE_CFLAGS) -c $$< -o $$@
 
 $$(TESTSUITE_OBJ_DIR)/%.$(1).o: testsuite/platform/%.c | $$(TESTSUITE_OBJ_DIR) $$(BUILD_DIR)
 	$$(MSG) "  [CC]   $$@"
-	$$(Q)$$(CC) $$(SDK_CFLAGS) -I $$(SDK_TARGETS_DIR)/$(1) -I testsuite/include -DDEBUG -c $$< -o $$@
+	$$(Q)$$(CC) $$(SDK_CFLAGS) -I $$(SDK_TARGETS_DIR)/$(1) -I testsuite/include -DDEBUG $$(TESTSUITE_CFLAGS) -c $$< -o $$@
 endef
 
 # Define a function to create build rules for each target
@@ -170,9 +198,17 @@ $$(BUILD_DIR)/libplatform_$(1).a: $$(ALL_OBJS_$(1))
 # Build testsuite binary for $(1)
 $$(BUILD_DIR)/bm_testsuite.$(1): $$(TESTSUITE_OBJS_$(1)) $$(BUILD_DIR)/libplatform_$(1).a $$(LDSCRIPT_DIR)/bmmap.$(1).ld
 	$$(MSG) "  [LD]   $$@.elf"
-	$$(Q)$$(CC) $$(SDK_CFLAGS) -I $$(SDK_TARGETS_DIR)/$(1) $$(TESTSUITE_OBJS_$(1)) $$(call PLATFORM_LIB,$(1)) -o $$@.elf $$(LOPTS) -T $$(LDSCRIPT_DIR)/bmmap.$(1).ld -T $$(TESTSUITE_LDSCRIPT)
+	$$(Q)$$(CC) $$(SDK_CFLAGS) -I $$(SDK_TARGETS_DIR)/$(1) $$(TESTSUITE_OBJS_$(1)) $$(call PLATFORM_LIB,$(1)) -o $$@.elf $$(LOPTS) -T $$(TESTSUITE_LDSCRIPT) -T $$(LDSCRIPT_DIR)/bmmap.$(1).ld
+ifeq ($(LZ4_BOOT),1)
+	$$(MSG) "  [LZ4]  $$@.bin"
+	$$(Q)$$(OBJCOPY) $$(CPOPS) -j .boot $$@.elf $$@.boot.bin
+	$$(Q)$$(OBJCOPY) $$(CPOPS) -R .boot $$@.elf $$@.image.bin
+	$$(Q)python3 $$(SDK_DIR)/tools/lz4_pack.py $$@.boot.bin $$@.image.bin $$@.bin \
+		--rom-size 0x$$$$($$(NM) $$@.elf | awk '$$$$3 == "___rom_length" { print $$$$1 }')
+else
 	$$(MSG) "  [BIN]  $$@.bin"
 	$$(Q)$$(OBJCOPY) $$(CPOPS) $$@.elf $$@.bin
+endif
 endef
 
 # Generate testsuite object rules for all targets
@@ -3,11 +3,30 @@
 FLASH_OPT=""
 DTB_OPT=""
 TFTP_OPT=""
+SERIAL_OPT="-serial stdio"
+CONSOLE_OPT=""
+BLK_OPT=""
 
 if [ -n "${TFTPROOT}" ]; then
 	TFTP_OPT=",tftp=${TFTPROOT},bootfile=boot.img"
 fi
 
+# Use a virtio console instead of the UART (for targets with
+# PLAT_VIRTIO_CONSOLE_BASE set), on virtio-mmio bus 6 (0x10007000)
+if [ -n "${VIRTIO_CONSOLE}" ]; then
+	SERIAL_OPT="-serial null"
+	CONSOLE_OPT="-chardev stdio,id=vcon0,signal=off \
+		     -device virtio-serial-device,bus=virtio-mmio-bus.6 \
+		     -device virtconsole,chardev=vcon0"
+fi
+
+# Attach a raw disk image as a virtio block device (see
+# virtio_blk.c), on virtio-mmio bus 5 (0x10006000)
+if [ -n "${VIRTIO_BLK}" ]; then
+	BLK_OPT="-drive file=${VIRTIO_BLK},format=raw,if=none,id=blk0 \
+		 -device virtio-blk-device,drive=blk0,bus=virtio-mmio-bus.5"
+fi
+
 if [ -n "${DTB_PATH}" ]; then
 	# Resolve DTB_PATH relative to the original working directory
 	DTB_PATH_ABS="$(cd "${ORIGINAL_PWD}" && cd "${DTB_PATH}" && pwd)"
@@ -26,10 +45,12 @@ else
 	fi
 fi
 
-qemu-system-riscv64 -machine virt${DTB_OPT},aia=aplic-imsic -serial stdio -nographic -monitor null -s -bios none \
+qemu-system-riscv64 -machine virt${DTB_OPT},aia=aplic-imsic ${SERIAL_OPT} -nographic -monitor null -s -bios none \
 		    -smp 4 -m 2G -global virtio-mmio.force-legacy=false  \
 		    -netdev user,id=net0${TFTP_OPT} \
 		    -device virtio-net-device,netdev=net0 \
+		    ${CONSOLE_OPT} \
+		    ${BLK_OPT} \
 		    ${FLASH_OPT}
 
 if [ -f /tmp/riscv-bm-qemu.flash ]; then
@@ -24,6 +24,25 @@
 #define	PLAT_HART_FREQ		1000000000
 
 
+/*---=== Performance Counters ===---*/
+/* Named mhpmevent values for perf.h, QEMU's virt machine uses
+ * the SBI PMU event codes for the few events it emulates. */
+#define PLAT_PERF_EVENTS \
+	{ "cpu_cycles",		0x1 }, \
+	{ "instructions",	0x2 }, \
+	{ "dtlb_load_miss",	0x10019 }, \
+	{ "dtlb_store_miss",	0x1001B }, \
+	{ "itlb_miss",		0x10021 }
+
+/* Named sets of the above, usable in place of event names */
+#define PLAT_PERF_SETS \
+	{ "tlb",	"dtlb_load_miss,dtlb_store_miss,itlb_miss" }
+
+/* Default event for the sampling profiler, QEMU only raises
+ * overflow interrupts for its cycles / instructions events */
+#define PLAT_PERF_PROF_EVENT	"cpu_cycles"
+
+
 /*---=== Memory Layout ===---*/
 #define KB	1024
 #define MB	KB * 1024
@@ -136,8 +155,22 @@ DEFINE_PLATFORM_INTC_MAP({
 #define PLAT_UART_REG_SHIFT	0
 #define	PLAT_UART_SHIFTED_IO	0
 #define PLAT_UART_IRQ		10
+#define PLAT_UART_FIFO_DEPTH	16
+
+/*---=== VIRTIO Console ===---*/
+/* Set to the base address of a virtio-mmio slot with a virtio console
+ * (e.g. 0x10007000 on QEMU virt, see VIRTIO_CONSOLE in run.sh) to use
+ * it instead of the UART, set to 0 to disable */
+#define PLAT_VIRTIO_CONSOLE_BASE	0
+#define PLAT_VIRTIO_CONSOLE_IRQ		7
 
 /*---=== VIRTIO Net ===---*/
 #define PLAT_VIRTIO_NET_BASE_ADDR 0x10008000	/* QEMU virt default */
+#define PLAT_VIRTIO_NET_IRQ	8
+
+/*---=== VIRTIO Block ===---*/
+/* Slot used by run.sh for VIRTIO_BLK=<image> */
+#define PLAT_VIRTIO_BLK_BASE_ADDR 0x10006000
+#define PLAT_VIRTIO_BLK_IRQ	6
 
 #endif /* _PLATFORM_H */
\ No newline at end of file
@@ -131,6 +131,7 @@ DEFINE_PLATFORM_INTC_MAP({
 #define PLAT_UART_REG_SHIFT	2
 #define	PLAT_UART_SHIFTED_IO	1
 #define PLAT_UART_IRQ		1
+#define PLAT_UART_FIFO_DEPTH	16
 
 
 /*---=== EMACLITE NIC ==---*/
@@ -0,0 +1,172 @@
+/*
+ * SPDX-FileType: SOURCE
+ *
+ * SPDX-FileCopyrightText: 2026 Nick Kossifidis <mick@ics.forth.gr>
+ * SPDX-FileCopyrightText: 2026 ICS/FORTH
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <test_framework.h>		/* For struct bench_entry */
+#include <platform/utils/utils.h>	/* For console output */
+#include <platform/utils/perf.h>	/* For perf_group_*() */
+#include <platform/utils/log.h>	/* For log_drain() */
+#include <stdio.h>			/* For printf(), snprintf() */
+#include <stdint.h>			/* For typed integers */
+#include <stdlib.h>			/* For malloc() / free() */
+#include <errno.h>			/* For ENOMEM */
+
+/*
+ * Benchmark runner for REGISTER_BENCHMARK entries. Each run is counted
+ * on its own through a perf group (cycles, instret and the entry's extra
+ * events), so we get a sample per run and per event, and report the
+ * min / median / max of them. The CSV output has one line per event:
+ *
+ * BENCH,"<description>",<event>,<iters>,<reps>,<min>,<median>,<max>
+ *
+ * with the raw counts of a run (iters operations), between a BENCH_BEGIN
+ * and a BENCH_END line, so that a script can pick it up from the UART log.
+ * The samples are allocated per run, for the events / runs it has.
+ */
+
+/*********\
+* Helpers *
+\*********/
+
+/* Insertion sort, we only have a few samples */
+static void
+bench_sort(uint64_t *vals, uint32_t num)
+{
+	for (uint32_t i = 1; i < num; i++) {
+		uint64_t val = vals[i];
+		uint32_t j = i;
+		for (; j > 0 && vals[j - 1] > val; j--)
+			vals[j] = vals[j - 1];
+		vals[j] = val;
+	}
+}
+
+static int
+bench_group_init(struct perf_group *group, const struct bench_entry *bench, bool csv)
+{
+	char events[128];
+	int ret = 0;
+
+	if (bench->events == NULL)
+		return perf_group_init(group, "cycles,instret");
+
+	snprintf(events, sizeof(events), "cycles,instret,%s", bench->events);
+	if ((ret = perf_group_init(group, events)) == 0)
+		return 0;
+
+	/* Missing hpm counters or an event this target doesn't name,
+	 * still worth running for cycles / instret */
+	if (!csv)
+		INF("Couldn't count %s (%i), only cycles / instret\n", bench->events, ret);
+	return perf_group_init(group, "cycles,instret");
+}
+
+/**************\
+* Entry points *
+\**************/
+
+int
+bench_run(const struct bench_entry *bench, bool csv)
+{
+	const uint32_t warmup = bench->warmup ? bench->warmup : BENCHMARK_DEFAULT_WARMUP;
+	uint32_t reps = bench->reps ? bench->reps : BENCHMARK_DEFAULT_REPS;
+	const uint32_t iters = bench->iters ? bench->iters : 1;
+	uint64_t values[PERF_MAX_EVENTS];
+	uint64_t *bench_samples = NULL;
+	struct perf_group group;
+	void *ctx = NULL;
+	int ret = 0;
+
+	if (reps > BENCHMARK_MAX_REPS)
+		reps = BENCHMARK_MAX_REPS;
+
+	if (!csv)
+		ANN("\n---=== %s (%u warmup, %u runs x %u) ===---\n",
+		    bench->description, warmup, reps, iters);
+
+	if (bench->setup && (ret = bench->setup(&ctx)) != 0) {
+		ERR("%s: setup failed (%i)\n", bench->description, ret);
+		return 1;
+	}
+
+	if ((ret = bench_group_init(&group, bench, csv)) != 0) {
+		ERR("%s: couldn't set up the counters (%i)\n", bench->description, ret);
+		goto out;
+	}
+
+	/* One row of reps samples per event */
+	bench_samples = malloc(group.num_events * reps * sizeof(uint64_t));
+	if (!bench_samples) {
+		ERR("%s: no memory for the samples\n", bench->description);
+		ret = -ENOMEM;
+		goto out;
+	}
+
+	for (uint32_t run = 0; run < warmup + reps; run++) {
+		perf_group_reset(&group);
+		if ((ret = perf_group_start(&group)) != 0) {
+			ERR("%s: couldn't start the counters (%i)\n", bench->description, ret);
+			goto out;
+		}
+		for (uint32_t i = 0; i < iters; i++)
+			bench->bench_fn(ctx);
+		perf_group_stop(&group);
+
+		if (run < warmup)
+			continue;
+		perf_group_totals(&group, values);
+		for (uint8_t e = 0; e < group.num_events; e++)
+			bench_samples[e * reps + run - warmup] = values[e];
+	}
+
+	if (!csv)
+		INF("%-24s %14s %14s %14s\n", "per op", "min", "median", "max");
+
+	for (uint8_t e = 0; e < group.num_events; e++) {
+		uint64_t *samples = &bench_samples[e * reps];
+		bench_sort(samples, reps);
+		const uint64_t min = samples[0];
+		const uint64_t max = samples[reps - 1];
+		const uint64_t median = (reps & 1) ? samples[reps / 2] :
+					(samples[reps / 2 - 1] + samples[reps / 2]) / 2;
+		if (csv)
+			printf("BENCH,\"%s\",%s,%u,%u,%lu,%lu,%lu\n", bench->description,
+			       group.names[e], iters, reps, min, median, max);
+		else
+			INF("%-24s %14.2f %14.2f %14.2f\n", group.names[e],
+			    (double) min / iters, (double) median / iters,
+			    (double) max / iters);
+	}
+
+ out:
+	free(bench_samples);
+	if (bench->teardown)
+		bench->teardown(ctx);
+	return ret ? 1 : 0;
+}
+
+/* Returns the number of benchmarks that failed to run */
+int
+bench_run_all(bool csv)
+{
+	const size_t num = __stop_rodata_benchmarks - __start_rodata_benchmarks;
+	int failures = 0;
+
+	log_drain();
+	if (csv) {
+		printf("BENCH_BEGIN,%lu\n", num);
+		printf("BENCH_HEADER,description,event,iters,reps,min,median,max\n");
+	}
+	for (size_t i = 0; i < num; i++) {
+		failures += bench_run(&__start_rodata_benchmarks[i], csv);
+		log_drain();
+	}
+	if (csv)
+		printf("BENCH_END,%i\n", failures);
+	return failures;
+}
@@ -10,6 +10,9 @@
 #ifndef TEST_FRAMEWORK_H
 #define TEST_FRAMEWORK_H
 
+#include <stdint.h>	/* For typed integers */
+#include <stdbool.h>	/* For bool */
+
 typedef int (*test_func_t)(void);
 
 struct test_entry {
@@ -19,6 +22,7 @@ struct test_entry {
 
 #define YALIBC_TEST_SECTION __attribute__((section("__tests_yalibc"), used, aligned(16)))
 #define PLATFORM_TEST_SECTION __attribute__((section("__tests_platform"), used, aligned(16)))
+#define YALIBC_BENCH_SECTION __attribute__((section("__bench_yalibc"), used, aligned(16)))
 
 #define REGISTER_YALIBC_TEST(desc, func) \
 	static const struct test_entry __test_yalibc_##func YALIBC_TEST_SECTION = { \
@@ -32,9 +36,59 @@ struct test_entry {
 		.test_fn = func \
 	}
 
+/* Benchmarks use the same entries, they just report their results
+ * instead of checking them, and return non-zero only on setup errors. */
+#define REGISTER_YALIBC_BENCH(desc, func) \
+	static const struct test_entry __bench_yalibc_##func YALIBC_BENCH_SECTION = { \
+		.description = desc, \
+		.test_fn = func \
+	}
+
+/*
+ * Benchmarks with a harness: bench_fn does one operation on ctx (from the
+ * optional setup), the runner calls it iters times per run, discards the
+ * first warmup runs and reports min / median / max across reps runs for
+ * cycles, instret and any events (perf.h names / sets, e.g. "tlb") on
+ * events, normalized per operation. Zero fields get the defaults below.
+ */
+typedef void (*bench_func_t)(void *ctx);
+typedef int (*bench_setup_t)(void **ctx);
+typedef void (*bench_teardown_t)(void *ctx);
+
+#define BENCHMARK_DEFAULT_WARMUP	1
+#define BENCHMARK_DEFAULT_REPS		11
+#define BENCHMARK_MAX_REPS		64
+
+struct bench_entry {
+	const char *description;	/* No commas, it goes on the CSV output */
+	bench_func_t bench_fn;
+	bench_setup_t setup;
+	bench_teardown_t teardown;
+	const char *events;		/* Extra events besides cycles / instret */
+	uint32_t warmup;
+	uint32_t reps;
+	uint32_t iters;
+} __attribute__((aligned(16)));
+
+#define BENCHMARK_SECTION __attribute__((section("__benchmarks"), used))
+
+#define REGISTER_BENCHMARK(desc, func, ...) \
+	static const struct bench_entry __benchmark_##func BENCHMARK_SECTION = { \
+		.description = desc, \
+		.bench_fn = func, \
+		__VA_ARGS__ \
+	}
+
+int bench_run(const struct bench_entry *bench, bool csv);
+int bench_run_all(bool csv);
+
 extern struct test_entry __start_rodata_tests_yalibc[];
 extern struct test_entry __stop_rodata_tests_yalibc[];
 extern struct test_entry __start_rodata_tests_platform[];
 extern struct test_entry __stop_rodata_tests_platform[];
+extern struct test_entry __start_rodata_bench_yalibc[];
+extern struct test_entry __stop_rodata_bench_yalibc[];
+extern struct bench_entry __start_rodata_benchmarks[];
+extern struct bench_entry __stop_rodata_benchmarks[];
 
 #endif
@@ -11,6 +11,7 @@
 #include <platform/utils/utils.h>	/* For console output */
 #include <platform/riscv/hart.h>	/* For hart_get_hstate_self() */
 #include <platform/riscv/csr.h>		/* For pause() */
+#include <platform/utils/log.h>	/* For log_drain() */
 #include <stdio.h>			/* For getchar(), EOF */
 #include <errno.h>			/* For EAGAIN */
 
@@ -23,6 +24,9 @@ print_category_menu(void)
 	INF("Select test category:\n");
 	INF("\t1 -> YaLibC tests\n");
 	INF("\t2 -> Platform tests\n");
+	INF("\t3 -> YaLibC benchmarks\n");
+	INF("\t4 -> Benchmarks (min / median / max)\n");
+	INF("\tb -> Run all benchmarks, CSV output\n");
 }
 
 static void
@@ -47,6 +51,7 @@ run_test_category(struct test_entry *tests_start, struct test_entry *tests_end,
 
 	while (1) {
 		print_test_menu(tests_start, tests_end, category);
+		log_drain();
 
 		int input = getchar();
 		if (input == EOF) {
@@ -74,14 +79,69 @@ run_test_category(struct test_entry *tests_start, struct test_entry *tests_end,
 	}
 }
 
+static void
+print_bench_menu(struct bench_entry *bench_start, struct bench_entry *bench_end)
+{
+	size_t num_benchs = bench_end - bench_start;
+
+	ANN("\n---=== Benchmarks ===---\n");
+	INF("Select a benchmark:\n");
+
+	for (size_t i = 0; i < num_benchs; i++) {
+		INF("\t%zu -> %s\n", i + 1, bench_start[i].description);
+	}
+	INF("\ta -> Run all of them\n");
+	INF("\t0 -> Back to category menu\n");
+}
+
+static int
+run_bench_category(struct bench_entry *bench_start, struct bench_entry *bench_end)
+{
+	size_t num_benchs = bench_end - bench_start;
+	int total_failures = 0;
+
+	while (1) {
+		print_bench_menu(bench_start, bench_end);
+		log_drain();
+
+		int input = getchar();
+		if (input == EOF) {
+			pause();
+			continue;
+		}
+
+		if (input == '0') {
+			return total_failures;
+		}
+
+		int bench_num = input - '1';
+		if (input == 'a') {
+			total_failures += bench_run_all(false);
+		} else if (bench_num >= 0 && bench_num < num_benchs) {
+			total_failures += bench_run(&bench_start[bench_num], false);
+		} else {
+			INF("Invalid selection. Please try again.\n");
+		}
+
+		pause();
+	}
+}
+
 void
 main(void)
 {
 	int total_failures = 0;
 	DBG("At main\n");
 
+#if defined(BENCH_AUTORUN)
+	/* Non-interactive, for tracking performance across builds */
+	total_failures += bench_run_all(true);
+	INF("\n---===DONE===---\n");
+#endif
+
 	while (1) {
 		print_category_menu();
+		log_drain();
 
 		int input = getchar();
 		if (input == EOF) {
@@ -106,6 +166,24 @@ main(void)
 				);
 				INF("\nTotal failures across all tests: %i\n", total_failures);
 				break;
+			case '3':
+				total_failures += run_test_category(
+					__start_rodata_bench_yalibc,
+					__stop_rodata_bench_yalibc,
+					"YaLibC Benchmarks"
+				);
+				INF("\nTotal failures across all tests: %i\n", total_failures);
+				break;
+			case '4':
+				total_failures += run_bench_category(
+					__start_rodata_benchmarks,
+					__stop_rodata_benchmarks
+				);
+				INF("\nTotal failures across all tests: %i\n", total_failures);
+				break;
+			case 'b':
+				total_failures += bench_run_all(true);
+				break;
 			case EOF:
 				break;
 			default:
@@ -0,0 +1,148 @@
+/*
+ * SPDX-FileType: SOURCE
+ *
+ * SPDX-FileCopyrightText: 2026 Nick Kossifidis <mick@ics.forth.gr>
+ * SPDX-FileCopyrightText: 2026 ICS/FORTH
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <target_config.h>		/* For PLAT_MAX_HARTS */
+#include <platform/utils/utils.h>	/* For console output */
+#include <platform/utils/barrier.h>	/* For the barrier API */
+#include <platform/riscv/hart.h>	/* For hart_wakeup_with_addr() */
+#include <test_framework.h>		/* For test registration macros */
+
+#include <stdatomic.h>	/* For C11 atomics */
+#include <stdint.h>	/* For typed integers */
+#include <stdlib.h>	/* For aligned_alloc() / free() */
+#include <time.h>	/* For clock() */
+
+#define BARRIER_TEST_ROUNDS	100
+
+/* Each hart publishes the round it's on, and after every barrier
+ * checks that all other harts got there too */
+static atomic_uint barrier_test_phase[PLAT_MAX_HARTS];
+static atomic_int barrier_test_errors;
+static atomic_int barrier_test_done;
+static struct barrier barrier_test_central[2];
+/* With per-hart cache line sized nodes these are too big for .bss */
+static struct dissem_barrier *barrier_test_dissem;
+
+static void
+barrier_test_check(uint16_t self, unsigned int round)
+{
+	for (int i = 0; i < hart_get_count(); i++) {
+		if (atomic_load_explicit(&barrier_test_phase[i], memory_order_relaxed) != round) {
+			ERR("Hart %u passed barrier %u before hart %i got there\n",
+			    self, round, i);
+			atomic_fetch_add_explicit(&barrier_test_errors, 1, memory_order_relaxed);
+			return;
+		}
+	}
+}
+
+static void
+barrier_test_run(void)
+{
+	const uint16_t self = hart_get_hstate_self()->hart_idx;
+	unsigned int round = 0;
+
+	for (int mode = 0; mode < 2; mode++) {
+		for (int i = 0; i < BARRIER_TEST_ROUNDS; i++) {
+			atomic_store_explicit(&barrier_test_phase[self], ++round, memory_order_relaxed);
+			barrier_wait(&barrier_test_central[mode]);
+			barrier_test_check(self, round);
+			/* Nobody may move on to the next round before
+			 * everyone is done checking this one */
+			barrier_wait(&barrier_test_central[mode]);
+		}
+		for (int i = 0; i < BARRIER_TEST_ROUNDS; i++) {
+			atomic_store_explicit(&barrier_test_phase[self], ++round, memory_order_relaxed);
+			dissem_barrier_wait(&barrier_test_dissem[mode]);
+			barrier_test_check(self, round);
+			dissem_barrier_wait(&barrier_test_dissem[mode]);
+		}
+	}
+}
+
+static void __attribute__((noreturn))
+barrier_test_payload(uint64_t arg0, uint64_t arg1)
+{
+	(void) arg0;
+	(void) arg1;
+	barrier_test_run();
+	atomic_fetch_add_explicit(&barrier_test_done, 1, memory_order_release);
+	hart_idle();
+}
+
+static int
+test_barrier(void)
+{
+	ANN("\n---=== Hart Barrier Test ===---\n");
+	struct hart_state *this_hs = hart_get_hstate_self();
+	const int num_harts = hart_get_count();
+	int failures = 0;
+
+	/* The barriers expect every hart to take part */
+	for (int i = 0; i < num_harts; i++) {
+		struct hart_state *hs = hart_get_hstate_by_idx(i);
+		if (hs == this_hs)
+			continue;
+		if (!hart_test_flags(hs, HS_FLAG_READY) ||
+		    hart_test_flags(hs, HS_FLAG_RUNNING) || hart_test_flags(hs, HS_FLAG_POOL)) {
+			INF("Hart %i is not available, skipping\n", i);
+			return 0;
+		}
+	}
+	if (num_harts == 1)
+		INF("Single hart, barriers should return immediately\n");
+
+	barrier_test_dissem = aligned_alloc(_Alignof(struct dissem_barrier),
+					    2 * sizeof(struct dissem_barrier));
+	if (!barrier_test_dissem) {
+		ERR("Could not allocate the dissemination barriers\n");
+		return 1;
+	}
+
+	for (int mode = 0; mode < 2; mode++) {
+		barrier_init(&barrier_test_central[mode], (enum barrier_wait_mode) mode);
+		dissem_barrier_init(&barrier_test_dissem[mode], (enum barrier_wait_mode) mode);
+	}
+	for (int i = 0; i < num_harts; i++)
+		atomic_init(&barrier_test_phase[i], 0);
+	atomic_store_explicit(&barrier_test_errors, 0, memory_order_relaxed);
+	atomic_store_explicit(&barrier_test_done, 0, memory_order_relaxed);
+
+	for (int i = 0; i < num_harts; i++) {
+		struct hart_state *hs = hart_get_hstate_by_idx(i);
+		if (hs == this_hs)
+			continue;
+		hart_set_flags(hs, HS_FLAG_RUNNING);
+		hart_wakeup_with_addr(i, (uintptr_t) barrier_test_payload, 0, 0, 0);
+	}
+
+	INF("Running %u rounds on %i harts, spinning and with wfi\n",
+	    2 * BARRIER_TEST_ROUNDS, num_harts);
+	barrier_test_run();
+
+	clock_t start = clock();
+	while (atomic_load_explicit(&barrier_test_done, memory_order_acquire) < num_harts - 1 &&
+	       (clock() - start) < CLOCKS_PER_SEC)
+		pause();
+	if (atomic_load_explicit(&barrier_test_done, memory_order_acquire) < num_harts - 1) {
+		ERR("Not all harts made it out of the barriers\n");
+		failures++;
+	} else {
+		/* Else someone may still be waiting on them */
+		free(barrier_test_dissem);
+		barrier_test_dissem = NULL;
+	}
+	failures += atomic_load_explicit(&barrier_test_errors, memory_order_relaxed);
+
+	INF("=== Hart Barrier Test Results: %s (%d failures) ===\n",
+	    failures == 0 ? "PASS" : "FAIL", failures);
+	return failures;
+}
+
+REGISTER_PLATFORM_TEST("Hart barrier test", test_barrier);
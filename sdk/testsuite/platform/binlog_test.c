@@ -0,0 +1,112 @@
+/*
+ * SPDX-FileType: SOURCE
+ *
+ * SPDX-FileCopyrightText: 2026 Nick Kossifidis <mick@ics.forth.gr>
+ * SPDX-FileCopyrightText: 2026 ICS/FORTH
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <platform/utils/utils.h>	/* For console output */
+#include <platform/utils/binlog.h>	/* For the binlog API */
+#include <test_framework.h>		/* For test registration macros */
+
+#include <stdint.h>	/* For typed integers */
+#include <string.h>	/* For memcmp() */
+#include <errno.h>	/* For error codes */
+#include <malloc.h>	/* For page_alloc() */
+
+#define BINLOG_TEST_RECS	16
+
+extern const char __binlog_fmts_start[];
+extern const char __binlog_fmts_end[];
+
+static int
+binlog_test_check(uint64_t seq, unsigned int nargs, const uint64_t *args, const char *fmt)
+{
+	struct binlog_record rec;
+	if (binlog_get(seq, &rec) < 0) {
+		ERR("Record %lu is missing\n", seq);
+		return 1;
+	}
+
+	const char *rec_fmt = __binlog_fmts_start + rec.fmt_id;
+	if (rec_fmt >= __binlog_fmts_end || strcmp(rec_fmt, fmt) != 0) {
+		ERR("Record %lu has a bad format ID (%u)\n", seq, rec.fmt_id);
+		return 1;
+	}
+
+	if (rec.nargs != nargs || memcmp(rec.args, args, nargs * sizeof(uint64_t)) != 0) {
+		ERR("Record %lu has bad arguments\n", seq);
+		return 1;
+	}
+
+	return 0;
+}
+
+static int
+test_binlog(void)
+{
+	ANN("\n---=== Binary Log Test ===---\n");
+	int failures = 0;
+
+	void *buff = page_alloc(1, 0);
+	if (!buff) {
+		ERR("Could not allocate the binlog buffer\n");
+		return -1;
+	}
+
+	if (binlog_init(buff, sizeof(struct binlog_record) - 1) != -EINVAL) {
+		ERR("binlog_init accepted a buffer with no room for records\n");
+		failures++;
+	}
+
+	/* Less than a page, so that it gets rounded down */
+	if (binlog_init(buff, BINLOG_TEST_RECS * sizeof(struct binlog_record) + 8) < 0) {
+		ERR("binlog_init failed\n");
+		page_free(buff, 1);
+		return -1;
+	}
+
+	INF("Logging a few records\n");
+	int neg = -5;
+	double dval = 1.5;
+	const char *str = "test";
+	BINLOG("no arguments\n");
+	BINLOG("int %i, unsigned %u\n", neg, 42U);
+	BINLOG("long %li, ptr %p, str %s, dbl %f, char %c\n", -1L, buff, str, dval, 'x');
+
+	union { double d; uint64_t u; } bits = { .d = dval };
+	const uint64_t args1[] = { (uint64_t) -5, 42 };
+	const uint64_t args2[] = { (uint64_t) -1, (uintptr_t) buff, (uintptr_t) str, bits.u, 'x' };
+	failures += binlog_test_check(0, 0, args1, "no arguments\n");
+	failures += binlog_test_check(1, 2, args1, "int %i, unsigned %u\n");
+	failures += binlog_test_check(2, 5, args2, "long %li, ptr %p, str %s, dbl %f, char %c\n");
+
+	INF("Wrapping around\n");
+	for (unsigned int i = 0; i < BINLOG_TEST_RECS; i++)
+		BINLOG("record %u\n", i);
+	struct binlog_record rec;
+	if (binlog_count() != BINLOG_TEST_RECS + 3) {
+		ERR("Got %lu records instead of %u\n", binlog_count(), BINLOG_TEST_RECS + 3);
+		failures++;
+	}
+	if (binlog_get(2, &rec) != -ENOMSG) {
+		ERR("Overwritten record is still there\n");
+		failures++;
+	}
+	const uint64_t args3[] = { BINLOG_TEST_RECS - 1 };
+	failures += binlog_test_check(BINLOG_TEST_RECS + 2, 1, args3, "record %u\n");
+
+	binlog_dump();
+
+	/* Don't leave it pointing to freed memory */
+	binlog_init(NULL, 0);
+	page_free(buff, 1);
+
+	INF("=== Binary Log Test Results: %s (%d failures) ===\n",
+	    failures == 0 ? "PASS" : "FAIL", failures);
+	return failures;
+}
+
+REGISTER_PLATFORM_TEST("Deferred binary log test", test_binlog);
@@ -0,0 +1,44 @@
+/*
+ * SPDX-FileType: SOURCE
+ *
+ * SPDX-FileCopyrightText: 2026 Nick Kossifidis <mick@ics.forth.gr>
+ * SPDX-FileCopyrightText: 2026 ICS/FORTH
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <platform/utils/utils.h>	/* For console output */
+#include <platform/utils/boot_prof.h>	/* For boot_prof_cycles/dump() */
+#include <test_framework.h>		/* For test registration macros */
+
+/* Print the boot phases, and check that their stamps are in order */
+static int
+test_boot_prof(void)
+{
+	ANN("\n---=== Boot Profiling Test ===---\n");
+	uint64_t prev = boot_prof_cycles[BOOT_PHASE_RESET];
+	int failures = 0;
+
+	for (int i = BOOT_PHASE_DATA_BSS; i < BOOT_PHASE_NUM; i++) {
+		/* Not reached through a custom platform_init() */
+		if (!boot_prof_cycles[i])
+			continue;
+		if (boot_prof_cycles[i] < prev) {
+			ERR("Boot phase %i stamped before the previous one\n", i);
+			failures++;
+		}
+		prev = boot_prof_cycles[i];
+	}
+	if (!boot_prof_cycles[BOOT_PHASE_MAIN]) {
+		ERR("Entry to main() wasn't stamped\n");
+		failures++;
+	}
+
+	boot_prof_dump();
+
+	INF("=== Boot Profiling Test Results: %s (%d failures) ===\n",
+	    failures == 0 ? "PASS" : "FAIL", failures);
+	return failures;
+}
+
+REGISTER_PLATFORM_TEST("Boot phase timestamps", test_boot_prof);
@@ -0,0 +1,193 @@
+/*
+ * SPDX-FileType: SOURCE
+ *
+ * SPDX-FileCopyrightText: 2026 Nick Kossifidis <mick@ics.forth.gr>
+ * SPDX-FileCopyrightText: 2026 ICS/FORTH
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <platform/utils/utils.h>	/* For console output */
+#include <platform/utils/crc.h>		/* For crc32() / crc32c() / hash64() */
+#include <platform/riscv/caps.h>	/* For struct rvcaps / CAP_ZBKC */
+#include <platform/riscv/hart.h>	/* For hart_probe_isa_caps() */
+#include <test_framework.h>		/* For test registration macros */
+#include <stdlib.h>			/* For rand_fill()/malloc() */
+#include <errno.h>			/* For ENOMEM */
+#include <string.h>			/* For strlen() */
+
+/* From crc.c, to switch between the clmul / table kernels */
+void __crc_set_caps(const struct rvcaps *caps);
+
+#define CRC_TEST_BUF	1024
+#define CRC_BENCH_BUF	4096
+
+/* Bit-at-a-time reference */
+static uint32_t
+crc_test_bitwise(uint32_t poly, const uint8_t *p, size_t len)
+{
+	uint32_t crc = 0xFFFFFFFF;
+	while (len--) {
+		crc ^= *p++;
+		for (int i = 0; i < 8; i++)
+			crc = (crc >> 1) ^ (poly & -(crc & 1));
+	}
+	return ~crc;
+}
+
+/* Compare both CRCs against the reference for every length / alignment,
+ * returns the number of mismatches */
+static int
+crc_test_lengths(const char *kernel, const uint8_t *crc_test_buf)
+{
+	int failures = 0;
+	for (int off = 0; off < 8; off++) {
+		for (size_t len = 0; len < CRC_TEST_BUF; len += (len < 64) ? 1 : 61) {
+			const uint8_t *p = crc_test_buf + off;
+			if (crc32(0, p, len) != crc_test_bitwise(0xEDB88320, p, len) ||
+			    crc32c(0, p, len) != crc_test_bitwise(0x82F63B78, p, len)) {
+				ERR("%s: mismatch at offset %i, len %lu\n", kernel, off, len);
+				failures++;
+				break;
+			}
+		}
+	}
+	return failures;
+}
+
+static int
+test_crc(void)
+{
+	ANN("\n---=== CRC / Hashing Tests ===---\n");
+	static const char check[] = "123456789";
+	uint8_t *crc_test_buf = malloc(CRC_TEST_BUF + 8);
+	int failures = 0;
+
+	if (!crc_test_buf) {
+		ERR("Couldn't allocate the test buffer\n");
+		return 1;
+	}
+
+	/* Test 1: The standard check values */
+	if (crc32(0, check, 9) != 0xCBF43926 || crc32c(0, check, 9) != 0xE3069283) {
+		ERR("Check values: crc32 0x%08x, crc32c 0x%08x\n",
+		    crc32(0, check, 9), crc32c(0, check, 9));
+		failures++;
+	}
+
+	/* Test 2: Chaining gives the same result */
+	rand_fill(crc_test_buf, CRC_TEST_BUF + 8);
+	for (size_t split = 0; split <= 64; split += 7) {
+		const uint32_t whole = crc32c(0, crc_test_buf, 64);
+		const uint32_t chained = crc32c(crc32c(0, crc_test_buf, split),
+						crc_test_buf + split, 64 - split);
+		if (whole != chained) {
+			ERR("Chained crc32c differs when split at %lu\n", split);
+			failures++;
+			break;
+		}
+	}
+
+	/* Test 3: Unaligned heads / tails on both kernels, the clmul one
+	 * only if the hart has Zbc / Zbkc */
+	struct rvcaps caps;
+	hart_probe_isa_caps(&caps);
+	INF("Using %s\n", (caps.z_caps & CAP_ZBKC) ? "clmul" : "slicing-by-8 tables");
+	failures += crc_test_lengths((caps.z_caps & CAP_ZBKC) ? "clmul" : "tables", crc_test_buf);
+	if (caps.z_caps & CAP_ZBKC) {
+		struct rvcaps no_clmul = caps;
+		no_clmul.z_caps &= ~CAP_ZBKC;
+		__crc_set_caps(&no_clmul);
+		failures += crc_test_lengths("tables", crc_test_buf);
+		__crc_set_caps(&caps);
+	}
+
+	/* Test 4: hash64() against wyhash's own test vectors */
+	static const struct {
+		const char *msg;
+		uint64_t hash;
+	} vectors[] = {
+		{ "", 0x93228a4de0eec5a2ULL },
+		{ "a", 0xc5bac3db178713c4ULL },
+		{ "abc", 0xa97f2f7b1d9b3314ULL },
+		{ "message digest", 0x786d1f1df3801df4ULL },
+		{ "abcdefghijklmnopqrstuvwxyz", 0xdca5a8138ad37c87ULL },
+	};
+	for (size_t i = 0; i < sizeof(vectors) / sizeof(vectors[0]); i++) {
+		const uint64_t hash = hash64(vectors[i].msg, strlen(vectors[i].msg), i);
+		if (hash != vectors[i].hash) {
+			ERR("hash64(\"%s\", %lu) = 0x%016lx\n", vectors[i].msg, i, hash);
+			failures++;
+		}
+	}
+
+	/* Test 5: Every input byte / the seed affect the hash, on all
+	 * the paths (up to 3, up to 16, up to 48 and more) */
+	for (size_t len = 1; len <= 100; len += 11) {
+		const uint64_t hash = hash64(crc_test_buf, len, 0);
+		if (hash64(crc_test_buf, len, 1) == hash) {
+			ERR("hash64() ignores the seed for len %lu\n", len);
+			failures++;
+		}
+		for (size_t i = 0; i < len; i++) {
+			crc_test_buf[i] ^= 0x10;
+			const uint64_t flipped = hash64(crc_test_buf, len, 0);
+			crc_test_buf[i] ^= 0x10;
+			if (flipped == hash) {
+				ERR("hash64() ignores byte %lu of %lu\n", i, len);
+				failures++;
+				break;
+			}
+		}
+	}
+
+	free(crc_test_buf);
+
+	INF("=== CRC / Hashing Test Results: %s (%d failures) ===\n",
+	    failures == 0 ? "PASS" : "FAIL", failures);
+	return failures;
+}
+
+REGISTER_PLATFORM_TEST("CRC / hashing tests", test_crc);
+
+
+/************\
+* Benchmarks *
+\************/
+
+/* So that the results don't get optimized out */
+static volatile uint64_t crc_bench_sink;
+
+static int
+crc_bench_setup(void **ctx)
+{
+	uint8_t *buf = malloc(CRC_BENCH_BUF);
+	if (!buf)
+		return -ENOMEM;
+	rand_fill(buf, CRC_BENCH_BUF);
+	*ctx = buf;
+	return 0;
+}
+
+static void
+crc_bench_teardown(void *ctx)
+{
+	free(ctx);
+}
+
+static void
+bench_crc32c(void *ctx)
+{
+	crc_bench_sink = crc32c(0, ctx, CRC_BENCH_BUF);
+}
+
+static void
+bench_hash64(void *ctx)
+{
+	crc_bench_sink = hash64(ctx, CRC_BENCH_BUF, 0);
+}
+
+REGISTER_BENCHMARK("crc32c 4KB", bench_crc32c, .setup = crc_bench_setup,
+		   .teardown = crc_bench_teardown, .warmup = 1, .reps = 15);
+REGISTER_BENCHMARK("hash64 4KB", bench_hash64, .setup = crc_bench_setup,
+		   .teardown = crc_bench_teardown, .warmup = 1, .reps = 15);
@@ -0,0 +1,251 @@
+/*
+ * SPDX-FileType: SOURCE
+ *
+ * SPDX-FileCopyrightText: 2026 Nick Kossifidis <mick@ics.forth.gr>
+ * SPDX-FileCopyrightText: 2026 ICS/FORTH
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <platform/utils/utils.h>	/* For console output */
+#include <platform/utils/devq.h>	/* For the devq API */
+#include <test_framework.h>		/* For test registration macros */
+#include <stdbool.h>			/* For bool */
+#include <stdlib.h>			/* For malloc() / free() */
+#include <string.h>			/* For memset() */
+#include <errno.h>			/* For error codes */
+
+/*
+ * A software "device" behind a device queue: submitted requests wait in
+ * pending[] until the test completes them (as the device would), then
+ * in done[] until the queue reaps them, and its interrupt is just a
+ * flag, with dev_irq() called directly in place of the handler. Both
+ * the device and the requests are allocated by the test.
+ */
+
+#define DEVQ_TEST_SLOTS		40
+#define DEVQ_TEST_REQS		(DEVQ_TEST_SLOTS + 1)
+
+struct devq_test_req {
+	volatile int status;
+};
+
+struct fdev_state {
+	void *pending[DEVQ_TEST_SLOTS];
+	void *done[DEVQ_TEST_SLOTS];
+	unsigned int num_pending;
+	unsigned int num_done;
+	unsigned int kicks;
+	unsigned int completions;
+	bool irq_on;
+};
+
+static struct fdev_state *fdev;
+
+static int
+fdev_submit(struct devq *q, void *req)
+{
+	if (fdev->num_pending + fdev->num_done >= DEVQ_TEST_SLOTS)
+		return -EAGAIN;
+	((struct devq_test_req *) req)->status = -EBUSY;
+	fdev->pending[fdev->num_pending++] = req;
+	return 0;
+}
+
+static void
+fdev_kick(struct devq *q)
+{
+	fdev->kicks++;
+}
+
+static int
+fdev_reap(struct devq *q, void **reqs, int max)
+{
+	int num = 0;
+	while (num < max && fdev->num_done)
+		reqs[num++] = fdev->done[--fdev->num_done];
+	return num;
+}
+
+static void
+fdev_complete(struct devq *q, void *req)
+{
+	((struct devq_test_req *) req)->status = 0;
+	fdev->completions++;
+}
+
+static bool
+fdev_irq_ctl(struct devq *q, bool on)
+{
+	fdev->irq_on = on;
+	return !(on && fdev->num_done);
+}
+
+static const struct devq_ops fdev_ops = {
+	.submit = fdev_submit,
+	.kick = fdev_kick,
+	.reap = fdev_reap,
+	.complete = fdev_complete,
+	.irq_ctl = fdev_irq_ctl,
+};
+
+/* The "device" finishes num of the pending requests */
+static void
+fdev_finish(unsigned int num)
+{
+	while (num-- && fdev->num_pending)
+		fdev->done[fdev->num_done++] = fdev->pending[--fdev->num_pending];
+}
+
+static int
+test_devq(void)
+{
+	ANN("\n---=== Device Queue Tests ===---\n");
+	static const struct devq_ops no_irq_ops = { .submit = fdev_submit,
+						    .reap = fdev_reap,
+						    .complete = fdev_complete };
+	struct devq q;
+	struct devq_stats stats;
+	struct devq_test_req *devq_test_reqs = NULL;
+	int failures = 0;
+	int ret = 0;
+
+	fdev = malloc(sizeof(struct fdev_state));
+	devq_test_reqs = malloc(DEVQ_TEST_REQS * sizeof(struct devq_test_req));
+	if (!fdev || !devq_test_reqs) {
+		ERR("Couldn't allocate the test device / requests\n");
+		free(devq_test_reqs);
+		free(fdev);
+		return 1;
+	}
+	memset(fdev, 0, sizeof(struct fdev_state));
+	devq_init(&q, &fdev_ops, NULL);
+
+	/* Test 1: Submit until the device is full, one kick per request */
+	for (int i = 0; i < DEVQ_TEST_SLOTS; i++) {
+		if ((ret = dev_submit(&q, &devq_test_reqs[i])) < 0) {
+			ERR("dev_submit failed on request %i: %i\n", i, ret);
+			failures++;
+			break;
+		}
+	}
+	if (dev_submit(&q, &devq_test_reqs[DEVQ_TEST_SLOTS]) != -EAGAIN ||
+	    q.inflight != DEVQ_TEST_SLOTS || fdev->kicks != DEVQ_TEST_SLOTS) {
+		ERR("Full queue: inflight %u, kicks %u\n", q.inflight, fdev->kicks);
+		failures++;
+	}
+
+	/* Test 2: Nothing done yet, then completions within the budget,
+	 * and the rest in batches of DEVQ_BATCH */
+	if (dev_poll(&q, 0) != 0) {
+		ERR("dev_poll completed requests the device didn't\n");
+		failures++;
+	}
+	fdev_finish(DEVQ_TEST_SLOTS);
+	if ((ret = dev_poll(&q, 3)) != 3 || fdev->completions != 3) {
+		ERR("dev_poll with a budget of 3 completed %i\n", ret);
+		failures++;
+	}
+	if ((ret = dev_poll(&q, 0)) != DEVQ_TEST_SLOTS - 3 || q.inflight != 0) {
+		ERR("dev_poll completed %i of %i, %u still in flight\n",
+		    ret, DEVQ_TEST_SLOTS - 3, q.inflight);
+		failures++;
+	}
+	for (int i = 0; i < DEVQ_TEST_SLOTS; i++) {
+		if (devq_test_reqs[i].status != 0) {
+			ERR("Request %i not completed\n", i);
+			failures++;
+			break;
+		}
+	}
+
+	/* Test 3: A batch gets a single kick, and stops when the device is full */
+	void *batch[DEVQ_TEST_REQS];
+	for (int i = 0; i < DEVQ_TEST_REQS; i++)
+		batch[i] = &devq_test_reqs[i];
+	fdev->kicks = 0;
+	if ((ret = dev_submit_batch(&q, batch, DEVQ_TEST_REQS)) != DEVQ_TEST_SLOTS ||
+	    fdev->kicks != 1) {
+		ERR("dev_submit_batch queued %i with %u kicks\n", ret, fdev->kicks);
+		failures++;
+	}
+	if (dev_submit_batch(&q, batch, 1) != -EAGAIN) {
+		ERR("dev_submit_batch on a full queue should return -EAGAIN\n");
+		failures++;
+	}
+
+	/* Test 4: dev_wait() polls in polling mode */
+	fdev_finish(1);
+	struct devq_test_req *last = fdev->done[0];
+	if (dev_wait(&q, &last->status) != 0 || q.inflight != DEVQ_TEST_SLOTS - 1) {
+		ERR("dev_wait didn't complete the request\n");
+		failures++;
+	}
+
+	/* Test 5: Switching to interrupts picks up what completed before */
+	fdev_finish(2);
+	const unsigned int completions = fdev->completions;
+	if (dev_set_mode(&q, DEVQ_MODE_IRQ) < 0 || !fdev->irq_on ||
+	    fdev->completions != completions + 2) {
+		ERR("Switching to interrupts: irq %s, %u missed completions\n",
+		    fdev->irq_on ? "on" : "off", completions + 2 - fdev->completions);
+		failures++;
+	}
+
+	/* Test 6: Adaptive mode goes to polling on a busy interrupt while
+	 * someone polls, and back to interrupts once it's idle */
+	dev_set_mode(&q, DEVQ_MODE_ADAPTIVE);
+	fdev_finish(2);
+	dev_irq(&q);
+	if (!fdev->irq_on) {
+		ERR("Adaptive mode switched to polling with nobody polling\n");
+		failures++;
+	}
+	dev_poll(&q, 0);
+	fdev_finish(DEVQ_BUSY_THRESH);
+	dev_irq(&q);
+	dev_get_stats(&q, &stats);
+	if (fdev->irq_on || stats.to_poll != 1) {
+		ERR("Adaptive mode didn't switch to polling under load\n");
+		failures++;
+	}
+	fdev_finish(8);
+	for (int i = 0; i < DEVQ_IDLE_POLLS; i++) {
+		if (fdev->num_done == 0 && fdev->irq_on) {
+			ERR("Adaptive mode went back to interrupts after %i polls\n", i);
+			failures++;
+			break;
+		}
+		dev_poll(&q, 0);
+	}
+	dev_poll(&q, 0);
+	dev_get_stats(&q, &stats);
+	if (!fdev->irq_on || stats.to_irq != 1) {
+		ERR("Adaptive mode didn't go back to interrupts when idle\n");
+		failures++;
+	}
+	INF("Submitted %lu, completed %lu, %lu polls (%lu empty), %lu irqs\n",
+	    stats.submitted, stats.completed, stats.polls, stats.empty_polls, stats.irqs);
+	if (stats.submitted - stats.completed != q.inflight) {
+		ERR("Stats don't add up to the requests in flight\n");
+		failures++;
+	}
+
+	/* Test 7: No interrupt control, no interrupt modes */
+	devq_init(&q, &no_irq_ops, NULL);
+	if (dev_set_mode(&q, DEVQ_MODE_ADAPTIVE) != -ENOTSUP ||
+	    dev_set_mode(&q, DEVQ_MODE_POLL) != 0) {
+		ERR("dev_set_mode without irq_ctl\n");
+		failures++;
+	}
+
+	free(devq_test_reqs);
+	free(fdev);
+	fdev = NULL;
+
+	INF("=== Device Queue Test Results: %s (%d failures) ===\n",
+	    failures == 0 ? "PASS" : "FAIL", failures);
+	return failures;
+}
+
+REGISTER_PLATFORM_TEST("Device queue tests", test_devq);
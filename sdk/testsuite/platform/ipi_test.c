@@ -7,11 +7,16 @@
  * SPDX-License-Identifier: Apache-2.0
  */
 
+#include <target_config.h>		/* For PLAT_MAX_HARTS */
 #include <platform/utils/utils.h>	/* For console output */
 #include <platform/riscv/csr.h>		/* For pause() */
 #include <platform/interfaces/ipi.h>	/* For ipi_self/send() */
+#include <platform/riscv/hart.h>	/* For hart_wakeup_with_addr() */
 #include <test_framework.h>		/* For test registration macros */
 
+#include <stdatomic.h>	/* For C11 atomics */
+#include <time.h>	/* For clock() */
+
 static int
 test_ipi(void)
 {
@@ -63,4 +68,138 @@ test_ipi(void)
 	return 0;
 }
 
-REGISTER_PLATFORM_TEST("IPI (Inter-Processor Interrupt) test", test_ipi);
\ No newline at end of file
+/* Wake up all idle harts back to back, each with its own arguments,
+ * they should all get theirs (each hart has its own mailbox) */
+static uint64_t mbox_test_args[PLAT_MAX_HARTS][2];
+static atomic_int mbox_test_done;
+
+static void __attribute__((noreturn))
+mbox_test_payload(uint64_t arg0, uint64_t arg1)
+{
+	struct hart_state *hs = hart_get_hstate_self();
+	mbox_test_args[hs->hart_idx][0] = arg0;
+	mbox_test_args[hs->hart_idx][1] = arg1;
+	atomic_fetch_add_explicit(&mbox_test_done, 1, memory_order_release);
+	hart_idle();
+}
+
+static int
+test_ipi_mailbox(void)
+{
+	ANN("\n---=== IPI Mailbox Test ===---\n");
+	struct hart_state *this_hs = hart_get_hstate_self();
+	int targets[PLAT_MAX_HARTS];
+	int num_targets = 0;
+	int failures = 0;
+
+	for (int i = 0; i < hart_get_count(); i++) {
+		struct hart_state *hs = hart_get_hstate_by_idx(i);
+		if (hs == this_hs || !hart_test_flags(hs, HS_FLAG_READY) ||
+		    hart_test_flags(hs, HS_FLAG_RUNNING) || hart_test_flags(hs, HS_FLAG_POOL))
+			continue;
+		hart_set_flags(hs, HS_FLAG_RUNNING);
+		targets[num_targets++] = i;
+	}
+	if (!num_targets) {
+		INF("No other harts available, skipping\n");
+		return 0;
+	}
+
+	atomic_store_explicit(&mbox_test_done, 0, memory_order_relaxed);
+	for (int i = 0; i < num_targets; i++)
+		hart_wakeup_with_addr(targets[i], (uintptr_t) mbox_test_payload,
+				      0x1000 + targets[i], 0x2000 + targets[i], 0);
+
+	clock_t start = clock();
+	while (atomic_load_explicit(&mbox_test_done, memory_order_acquire) < num_targets &&
+	       (clock() - start) < CLOCKS_PER_SEC)
+		pause();
+
+	for (int i = 0; i < num_targets; i++) {
+		const int idx = targets[i];
+		if (mbox_test_args[idx][0] != 0x1000 + idx ||
+		    mbox_test_args[idx][1] != 0x2000 + idx) {
+			ERR("Hart %i got args 0x%lx / 0x%lx\n", idx,
+			    mbox_test_args[idx][0], mbox_test_args[idx][1]);
+			failures++;
+		}
+	}
+
+	INF("=== IPI Mailbox Test Results: %s (%d failures) ===\n",
+	    failures == 0 ? "PASS" : "FAIL", failures);
+	return failures;
+}
+
+/* Have all idle harts call a function through a single multicast IPI
+ * (hart_call_mask() -> ipi_send_mask()), every one of them should get
+ * it, including the ones that only get it forwarded when fanning out
+ * (build with IPI_FANOUT=2 to test that). */
+#define MCAST_TEST_ROUNDS	16
+
+static atomic_uint_least64_t mcast_test_seen;
+
+static void
+mcast_test_call(uint64_t arg0, uint64_t arg1)
+{
+	atomic_fetch_or_explicit(&mcast_test_seen, HARTMASK(hart_get_hstate_self()->hart_idx),
+				 memory_order_release);
+}
+
+static int
+test_ipi_multicast(void)
+{
+	ANN("\n---=== IPI Multicast Test ===---\n");
+	struct hart_state *this_hs = hart_get_hstate_self();
+	hartmask_t targets = 0;
+	int failures = 0;
+
+	for (int i = 0; i < hart_get_count(); i++) {
+		struct hart_state *hs = hart_get_hstate_by_idx(i);
+		if (hs == this_hs || !hart_test_flags(hs, HS_FLAG_READY) ||
+		    hart_test_flags(hs, HS_FLAG_RUNNING) || hart_test_flags(hs, HS_FLAG_POOL))
+			continue;
+		targets |= HARTMASK(i);
+	}
+	if (!targets) {
+		INF("No other harts available, skipping\n");
+		return 0;
+	}
+	#if defined(PLAT_IPI_FANOUT) && (PLAT_IPI_FANOUT > 1)
+		INF("Sending to %i harts, fan-out %i\n", __builtin_popcountll(targets),
+		    PLAT_IPI_FANOUT);
+		if (__builtin_popcountll(targets) <= PLAT_IPI_FANOUT)
+			WRN("Not enough harts to fan out, testing direct multicast\n");
+	#else
+		INF("Sending to %i harts, no fan-out (build with IPI_FANOUT=2 for that)\n",
+		    __builtin_popcountll(targets));
+	#endif
+
+	for (int round = 0; round < MCAST_TEST_ROUNDS; round++) {
+		atomic_store_explicit(&mcast_test_seen, 0, memory_order_relaxed);
+		const hartmask_t sent = hart_call_mask(targets, mcast_test_call, 0, 0);
+		if (sent != targets) {
+			ERR("Round %i: could only post to 0x%lx of 0x%lx\n", round, sent, targets);
+			failures++;
+		}
+
+		clock_t start = clock();
+		while (atomic_load_explicit(&mcast_test_seen, memory_order_acquire) != sent &&
+		       (clock() - start) < CLOCKS_PER_SEC)
+			pause();
+
+		const hartmask_t seen = atomic_load_explicit(&mcast_test_seen, memory_order_acquire);
+		if (seen != sent) {
+			ERR("Round %i: sent to 0x%lx, received by 0x%lx\n", round, sent, seen);
+			failures++;
+			break;
+		}
+	}
+
+	INF("=== IPI Multicast Test Results: %s (%d failures) ===\n",
+	    failures == 0 ? "PASS" : "FAIL", failures);
+	return failures;
+}
+
+REGISTER_PLATFORM_TEST("IPI (Inter-Processor Interrupt) test", test_ipi);
+REGISTER_PLATFORM_TEST("IPI mailbox test", test_ipi_mailbox);
+REGISTER_PLATFORM_TEST("IPI multicast test", test_ipi_multicast);
\ No newline at end of file
@@ -0,0 +1,149 @@
+/*
+ * SPDX-FileType: SOURCE
+ *
+ * SPDX-FileCopyrightText: 2026 Nick Kossifidis <mick@ics.forth.gr>
+ * SPDX-FileCopyrightText: 2026 ICS/FORTH
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <target_config.h>		/* For PLAT_* constants */
+
+/* We need a detached source we can trigger from software */
+#if defined(PLAT_HAS_APLIC)
+
+#include <platform/utils/utils.h>	/* For console output */
+#include <platform/riscv/mmio.h>	/* For write32() */
+#include <platform/riscv/hart.h>	/* For hart_wakeup_with_addr() */
+#include <platform/interfaces/irq.h>	/* For irq_set_affinity/rebalance() */
+#include <test_framework.h>		/* For test registration macros */
+
+#include <stdatomic.h>	/* For C11 atomics */
+#include <stdint.h>	/* For typed integers */
+#include <errno.h>	/* For error codes */
+
+#define _REGBASE PLAT_APLIC_BASE
+#include <platform/utils/register.h>
+
+#define APLIC_SETIPNUM_LE	REG32(0x2000)
+
+/* Below the ones of aplic_test.c / irq_nested_test.c */
+#define AFFINITY_SOURCE_ID	(PLAT_NUM_IRQ_SOURCES - 4)
+
+#define AFFINITY_WAIT_LOOPS	1000000
+
+static atomic_int affinity_test_hart = -1;
+static atomic_int affinity_test_ready;
+
+static void
+irq_affinity_test_handler(uint16_t source)
+{
+	atomic_store_explicit(&affinity_test_hart, hart_get_hstate_self()->hart_idx,
+			      memory_order_release);
+}
+
+REGISTER_IRQ_SOURCE(irq_affinity_test, {
+	.source.wire_id = AFFINITY_SOURCE_ID,
+	.handler = irq_affinity_test_handler,
+	.target_hart = 0,
+	.priority = IRQ_PRIORITY_HIGH,
+	.flags = IRQ_TRIGGER_DETACHED,
+});
+
+/* Secondary harts only enable IPIs in hart_init */
+static void __attribute__((noreturn))
+irq_affinity_test_payload(uint64_t arg0, uint64_t arg1)
+{
+	(void) arg0;
+	(void) arg1;
+	hart_enable_intr(INTR_MACHINE_EXTERNAL);
+	atomic_store_explicit(&affinity_test_ready, 1, memory_order_release);
+	hart_idle();
+}
+
+/* Trigger the source and return the hart that handled it */
+static int
+irq_affinity_test_fire(void)
+{
+	atomic_store_explicit(&affinity_test_hart, -1, memory_order_relaxed);
+	write32(APLIC_SETIPNUM_LE, AFFINITY_SOURCE_ID);
+	for (int i = 0; i < AFFINITY_WAIT_LOOPS; i++) {
+		const int hart = atomic_load_explicit(&affinity_test_hart, memory_order_acquire);
+		if (hart >= 0)
+			return hart;
+		pause();
+	}
+	return -1;
+}
+
+static int
+test_irq_affinity(void)
+{
+	ANN("\n---=== IRQ Affinity Test ===---\n");
+	const uint16_t num_harts = hart_get_count();
+	int failures = 0;
+	int hart = 0;
+
+	if (num_harts < 2) {
+		INF("Need at least 2 harts, skipping\n");
+		return 0;
+	}
+
+	hart_enable_intr(INTR_MACHINE_EXTERNAL);
+	atomic_store_explicit(&affinity_test_ready, 0, memory_order_relaxed);
+	hart_wakeup_with_addr(1, (uintptr_t) irq_affinity_test_payload, 0, 0, 0);
+	while (!atomic_load_explicit(&affinity_test_ready, memory_order_acquire))
+		pause();
+
+	irq_source_enable(AFFINITY_SOURCE_ID);
+	hart = irq_affinity_test_fire();
+	INF("Handled by hart %i before moving it\n", hart);
+	if (hart != 0) {
+		ERR("Expected hart 0 (from the source's mapping)\n");
+		failures++;
+	}
+
+	/* Moving an enabled source */
+	if (irq_set_affinity(AFFINITY_SOURCE_ID, 1)) {
+		ERR("Couldn't move source %i to hart 1\n", AFFINITY_SOURCE_ID);
+		failures++;
+	} else {
+		hart = irq_affinity_test_fire();
+		INF("Handled by hart %i after moving it to hart 1\n", hart);
+		if (hart != 1) {
+			ERR("Expected hart 1\n");
+			failures++;
+		}
+	}
+
+	if (irq_set_affinity(AFFINITY_SOURCE_ID, num_harts) != -EINVAL) {
+		ERR("Out of range hart should be rejected\n");
+		failures++;
+	}
+
+	/* Moving it back while disabled, the next enable should pick it up */
+	irq_source_disable(AFFINITY_SOURCE_ID);
+	irq_set_affinity(AFFINITY_SOURCE_ID, 0);
+	irq_source_enable(AFFINITY_SOURCE_ID);
+	hart = irq_affinity_test_fire();
+	INF("Handled by hart %i after moving it back\n", hart);
+	if (hart != 0) {
+		ERR("Expected hart 0\n");
+		failures++;
+	}
+	irq_source_disable(AFFINITY_SOURCE_ID);
+
+	const int moved = irq_rebalance();
+	if (moved == -ENOTSUP)
+		INF("Built without IRQ_STATS, no rebalancer\n");
+	else
+		INF("Rebalancer moved %i sources\n", moved);
+
+	INF("=== IRQ Affinity Test Results: %s (%d failures) ===\n",
+	    failures == 0 ? "PASS" : "FAIL", failures);
+	return failures;
+}
+
+REGISTER_PLATFORM_TEST("IRQ affinity", test_irq_affinity);
+
+#endif /* PLAT_HAS_APLIC */
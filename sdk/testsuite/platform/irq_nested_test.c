@@ -0,0 +1,126 @@
+/*
+ * SPDX-FileType: SOURCE
+ *
+ * SPDX-FileCopyrightText: 2026 Nick Kossifidis <mick@ics.forth.gr>
+ * SPDX-FileCopyrightText: 2026 ICS/FORTH
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <target_config.h>		/* For PLAT_* constants */
+
+/* We need detached sources we can trigger from software */
+#if defined(PLAT_HAS_APLIC)
+
+#include <stdint.h>			/* For typed integers */
+#include <platform/utils/utils.h>	/* For console output */
+#include <platform/riscv/mmio.h>	/* For write32() */
+#include <platform/riscv/hart.h>	/* For hart interrupt control */
+#include <platform/interfaces/irq.h>	/* For irq_source_enable/disable() / irq_nested() */
+#include <test_framework.h>		/* For test registration macros */
+
+#define _REGBASE PLAT_APLIC_BASE
+#include <platform/utils/register.h>
+
+#define APLIC_SETIPNUM_LE	REG32(0x2000)
+
+/* Below the one aplic_test.c uses, on IMSIC the lower
+ * eiid is the higher priority one so it goes first. */
+#define NESTED_HIGH_SOURCE_ID	(PLAT_NUM_IRQ_SOURCES - 3)
+#define NESTED_LOW_SOURCE_ID	(PLAT_NUM_IRQ_SOURCES - 2)
+
+/* How long the low priority handler waits to get preempted */
+#define NESTED_WAIT_LOOPS	100000
+
+static volatile uint32_t high_runs = 0;
+static volatile uint32_t low_runs = 0;
+static volatile uint32_t preempted = 0;
+static volatile uint32_t not_nested = 0;
+
+static void
+irq_nested_high_handler(uint16_t source)
+{
+	high_runs++;
+}
+
+/* Trigger the high priority source from within the low
+ * priority handler, with IRQ_NESTED it should run before
+ * we return. */
+static void
+irq_nested_low_handler(uint16_t source)
+{
+	const uint32_t runs = high_runs;
+	low_runs++;
+	/* Else string.c would use the VPU in here */
+	if (!irq_nested())
+		not_nested++;
+	write32(APLIC_SETIPNUM_LE, NESTED_HIGH_SOURCE_ID);
+	for (int i = 0; i < NESTED_WAIT_LOOPS && high_runs == runs; i++)
+		pause();
+	if (high_runs != runs)
+		preempted++;
+}
+
+REGISTER_IRQ_SOURCE(irq_nested_high, {
+	.source.wire_id = NESTED_HIGH_SOURCE_ID,
+	.handler = irq_nested_high_handler,
+	.target_hart = 0,
+	.priority = IRQ_PRIORITY_HIGH,
+	.flags = IRQ_TRIGGER_DETACHED,
+});
+
+/* Medium instead of low, in direct mode ithreshold
+ * starts at the lowest priority (see irq_aplic.c) */
+REGISTER_IRQ_SOURCE(irq_nested_low, {
+	.source.wire_id = NESTED_LOW_SOURCE_ID,
+	.handler = irq_nested_low_handler,
+	.target_hart = 0,
+	.priority = IRQ_PRIORITY_MEDIUM,
+	.flags = IRQ_TRIGGER_DETACHED,
+});
+
+static int
+test_irq_nested(void)
+{
+	ANN("\n---=== Nested Interrupts Test ===---\n");
+	#if !defined(IRQ_NESTED)
+		INF("Built without IRQ_NESTED, skipping\n");
+		return 0;
+	#else
+		int failures = 0;
+
+		high_runs = low_runs = preempted = not_nested = 0;
+		hart_enable_intr(INTR_MACHINE_EXTERNAL);
+		irq_source_enable(NESTED_HIGH_SOURCE_ID);
+		irq_source_enable(NESTED_LOW_SOURCE_ID);
+
+		write32(APLIC_SETIPNUM_LE, NESTED_LOW_SOURCE_ID);
+		for (int i = 0; i < NESTED_WAIT_LOOPS && high_runs == 0; i++)
+			pause();
+
+		INF("low handler runs: %u, high handler runs: %u, preempted: %u\n",
+		    low_runs, high_runs, preempted);
+		if (low_runs != 1 || high_runs != 1) {
+			ERR("Interrupts didn't get delivered\n");
+			failures++;
+		} else if (!preempted) {
+			ERR("High priority source didn't preempt the low priority one\n");
+			failures++;
+		}
+		if (not_nested) {
+			ERR("Handler ran preemptible without irq_nested()\n");
+			failures++;
+		}
+
+		irq_source_disable(NESTED_LOW_SOURCE_ID);
+		irq_source_disable(NESTED_HIGH_SOURCE_ID);
+
+		INF("=== Nested Interrupts Test Results: %s (%d failures) ===\n",
+		    failures == 0 ? "PASS" : "FAIL", failures);
+		return failures;
+	#endif
+}
+
+REGISTER_PLATFORM_TEST("Nested interrupts", test_irq_nested);
+
+#endif /* PLAT_HAS_APLIC */
@@ -0,0 +1,81 @@
+/*
+ * SPDX-FileType: SOURCE
+ *
+ * SPDX-FileCopyrightText: 2026 Nick Kossifidis <mick@ics.forth.gr>
+ * SPDX-FileCopyrightText: 2026 ICS/FORTH
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <target_config.h>		/* For PLAT_* constants */
+#include <platform/utils/utils.h>	/* For console output */
+#include <platform/utils/irq_stats.h>	/* For irq_stats_get/reset/dump() */
+#include <platform/interfaces/timer.h>	/* For timer_nanosleep() */
+#include <platform/interfaces/ipi.h>	/* For ipi_self() */
+#include <platform/riscv/hart.h>	/* For hart_get_hstate_self() */
+#include <test_framework.h>		/* For test registration macros */
+#include <errno.h>			/* For error codes */
+
+#define IRQ_STATS_TEST_ROUNDS	16
+
+static uint32_t
+irq_stats_test_samples(const struct irq_hist *hist)
+{
+	uint32_t samples = 0;
+	for (int i = 0; i < IRQ_STAT_BUCKETS; i++)
+		samples += hist->count[i];
+	return samples;
+}
+
+/* Generate a few timer interrupts and IPIs on this hart, check
+ * that they got counted and print everything we have so far */
+static int
+test_irq_stats(void)
+{
+	ANN("\n---=== IRQ Latency / Duration Test ===---\n");
+	const uint16_t self = hart_get_hstate_self()->hart_idx;
+	struct irq_stats stats;
+	int failures = 0;
+
+	if (irq_stats_reset(self) == -ENOTSUP) {
+		INF("Built without IRQ_STATS, skipping\n");
+		return 0;
+	}
+
+	for (int i = 0; i < IRQ_STATS_TEST_ROUNDS; i++) {
+		#ifndef PLAT_NO_MTIMER
+			/* Long enough to go through the timer wheel */
+			timer_nanosleep(PLAT_TIMER_MTIMER, 2 * 1000 * 1000);
+		#endif
+		#ifndef PLAT_NO_IPI
+			ipi_self(IPI_WAKEUP);
+		#endif
+	}
+
+	#ifndef PLAT_NO_MTIMER
+		if (irq_stats_get(self, IRQ_STAT_TIMER, &stats) ||
+		    irq_stats_test_samples(&stats.duration) < IRQ_STATS_TEST_ROUNDS) {
+			ERR("Timer interrupts didn't get recorded\n");
+			failures++;
+		}
+	#endif
+	#ifndef PLAT_NO_IPI
+		if (irq_stats_get(self, IRQ_STAT_IPI, &stats) ||
+		    irq_stats_test_samples(&stats.duration) < IRQ_STATS_TEST_ROUNDS) {
+			ERR("IPIs didn't get recorded\n");
+			failures++;
+		}
+	#endif
+	if (irq_stats_get(self, IRQ_STAT_NUM_SOURCES, &stats) != -EINVAL) {
+		ERR("Out of range source should be rejected\n");
+		failures++;
+	}
+
+	irq_stats_dump();
+
+	INF("=== IRQ Latency / Duration Test Results: %s (%d failures) ===\n",
+	    failures == 0 ? "PASS" : "FAIL", failures);
+	return failures;
+}
+
+REGISTER_PLATFORM_TEST("IRQ latency / duration histograms", test_irq_stats);
@@ -0,0 +1,178 @@
+/*
+ * SPDX-FileType: SOURCE
+ *
+ * SPDX-FileCopyrightText: 2026 Nick Kossifidis <mick@ics.forth.gr>
+ * SPDX-FileCopyrightText: 2026 ICS/FORTH
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <target_config.h>		/* For PLAT_* constants */
+#include <platform/utils/utils.h>	/* For console output */
+#include <platform/riscv/mmio.h>	/* For write32() */
+#include <platform/riscv/hart.h>	/* For hart interrupt control */
+#include <platform/interfaces/irq.h>	/* For irq_work_queue/run() / irq_nested() */
+#include <test_framework.h>		/* For test registration macros */
+
+#include <stdint.h>	/* For typed integers */
+
+/* Works record the order they ran in */
+#define WORK_LOG_SIZE	8
+
+static uint32_t work_log[WORK_LOG_SIZE];
+static volatile uint32_t work_log_len = 0;
+
+static void
+irq_work_test_log(struct irq_work *work)
+{
+	if (work_log_len < WORK_LOG_SIZE)
+		work_log[work_log_len] = (uint32_t)(uintptr_t) work->arg;
+	work_log_len++;
+}
+
+/* Queues itself once more, from within its func */
+static void
+irq_work_test_requeue(struct irq_work *work)
+{
+	static int runs = 0;
+	irq_work_test_log(work);
+	if (++runs == 1)
+		irq_work_queue(work);
+}
+
+static struct irq_work work_a = IRQ_WORK_INIT(irq_work_test_log, (void *) 1);
+static struct irq_work work_b = IRQ_WORK_INIT(irq_work_test_log, (void *) 2);
+static struct irq_work work_c = IRQ_WORK_INIT(irq_work_test_requeue, (void *) 3);
+
+#if defined(PLAT_HAS_APLIC)
+#define _REGBASE PLAT_APLIC_BASE
+#include <platform/utils/register.h>
+
+#define APLIC_SETIPNUM_LE	REG32(0x2000)
+
+/* Below the ones of aplic_test.c / irq_nested_test.c / irq_affinity_test.c */
+#define WORK_SOURCE_ID		(PLAT_NUM_IRQ_SOURCES - 5)
+#define WORK_WAIT_LOOPS		1000000
+
+static volatile uint32_t top_half_done = 0;
+static volatile uint32_t bottom_half_runs = 0;
+static volatile uint32_t bottom_half_irqs_on = 0;
+static volatile uint32_t bottom_half_after_top = 0;
+static volatile uint32_t bottom_half_nested = 0;
+
+static void
+irq_work_test_bottom_half(struct irq_work *work)
+{
+	bottom_half_runs++;
+	if (csr_read(CSR_MSTATUS) & CSR_MSTATUS_MIE)
+		bottom_half_irqs_on++;
+	if (top_half_done)
+		bottom_half_after_top++;
+	/* Still inside the trap, so no VPU for string.c */
+	if (irq_nested())
+		bottom_half_nested++;
+}
+
+static struct irq_work work_irq = IRQ_WORK_INIT(irq_work_test_bottom_half, NULL);
+
+static void
+irq_work_test_handler(uint16_t source)
+{
+	top_half_done = 0;
+	irq_work_queue(&work_irq);
+	top_half_done = 1;
+}
+
+REGISTER_IRQ_SOURCE(irq_work_test, {
+	.source.wire_id = WORK_SOURCE_ID,
+	.handler = irq_work_test_handler,
+	.target_hart = 0,
+	.priority = IRQ_PRIORITY_HIGH,
+	.flags = IRQ_TRIGGER_DETACHED,
+});
+
+static int
+test_irq_work_from_irq(void)
+{
+	int failures = 0;
+
+	bottom_half_runs = bottom_half_irqs_on = bottom_half_after_top = 0;
+	bottom_half_nested = 0;
+	hart_enable_intr(INTR_MACHINE_EXTERNAL);
+	irq_source_enable(WORK_SOURCE_ID);
+
+	write32(APLIC_SETIPNUM_LE, WORK_SOURCE_ID);
+	for (int i = 0; i < WORK_WAIT_LOOPS && bottom_half_runs == 0; i++)
+		pause();
+
+	irq_source_disable(WORK_SOURCE_ID);
+
+	INF("Bottom half runs: %u, with interrupts on: %u, after the top half: %u\n",
+	    bottom_half_runs, bottom_half_irqs_on, bottom_half_after_top);
+	if (bottom_half_runs != 1) {
+		ERR("Bottom half didn't run once\n");
+		failures++;
+	}
+	if (bottom_half_irqs_on != bottom_half_runs) {
+		ERR("Bottom half ran with interrupts masked\n");
+		failures++;
+	}
+	if (bottom_half_after_top != bottom_half_runs) {
+		ERR("Bottom half ran before the top half returned\n");
+		failures++;
+	}
+	if (bottom_half_nested != bottom_half_runs) {
+		ERR("Bottom half ran inside the trap without irq_nested()\n");
+		failures++;
+	}
+	return failures;
+}
+#endif /* PLAT_HAS_APLIC */
+
+static int
+test_irq_work(void)
+{
+	ANN("\n---=== Deferred Work Test ===---\n");
+	static const uint32_t expected[] = { 1, 3, 2, 3 };
+	const uint32_t num_expected = sizeof(expected) / sizeof(expected[0]);
+	int failures = 0;
+
+	work_log_len = 0;
+	/* Keep traps from running them (on exit) before
+	 * we are done queueing, to check the order */
+	const bool irqs_on = csr_read(CSR_MSTATUS) & CSR_MSTATUS_MIE;
+	hart_block_interrupts();
+	irq_work_queue(&work_a);
+	irq_work_queue(&work_c);
+	if (irq_work_queue(&work_a)) {
+		ERR("Queued a pending work twice\n");
+		failures++;
+	}
+	irq_work_queue(&work_b);
+	if (irqs_on)
+		hart_allow_interrupts();
+	irq_work_run();
+
+	INF("Ran %u works\n", work_log_len);
+	if (work_log_len != num_expected) {
+		ERR("Expected %u works\n", num_expected);
+		failures++;
+	} else {
+		for (uint32_t i = 0; i < work_log_len; i++) {
+			if (work_log[i] != expected[i]) {
+				ERR("Work %u: got %u, expected %u\n", i, work_log[i], expected[i]);
+				failures++;
+			}
+		}
+	}
+
+	#if defined(PLAT_HAS_APLIC)
+		failures += test_irq_work_from_irq();
+	#endif
+
+	INF("=== Deferred Work Test Results: %s (%d failures) ===\n",
+	    failures == 0 ? "PASS" : "FAIL", failures);
+	return failures;
+}
+
+REGISTER_PLATFORM_TEST("Deferred work", test_irq_work);
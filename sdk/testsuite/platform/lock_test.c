@@ -0,0 +1,220 @@
+/*
+ * SPDX-FileType: SOURCE
+ *
+ * SPDX-FileCopyrightText: 2026 Nick Kossifidis <mick@ics.forth.gr>
+ * SPDX-FileCopyrightText: 2026 ICS/FORTH
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <target_config.h>		/* For PLAT_MAX_HARTS, before lock.h */
+#include <platform/utils/utils.h>	/* For console output */
+#include <platform/utils/lock.h>	/* For the lock API */
+#include <platform/riscv/hart.h>	/* For parallel_for() */
+#include <test_framework.h>		/* For test registration macros */
+
+#include <stdint.h>	/* For typed integers */
+
+/* Each item does LOCK_TEST_INCS non-atomic increments
+ * under the lock, spread over all harts */
+#define LOCK_TEST_ITEMS	64
+#define LOCK_TEST_INCS	100
+
+enum lock_test_type {
+	LOCK_TEST_SPIN,
+	LOCK_TEST_TICKET,
+	LOCK_TEST_MCS,
+	LOCK_TEST_SDK,
+};
+
+static struct {
+	enum lock_test_type type;
+	atomic_int spin;
+	struct ticket_lock ticket;
+	struct mcs_lock mcs;
+	sdk_lock_t sdk;
+	volatile unsigned long counter;
+} lock_test;
+
+static void
+lock_test_worker(void *ctx, size_t begin, size_t end)
+{
+	(void) ctx;
+	struct mcs_node node;
+
+	for (size_t i = begin; i < end; i++) {
+		for (int j = 0; j < LOCK_TEST_INCS; j++) {
+			switch (lock_test.type) {
+			case LOCK_TEST_SPIN:
+				lock_acquire(&lock_test.spin);
+				lock_test.counter++;
+				lock_release(&lock_test.spin);
+				break;
+			case LOCK_TEST_TICKET:
+				ticket_lock_acquire(&lock_test.ticket);
+				lock_test.counter++;
+				ticket_lock_release(&lock_test.ticket);
+				break;
+			case LOCK_TEST_MCS:
+				mcs_lock_acquire(&lock_test.mcs, &node);
+				lock_test.counter++;
+				mcs_lock_release(&lock_test.mcs, &node);
+				break;
+			case LOCK_TEST_SDK:
+				sdk_lock_acquire(&lock_test.sdk);
+				lock_test.counter++;
+				sdk_lock_release(&lock_test.sdk);
+				break;
+			}
+		}
+	}
+}
+
+/* Every LOCK_TEST_WR_EVERY-th item is a writer that bumps both words
+ * of the pair, the rest are readers that check they are still equal */
+#define LOCK_TEST_WR_EVERY	8
+
+static struct {
+	struct rwlock rw;
+	struct seqlock seq;
+	bool use_seqlock;
+	volatile unsigned long a;
+	volatile unsigned long b;
+	atomic_int torn;
+} rd_test;
+
+static void
+rd_test_worker(void *ctx, size_t begin, size_t end)
+{
+	(void) ctx;
+
+	for (size_t i = begin; i < end; i++) {
+		const bool writer = !(i % LOCK_TEST_WR_EVERY);
+		for (int j = 0; j < LOCK_TEST_INCS; j++) {
+			unsigned long a, b;
+			if (writer && rd_test.use_seqlock) {
+				seqlock_write_begin(&rd_test.seq);
+				rd_test.a++;
+				rd_test.b++;
+				seqlock_write_end(&rd_test.seq);
+				continue;
+			} else if (writer) {
+				rwlock_write_acquire(&rd_test.rw);
+				rd_test.a++;
+				rd_test.b++;
+				rwlock_write_release(&rd_test.rw);
+				continue;
+			}
+
+			if (rd_test.use_seqlock) {
+				unsigned int seq;
+				do {
+					seq = seqlock_read_begin(&rd_test.seq);
+					a = rd_test.a;
+					b = rd_test.b;
+				} while (seqlock_read_retry(&rd_test.seq, seq));
+			} else {
+				rwlock_read_acquire(&rd_test.rw);
+				a = rd_test.a;
+				b = rd_test.b;
+				rwlock_read_release(&rd_test.rw);
+			}
+			if (a != b)
+				atomic_fetch_add_explicit(&rd_test.torn, 1, memory_order_relaxed);
+		}
+	}
+}
+
+static int
+test_read_mostly(void)
+{
+	const unsigned long expected = (LOCK_TEST_ITEMS / LOCK_TEST_WR_EVERY) * LOCK_TEST_INCS;
+	int failures = 0;
+
+	for (int use_seqlock = 0; use_seqlock < 2; use_seqlock++) {
+		const char *name = use_seqlock ? "seqlock" : "rwlock";
+		rd_test.use_seqlock = use_seqlock;
+		rd_test.a = rd_test.b = 0;
+		atomic_store_explicit(&rd_test.torn, 0, memory_order_relaxed);
+		uint64_t cycles = hart_get_counter(HC_CYCLES);
+		int ret = parallel_for(0, LOCK_TEST_ITEMS, 1, rd_test_worker, NULL);
+		cycles = hart_get_counter(HC_CYCLES) - cycles;
+		INF("%s: %lu writes, rest reads, in %lu cycles\n", name, rd_test.a, cycles);
+		if (ret < 0) {
+			ERR("parallel_for failed: %i\n", ret);
+			failures++;
+			continue;
+		}
+		if (rd_test.a != expected || rd_test.b != expected) {
+			ERR("%s: expected %lu writes\n", name, expected);
+			failures++;
+		}
+		if (atomic_load_explicit(&rd_test.torn, memory_order_relaxed)) {
+			ERR("%s: %i readers saw a half-done write\n", name,
+			    atomic_load_explicit(&rd_test.torn, memory_order_relaxed));
+			failures++;
+		}
+	}
+
+	return failures;
+}
+
+static int
+test_locks(void)
+{
+	ANN("\n---=== Lock Test ===---\n");
+	static const char *names[] = { "spin-lock", "ticket lock", "MCS lock", "sdk_lock_t" };
+	const unsigned long expected = LOCK_TEST_ITEMS * LOCK_TEST_INCS;
+	struct mcs_node node;
+	int failures = 0;
+
+	INF("Running with %i harts\n", hart_get_count());
+
+	/* Uncontended try_acquire should succeed, and then fail */
+	struct ticket_lock ticket = TICKET_LOCK_INIT;
+	struct mcs_lock mcs = MCS_LOCK_INIT;
+	if (!ticket_lock_try_acquire(&ticket) || ticket_lock_try_acquire(&ticket)) {
+		ERR("ticket_lock_try_acquire misbehaves\n");
+		failures++;
+	}
+	ticket_lock_release(&ticket);
+	if (!ticket_lock_try_acquire(&ticket)) {
+		ERR("ticket_lock_try_acquire failed after release\n");
+		failures++;
+	}
+	if (!mcs_lock_try_acquire(&mcs, &node)) {
+		ERR("mcs_lock_try_acquire failed on a free lock\n");
+		failures++;
+	} else {
+		struct mcs_node other;
+		if (mcs_lock_try_acquire(&mcs, &other)) {
+			ERR("mcs_lock_try_acquire succeeded on a held lock\n");
+			failures++;
+		}
+		mcs_lock_release(&mcs, &node);
+	}
+
+	for (int type = LOCK_TEST_SPIN; type <= LOCK_TEST_SDK; type++) {
+		lock_test.type = (enum lock_test_type) type;
+		lock_test.counter = 0;
+		uint64_t cycles = hart_get_counter(HC_CYCLES);
+		int ret = parallel_for(0, LOCK_TEST_ITEMS, 1, lock_test_worker, NULL);
+		cycles = hart_get_counter(HC_CYCLES) - cycles;
+		INF("%s: %lu increments in %lu cycles\n", names[type], lock_test.counter, cycles);
+		if (ret < 0) {
+			ERR("parallel_for failed: %i\n", ret);
+			failures++;
+		} else if (lock_test.counter != expected) {
+			ERR("%s: expected %lu increments\n", names[type], expected);
+			failures++;
+		}
+	}
+
+	failures += test_read_mostly();
+
+	INF("=== Lock Test Results: %s (%d failures) ===\n",
+	    failures == 0 ? "PASS" : "FAIL", failures);
+	return failures;
+}
+
+REGISTER_PLATFORM_TEST("Spin / ticket / MCS / rw / seq lock test", test_locks);
@@ -0,0 +1,84 @@
+/*
+ * SPDX-FileType: SOURCE
+ *
+ * SPDX-FileCopyrightText: 2026 Nick Kossifidis <mick@ics.forth.gr>
+ * SPDX-FileCopyrightText: 2026 ICS/FORTH
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <platform/utils/utils.h>	/* For console output */
+#include <platform/riscv/hart.h>	/* For hart_get_hstate_self() */
+#include <platform/utils/log.h>		/* For the log API */
+#include <test_framework.h>		/* For test registration macros */
+
+#include <stdint.h>	/* For typed integers */
+#include <errno.h>	/* For ENODATA */
+
+static int
+test_log_rings(void)
+{
+	ANN("\n---=== Log Ring Test ===---\n");
+	int failures = 0;
+	uint16_t hart_idx = hart_get_hstate_self()->hart_idx;
+	struct log_stats before, after;
+
+	/* Already there with LOG_RINGS */
+	if (log_init_hart() < 0) {
+		INF("No log ring available, skipping\n");
+		return 0;
+	}
+	log_printf("Logging from hart %i\n", hart_idx);
+	log_drain();
+	if (log_get_stats(hart_idx, &before) < 0) {
+		INF("No log ring available, skipping\n");
+		return 0;
+	}
+
+	INF("Queueing a few messages\n");
+	log_get_stats(hart_idx, &before);
+	for (int i = 0; i < 4; i++)
+		log_printf("  queued message %i\n", i);
+	log_get_stats(hart_idx, &after);
+	if (after.msgs != before.msgs + 4 || after.used == 0) {
+		ERR("Messages didn't make it to the ring (msgs: %lu, used: %u)\n",
+		    after.msgs - before.msgs, after.used);
+		failures++;
+	}
+
+	INF("Draining\n");
+	int drained = log_drain();
+	log_get_stats(hart_idx, &after);
+	if (drained <= 0 || after.used != 0) {
+		ERR("log_drain didn't empty the ring (drained: %i, used: %u)\n",
+		    drained, after.used);
+		failures++;
+	}
+
+	INF("Overflowing the ring\n");
+	log_get_stats(hart_idx, &before);
+	for (int i = 0; i < (LOG_RING_SIZE / 16) + 1; i++)
+		log_printf("  overflow %04i .\n", i);
+	log_printf("  %0*i\n", LOG_MSG_MAX, 0);
+	log_get_stats(hart_idx, &after);
+	if (after.dropped == before.dropped || after.truncated == before.truncated) {
+		ERR("Dropped / truncated messages weren't counted\n");
+		failures++;
+	}
+	if (after.used > LOG_RING_SIZE) {
+		ERR("Ring overflowed (used: %u)\n", after.used);
+		failures++;
+	}
+	log_drain();
+
+	if (log_get_stats(0xFFFF, &after) != -EINVAL) {
+		ERR("log_get_stats accepted an invalid hart\n");
+		failures++;
+	}
+
+	INF("=== Log Ring Test Results: %s (%d failures) ===\n",
+	    failures == 0 ? "PASS" : "FAIL", failures);
+	return failures;
+}
+
+REGISTER_PLATFORM_TEST("Per-hart log ring test", test_log_rings);
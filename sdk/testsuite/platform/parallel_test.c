@@ -0,0 +1,290 @@
+/*
+ * SPDX-FileType: SOURCE
+ *
+ * SPDX-FileCopyrightText: 2026 Nick Kossifidis <mick@ics.forth.gr>
+ * SPDX-FileCopyrightText: 2026 ICS/FORTH
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <platform/utils/utils.h>	/* For console output */
+#include <platform/riscv/hart.h>	/* For memcpy/memset_parallel() */
+#include <test_framework.h>		/* For test registration macros */
+
+#include <stdint.h>	/* For typed integers */
+#include <stdlib.h>	/* For malloc/free */
+#include <stdatomic.h>	/* For C11 atomics */
+#include <errno.h>	/* For error codes */
+
+/* Large enough to go through the multi-hart path */
+#define PAR_TEST_LEN	(512 * 1024)
+
+static int
+test_parallel_mem(void)
+{
+	ANN("\n---=== Parallel memcpy/memset Test ===---\n");
+	int failures = 0;
+
+	INF("Running with %i harts\n", hart_get_count());
+
+	uint8_t *src = malloc(PAR_TEST_LEN + 16);
+	uint8_t *dst = malloc(PAR_TEST_LEN + 16);
+	if (!src || !dst) {
+		ERR("Could not allocate test buffers\n");
+		free(dst);
+		free(src);
+		return -1;
+	}
+
+	/* Unaligned on both sides, with guard bytes around dst */
+	for (size_t i = 0; i < PAR_TEST_LEN + 16; i++)
+		src[i] = (uint8_t)(i * 7 + (i >> 9));
+	dst[2] = 0xAA;
+	dst[PAR_TEST_LEN + 3] = 0xAA;
+
+	INF("memcpy_parallel: %u bytes, unaligned\n", PAR_TEST_LEN);
+	uint64_t cycles = hart_get_counter(HC_CYCLES);
+	void *ret = memcpy_parallel(dst + 3, src + 5, PAR_TEST_LEN);
+	cycles = hart_get_counter(HC_CYCLES) - cycles;
+	INF("  took %lu cycles\n", cycles);
+	if (ret != dst + 3) {
+		ERR("memcpy_parallel should return dst\n");
+		failures++;
+	}
+	for (size_t i = 0; i < PAR_TEST_LEN; i++) {
+		if (dst[3 + i] != src[5 + i]) {
+			ERR("memcpy_parallel mismatch at byte %lu\n", i);
+			failures++;
+			break;
+		}
+	}
+	if (dst[2] != 0xAA || dst[PAR_TEST_LEN + 3] != 0xAA) {
+		ERR("memcpy_parallel wrote outside its range\n");
+		failures++;
+	}
+
+	INF("memset_parallel: %u bytes, unaligned\n", PAR_TEST_LEN);
+	cycles = hart_get_counter(HC_CYCLES);
+	memset_parallel(dst + 3, 0x5C, PAR_TEST_LEN);
+	cycles = hart_get_counter(HC_CYCLES) - cycles;
+	INF("  took %lu cycles\n", cycles);
+	for (size_t i = 0; i < PAR_TEST_LEN; i++) {
+		if (dst[3 + i] != 0x5C) {
+			ERR("memset_parallel mismatch at byte %lu\n", i);
+			failures++;
+			break;
+		}
+	}
+	if (dst[2] != 0xAA || dst[PAR_TEST_LEN + 3] != 0xAA) {
+		ERR("memset_parallel wrote outside its range\n");
+		failures++;
+	}
+
+	/* Small sizes go through the serial path */
+	INF("memset_parallel: small buffer\n");
+	memset_parallel(dst, 0x11, 100);
+	for (size_t i = 0; i < 100; i++) {
+		if (dst[i] != 0x11) {
+			ERR("memset_parallel (small) mismatch at byte %lu\n", i);
+			failures++;
+			break;
+		}
+	}
+
+	free(dst);
+	free(src);
+
+	INF("=== Parallel Test Results: %s (%d failures) ===\n",
+	    failures == 0 ? "PASS" : "FAIL", failures);
+	return failures;
+}
+
+#define PFOR_TEST_LEN	10007
+
+struct pfor_test_ctx {
+	uint8_t *visits;
+	atomic_size_t chunks;
+	atomic_int harts_mask;
+};
+
+static void
+pfor_test_fn(void *ctx, size_t begin, size_t end)
+{
+	struct pfor_test_ctx *t = ctx;
+	for (size_t i = begin; i < end; i++)
+		t->visits[i]++;
+	atomic_fetch_add(&t->chunks, 1);
+	atomic_fetch_or(&t->harts_mask, 1 << hart_get_hstate_self()->hart_idx);
+}
+
+static atomic_int wq_test_runs;
+
+static void
+wq_test_fn(struct work_item *work)
+{
+	atomic_fetch_add(&wq_test_runs, (int)(uintptr_t) work->arg);
+}
+
+static int
+test_parallel_for(void)
+{
+	ANN("\n---=== Parallel-for / Work queue Test ===---\n");
+	int failures = 0;
+
+	uint8_t *visits = calloc(PFOR_TEST_LEN, 1);
+	if (!visits) {
+		ERR("Could not allocate test buffer\n");
+		return -1;
+	}
+
+	/* Each index must be visited exactly once, with the odd
+	 * length the last chunk is a partial one */
+	struct pfor_test_ctx ctx = { .visits = visits };
+	if (parallel_for(0, PFOR_TEST_LEN, 64, pfor_test_fn, &ctx) < 0) {
+		ERR("parallel_for failed\n");
+		failures++;
+	}
+	for (size_t i = 0; i < PFOR_TEST_LEN; i++) {
+		if (visits[i] != 1) {
+			ERR("Index %lu visited %u times\n", i, visits[i]);
+			failures++;
+			break;
+		}
+	}
+	INF("parallel_for: %lu chunks on harts 0x%x\n",
+	    atomic_load(&ctx.chunks), atomic_load(&ctx.harts_mask));
+	if (atomic_load(&ctx.chunks) != (PFOR_TEST_LEN + 63) / 64) {
+		ERR("Unexpected number of chunks\n");
+		failures++;
+	}
+
+	/* Sub-range with an automatic grain */
+	if (parallel_for(100, 200, 0, pfor_test_fn, &ctx) < 0 || visits[99] != 1 ||
+	    visits[100] != 2 || visits[199] != 2 || visits[200] != 1) {
+		ERR("parallel_for on a sub-range failed\n");
+		failures++;
+	}
+	if (parallel_for(10, 5, 1, pfor_test_fn, &ctx) != -EINVAL) {
+		ERR("parallel_for should reject empty ranges\n");
+		failures++;
+	}
+
+	struct work_item items[8] = { 0 };
+	atomic_store(&wq_test_runs, 0);
+	for (int i = 0; i < 8; i++) {
+		items[i].fn = wq_test_fn;
+		items[i].arg = (void*)(uintptr_t)(i + 1);
+		if (workqueue_submit(&items[i]) < 0) {
+			ERR("workqueue_submit failed\n");
+			failures++;
+		}
+	}
+	for (int i = 0; i < 8; i++)
+		workqueue_wait(&items[i]);
+	if (atomic_load(&wq_test_runs) != 36) {
+		ERR("Work items didn't all run exactly once (%i)\n",
+		    atomic_load(&wq_test_runs));
+		failures++;
+	}
+	if (workqueue_cancel(&items[0]) != -EINVAL) {
+		ERR("workqueue_cancel should fail on completed items\n");
+		failures++;
+	}
+
+	free(visits);
+
+	INF("=== Parallel-for Test Results: %s (%d failures) ===\n",
+	    failures == 0 ? "PASS" : "FAIL", failures);
+	return failures;
+}
+
+/* Recursive sum of [begin, end), splitting it in two tasks
+ * until it gets below TASK_TEST_CUTOFF */
+#define TASK_TEST_LEN		20000
+#define TASK_TEST_CUTOFF	64
+
+struct task_test_range {
+	const uint32_t *vals;
+	size_t begin;
+	size_t end;
+	uint64_t sum;
+};
+
+static atomic_int task_test_harts_mask;
+static atomic_int task_test_leaves;
+
+static void
+task_test_sum(struct work_item *work)
+{
+	struct task_test_range *r = work->arg;
+	if (r->end - r->begin <= TASK_TEST_CUTOFF) {
+		r->sum = 0;
+		for (size_t i = r->begin; i < r->end; i++)
+			r->sum += r->vals[i];
+		atomic_fetch_add(&task_test_leaves, 1);
+		atomic_fetch_or(&task_test_harts_mask, 1 << hart_get_hstate_self()->hart_idx);
+		return;
+	}
+
+	/* Spawn the left half, do the right one ourselves */
+	const size_t mid = r->begin + (r->end - r->begin) / 2;
+	struct task_test_range left = { .vals = r->vals, .begin = r->begin, .end = mid };
+	struct task_test_range right = { .vals = r->vals, .begin = mid, .end = r->end };
+	struct work_item left_work = { .fn = task_test_sum, .arg = &left };
+	struct work_item right_work = { .fn = task_test_sum, .arg = &right };
+	task_spawn(&left_work);
+	task_test_sum(&right_work);
+	task_wait(&left_work);
+	r->sum = left.sum + right.sum;
+}
+
+static int
+test_tasks(void)
+{
+	ANN("\n---=== Work-stealing Task Test ===---\n");
+	int failures = 0;
+
+	uint32_t *vals = malloc(TASK_TEST_LEN * sizeof(uint32_t));
+	if (!vals) {
+		ERR("Could not allocate test buffer\n");
+		return -1;
+	}
+	uint64_t expected = 0;
+	for (size_t i = 0; i < TASK_TEST_LEN; i++) {
+		vals[i] = (uint32_t)(i * 2654435761u) >> 8;
+		expected += vals[i];
+	}
+
+	atomic_store(&task_test_harts_mask, 0);
+	atomic_store(&task_test_leaves, 0);
+	struct task_test_range root = { .vals = vals, .begin = 0, .end = TASK_TEST_LEN };
+	struct work_item root_work = { .fn = task_test_sum, .arg = &root };
+	uint64_t cycles = hart_get_counter(HC_CYCLES);
+	if (task_spawn(&root_work) < 0) {
+		ERR("task_spawn failed\n");
+		failures++;
+	}
+	task_wait(&root_work);
+	cycles = hart_get_counter(HC_CYCLES) - cycles;
+
+	INF("%i leaf tasks on harts 0x%x, took %lu cycles\n", atomic_load(&task_test_leaves),
+	    atomic_load(&task_test_harts_mask), cycles);
+	if (root.sum != expected) {
+		ERR("Got sum %lu, expected %lu\n", root.sum, expected);
+		failures++;
+	}
+	if (task_spawn(NULL) != -EINVAL) {
+		ERR("task_spawn should reject NULL items\n");
+		failures++;
+	}
+
+	free(vals);
+
+	INF("=== Task Test Results: %s (%d failures) ===\n",
+	    failures == 0 ? "PASS" : "FAIL", failures);
+	return failures;
+}
+
+REGISTER_PLATFORM_TEST("Parallel memcpy/memset test", test_parallel_mem);
+REGISTER_PLATFORM_TEST("Parallel-for / work queue test", test_parallel_for);
+REGISTER_PLATFORM_TEST("Work-stealing task test", test_tasks);
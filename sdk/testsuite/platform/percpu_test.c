@@ -0,0 +1,109 @@
+/*
+ * SPDX-FileType: SOURCE
+ *
+ * SPDX-FileCopyrightText: 2026 Nick Kossifidis <mick@ics.forth.gr>
+ * SPDX-FileCopyrightText: 2026 ICS/FORTH
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <target_config.h>		/* For PLAT_MAX_HARTS */
+#include <platform/utils/utils.h>	/* For console output */
+#include <platform/utils/percpu.h>	/* For __percpu / this_cpu_ptr() */
+#include <platform/riscv/hart.h>	/* For hart_wakeup_with_addr() */
+#include <test_framework.h>		/* For test registration macros */
+
+#include <stdatomic.h>	/* For C11 atomics */
+#include <stdint.h>	/* For typed integers */
+#include <time.h>	/* For clock() */
+
+#define PERCPU_TEST_MAGIC	0x50E7C0DEUL
+
+static uint64_t percpu_test_val __percpu = PERCPU_TEST_MAGIC;
+static atomic_int percpu_test_done;
+
+static void __attribute__((noreturn))
+percpu_test_payload(uint64_t arg0, uint64_t arg1)
+{
+	(void) arg0;
+	(void) arg1;
+	uint64_t *val = this_cpu_ptr(&percpu_test_val);
+	/* Only touch our own copy if it got initialized */
+	if (*val == PERCPU_TEST_MAGIC)
+		*val = hart_get_hstate_self()->hart_idx;
+	atomic_fetch_add_explicit(&percpu_test_done, 1, memory_order_release);
+	hart_idle();
+}
+
+static int
+test_percpu(void)
+{
+	ANN("\n---=== Per-hart Data Test ===---\n");
+	struct hart_state *this_hs = hart_get_hstate_self();
+	const int num_harts = hart_get_count();
+	int failures = 0;
+
+	/* Each copy should be on its own cache lines */
+	for (int i = 0; i < num_harts; i++) {
+		uint64_t *val = per_cpu_ptr(&percpu_test_val, i);
+		if ((uintptr_t) val == (uintptr_t) &percpu_test_val) {
+			ERR("Hart %i uses the template instead of its copy\n", i);
+			failures++;
+		}
+		if (i > 0 && (uintptr_t) per_cpu_ptr(&percpu_test_val, i - 1) - (uintptr_t) val < 64) {
+			ERR("Copies of harts %i and %i share a cache line\n", i - 1, i);
+			failures++;
+		}
+	}
+	if (this_cpu_ptr(&percpu_test_val) != per_cpu_ptr(&percpu_test_val, this_hs->hart_idx)) {
+		ERR("this_cpu_ptr() doesn't match per_cpu_ptr() for this hart\n");
+		failures++;
+	}
+
+	if (*this_cpu_ptr(&percpu_test_val) != PERCPU_TEST_MAGIC) {
+		ERR("Per-hart copy not initialized from the template\n");
+		failures++;
+	}
+
+	/* Let the other harts write their index in their copies */
+	uint64_t expected = 0;
+	atomic_store_explicit(&percpu_test_done, 0, memory_order_relaxed);
+	for (int i = 0; i < num_harts; i++) {
+		struct hart_state *hs = hart_get_hstate_by_idx(i);
+		if (hs == this_hs)
+			continue;
+		if (!hart_test_flags(hs, HS_FLAG_READY) ||
+		    hart_test_flags(hs, HS_FLAG_RUNNING) || hart_test_flags(hs, HS_FLAG_POOL)) {
+			INF("Hart %i is not available, skipping\n", i);
+			continue;
+		}
+		hart_set_flags(hs, HS_FLAG_RUNNING);
+		hart_wakeup_with_addr(i, (uintptr_t) percpu_test_payload, 0, 0, 0);
+		expected |= 1ULL << i;
+	}
+
+	clock_t start = clock();
+	while (atomic_load_explicit(&percpu_test_done, memory_order_acquire) < __builtin_popcountll(expected) &&
+	       (clock() - start) < CLOCKS_PER_SEC)
+		pause();
+
+	for (int i = 0; i < num_harts; i++) {
+		if (!(expected & (1ULL << i)))
+			continue;
+		const uint64_t val = *per_cpu_ptr(&percpu_test_val, i);
+		if (val != (uint64_t) i) {
+			ERR("Copy of hart %i has 0x%lx\n", i, val);
+			failures++;
+		}
+	}
+	if (*this_cpu_ptr(&percpu_test_val) != PERCPU_TEST_MAGIC) {
+		ERR("Another hart wrote to our copy\n");
+		failures++;
+	}
+
+	INF("=== Per-hart Data Test Results: %s (%d failures) ===\n",
+	    failures == 0 ? "PASS" : "FAIL", failures);
+	return failures;
+}
+
+REGISTER_PLATFORM_TEST("Per-hart data test", test_percpu);
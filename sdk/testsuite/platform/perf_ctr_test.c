@@ -0,0 +1,136 @@
+/*
+ * SPDX-FileType: SOURCE
+ *
+ * SPDX-FileCopyrightText: 2026 Nick Kossifidis <mick@ics.forth.gr>
+ * SPDX-FileCopyrightText: 2026 ICS/FORTH
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <platform/utils/utils.h>	/* For console output */
+#include <platform/utils/perf.h>	/* For perf_ctr_*() */
+#include <test_framework.h>		/* For test registration macros */
+
+#include <stdint.h>	/* For typed integers */
+#include <stdlib.h>	/* For malloc() / free() */
+#include <errno.h>	/* For error codes */
+
+#define CTR_TEST_CALLS		8
+#define CTR_TEST_RUNS		4
+#define CTR_TEST_MAX_RECORDS	256
+
+static volatile uint64_t ctr_test_sink;
+
+static void __attribute__((noinline))
+ctr_test_leaf(int i)
+{
+	if (i & 1)
+		ctr_test_sink += i;
+	else
+		ctr_test_sink -= i;
+}
+
+static void __attribute__((noinline))
+ctr_test_region(void)
+{
+	for (int i = 0; i < CTR_TEST_CALLS; i++)
+		ctr_test_leaf(i);
+}
+
+static int
+test_perf_ctr(void)
+{
+	ANN("\n---=== Control Transfer Records Test ===---\n");
+	struct perf_ctr_record *ctr_test_recs = NULL;
+	struct perf_ctr_edges edges;
+	int failures = 0;
+	int ret = 0;
+
+	/* Up front, so that the allocator doesn't show up on the records */
+	ctr_test_recs = malloc(CTR_TEST_MAX_RECORDS * sizeof(struct perf_ctr_record));
+	if (!ctr_test_recs) {
+		ERR("Couldn't allocate the records\n");
+		return 1;
+	}
+
+	ret = perf_ctr_start(PERF_CTR_ALL);
+	if (ret == -ENOTSUP) {
+		INF("No Smctr, skipping\n");
+		INF("=== Control Transfer Records Test Results: PASS (0 failures) ===\n");
+		free(ctr_test_recs);
+		return 0;
+	} else if (ret) {
+		ERR("Couldn't start recording (%i)\n", ret);
+		free(ctr_test_recs);
+		return 1;
+	}
+	if (perf_ctr_start(PERF_CTR_ALL) != -EBUSY) {
+		ERR("Started recording twice\n");
+		failures++;
+	}
+	ctr_test_region();
+	perf_ctr_stop();
+
+	int num = perf_ctr_read(ctr_test_recs, CTR_TEST_MAX_RECORDS);
+	INF("CTR depth %u, got %i records\n", perf_ctr_depth(), num);
+	if (num <= 0) {
+		ERR("Nothing recorded (%i)\n", num);
+		free(ctr_test_recs);
+		return failures + 1;
+	}
+
+	/* The calls to the leaf should be there, unless the buffer is too
+	 * small to hold the whole region */
+	int calls = 0;
+	for (int i = 0; i < num; i++)
+		if (ctr_test_recs[i].type == PERF_CTR_TYPE_DIRCALL &&
+		    ctr_test_recs[i].target == (uintptr_t) ctr_test_leaf)
+			calls++;
+	if (calls == 0 || (perf_ctr_depth() >= 64 && calls != CTR_TEST_CALLS)) {
+		ERR("Recorded %i calls to the leaf, expected %u\n", calls, CTR_TEST_CALLS);
+		failures++;
+	}
+	perf_ctr_dump(ctr_test_recs, num < 16 ? num : 16);
+
+	/* Only calls / returns this time, no branches */
+	perf_ctr_start(PERF_CTR_CALLS);
+	ctr_test_region();
+	perf_ctr_stop();
+	num = perf_ctr_read(ctr_test_recs, CTR_TEST_MAX_RECORDS);
+	for (int i = 0; i < num; i++) {
+		if (ctr_test_recs[i].type == PERF_CTR_TYPE_TKBR) {
+			ERR("Recorded a branch with only calls enabled\n");
+			failures++;
+			break;
+		}
+	}
+
+	/* Aggregate a few runs, the hottest edges should show up on every one */
+	if ((ret = perf_ctr_edges_init(&edges, 256)) != 0) {
+		ERR("Couldn't allocate the edges table (%i)\n", ret);
+		free(ctr_test_recs);
+		return failures + 1;
+	}
+	for (int run = 0; run < CTR_TEST_RUNS; run++) {
+		perf_ctr_start(PERF_CTR_BRANCHES | PERF_CTR_CALLS);
+		ctr_test_region();
+		perf_ctr_stop();
+		num = perf_ctr_read(ctr_test_recs, CTR_TEST_MAX_RECORDS);
+		if (num > 0)
+			perf_ctr_edges_add(&edges, ctr_test_recs, num);
+	}
+	struct perf_ctr_edge top[1];
+	if (perf_ctr_edges_top(&edges, top, 1) != 1 || top[0].hits < CTR_TEST_RUNS) {
+		ERR("Hottest edge wasn't taken on every run\n");
+		failures++;
+	}
+	perf_ctr_edges_dump(&edges, 8);
+	perf_ctr_edges_free(&edges);
+	free(ctr_test_recs);
+
+	INF("=== Control Transfer Records Test Results: %s (%d failures) ===\n",
+	    failures == 0 ? "PASS" : "FAIL", failures);
+	return failures;
+}
+
+REGISTER_PLATFORM_TEST("Control transfer records (Smctr)", test_perf_ctr);
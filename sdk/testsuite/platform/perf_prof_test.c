@@ -0,0 +1,96 @@
+/*
+ * SPDX-FileType: SOURCE
+ *
+ * SPDX-FileCopyrightText: 2026 Nick Kossifidis <mick@ics.forth.gr>
+ * SPDX-FileCopyrightText: 2026 ICS/FORTH
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <target_config.h>		/* For PLAT_PERF_PROF_EVENT */
+#include <platform/utils/utils.h>	/* For console output */
+#include <platform/utils/perf.h>	/* For perf_prof_*() */
+#include <platform/riscv/hart.h>	/* For hart_get_hstate_self() */
+#include <test_framework.h>		/* For test registration macros */
+
+#include <stdint.h>	/* For typed integers */
+#include <errno.h>	/* For error codes */
+
+/* Sample every that many events, with QEMU's cycles
+ * event that's a few hundred samples for the loops below. */
+#define PROF_TEST_PERIOD	10000
+#define PROF_TEST_TOP		8
+
+static volatile uint64_t prof_test_sink;
+
+/* Most samples should land here... */
+static void __attribute__((noinline))
+prof_test_hot(void)
+{
+	for (int i = 0; i < 1000000; i++)
+		prof_test_sink += i * 3;
+}
+
+/* ...and fewer here */
+static void __attribute__((noinline))
+prof_test_cold(void)
+{
+	for (int i = 0; i < 100000; i++)
+		prof_test_sink ^= i;
+}
+
+static int
+test_perf_prof(void)
+{
+	ANN("\n---=== Sampling Profiler Test ===---\n");
+	const uint16_t hart_idx = hart_get_hstate_self()->hart_idx;
+	struct perf_prof_entry top[PROF_TEST_TOP];
+	int failures = 0;
+
+	/* Start from a clean table, in case it ran before */
+	perf_prof_reset(hart_idx);
+	int ret = perf_prof_start(NULL, PROF_TEST_PERIOD);
+	if (ret == -ENOTSUP || ret == -ENOENT) {
+		INF("No Sscofpmf / profiling event on this target, skipping\n");
+		return 0;
+	} else if (ret) {
+		ERR("Couldn't start the profiler (%i)\n", ret);
+		return 1;
+	}
+	if (perf_prof_start(NULL, PROF_TEST_PERIOD) != -EBUSY) {
+		ERR("Started the profiler twice on the same hart\n");
+		failures++;
+	}
+
+	prof_test_hot();
+	prof_test_cold();
+	perf_prof_stop();
+
+	perf_prof_dump(hart_idx, PROF_TEST_TOP);
+	const uint64_t samples = perf_prof_samples(hart_idx);
+	const int found = perf_prof_top(hart_idx, top, PROF_TEST_TOP);
+	if (samples == 0 || found <= 0) {
+		ERR("No samples recorded\n");
+		failures++;
+	}
+	for (int i = 1; i < found; i++) {
+		if (top[i].hits > top[i - 1].hits) {
+			ERR("Profile isn't sorted by hits\n");
+			failures++;
+			break;
+		}
+	}
+
+	/* Nothing should be recorded once stopped */
+	prof_test_cold();
+	if (perf_prof_samples(hart_idx) != samples) {
+		ERR("Got samples after stopping the profiler\n");
+		failures++;
+	}
+
+	INF("=== Sampling Profiler Test Results: %s (%d failures) ===\n",
+	    failures == 0 ? "PASS" : "FAIL", failures);
+	return failures;
+}
+
+REGISTER_PLATFORM_TEST("Sampling profiler", test_perf_prof);
@@ -0,0 +1,104 @@
+/*
+ * SPDX-FileType: SOURCE
+ *
+ * SPDX-FileCopyrightText: 2026 Nick Kossifidis <mick@ics.forth.gr>
+ * SPDX-FileCopyrightText: 2026 ICS/FORTH
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <target_config.h>		/* For PLAT_PERF_* */
+#include <platform/utils/utils.h>	/* For console output */
+#include <platform/utils/perf.h>	/* For perf_group_*() */
+#include <test_framework.h>		/* For test registration macros */
+
+#include <stdint.h>	/* For typed integers */
+#include <errno.h>	/* For error codes */
+
+#define PERF_TEST_LOOPS		10000
+
+static volatile uint64_t perf_test_sink;
+
+static void
+perf_test_loop(void)
+{
+	for (int i = 0; i < PERF_TEST_LOOPS; i++)
+		perf_test_sink += i;
+}
+
+static int
+test_perf(void)
+{
+	ANN("\n---=== Perf Counters Test ===---\n");
+	struct perf_group group;
+	uint64_t values[PERF_MAX_EVENTS];
+	int failures = 0;
+	int ret = 0;
+
+	if ((ret = perf_group_init(&group, "cycles,instret")) != 0) {
+		ERR("Couldn't set up a cycles / instret group (%i)\n", ret);
+		return 1;
+	}
+
+	/* Two runs on this hart should add up */
+	for (int run = 0; run < 2; run++) {
+		if ((ret = perf_group_start(&group)) != 0) {
+			ERR("Couldn't start the group (%i)\n", ret);
+			failures++;
+			break;
+		}
+		if (perf_group_start(&group) != -EBUSY) {
+			ERR("Started the group twice on the same hart\n");
+			failures++;
+		}
+		perf_test_loop();
+		perf_group_read(&group, values);
+		perf_group_stop(&group);
+	}
+	perf_group_totals(&group, values);
+	perf_group_print(&group);
+	if (values[1] < 2 * PERF_TEST_LOOPS) {
+		ERR("Expected at least %u instructions\n", 2 * PERF_TEST_LOOPS);
+		failures++;
+	}
+	if (values[0] == 0) {
+		ERR("No cycles counted\n");
+		failures++;
+	}
+	if (perf_group_stop(&group) != -EINVAL) {
+		ERR("Stopped a group that wasn't running\n");
+		failures++;
+	}
+
+	if (perf_group_init(&group, "cycles,no_such_event") != -ENOENT) {
+		ERR("Unknown event wasn't rejected\n");
+		failures++;
+	}
+
+	/* An event on the hpm counters, the target's first one if it has any */
+	#if defined(PLAT_PERF_EVENTS)
+		static const struct perf_event_desc events[] = { PLAT_PERF_EVENTS };
+		const struct perf_event_desc hpm_event = events[0];
+	#else
+		const struct perf_event_desc hpm_event = { "raw", 0 };
+	#endif
+	perf_group_init(&group, "cycles");
+	ret = perf_group_add_raw(&group, hpm_event.name, hpm_event.event);
+	if (ret == -ENOTSUP)
+		INF("No hpm counters, skipping\n");
+	else if (ret) {
+		ERR("Couldn't set up an hpm group (%i)\n", ret);
+		failures++;
+	} else {
+		perf_group_start(&group);
+		perf_test_loop();
+		perf_group_stop(&group);
+		perf_group_print(&group);
+	}
+
+	INF("=== Perf Counters Test Results: %s (%d failures) ===\n",
+	    failures == 0 ? "PASS" : "FAIL", failures);
+	return failures;
+}
+
+REGISTER_PLATFORM_TEST("Perf counters", test_perf);
@@ -0,0 +1,135 @@
+/*
+ * SPDX-FileType: SOURCE
+ *
+ * SPDX-FileCopyrightText: 2026 Nick Kossifidis <mick@ics.forth.gr>
+ * SPDX-FileCopyrightText: 2026 ICS/FORTH
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <platform/utils/utils.h>	/* For console output */
+#include <platform/riscv/hart.h>	/* For hart_wakeup_with_addr() */
+#include <platform/utils/pool.h>	/* For the pool API */
+#include <test_framework.h>		/* For test registration macros */
+
+#include <stdatomic.h>	/* For C11 atomics */
+#include <stdint.h>	/* For typed integers */
+
+#define POOL_TEST_OBJS		64
+#define POOL_TEST_OBJ_SIZE	40
+
+static void *pool_test_objs[POOL_TEST_OBJS];
+static atomic_int pool_test_freed;
+
+/* Runs on another hart and frees all objects allocated by the boot
+ * hart, so they should go back to its magazine's remote list */
+static void __attribute__((noreturn))
+pool_test_remote_free(uint64_t arg0, uint64_t arg1)
+{
+	struct pool *pool = (struct pool *)(uintptr_t) arg0;
+	(void) arg1;
+
+	for (int i = 0; i < POOL_TEST_OBJS; i++)
+		pool_free(pool, pool_test_objs[i]);
+	atomic_store_explicit(&pool_test_freed, 1, memory_order_release);
+	hart_idle();
+}
+
+static int
+pool_test_alloc_all(struct pool *pool)
+{
+	int failures = 0;
+
+	for (int i = 0; i < POOL_TEST_OBJS; i++) {
+		uint8_t *obj = pool_alloc(pool);
+		pool_test_objs[i] = obj;
+		if (!obj) {
+			ERR("pool_alloc failed at object %i\n", i);
+			return failures + 1;
+		}
+		if ((uintptr_t) obj & 15) {
+			ERR("pool_alloc returned unaligned object %p\n", obj);
+			failures++;
+		}
+		for (int j = 0; j < POOL_TEST_OBJ_SIZE; j++)
+			obj[j] = (uint8_t)(i + j);
+	}
+
+	/* No overlaps, everything should still be there */
+	for (int i = 0; i < POOL_TEST_OBJS; i++) {
+		uint8_t *obj = pool_test_objs[i];
+		for (int j = 0; j < POOL_TEST_OBJ_SIZE; j++) {
+			if (obj[j] != (uint8_t)(i + j)) {
+				ERR("Pool object %i got overwritten\n", i);
+				failures++;
+				break;
+			}
+		}
+	}
+
+	return failures;
+}
+
+static int
+test_pool(void)
+{
+	ANN("\n---=== Object Pool Test ===---\n");
+	int failures = 0;
+
+	struct pool *pool = pool_create(POOL_TEST_OBJ_SIZE, POOL_TEST_OBJS);
+	if (!pool) {
+		ERR("pool_create failed\n");
+		return -1;
+	}
+
+	INF("Allocating %u objects of %u bytes\n", POOL_TEST_OBJS, POOL_TEST_OBJ_SIZE);
+	failures += pool_test_alloc_all(pool);
+	if (pool_alloc(pool) != NULL) {
+		ERR("pool_alloc should fail once the pool is exhausted\n");
+		failures++;
+	}
+
+	INF("Freeing in a different order and re-allocating\n");
+	for (int i = 0; i < POOL_TEST_OBJS; i++)
+		pool_free(pool, pool_test_objs[(i * 5) % POOL_TEST_OBJS]);
+	failures += pool_test_alloc_all(pool);
+
+	/* Have another hart free them, we should get them all back */
+	int target = -1;
+	struct hart_state *this_hs = hart_get_hstate_self();
+	for (int i = 0; i < hart_get_count(); i++) {
+		struct hart_state *hs = hart_get_hstate_by_idx(i);
+		if (hs == this_hs || !hart_test_flags(hs, HS_FLAG_READY) ||
+		    hart_test_flags(hs, HS_FLAG_RUNNING) || hart_test_flags(hs, HS_FLAG_POOL))
+			continue;
+		target = i;
+		break;
+	}
+
+	if (target >= 0) {
+		INF("Freeing from hart %i\n", target);
+		atomic_store_explicit(&pool_test_freed, 0, memory_order_relaxed);
+		hart_set_flags(hart_get_hstate_by_idx(target), HS_FLAG_RUNNING);
+		hart_wakeup_with_addr(target, (uintptr_t) pool_test_remote_free,
+				      (uintptr_t) pool, 0, 0);
+		while (!atomic_load_explicit(&pool_test_freed, memory_order_acquire))
+			pause();
+		failures += pool_test_alloc_all(pool);
+	} else
+		INF("No other harts available, skipping remote free test\n");
+
+	for (int i = 0; i < POOL_TEST_OBJS; i++)
+		pool_free(pool, pool_test_objs[i]);
+	pool_destroy(pool);
+
+	if (pool_create(0, 1) != NULL || pool_create(1, 0) != NULL) {
+		ERR("pool_create accepted invalid arguments\n");
+		failures++;
+	}
+
+	INF("=== Object Pool Test Results: %s (%d failures) ===\n",
+	    failures == 0 ? "PASS" : "FAIL", failures);
+	return failures;
+}
+
+REGISTER_PLATFORM_TEST("Lock-free object pool test", test_pool);
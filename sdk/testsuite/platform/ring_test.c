@@ -0,0 +1,188 @@
+/*
+ * SPDX-FileType: SOURCE
+ *
+ * SPDX-FileCopyrightText: 2026 Nick Kossifidis <mick@ics.forth.gr>
+ * SPDX-FileCopyrightText: 2026 ICS/FORTH
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <target_config.h>		/* For PLAT_MAX_HARTS */
+#include <platform/utils/utils.h>	/* For console output */
+#include <platform/utils/ring.h>	/* For the ring API */
+#include <platform/riscv/hart.h>	/* For hart_wakeup_with_addr() */
+#include <test_framework.h>		/* For test registration macros */
+
+#include <stdatomic.h>	/* For C11 atomics */
+#include <stdint.h>	/* For typed integers */
+
+#define RING_TEST_SIZE		8
+#define RING_TEST_MSGS		2000
+
+/* Messages carry the producer's index and a sequence number,
+ * so that the consumer can check they arrive in order */
+#define RING_TEST_MSG(idx, seq)	((void *)(uintptr_t)(((uintptr_t)(idx) << 32) | (seq)))
+#define RING_TEST_IDX(msg)	((unsigned int)((uintptr_t)(msg) >> 32))
+#define RING_TEST_SEQ(msg)	((uint32_t)(uintptr_t)(msg))
+
+static struct ring *ring_test_ring;
+
+static int
+test_ring_single(void)
+{
+	void *objs[RING_TEST_SIZE + 2];
+	void *obj = NULL;
+	int failures = 0;
+
+	if (ring_create(6, RING_SPSC) != NULL) {
+		ERR("Ring with a non power of two size got created\n");
+		failures++;
+	}
+
+	struct ring *ring = ring_create(RING_TEST_SIZE, RING_SPSC);
+	if (!ring) {
+		ERR("Could not create ring\n");
+		return failures + 1;
+	}
+
+	if (ring_dequeue(ring, &obj) != -EAGAIN) {
+		ERR("Dequeue from an empty ring should fail\n");
+		failures++;
+	}
+
+	/* Only as many as fit should go in */
+	for (unsigned int i = 0; i < RING_TEST_SIZE + 2; i++)
+		objs[i] = RING_TEST_MSG(0, i);
+	if (ring_enqueue_burst(ring, objs, RING_TEST_SIZE + 2) != RING_TEST_SIZE ||
+	    ring_count(ring) != RING_TEST_SIZE) {
+		ERR("Burst enqueue should stop when the ring is full\n");
+		failures++;
+	}
+	if (ring_enqueue(ring, objs[0]) != -ENOBUFS) {
+		ERR("Enqueue on a full ring should fail\n");
+		failures++;
+	}
+
+	/* Make room for a few more, so that the indices wrap around */
+	if (ring_dequeue_burst(ring, objs, 3) != 3) {
+		ERR("Burst dequeue of 3 objects failed\n");
+		failures++;
+	}
+	for (unsigned int i = 0; i < 3; i++) {
+		if (ring_enqueue(ring, RING_TEST_MSG(0, RING_TEST_SIZE + i))) {
+			ERR("Enqueue after dequeue failed\n");
+			failures++;
+		}
+	}
+
+	unsigned int num = ring_dequeue_burst(ring, objs, RING_TEST_SIZE + 2);
+	if (num != RING_TEST_SIZE) {
+		ERR("Got %u objects back, expected %u\n", num, RING_TEST_SIZE);
+		failures++;
+	}
+	for (unsigned int i = 0; i < num; i++) {
+		if (RING_TEST_SEQ(objs[i]) != i + 3) {
+			ERR("Object %u out of order (%u)\n", i, RING_TEST_SEQ(objs[i]));
+			failures++;
+			break;
+		}
+	}
+	if (ring_count(ring)) {
+		ERR("Ring should be empty\n");
+		failures++;
+	}
+
+	ring_destroy(ring);
+	return failures;
+}
+
+static void __attribute__((noreturn))
+ring_test_producer(uint64_t arg0, uint64_t arg1)
+{
+	const unsigned int self = hart_get_hstate_self()->hart_idx;
+	(void) arg0;
+	(void) arg1;
+
+	for (uint32_t i = 0; i < RING_TEST_MSGS; i++) {
+		while (ring_enqueue(ring_test_ring, RING_TEST_MSG(self, i)))
+			pause();
+	}
+	hart_idle();
+}
+
+/* All other harts produce into a small MPSC ring, this one consumes
+ * waiting on wfi for the producers' kick */
+static int
+test_ring_mpsc(void)
+{
+	struct hart_state *this_hs = hart_get_hstate_self();
+	const int num_harts = hart_get_count();
+	uint32_t next_seq[PLAT_MAX_HARTS] = { 0 };
+	void *objs[RING_TEST_SIZE];
+	int failures = 0;
+
+	if (num_harts == 1) {
+		INF("Single hart, skipping MPSC test\n");
+		return 0;
+	}
+	for (int i = 0; i < num_harts; i++) {
+		struct hart_state *hs = hart_get_hstate_by_idx(i);
+		if (hs == this_hs)
+			continue;
+		if (!hart_test_flags(hs, HS_FLAG_READY) ||
+		    hart_test_flags(hs, HS_FLAG_RUNNING) || hart_test_flags(hs, HS_FLAG_POOL)) {
+			INF("Hart %i is not available, skipping MPSC test\n", i);
+			return 0;
+		}
+	}
+
+	ring_test_ring = ring_create(RING_TEST_SIZE, RING_MPSC);
+	if (!ring_test_ring) {
+		ERR("Could not create ring\n");
+		return 1;
+	}
+	ring_set_consumer(ring_test_ring, this_hs->hart_idx);
+
+	for (int i = 0; i < num_harts; i++) {
+		struct hart_state *hs = hart_get_hstate_by_idx(i);
+		if (hs == this_hs)
+			continue;
+		hart_set_flags(hs, HS_FLAG_RUNNING);
+		hart_wakeup_with_addr(i, (uintptr_t) ring_test_producer, 0, 0, 0);
+	}
+
+	INF("Passing %u messages from each of %i harts\n", RING_TEST_MSGS, num_harts - 1);
+	unsigned int remaining = (num_harts - 1) * RING_TEST_MSGS;
+	while (remaining) {
+		ring_wait(ring_test_ring);
+		unsigned int num = ring_dequeue_burst(ring_test_ring, objs, RING_TEST_SIZE);
+		for (unsigned int i = 0; i < num; i++) {
+			const unsigned int idx = RING_TEST_IDX(objs[i]);
+			if (idx >= (unsigned int) num_harts || RING_TEST_SEQ(objs[i]) != next_seq[idx]) {
+				ERR("Unexpected message %u from hart %u\n",
+				    RING_TEST_SEQ(objs[i]), idx);
+				failures++;
+				continue;
+			}
+			next_seq[idx]++;
+		}
+		remaining -= num;
+	}
+
+	ring_destroy(ring_test_ring);
+	return failures;
+}
+
+static int
+test_ring(void)
+{
+	ANN("\n---=== Ring Queue Test ===---\n");
+	int failures = test_ring_single();
+	failures += test_ring_mpsc();
+
+	INF("=== Ring Queue Test Results: %s (%d failures) ===\n",
+	    failures == 0 ? "PASS" : "FAIL", failures);
+	return failures;
+}
+
+REGISTER_PLATFORM_TEST("Ring queue test", test_ring);
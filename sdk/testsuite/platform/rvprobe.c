@@ -9,7 +9,7 @@
 
 #include <platform/riscv/hart.h>	/* For hart_state */
 #include <platform/riscv/caps.h>	/* For CAP_* macros */
-#include <platform/utils/utils.h>	/* For ANN/INF */
+#include <platform/utils/utils.h>	/* For ANN/INF / __cold */
 #include <test_framework.h>		/* For test registration macros */
 
 #include <stdint.h>			/* For typed ints */
@@ -82,7 +82,8 @@ static const struct cap_to_str misa_ext_names[] = {
 /* U-mode extensions */
 static const struct cap_to_str u_ext_names[] = {
 	{CAP_ZICNTR, "Zicntr (base counters)"},
-	{CAP_ZIHPM, "Zihpm (HPM counters)"}
+	{CAP_ZIHPM, "Zihpm (HPM counters)"},
+	{CAP_ZICNTR_TIME, "time CSR (M-mode)"}
 };
 
 /* Z* (common) capabilities */
@@ -91,7 +92,10 @@ static const struct cap_to_str_64 z_cap_names[] = {
 	{CAP_ZICFISS, "Zicfiss (shadow stack)"},
 	{CAP_ZICBOM, "Zicbom (cache block management)"},
 	{CAP_ZICBOZ, "Zicboz (cache block zero)"},
-	{CAP_ZKR, "Zkr (entropy source)"}
+	{CAP_ZKR, "Zkr (entropy source)"},
+	{CAP_ZAWRS, "Zawrs (wait on reservation set)"},
+	{CAP_ZBKC, "Zbkc (carry-less multiply)"},
+	{CAP_ZBC, "Zbc (carry-less multiply, full)"}
 };
 
 static void
@@ -171,7 +175,7 @@ print_big_endian_support(struct rvcaps *caps)
 		INF("  None\n");
 }
 
-static int
+static int __cold
 print_caps(void)
 {
 	struct rvcaps caps = {0};
@@ -223,6 +227,10 @@ print_caps(void)
 		uint16_t vlen = vlenb * 8;
 		INF("Vector Length (VLEN): %u bits (%u bytes)\n", vlen, vlenb);
 	}
+	if (caps.cboz_block_shift > 0)
+		INF("Zicboz block size: %u bytes\n", 1U << caps.cboz_block_shift);
+	if (caps.cbom_block_shift > 0)
+		INF("Zicbom block size: %u bytes\n", 1U << caps.cbom_block_shift);
 
 	INF("\nPress a key to continue...\n");
 	return 0;
@@ -8,10 +8,13 @@
  */
 
 #include <platform/utils/utils.h>	/* For console output */
+#include <platform/interfaces/timer.h>	/* For timer_add/cancel() */
+#include <platform/riscv/csr.h>		/* For wfi() */
 #include <test_framework.h>		/* For test registration macros */
 
 #include <time.h>	/* For struct timespec, CLOCK_*, nanosleep etc */
 #include <limits.h>	/* For LONG_MAX */
+#include <errno.h>	/* For error codes */
 
 /* Nanoseconds per second constant */
 #define NSEC_PER_SEC 1000000000L
@@ -36,7 +39,7 @@ timespecsub(struct timespec *a, struct timespec *b, struct timespec *res)
 	 * overlaps with a or b (in-place operation).
 	 */
 	sec_diff = a->tv_sec - b->tv_sec;
-	nsec_diff = a->tv_nsec - b->tv_nsec;
+	nsec_diff = (long) a->tv_nsec - (long) b->tv_nsec;
 
 	/*
 	 * Handle nanosecond underflow.
@@ -67,11 +70,175 @@ timespecsub(struct timespec *a, struct timespec *b, struct timespec *res)
 		res->tv_sec += res->tv_nsec / NSEC_PER_SEC;
 		res->tv_nsec = res->tv_nsec % NSEC_PER_SEC;
 	}
-	/* Handle potential negative results consistently */
-	else if (res->tv_nsec < 0 && res->tv_sec > 0) {
-		res->tv_sec--;
-		res->tv_nsec += NSEC_PER_SEC;
+}
+
+static int
+test_timer_monotonic(void)
+{
+	ANN("\n---=== Timer Monotonicity Test ===---\n");
+	struct timespec ts = {0};
+	long prev_ns = 0;
+	int failures = 0;
+
+	/* Clocks are free-running, reading them back to
+	 * back must never go backwards (or reset) */
+	INF("Reading CLOCK_MONOTONIC 100000 times\n");
+	for (int i = 0; i < 100000; i++) {
+		clock_gettime(CLOCK_MONOTONIC, &ts);
+		long now_ns = ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
+		if (now_ns < prev_ns) {
+			failures++;
+			if (failures <= 3)
+				INF("  [FAIL] Iteration %d: went back by %ldns\n",
+				    i, prev_ns - now_ns);
+		}
+		prev_ns = now_ns;
+	}
+
+	INF("=== Timer monotonicity test: %s (%d failures) ===\n",
+	    failures == 0 ? "PASS" : "FAIL", failures);
+	return failures;
+}
+
+#define TW_TEST_EVENTS	6
+
+static const uint64_t tw_test_delays_ms[TW_TEST_EVENTS] = { 30, 1, 120, 5, 60, 2 };
+static uint64_t tw_test_fired_ns[TW_TEST_EVENTS];
+static volatile int tw_test_fired;
+static volatile int tw_test_ticks;
+
+static void
+tw_test_handler(struct timer_event *ev)
+{
+	tw_test_fired_ns[(uintptr_t) ev->arg] = timer_get_nsecs(PLAT_TIMER_MTIMER);
+	tw_test_fired++;
+}
+
+static void
+tw_test_periodic(struct timer_event *ev)
+{
+	if (++tw_test_ticks == 10)
+		timer_cancel(ev);
+}
+
+static int
+test_timer_wheel(void)
+{
+	ANN("\n---=== Timer Wheel Test ===---\n");
+	struct timer_event evs[TW_TEST_EVENTS] = {0};
+	struct timer_event cancelled = { .handler = tw_test_handler, .arg = (void*) 0 };
+	struct timer_event periodic = { .handler = tw_test_periodic };
+	int failures = 0;
+
+	tw_test_fired = 0;
+	tw_test_ticks = 0;
+	const uint64_t start_ns = timer_get_nsecs(PLAT_TIMER_MTIMER);
+	for (int i = 0; i < TW_TEST_EVENTS; i++) {
+		evs[i].handler = tw_test_handler;
+		evs[i].arg = (void*)(uintptr_t) i;
+		if (timer_add(&evs[i], tw_test_delays_ms[i] * 1000000, 0) < 0) {
+			ERR("timer_add failed\n");
+			return 1;
+		}
+	}
+	if (timer_add(&evs[0], 1000000, 0) != -EBUSY) {
+		ERR("timer_add should reject pending events\n");
+		failures++;
+	}
+	timer_add(&cancelled, 10 * 1000000, 0);
+	timer_add(&periodic, 3 * 1000000, 3 * 1000000);
+	if (timer_cancel(&cancelled) != 0 || timer_pending(&cancelled)) {
+		ERR("timer_cancel failed\n");
+		failures++;
 	}
+
+	INF("Waiting for %i events (and a periodic one)\n", TW_TEST_EVENTS);
+	while (tw_test_fired < TW_TEST_EVENTS || tw_test_ticks < 10)
+		wfi();
+
+	for (int i = 0; i < TW_TEST_EVENTS; i++) {
+		const uint64_t delay_ns = tw_test_fired_ns[i] - start_ns;
+		const uint64_t want_ns = tw_test_delays_ms[i] * 1000000;
+		INF("  %lums event fired after %.3fms\n", tw_test_delays_ms[i],
+		    delay_ns / 1000000.0);
+		/* Never early, and not much later either */
+		if (delay_ns < want_ns || delay_ns > want_ns + 5 * 1000000) {
+			ERR("  event %i out of range\n", i);
+			failures++;
+		}
+	}
+	if (timer_pending(&periodic) || timer_cancel(&periodic) != -EINVAL) {
+		ERR("Periodic event still pending after timer_cancel\n");
+		failures++;
+	}
+
+	INF("=== Timer wheel test: %s (%d failures) ===\n",
+	    failures == 0 ? "PASS" : "FAIL", failures);
+	return failures;
+}
+
+/* Each hart calibrates its cycle counter against mtime during boot,
+ * so both clocks should agree on how long a (busy) wait took. */
+static int
+test_timer_cycles(void)
+{
+	ANN("\n---=== Cycle Counter Calibration Test ===---\n");
+	int failures = 0;
+
+	for (int i = 0; i < 5; i++) {
+		uint64_t start_mtime = timer_get_nsecs(PLAT_TIMER_MTIMER);
+		uint64_t start_cycles = timer_get_nsecs(PLAT_TIMER_CYCLES);
+		while (timer_get_nsecs(PLAT_TIMER_MTIMER) - start_mtime < 20 * 1000 * 1000)
+			;
+		uint64_t mtime_ns = timer_get_nsecs(PLAT_TIMER_MTIMER) - start_mtime;
+		uint64_t cycles_ns = timer_get_nsecs(PLAT_TIMER_CYCLES) - start_cycles;
+		uint64_t diff = (cycles_ns > mtime_ns) ? cycles_ns - mtime_ns : mtime_ns - cycles_ns;
+		/* Allow 1% */
+		if (diff * 100 > mtime_ns) {
+			failures++;
+			INF("  [FAIL] Round %d: %luns on mtime, %luns on the cycle counter\n",
+			    i, mtime_ns, cycles_ns);
+		}
+	}
+
+	INF("=== Cycle counter calibration test: %s (%d failures) ===\n",
+	    failures == 0 ? "PASS" : "FAIL", failures);
+	return failures;
+}
+
+/* Short delays either spin or wake up early and spin for the rest,
+ * so they should never return early, and only overshoot by about
+ * the clock's resolution (plus the time it takes to read it). */
+static const uint64_t short_test_delays_ns[] = { 500, 2000, 10000, 50000, 200000 };
+
+static int
+test_timer_short(void)
+{
+	ANN("\n---=== Timer Short Delay Test ===---\n");
+	const long res = timer_get_resolution(PLAT_TIMER_MTIMER)->tv_nsec;
+	int failures = 0;
+
+	for (unsigned int d = 0; d < sizeof(short_test_delays_ns) / sizeof(short_test_delays_ns[0]); d++) {
+		const uint64_t delay = short_test_delays_ns[d];
+		uint64_t total = 0;
+		for (int i = 0; i < 20; i++) {
+			uint64_t start = timer_get_nsecs(PLAT_TIMER_MTIMER);
+			timer_nanosleep(PLAT_TIMER_MTIMER, delay);
+			uint64_t elapsed = timer_get_nsecs(PLAT_TIMER_MTIMER) - start;
+			if (elapsed + res < delay) {
+				failures++;
+				if (failures <= 3)
+					INF("  [FAIL] %luns delay returned after %luns\n",
+					    delay, elapsed);
+			}
+			total += elapsed;
+		}
+		INF("  %luns delay: %luns on average\n", delay, total / 20);
+	}
+
+	INF("=== Timer short delay test: %s (%d failures) ===\n",
+	    failures == 0 ? "PASS" : "FAIL", failures);
+	return failures;
 }
 
 static int
@@ -144,4 +311,8 @@ test_timer(void)
 	return ret;
 }
 
+REGISTER_PLATFORM_TEST("Timer monotonicity test", test_timer_monotonic);
+REGISTER_PLATFORM_TEST("Timer wheel test", test_timer_wheel);
+REGISTER_PLATFORM_TEST("Cycle counter calibration test", test_timer_cycles);
+REGISTER_PLATFORM_TEST("Timer short delay test", test_timer_short);
 REGISTER_PLATFORM_TEST("Timer nanosleep test", test_timer);
\ No newline at end of file
@@ -0,0 +1,91 @@
+/*
+ * SPDX-FileType: SOURCE
+ *
+ * SPDX-FileCopyrightText: 2026 Nick Kossifidis <mick@ics.forth.gr>
+ * SPDX-FileCopyrightText: 2026 ICS/FORTH
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <target_config.h>		/* For PLAT_* constants */
+#include <platform/utils/utils.h>	/* For console output */
+#include <platform/utils/trap_trace.h>	/* For trap_trace_read/reset/dump() */
+#include <platform/interfaces/timer.h>	/* For timer_nanosleep() */
+#include <platform/interfaces/ipi.h>	/* For ipi_self() */
+#include <platform/riscv/hart.h>	/* For hart_get_hstate_self() */
+#include <test_framework.h>		/* For test registration macros */
+#include <stdlib.h>			/* For malloc() / free() */
+#include <errno.h>			/* For error codes */
+
+#define TRAP_TRACE_TEST_ROUNDS	8
+
+/* Generate a few timer interrupts and IPIs on this hart, check that
+ * they got recorded in order and print the timeline of all harts */
+static int
+test_trap_trace(void)
+{
+	ANN("\n---=== Trap Trace Test ===---\n");
+	const uint16_t self = hart_get_hstate_self()->hart_idx;
+	struct trap_trace_rec *trap_trace_test_recs = NULL;
+	int timers = 0, ipis = 0, sends = 0;
+	int failures = 0;
+
+	if (trap_trace_reset() == -ENOTSUP) {
+		INF("Built without TRAP_TRACE, skipping\n");
+		return 0;
+	}
+
+	trap_trace_test_recs = malloc(TRAP_TRACE_ENTRIES * sizeof(struct trap_trace_rec));
+	if (!trap_trace_test_recs) {
+		ERR("Couldn't allocate the records\n");
+		return 1;
+	}
+
+	for (int i = 0; i < TRAP_TRACE_TEST_ROUNDS; i++) {
+		#ifndef PLAT_NO_MTIMER
+			timer_nanosleep(PLAT_TIMER_MTIMER, 1000 * 1000);
+		#endif
+		#ifndef PLAT_NO_IPI
+			ipi_self(IPI_WAKEUP);
+		#endif
+	}
+
+	const int num = trap_trace_read(self, trap_trace_test_recs, TRAP_TRACE_ENTRIES);
+	for (int i = 0; i < num; i++) {
+		const struct trap_trace_rec *rec = &trap_trace_test_recs[i];
+		if (i && rec->time < trap_trace_test_recs[i - 1].time) {
+			ERR("Record %i went back in time\n", i);
+			failures++;
+		}
+		if (rec->hart_idx != self) {
+			ERR("Record %i has hart %u\n", i, rec->hart_idx);
+			failures++;
+		}
+		timers += (rec->event == TRAP_TRACE_TIMER);
+		ipis += (rec->event == TRAP_TRACE_IPI);
+		sends += (rec->event == TRAP_TRACE_IPI_SEND);
+	}
+	INF("Got %i records, %i timer interrupts, %i IPIs, %i sent\n", num, timers, ipis, sends);
+	free(trap_trace_test_recs);
+
+	#ifndef PLAT_NO_MTIMER
+		if (timers < TRAP_TRACE_TEST_ROUNDS) {
+			ERR("Timer interrupts didn't get recorded\n");
+			failures++;
+		}
+	#endif
+	#ifndef PLAT_NO_IPI
+		if (ipis < TRAP_TRACE_TEST_ROUNDS || sends < TRAP_TRACE_TEST_ROUNDS) {
+			ERR("IPIs didn't get recorded\n");
+			failures++;
+		}
+	#endif
+
+	trap_trace_dump(64);
+
+	INF("=== Trap Trace Test Results: %s (%d failures) ===\n",
+	    failures == 0 ? "PASS" : "FAIL", failures);
+	return failures;
+}
+
+REGISTER_PLATFORM_TEST("Trap trace timeline (all harts)", test_trap_trace);
@@ -7,7 +7,7 @@
  * SPDX-License-Identifier: Apache-2.0
  */
 
-#include <target_config.h>		/* For PLAT_UART_IRQ */
+#include <target_config.h>		/* For PLAT_UART_IRQ / PLAT_VIRTIO_CONSOLE_* */
 #include <platform/utils/utils.h>	/* For console output */
 #include <platform/interfaces/uart.h>	/* For uart_enable_irq() */
 #include <platform/riscv/csr.h>		/* For wfi() */
@@ -17,6 +17,15 @@
 
 #include <stdio.h>			/* For putchar/getchar */
 #include <stdint.h>			/* For typed ints */
+#include <stdbool.h>			/* For bool */
+#include <errno.h>			/* For EAGAIN */
+
+/* The console may be a virtio console instead (see virtio_console.c) */
+#if defined(PLAT_VIRTIO_CONSOLE_BASE) && (PLAT_VIRTIO_CONSOLE_BASE > 0)
+	#define UART_TEST_IRQ	PLAT_VIRTIO_CONSOLE_IRQ
+#else
+	#define UART_TEST_IRQ	PLAT_UART_IRQ
+#endif
 
 static int
 uart_loopback_poll(void)
@@ -58,20 +67,77 @@ uart_loopback_irq(void)
 	INF("Press Q to exit...\n");
 	uart_set_irq_handler(&uart_irq_test_handler);
 	hart_enable_intr(INTR_MACHINE_EXTERNAL);
-	irq_source_enable(PLAT_UART_IRQ);
+	irq_source_enable(UART_TEST_IRQ);
 	uart_enable_irq();
+	/* The handler signals us by clearing RUNNING, put it back
+	 * when done since the rest of the tests rely on it */
 	struct hart_state *hs = hart_get_hstate_self();
+	const bool was_running = hart_test_flags(hs, HS_FLAG_RUNNING);
 	hart_set_flags(hs, HS_FLAG_RUNNING);
 	while(hart_test_flags(hs, HS_FLAG_RUNNING)) {
 		wfi();
 	}
 	uart_disable_irq();
-	irq_source_disable(PLAT_UART_IRQ);
+	irq_source_disable(UART_TEST_IRQ);
 	hart_disable_intr(INTR_MACHINE_EXTERNAL);
+	if (was_running)
+		hart_set_flags(hs, HS_FLAG_RUNNING);
 
 	INF("Press a key to continue...\n");
 	return 0;
 }
 
+static int
+uart_buffered_write(void)
+{
+	ANN("\n---=== UART Buffered Write Test ===---\n");
+	static const char line[] = "................................................................\n";
+	int failures = 0;
+	int queued = 0;
+	int ret = 0;
+
+	/* With interrupts off only uart_write itself moves data
+	 * to the FIFO, so the ring should fill up and push back
+	 * with a short write (or -EAGAIN) */
+	INF("Filling up the Tx ring\n");
+	uart_flush();
+	bool short_write = false;
+	for (int i = 0; i < 64 && !short_write; i++) {
+		ret = uart_write(line, sizeof(line) - 1);
+		if (ret == -EAGAIN || (ret >= 0 && ret < (int) sizeof(line) - 1))
+			short_write = true;
+		if (ret > 0)
+			queued += ret;
+	}
+	uart_flush();
+	/* The virtio console frees its buffers as soon as
+	 * QEMU is done with them, so it may never push back */
+	#if !(defined(PLAT_VIRTIO_CONSOLE_BASE) && (PLAT_VIRTIO_CONSOLE_BASE > 0))
+	if (!short_write || queued <= 0) {
+		ERR("\nuart_write didn't push back on a full ring (last: %i, queued: %i)\n", ret, queued);
+		failures++;
+	}
+	#endif
+
+	INF("\nWriting with the THRE interrupt\n");
+	hart_enable_intr(INTR_MACHINE_EXTERNAL);
+	irq_source_enable(UART_TEST_IRQ);
+	uart_enable_irq();
+	ret = uart_write(line, sizeof(line) - 1);
+	if (ret != sizeof(line) - 1) {
+		ERR("uart_write failed on an empty ring (%i)\n", ret);
+		failures++;
+	}
+	uart_flush();
+	uart_disable_irq();
+	irq_source_disable(UART_TEST_IRQ);
+	hart_disable_intr(INTR_MACHINE_EXTERNAL);
+
+	INF("=== UART Buffered Write Test Results: %s (%d failures) ===\n",
+	    failures == 0 ? "PASS" : "FAIL", failures);
+	return failures;
+}
+
+REGISTER_PLATFORM_TEST("UART buffered write test", uart_buffered_write);
 REGISTER_PLATFORM_TEST("UART loopback test (polling mode)", uart_loopback_poll);
 REGISTER_PLATFORM_TEST("UART loopback test (IRQ mode)", uart_loopback_irq);
\ No newline at end of file
@@ -0,0 +1,224 @@
+/*
+ * SPDX-FileType: SOURCE
+ *
+ * SPDX-FileCopyrightText: 2026 Nick Kossifidis <mick@ics.forth.gr>
+ * SPDX-FileCopyrightText: 2026 ICS/FORTH
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <platform/utils/utils.h>	/* For console output */
+#include <platform/riscv/csr.h>	/* For csr_read() */
+#include <platform/riscv/hart.h>	/* For hart_va_*() */
+#include <test_framework.h>		/* For test registration macros */
+
+#include <stdint.h>	/* For typed integers */
+#include <errno.h>	/* For error codes */
+
+/* We only build the tables and walk them in software, without loading
+ * them on satp, so the physical addresses don't need to be backed. */
+#define VA_TEST_SZ_4K		0x1000UL
+#define VA_TEST_SZ_2M		0x200000UL
+#define VA_TEST_SZ_1G		0x40000000UL
+
+struct va_test_case {
+	uintptr_t va;
+	uintptr_t pa;		/* Expected translation */
+	size_t leaf_size;	/* Expected leaf */
+};
+
+static int
+va_test_check(const struct va_test_case *tc, int num)
+{
+	int failures = 0;
+	for (int i = 0; i < num; i++) {
+		uintptr_t pa = 0;
+		size_t leaf_size = 0;
+		int ret = hart_va_translate(tc[i].va, &pa, &leaf_size);
+		if (ret || pa != tc[i].pa || leaf_size != tc[i].leaf_size) {
+			ERR("VA 0x%lx: got PA 0x%lx / leaf 0x%lx (%i), expected 0x%lx / 0x%lx\n",
+			    tc[i].va, pa, leaf_size, ret, tc[i].pa, tc[i].leaf_size);
+			failures++;
+		}
+	}
+	return failures;
+}
+
+/* Two spaces with the same VA mapped differently, they should get their
+ * own ASIDs (unless the hart has none) and not see each other's mappings */
+static int
+test_va_spaces(void)
+{
+	const uintptr_t va = 0x10000000UL;
+	const uintptr_t pa_a = 0x80000000UL;
+	const uintptr_t pa_b = 0x90000000UL;
+	int failures = 0;
+	uintptr_t pa = 0;
+
+	struct va_space *vs_a = hart_va_space_create(SATP_MODE_SV39);
+	struct va_space *vs_b = hart_va_space_create(SATP_MODE_SV39);
+	if (vs_a == NULL || vs_b == NULL) {
+		ERR("Couldn't create address spaces\n");
+		hart_va_space_destroy(vs_a);
+		hart_va_space_destroy(vs_b);
+		return 1;
+	}
+
+	const uint16_t asid_a = hart_va_space_asid(vs_a);
+	const uint16_t asid_b = hart_va_space_asid(vs_b);
+	INF("Address spaces got ASIDs %u / %u\n", asid_a, asid_b);
+	if (asid_a && asid_a == asid_b) {
+		ERR("Two spaces share ASID %u\n", asid_a);
+		failures++;
+	}
+
+	hart_va_space_map(vs_a, va, pa_a, VA_TEST_SZ_4K, VA_MAP_RW);
+	hart_va_space_map(vs_b, va, pa_b, VA_TEST_SZ_4K, VA_MAP_RW);
+	if (hart_va_space_translate(vs_a, va, &pa, NULL) || pa != pa_a) {
+		ERR("Space A: VA 0x%lx -> 0x%lx, expected 0x%lx\n", va, pa, pa_a);
+		failures++;
+	}
+	if (hart_va_space_translate(vs_b, va, &pa, NULL) || pa != pa_b) {
+		ERR("Space B: VA 0x%lx -> 0x%lx, expected 0x%lx\n", va, pa, pa_b);
+		failures++;
+	}
+
+	/* Unmapping while active goes through the targeted flush, we are
+	 * in M-mode so loading satp doesn't affect us. */
+	int ret = hart_va_space_activate(vs_a);
+	if (ret && ret != -ENOTSUP) {
+		ERR("Couldn't activate space A (%i)\n", ret);
+		failures++;
+	}
+	if (hart_va_space_unmap(vs_a, va, VA_TEST_SZ_4K) ||
+	    hart_va_space_translate(vs_a, va, &pa, NULL) != -ENOENT) {
+		ERR("Unmapping from the active space failed\n");
+		failures++;
+	}
+	if (hart_va_space_translate(vs_b, va, &pa, NULL) || pa != pa_b) {
+		ERR("Unmapping from space A affected space B\n");
+		failures++;
+	}
+
+	/* Destroying the active space switches us to Bare mode */
+	if (hart_va_space_destroy(vs_a) != 0) {
+		ERR("Couldn't destroy space A\n");
+		failures++;
+	}
+	if (csr_read(CSR_SATP) != 0) {
+		ERR("Still translating after destroying the active space\n");
+		failures++;
+	}
+
+	/* Its ASID should be free for the next one */
+	struct va_space *vs_c = hart_va_space_create(SATP_MODE_SV39);
+	if (vs_c && asid_a && hart_va_space_asid(vs_c) != asid_a) {
+		ERR("ASID %u wasn't reused (got %u)\n", asid_a, hart_va_space_asid(vs_c));
+		failures++;
+	}
+	hart_va_space_destroy(vs_c);
+	hart_va_space_destroy(vs_b);
+	return failures;
+}
+
+static int
+test_va(void)
+{
+	ANN("\n---=== VA Mapper Test ===---\n");
+	int failures = 0;
+	int ret = 0;
+
+	ret = hart_va_init(SATP_MODE_SV39);
+	if (ret) {
+		ERR("Couldn't create Sv39 tables (%i)\n", ret);
+		return 1;
+	}
+
+	/* A 1GB + 2MB + 4KB range with everything aligned should take
+	 * one leaf of each, a 2MB aligned but 4KB offset PA only 4KB
+	 * leaves, and a range in the upper half should work as well. */
+	const uintptr_t va_big = 0x40000000UL;
+	const uintptr_t pa_big = 0x80000000UL;
+	const size_t big_size = VA_TEST_SZ_1G + VA_TEST_SZ_2M + VA_TEST_SZ_4K;
+	const uintptr_t va_small = 0x200000UL;
+	const uintptr_t pa_small = 0x90001000UL;
+	const uintptr_t va_high = 0xFFFFFFC000000000UL;
+
+	if ((ret = hart_va_map(va_big, pa_big, big_size, VA_MAP_RW)) != 0) {
+		ERR("Mapping the big range failed (%i)\n", ret);
+		failures++;
+	}
+	if ((ret = hart_va_map(va_small, pa_small, VA_TEST_SZ_2M, VA_MAP_RWX)) != 0) {
+		ERR("Mapping the small range failed (%i)\n", ret);
+		failures++;
+	}
+	if ((ret = hart_va_map(va_high, pa_big, VA_TEST_SZ_2M, VA_MAP_R | VA_MAP_G)) != 0) {
+		ERR("Mapping the upper half range failed (%i)\n", ret);
+		failures++;
+	}
+
+	const struct va_test_case cases[] = {
+		{ va_big + 0x1234, pa_big + 0x1234, VA_TEST_SZ_1G },
+		{ va_big + VA_TEST_SZ_1G + 0x10, pa_big + VA_TEST_SZ_1G + 0x10, VA_TEST_SZ_2M },
+		{ va_big + VA_TEST_SZ_1G + VA_TEST_SZ_2M, pa_big + VA_TEST_SZ_1G + VA_TEST_SZ_2M, VA_TEST_SZ_4K },
+		{ va_small + 0x5008, pa_small + 0x5008, VA_TEST_SZ_4K },
+		{ va_high + 0x100, pa_big + 0x100, VA_TEST_SZ_2M },
+	};
+	failures += va_test_check(cases, sizeof(cases) / sizeof(cases[0]));
+	INF("Page tables in use: %lu\n", hart_va_num_tables());
+
+	/* Overlaps and non-canonical VAs should be rejected */
+	if (hart_va_map(va_small + VA_TEST_SZ_4K, pa_small, VA_TEST_SZ_4K, VA_MAP_RW) != -EEXIST) {
+		ERR("Overlapping mapping wasn't rejected\n");
+		failures++;
+	}
+	if (hart_va_map(0x0000004000000000UL, pa_big, VA_TEST_SZ_4K, VA_MAP_RW) != -EFAULT) {
+		ERR("Non-canonical VA wasn't rejected\n");
+		failures++;
+	}
+
+	/* Memory type overrides need Svpbmt */
+	ret = hart_va_map(va_small + VA_TEST_SZ_2M, pa_small, VA_TEST_SZ_4K, VA_MAP_RW | VA_MAP_IO);
+	if (ret == -ENOTSUP)
+		INF("No Svpbmt, I/O mapping rejected\n");
+	else if (ret) {
+		ERR("I/O mapping failed (%i)\n", ret);
+		failures++;
+	} else
+		hart_va_unmap(va_small + VA_TEST_SZ_2M, VA_TEST_SZ_4K);
+
+	/* Can't unmap half a superpage, but the whole of it is fine */
+	if (hart_va_unmap(va_big, VA_TEST_SZ_2M) != -EINVAL) {
+		ERR("Partial unmap of a gigapage wasn't rejected\n");
+		failures++;
+	}
+	if ((ret = hart_va_unmap(va_small, VA_TEST_SZ_2M)) != 0) {
+		ERR("Unmapping the small range failed (%i)\n", ret);
+		failures++;
+	}
+	uintptr_t pa = 0;
+	if (hart_va_translate(va_small, &pa, NULL) != -ENOENT) {
+		ERR("Unmapped VA still translates to 0x%lx\n", pa);
+		failures++;
+	}
+	hart_va_unmap(va_big, big_size);
+	hart_va_unmap(va_high, VA_TEST_SZ_2M);
+	if (hart_va_num_tables() != 1) {
+		ERR("%lu page tables left after unmapping everything\n", hart_va_num_tables());
+		failures++;
+	}
+
+	hart_va_destroy();
+	if (hart_va_num_tables() != 0) {
+		ERR("Page tables leaked\n");
+		failures++;
+	}
+
+	failures += test_va_spaces();
+
+	INF("=== VA Mapper Test Results: %s (%d failures) ===\n",
+	    failures == 0 ? "PASS" : "FAIL", failures);
+	return failures;
+}
+
+REGISTER_PLATFORM_TEST("VA mapper (page tables / superpages / ASIDs) test", test_va);
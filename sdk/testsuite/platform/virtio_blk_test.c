@@ -0,0 +1,168 @@
+/*
+ * SPDX-FileType: SOURCE
+ *
+ * SPDX-FileCopyrightText: 2026 Nick Kossifidis <mick@ics.forth.gr>
+ * SPDX-FileCopyrightText: 2026 ICS/FORTH
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <target_config.h>		/* For PLAT_VIRTIO_BLK_BASE_ADDR */
+#include <platform/utils/utils.h>	/* For console output */
+#include <platform/interfaces/blk.h>	/* For blk_*() */
+#include <platform/interfaces/irq.h>	/* For irq_source_enable/disable() */
+#include <platform/riscv/hart.h>	/* For hart_enable/disable_intr() */
+#include <platform/riscv/csr.h>		/* For pause() */
+#include <test_framework.h>		/* For test registration macros */
+
+#include <stdint.h>	/* For typed integers */
+#include <string.h>	/* For memcmp */
+#include <malloc.h>	/* For page_alloc/free() */
+#include <errno.h>	/* For error codes */
+
+#if defined(PLAT_VIRTIO_BLK_BASE_ADDR) && (PLAT_VIRTIO_BLK_BASE_ADDR > 0)
+
+/*
+ * Read-only, so that it's safe to run on any image: read the start of
+ * the disk once with blk_read(), and again in small chunks through a pair
+ * of buffers that are re-submitted from the completion callback (the way
+ * a dataset would be streamed in), and compare.
+ */
+
+#define BLK_TEST_CHUNK		(4 * BLK_SECTOR_SIZE)
+#define BLK_TEST_PAGES		4
+#define BLK_TEST_LEN		(BLK_TEST_PAGES * PAGE_FRAME_SIZE)
+
+static struct {
+	struct blk_req reqs[2];
+	uint8_t *bufs[2];
+	const uint8_t *ref;
+	uint64_t next_sector;
+	uint64_t end_sector;
+	unsigned int chunks;
+	unsigned int mismatches;
+	unsigned int errors;
+} blk_stream;
+
+static void
+blk_test_done(struct blk_req *req)
+{
+	const uint64_t offt = req->sector * BLK_SECTOR_SIZE;
+	if (req->status < 0)
+		blk_stream.errors++;
+	else if (memcmp(req->buf, blk_stream.ref + offt, req->len))
+		blk_stream.mismatches++;
+	blk_stream.chunks++;
+
+	/* "Consumed", refill the buffer with the next chunk */
+	if (blk_stream.next_sector >= blk_stream.end_sector)
+		return;
+	req->sector = blk_stream.next_sector;
+	blk_stream.next_sector += BLK_TEST_CHUNK / BLK_SECTOR_SIZE;
+	if (blk_submit(req) < 0)
+		blk_stream.errors++;
+}
+
+static int
+test_virtio_blk(void)
+{
+	ANN("\n---=== Virtio-blk Test ===---\n");
+	int failures = 0;
+	struct blk_info info = { 0 };
+
+	int ret = blk_init();
+	if (ret == -ENODEV) {
+		WRN("No virtio-blk device (run with VIRTIO_BLK=<image>), skipping\n");
+		return 0;
+	} else if (ret < 0) {
+		ERR("blk_init failed: %i\n", ret);
+		return 1;
+	}
+	blk_get_info(&info);
+	INF("Capacity: %lu sectors, block size: %u, max in flight: %u\n",
+	    info.num_sectors, info.block_size, info.max_inflight);
+	if (info.num_sectors * BLK_SECTOR_SIZE < BLK_TEST_LEN) {
+		WRN("Image too small, skipping\n");
+		return 0;
+	}
+
+	struct blk_req bad = { .op = BLK_OP_READ, .buf = &info, .len = 3 };
+	if (blk_submit(&bad) != -EINVAL) {
+		ERR("blk_submit should reject unaligned lengths\n");
+		failures++;
+	}
+	bad.len = BLK_SECTOR_SIZE;
+	bad.sector = info.num_sectors;
+	if (blk_submit(&bad) != -EINVAL) {
+		ERR("blk_submit should reject requests past the end\n");
+		failures++;
+	}
+
+	uint8_t *ref = page_alloc(BLK_TEST_PAGES, 0);
+	uint8_t *bufs = page_alloc(2 * BLK_TEST_CHUNK / PAGE_FRAME_SIZE, 0);
+	if (!ref || !bufs) {
+		ERR("Could not allocate test buffers\n");
+		failures++;
+		goto done;
+	}
+	if ((ret = blk_read(0, ref, BLK_TEST_LEN)) < 0) {
+		ERR("blk_read failed: %i\n", ret);
+		failures++;
+		goto done;
+	}
+
+	memset(&blk_stream, 0, sizeof(blk_stream));
+	blk_stream.ref = ref;
+	blk_stream.end_sector = BLK_TEST_LEN / BLK_SECTOR_SIZE;
+	for (int i = 0; i < 2; i++) {
+		struct blk_req *req = &blk_stream.reqs[i];
+		blk_stream.bufs[i] = bufs + i * BLK_TEST_CHUNK;
+		req->op = BLK_OP_READ;
+		req->buf = blk_stream.bufs[i];
+		req->len = BLK_TEST_CHUNK;
+		req->done = blk_test_done;
+		req->sector = blk_stream.next_sector;
+		blk_stream.next_sector += BLK_TEST_CHUNK / BLK_SECTOR_SIZE;
+		if (blk_submit(req) < 0)
+			blk_stream.errors++;
+	}
+
+	/* Completions (and re-submissions) happen in the interrupt
+	 * handler, or here through blk_poll() without interrupts */
+	const unsigned int total = BLK_TEST_LEN / BLK_TEST_CHUNK;
+#ifndef PLAT_NO_IRQ
+	hart_enable_intr(INTR_MACHINE_EXTERNAL);
+	irq_source_enable(PLAT_VIRTIO_BLK_IRQ);
+	blk_enable_irq();
+#endif
+	while (blk_stream.chunks + blk_stream.errors < total) {
+#ifdef PLAT_NO_IRQ
+		blk_poll();
+#endif
+		pause();
+	}
+#ifndef PLAT_NO_IRQ
+	blk_disable_irq();
+	irq_source_disable(PLAT_VIRTIO_BLK_IRQ);
+	hart_disable_intr(INTR_MACHINE_EXTERNAL);
+#endif
+
+	if (blk_stream.errors || blk_stream.mismatches) {
+		ERR("Streaming read: %u errors, %u mismatching chunks\n",
+		    blk_stream.errors, blk_stream.mismatches);
+		failures++;
+	}
+
+ done:
+	if (ref)
+		page_free(ref, BLK_TEST_PAGES);
+	if (bufs)
+		page_free(bufs, 2 * BLK_TEST_CHUNK / PAGE_FRAME_SIZE);
+	INF("=== Virtio-blk Test Results: %s (%d failures) ===\n",
+	    failures == 0 ? "PASS" : "FAIL", failures);
+	return failures;
+}
+
+REGISTER_PLATFORM_TEST("Virtio-blk streaming read test", test_virtio_blk);
+
+#endif /* defined(PLAT_VIRTIO_BLK_BASE_ADDR) && (PLAT_VIRTIO_BLK_BASE_ADDR > 0) */
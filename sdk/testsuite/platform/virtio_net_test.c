@@ -0,0 +1,124 @@
+/*
+ * SPDX-FileType: SOURCE
+ *
+ * SPDX-FileCopyrightText: 2026 Nick Kossifidis <mick@ics.forth.gr>
+ * SPDX-FileCopyrightText: 2026 ICS/FORTH
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <target_config.h>		/* For PLAT_VIRTIO_NET_BASE_ADDR */
+#include <platform/utils/utils.h>	/* For console output */
+#include <platform/interfaces/net.h>	/* For net_*() */
+#include <test_framework.h>		/* For test registration macros */
+
+#include <stdint.h>	/* For typed integers */
+#include <stdbool.h>	/* For bool */
+#include <string.h>	/* For memcpy/memcmp */
+#include <time.h>	/* For clock() */
+#include <errno.h>	/* For error codes */
+
+#if defined(PLAT_VIRTIO_NET_BASE_ADDR) && (PLAT_VIRTIO_NET_BASE_ADDR > 0)
+
+/* QEMU's user mode networking (-netdev user): we are 10.0.2.15
+ * and the gateway at 10.0.2.2 answers ARP requests. */
+static const uint8_t net_test_ip[4] = { 10, 0, 2, 15 };
+static const uint8_t net_test_gw[4] = { 10, 0, 2, 2 };
+
+#define NET_TEST_ARP_LEN	42
+#define NET_TEST_TIMEOUT	(CLOCKS_PER_SEC / 2)
+
+static size_t
+net_test_build_arp(uint8_t *frame, const uint8_t mac[NET_MAC_LEN])
+{
+	static const uint8_t arp_hdr[8] = { 0x00, 0x01, 0x08, 0x00, 6, 4, 0x00, 0x01 };
+
+	memset(frame, 0xff, NET_MAC_LEN);
+	memcpy(frame + 6, mac, NET_MAC_LEN);
+	frame[12] = 0x08;
+	frame[13] = 0x06;
+	memcpy(frame + 14, arp_hdr, sizeof(arp_hdr));
+	memcpy(frame + 22, mac, NET_MAC_LEN);
+	memcpy(frame + 28, net_test_ip, 4);
+	memset(frame + 32, 0, NET_MAC_LEN);
+	memcpy(frame + 38, net_test_gw, 4);
+	return NET_TEST_ARP_LEN;
+}
+
+static bool
+net_test_is_arp_reply(const uint8_t *frame, size_t len, const uint8_t mac[NET_MAC_LEN])
+{
+	return len >= NET_TEST_ARP_LEN &&
+	       frame[12] == 0x08 && frame[13] == 0x06 &&
+	       frame[20] == 0x00 && frame[21] == 0x02 &&
+	       !memcmp(frame + 28, net_test_gw, 4) &&
+	       !memcmp(frame + 32, mac, NET_MAC_LEN);
+}
+
+static int
+test_virtio_net(void)
+{
+	ANN("\n---=== Virtio-net Test ===---\n");
+	int failures = 0;
+	uint8_t mac[NET_MAC_LEN] = { 0 };
+
+	int ret = net_init();
+	if (ret == -ENODEV) {
+		WRN("No virtio-net device, skipping\n");
+		return 0;
+	} else if (ret < 0) {
+		ERR("net_init failed: %i\n", ret);
+		return 1;
+	}
+	net_get_mac(mac);
+
+	uint8_t *frame = net_tx_alloc();
+	if (!frame) {
+		ERR("net_tx_alloc failed\n");
+		return 1;
+	}
+	if (net_tx_submit(frame, NET_FRAME_MAX + 1) != -EINVAL) {
+		ERR("net_tx_submit should reject oversized frames\n");
+		failures++;
+	}
+
+	/* Ask the gateway for its MAC, and wait for the reply */
+	size_t len = net_test_build_arp(frame, mac);
+	if (net_tx_submit(frame, len) < 0) {
+		ERR("net_tx_submit failed\n");
+		return failures + 1;
+	}
+	net_tx_flush();
+
+	uint8_t gw_mac[NET_MAC_LEN] = { 0 };
+	bool got_reply = false;
+	clock_t start = clock();
+	while (!got_reply && (clock() - start) < NET_TEST_TIMEOUT) {
+		void *rx_frame = NULL;
+		if (net_rx_poll(&rx_frame, &len) < 0)
+			continue;
+		got_reply = net_test_is_arp_reply(rx_frame, len, mac);
+		if (got_reply)
+			memcpy(gw_mac, (uint8_t*) rx_frame + 22, NET_MAC_LEN);
+		net_rx_release(rx_frame);
+	}
+	if (!got_reply) {
+		ERR("No ARP reply from the gateway\n");
+		failures++;
+	} else
+		INF("Gateway is at %02x:%02x:%02x:%02x:%02x:%02x\n",
+		    gw_mac[0], gw_mac[1], gw_mac[2], gw_mac[3], gw_mac[4], gw_mac[5]);
+
+	struct net_stats stats = { 0 };
+	net_get_stats(&stats);
+	INF("Frames rx/tx: %lu/%lu, tx notifications: %lu\n",
+	    stats.rx_frames, stats.tx_frames, stats.tx_kicks);
+
+	INF("=== Virtio-net Test Results: %s (%d failures) ===\n",
+	    failures == 0 ? "PASS" : "FAIL", failures);
+	return failures;
+}
+
+REGISTER_PLATFORM_TEST("Virtio-net ARP test", test_virtio_net);
+
+#endif /* defined(PLAT_VIRTIO_NET_BASE_ADDR) && (PLAT_VIRTIO_NET_BASE_ADDR > 0) */
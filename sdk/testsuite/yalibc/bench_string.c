@@ -0,0 +1,310 @@
+/*
+ * SPDX-FileType: SOURCE
+ *
+ * SPDX-FileCopyrightText: 2026 Nick Kossifidis <mick@ics.forth.gr>
+ * SPDX-FileCopyrightText: 2026 ICS/FORTH
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stdint.h>			/* For typed ints */
+#include <platform/utils/utils.h>	/* For ANN/INF/ERR */
+#include <platform/riscv/hart.h>	/* For hart_get_counter() */
+#include <stdlib.h>			/* For malloc/free/rand */
+#include <string.h>			/* For mem*, str* etc */
+#include <test_framework.h>		/* For test registration macros */
+#include <errno.h>			/* For ENOMEM */
+
+/*
+ * Throughput benchmarks for the mem* / str* functions, we sweep sizes
+ * from BENCH_MIN_SIZE up to BENCH_MAX_SIZE (or whatever we can get from
+ * the heap) for a few src/dst alignments, and report cycles/byte and
+ * instret/byte, so that we can compare the scalar / Zbb / RVV kernels
+ * across targets.
+ */
+
+#define BENCH_MIN_SIZE		8
+#define BENCH_MAX_SIZE		(4 * 1024 * 1024)
+
+/* Repeat each run until we've processed about this many bytes,
+ * so that small sizes don't end up measuring the counter reads */
+#define BENCH_TARGET_BYTES	(256 * 1024)
+#define BENCH_MAX_REPS		4096
+
+/* src / dst offsets from a word-aligned buffer */
+static const struct {
+	uint8_t src;
+	uint8_t dst;
+} bench_aligns[] = {
+	{ 0, 0 },
+	{ 1, 0 },
+	{ 0, 3 },
+	{ 7, 5 },
+};
+#define BENCH_NUM_ALIGNS	(sizeof(bench_aligns) / sizeof(bench_aligns[0]))
+
+enum bench_op {
+	BENCH_MEMCPY,
+	BENCH_MEMMOVE,
+	BENCH_MEMSET,
+	BENCH_MEMCMP,
+	BENCH_STRLEN,
+	BENCH_STRSTR,
+};
+
+static const char *bench_op_names[] = {
+	[BENCH_MEMCPY] = "memcpy",
+	[BENCH_MEMMOVE] = "memmove",
+	[BENCH_MEMSET] = "memset",
+	[BENCH_MEMCMP] = "memcmp",
+	[BENCH_STRLEN] = "strlen",
+	[BENCH_STRSTR] = "strstr",
+};
+
+/* Needle for strstr, longer than a word so that we also go through
+ * the two-way search, and placed at the end of the haystack */
+static const char bench_needle[] = "0123456789-needle";
+
+struct bench_bufs {
+	uint8_t *src;
+	uint8_t *dst;
+	size_t size;
+};
+
+/* Keep the compiler from optimizing away a call whose results we don't
+ * use (it knows what memcpy and friends do) */
+#define BENCH_CLOBBER(_ptr) __asm__ __volatile__("" : : "r"(_ptr) : "memory")
+
+static int
+bench_alloc(struct bench_bufs *bufs)
+{
+	/* We need some slack for the alignment offsets, and
+	 * on smaller targets just get whatever fits */
+	for (size_t size = BENCH_MAX_SIZE; size >= BENCH_MIN_SIZE; size /= 2) {
+		bufs->src = malloc(size + 16);
+		if (!bufs->src)
+			continue;
+		bufs->dst = malloc(size + 16);
+		if (bufs->dst) {
+			bufs->size = size;
+			return 0;
+		}
+		free(bufs->src);
+	}
+	ERR("Could not allocate benchmark buffers\n");
+	return -1;
+}
+
+static void
+bench_free(struct bench_bufs *bufs)
+{
+	/* Reverse order for the LIFO allocator */
+	free(bufs->dst);
+	free(bufs->src);
+}
+
+/* Prepare the buffers so that the ops that depend on the data
+ * (memcmp, strlen, strstr) have to go through all of them */
+static void
+bench_prepare(enum bench_op op, uint8_t *src, uint8_t *dst, size_t size)
+{
+	switch (op) {
+	case BENCH_MEMCMP:
+		memset(src, 0x5A, size);
+		memset(dst, 0x5A, size);
+		break;
+	case BENCH_STRLEN:
+		memset(src, 'a', size);
+		src[size - 1] = '\0';
+		break;
+	case BENCH_STRSTR:
+		for (size_t i = 0; i < size - 1; i++)
+			src[i] = 'a' + (rand() % 26);
+		src[size - 1] = '\0';
+		if (size > sizeof(bench_needle))
+			memcpy(src + size - sizeof(bench_needle), bench_needle,
+			       sizeof(bench_needle));
+		break;
+	default:
+		break;
+	}
+}
+
+static void
+bench_run_once(enum bench_op op, uint8_t *src, uint8_t *dst, size_t size)
+{
+	switch (op) {
+	case BENCH_MEMCPY:
+		BENCH_CLOBBER(memcpy(dst, src, size));
+		break;
+	case BENCH_MEMMOVE:
+		/* Overlapping, backwards (dst > src) */
+		BENCH_CLOBBER(memmove(src + 1, src, size - 1));
+		break;
+	case BENCH_MEMSET:
+		BENCH_CLOBBER(memset(dst, 0, size));
+		break;
+	case BENCH_MEMCMP:
+		BENCH_CLOBBER((uintptr_t)memcmp(dst, src, size));
+		break;
+	case BENCH_STRLEN:
+		BENCH_CLOBBER(strlen((char *)src));
+		break;
+	case BENCH_STRSTR:
+		BENCH_CLOBBER(strstr((char *)src, bench_needle));
+		break;
+	}
+}
+
+static void
+bench_op(enum bench_op op, struct bench_bufs *bufs)
+{
+	INF("\n%-8s %10s %7s %12s %12s\n", bench_op_names[op],
+	    "size", "src/dst", "cycles/B", "instret/B");
+
+	for (size_t size = BENCH_MIN_SIZE; size <= bufs->size; size *= 2) {
+		size_t reps = BENCH_TARGET_BYTES / size;
+		if (reps == 0)
+			reps = 1;
+		else if (reps > BENCH_MAX_REPS)
+			reps = BENCH_MAX_REPS;
+
+		for (size_t i = 0; i < BENCH_NUM_ALIGNS; i++) {
+			uint8_t *src = bufs->src + bench_aligns[i].src;
+			uint8_t *dst = bufs->dst + bench_aligns[i].dst;
+
+			/* memset only cares about dst alignment */
+			if (op == BENCH_MEMSET && i > 0 &&
+			    bench_aligns[i].dst == bench_aligns[i - 1].dst)
+				continue;
+
+			bench_prepare(op, src, dst, size);
+
+			/* Warm up the caches / branch predictors */
+			bench_run_once(op, src, dst, size);
+
+			uint64_t cycles = hart_get_counter(HC_CYCLES);
+			uint64_t instret = hart_get_counter(HC_INSTRET);
+			for (size_t r = 0; r < reps; r++)
+				bench_run_once(op, src, dst, size);
+			cycles = hart_get_counter(HC_CYCLES) - cycles;
+			instret = hart_get_counter(HC_INSTRET) - instret;
+
+			double bytes = (double) size * reps;
+			INF("%-8s %10lu %3u/%-3u %12.3f %12.3f\n", bench_op_names[op],
+			    size, bench_aligns[i].src, bench_aligns[i].dst,
+			    cycles / bytes, instret / bytes);
+		}
+	}
+}
+
+static int
+bench_ops(const enum bench_op *ops, size_t num_ops)
+{
+	struct bench_bufs bufs = { 0 };
+	if (bench_alloc(&bufs) < 0)
+		return -1;
+
+	INF("Max size: %lu bytes, ~%u bytes processed per entry\n",
+	    bufs.size, BENCH_TARGET_BYTES);
+
+	for (size_t i = 0; i < num_ops; i++)
+		bench_op(ops[i], &bufs);
+
+	bench_free(&bufs);
+	return 0;
+}
+
+static int
+bench_string_copy(void)
+{
+	ANN("\n---===String Copy/Fill Benchmarks===---\n");
+	static const enum bench_op ops[] = { BENCH_MEMCPY, BENCH_MEMMOVE, BENCH_MEMSET };
+	return bench_ops(ops, sizeof(ops) / sizeof(ops[0]));
+}
+
+static int
+bench_string_search(void)
+{
+	ANN("\n---===String Compare/Search Benchmarks===---\n");
+	static const enum bench_op ops[] = { BENCH_MEMCMP, BENCH_STRLEN, BENCH_STRSTR };
+	return bench_ops(ops, sizeof(ops) / sizeof(ops[0]));
+}
+
+REGISTER_YALIBC_BENCH("String copy/fill (memcpy/memmove/memset)", bench_string_copy);
+REGISTER_YALIBC_BENCH("String compare/search (memcmp/strlen/strstr)", bench_string_search);
+
+/*
+ * Fixed size (aligned) runs through the benchmark harness, with min /
+ * median / max across runs, for tracking these across builds. The buffers
+ * are equal strings of BENCH_FIXED_SIZE - 1 bytes, so that memcmp / strlen
+ * go through all of them.
+ */
+#define BENCH_FIXED_SIZE	4096
+
+static struct bench_bufs bench_fixed_bufs;
+
+static int
+bench_fixed_setup(void **ctx)
+{
+	struct bench_bufs *bufs = &bench_fixed_bufs;
+	bufs->src = malloc(BENCH_FIXED_SIZE);
+	if (!bufs->src)
+		return -ENOMEM;
+	bufs->dst = malloc(BENCH_FIXED_SIZE);
+	if (!bufs->dst) {
+		free(bufs->src);
+		return -ENOMEM;
+	}
+	bufs->size = BENCH_FIXED_SIZE;
+	memset(bufs->src, 'a', BENCH_FIXED_SIZE);
+	memset(bufs->dst, 'a', BENCH_FIXED_SIZE);
+	bufs->src[BENCH_FIXED_SIZE - 1] = '\0';
+	bufs->dst[BENCH_FIXED_SIZE - 1] = '\0';
+	*ctx = bufs;
+	return 0;
+}
+
+static void
+bench_fixed_teardown(void *ctx)
+{
+	bench_free(ctx);
+}
+
+static void
+bench_fixed_memcpy(void *ctx)
+{
+	struct bench_bufs *bufs = ctx;
+	bench_run_once(BENCH_MEMCPY, bufs->src, bufs->dst, bufs->size);
+}
+
+static void
+bench_fixed_memset(void *ctx)
+{
+	struct bench_bufs *bufs = ctx;
+	bench_run_once(BENCH_MEMSET, bufs->src, bufs->dst, bufs->size);
+}
+
+static void
+bench_fixed_memcmp(void *ctx)
+{
+	struct bench_bufs *bufs = ctx;
+	bench_run_once(BENCH_MEMCMP, bufs->src, bufs->dst, bufs->size);
+}
+
+static void
+bench_fixed_strlen(void *ctx)
+{
+	struct bench_bufs *bufs = ctx;
+	bench_run_once(BENCH_STRLEN, bufs->src, bufs->dst, bufs->size);
+}
+
+REGISTER_BENCHMARK("memcpy 4KB", bench_fixed_memcpy, .setup = bench_fixed_setup,
+		   .teardown = bench_fixed_teardown, .events = "tlb",
+		   .warmup = 2, .reps = 15, .iters = 16);
+REGISTER_BENCHMARK("memset 4KB", bench_fixed_memset, .setup = bench_fixed_setup,
+		   .teardown = bench_fixed_teardown, .warmup = 2, .reps = 15, .iters = 16);
+REGISTER_BENCHMARK("memcmp 4KB", bench_fixed_memcmp, .setup = bench_fixed_setup,
+		   .teardown = bench_fixed_teardown, .warmup = 2, .reps = 15, .iters = 16);
+REGISTER_BENCHMARK("strlen 4KB", bench_fixed_strlen, .setup = bench_fixed_setup,
+		   .teardown = bench_fixed_teardown, .warmup = 2, .reps = 15, .iters = 16);
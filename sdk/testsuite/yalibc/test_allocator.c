@@ -9,8 +9,31 @@
 
 #include <stdint.h>			/* For typed ints */
 #include <platform/utils/utils.h>	/* For ANN/INF/ERR */
+#include <platform/riscv/hart.h>	/* For hart_wakeup_with_addr() */
 #include <stdlib.h>			/* For malloc */
+#include <malloc.h>			/* For slab_alloc / page_alloc / arenas / stats */
+#include <errno.h>			/* For EINVAL */
 #include <test_framework.h>		/* For test registration macros */
+#include <stdatomic.h>			/* For C11 atomics */
+
+#define REMOTE_FREE_OBJS	4
+
+static void *remote_free_objs[REMOTE_FREE_OBJS];
+static atomic_int remote_free_done;
+
+/* Runs on another hart and frees the boot hart's allocations, oldest
+ * first, so only the last one is on top of its arena when freed. */
+static void __attribute__((noreturn))
+test_allocator_remote_free(uint64_t arg0, uint64_t arg1)
+{
+	(void) arg0;
+	(void) arg1;
+
+	for (int i = 0; i < REMOTE_FREE_OBJS; i++)
+		free(remote_free_objs[i]);
+	atomic_store_explicit(&remote_free_done, 1, memory_order_release);
+	hart_idle();
+}
 
 static int
 test_allocator(void)
@@ -425,6 +448,401 @@ test_allocator(void)
 		}
 	}
 
+	/* Test 10: Slab allocations with out-of-order free */
+	INF("Test 10: Slab out-of-order free...\n");
+	{
+		#define SLAB_TEST_OBJS 16
+		uint8_t *objs[SLAB_TEST_OBJS] = { 0 };
+		size_t sizes[SLAB_TEST_OBJS] = { 0 };
+
+		for (int i = 0; i < SLAB_TEST_OBJS; i++) {
+			sizes[i] = 1 + ((uint16_t) rand() % 2048);
+			objs[i] = slab_alloc(sizes[i]);
+			if (!objs[i]) {
+				ERR("slab_alloc(%zu) failed\n", sizes[i]);
+				failures++;
+				continue;
+			}
+			if ((uintptr_t)objs[i] % __SIZEOF_POINTER__ != 0) {
+				ERR("slab_alloc(%zu) not aligned: %p\n", sizes[i], objs[i]);
+				failures++;
+			}
+			FILL_PATTERN(objs[i], sizes[i], (uint8_t) i);
+		}
+
+		/* Free every other object, then verify the rest are intact */
+		for (int i = 0; i < SLAB_TEST_OBJS; i += 2) {
+			free(objs[i]);
+			objs[i] = NULL;
+		}
+		for (int i = 1; i < SLAB_TEST_OBJS; i += 2) {
+			if (objs[i] && !CHECK_PATTERN(objs[i], sizes[i], (uint8_t) i)) {
+				ERR("Slab object %d corrupted after freeing its neighbours\n", i);
+				failures++;
+			}
+		}
+
+		/* A freed object should be handed out again for the same size */
+		uint8_t *a = slab_alloc(64);
+		free(a);
+		uint8_t *b = slab_alloc(64);
+		if (!a || a != b) {
+			ERR("Slab didn't reuse freed object (%p vs %p)\n", a, b);
+			failures++;
+		}
+
+		/* Growing a slab object past its class should move it and keep its data */
+		if (b) {
+			FILL_PATTERN(b, 64, 0x5A);
+			uint8_t *c = realloc(b, 1000);
+			if (!c) {
+				ERR("Slab realloc failed\n");
+				failures++;
+				free(b);
+			} else {
+				if (!CHECK_PATTERN(c, 64, 0x5A)) {
+					ERR("Slab realloc didn't preserve data\n");
+					failures++;
+				}
+				free(c);
+			}
+		}
+
+		/* Free the rest in the order we allocated them */
+		for (int i = 1; i < SLAB_TEST_OBJS; i += 2)
+			free(objs[i]);
+
+		/* The LIFO heap should still work as before */
+		void *p1 = malloc(100);
+		void *p2 = malloc(100);
+		free(p2);
+		void *p3 = malloc(100);
+		if (!p1 || p3 != p2) {
+			ERR("LIFO allocator broken after slab use\n");
+			failures++;
+		}
+		free(p3);
+		free(p1);
+
+		/* Sizes beyond the largest class should fail */
+		if (slab_alloc(0) != NULL || slab_alloc(8192) != NULL) {
+			ERR("slab_alloc accepted an invalid size\n");
+			failures++;
+		}
+		#undef SLAB_TEST_OBJS
+	}
+
+	/* Test 11: Growing the top allocation past the per-hart arena */
+	INF("Test 11: Large realloc of the top allocation...\n");
+	{
+		/* Depending on the target this is either resized in place on the
+		 * global heap, or moved there from this hart's arena, either way
+		 * data should be preserved and the old spot should be reused. */
+		uint8_t *small = malloc(100);
+		if (!small) {
+			ERR("malloc for large realloc test failed\n");
+			failures++;
+		} else {
+			FILL_PATTERN(small, 100, 0x3C);
+			uint8_t *large = realloc(small, 256 * 1024);
+			if (!large) {
+				WRN("Not enough heap for large realloc test, skipping\n");
+				free(small);
+			} else {
+				if (!CHECK_PATTERN(large, 100, 0x3C)) {
+					ERR("Large realloc didn't preserve data\n");
+					failures++;
+				}
+				FILL_PATTERN(large, 256 * 1024, 0x3D);
+				free(large);
+				void *again = malloc(100);
+				if (again != small) {
+					ERR("Large realloc leaked the original allocation\n");
+					failures++;
+				}
+				free(again);
+			}
+		}
+	}
+
+	/* Test 12: Aligned allocations */
+	INF("Test 12: aligned_alloc/posix_memalign...\n");
+	{
+		static const size_t aligns[] = { 16, 64, 256, 4096, 65536 };
+		for (size_t i = 0; i < sizeof(aligns) / sizeof(aligns[0]); i++) {
+			/* Mess up the alignment of the next allocation first */
+			uint8_t *before = malloc(24);
+			uint8_t *p = aligned_alloc(aligns[i], 100);
+			if (!before || !p) {
+				ERR("aligned_alloc(%zu, 100) failed\n", aligns[i]);
+				failures++;
+			} else if ((uintptr_t)p & (aligns[i] - 1)) {
+				ERR("aligned_alloc(%zu) not aligned: %p\n", aligns[i], p);
+				failures++;
+			} else {
+				FILL_PATTERN(before, 24, 0x77);
+				FILL_PATTERN(p, 100, 0x88);
+				if (!CHECK_PATTERN(before, 24, 0x77)) {
+					ERR("aligned_alloc(%zu) overlaps previous allocation\n", aligns[i]);
+					failures++;
+				}
+			}
+
+			/* Freeing it should rewind over the padding too */
+			free(p);
+			void *next = malloc(8);
+			if (before && next != before + 24 + __SIZEOF_POINTER__) {
+				ERR("free() of aligned_alloc(%zu) didn't rewind the heap\n", aligns[i]);
+				failures++;
+			}
+			free(next);
+			free(before);
+		}
+
+		/* Non power of two alignments are invalid */
+		if (aligned_alloc(24, 100) != NULL) {
+			ERR("aligned_alloc accepted a non power of two alignment\n");
+			failures++;
+		}
+
+		void *p = NULL;
+		if (posix_memalign(&p, 4, 100) != EINVAL) {
+			ERR("posix_memalign accepted alignment smaller than a pointer\n");
+			failures++;
+		}
+		if (posix_memalign(&p, 128, 100) != 0 || !p || ((uintptr_t)p & 127)) {
+			ERR("posix_memalign(128) failed or returned unaligned memory\n");
+			failures++;
+		} else {
+			/* Resizing in place keeps the alignment */
+			void *p2 = realloc(p, 200);
+			if (p2 != p) {
+				ERR("realloc of aligned top allocation moved it\n");
+				failures++;
+			}
+			free(p2);
+		}
+	}
+
+	/* Test 13: Scoped arenas with mark/reset */
+	INF("Test 13: Arena mark/reset...\n");
+	{
+		struct arena *arena = arena_create(4096);
+		if (!arena) {
+			ERR("arena_create failed\n");
+			failures++;
+		} else {
+			arena_mark_t empty = arena_mark(arena);
+			uint8_t *keep = arena_alloc(arena, 100);
+			arena_mark_t phase = arena_mark(arena);
+
+			/* Allocate a bunch of objects for this "phase" */
+			int count = 0;
+			void *first = NULL;
+			void *obj;
+			while ((obj = arena_alloc(arena, 64)) != NULL) {
+				if (!first)
+					first = obj;
+				FILL_PATTERN(obj, 64, 0xEE);
+				count++;
+			}
+			if (!keep || count == 0) {
+				ERR("arena_alloc failed (count: %d)\n", count);
+				failures++;
+			} else {
+				FILL_PATTERN(keep, 100, 0x42);
+
+				/* Release the whole phase at once */
+				arena_reset_to(arena, phase);
+				if (arena_alloc(arena, 64) != first) {
+					ERR("arena_reset_to didn't release the phase\n");
+					failures++;
+				}
+				if (!CHECK_PATTERN(keep, 100, 0x42)) {
+					ERR("arena_reset_to touched allocations before the mark\n");
+					failures++;
+				}
+
+				/* And everything */
+				arena_reset_to(arena, empty);
+				if (arena_alloc(arena, 8) != keep) {
+					ERR("arena_reset_to(empty) didn't release everything\n");
+					failures++;
+				}
+			}
+			arena_destroy(arena);
+		}
+	}
+
+	/* Test 14: Allocator statistics */
+	INF("Test 14: Allocator statistics...\n");
+	{
+		struct malloc_stats before, after;
+		int ret = malloc_get_stats(&before);
+		void *p = malloc(128);
+		void *huge = malloc(SIZE_MAX / 2);
+		free(p);
+		malloc_get_stats(&after);
+
+		if (before.heap_used > before.heap_size || before.heap_peak < before.heap_used ||
+		    after.heap_used + after.heap_free > after.heap_size) {
+			ERR("Inconsistent heap statistics\n");
+			failures++;
+		}
+
+		if (ret == -ENOTSUP) {
+			INF("Allocator counters not available in this build\n");
+		} else if (ret != 0) {
+			ERR("malloc_get_stats failed: %d\n", ret);
+			failures++;
+		} else if (huge || after.allocs != before.allocs + 1 ||
+			   after.frees != before.frees + 1 ||
+			   after.failures != before.failures + 1) {
+			ERR("Allocator counters off (allocs: %lu -> %lu, frees: %lu -> %lu, failures: %lu -> %lu)\n",
+			    before.allocs, after.allocs, before.frees, after.frees,
+			    before.failures, after.failures);
+			failures++;
+		}
+		malloc_stats();
+	}
+
+	/* Test 15: Page-frame allocator */
+	INF("Test 15: Page-frame allocator...\n");
+	{
+		struct malloc_stats before, after;
+		malloc_get_stats(&before);
+
+		uint8_t *a = page_alloc(1, 0);
+		uint8_t *b = page_alloc(2, 16 * 1024);
+		uint8_t *c = page_alloc(1, 0);
+		if (!a || !b || !c) {
+			ERR("page_alloc failed\n");
+			failures++;
+		} else {
+			if (((uintptr_t)a | (uintptr_t)c) & (PAGE_FRAME_SIZE - 1) ||
+			    ((uintptr_t)b & (16 * 1024 - 1))) {
+				ERR("page_alloc returned unaligned pages\n");
+				failures++;
+			}
+			FILL_PATTERN(a, PAGE_FRAME_SIZE, 0xA1);
+			FILL_PATTERN(b, 2 * PAGE_FRAME_SIZE, 0xB2);
+			FILL_PATTERN(c, PAGE_FRAME_SIZE, 0xC3);
+			if (!CHECK_PATTERN(a, PAGE_FRAME_SIZE, 0xA1) ||
+			    !CHECK_PATTERN(c, PAGE_FRAME_SIZE, 0xC3)) {
+				ERR("page_alloc returned overlapping pages\n");
+				failures++;
+			}
+
+			/* Free out of order, the freed run should be reused */
+			page_free(b, 2);
+			uint8_t *d = page_alloc(2, 16 * 1024);
+			if (d != b) {
+				ERR("page_alloc didn't reuse freed pages\n");
+				failures++;
+			}
+			page_free(a, 1);
+			page_free(d, 2);
+			page_free(c, 1);
+		}
+
+		/* Once all pages are freed, the heap should get them back */
+		malloc_get_stats(&after);
+		if (after.pages_used != before.pages_used || after.heap_free < before.heap_free) {
+			ERR("Freed pages didn't go back to the heap\n");
+			failures++;
+		}
+
+		if (page_alloc(0, 0) != NULL || page_alloc(1, 100) != NULL) {
+			ERR("page_alloc accepted invalid arguments\n");
+			failures++;
+		}
+	}
+
+	/* Test 16: Calloc over memory that was used before */
+	INF("Test 16: Calloc over recycled memory...\n");
+	{
+		/* Dirty the top of the heap and then calloc a larger
+		 * buffer over it, that also extends to unused memory */
+		uint8_t *dirty = malloc(4096);
+		if (!dirty) {
+			ERR("malloc failed\n");
+			failures++;
+		} else {
+			FILL_PATTERN(dirty, 4096, 0xFF);
+			free(dirty);
+
+			uint8_t *buf = calloc(3, 4096);
+			if (!buf) {
+				ERR("calloc failed\n");
+				failures++;
+			} else {
+				if (!CHECK_ZERO(buf, 3 * 4096)) {
+					ERR("calloc didn't zero recycled memory\n");
+					failures++;
+				}
+				FILL_PATTERN(buf, 3 * 4096, 0xFF);
+				free(buf);
+			}
+
+			/* Again, now that all of it was used */
+			buf = calloc(3, 4096);
+			if (!buf || !CHECK_ZERO(buf, 3 * 4096)) {
+				ERR("calloc didn't zero recycled memory\n");
+				failures++;
+			}
+			free(buf);
+		}
+	}
+
+	/* Test 17: Frees from another hart */
+	INF("Test 17: Frees from another hart...\n");
+	{
+		int target = -1;
+		struct hart_state *this_hs = hart_get_hstate_self();
+		for (int i = 0; i < hart_get_count(); i++) {
+			struct hart_state *hs = hart_get_hstate_by_idx(i);
+			if (hs == this_hs || !hart_test_flags(hs, HS_FLAG_READY) ||
+			    hart_test_flags(hs, HS_FLAG_RUNNING) || hart_test_flags(hs, HS_FLAG_POOL))
+				continue;
+			target = i;
+			break;
+		}
+
+		int allocated = 0;
+		for (; allocated < REMOTE_FREE_OBJS; allocated++) {
+			remote_free_objs[allocated] = malloc(64);
+			if (!remote_free_objs[allocated])
+				break;
+		}
+
+		if (target < 0) {
+			INF("No other harts available, skipping\n");
+		} else if (allocated != REMOTE_FREE_OBJS) {
+			ERR("malloc failed\n");
+			failures++;
+		} else {
+			atomic_store_explicit(&remote_free_done, 0, memory_order_relaxed);
+			hart_set_flags(hart_get_hstate_by_idx(target), HS_FLAG_RUNNING);
+			hart_wakeup_with_addr(target, (uintptr_t) test_allocator_remote_free, 0, 0, 0);
+			while (!atomic_load_explicit(&remote_free_done, memory_order_acquire))
+				pause();
+			allocated = 0;
+
+			/* All of them should be back, the next allocation
+			 * should go where the first one was */
+			void *again = malloc(64);
+			if (again != remote_free_objs[0]) {
+				ERR("Frees from hart %i leaked memory (%p instead of %p)\n",
+				    target, again, remote_free_objs[0]);
+				failures++;
+			}
+			free(again);
+		}
+
+		while (allocated > 0)
+			free(remote_free_objs[--allocated]);
+	}
+
 	INF("=== Allocator Test Results: %s (%d failures) ===\n",
 		failures == 0 ? "PASS" : "FAIL", failures);
 
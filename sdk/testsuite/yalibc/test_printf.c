@@ -11,6 +11,8 @@
 #include <stdio.h>			/* For printf */
 #include <platform/utils/utils.h>	/* For ANN/INF/ERR */
 #include <limits.h>			/* For INT_MAX */
+#include <string.h>			/* For memset */
+#include <unistd.h>			/* For write */
 #include <test_framework.h>		/* For test registration macros */
 
 static void
@@ -134,6 +136,12 @@ test_printf(void)
 
 	/* Hex to verify no truncation */
 	printf("ULLONG_MAX hex: %llx\n", ULLONG_MAX);
+	printf("ULLONG_MAX oct: %#llo\n", ULLONG_MAX);
+	printf("ULLONG_MAX bin: %#llb\n", ULLONG_MAX);
+
+	/* Digit pair boundaries for decimal */
+	printf("Pairs: %u %u %u %u %u %u %lu %lu\n", 0, 9, 10, 99, 100, 999,
+	       9999999999UL, 10000000000UL);
 
 	union {
 		double d;
@@ -309,6 +317,15 @@ test_printf(void)
 		prec -= 4;
 	}
 
+	INF("\n---Fixed precision (exact digits)---\n");
+	printf("0.1 with %%.20f: %.20f (0.10000000000000000555)\n", 0.1);
+	printf("1e23 with %%.0f: %.0f (99999999999999991611392)\n", 1e23);
+	printf("1.4999999999999999e-7 with %%.0e: %.0e (1e-07)\n", 1.4999999999999999e-7);
+	printf("Ties to even with %%.0f: %.0f %.0f %.0f (0 2 2)\n", 0.5, 1.5, 2.5);
+	printf("2.675 with %%.2f: %.2f (2.67)\n", 2.675);
+	test.i = 0x0000000000000001ULL;
+	printf("Min sub-normal with %%.30e: %.30e\n(4.940656458412465441765687928682e-324)\n", test.d);
+
 	INF("\n---STRING/CHAR---\n");
 	printf("Example from C11 7.21.6.1 with normal (non-wide) characters\n");
 	static char str[] = " X Yabc Z W";
@@ -320,6 +337,21 @@ test_printf(void)
 	printf("|%13.15s|\n", &str[2]);
 	printf("|%13c|\n", str[5]);
 
+	INF("\n---BULK OUTPUT---\n");
+	/* Longer than the line buffer, so it goes out in one piece */
+	static char longstr[301];
+	memset(longstr, '-', sizeof(longstr) - 1);
+	printf("%s\n", longstr);
+	puts("puts: line one\nputs: line two");
+	static const char fwbuff[] = "fwrite: 3 x 4 bytes\n";
+	if (fwrite(fwbuff, 4, 3, stdout) != 3)
+		ERR("fwrite didn't write all items\n");
+	fwrite(fwbuff + 12, 1, sizeof(fwbuff) - 13, stderr);
+	if (write(STDOUT_FILENO, "write: to stdout\n", 17) != 17)
+		ERR("write didn't write all bytes\n");
+	if (write(42, "x", 1) != -1)
+		ERR("write accepted a bad file descriptor\n");
+
 	INF("Press a key to continue...\n");
 	return 0;
 }
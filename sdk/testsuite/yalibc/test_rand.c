@@ -0,0 +1,146 @@
+/*
+ * SPDX-FileType: SOURCE
+ *
+ * SPDX-FileCopyrightText: 2026 Nick Kossifidis <mick@ics.forth.gr>
+ * SPDX-FileCopyrightText: 2026 ICS/FORTH
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stdint.h>			/* For typed ints */
+#include <platform/utils/utils.h>	/* For ANN/INF/ERR */
+#include <stdlib.h>			/* For rand/srand/rand64/rand_fill, malloc/free */
+#include <string.h>			/* For memcmp/memset */
+#include <errno.h>			/* For ENOMEM */
+#include <test_framework.h>		/* For test registration macros */
+
+#define RAND_TEST_SEQ		64
+#define RAND_TEST_BUF		256
+#define RAND_TEST_GUARD		8
+
+/* Allocated by the test, we only have 4KB for .data/.bss */
+struct rand_test_bufs {
+	uint64_t seq[RAND_TEST_SEQ];
+	uint8_t buf[RAND_TEST_BUF + 2 * RAND_TEST_GUARD];
+	uint8_t ref[RAND_TEST_BUF];
+};
+
+static int
+test_rand(void)
+{
+	ANN("\n---=== PRNG Tests ===---\n");
+	struct rand_test_bufs *bufs = malloc(sizeof(struct rand_test_bufs));
+	uint64_t *rand_test_seq = NULL;
+	uint8_t *rand_test_buf = NULL;
+	uint8_t *rand_test_ref = NULL;
+	int failures = 0;
+
+	if (!bufs) {
+		ERR("Couldn't allocate the test buffers\n");
+		return 1;
+	}
+	rand_test_seq = bufs->seq;
+	rand_test_buf = bufs->buf;
+	rand_test_ref = bufs->ref;
+
+	/* Test 1: Same seed, same sequence */
+	srand(42);
+	for (int i = 0; i < RAND_TEST_SEQ; i++)
+		rand_test_seq[i] = rand64();
+	srand(42);
+	for (int i = 0; i < RAND_TEST_SEQ; i++) {
+		if (rand64() != rand_test_seq[i]) {
+			ERR("Sequence %i differs after re-seeding\n", i);
+			failures++;
+			break;
+		}
+	}
+	srand(43);
+	if (rand64() == rand_test_seq[0]) {
+		ERR("Different seeds gave the same output\n");
+		failures++;
+	}
+
+	/* Test 2: rand() stays within [0, RAND_MAX) */
+	for (int i = 0; i < 4096; i++) {
+		int val = rand();
+		if (val < 0 || val >= RAND_MAX) {
+			ERR("rand() returned %i, out of range\n", val);
+			failures++;
+			break;
+		}
+	}
+
+	/* Test 3: rand_fill() continues the rand64() stream, for all
+	 * head / tail alignments and without touching the guard bytes */
+	for (int off = 0; off < RAND_TEST_GUARD; off++) {
+		for (size_t len = 0; len < 24; len++) {
+			memset(rand_test_buf, 0xA5, sizeof(bufs->buf));
+			rand_fill(rand_test_buf + RAND_TEST_GUARD + off, len);
+			for (size_t i = 0; i < sizeof(bufs->buf); i++) {
+				if ((i < RAND_TEST_GUARD + off || i >= RAND_TEST_GUARD + off + len) &&
+				    rand_test_buf[i] != 0xA5) {
+					ERR("rand_fill(%i, %lu) wrote outside the buffer\n", off, len);
+					failures++;
+					break;
+				}
+			}
+		}
+	}
+
+	srand(7);
+	rand_fill(rand_test_ref, RAND_TEST_BUF);
+	srand(7);
+	for (int i = 0; i < RAND_TEST_BUF / 8; i++) {
+		uint64_t val = rand64();
+		if (memcmp(&rand_test_ref[i * 8], &val, sizeof(val))) {
+			ERR("rand_fill() doesn't match rand64() at word %i\n", i);
+			failures++;
+			break;
+		}
+	}
+
+	/* Test 4: Byte distribution isn't badly skewed */
+	uint32_t ones = 0;
+	rand_fill(rand_test_ref, RAND_TEST_BUF);
+	for (int i = 0; i < RAND_TEST_BUF; i++)
+		ones += __builtin_popcount(rand_test_ref[i]);
+	if (ones < RAND_TEST_BUF * 3 || ones > RAND_TEST_BUF * 5) {
+		ERR("Got %u set bits out of %u\n", ones, RAND_TEST_BUF * 8);
+		failures++;
+	}
+
+	/* Re-seed from the platform's entropy sources, nothing to
+	 * check here, just make sure it doesn't hang */
+	srand_entropy();
+	INF("Entropy-seeded output: 0x%016llx\n", rand64());
+	free(bufs);
+
+	INF("=== PRNG Test Results: %s (%d failures) ===\n",
+	    failures == 0 ? "PASS" : "FAIL", failures);
+	return failures;
+}
+
+REGISTER_YALIBC_TEST("PRNG tests", test_rand);
+
+static int
+bench_rand_setup(void **ctx)
+{
+	*ctx = malloc(RAND_TEST_BUF);
+	return *ctx ? 0 : -ENOMEM;
+}
+
+static void
+bench_rand_teardown(void *ctx)
+{
+	free(ctx);
+}
+
+static void
+bench_rand_fill(void *ctx)
+{
+	rand_fill(ctx, RAND_TEST_BUF);
+}
+
+REGISTER_BENCHMARK("rand_fill 256B", bench_rand_fill, .setup = bench_rand_setup,
+		   .teardown = bench_rand_teardown, .warmup = 2, .reps = 15, .iters = 64);
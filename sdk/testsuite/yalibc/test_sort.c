@@ -0,0 +1,237 @@
+/*
+ * SPDX-FileType: SOURCE
+ *
+ * SPDX-FileCopyrightText: 2026 Nick Kossifidis <mick@ics.forth.gr>
+ * SPDX-FileCopyrightText: 2026 ICS/FORTH
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#define __STDC_WANT_LIB_EXT1__ 1	/* For qsort_s() */
+#include <stdint.h>			/* For typed ints */
+#include <platform/utils/utils.h>	/* For ANN/INF/ERR */
+#include <stdlib.h>			/* For qsort/bsearch/rand, malloc/free */
+#include <string.h>			/* For memcmp/memcpy */
+#include <test_framework.h>		/* For test registration macros */
+#include <errno.h>			/* For ENOMEM */
+
+#define SORT_TEST_MAX		2048
+#define SORT_BENCH_NUM		4096
+
+enum sort_test_pattern {
+	SORT_RANDOM,
+	SORT_ASCENDING,
+	SORT_DESCENDING,
+	SORT_FEW_UNIQUE,
+	SORT_ORGAN_PIPE,
+	SORT_NUM_PATTERNS
+};
+
+static const char *sort_pattern_names[SORT_NUM_PATTERNS] = {
+	"random", "ascending", "descending", "few unique", "organ pipe"
+};
+
+static int
+sort_cmp_u64(const void *a, const void *b)
+{
+	const uint64_t x = *(const uint64_t *) a;
+	const uint64_t y = *(const uint64_t *) b;
+	return (x > y) - (x < y);
+}
+
+static int
+sort_cmp_3bytes(const void *a, const void *b)
+{
+	return memcmp(a, b, 3);
+}
+
+static int
+sort_cmp_u64_counted(const void *a, const void *b, void *context)
+{
+	(*(unsigned int *) context)++;
+	return sort_cmp_u64(a, b);
+}
+
+static void
+sort_fill(uint64_t *vals, size_t num, enum sort_test_pattern pattern)
+{
+	for (size_t i = 0; i < num; i++) {
+		switch (pattern) {
+		case SORT_ASCENDING:
+			vals[i] = i;
+			break;
+		case SORT_DESCENDING:
+			vals[i] = num - i;
+			break;
+		case SORT_FEW_UNIQUE:
+			vals[i] = rand64() % 4;
+			break;
+		case SORT_ORGAN_PIPE:
+			vals[i] = (i < num / 2) ? i : num - i;
+			break;
+		default:
+			vals[i] = rand64();
+		}
+	}
+}
+
+static int
+test_sort(void)
+{
+	ANN("\n---=== Sort / Search Tests ===---\n");
+	static const size_t sizes[] = { 0, 1, 2, 3, 15, 16, 17, 100, 127, 128, 1000, SORT_TEST_MAX };
+	uint64_t *sort_test_words = NULL;
+	/* 3-byte elements, one byte off a word boundary, for the byte swaps */
+	uint8_t *sort_test_bytes = NULL;
+	int failures = 0;
+
+	sort_test_words = malloc(SORT_TEST_MAX * sizeof(uint64_t));
+	sort_test_bytes = malloc(SORT_TEST_MAX * 3 + 1);
+	if (!sort_test_words || !sort_test_bytes) {
+		ERR("Couldn't allocate the test arrays\n");
+		free(sort_test_bytes);
+		free(sort_test_words);
+		return 1;
+	}
+
+	/* Test 1: qsort() / bsearch() on word-sized elements */
+	for (int p = 0; p < SORT_NUM_PATTERNS; p++) {
+		for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+			const size_t num = sizes[s];
+			sort_fill(sort_test_words, num, p);
+			qsort(sort_test_words, num, sizeof(uint64_t), sort_cmp_u64);
+			for (size_t i = 1; i < num; i++) {
+				if (sort_test_words[i - 1] > sort_test_words[i]) {
+					ERR("qsort(%s, %lu) out of order at %lu\n",
+					    sort_pattern_names[p], num, i);
+					failures++;
+					break;
+				}
+			}
+			for (size_t i = 0; i < num; i++) {
+				const uint64_t *found = bsearch(&sort_test_words[i], sort_test_words, num,
+								sizeof(uint64_t), sort_cmp_u64);
+				if (!found || *found != sort_test_words[i]) {
+					ERR("bsearch(%s, %lu) missed element %lu\n",
+					    sort_pattern_names[p], num, i);
+					failures++;
+					break;
+				}
+			}
+		}
+	}
+	const uint64_t missing = UINT64_MAX;
+	sort_fill(sort_test_words, 100, SORT_ASCENDING);
+	if (bsearch(&missing, sort_test_words, 100, sizeof(uint64_t), sort_cmp_u64) != NULL) {
+		ERR("bsearch() found a missing key\n");
+		failures++;
+	}
+
+	/* Test 2: Unaligned, odd-sized elements */
+	uint8_t *bytes = sort_test_bytes + 1;
+	rand_fill(bytes, SORT_TEST_MAX * 3);
+	qsort(bytes, SORT_TEST_MAX, 3, sort_cmp_3bytes);
+	for (size_t i = 1; i < SORT_TEST_MAX; i++) {
+		if (memcmp(&bytes[(i - 1) * 3], &bytes[i * 3], 3) > 0) {
+			ERR("qsort() of 3-byte elements out of order at %lu\n", i);
+			failures++;
+			break;
+		}
+	}
+
+	/* Test 3: qsort_s() passes the context through, and checks its arguments */
+	unsigned int compares = 0;
+	sort_fill(sort_test_words, SORT_TEST_MAX, SORT_RANDOM);
+	if (qsort_s(sort_test_words, SORT_TEST_MAX, sizeof(uint64_t), sort_cmp_u64_counted, &compares) ||
+	    compares == 0) {
+		ERR("qsort_s() failed / didn't pass the context\n");
+		failures++;
+	}
+	INF("qsort_s() of %u random words took %u compares\n", SORT_TEST_MAX, compares);
+	if (qsort_s(NULL, 1, sizeof(uint64_t), sort_cmp_u64_counted, NULL) == 0 ||
+	    qsort_s(sort_test_words, RSIZE_MAX + 1, 1, sort_cmp_u64_counted, NULL) == 0) {
+		ERR("qsort_s() accepted invalid arguments\n");
+		failures++;
+	}
+
+	/* LIFO allocator, free in reverse */
+	free(sort_test_bytes);
+	free(sort_test_words);
+
+	INF("=== Sort / Search Test Results: %s (%d failures) ===\n",
+	    failures == 0 ? "PASS" : "FAIL", failures);
+	return failures;
+}
+
+REGISTER_YALIBC_TEST("Sort / search tests", test_sort);
+
+
+/************\
+* Benchmarks *
+\************/
+
+struct sort_bench {
+	uint64_t *src;
+	uint64_t *work;
+};
+
+/* So that the lookups don't get optimized out */
+static volatile unsigned int sort_bench_found;
+
+static int
+sort_bench_setup(void **ctx)
+{
+	struct sort_bench *sb = malloc(sizeof(struct sort_bench));
+	if (!sb)
+		return -ENOMEM;
+	sb->src = malloc(SORT_BENCH_NUM * sizeof(uint64_t));
+	sb->work = malloc(SORT_BENCH_NUM * sizeof(uint64_t));
+	if (!sb->src || !sb->work) {
+		free(sb->work);
+		free(sb->src);
+		free(sb);
+		return -ENOMEM;
+	}
+	srand(1);
+	sort_fill(sb->src, SORT_BENCH_NUM, SORT_RANDOM);
+	memcpy(sb->work, sb->src, SORT_BENCH_NUM * sizeof(uint64_t));
+	qsort(sb->work, SORT_BENCH_NUM, sizeof(uint64_t), sort_cmp_u64);
+	*ctx = sb;
+	return 0;
+}
+
+/* LIFO allocator, free in reverse */
+static void
+sort_bench_teardown(void *ctx)
+{
+	struct sort_bench *sb = ctx;
+	free(sb->work);
+	free(sb->src);
+	free(sb);
+}
+
+/* Includes copying the unsorted input back in */
+static void
+bench_qsort(void *ctx)
+{
+	struct sort_bench *sb = ctx;
+	memcpy(sb->work, sb->src, SORT_BENCH_NUM * sizeof(uint64_t));
+	qsort(sb->work, SORT_BENCH_NUM, sizeof(uint64_t), sort_cmp_u64);
+}
+
+/* Look up every element of the sorted copy from setup */
+static void
+bench_bsearch(void *ctx)
+{
+	struct sort_bench *sb = ctx;
+	unsigned int found = 0;
+	for (int i = 0; i < SORT_BENCH_NUM; i++)
+		found += bsearch(&sb->src[i], sb->work, SORT_BENCH_NUM, sizeof(uint64_t),
+				 sort_cmp_u64) != NULL;
+	sort_bench_found = found;
+}
+
+REGISTER_BENCHMARK("qsort 4K random words", bench_qsort, .setup = sort_bench_setup,
+		   .teardown = sort_bench_teardown, .warmup = 1, .reps = 11);
+REGISTER_BENCHMARK("bsearch 4K words x 4K", bench_bsearch, .setup = sort_bench_setup,
+		   .teardown = sort_bench_teardown, .warmup = 1, .reps = 11);
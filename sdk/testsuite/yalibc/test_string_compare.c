@@ -440,6 +440,50 @@ test_string_compare(void)
 		failures++;
 	}
 
+	/* Equal strings on equally aligned buffers, with different
+	 * bytes after the null terminator in the same word */
+	printf("strcmp/strncmp: garbage after null (same alignment)\n");
+	memset(testbuff_a, 'x', 64);
+	memset(testbuff_b, 'y', 64);
+	memcpy(testbuff_a + 3, "same string", 12);
+	memcpy(testbuff_b + 3, "same string", 12);
+	if (strcmp((char *)testbuff_a + 3, (char *)testbuff_b + 3) != 0 ||
+	    strncmp((char *)testbuff_a + 3, (char *)testbuff_b + 3, 40) != 0) {
+		ERR("strcmp/strncmp compared bytes past the null terminator\n");
+		failures++;
+	}
+
+	/* Single difference at a random position of long, unaligned
+	 * buffers/strings, checking the exact difference returned */
+	printf("memcmp/strcmp/strncmp: long compare, random difference (x100)\n");
+	for (int i = 0; i < 100; i++) {
+		uint16_t offt_a = ((uint16_t)rand()) % 16;
+		uint16_t offt_b = ((uint16_t)rand()) % 16;
+		uint16_t len = 1 + ((uint16_t)rand()) % (TESTBUFF_LEN - 32);
+		uint16_t pos = ((uint16_t)rand()) % len;
+		uint8_t *a = testbuff_a + offt_a;
+		uint8_t *b = testbuff_b + offt_b;
+
+		for (int j = 0; j < len; j++)
+			a[j] = b[j] = 1 + ((uint8_t)rand() % 254);
+		a[len] = b[len] = '\0';
+		b[pos] = a[pos] + 1;
+
+		if (memcmp(a, b, len) != -1) {
+			ERR("memcmp failed for len: %d, pos: %d\n", len, pos);
+			failures++;
+		}
+		if (strcmp((char *)b, (char *)a) != 1) {
+			ERR("strcmp failed for len: %d, pos: %d\n", len, pos);
+			failures++;
+		}
+		if (strncmp((char *)a, (char *)b, pos) != 0 ||
+		    strncmp((char *)a, (char *)b, len + 16) != -1) {
+			ERR("strncmp failed for len: %d, pos: %d\n", len, pos);
+			failures++;
+		}
+	}
+
 	free(testbuff_a);
 	free(testbuff_b);
 
@@ -225,6 +225,28 @@ test_string_copy(void)
 		}
 	}
 
+	/* Large overlapping moves by a small odd offset, so that the
+	 * copy spans many vector chunks / words in both directions */
+	printf("memmove: large overlapping (forward/backward by 3 bytes)\n");
+	for (int i = 0; i < OVERLAP_TEST_SIZE; i++)
+		overlap_buf[i] = (uint8_t)(i * 7);
+	memmove(overlap_buf + 3, overlap_buf, OVERLAP_TEST_SIZE - 3);
+	for (int i = 0; i < OVERLAP_TEST_SIZE - 3; i++) {
+		if (overlap_buf[3 + i] != (uint8_t)(i * 7)) {
+			ERR("memmove large overlapping forward failed at byte %d\n", i);
+			failures++;
+			break;
+		}
+	}
+	memmove(overlap_buf, overlap_buf + 3, OVERLAP_TEST_SIZE - 3);
+	for (int i = 0; i < OVERLAP_TEST_SIZE - 3; i++) {
+		if (overlap_buf[i] != (uint8_t)(i * 7)) {
+			ERR("memmove large overlapping backward failed at byte %d\n", i);
+			failures++;
+			break;
+		}
+	}
+
 	/* Same source and destination */
 	printf("memmove: src == dst\n");
 	memset(testbuff_a, 0xBB, 10);
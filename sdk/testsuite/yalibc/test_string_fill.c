@@ -88,6 +88,33 @@ test_string_fill(void)
 		}
 	}
 
+	/* Small unaligned fill that ends before the next word boundary */
+	printf("memset: small unaligned (within a word)\n");
+	memset(testbuff, 0xFF, 16);
+	memset(testbuff + 1, 0x33, 2);
+	if (testbuff[0] != 0xFF || testbuff[1] != 0x33 ||
+	    testbuff[2] != 0x33 || testbuff[3] != 0xFF) {
+		ERR("memset small unaligned fill overran its range\n");
+		failures++;
+	}
+
+	/* Unaligned zero fill spanning multiple cache blocks, so
+	 * that we also cover the cbo.zero head/tail handling */
+	printf("memset: unaligned zero fill (cache block interior)\n");
+	memset(testbuff, 0xFF, 512);
+	memset(testbuff + 5, 0, 500);
+	if (testbuff[4] != 0xFF || testbuff[505] != 0xFF) {
+		ERR("memset unaligned zero fill boundary error\n");
+		failures++;
+	}
+	for (int i = 5; i < 505; i++) {
+		if (testbuff[i] != 0) {
+			ERR("memset unaligned zero fill failed at byte %d\n", i);
+			failures++;
+			break;
+		}
+	}
+
 	/* Different patterns */
 	printf("memset: various fill values\n");
 	uint8_t patterns[] = {0x00, 0xFF, 0xAA, 0x55, 0x01, 0xFE};
@@ -248,6 +248,33 @@ test_string_search(void)
 		failures++;
 	}
 
+	/* Long scans at random start offsets / lengths, so that they span
+	 * multiple words / vector chunks and start unaligned */
+	printf("strlen/strchr/strrchr: long buffer scans (x100)\n");
+	for (int i = 0; i < 100; i++) {
+		uint16_t start = ((uint16_t)rand()) % 64;
+		uint16_t len = ((uint16_t)rand()) % (TESTBUFF_LEN - 128);
+		char *s = (char *)testbuff_a + start;
+		memset(testbuff_a, 'x', TESTBUFF_LEN);
+		s[len] = '\0';
+		if (strlen(s) != len) {
+			ERR("strlen failed for start: %d, len: %d\n", start, len);
+			failures++;
+		}
+		if (len > 1) {
+			uint16_t pos = ((uint16_t)rand()) % len;
+			s[pos] = 'y';
+			if (strchr(s, 'y') != s + pos || strrchr(s, 'y') != s + pos) {
+				ERR("strchr/strrchr failed for pos: %d, len: %d\n", pos, len);
+				failures++;
+			}
+		}
+		if (strchr(s, 'z') != NULL) {
+			ERR("strchr found a char past the terminator (len: %d)\n", len);
+			failures++;
+		}
+	}
+
 	/* ===== strnlen ===== */
 	INF("\n--- strnlen tests ---\n");
 
@@ -686,6 +713,61 @@ test_string_search(void)
 		}
 	}
 
+	/* ===== memmem ===== */
+	INF("\n--- memmem tests ---\n");
+	const void *vptr;
+
+	/* Binary haystack/needle with embedded nulls */
+	printf("memmem: binary data with nulls\n");
+	static const uint8_t blob[] = { 0, 1, 0, 2, 0xFF, 0, 1, 0, 3, 0, 1, 0, 3, 7 };
+	static const uint8_t marker[] = { 0, 1, 0, 3 };
+	vptr = memmem(blob, sizeof(blob), marker, sizeof(marker));
+	if (vptr != blob + 5) {
+		ERR("memmem binary search failed\n");
+		failures++;
+	}
+
+	/* Match must be fully within haystack_len */
+	printf("memmem: needle crossing haystack end\n");
+	vptr = memmem(blob, 7, marker, sizeof(marker));
+	if (vptr != NULL) {
+		ERR("memmem matched past haystack_len\n");
+		failures++;
+	}
+
+	printf("memmem: empty needle / needle longer than haystack\n");
+	if (memmem(blob, sizeof(blob), marker, 0) != blob ||
+	    memmem(marker, sizeof(marker), blob, sizeof(blob)) != NULL) {
+		ERR("memmem edge cases failed\n");
+		failures++;
+	}
+
+	/* Repetitive haystack, lots of first/last byte candidates */
+	printf("memmem: repetitive haystack\n");
+	memset(testbuff_a, 'a', TESTBUFF_LEN);
+	memcpy(testbuff_a + TESTBUFF_LEN - 40, "aaaaaaaaaaaaaaaaaaab", 20);
+	vptr = memmem(testbuff_a, TESTBUFF_LEN, "aaaaaaaaaaaaaaaaaaab", 20);
+	if (vptr != testbuff_a + TESTBUFF_LEN - 40) {
+		ERR("memmem repetitive haystack failed\n");
+		failures++;
+	}
+
+	/* Random binary needles taken from a random binary haystack */
+	printf("memmem: random binary substrings (x100)\n");
+	for (int i = 0; i < 100; i++) {
+		for (int j = 0; j < TESTBUFF_LEN; j++)
+			testbuff_a[j] = (uint8_t)rand() % 4;
+		uint16_t needle_len = 2 + ((uint16_t)rand() % 30);
+		uint16_t pos = (uint16_t)rand() % (TESTBUFF_LEN - needle_len);
+		uint8_t *res = memmem(testbuff_a, TESTBUFF_LEN, testbuff_a + pos, needle_len);
+		if (!res || res > testbuff_a + pos ||
+		    memcmp(res, testbuff_a + pos, needle_len) != 0) {
+			ERR("memmem random test %d failed (needle_len=%u, pos=%u)\n",
+			    i + 1, needle_len, pos);
+			failures++;
+		}
+	}
+
 	free(testbuff_a);
 
 	INF("=== String Search Test Results: %s (%d failures) ===\n",
@@ -0,0 +1,151 @@
+/*
+ * SPDX-FileType: SOURCE
+ *
+ * SPDX-FileCopyrightText: 2026 Nick Kossifidis <mick@ics.forth.gr>
+ * SPDX-FileCopyrightText: 2026 ICS/FORTH
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stdint.h>			/* For typed ints */
+#include <platform/utils/utils.h>	/* For ANN/INF/ERR */
+#include <threads.h>			/* For thrd_* / mtx_* / cnd_* */
+#include <time.h>			/* For timespec_get() */
+#include <test_framework.h>		/* For test registration macros */
+
+#define THRD_TEST_NUM		4
+#define THRD_TEST_ROUNDS	50
+
+static mtx_t thrd_test_mtx;
+static cnd_t thrd_test_cnd;
+static unsigned long thrd_test_counter;
+static int thrd_test_ready;
+
+/* Increment the counter under the mutex, yielding while holding
+ * it every now and then, so that the others have to block on it */
+static int
+thrd_test_counter_fn(void *arg)
+{
+	const int idx = (int)(uintptr_t) arg;
+	for (int i = 0; i < THRD_TEST_ROUNDS; i++) {
+		mtx_lock(&thrd_test_mtx);
+		unsigned long val = thrd_test_counter;
+		if (!(i % 8))
+			thrd_yield();
+		thrd_test_counter = val + 1;
+		mtx_unlock(&thrd_test_mtx);
+		thrd_yield();
+	}
+	return idx + 100;
+}
+
+static int
+thrd_test_sleeper_fn(void *arg)
+{
+	struct timespec ts = { .tv_sec = 0, .tv_nsec = 20000000 };
+	(void) arg;
+	thrd_sleep(&ts, NULL);
+	return 0;
+}
+
+static int
+thrd_test_waiter_fn(void *arg)
+{
+	(void) arg;
+	mtx_lock(&thrd_test_mtx);
+	while (!thrd_test_ready)
+		cnd_wait(&thrd_test_cnd, &thrd_test_mtx);
+	thrd_test_ready = 2;
+	mtx_unlock(&thrd_test_mtx);
+	return 0;
+}
+
+static int
+test_threads(void)
+{
+	thrd_t thrs[THRD_TEST_NUM];
+	int failures = 0;
+	int res = 0;
+
+	ANN("\n---===Threads tests===---\n");
+
+	mtx_init(&thrd_test_mtx, mtx_plain);
+	cnd_init(&thrd_test_cnd);
+
+	/* Mutual exclusion and join results */
+	thrd_test_counter = 0;
+	for (int i = 0; i < THRD_TEST_NUM; i++) {
+		if (thrd_create(&thrs[i], thrd_test_counter_fn, (void *)(uintptr_t) i) != thrd_success) {
+			ERR("thrd_create failed\n");
+			return failures + 1;
+		}
+	}
+	for (int i = 0; i < THRD_TEST_NUM; i++) {
+		if (thrd_join(thrs[i], &res) != thrd_success || res != i + 100) {
+			ERR("thrd_join for thread %i failed (res: %i)\n", i, res);
+			failures++;
+		}
+	}
+	if (thrd_test_counter != THRD_TEST_NUM * THRD_TEST_ROUNDS) {
+		ERR("Counter is %lu, expected %u\n", thrd_test_counter,
+		    THRD_TEST_NUM * THRD_TEST_ROUNDS);
+		failures++;
+	}
+
+	/* A few sleeping threads should overlap, not add up */
+	struct timespec start, end;
+	timespec_get(&start, TIME_UTC);
+	for (int i = 0; i < THRD_TEST_NUM; i++)
+		thrd_create(&thrs[i], thrd_test_sleeper_fn, NULL);
+	for (int i = 0; i < THRD_TEST_NUM; i++)
+		thrd_join(thrs[i], NULL);
+	timespec_get(&end, TIME_UTC);
+	const uint64_t elapsed = (end.tv_sec - start.tv_sec) * 1000000000UL + end.tv_nsec - start.tv_nsec;
+	INF("%u threads sleeping for 20ms took %lu ns\n", THRD_TEST_NUM, elapsed);
+	if (elapsed < 20000000UL || elapsed >= 2 * 20000000UL) {
+		ERR("Sleeping threads didn't overlap\n");
+		failures++;
+	}
+
+	/* Condition variable hand-off */
+	thrd_test_ready = 0;
+	thrd_create(&thrs[0], thrd_test_waiter_fn, NULL);
+	thrd_yield();
+	mtx_lock(&thrd_test_mtx);
+	thrd_test_ready = 1;
+	cnd_signal(&thrd_test_cnd);
+	mtx_unlock(&thrd_test_mtx);
+	thrd_join(thrs[0], NULL);
+	if (thrd_test_ready != 2) {
+		ERR("cnd_wait didn't return after cnd_signal\n");
+		failures++;
+	}
+
+	/* Timeouts */
+	struct timespec deadline;
+	timespec_get(&deadline, TIME_UTC);
+	deadline.tv_nsec += 5000000;
+	if (deadline.tv_nsec >= 1000000000) {
+		deadline.tv_sec++;
+		deadline.tv_nsec -= 1000000000;
+	}
+	mtx_lock(&thrd_test_mtx);
+	if (cnd_timedwait(&thrd_test_cnd, &thrd_test_mtx, &deadline) != thrd_timedout) {
+		ERR("cnd_timedwait should time out\n");
+		failures++;
+	}
+	if (mtx_trylock(&thrd_test_mtx) != thrd_busy) {
+		ERR("mtx_trylock should fail on a locked mutex\n");
+		failures++;
+	}
+	mtx_unlock(&thrd_test_mtx);
+
+	mtx_destroy(&thrd_test_mtx);
+	cnd_destroy(&thrd_test_cnd);
+
+	INF("=== Threads Test Results: %s (%d failures) ===\n",
+	    failures == 0 ? "PASS" : "FAIL", failures);
+	return failures;
+}
+
+REGISTER_YALIBC_TEST("Threads tests", test_threads);
@@ -0,0 +1,166 @@
+#!/usr/bin/env python3
+#
+# SPDX-FileType: SOURCE
+#
+# SPDX-FileCopyrightText: 2026 Nick Kossifidis <mick@ics.forth.gr>
+# SPDX-FileCopyrightText: 2026 ICS/FORTH
+#
+# SPDX-License-Identifier: Apache-2.0
+#
+# Decoder for the records sent out by binlog_dump() (see
+# platform/include/utils/binlog.h). It reads the format strings from the
+# ELF image the records came from, and renders them using printf semantics.
+#
+# Usage: binlog_decode.py <elf image> [console log] [--freq <hart freq in Hz>]
+#
+# The console log defaults to stdin, anything that's not a binlog record
+# (e.g. normal console output) is ignored.
+
+import re
+import struct
+import sys
+
+SHT_SYMTAB = 2
+SHT_NOBITS = 8
+SHF_ALLOC = 0x2
+
+FMT_SPEC = re.compile(r"%([-+ #0]*)(\*|\d+)?(?:\.(\*|\d*))?(hh|h|ll|l|j|z|t|L)?([diouxXcsfFeEgGaAp%])")
+
+
+class Elf:
+	def __init__(self, path):
+		with open(path, "rb") as f:
+			self.data = f.read()
+		if self.data[:4] != b"\x7fELF" or self.data[4] != 2 or self.data[5] != 1:
+			raise ValueError("%s is not a little-endian ELF64 image" % path)
+
+		(shoff,) = struct.unpack_from("<Q", self.data, 0x28)
+		shentsize, shnum = struct.unpack_from("<HH", self.data, 0x3A)
+		self.sections = []
+		for i in range(shnum):
+			(name, stype, flags, addr, offset, size, link, info, align,
+			 entsize) = struct.unpack_from("<IIQQQQIIQQ", self.data, shoff + i * shentsize)
+			self.sections.append((stype, flags, addr, offset, size, link, entsize))
+
+		self.symbols = {}
+		for stype, flags, addr, offset, size, link, entsize in self.sections:
+			if stype != SHT_SYMTAB:
+				continue
+			stroff = self.sections[link][3]
+			for off in range(offset, offset + size, entsize):
+				name, info, other, shndx, value, _ = struct.unpack_from("<IBBHQQ", self.data, off)
+				end = self.data.index(b"\0", stroff + name)
+				self.symbols[self.data[stroff + name:end].decode()] = value
+
+	def read(self, addr, size):
+		for stype, flags, saddr, offset, ssize, link, entsize in self.sections:
+			if not (flags & SHF_ALLOC) or stype == SHT_NOBITS:
+				continue
+			if saddr <= addr and addr + size <= saddr + ssize:
+				return self.data[offset + addr - saddr:offset + addr - saddr + size]
+		return None
+
+	def read_string(self, addr, max_len=256):
+		for stype, flags, saddr, offset, ssize, link, entsize in self.sections:
+			if not (flags & SHF_ALLOC) or stype == SHT_NOBITS:
+				continue
+			if saddr <= addr < saddr + ssize:
+				start = offset + addr - saddr
+				end = min(offset + ssize, start + max_len)
+				nul = self.data.find(b"\0", start, end)
+				return self.data[start:nul if nul >= 0 else end].decode(errors="replace")
+		return None
+
+
+def to_signed(val, bits):
+	val &= (1 << bits) - 1
+	return val - (1 << bits) if val & (1 << (bits - 1)) else val
+
+
+def int_bits(length):
+	return {"hh": 8, "h": 16, None: 32}.get(length, 64)
+
+
+def render(elf, fmt, args):
+	args = list(args)
+	out = []
+	pos = 0
+
+	def next_arg():
+		return args.pop(0) if args else 0
+
+	for m in FMT_SPEC.finditer(fmt):
+		out.append(fmt[pos:m.start()])
+		pos = m.end()
+		flags, width, prec, length, conv = m.groups()
+		if conv == "%":
+			out.append("%")
+			continue
+		if width == "*":
+			width = str(to_signed(next_arg(), 32))
+		if prec == "*":
+			prec = str(to_signed(next_arg(), 32))
+		spec = "%" + flags + (width or "") + ("." + prec if prec is not None else "")
+		val = next_arg()
+
+		if conv in "di":
+			out.append((spec + "d") % to_signed(val, int_bits(length)))
+		elif conv in "ouxX":
+			out.append((spec + conv) % (val & ((1 << int_bits(length)) - 1)))
+		elif conv == "c":
+			out.append((spec + "c") % chr(val & 0xFF))
+		elif conv == "p":
+			out.append((spec + "s") % ("0x%x" % val))
+		elif conv == "s":
+			string = elf.read_string(val)
+			out.append((spec + "s") % (string if string is not None else "<0x%x>" % val))
+		else:
+			(dval,) = struct.unpack("<d", struct.pack("<Q", val))
+			if conv in "aA":
+				# float.hex() keeps all 13 hex digits, printf drops trailing zeros
+				string = re.sub(r"\.?0+p", "p", dval.hex())
+				out.append((spec.replace(".", "") + "s") % (string.upper() if conv == "A" else string))
+			else:
+				out.append((spec + conv) % dval)
+	out.append(fmt[pos:])
+	return "".join(out)
+
+
+def main(argv):
+	freq = None
+	if "--freq" in argv:
+		i = argv.index("--freq")
+		freq = float(argv[i + 1])
+		del argv[i:i + 2]
+	if len(argv) < 2:
+		sys.stderr.write("Usage: %s <elf image> [console log] [--freq <hart freq in Hz>]\n" % argv[0])
+		return 1
+
+	elf = Elf(argv[1])
+	if "__binlog_fmts_start" not in elf.symbols:
+		sys.stderr.write("No __binlog_fmts_start in %s\n" % argv[1])
+		return 1
+	fmts_start = elf.symbols["__binlog_fmts_start"]
+	log = open(argv[2], errors="replace") if len(argv) > 2 else sys.stdin
+
+	for line in log:
+		fields = line.split()
+		if len(fields) < 5 or fields[0] != "BL":
+			continue
+		try:
+			seq, fmt_id, hart_idx, cycles = (int(x, 16) for x in fields[1:5])
+			args = [int(x, 16) for x in fields[5:]]
+		except ValueError:
+			continue
+		fmt = elf.read_string(fmts_start + fmt_id, 1024)
+		if fmt is None:
+			fmt = "<unknown format 0x%x>\n" % fmt_id
+		stamp = "%.9f" % (cycles / freq) if freq else "%u" % cycles
+		sys.stdout.write("[%s] %u hart %u: %s" % (stamp, seq, hart_idx, render(elf, fmt, args)))
+		if not fmt.endswith("\n"):
+			sys.stdout.write("\n")
+	return 0
+
+
+if __name__ == "__main__":
+	sys.exit(main(sys.argv))
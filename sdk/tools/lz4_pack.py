@@ -0,0 +1,167 @@
+#!/usr/bin/env python3
+#
+# SPDX-FileType: SOURCE
+#
+# SPDX-FileCopyrightText: 2026 Nick Kossifidis <mick@ics.forth.gr>
+# SPDX-FileCopyrightText: 2026 ICS/FORTH
+#
+# SPDX-License-Identifier: Apache-2.0
+#
+# Packs an LZ4_BOOT image (see sdk.mk), the boot stage of start.S followed
+# by the rest of the image LZ4-compressed, for the boot stage to expand it
+# into ram. The image is the raw binary of everything linked to ram, up to
+# the end of .data, its last four words (the boot lottery / hart counter /
+# "image ready" words, filled with 0xDEADBEEF) are left out so that the boot
+# stage doesn't overwrite them.
+#
+# Usage: lz4_pack.py <boot stage bin> <image bin> <output bin> [--rom-size <bytes>]
+#
+# The compressed image is a single LZ4 block (no frame), after a header of
+# four little-endian words: magic ("BLZ4"), raw size, compressed size and
+# a reserved one.
+
+import struct
+import sys
+
+LZ4_BOOT_MAGIC = 0x345A4C42
+LZ4_BOOT_TRAILER = b"\xde\xad\xbe\xef" * 4
+
+MIN_MATCH = 4
+MAX_OFFSET = 0xFFFF
+# From the block format spec, the last match must start at least 12 bytes
+# before the end, and the last 5 bytes are always literals
+MF_LIMIT = 12
+LAST_LITERALS = 5
+
+
+def put_length(out, length):
+	while length >= 255:
+		out.append(255)
+		length -= 255
+	out.append(length)
+
+
+def put_sequence(out, literals, offset=None, match_len=0):
+	lit_len = len(literals)
+	token = min(lit_len, 15) << 4
+	if offset is not None:
+		token |= min(match_len - MIN_MATCH, 15)
+	out.append(token)
+	if lit_len >= 15:
+		put_length(out, lit_len - 15)
+	out += literals
+	if offset is None:
+		return
+	out += struct.pack("<H", offset)
+	if match_len - MIN_MATCH >= 15:
+		put_length(out, match_len - MIN_MATCH - 15)
+
+
+# Greedy, with the last position of each 4-byte sequence as the only
+# candidate, it's about what lz4's fast mode does. We only run it once
+# per build, the decompression speed is what matters here.
+def compress(src):
+	out = bytearray()
+	size = len(src)
+	last = {}
+	anchor = 0
+	i = 0
+	while i < size - MF_LIMIT:
+		key = src[i:i + MIN_MATCH]
+		cand = last.get(key)
+		last[key] = i
+		if cand is None or i - cand > MAX_OFFSET:
+			i += 1
+			continue
+		match_len = MIN_MATCH
+		limit = size - LAST_LITERALS
+		while i + match_len < limit and src[cand + match_len] == src[i + match_len]:
+			match_len += 1
+		put_sequence(out, src[anchor:i], i - cand, match_len)
+		for j in range(i + 1, min(i + match_len, size - MF_LIMIT)):
+			last[src[j:j + MIN_MATCH]] = j
+		i += match_len
+		anchor = i
+	put_sequence(out, src[anchor:])
+	return bytes(out)
+
+
+# Same as the boot stage, to make sure we got it right
+def decompress(src, raw_size):
+	out = bytearray()
+	i = 0
+	while True:
+		token = src[i]
+		i += 1
+		length = token >> 4
+		if length == 15:
+			while True:
+				b = src[i]
+				i += 1
+				length += b
+				if b != 255:
+					break
+		out += src[i:i + length]
+		i += length
+		if i >= len(src):
+			break
+		offset = src[i] | (src[i + 1] << 8)
+		i += 2
+		length = token & 15
+		if length == 15:
+			while True:
+				b = src[i]
+				i += 1
+				length += b
+				if b != 255:
+					break
+		length += MIN_MATCH
+		for _ in range(length):
+			out.append(out[-offset])
+	if len(out) != raw_size:
+		raise ValueError("decompressed %u bytes instead of %u" % (len(out), raw_size))
+	return bytes(out)
+
+
+def main(argv):
+	rom_size = None
+	if "--rom-size" in argv:
+		i = argv.index("--rom-size")
+		rom_size = int(argv[i + 1], 0)
+		del argv[i:i + 2]
+	if len(argv) != 4:
+		sys.stderr.write("Usage: %s <boot stage bin> <image bin> <output bin> [--rom-size <bytes>]\n" % argv[0])
+		return 1
+
+	with open(argv[1], "rb") as f:
+		boot = f.read()
+	with open(argv[2], "rb") as f:
+		image = f.read()
+
+	if len(boot) % 8:
+		sys.stderr.write("Boot stage isn't word aligned (%u bytes)\n" % len(boot))
+		return 1
+	if not image.endswith(LZ4_BOOT_TRAILER):
+		sys.stderr.write("%s doesn't end with the boot lottery words, not an LZ4_BOOT image ?\n" % argv[2])
+		return 1
+	image = image[:-len(LZ4_BOOT_TRAILER)]
+
+	block = compress(image)
+	if decompress(block, len(image)) != image:
+		sys.stderr.write("Compressed image doesn't match the original\n")
+		return 1
+
+	packed = boot + struct.pack("<IIII", LZ4_BOOT_MAGIC, len(image), len(block), 0) + block
+	if rom_size is not None and len(packed) > rom_size:
+		sys.stderr.write("Packed image is %u bytes, rom is only %u\n" % (len(packed), rom_size))
+		return 1
+	with open(argv[3], "wb") as f:
+		f.write(packed)
+
+	sys.stdout.write("%s: %u -> %u bytes (%.1f%%), boot stage %u bytes\n" %
+			 (argv[3], len(image), len(block), 100.0 * len(block) / max(len(image), 1), len(boot)))
+	return 0
+
+
+if __name__ == "__main__":
+	sys.exit(main(sys.argv))
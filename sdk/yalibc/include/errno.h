@@ -37,15 +37,20 @@ int *__errno_location(void);
 /* Memory errors */
 #define ENOMEM		12	/* Out of memory */
 #define ENOSPC		28	/* No space left on device */
+#define EFAULT		14	/* Bad address */
 
 /* Device/resource errors */
 #define ENODEV		19	/* No such device */
 #define ENOSYS		38	/* Function not implemented */
 #define ENOTSUP		95	/* Not supported */
 #define EBUSY		16	/* Device or resource busy */
+#define EPERM		 1	/* Operation not permitted */
+#define ENOENT		 2	/* No such file or directory */
+#define EEXIST		17	/* File exists */
 
 /* I/O errors */
 #define EIO		 5	/* I/O error */
+#define EBADF		 9	/* Bad file number */
 #define ETIME		62	/* Timer expired */
 #define EAGAIN		11	/* Try again */
 
@@ -0,0 +1,77 @@
+/*
+ * SPDX-FileType: SOURCE
+ *
+ * SPDX-FileCopyrightText: 2026 Nick Kossifidis <mick@ics.forth.gr>
+ * SPDX-FileCopyrightText: 2026 ICS/FORTH
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef _MALLOC_H
+#define _MALLOC_H
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <features.h>
+#include <stddef.h>	/* For size_t */
+#include <stdint.h>	/* For uintptr_t */
+
+/* Non-standard allocator extensions, the standard
+ * allocator API lives in stdlib.h */
+
+/* Size-class slab allocator for small objects (up to 4KB minus
+ * a word for the redzone) that may be freed in any order. Its
+ * objects are freed/resized through the usual free()/realloc(). */
+void *slab_alloc(size_t size);
+
+/* Page-frame allocator, num_pages contiguous page frames aligned to
+ * align (a power of two, at least PAGE_FRAME_SIZE, 0 for the default),
+ * taken from the top of the heap. They should be freed with the same
+ * num_pages, and are not zeroed. */
+#define PAGE_FRAME_SIZE	4096
+
+void *page_alloc(size_t num_pages, size_t align);
+void page_free(void *pages, size_t num_pages);
+
+/* Scoped arenas: private LIFO heaps for many short-lived allocations
+ * that get released together, by resetting the arena to a mark taken
+ * earlier. An arena should only be used by one hart. */
+struct arena;
+
+typedef struct {
+	uintptr_t top;
+	unsigned int count;
+} arena_mark_t;
+
+struct arena *arena_create(size_t size);
+void arena_destroy(struct arena *arena);
+void *arena_alloc(struct arena *arena, size_t size);
+arena_mark_t arena_mark(const struct arena *arena);
+void arena_reset_to(struct arena *arena, arena_mark_t mark);
+
+/* Allocator statistics, the counters are only there if yalibc was built
+ * with DEBUG and without NO_MALLOC_STATS, otherwise malloc_get_stats()
+ * returns -ENOTSUP and only fills in the heap_* / page / slab fields. */
+struct malloc_stats {
+	size_t heap_size;		/* From the start of the heap to __ram_end */
+	size_t heap_used;		/* Up to the top allocation (includes per-hart arenas) */
+	size_t heap_peak;		/* High watermark of heap_used */
+	size_t heap_free;		/* Between the top allocation and heap_end */
+	size_t slab_size;		/* Taken by slabs */
+	size_t pages_used;		/* Page frames allocated through page_alloc() */
+	size_t pages_free;		/* Free page frames in the page pool */
+	unsigned long allocs;		/* Successful allocations */
+	unsigned long frees;		/* Calls to free() / realloc(ptr, 0) */
+	unsigned long failures;		/* Failed allocations / resizes */
+	unsigned long lock_contended;	/* Times we had to wait for the global lock */
+	uint64_t lock_wait_cycles;	/* Cycles spent waiting for it */
+};
+
+int malloc_get_stats(struct malloc_stats *stats);
+void malloc_stats(void);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* _MALLOC_H */
@@ -32,6 +32,12 @@ extern "C" {
 /* We still need this for getchar */
 #define EOF -1
 
+/* There are no real streams behind FILE, stdout / stderr are
+ * just handles for fwrite, and both go to the uart. */
+typedef struct __yalc_file FILE;
+#define stdout	((FILE *) 1)
+#define stderr	((FILE *) 2)
+
 /* Note: *printf doesn't support wide chars, decimal floats, nor %n.
  * Wide chars and decimal floats are both conditional features
  * (__STDC_ISO_10646__, __STDC_IEC_60559_DFP__) so omitting them is
@@ -48,6 +54,7 @@ int vsnprintf(char* restrict outbuff, size_t outbuff_len, const char* restrict f
 int getchar(void);
 int putchar(int c);
 int puts(const char *s);
+size_t fwrite(const void * restrict ptr, size_t size, size_t nmemb, FILE * restrict stream);
 
 #ifdef __cplusplus
 }
@@ -30,9 +30,43 @@ void free(void *ptr);
 void *malloc(size_t size);
 void *realloc(void *ptr, size_t size);
 void *reallocarray(void *ptr, size_t nmemb, size_t size);
+void *aligned_alloc(size_t alignment, size_t size);
+
+#if !defined(__STRICT_ANSI__) || (_POSIX_C_SOURCE >= 200112L)
+int posix_memalign(void **memptr, size_t alignment, size_t size);
+#endif
 
 _Noreturn void abort(void);
 
+void *bsearch(const void *key, const void *base, size_t nmemb, size_t size,
+	      int (*compar)(const void *, const void *));
+void qsort(void *base, size_t nmemb, size_t size,
+	   int (*compar)(const void *, const void *));
+
+/* C23 Annex K - Bounds-checking interfaces */
+#if defined(__STDC_WANT_LIB_EXT1__) && __STDC_WANT_LIB_EXT1__ == 1
+#ifndef __errno_t_defined
+#define __errno_t_defined
+typedef int errno_t;
+#endif
+#ifndef __rsize_t_defined
+#define __rsize_t_defined
+typedef size_t rsize_t;
+#endif
+#define RSIZE_MAX (__SIZE_MAX__ >> 1)
+
+errno_t qsort_s(void *base, rsize_t nmemb, rsize_t size,
+		int (*compar)(const void *x, const void *y, void *context),
+		void *context);
+#endif
+
+#if !defined(__STRICT_ANSI__)
+/* Non-standard, on the same per-hart generators as rand() */
+unsigned long long rand64(void);
+void rand_fill(void *buf, size_t len);
+void srand_entropy(void);
+#endif
+
 #ifdef __cplusplus
 }
 #endif
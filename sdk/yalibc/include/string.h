@@ -61,6 +61,11 @@ size_t strnlen_s(const char *s, size_t maxsize);
 size_t strnlen(const char *s, size_t maxsize);
 #endif
 
+/* GNU extension, also part of POSIX.1-2024 - memmem */
+#if !defined(__STRICT_ANSI__) || (defined(_POSIX_C_SOURCE) && _POSIX_C_SOURCE >= 202405L)
+void *memmem(const void *haystack, size_t haystacklen, const void *needle, size_t needlelen);
+#endif
+
 #ifdef __cplusplus
 }
 #endif
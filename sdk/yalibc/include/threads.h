@@ -15,20 +15,73 @@ extern "C" {
 
 #include <features.h>
 #include <time.h>	/* For struct timespec */
+#include <stdatomic.h>	/* For C11 atomic types */
 
-/* We don't really support threads here, just thrd_sleep() */
+/*
+ * Threads here are cooperative green threads, each hart has its own
+ * run queue and a thread always runs on the hart that created it,
+ * switching only when it calls thrd_yield() or blocks (thrd_sleep(),
+ * thrd_join(), mtx_lock(), cnd_wait() etc). The code that was running
+ * on the hart before (e.g. main()) becomes its initial thread. Mutexes
+ * and condition variables may be shared between harts.
+ */
 
 /* Enumeration constants returned by functions
- * declared in threads.h (we just care about those
- * returned by thrd_sleep). */
+ * declared in threads.h */
 enum {
 	thrd_success = 0,
-	thrd_error = -1
+	thrd_error = -1,
+	thrd_busy = -2,
+	thrd_nomem = -3,
+	thrd_timedout = -4
+};
+
+/* Mutex types */
+enum {
+	mtx_plain = 0,
+	mtx_recursive = 1,
+	mtx_timed = 2
 };
 
+struct __thrd;
+typedef struct __thrd *thrd_t;
+typedef int (*thrd_start_t)(void *);
+
+typedef struct {
+	_Atomic(struct __thrd *) owner;
+	unsigned int count;
+	int type;
+} mtx_t;
+
+typedef struct {
+	atomic_uint seq;
+} cnd_t;
+
+int thrd_create(thrd_t *thr, thrd_start_t func, void *_Nullable arg);
+int thrd_equal(thrd_t thr0, thrd_t thr1);
+thrd_t thrd_current(void);
 int thrd_sleep(const struct timespec *req, struct timespec *_Nullable rem);
+void thrd_yield(void);
+_Noreturn void thrd_exit(int res);
+int thrd_detach(thrd_t thr);
+int thrd_join(thrd_t thr, int *_Nullable res);
+
+int mtx_init(mtx_t *mtx, int type);
+int mtx_lock(mtx_t *mtx);
+int mtx_timedlock(mtx_t *restrict mtx, const struct timespec *restrict ts);
+int mtx_trylock(mtx_t *mtx);
+int mtx_unlock(mtx_t *mtx);
+void mtx_destroy(mtx_t *mtx);
+
+int cnd_init(cnd_t *cond);
+int cnd_signal(cnd_t *cond);
+int cnd_broadcast(cnd_t *cond);
+int cnd_wait(cnd_t *cond, mtx_t *mtx);
+int cnd_timedwait(cnd_t *restrict cond, mtx_t *restrict mtx,
+		  const struct timespec *restrict ts);
+void cnd_destroy(cnd_t *cond);
 
 #ifdef __cplusplus
 }
 #endif
-#endif /* _THREADS_H */
\ No newline at end of file
+#endif /* _THREADS_H */
@@ -0,0 +1,37 @@
+/*
+ * SPDX-FileType: SOURCE
+ *
+ * SPDX-FileCopyrightText: 2026 Nick Kossifidis <mick@ics.forth.gr>
+ * SPDX-FileCopyrightText: 2026 ICS/FORTH
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef _UNISTD_H
+#define _UNISTD_H
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <features.h>
+#include <stddef.h>	/* For NULL/size_t */
+
+/* POSIX extension - write() for the standard descriptors
+ * There are no files here, only STDOUT_FILENO and STDERR_FILENO
+ * are valid and both go to the platform's uart (same as stdout). */
+#if defined(_POSIX_C_SOURCE) && _POSIX_C_SOURCE >= 200112L
+
+typedef long ssize_t;
+
+#define STDIN_FILENO	0
+#define STDOUT_FILENO	1
+#define STDERR_FILENO	2
+
+ssize_t write(int fd, const void *buf, size_t count);
+
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* _UNISTD_H */
@@ -7,13 +7,14 @@
  * SPDX-License-Identifier: Apache-2.0
  */
 
-#include <platform/utils/lock.h>	/* For lock_acquire/release() */
+#include <platform/utils/lock.h>	/* For sdk_lock_acquire/release() */
 #include <stdint.h>	/* For typed integers */
 #include <stdbool.h>	/* For bool */
 #include <errno.h>	/* For error codes */
 #include <string.h>	/* For strncpy/strnlen etc */
 #include <limits.h>	/* For INT_MAX */
 #include <stdio.h>
+#include <stdlib.h>	/* For malloc/free */
 
 /***********************\
 * Printf implementation *
@@ -27,6 +28,9 @@
 					 * per conversion, we use exactly that
 					 * as our implicit default precision. */
 
+#define YALC_LINEBUFF_LEN	128	/* Size of vprintf's line buffer, on
+					 * the caller's stack */
+
 enum format_flags {
 	FFLAG_ALT	= 0x01,
 	FFLAG_ZERO_PAD	= 0x02,
@@ -108,9 +112,15 @@ struct output_info {
 	char* outbuff;
 	size_t outbuff_len;
 	size_t chars_out;
+	/* For stdout (see vprintf) */
+	char* linebuff;
+	size_t linebuff_used;
+	bool locked;
 };
 
-static atomic_int printf_lock = 0;
+/* From stdio_misc.c */
+extern sdk_lock_t yalc_stdout_lock;
+extern void yalc_stdout_write(const char* restrict buff, size_t len);
 
 /*********\
 * Helpers *
@@ -459,11 +469,35 @@ yalc_pf_parse_format(const char* restrict fmt, int fmt_len, struct format_info*
  * cases we move on to the next character, so to avoid
  * duplication/complexity define a function that processes a
  * character in both cases. */
+static void
+yalc_pf_stdout_write(const char* restrict buff, size_t len, struct output_info* out)
+{
+	/* Once we start sending the message out keep the lock
+	 * until we are done with it (see vprintf) */
+	if (!out->locked) {
+		sdk_lock_acquire(&yalc_stdout_lock);
+		out->locked = true;
+	}
+	yalc_stdout_write(buff, len);
+}
+
+static void
+yalc_pf_flush(struct output_info* out)
+{
+	if (!out->linebuff_used)
+		return;
+
+	yalc_pf_stdout_write(out->linebuff, out->linebuff_used, out);
+	out->linebuff_used = 0;
+}
+
 static void
 yalc_pf_char_out(char in, struct output_info* out)
 {
 	if (!out->outbuff) {
-		putchar(in);
+		out->linebuff[out->linebuff_used++] = in;
+		if (out->linebuff_used == YALC_LINEBUFF_LEN)
+			yalc_pf_flush(out);
 	} else if (out->outbuff_len > 0) {
 		if (out->chars_out < out->outbuff_len - 1)
 			out->outbuff[out->chars_out] = in;
@@ -478,10 +512,21 @@ static void
 yalc_pf_chars_out(const char* restrict in, size_t in_len, bool reverse,
 		  struct output_info* restrict out)
 {
-	if (reverse)
+	if (reverse) {
 		for (size_t i = in_len; i-- > 0; )
 			yalc_pf_char_out(in[i], out);
-	else
+	} else if (!out->outbuff && in_len >= YALC_LINEBUFF_LEN - out->linebuff_used) {
+		/* Doesn't fit in the line buffer (e.g. a long %s), send
+		 * what we have so far and then the whole thing at once,
+		 * instead of going through the line buffer in pieces */
+		yalc_pf_flush(out);
+		yalc_pf_stdout_write(in, in_len, out);
+		out->chars_out += in_len;
+	} else if (!out->outbuff) {
+		memcpy(out->linebuff + out->linebuff_used, in, in_len);
+		out->linebuff_used += in_len;
+		out->chars_out += in_len;
+	} else
 		for (size_t i = 0; i < in_len; i++)
 			yalc_pf_char_out(in[i], out);
 }
@@ -545,6 +590,7 @@ yalc_pf_field_out(const struct field_data* restrict fld,
 			yalc_pf_chars_out(fld->prefix, fld->prefix_len, fi->flags & TRFLAG_REVERSE_PREFIX, out);
 			yalc_pf_pad(width_pad, '0', out);
 		}
+		yalc_pf_pad(prebuf_pad, '0', out);
 		yalc_pf_chars_out(fld->inbuff, fld->inbuff_len, fi->flags & TRFLAG_REVERSE_NUM, out);
 		yalc_pf_pad(postbuf_pad, '0', out);
 		yalc_pf_chars_out(fld->suffix, fld->suffix_len, fi->flags & TRFLAG_REVERSE_SUFFIX, out);
@@ -606,47 +652,65 @@ yalc_pf_field_out_simple(const struct field_data* restrict fld,
 /* The longest representation is the binary one for %b/B*/
 #define INTBUFF_LEN	64
 
+/* "00" to "99", so that we can do two decimal digits per division
+ * (also used in ryu.c) */
+const char yalc_digit_pairs[] =
+	"00010203040506070809"
+	"10111213141516171819"
+	"20212223242526272829"
+	"30313233343536373839"
+	"40414243444546474849"
+	"50515253545556575859"
+	"60616263646566676869"
+	"70717273747576777879"
+	"80818283848586878889"
+	"90919293949596979899";
+
+static const char yalc_hex_digits[2][17] = {
+	"0123456789abcdef",
+	"0123456789ABCDEF"
+};
+
+/* Write val in num_buff backwards, this is used for doubles where
+ * the code that follows expects the digits reversed, see yalc_itoa()
+ * below for integers. */
 static int
 yalc_itora(char* restrict num_buff, uintmax_t val, struct format_info* restrict fi)
 {
-	int digit = 0;
 	int i = 0;
-	const char dec_base = '0';
-	const char hex_base = (fi->flags & SFLAG_UPPERCASE) ? 'A' : 'a';
+	const char *hex_digits = yalc_hex_digits[(fi->flags & SFLAG_UPPERCASE) ? 1 : 0];
 
-	/* Write val in num_buff backwards, we do it like this
-	 * so that the compiler can optimize div/mod with a
-	 * constant. */
 	switch (fi->radix) {
 		case RADIX_DEC:
-			do {
-				digit = val % 10;
-				num_buff[i++] = dec_base + digit;
-				val /= 10;
-			} while (val);
+			/* Two digits per step, least significant first */
+			while (val >= 100) {
+				const unsigned int pair = (unsigned int)(val % 100) * 2;
+				val /= 100;
+				num_buff[i++] = yalc_digit_pairs[pair + 1];
+				num_buff[i++] = yalc_digit_pairs[pair];
+			}
+			if (val >= 10) {
+				num_buff[i++] = yalc_digit_pairs[val * 2 + 1];
+				num_buff[i++] = yalc_digit_pairs[val * 2];
+			} else
+				num_buff[i++] = '0' + (char) val;
 			break;
 		case RADIX_HEX:
 			do {
-				digit = val % 16;
-				if (digit < 10)
-					num_buff[i++] = dec_base + digit;
-				else
-					num_buff[i++] = hex_base + digit - 10;
-				val /= 16;
+				num_buff[i++] = hex_digits[val & 0xF];
+				val >>= 4;
 			} while (val);
 			break;
 		case RADIX_OCT:
 			do {
-				digit = val % 8;
-				num_buff[i++] = dec_base + digit;
-				val /= 8;
+				num_buff[i++] = '0' + (char)(val & 0x7);
+				val >>= 3;
 			} while (val);
 			break;
 		case RADIX_BIN:
 			do {
-				digit = val % 2;
-				num_buff[i++] = dec_base + digit;
-				val /= 2;
+				num_buff[i++] = '0' + (char)(val & 0x1);
+				val >>= 1;
 			} while (val);
 			break;
 		default:
@@ -657,6 +721,52 @@ yalc_itora(char* restrict num_buff, uintmax_t val, struct format_info* restrict
 	return i;
 }
 
+/* Write val in num_buff in the order it'll be printed, so that it doesn't
+ * need to be reversed on output. We first get the number of digits, and
+ * then fill them in from the end, two at a time for decimal (one division
+ * by 100 instead of two by 10), and with shifts / masks for the power of
+ * two radixes, where the number of digits comes from the top set bit. */
+static size_t
+yalc_itoa(char* restrict num_buff, uintmax_t val, const struct format_info* restrict fi)
+{
+	size_t len = 1;
+
+	if (fi->radix == RADIX_DEC) {
+		/* 10^19 is the largest power of ten that fits in 64bits */
+		for (uintmax_t c = 10; len < 20 && c <= val; c *= 10)
+			len++;
+
+		char *digit = num_buff + len;
+		while (val >= 100) {
+			const unsigned int pair = (unsigned int)(val % 100) * 2;
+			val /= 100;
+			digit -= 2;
+			digit[0] = yalc_digit_pairs[pair];
+			digit[1] = yalc_digit_pairs[pair + 1];
+		}
+		if (val >= 10) {
+			digit[-2] = yalc_digit_pairs[val * 2];
+			digit[-1] = yalc_digit_pairs[val * 2 + 1];
+		} else
+			digit[-1] = '0' + (char) val;
+		return len;
+	}
+
+	const int shift = (fi->radix == RADIX_HEX) ? 4 : (fi->radix == RADIX_OCT) ? 3 : 1;
+	const unsigned int mask = (1U << shift) - 1;
+	const char *hex_digits = yalc_hex_digits[(fi->flags & SFLAG_UPPERCASE) ? 1 : 0];
+	if (val) {
+		const int bits = sizeof(uintmax_t) * 8 - __builtin_clzll(val);
+		len = (bits + shift - 1) / shift;
+	}
+
+	for (size_t i = len; i-- > 0; ) {
+		num_buff[i] = hex_digits[val & mask];
+		val >>= shift;
+	}
+	return len;
+}
+
 static void
 yalc_putll(uintmax_t val, struct format_info* restrict fi, struct output_info* restrict out)
 {
@@ -699,13 +809,13 @@ yalc_putll(uintmax_t val, struct format_info* restrict fi, struct output_info* r
 		break;
 	}
 
-	size_t len = yalc_itora(num_buff, val, fi);
+	size_t len = yalc_itoa(num_buff, val, fi);
 
 	/* "For o conversion, it increases the precision, if and only if necessary,
 	 * to force the first digit of the result to be a zero (if the value and
 	 * precision are both 0, a single 0 is printed)." */
 	if (fi->radix == RADIX_OCT && (fi->flags & FFLAG_ALT)) {
-		if (((num_buff[len - 1] != '0')) &&
+		if (((num_buff[0] != '0')) &&
 		    (fi->precision <= len)) {
 			fi->flags |= SFLAG_HAS_PREC;
 			fi->precision = len + 1;
@@ -741,6 +851,7 @@ yalc_putll(uintmax_t val, struct format_info* restrict fi, struct output_info* r
 
 #define EXPONENT_BITS	11
 #define EXPONENT_MASK	((1U << EXPONENT_BITS) - 1)
+#define EXPONENT_BIAS	1023
 #define SIGNIFICAND_BITS 52
 #define SIGNIFICAND_MASK ((1ULL << SIGNIFICAND_BITS) - 1)
 static const char *nan_str[2] = {"nan", "NAN"};
@@ -750,6 +861,15 @@ static const char *inf_str[2] = {"inf", "INF"};
 extern void yalc_double_to_decimal(uint32_t exponent_biased, uint64_t significand,
 				   int32_t* exponent10, uint64_t* fraction10);
 extern uint64_t yalc_round_to_digits(uint64_t value, int current_digits, int desired_digits);
+/* Exact fixed precision digits (also in ryu.c), the longest expansion
+ * of a double has 767 significant digits, plus a block of 9 for slack
+ * and one for the decimal point */
+extern int yalc_double_to_fixed(uint32_t exponent_biased, uint64_t significand, int precision,
+				bool e_form, char* digits, int max_len, int32_t* point);
+#define FIXEDBUFF_MAX_DIGITS	767
+#define FIXEDBUFF_SLACK		(9 + 1)
+/* Enough for the usual precisions / magnitudes, the rest go on the heap */
+#define FIXEDBUFF_STACK_LEN	(64 + FIXEDBUFF_SLACK)
 
 static size_t
 yalc_count_digits(uint64_t val, int radix)
@@ -777,6 +897,119 @@ yalc_count_digits(uint64_t val, int radix)
 	return len;
 }
 
+/* Upper bound on the digits yalc_double_to_fixed() may produce */
+static int
+yalc_fixed_max_digits(uint32_t exponent_biased, int precision, bool e_form)
+{
+	if (precision >= FIXEDBUFF_MAX_DIGITS)
+		return FIXEDBUFF_MAX_DIGITS;
+	int num = precision + 1;
+	if (!e_form) {
+		/* The value is below 2^bits, so the integer part has up to
+		 * bits * log10(2) + 1 digits (log10(2) ~= 78913 / 2^18), plus
+		 * one more if rounding carries into a new digit */
+		const int bits = (exponent_biased ? (int) exponent_biased : 1) - EXPONENT_BIAS + 1;
+		num = precision + ((bits > 0) ? ((bits * 78913) >> 18) + 2 : 1);
+	}
+	return (num < FIXEDBUFF_MAX_DIGITS) ? num : FIXEDBUFF_MAX_DIGITS;
+}
+
+/* f/e-form with the exact digits, prefix already has the sign (unless it's
+ * passed in sign_char for zero-padding). Hart stacks are small, so only
+ * the usual cases get their digits on the stack, long expansions (large
+ * integer parts / precisions, up to 767 digits) go on the heap, and if
+ * that fails they get truncated to what fits on the stack, the rest
+ * printed as zeroes. Kept out of yalc_putd() for the other forms. */
+static void __attribute__((noinline))
+yalc_putd_fixed(uint32_t exponent_biased, uint64_t significand, char* restrict prefix,
+		size_t prefix_len, char sign_char, struct format_info* restrict fi,
+		struct output_info* restrict out)
+{
+	char stack_digits[FIXEDBUFF_STACK_LEN];
+	char suffix[6];		/* [e/E][+/-]XXX */
+	const bool e_form = (fi->flags & SFLAG_IS_GFORM) == SFLAG_IS_EFORM;
+	int digits_len = yalc_fixed_max_digits(exponent_biased, fi->precision, e_form) +
+			 FIXEDBUFF_SLACK;
+	char* heap_digits = NULL;
+	char* digits = stack_digits;
+	if (digits_len > FIXEDBUFF_STACK_LEN) {
+		heap_digits = malloc(digits_len);
+		if (heap_digits)
+			digits = heap_digits;
+		else
+			digits_len = FIXEDBUFF_STACK_LEN;
+	}
+	const char* num = digits;
+	size_t len = 0;
+	size_t suffix_len = 0;
+	const bool add_point = fi->precision || (fi->flags & FFLAG_ALT);
+	int32_t point = 0;
+
+	/* The value is 0.digits x 10^point */
+	int num_digits = yalc_double_to_fixed(exponent_biased, significand, fi->precision, e_form,
+					      digits, digits_len - 1, &point);
+
+	if (e_form) {
+		/* d.ddd[e/E][+/-]XX, with at least precision digits after
+		 * the decimal point */
+		const int32_t exp_val = point - 1;
+		prefix[prefix_len++] = digits[0];
+		if (add_point)
+			prefix[prefix_len++] = '.';
+		num = digits + 1;
+		len = num_digits - 1;
+		fi->num_pad = fi->precision - len;
+
+		suffix[suffix_len++] = (fi->flags & SFLAG_UPPERCASE) ? 'E' : 'e';
+		suffix[suffix_len++] = (exp_val < 0) ? '-' : '+';
+		if (exp_val > -10 && exp_val < 10)
+			suffix[suffix_len++] = '0';
+		fi->radix = RADIX_DEC;
+		suffix_len += yalc_itoa(suffix + suffix_len, (exp_val < 0) ? -exp_val : exp_val, fi);
+	} else if (!num_digits) {
+		/* Rounds to zero, 0.000... */
+		prefix[prefix_len++] = '0';
+		if (add_point)
+			prefix[prefix_len++] = '.';
+		fi->suffix_pad = fi->precision;
+	} else if (point <= 0) {
+		/* 0.<-point zeroes><digits><zeroes up to precision> */
+		prefix[prefix_len++] = '0';
+		prefix[prefix_len++] = '.';
+		len = num_digits;
+		fi->num_pad = point;
+		fi->suffix_pad = fi->precision + point - num_digits;
+	} else if (num_digits <= point) {
+		/* <digits><zeroes up to the point>.<precision zeroes> */
+		len = num_digits;
+		fi->num_pad = point - num_digits;
+		if (add_point) {
+			suffix[suffix_len++] = '.';
+			fi->suffix_pad = fi->precision;
+		}
+	} else {
+		/* <digits>.<digits><zeroes up to precision>, move the
+		 * fractional digits to make room for the point */
+		for (int i = num_digits; i > point; i--)
+			digits[i] = digits[i - 1];
+		digits[point] = '.';
+		len = num_digits + 1;
+		fi->suffix_pad = fi->precision - (num_digits - point);
+	}
+
+	struct field_data fld = {
+		.inbuff = num,
+		.inbuff_len = len,
+		.prefix = prefix,
+		.prefix_len = prefix_len,
+		.suffix = suffix,
+		.suffix_len = suffix_len,
+		.sign_char = sign_char
+	};
+	yalc_pf_field_out(&fld, fi, out);
+	free(heap_digits);
+}
+
 void __attribute__((weak))
 yalc_putd(double in, struct format_info* restrict fi, struct output_info* restrict out)
 {
@@ -864,7 +1097,7 @@ yalc_putd(double in, struct format_info* restrict fi, struct output_info* restri
 			prefix[prefix_len++] = '0';
 			if (((fi->flags & SFLAG_IS_GFORM) != SFLAG_IS_GFORM) ||
 			    (fi->flags & FFLAG_ALT)) {
-				if (fi->precision) {
+				if (fi->precision || (fi->flags & FFLAG_ALT)) {
 					prefix[prefix_len++] = '.';
 					fi->num_pad = fi->precision;
 				}
@@ -893,6 +1126,14 @@ yalc_putd(double in, struct format_info* restrict fi, struct output_info* restri
 
 	/* Extract the 2-bit form field (bits 22-24) */
 	const int form = (fi->flags >> 22) & 7;
+
+	/* f/e-form get the exact digits, g-form works on the
+	 * shortest representation (see below) */
+	if (form < 3) {
+		yalc_putd_fixed(exponent_biased, significand, prefix, prefix_len, sign_char, fi, out);
+		return;
+	}
+
 	int frac_digits = 0;
 	int int_digits = 0;
 	int decimal_digits = 0;
@@ -1437,12 +1678,18 @@ sprintf(char* restrict outbuff, const char* restrict fmt, ...)
 int
 vprintf(const char* restrict fmt, va_list va)
 {
+	/* Format the message into a line buffer on our stack without
+	 * holding any lock, and only acquire yalc_stdout_lock when sending
+	 * it out, so that we don't have two instances printing at the
+	 * same time. Longer messages are sent out in chunks, holding
+	 * the lock from the first chunk until the end. */
+	char linebuff[YALC_LINEBUFF_LEN];
 	struct output_info out = {0};
-	/* Acquire lock so that we don't have two instances
-	 * printing at the same time. */
-	lock_acquire(&printf_lock);
+	out.linebuff = linebuff;
 	int ret = yalc_xprintf(&out, fmt, &va);
-	lock_release(&printf_lock);
+	yalc_pf_flush(&out);
+	if (out.locked)
+		sdk_lock_release(&yalc_stdout_lock);
 	return ret;
 }
 
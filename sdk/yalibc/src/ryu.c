@@ -85,8 +85,9 @@
  *
  * In order for this to work, we need int128 support from the compiler,
  * GCC supports this for all 64bit architectures so we should be ok. Note
- * that we won't go for arbitrary precision here, we'll use the standard
- * Ryu instead of Ryu printf, and return the shortest representation instead.
+ * that we won't go for Ryu printf's tables here, we use the standard Ryu
+ * for the shortest representation (%g), and generate the exact digits for
+ * fixed precision (%f / %e) further below.
  *
  * Although I like Ryu, when there are size/arch constraints where we can't
  * use int128 (e.g. on 32bit targets), or the lookup tables, so an alternative
@@ -539,4 +540,323 @@ yalc_round_to_digits(uint64_t value, int current_digits, int desired_digits)
 		quotient++;
 
 	return quotient;
-}
\ No newline at end of file
+}
+/*
+ * Fixed precision (%f / %e)
+ *
+ * The shortest representation is what we want for %g, but for %f / %e with
+ * a given precision we need the digits of the exact value the double holds
+ * (0.1 is really 0.1000000000000000055511151231257827...), rounded as a
+ * whole at the requested position, rounding the shortest representation
+ * instead gets the digits past the 17th wrong, and double-rounds ties (e.g.
+ * 1.4999999999999999e-7 -> 1.5e-7 -> 2e-7 for %.0e).
+ *
+ * Ryu printf does this with ~100KB of tables, which is way too much for
+ * our ROM, instead we generate the exact expansion nine digits at a time:
+ * the integer part by dividing it with 10^9 and the fractional part by
+ * multiplying it with 10^9 and taking what overflows the binary point, and
+ * stop as soon as we have enough digits for rounding. Since every binary
+ * fraction has a finite decimal expansion we also stop when the fraction
+ * runs out and we know the rest is zeroes. For the common case (|x| < 2^64
+ * and exponent >= -64) all of this fits in 64/128bit integers, then a %.6f
+ * is a single 64x64 multiplication, otherwise we use a small bignum with
+ * 32bit limbs on the stack (up to 1074 + 53 bits).
+ */
+
+#define BLOCK_DIGITS	9
+#define BLOCK_BASE	1000000000U
+#define BIGNUM_LIMBS	36
+
+/* From printf.c */
+extern const char yalc_digit_pairs[];
+
+static const uint64_t POW10_TABLE[20] = {
+	1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL, 10000000ULL,
+	100000000ULL, 1000000000ULL, 10000000000ULL, 100000000000ULL,
+	1000000000000ULL, 10000000000000ULL, 100000000000000ULL,
+	1000000000000000ULL, 10000000000000000ULL, 100000000000000000ULL,
+	1000000000000000000ULL, 10000000000000000000ULL
+};
+
+/* Write val in exactly num digits (zero-padded), two at a time from the end */
+static void
+fixed_write_digits(char* digits, uint64_t val, int num)
+{
+	while (num >= 2) {
+		const unsigned int pair = (unsigned int) (val % 100) * 2;
+		val /= 100;
+		num -= 2;
+		digits[num] = yalc_digit_pairs[pair];
+		digits[num + 1] = yalc_digit_pairs[pair + 1];
+	}
+	if (num)
+		digits[0] = '0' + (char) (val % 10);
+}
+
+static int
+fixed_count_digits(uint64_t val)
+{
+	int num = 1;
+	while (num < 20 && val >= POW10_TABLE[num])
+		num++;
+	return num;
+}
+
+struct fixed_state {
+	char* digits;
+	int len;
+	int max_len;
+	int32_t point;
+};
+
+/* Write a block of (up to) 9 digits, skipping any leading zeroes if
+ * we don't have any digits yet (they only move the decimal point) */
+static void
+fixed_put_block(struct fixed_state* st, uint32_t block, bool is_fraction)
+{
+	char tmp[BLOCK_DIGITS];
+	int num = BLOCK_DIGITS;
+
+	fixed_write_digits(tmp, block, BLOCK_DIGITS);
+
+	int skip = 0;
+	if (!st->len) {
+		while (skip < BLOCK_DIGITS && tmp[skip] == '0')
+			skip++;
+		if (is_fraction)
+			st->point -= skip;
+	}
+
+	num -= skip;
+	if (!is_fraction)
+		st->point += num;
+	if (num > st->max_len - st->len)
+		num = st->max_len - st->len;
+	for (int i = 0; i < num; i++)
+		st->digits[st->len++] = tmp[skip + i];
+}
+
+static void
+fixed_put_uint64(struct fixed_state* st, uint64_t val)
+{
+	if (val >= (uint64_t) BLOCK_BASE * BLOCK_BASE)
+		fixed_put_block(st, (uint32_t) (val / BLOCK_BASE / BLOCK_BASE), false);
+	if (val >= BLOCK_BASE)
+		fixed_put_block(st, (uint32_t) ((val / BLOCK_BASE) % BLOCK_BASE), false);
+	fixed_put_block(st, (uint32_t) (val % BLOCK_BASE), false);
+}
+
+/* Integer part >= 2^64 (so it doesn't have a fractional part), convert
+ * all of it by dividing with 10^9 and then write the blocks in order. */
+static void
+fixed_put_bigint(struct fixed_state* st, uint64_t fraction2, int32_t exponent2)
+{
+	uint32_t limbs[BIGNUM_LIMBS] = { 0 };
+	uint32_t blocks[BIGNUM_LIMBS] = { 0 };
+	int num_limbs = (exponent2 / 32) + 3;
+	int num_blocks = 0;
+
+	const int shift = exponent2 % 32;
+	const uint128_t shifted = ((uint128_t) fraction2) << shift;
+	limbs[exponent2 / 32] = (uint32_t) shifted;
+	limbs[exponent2 / 32 + 1] = (uint32_t) (shifted >> 32);
+	limbs[exponent2 / 32 + 2] = (uint32_t) (shifted >> 64);
+
+	while (num_limbs > 0) {
+		uint64_t rem = 0;
+		for (int i = num_limbs; i-- > 0; ) {
+			const uint64_t cur = (rem << 32) | limbs[i];
+			limbs[i] = (uint32_t) (cur / BLOCK_BASE);
+			rem = cur % BLOCK_BASE;
+		}
+		blocks[num_blocks++] = (uint32_t) rem;
+		while (num_limbs > 0 && !limbs[num_limbs - 1])
+			num_limbs--;
+	}
+
+	while (num_blocks-- > 0)
+		fixed_put_block(st, blocks[num_blocks], false);
+}
+
+/* How many digits we need to keep, for %e it's the precision + 1, for %f it
+ * depends on where the decimal point is (may be <= 0 if the value is smaller
+ * than the last digit we keep). */
+static inline int
+fixed_digits_needed(const struct fixed_state* st, int precision, bool e_form)
+{
+	return e_form ? precision + 1 : st->point + precision;
+}
+
+/*
+ * Fills digits with the decimal expansion of the double, rounded to precision
+ * digits after the decimal point (f-form), or to precision + 1 significant
+ * digits (e-form), with ties to even. Trailing zeroes are dropped, and the
+ * value is 0.digits x 10^point, if it rounds to zero it returns 0. Doesn't
+ * handle zero / infinity / NaN. The caller should provide a buffer large
+ * enough for the longest expansion (767 significant digits) plus a block.
+ */
+int
+yalc_double_to_fixed(uint32_t exponent_biased, uint64_t significand, int precision,
+		     bool e_form, char* digits, int max_len, int32_t* point)
+{
+	struct fixed_state st = { .digits = digits, .len = 0, .max_len = max_len, .point = 0 };
+	uint64_t fraction2 = significand;
+	int32_t exponent2 = -1074;
+	bool has_fraction = false;
+	/* Fast path for the fractional part, up to 64 bits */
+	uint64_t frac64 = 0;
+	int frac_bits = 0;
+	/* Otherwise a fixed-point bignum, num_limbs x 32 bits after the binary point */
+	uint32_t limbs[BIGNUM_LIMBS];
+	int num_limbs = 0;
+	int low_limb = 0;
+
+	if (exponent_biased) {
+		fraction2 |= 1ULL << SIGNIFICAND_BITS;
+		exponent2 = (int32_t) exponent_biased - EXPONENT_BIAS - SIGNIFICAND_BITS;
+	}
+
+	/* Fast path for %f with up to 19 digits after the point, when the
+	 * integer part fits in 64bits and the fractional part in 64bits,
+	 * a single multiplication with 10^precision gives us all the
+	 * fractional digits we need and what's left for rounding. */
+	if (!e_form && precision < 20 && exponent2 > -64 && exponent2 <= 11) {
+		uint64_t int_part = (exponent2 >= 0) ? fraction2 << exponent2 :
+						       fraction2 >> -exponent2;
+		uint64_t frac_part = 0;
+		if (exponent2 < 0) {
+			const int frac_bits = -exponent2;
+			const uint64_t mask = (1ULL << frac_bits) - 1;
+			const uint128_t scaled = ((uint128_t) (fraction2 & mask)) * POW10_TABLE[precision];
+			const uint64_t rem = (uint64_t) scaled & mask;
+			const uint64_t half = 1ULL << (frac_bits - 1);
+
+			frac_part = (uint64_t) (scaled >> frac_bits);
+			/* With no fractional digits, the last digit we keep is the
+			 * integer part's */
+			const bool odd = (precision ? frac_part : int_part) & 1;
+			if (rem > half || (rem == half && odd)) {
+				frac_part++;
+				if (frac_part == POW10_TABLE[precision]) {
+					frac_part = 0;
+					int_part++;
+				}
+			}
+		}
+
+		int len = 0;
+		if (int_part) {
+			len = fixed_count_digits(int_part);
+			fixed_write_digits(digits, int_part, len);
+			*point = len;
+			fixed_write_digits(digits + len, frac_part, precision);
+			len += precision;
+		} else if (frac_part) {
+			len = fixed_count_digits(frac_part);
+			fixed_write_digits(digits, frac_part, len);
+			*point = len - precision;
+		}
+
+		while (len > 0 && digits[len - 1] == '0')
+			len--;
+		return len;
+	}
+
+	/* Integer part */
+	if (exponent2 > 11)
+		fixed_put_bigint(&st, fraction2, exponent2);
+	else if (exponent2 >= 0)
+		fixed_put_uint64(&st, fraction2 << exponent2);
+	else if (exponent2 > -64) {
+		frac_bits = -exponent2;
+		frac64 = fraction2 & ((1ULL << frac_bits) - 1);
+		has_fraction = (frac64 != 0);
+		fixed_put_uint64(&st, fraction2 >> frac_bits);
+	} else {
+		/* No integer part, the fraction is limbs / 2^(num_limbs * 32) */
+		frac_bits = -exponent2;
+		num_limbs = (frac_bits + 31) / 32;
+		const int shift = num_limbs * 32 - frac_bits;
+		const uint128_t shifted = ((uint128_t) fraction2) << shift;
+		for (int i = 0; i < num_limbs; i++)
+			limbs[i] = 0;
+		limbs[0] = (uint32_t) shifted;
+		if (num_limbs > 1)
+			limbs[1] = (uint32_t) (shifted >> 32);
+		if (num_limbs > 2)
+			limbs[2] = (uint32_t) (shifted >> 64);
+		has_fraction = true;
+	}
+
+	/* Fractional part, until we have one more digit than we need
+	 * (for rounding), or we know the rest are zeroes. */
+	while (has_fraction && st.len <= fixed_digits_needed(&st, precision, e_form)) {
+		uint32_t block = 0;
+
+		/* Way below the last digit we keep, rounds to zero */
+		if (!st.len && fixed_digits_needed(&st, precision, e_form) < 0)
+			return 0;
+
+		if (!num_limbs) {
+			const uint128_t cur = ((uint128_t) frac64) * BLOCK_BASE;
+			block = (uint32_t) (cur >> frac_bits);
+			frac64 = (uint64_t) cur & ((1ULL << frac_bits) - 1);
+			has_fraction = (frac64 != 0);
+		} else {
+			uint64_t carry = 0;
+			for (int i = low_limb; i < num_limbs; i++) {
+				const uint64_t cur = ((uint64_t) limbs[i]) * BLOCK_BASE + carry;
+				limbs[i] = (uint32_t) cur;
+				carry = cur >> 32;
+			}
+			block = (uint32_t) carry;
+			/* Multiplying by 10^9 also multiplies by 2^9, so the
+			 * low limbs become zero as we go. */
+			while (low_limb < num_limbs && !limbs[low_limb])
+				low_limb++;
+			has_fraction = (low_limb < num_limbs);
+		}
+
+		if (!st.len && !block) {
+			st.point -= BLOCK_DIGITS;
+			continue;
+		}
+		fixed_put_block(&st, block, true);
+	}
+
+	/* Round at the digit after the last one we keep, anything
+	 * left in the fraction (or in the digits after it) makes it
+	 * more than half way through. */
+	const int keep = fixed_digits_needed(&st, precision, e_form);
+	if (keep < 0)
+		return 0;
+	if (keep < st.len) {
+		const char round_digit = digits[keep];
+		bool sticky = has_fraction;
+		for (int i = keep + 1; !sticky && i < st.len; i++)
+			sticky = (digits[i] != '0');
+		const bool odd = (keep > 0) && ((digits[keep - 1] - '0') & 1);
+
+		st.len = keep;
+		if (round_digit > '5' || (round_digit == '5' && (sticky || odd))) {
+			int i = keep - 1;
+			while (i >= 0 && digits[i] == '9')
+				digits[i--] = '0';
+			if (i >= 0)
+				digits[i]++;
+			else {
+				/* 9.99 -> 10.0, or 0.9 -> 1 */
+				digits[0] = '1';
+				if (!st.len)
+					st.len = 1;
+				st.point++;
+			}
+		}
+	}
+
+	while (st.len > 0 && digits[st.len - 1] == '0')
+		st.len--;
+
+	*point = st.point;
+	return st.len;
+}
@@ -7,10 +7,19 @@
  * SPDX-License-Identifier: Apache-2.0
  */
 
-#include <platform/interfaces/uart.h>	/* For uart_putc/getc() */
-#include <errno.h>			/* For EAGAIN */
+#include <platform/interfaces/uart.h>	/* For uart_putc/getc/write_buf() */
+#include <platform/utils/lock.h>	/* For sdk_lock_acquire/release() */
+#include <errno.h>			/* For EAGAIN, EBADF */
+#include <stddef.h>			/* For size_t */
+#include <stdint.h>			/* For SIZE_MAX */
+#include <string.h>			/* For strlen() */
+#include <unistd.h>			/* For write() */
 #include <stdio.h>
 
+/* Held while sending a message out, so that messages from
+ * different harts don't get mixed up (also used by vprintf) */
+sdk_lock_t yalc_stdout_lock = SDK_LOCK_INIT;
+
 int
 putchar(int c)
 {
@@ -18,6 +27,45 @@ putchar(int c)
 	return (int) c;
 }
 
+/* Send a buffer to stdout, used by vprintf (with
+ * yalc_stdout_lock held) */
+void
+yalc_stdout_write(const char* restrict buff, size_t len)
+{
+	uart_write_buf(buff, len);
+}
+
+size_t
+fwrite(const void * restrict ptr, size_t size, size_t nmemb, FILE * restrict stream)
+{
+	if (stream != stdout && stream != stderr)
+		return 0;
+	if (!size || !nmemb)
+		return 0;
+	/* Can't be more than what's addressable */
+	if (nmemb > SIZE_MAX / size)
+		return 0;
+
+	sdk_lock_acquire(&yalc_stdout_lock);
+	uart_write_buf(ptr, size * nmemb);
+	sdk_lock_release(&yalc_stdout_lock);
+	return nmemb;
+}
+
+ssize_t
+write(int fd, const void *buf, size_t count)
+{
+	if (fd != STDOUT_FILENO && fd != STDERR_FILENO) {
+		errno = EBADF;
+		return -1;
+	}
+
+	sdk_lock_acquire(&yalc_stdout_lock);
+	uart_write_buf(buf, count);
+	sdk_lock_release(&yalc_stdout_lock);
+	return (ssize_t) count;
+}
+
 int
 getchar(void)
 {
@@ -38,8 +86,9 @@ getchar(void)
 int
 puts(const char *s)
 {
-	while (*s)
-		putchar(*s++);
-	putchar('\n');
+	sdk_lock_acquire(&yalc_stdout_lock);
+	uart_write_buf(s, strlen(s));
+	uart_write_buf("\n", 1);
+	sdk_lock_release(&yalc_stdout_lock);
 	return 0;
 }
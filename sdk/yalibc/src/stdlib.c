@@ -7,49 +7,183 @@
  * SPDX-License-Identifier: Apache-2.0
  */
 
+#define __STDC_WANT_LIB_EXT1__ 1	/* For qsort_s() */
 #include <stdint.h>	/* For typed ints */
 #include <stddef.h>	/* For size_t / NULL */
-#include <string.h>	/* For memset() */
+#include <stdbool.h>	/* For bool */
+#include <string.h>	/* For memset()/memcpy() */
 #include <errno.h>	/* For errno and ENOMEM */
-#include <platform/utils/lock.h>	/* For lock_acquire/release() */
+#include <stdio.h>	/* For printf() */
+#include <platform/utils/lock.h>	/* For sdk_lock_acquire/release() */
 #include <platform/utils/utils.h>	/* For console output */
+#include <platform/interfaces/rng.h>	/* For rng_get_seed() */
+#include <stdatomic.h>	/* For C11 atomics */
 #include <stdlib.h>
+#include <malloc.h>
 
 /***********************\
 * RAND() Implementation *
 \***********************/
 
-/* xorshift64 - lightweight PRNG, Code is in the public domain.*/
+/*
+ * Each hart has its own xoshiro256** generator (by David Blackman and
+ * Sebastiano Vigna, public domain), so harts don't race on / bounce the
+ * cache line of a shared state. srand() / srand_entropy() set a global
+ * seed, that every hart expands (through splitmix64) to the same 256bit
+ * state and jumps ahead by 2^128 outputs per hart index, so the streams
+ * of different harts don't overlap. Harts pick up a new seed lazily, on
+ * their next call, by comparing its generation with theirs.
+ */
 
 /* This nothing-up-my-sleeve number comes from RFC3526 (pi in hex) */
 #define DEFAULT_SEED 0xC90FDAA22168C234ULL
 
-static uint64_t xorshift64_state = DEFAULT_SEED;
+struct rand_state {
+	uint64_t s[4];
+	unsigned int gen;	/* Seed generation s came from */
+};
+
+/* Per-hart slot for it (6 words), from the platform layer */
+extern void *__rand_state_location(uint16_t *hart_idx);
+_Static_assert(sizeof(struct rand_state) <= 6 * sizeof(uint64_t),
+	       "struct rand_state doesn't fit in its per-hart slot");
+
+static _Atomic(uint64_t) rand_seed = DEFAULT_SEED;
+static atomic_uint rand_seed_gen = 1;
+
+static inline uint64_t
+rand_rotl(const uint64_t x, int k)
+{
+	return (x << k) | (x >> (64 - k));
+}
+
+static inline uint64_t
+splitmix64_next(uint64_t *x)
+{
+	uint64_t z = (*x += 0x9E3779B97F4A7C15ULL);
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+	return z ^ (z >> 31);
+}
 
 static inline uint64_t
-xorshift64_next(void)
+xoshiro256ss_next(uint64_t *s)
+{
+	const uint64_t result = rand_rotl(s[1] * 5, 7) * 9;
+	const uint64_t t = s[1] << 17;
+	s[2] ^= s[0];
+	s[3] ^= s[1];
+	s[1] ^= s[2];
+	s[0] ^= s[3];
+	s[2] ^= t;
+	s[3] = rand_rotl(s[3], 45);
+	return result;
+}
+
+/* Equivalent to 2^128 calls to xoshiro256ss_next() */
+static void
+xoshiro256ss_jump(uint64_t *s)
+{
+	static const uint64_t jump[] = { 0x180EC6D33CFD0ABAULL, 0xD5A61266F0C9392CULL,
+					 0xA9582618E03FC9AAULL, 0x39ABDC4529B1661CULL };
+	uint64_t j[4] = { 0 };
+	for (int i = 0; i < 4; i++) {
+		for (int b = 0; b < 64; b++) {
+			if (jump[i] & (1ULL << b)) {
+				j[0] ^= s[0];
+				j[1] ^= s[1];
+				j[2] ^= s[2];
+				j[3] ^= s[3];
+			}
+			xoshiro256ss_next(s);
+		}
+	}
+	memcpy(s, j, sizeof(j));
+}
+
+static void __attribute__((noinline))
+rand_reseed(struct rand_state *rs, uint16_t hart_idx, unsigned int gen)
+{
+	uint64_t x = atomic_load_explicit(&rand_seed, memory_order_relaxed);
+	for (int i = 0; i < 4; i++)
+		rs->s[i] = splitmix64_next(&x);
+	for (uint16_t i = 0; i < hart_idx; i++)
+		xoshiro256ss_jump(rs->s);
+	rs->gen = gen;
+}
+
+static inline struct rand_state *
+rand_get_state(void)
 {
-	uint64_t x = xorshift64_state;
-	x ^= x << 13;
-	x ^= x >> 7;
-	x ^= x << 17;
-	xorshift64_state = x;
-	return x;
+	uint16_t hart_idx = 0;
+	struct rand_state *rs = __rand_state_location(&hart_idx);
+	const unsigned int gen = atomic_load_explicit(&rand_seed_gen, memory_order_acquire);
+	if (__builtin_expect(rs->gen != gen, 0))
+		rand_reseed(rs, hart_idx, gen);
+	return rs;
+}
+
+static void
+rand_set_seed(uint64_t seed)
+{
+	atomic_store_explicit(&rand_seed, seed, memory_order_relaxed);
+	atomic_fetch_add_explicit(&rand_seed_gen, 1, memory_order_release);
 }
 
 void
 srand(unsigned int seed)
 {
-	xorshift64_state = seed ^ DEFAULT_SEED;
-	if (!xorshift64_state)
-		xorshift64_state = DEFAULT_SEED;
+	rand_set_seed(seed ^ DEFAULT_SEED);
+}
+
+/* Seed all harts from the platform's entropy sources (Zkr when available) */
+void
+srand_entropy(void)
+{
+	const uint64_t hi = rng_get_seed();
+	rand_set_seed((hi << 32) | rng_get_seed());
 }
 
 int
 rand(void)
 {
-	/* Return positive int in range [0, RAND_MAX] */
-	return (int)(xorshift64_next() % RAND_MAX);;
+	/* Return positive int in range [0, RAND_MAX) */
+	return (int)(xoshiro256ss_next(rand_get_state()->s) >> 34);
+}
+
+unsigned long long
+rand64(void)
+{
+	return xoshiro256ss_next(rand_get_state()->s);
+}
+
+/* Fill buf with len random bytes, with the state in registers
+ * and word stores for the aligned part */
+void
+rand_fill(void *buf, size_t len)
+{
+	struct rand_state *rs = rand_get_state();
+	uint8_t *dst = buf;
+	uint64_t s[4];
+	uint64_t val = 0;
+
+	memcpy(s, rs->s, sizeof(s));
+	/* Unaligned head, up to 7 bytes from one output */
+	if ((uintptr_t) dst & (sizeof(uint64_t) - 1)) {
+		val = xoshiro256ss_next(s);
+		for (; len && ((uintptr_t) dst & (sizeof(uint64_t) - 1)); len--, val >>= 8)
+			*dst++ = (uint8_t) val;
+	}
+	uint64_t *dst_words = (uint64_t *) dst;
+	for (; len >= sizeof(uint64_t); len -= sizeof(uint64_t))
+		*dst_words++ = xoshiro256ss_next(s);
+	dst = (uint8_t *) dst_words;
+	if (len) {
+		val = xoshiro256ss_next(s);
+		for (; len; len--, val >>= 8)
+			*dst++ = (uint8_t) val;
+	}
+	memcpy(rs->s, s, sizeof(s));
 }
 
 
@@ -66,30 +200,134 @@ rand(void)
  * add an extra uintptr_t at the end of each allocation that holds metadata for the
  * allocation, allowing ust to free in the reverse order that we allocated, and also
  * catch memory corruption cases.
+ *
+ * Next to it there is a size-class slab allocator (slab_alloc) for small objects that
+ * need to be freed out of order, and free()/realloc() will route its pointers back to
+ * it. Its slabs come from a page-frame allocator (page_alloc) that takes pages from the
+ * top of the heap (so they don't get in the way of the LIFO allocations), and is also
+ * used for page tables, DMA rings etc.
+ *
+ * If the platform tells us that the heap is zeroed on boot, we also track the part of
+ * each heap that was never handed out (its "clean" region), so that calloc() doesn't
+ * need to clear memory that's still zero.
  */
 
  /* External values from the linker, through boot.S (.srodata.ldvars section) */
 extern const uintptr_t __stack_start;
 extern const uintptr_t __ram_end;
 
-/* Allocator's state */
-static atomic_int alloc_lock = 0;
-static uintptr_t heap_end = 0;
-static uintptr_t last_alloc_end = 0;
-static size_t total_alloc_size = 0;
-static unsigned int alloc_count = 0;
-
-/* This may be used by other allocators (e.g. for pages/page tables) to use
- * the top part of the heap and leave the rest for this one. */
-uintptr_t
-__adjust_heap_end(uintptr_t new_heap_end)
-{
-	lock_acquire(&alloc_lock);
-	if ((new_heap_end <= __ram_end) && (new_heap_end > last_alloc_end))
-		heap_end = new_heap_end;
-	uintptr_t result = heap_end;
-	lock_release(&alloc_lock);
-	return result;
+/* Per-hart arena slot, from the platform layer (NULL if there is only one hart) */
+extern void **__heap_arena_location(void);
+
+/* Also from the platform layer, true if RAM is zeroed on reset */
+extern bool __heap_zeroed_on_boot(void);
+
+/* State of a LIFO heap, the global one spans [__stack_start, heap_end) and
+ * each hart's arena is carved out of it (see below). Memory in [clean_start,
+ * clean_end) hasn't been written since boot, and is still zero. */
+struct heap {
+	uintptr_t start;
+	uintptr_t end;
+	uintptr_t last_alloc_end;
+	size_t total_alloc_size;
+	unsigned int alloc_count;
+	uintptr_t clean_start;
+	uintptr_t clean_end;
+	/* Per-hart arenas only (see below) */
+	struct heap *next_arena;
+	_Atomic(void *) remote_frees;
+	void *pending_frees;
+};
+
+/* Allocator's state, alloc_lock covers the global heap, the page-frame
+ * allocator and the slabs (that come from it), per-hart arenas don't
+ * need it, except when they are created. */
+static sdk_lock_t alloc_lock = SDK_LOCK_INIT;
+static struct heap global_heap = { 0 };
+
+/* Called with alloc_lock held */
+static inline void
+heap_init(void)
+{
+	if (!global_heap.start) {
+		global_heap.start = __stack_start;
+		global_heap.last_alloc_end = __stack_start;
+		if (__heap_zeroed_on_boot()) {
+			global_heap.clean_start = __stack_start;
+			global_heap.clean_end = __ram_end;
+		}
+	}
+	if (!global_heap.end)
+		global_heap.end = __ram_end;
+}
+
+/*
+ * Allocator statistics, on by default for debug builds, define
+ * NO_MALLOC_STATS to compile them out.
+ */
+#if defined(DEBUG) && !defined(NO_MALLOC_STATS)
+#define MALLOC_STATS
+#endif
+
+#if defined(MALLOC_STATS)
+static struct {
+	/* Updated from the lock-free paths too */
+	atomic_ulong allocs;
+	atomic_ulong frees;
+	atomic_ulong failures;
+	/* Updated with alloc_lock held */
+	unsigned long lock_contended;
+	uint64_t lock_wait_cycles;
+	size_t heap_peak;
+} alloc_stats;
+
+#define ALLOC_STAT_INC(_field) \
+	atomic_fetch_add_explicit(&alloc_stats._field, 1, memory_order_relaxed)
+#else
+#define ALLOC_STAT_INC(_field) do {} while (0)
+#endif
+
+static inline void
+alloc_lock_acquire(void)
+{
+#if defined(MALLOC_STATS)
+	if (sdk_lock_try_acquire(&alloc_lock))
+		return;
+	const uint64_t start = csr_read(CSR_MCYCLE);
+	sdk_lock_acquire(&alloc_lock);
+	alloc_stats.lock_wait_cycles += csr_read(CSR_MCYCLE) - start;
+	alloc_stats.lock_contended++;
+#else
+	sdk_lock_acquire(&alloc_lock);
+#endif
+}
+
+static inline void
+alloc_lock_release(void)
+{
+#if defined(MALLOC_STATS)
+	/* Everything that grows the global heap happens
+	 * with the lock held, so this is a good spot to
+	 * track its high watermark. */
+	const size_t heap_used = global_heap.last_alloc_end - global_heap.start;
+	if (heap_used > alloc_stats.heap_peak)
+		alloc_stats.heap_peak = heap_used;
+#endif
+	sdk_lock_release(&alloc_lock);
+}
+
+/* Update the counters based on what a realloc() call did */
+static inline void
+alloc_stats_update(const void *ptr, size_t size, const void *result)
+{
+	if (size && !result)
+		ALLOC_STAT_INC(failures);
+	else if (!ptr && result)
+		ALLOC_STAT_INC(allocs);
+	else if (ptr && !size)
+		ALLOC_STAT_INC(frees);
+	(void) ptr;
+	(void) result;
 }
 
 /* Some helper macros */
@@ -102,31 +340,452 @@ __adjust_heap_end(uintptr_t new_heap_end)
  * to also verify the allocator's consistency. */
 #define METADATA_AC_MASK	(ALLOC_ALIGN - 1)
 
+
+/*
+ * Page-frame allocator
+ *
+ * Page frames come from the top of the heap, the pool of pages grows
+ * downwards (lowering heap_end) when there is no free run of pages that
+ * fits a request, and shrinks back when the pages at its bottom get freed,
+ * so that the LIFO heap can use them again. Each page of the heap has a
+ * byte in the page map (placed at the top of RAM on first use) that marks
+ * it as free, or as the first / next page of an allocation, so that we can
+ * verify page_free() calls, and tell if a pointer belongs to a slab.
+ */
+
+#define PF_SIZE			PAGE_FRAME_SIZE
+#define PF_ALIGN_UP(x)		(((x) + PF_SIZE - 1) & ~((uintptr_t) PF_SIZE - 1))
+
+enum pf_state {
+	PF_FREE		= 0,
+	PF_HEAD		= 1,	/* First page of an allocation */
+	PF_TAIL		= 2,	/* Next pages */
+	PF_STATE_MASK	= 3,
+	PF_SLAB		= 4,	/* Allocation is a slab */
+};
+
+/* Pages that go to the page pool get dirty, and don't come back clean
+ * when they return to the heap. */
+static inline void
+heap_lower_clean_end(struct heap *h, uintptr_t end)
+{
+	if (h->clean_end > end)
+		h->clean_end = end;
+}
+
+/* Page allocator's state, the pool is [pf_floor, pf_top) */
+static uint8_t *pf_map = NULL;
+static uintptr_t pf_base = 0;
+static uintptr_t pf_floor = 0;
+static uintptr_t pf_top = 0;
+static size_t pf_used_pages = 0;
+static size_t pf_slab_pages = 0;
+
+static inline uint8_t*
+pf_entry(uintptr_t addr)
+{
+	return &pf_map[(addr - pf_base) / PF_SIZE];
+}
+
+/* Put the page map at the top of RAM, called with alloc_lock held */
+static bool
+pf_init(void)
+{
+	if (pf_map)
+		return true;
+
+	heap_init();
+	pf_base = ALIGN_DOWN(global_heap.start, PF_SIZE);
+	const uintptr_t ram_top = ALIGN_DOWN(__ram_end, PF_SIZE);
+	const size_t map_size = PF_ALIGN_UP((ram_top - pf_base) / PF_SIZE);
+	const uintptr_t map = ram_top - map_size;
+	if (map < PF_ALIGN_UP(global_heap.last_alloc_end) || map > global_heap.end)
+		return false;
+
+	pf_map = (uint8_t*) map;
+	pf_floor = pf_top = map;
+	global_heap.end = map;
+	heap_lower_clean_end(&global_heap, map);
+	DBG("page map at 0x%lx (%lu bytes)\n", map, map_size);
+	return true;
+}
+
+static inline bool
+pf_run_is_free(uintptr_t start, size_t num_pages)
+{
+	for (size_t i = 0; i < num_pages; i++)
+		if ((*pf_entry(start + i * PF_SIZE) & PF_STATE_MASK) != PF_FREE)
+			return false;
+	return true;
+}
+
+/* Allocate num_pages contiguous frames, aligned to align (a power of two
+ * multiple of PF_SIZE), called with alloc_lock held. */
+static uintptr_t
+pf_alloc(size_t num_pages, size_t align, uint8_t flags)
+{
+	if (!pf_init())
+		return 0;
+
+	const size_t run_size = num_pages * PF_SIZE;
+	uintptr_t start = 0;
+
+	/* First fit from the free pages in the pool, starting from the top
+	 * so that the bottom of the pool is more likely to be freed up, and
+	 * go back to the heap. */
+	if (pf_top - pf_floor >= run_size) {
+		for (uintptr_t addr = ALIGN_DOWN(pf_top - run_size, align);
+		     addr >= pf_floor; addr -= align) {
+			if (pf_run_is_free(addr, num_pages)) {
+				start = addr;
+				break;
+			}
+			if (addr < align)
+				break;
+		}
+	}
+
+	/* None fits, grow the pool downwards, re-using any
+	 * free pages right above its current floor. */
+	if (!start) {
+		uintptr_t run_end = pf_floor;
+		while (run_end < pf_top && (*pf_entry(run_end) & PF_STATE_MASK) == PF_FREE)
+			run_end += PF_SIZE;
+
+		const uintptr_t heap_top = PF_ALIGN_UP(global_heap.last_alloc_end);
+		if (run_end < heap_top + run_size)
+			return 0;
+		start = ALIGN_DOWN(run_end - run_size, align);
+		if (start < heap_top)
+			return 0;
+
+		for (uintptr_t addr = start; addr < pf_floor; addr += PF_SIZE)
+			*pf_entry(addr) = PF_FREE;
+		pf_floor = start;
+		global_heap.end = start;
+		heap_lower_clean_end(&global_heap, start);
+	}
+
+	*pf_entry(start) = PF_HEAD | flags;
+	for (size_t i = 1; i < num_pages; i++)
+		*pf_entry(start + i * PF_SIZE) = PF_TAIL | flags;
+	pf_used_pages += num_pages;
+	if (flags & PF_SLAB)
+		pf_slab_pages += num_pages;
+	return start;
+}
+
 void*
-realloc(void *ptr, size_t size)
+page_alloc(size_t num_pages, size_t align)
 {
-	/* Do we even have anough heap for the allocator ? */
-	if (__stack_start + __SIZEOF_POINTER__ >= __ram_end)
+	if (!align)
+		align = PF_SIZE;
+	if (!num_pages || num_pages > (SIZE_MAX / PF_SIZE) ||
+	    (align & (align - 1)) || align < PF_SIZE)
 		return NULL;
 
-	void *result = NULL;
+	alloc_lock_acquire();
+	void *result = (void*) pf_alloc(num_pages, align, 0);
+	alloc_lock_release();
+	alloc_stats_update(NULL, num_pages * PF_SIZE, result);
+	return result;
+}
+
+void
+page_free(void *pages, size_t num_pages)
+{
+	const uintptr_t start = (uintptr_t) pages;
+	if (!pages || !num_pages)
+		return;
+
+	alloc_lock_acquire();
+
+	/* Make sure this is exactly one (non-slab) allocation */
+	if (!pf_map || start < pf_floor || (start & (PF_SIZE - 1)) ||
+	    num_pages > (pf_top - start) / PF_SIZE || *pf_entry(start) != PF_HEAD)
+		goto err;
+	for (size_t i = 1; i < num_pages; i++)
+		if (*pf_entry(start + i * PF_SIZE) != PF_TAIL)
+			goto err;
+	const uintptr_t end = start + num_pages * PF_SIZE;
+	if (end < pf_top && *pf_entry(end) == PF_TAIL)
+		goto err;
+
+	for (size_t i = 0; i < num_pages; i++)
+		*pf_entry(start + i * PF_SIZE) = PF_FREE;
+	pf_used_pages -= num_pages;
+
+	/* Give any free pages at the bottom of the pool back to the heap */
+	while (pf_floor < pf_top && *pf_entry(pf_floor) == PF_FREE)
+		pf_floor += PF_SIZE;
+	global_heap.end = pf_floor;
+
+	alloc_lock_release();
+	ALLOC_STAT_INC(frees);
+	return;
+
+ err:
+	ERR("Invalid page_free() of %lu pages at 0x%lx !\n", num_pages, start);
+	abort();
+}
+
+
+/*
+ * Size-class slab allocator
+ *
+ * Each slab is a SLAB_SIZE aligned block with a small header, followed by
+ * objects of a single power of two size class (16B - 4KB). Every class has
+ * its own free list, threaded through the free objects, so both allocation
+ * and (out of order) free are O(1). Slabs come from the page-frame allocator
+ * and are never freed, its page map tells us if a pointer belongs to a slab.
+ * The last word of each object is a
+ * redzone that's XORed with the object's address and differs between free
+ * and allocated objects, so that we can catch overflows, double frees and
+ * bogus pointers.
+ */
+
+#define SLAB_SIZE		(16 * 1024)
+#define SLAB_HDR_SIZE		64
+#define SLAB_MIN_SHIFT		4
+#define SLAB_MAX_SHIFT		12
+#define SLAB_NUM_CLASSES	(SLAB_MAX_SHIFT - SLAB_MIN_SHIFT + 1)
+#define SLAB_REDZONE		__SIZEOF_POINTER__
+#define SLAB_MAX_USABLE		((1UL << SLAB_MAX_SHIFT) - SLAB_REDZONE)
+#define SLAB_MAGIC		0x51AB51AB0BADC0DEULL
+#define SLAB_RZ_USED		0xA110CA7EDA110CA7ULL
+#define SLAB_RZ_FREE		0xF4EEF4EEF4EEF4EEULL
+
+struct slab_hdr {
+	uintptr_t magic;	/* SLAB_MAGIC ^ address of the slab */
+	unsigned int class_idx;
+};
+
+static void *slab_free_list[SLAB_NUM_CLASSES];
+
+static inline bool
+slab_owns(const void *ptr)
+{
+	uintptr_t addr = (uintptr_t) ptr;
+	return pf_map && (addr >= pf_floor) && (addr < pf_top) && (*pf_entry(addr) & PF_SLAB);
+}
+
+static inline unsigned int
+slab_class_idx(size_t size)
+{
+	size += SLAB_REDZONE;
+	if (size <= (1UL << SLAB_MIN_SHIFT))
+		return 0;
+	return (__SIZEOF_LONG__ * 8 - __builtin_clzl(size - 1)) - SLAB_MIN_SHIFT;
+}
+
+static inline size_t
+slab_class_size(unsigned int class_idx)
+{
+	return 1UL << (class_idx + SLAB_MIN_SHIFT);
+}
+
+static inline uintptr_t*
+slab_redzone(uintptr_t obj, size_t obj_size)
+{
+	return (uintptr_t*)(obj + obj_size - SLAB_REDZONE);
+}
+
+/* Grab a new slab from the page allocator and put its objects
+ * on the class's free list, called with alloc_lock held. */
+static bool
+slab_grow(unsigned int class_idx)
+{
+	const uintptr_t slab = pf_alloc(SLAB_SIZE / PF_SIZE, SLAB_SIZE, PF_SLAB);
+	if (!slab)
+		return false;
+
+	struct slab_hdr *hdr = (struct slab_hdr*) slab;
+	hdr->magic = SLAB_MAGIC ^ slab;
+	hdr->class_idx = class_idx;
+
+	const size_t obj_size = slab_class_size(class_idx);
+	for (uintptr_t obj = slab + SLAB_HDR_SIZE; obj + obj_size <= slab + SLAB_SIZE;
+	     obj += obj_size) {
+		*slab_redzone(obj, obj_size) = SLAB_RZ_FREE ^ obj;
+		*(void**)obj = slab_free_list[class_idx];
+		slab_free_list[class_idx] = (void*)obj;
+	}
+
+	DBG("new slab at 0x%lx for %lu byte objects\n", slab, obj_size);
+	return true;
+}
+
+/* Verify that ptr is the start of an allocated slab object
+ * and return its size, aborts on corruption / bogus pointers. */
+static size_t
+slab_obj_size(const void *ptr)
+{
+	const uintptr_t obj = (uintptr_t) ptr;
+	const uintptr_t slab = ALIGN_DOWN(obj, SLAB_SIZE);
+	const struct slab_hdr *hdr = (const struct slab_hdr*) slab;
+
+	if (hdr->magic != (SLAB_MAGIC ^ slab) || hdr->class_idx >= SLAB_NUM_CLASSES)
+		goto err;
+
+	const size_t obj_size = slab_class_size(hdr->class_idx);
+	if ((obj < slab + SLAB_HDR_SIZE) || ((obj - slab - SLAB_HDR_SIZE) & (obj_size - 1)) ||
+	    (obj + obj_size > slab + SLAB_SIZE))
+		goto err;
+
+	const uintptr_t redzone = *slab_redzone(obj, obj_size);
+	if (redzone == (SLAB_RZ_FREE ^ obj)) {
+		ERR("Double free of slab object at 0x%lx !\n", obj);
+		abort();
+	} else if (redzone != (SLAB_RZ_USED ^ obj))
+		goto err;
+
+	return obj_size;
+ err:
+	ERR("Detected memory corruption at 0x%lx !\n", obj);
+	abort();
+	__builtin_unreachable();
+}
+
+static void*
+slab_alloc_obj(size_t size)
+{
+	if (!size || size > SLAB_MAX_USABLE)
+		return NULL;
+
+	const unsigned int class_idx = slab_class_idx(size);
+	const size_t obj_size = slab_class_size(class_idx);
+	uintptr_t obj = 0;
+
+	alloc_lock_acquire();
+	heap_init();
+
+	if (!slab_free_list[class_idx] && !slab_grow(class_idx))
+		goto done;
+
+	/* A free object's redzone and next pointer should be intact, if not
+	 * someone wrote past the previous object or used it after free. */
+	obj = (uintptr_t) slab_free_list[class_idx];
+	void *next = *(void**)obj;
+	if ((*slab_redzone(obj, obj_size) != (SLAB_RZ_FREE ^ obj)) ||
+	    (next && !slab_owns(next))) {
+		ERR("Detected memory corruption at 0x%lx !\n", obj);
+		abort();
+	}
+	slab_free_list[class_idx] = next;
+	*slab_redzone(obj, obj_size) = SLAB_RZ_USED ^ obj;
+
+ done:
+	alloc_lock_release();
+	return (void*) obj;
+}
+
+static void
+slab_free(void *ptr)
+{
+	alloc_lock_acquire();
+	const size_t obj_size = slab_obj_size(ptr);
+	const unsigned int class_idx = slab_class_idx(obj_size - SLAB_REDZONE);
+	const uintptr_t obj = (uintptr_t) ptr;
+
+	*slab_redzone(obj, obj_size) = SLAB_RZ_FREE ^ obj;
+	*(void**)ptr = slab_free_list[class_idx];
+	slab_free_list[class_idx] = ptr;
+	alloc_lock_release();
+}
+
+static void *heap_route_realloc(void *ptr, size_t size, size_t *dirty);
+
+static void*
+slab_realloc(void *ptr, size_t size)
+{
+	if (!size) {
+		slab_free(ptr);
+		return NULL;
+	}
+
+	alloc_lock_acquire();
+	const size_t usable_size = slab_obj_size(ptr) - SLAB_REDZONE;
+	alloc_lock_release();
+
+	/* Still fits, nothing to do */
+	if (size <= usable_size)
+		return ptr;
+
+	/* Move it to a larger class, or to the LIFO heap if it doesn't
+	 * fit in a slab. On failure leave the original untouched. */
+	void *new_ptr = (size <= SLAB_MAX_USABLE) ? slab_alloc_obj(size) : heap_route_realloc(NULL, size, NULL);
+	if (!new_ptr)
+		return NULL;
+	memcpy(new_ptr, ptr, usable_size);
+	slab_free(ptr);
+	return new_ptr;
+}
+
+void*
+slab_alloc(size_t size)
+{
+	void *result = slab_alloc_obj(size);
+	alloc_stats_update(NULL, size, result);
+	return result;
+}
+
+/* Verify the metadata of the top allocation and return its start */
+static uintptr_t
+heap_last_alloc(const struct heap *h)
+{
+	const uintptr_t *last_metadata_ptr = (uintptr_t*)(h->last_alloc_end - (__SIZEOF_POINTER__));
+	if (!h->alloc_count ||
+	    (*last_metadata_ptr & METADATA_AC_MASK) != (h->alloc_count & METADATA_AC_MASK))
+		goto err;
+	const size_t last_metadata_size = *last_metadata_ptr & (~METADATA_AC_MASK);
+	const uintptr_t start_ptr = h->start + last_metadata_size;
+	const size_t last_alloc_size = h->total_alloc_size - last_metadata_size;
+	if (last_alloc_size != (h->last_alloc_end - start_ptr))
+		goto err;
+	return start_ptr;
+
+ err:
+	ERR("Detected memory corruption at 0x%lx !\n", h->last_alloc_end);
+	abort();
+	__builtin_unreachable();
+}
+
+/* Aligned allocations (see heap_memalign) start after some padding, with
+ * this tag (XORed with the start of the allocation) right before them. */
+#define HEAP_ALIGNED_TAG	0xA11C0DEDA11C0DEDULL
+
+/* Check if ptr is the top allocation, where start_ptr is the
+ * start of the top allocation from heap_last_alloc() */
+static inline bool
+heap_is_top(const struct heap *h, const void *ptr, uintptr_t start_ptr)
+{
+	const uintptr_t addr = (uintptr_t) ptr;
+	if (addr == start_ptr)
+		return true;
+	return (addr > start_ptr) && (addr < h->last_alloc_end) && !(addr & (ALLOC_ALIGN - 1)) &&
+	       (*((const uintptr_t*)ptr - 1) == (HEAP_ALIGNED_TAG ^ start_ptr));
+}
+
+static inline bool
+heap_owns(const struct heap *h, const void *ptr)
+{
+	return ((uintptr_t) ptr >= h->start) && ((uintptr_t) ptr < h->end);
+}
+
+/* The LIFO allocator itself, the caller handles locking */
+static void*
+heap_realloc(struct heap *h, void *ptr, size_t size)
+{
 	/* This is used so that we don't try to increase
 	 * the alloc_count on realloc. */
 	int new_alloc = 0;
 	uintptr_t saved_metadata_val = 0;
 
-	lock_acquire(&alloc_lock);
-
-	if (!last_alloc_end)
-		last_alloc_end = __stack_start;
-	if (!heap_end)
-		heap_end = __ram_end;
-
 	/* ptr == NULL -> New allocation */
 	if (ptr == NULL) {
 		if (!size)
-			goto done;
-		ptr = (void*)last_alloc_end;
+			return NULL;
+		ptr = (void*)h->last_alloc_end;
 		new_alloc = 1;
  alloc:
 		/* Align size up to pointer size, and add an extra uintptr_t
@@ -136,61 +795,286 @@ realloc(void *ptr, size_t size)
 		const uintptr_t end_ptr = start_ptr + aligned_size + (__SIZEOF_POINTER__);
 
 		/* Check if we have enough space, and if so do the (re)allocation */
-		if (end_ptr > heap_end)
-			goto done;
-		last_alloc_end = end_ptr;
-		alloc_count += new_alloc;
+		if (end_ptr > h->end || end_ptr < start_ptr)
+			return NULL;
+		h->last_alloc_end = end_ptr;
+		h->alloc_count += new_alloc;
+		if (end_ptr > h->clean_start)
+			h->clean_start = end_ptr;
 
 		/* Populate metadata, if this is a resize and not a new allocation
 		 * preserve the existing metadata instead. */
 		uintptr_t *metadata_ptr = (uintptr_t*)(start_ptr + aligned_size);
 		if (new_alloc)
-			*metadata_ptr = (total_alloc_size | (alloc_count & METADATA_AC_MASK));
+			*metadata_ptr = (h->total_alloc_size | (h->alloc_count & METADATA_AC_MASK));
 		else
 			*metadata_ptr = saved_metadata_val;
-		total_alloc_size = (end_ptr - __stack_start);
-		result = (void*)start_ptr;
-		DBG("(re)allocation at 0x%lx, total_alloc_size: %z, alloc_count: %u\n",
-		    start_ptr, total_alloc_size, alloc_count);
-		goto done;
+		h->total_alloc_size = (end_ptr - h->start);
+		DBG("(re)allocation at 0x%lx, total_alloc_size: %zu, alloc_count: %u\n",
+		    start_ptr, h->total_alloc_size, h->alloc_count);
+		return (void*)start_ptr;
 	}
 
-	/* ptr != NULL -> Free/Resize last allocation */
-	if (!alloc_count)
-		goto err;
-
-	/* Verify metadata consistency and make sure ptr points to the start of last allocation */
-	const uintptr_t *last_metadata_ptr = (uintptr_t*)(last_alloc_end - (__SIZEOF_POINTER__));
-	if ((*last_metadata_ptr & METADATA_AC_MASK) != (alloc_count & METADATA_AC_MASK))
-		goto err;
-	const size_t last_metadata_size = *last_metadata_ptr & (~METADATA_AC_MASK);
-	const uintptr_t start_ptr = __stack_start + last_metadata_size;
-	const size_t last_alloc_size = total_alloc_size - last_metadata_size;
-	if (last_alloc_size != (last_alloc_end - start_ptr))
-		goto err;
-	if ((uintptr_t)ptr != start_ptr)
-		goto done;
+	/* ptr != NULL -> Free/Resize last allocation, verify metadata
+	 * consistency and make sure ptr points to its start */
+	const uintptr_t start_ptr = heap_last_alloc(h);
+	if (!heap_is_top(h, ptr, start_ptr))
+		return NULL;
 
 	/* Try to realloc, if it fails we won't modify allocator's state
 	 * or metadata, so that the caller can retry with different sizes. */
 	if (size) {
-		saved_metadata_val = *last_metadata_ptr;
+		saved_metadata_val = *(uintptr_t*)(h->last_alloc_end - (__SIZEOF_POINTER__));
 		goto alloc;
 	}
 
-	/* free -> rewind to previous allocation */
-	last_alloc_end = start_ptr;
-	total_alloc_size -= last_alloc_size;
-	alloc_count--;
+	/* free -> rewind to previous allocation, also clear the tag
+	 * of an aligned allocation so that it doesn't match again. */
+	if ((uintptr_t)ptr != start_ptr)
+		*((uintptr_t*)ptr - 1) = 0;
+	h->total_alloc_size -= (h->last_alloc_end - start_ptr);
+	h->last_alloc_end = start_ptr;
+	h->alloc_count--;
+	return NULL;
+}
 
- done:
-	lock_release(&alloc_lock);
+/* A new allocation that also reports how much of it may be dirty (non-zero),
+ * i.e. the part below clean_start, or all of it if it goes past clean_end. */
+static void*
+heap_alloc(struct heap *h, size_t size, size_t *dirty)
+{
+	const uintptr_t start_ptr = h->last_alloc_end;
+	const uintptr_t clean_start = h->clean_start;
+	void *result = heap_realloc(h, NULL, size);
+	if (!result || !dirty)
+		return result;
+
+	if (clean_start >= h->clean_end || start_ptr + size > h->clean_end)
+		*dirty = size;
+	else if (clean_start > start_ptr)
+		*dirty = (clean_start - start_ptr < size) ? clean_start - start_ptr : size;
+	else
+		*dirty = 0;
 	return result;
+}
 
- err:
-	ERR("Detected memory corruption at 0x%lx !\n", ptr);
-	abort();
-	__builtin_unreachable();
+/* Allocate with a larger than ALLOC_ALIGN alignment, by padding the start
+ * of a normal allocation. The padding is part of the allocation so that
+ * free() rewinds over it, and the tag before the returned pointer lets
+ * heap_is_top() recognize it. */
+static void*
+heap_memalign(struct heap *h, size_t alignment, size_t size)
+{
+	if (alignment <= ALLOC_ALIGN)
+		return heap_realloc(h, NULL, size);
+
+	const uintptr_t start_ptr = h->last_alloc_end;
+	const uintptr_t aligned_ptr = (start_ptr + alignment - 1) & ~(alignment - 1);
+	if (aligned_ptr < start_ptr || aligned_ptr - start_ptr > h->end - start_ptr)
+		return NULL;
+
+	const size_t padding = aligned_ptr - start_ptr;
+	if (size > SIZE_MAX - padding || !heap_realloc(h, NULL, padding + size))
+		return NULL;
+
+	if (padding)
+		*((uintptr_t*)aligned_ptr - 1) = HEAP_ALIGNED_TAG ^ start_ptr;
+	return (void*)aligned_ptr;
+}
+
+
+/*
+ * Per-hart arenas
+ *
+ * To keep harts from serializing on alloc_lock, each hart gets its own
+ * LIFO arena (a HEAP_ARENA_SIZE allocation from the global heap) on its
+ * first allocation, and only that hart allocates / frees from it so no
+ * lock is needed. When the arena runs out we fall back to the global heap
+ * (moving the top allocation there in case of realloc). Only malloc() and
+ * friends go through the arenas, slab_alloc() / page_alloc() still take
+ * alloc_lock.
+ *
+ * When another hart frees something from an arena (e.g. a consumer freeing
+ * the producer's buffers), it pushes it to the arena's remote_frees list
+ * (threaded through the freed allocations), and the owner picks them up on
+ * its next allocation / free. Since an arena is a LIFO heap, the owner can
+ * only release the top allocation, so the rest wait on its pending_frees
+ * list (sorted from the top down) until whatever was above them is freed,
+ * instead of getting leaked. A realloc() from another hart fails.
+ */
+
+#define HEAP_ARENA_SIZE		(64 * 1024)
+/* Don't let arenas eat up small heaps */
+#define HEAP_ARENA_MIN_FREE	(8 * HEAP_ARENA_SIZE)
+/* Keep each arena on its own cache lines */
+#define HEAP_ARENA_ALIGN	64
+/* Marks a hart that couldn't get an arena */
+#define HEAP_ARENA_NONE		((struct heap*)(~(uintptr_t)0))
+
+/* All arenas, most recent first, only added to (with alloc_lock held) */
+static _Atomic(struct heap *) heap_arenas = NULL;
+
+static struct heap*
+heap_find_arena(const void *ptr)
+{
+	struct heap *arena = atomic_load_explicit(&heap_arenas, memory_order_acquire);
+	for (; arena != NULL; arena = arena->next_arena) {
+		if (heap_owns(arena, ptr))
+			return arena;
+	}
+	return NULL;
+}
+
+/* Called by other harts, hand ptr over to the arena's owner */
+static void
+heap_remote_free(struct heap *arena, void *ptr)
+{
+	void *head = atomic_load_explicit(&arena->remote_frees, memory_order_relaxed);
+	do {
+		*(void**)ptr = head;
+	} while (!atomic_compare_exchange_weak_explicit(&arena->remote_frees, &head, ptr,
+							memory_order_release,
+							memory_order_relaxed));
+}
+
+/* Called by the owner, move the remote frees to pending_frees and
+ * release the ones that are on top. */
+static void
+heap_drain_remote_frees(struct heap *arena)
+{
+	void *ptr = atomic_exchange_explicit(&arena->remote_frees, NULL, memory_order_acquire);
+
+	while (ptr != NULL) {
+		void *next = *(void**)ptr;
+		void **pos = &arena->pending_frees;
+		while (*pos && (uintptr_t) *pos > (uintptr_t) ptr)
+			pos = (void**) *pos;
+		*(void**)ptr = *pos;
+		*pos = ptr;
+		ptr = next;
+	}
+
+	while ((ptr = arena->pending_frees) != NULL && arena->alloc_count &&
+	       heap_is_top(arena, ptr, heap_last_alloc(arena))) {
+		arena->pending_frees = *(void**)ptr;
+		(void) heap_realloc(arena, ptr, 0);
+	}
+}
+
+static struct heap*
+heap_get_arena(void)
+{
+	struct heap **slot = (struct heap**) __heap_arena_location();
+	if (!slot)
+		return NULL;
+
+	struct heap *arena = *slot;
+	if (arena) {
+		if (arena == HEAP_ARENA_NONE)
+			return NULL;
+		if (arena->pending_frees ||
+		    atomic_load_explicit(&arena->remote_frees, memory_order_relaxed))
+			heap_drain_remote_frees(arena);
+		return arena;
+	}
+
+	size_t dirty = HEAP_ARENA_SIZE;
+	alloc_lock_acquire();
+	heap_init();
+	if (global_heap.end - global_heap.last_alloc_end >= HEAP_ARENA_MIN_FREE)
+		arena = heap_alloc(&global_heap, HEAP_ARENA_SIZE, &dirty);
+	alloc_lock_release();
+
+	if (!arena) {
+		*slot = HEAP_ARENA_NONE;
+		return NULL;
+	}
+
+	arena->start = ((uintptr_t)(arena + 1) + HEAP_ARENA_ALIGN - 1) & ~(HEAP_ARENA_ALIGN - 1);
+	arena->end = (uintptr_t) arena + HEAP_ARENA_SIZE;
+	arena->last_alloc_end = arena->start;
+	arena->total_alloc_size = 0;
+	arena->alloc_count = 0;
+	arena->clean_start = (uintptr_t) arena + dirty;
+	if (arena->clean_start < arena->start)
+		arena->clean_start = arena->start;
+	arena->clean_end = arena->end;
+	arena->pending_frees = NULL;
+	atomic_init(&arena->remote_frees, NULL);
+
+	/* Let other harts find it, for heap_remote_free() */
+	alloc_lock_acquire();
+	arena->next_arena = atomic_load_explicit(&heap_arenas, memory_order_relaxed);
+	atomic_store_explicit(&heap_arenas, arena, memory_order_release);
+	alloc_lock_release();
+
+	*slot = arena;
+	DBG("new heap arena at 0x%lx\n", arena->start);
+	return arena;
+}
+
+/* For new allocations (ptr == NULL), dirty (if not NULL) gets how much
+ * of the returned memory may be non-zero (see heap_alloc) */
+static void*
+heap_route_realloc(void *ptr, size_t size, size_t *dirty)
+{
+	/* Do we even have anough heap for the allocator ? */
+	if (__stack_start + __SIZEOF_POINTER__ >= __ram_end)
+		return NULL;
+
+	/* Slab objects are handled by the slab allocator */
+	if (ptr && slab_owns(ptr))
+		return slab_realloc(ptr, size);
+
+	/* Try this hart's arena first */
+	struct heap *arena = heap_get_arena();
+	if (arena && (!ptr || heap_owns(arena, ptr))) {
+		void *result = ptr ? heap_realloc(arena, ptr, size) : heap_alloc(arena, size, dirty);
+		if (result || !size)
+			return result;
+
+		/* Arena is full, if this was a resize of its top allocation
+		 * move it to the global heap. */
+		if (ptr) {
+			if (!heap_is_top(arena, ptr, heap_last_alloc(arena)))
+				return NULL;
+
+			const size_t old_size = arena->last_alloc_end - (__SIZEOF_POINTER__) -
+						(uintptr_t) ptr;
+			alloc_lock_acquire();
+			result = heap_realloc(&global_heap, NULL, size);
+			alloc_lock_release();
+			if (!result)
+				return NULL;
+
+			memcpy(result, ptr, old_size);
+			(void) heap_realloc(arena, ptr, 0);
+			return result;
+		}
+	}
+
+	/* From another hart's arena, we don't know its size to move it,
+	 * so only frees are possible */
+	struct heap *owner = ptr ? heap_find_arena(ptr) : NULL;
+	if (owner) {
+		if (!size)
+			heap_remote_free(owner, ptr);
+		return NULL;
+	}
+
+	alloc_lock_acquire();
+	heap_init();
+	void *result = ptr ? heap_realloc(&global_heap, ptr, size) : heap_alloc(&global_heap, size, dirty);
+	alloc_lock_release();
+	return result;
+}
+
+void*
+realloc(void *ptr, size_t size)
+{
+	void *result = heap_route_realloc(ptr, size, NULL);
+	alloc_stats_update(ptr, size, result);
+	return result;
 }
 
 void *reallocarray(void *_Nullable ptr, size_t n, size_t size)
@@ -200,15 +1084,18 @@ void *reallocarray(void *_Nullable ptr, size_t n, size_t size)
 	if (__builtin_mul_overflow(n, size, &total_size))
 		return NULL;
 
-	void* new_ptr = realloc(ptr, total_size);
+	size_t dirty = total_size;
+	void* new_ptr = heap_route_realloc(ptr, total_size, ptr ? NULL : &dirty);
+	alloc_stats_update(ptr, total_size, new_ptr);
 	if (new_ptr == NULL)
 		return NULL;
 
 	/* In case this is calloc() zero-out allocated memory, note
 	 * that the spec for realloc only prevents initialization of
-	 * existing allocations, not new ones, so we are still ok. */
+	 * existing allocations, not new ones, so we are still ok.
+	 * Skip the part that's still zero since boot. */
 	if (ptr == NULL)
-		memset(new_ptr, 0, total_size);
+		memset(new_ptr, 0, dirty);
 
 	return new_ptr;
 }
@@ -223,6 +1110,61 @@ void *calloc(size_t n, size_t size)
 	return reallocarray(NULL, n, size);
 }
 
+/* aligned_alloc() - Allocate memory with a given alignment
+ *
+ * Per C standard (C11 7.22.3.1, C23 7.24.3.1):
+ * - alignment should be a valid alignment supported by the implementation,
+ *   for us that's any power of two, otherwise it returns NULL
+ * - Memory can be freed/resized through free()/realloc(), note that realloc
+ *   may move it to a location that's only ALLOC_ALIGN aligned.
+ */
+void *aligned_alloc(size_t alignment, size_t size)
+{
+	if (!size || !alignment || (alignment & (alignment - 1)))
+		return NULL;
+
+	/* Do we even have anough heap for the allocator ? */
+	if (__stack_start + __SIZEOF_POINTER__ >= __ram_end)
+		return NULL;
+
+	void *result = NULL;
+	struct heap *arena = heap_get_arena();
+	if (arena)
+		result = heap_memalign(arena, alignment, size);
+
+	if (!result) {
+		alloc_lock_acquire();
+		heap_init();
+		result = heap_memalign(&global_heap, alignment, size);
+		alloc_lock_release();
+	}
+
+	alloc_stats_update(NULL, size, result);
+	return result;
+}
+
+/* posix_memalign() - POSIX flavor of aligned_alloc()
+ *
+ * Per POSIX.1-2001: alignment should be a power of two multiple of
+ * sizeof(void *), returns EINVAL if not, or ENOMEM if we are out of memory
+ * (without touching errno). For size 0 we return NULL in memptr.
+ */
+int posix_memalign(void **memptr, size_t alignment, size_t size)
+{
+	if (!alignment || (alignment & (alignment - 1)) || (alignment % sizeof(void *)))
+		return EINVAL;
+
+	*memptr = NULL;
+	if (!size)
+		return 0;
+
+	void *result = aligned_alloc(alignment, size);
+	if (!result)
+		return ENOMEM;
+	*memptr = result;
+	return 0;
+}
+
 void free(void *ptr)
 {
 	/* This will suppress the compiler warning about
@@ -232,6 +1174,468 @@ void free(void *ptr)
 }
 
 
+/*
+ * Scoped arenas
+ *
+ * For code that allocates many short-lived objects and throws them all away
+ * together (e.g. per-request), an arena is a private LIFO heap, allocated
+ * from the normal one, with the same metadata after each allocation. A mark
+ * records the arena's top, and resetting to it releases everything that was
+ * allocated after it at once, after verifying the metadata at both ends.
+ * Arenas are not thread-safe, each one should be used by a single hart.
+ */
+
+struct arena {
+	struct heap h;
+};
+
+struct arena*
+arena_create(size_t size)
+{
+	if (!size || size > SIZE_MAX - sizeof(struct arena))
+		return NULL;
+
+	struct arena *arena = malloc(sizeof(struct arena) + size);
+	if (!arena)
+		return NULL;
+
+	arena->h.start = (uintptr_t)(arena + 1);
+	arena->h.end = arena->h.start + ALIGN_DOWN(size, ALLOC_ALIGN);
+	arena->h.last_alloc_end = arena->h.start;
+	arena->h.total_alloc_size = 0;
+	arena->h.alloc_count = 0;
+	arena->h.clean_start = arena->h.clean_end = 0;
+	return arena;
+}
+
+void
+arena_destroy(struct arena *arena)
+{
+	free(arena);
+}
+
+void*
+arena_alloc(struct arena *arena, size_t size)
+{
+	if (!arena)
+		return NULL;
+	return heap_realloc(&arena->h, NULL, size);
+}
+
+arena_mark_t
+arena_mark(const struct arena *arena)
+{
+	arena_mark_t mark = { 0 };
+	if (arena) {
+		mark.top = arena->h.last_alloc_end;
+		mark.count = arena->h.alloc_count;
+	}
+	return mark;
+}
+
+void
+arena_reset_to(struct arena *arena, arena_mark_t mark)
+{
+	if (!arena)
+		return;
+
+	struct heap *h = &arena->h;
+	if (mark.top < h->start || mark.top > h->last_alloc_end || mark.count > h->alloc_count)
+		goto err;
+
+	/* Verify the current top (so that we catch overflows on the last
+	 * allocation), and the allocation right before the mark. */
+	if (h->alloc_count)
+		(void) heap_last_alloc(h);
+	if (mark.count) {
+		const uintptr_t metadata = *(uintptr_t*)(mark.top - (__SIZEOF_POINTER__));
+		if ((metadata & METADATA_AC_MASK) != (mark.count & METADATA_AC_MASK) ||
+		    (metadata & ~METADATA_AC_MASK) >= mark.top - h->start)
+			goto err;
+	} else if (mark.top != h->start)
+		goto err;
+
+	h->last_alloc_end = mark.top;
+	h->total_alloc_size = mark.top - h->start;
+	h->alloc_count = mark.count;
+	return;
+
+ err:
+	ERR("Invalid arena mark / corrupted arena at 0x%lx !\n", mark.top);
+	abort();
+}
+
+
+/*
+ * Allocator statistics
+ */
+
+int
+malloc_get_stats(struct malloc_stats *stats)
+{
+	if (!stats)
+		return -EINVAL;
+
+	alloc_lock_acquire();
+	heap_init();
+	stats->heap_size = __ram_end - global_heap.start;
+	stats->heap_used = global_heap.last_alloc_end - global_heap.start;
+	stats->heap_free = global_heap.end - global_heap.last_alloc_end;
+	stats->slab_size = pf_slab_pages * PF_SIZE;
+	stats->pages_used = (pf_used_pages - pf_slab_pages) * PF_SIZE;
+	stats->pages_free = (pf_top - pf_floor) - pf_used_pages * PF_SIZE;
+#if defined(MALLOC_STATS)
+	stats->heap_peak = alloc_stats.heap_peak;
+	stats->allocs = atomic_load_explicit(&alloc_stats.allocs, memory_order_relaxed);
+	stats->frees = atomic_load_explicit(&alloc_stats.frees, memory_order_relaxed);
+	stats->failures = atomic_load_explicit(&alloc_stats.failures, memory_order_relaxed);
+	stats->lock_contended = alloc_stats.lock_contended;
+	stats->lock_wait_cycles = alloc_stats.lock_wait_cycles;
+#endif
+	alloc_lock_release();
+
+#if defined(MALLOC_STATS)
+	return 0;
+#else
+	stats->heap_peak = stats->heap_used;
+	stats->allocs = stats->frees = stats->failures = 0;
+	stats->lock_contended = 0;
+	stats->lock_wait_cycles = 0;
+	return -ENOTSUP;
+#endif
+}
+
+void
+malloc_stats(void)
+{
+	struct malloc_stats stats;
+	int ret = malloc_get_stats(&stats);
+
+	printf("heap: %lu bytes, used: %lu (peak: %lu), free: %lu\n",
+	       stats.heap_size, stats.heap_used, stats.heap_peak, stats.heap_free);
+	printf("pages: %lu bytes used, %lu bytes free, slabs: %lu bytes\n",
+	       stats.pages_used, stats.pages_free, stats.slab_size);
+	if (ret < 0)
+		return;
+	printf("allocs: %lu, frees: %lu, failures: %lu\n",
+	       stats.allocs, stats.frees, stats.failures);
+	printf("lock contended: %lu times, %lu cycles spent waiting\n",
+	       stats.lock_contended, stats.lock_wait_cycles);
+}
+
+
+/*****************************\
+* Searching and sorting utils *
+\*****************************/
+
+/*
+ * qsort() is an introsort: quicksort with a median of three pivot (the
+ * median of three medians for large partitions), that switches to
+ * insertion sort for small partitions, and to heapsort for partitions
+ * that went through too many bad pivots, so it's O(n log n) on any input.
+ * Partitions go on a fixed stack, we always keep working on the smaller
+ * one so it never needs more than log2(n) entries, and we never allocate
+ * anything (the allocator above can only free its top allocation).
+ * Elements are swapped a word at a time when base and size allow it.
+ */
+
+#define SORT_INSERTION_MAX	16
+#define SORT_NINTHER_MIN	128
+#define SORT_STACK_DEPTH	(sizeof(size_t) * 8)
+
+/* Same as in string.c, to make our intent clear when it comes to aliasing */
+union sort_data {
+	unsigned char *as_bytes;
+	unsigned long *as_ulong;
+};
+
+enum sort_swap_type {
+	SORT_SWAP_BYTES,
+	SORT_SWAP_WORDS,
+	SORT_SWAP_WORD,	/* Exactly one word */
+};
+
+struct sort_ctx {
+	size_t size;
+	enum sort_swap_type swap_type;
+	int (*compar)(const void *, const void *, void *);
+	void *context;
+};
+
+static inline enum sort_swap_type
+sort_get_swap_type(const void *base, size_t size)
+{
+	if (((uintptr_t) base | size) & (sizeof(long) - 1))
+		return SORT_SWAP_BYTES;
+	return (size == sizeof(long)) ? SORT_SWAP_WORD : SORT_SWAP_WORDS;
+}
+
+static inline void
+sort_swap(const struct sort_ctx *ctx, void *a_ptr, void *b_ptr)
+{
+	union sort_data a = { .as_bytes = a_ptr };
+	union sort_data b = { .as_bytes = b_ptr };
+	size_t remaining = ctx->size;
+
+	switch (ctx->swap_type) {
+	case SORT_SWAP_WORD: {
+		const unsigned long tmp = *a.as_ulong;
+		*a.as_ulong = *b.as_ulong;
+		*b.as_ulong = tmp;
+		break;
+	}
+	case SORT_SWAP_WORDS:
+		for (; remaining; remaining -= sizeof(long)) {
+			const unsigned long tmp = *a.as_ulong;
+			*a.as_ulong++ = *b.as_ulong;
+			*b.as_ulong++ = tmp;
+		}
+		break;
+	default:
+		for (; remaining; remaining--) {
+			const unsigned char tmp = *a.as_bytes;
+			*a.as_bytes++ = *b.as_bytes;
+			*b.as_bytes++ = tmp;
+		}
+	}
+}
+
+static inline int
+sort_cmp(const struct sort_ctx *ctx, const void *a, const void *b)
+{
+	return ctx->compar(a, b, ctx->context);
+}
+
+static inline unsigned char *
+sort_elem(const struct sort_ctx *ctx, unsigned char *base, size_t idx)
+{
+	return base + idx * ctx->size;
+}
+
+static void
+sort_insertion(const struct sort_ctx *ctx, unsigned char *base, size_t nmemb)
+{
+	for (size_t i = 1; i < nmemb; i++)
+		for (size_t j = i; j > 0; j--) {
+			unsigned char *cur = sort_elem(ctx, base, j);
+			unsigned char *prev = cur - ctx->size;
+			if (sort_cmp(ctx, prev, cur) <= 0)
+				break;
+			sort_swap(ctx, prev, cur);
+		}
+}
+
+static void
+sort_sift_down(const struct sort_ctx *ctx, unsigned char *base, size_t root, size_t nmemb)
+{
+	while (1) {
+		size_t child = 2 * root + 1;
+		if (child >= nmemb)
+			return;
+		if (child + 1 < nmemb &&
+		    sort_cmp(ctx, sort_elem(ctx, base, child), sort_elem(ctx, base, child + 1)) < 0)
+			child++;
+		if (sort_cmp(ctx, sort_elem(ctx, base, root), sort_elem(ctx, base, child)) >= 0)
+			return;
+		sort_swap(ctx, sort_elem(ctx, base, root), sort_elem(ctx, base, child));
+		root = child;
+	}
+}
+
+static void
+sort_heap(const struct sort_ctx *ctx, unsigned char *base, size_t nmemb)
+{
+	for (size_t i = nmemb / 2; i > 0; i--)
+		sort_sift_down(ctx, base, i - 1, nmemb);
+	for (size_t end = nmemb - 1; end > 0; end--) {
+		sort_swap(ctx, base, sort_elem(ctx, base, end));
+		sort_sift_down(ctx, base, 0, end);
+	}
+}
+
+static inline unsigned char *
+sort_median3(const struct sort_ctx *ctx, unsigned char *a, unsigned char *b, unsigned char *c)
+{
+	if (sort_cmp(ctx, a, b) < 0) {
+		if (sort_cmp(ctx, b, c) < 0)
+			return b;
+		return (sort_cmp(ctx, a, c) < 0) ? c : a;
+	}
+	if (sort_cmp(ctx, a, c) < 0)
+		return a;
+	return (sort_cmp(ctx, b, c) < 0) ? c : b;
+}
+
+/* Partition around a pivot, moved to base, returns the
+ * pivot's final index (everything before it is <= to it,
+ * everything after it >=). */
+static size_t
+sort_partition(const struct sort_ctx *ctx, unsigned char *base, size_t nmemb)
+{
+	const size_t mid = nmemb / 2;
+	unsigned char *pivot = NULL;
+
+	if (nmemb >= SORT_NINTHER_MIN) {
+		const size_t step = nmemb / 8;
+		pivot = sort_median3(ctx,
+			sort_median3(ctx, base, sort_elem(ctx, base, step), sort_elem(ctx, base, 2 * step)),
+			sort_median3(ctx, sort_elem(ctx, base, mid - step), sort_elem(ctx, base, mid),
+				     sort_elem(ctx, base, mid + step)),
+			sort_median3(ctx, sort_elem(ctx, base, nmemb - 1 - 2 * step),
+				     sort_elem(ctx, base, nmemb - 1 - step), sort_elem(ctx, base, nmemb - 1)));
+	} else
+		pivot = sort_median3(ctx, base, sort_elem(ctx, base, mid), sort_elem(ctx, base, nmemb - 1));
+	if (pivot != base)
+		sort_swap(ctx, base, pivot);
+
+	/* Hoare partitioning, stopping on equal elements so
+	 * that runs of them get split in the middle */
+	size_t i = 0;
+	size_t j = nmemb;
+	while (1) {
+		do
+			i++;
+		while (i < nmemb && sort_cmp(ctx, sort_elem(ctx, base, i), base) < 0);
+		do
+			j--;
+		while (sort_cmp(ctx, sort_elem(ctx, base, j), base) > 0);
+		if (i >= j)
+			break;
+		sort_swap(ctx, sort_elem(ctx, base, i), sort_elem(ctx, base, j));
+	}
+	if (j)
+		sort_swap(ctx, base, sort_elem(ctx, base, j));
+	return j;
+}
+
+static void
+sort_intro(const struct sort_ctx *ctx, unsigned char *base, size_t nmemb)
+{
+	struct {
+		unsigned char *base;
+		size_t nmemb;
+		unsigned int depth;
+	} stack[SORT_STACK_DEPTH];
+	unsigned int top = 0;
+	/* 2 * log2(nmemb) bad pivots before switching to heapsort */
+	unsigned int depth = 2 * (sizeof(size_t) * 8 - __builtin_clzl(nmemb | 1));
+
+	while (1) {
+		if (nmemb <= SORT_INSERTION_MAX) {
+			sort_insertion(ctx, base, nmemb);
+		} else if (depth == 0) {
+			sort_heap(ctx, base, nmemb);
+		} else {
+			const size_t p = sort_partition(ctx, base, nmemb);
+			unsigned char *right = sort_elem(ctx, base, p + 1);
+			const size_t right_n = nmemb - p - 1;
+			depth--;
+
+			/* Push the larger one and continue with the smaller */
+			if (p < right_n) {
+				stack[top].base = right;
+				stack[top].nmemb = right_n;
+				stack[top++].depth = depth;
+				nmemb = p;
+			} else {
+				stack[top].base = base;
+				stack[top].nmemb = p;
+				stack[top++].depth = depth;
+				base = right;
+				nmemb = right_n;
+			}
+			continue;
+		}
+
+		if (top == 0)
+			return;
+		top--;
+		base = stack[top].base;
+		nmemb = stack[top].nmemb;
+		depth = stack[top].depth;
+	}
+}
+
+static int
+sort_cmp_no_context(const void *a, const void *b, void *context)
+{
+	int (*compar)(const void *, const void *) = *(int (**)(const void *, const void *)) context;
+	return compar(a, b);
+}
+
+/* C23 7.24.5.1 - The bsearch generic function
+ *
+ * base must be sorted in ascending order according to compar, if more than
+ * one element matches key any of them may be returned, returns NULL if there
+ * is no match.
+ */
+void *
+bsearch(const void *key, const void *base, size_t nmemb, size_t size,
+	int (*compar)(const void *, const void *))
+{
+	const unsigned char *lo = base;
+
+	/* Halve the range each time, nmemb is what's left of it */
+	while (nmemb > 0) {
+		const unsigned char *mid = lo + (nmemb / 2) * size;
+		const int ret = compar(key, mid);
+		if (ret == 0)
+			return (void *) mid;
+		if (ret > 0) {
+			lo = mid + size;
+			nmemb -= nmemb / 2 + 1;
+		} else
+			nmemb /= 2;
+	}
+	return NULL;
+}
+
+/* C23 7.24.5.2 - The qsort function
+ *
+ * Sorts nmemb elements of size bytes at base in ascending order according
+ * to compar, not stable.
+ */
+void
+qsort(void *base, size_t nmemb, size_t size, int (*compar)(const void *, const void *))
+{
+	if (nmemb < 2 || size == 0)
+		return;
+	const struct sort_ctx ctx = {
+		.size = size,
+		.swap_type = sort_get_swap_type(base, size),
+		.compar = sort_cmp_no_context,
+		.context = &compar,
+	};
+	sort_intro(&ctx, base, nmemb);
+}
+
+/* C23 §K.3.6.3.2 - The qsort_s function (Annex K)
+ *
+ * Same as qsort() with context passed on to compar, returns non-zero
+ * (EINVAL) without sorting anything if nmemb or size are larger than
+ * RSIZE_MAX, or if nmemb is non-zero and base or compar are NULL.
+ */
+errno_t
+qsort_s(void *base, rsize_t nmemb, rsize_t size,
+	int (*compar)(const void *x, const void *y, void *context), void *context)
+{
+	if (nmemb > RSIZE_MAX || size > RSIZE_MAX)
+		return EINVAL;
+	if (nmemb && (base == NULL || compar == NULL))
+		return EINVAL;
+	if (nmemb < 2 || size == 0)
+		return 0;
+	const struct sort_ctx ctx = {
+		.size = size,
+		.swap_type = sort_get_swap_type(base, size),
+		.compar = compar,
+		.context = context,
+	};
+	sort_intro(&ctx, base, nmemb);
+	return 0;
+}
+
+
 /*********************\
 * Program Termination *
 \*********************/
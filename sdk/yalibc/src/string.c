@@ -11,6 +11,10 @@
 #include <stddef.h>	/* For size_t / NULL */
 #include <stdbool.h>	/* For bool/true/false */
 #include <string.h>
+#include <platform/riscv/csr.h>	/* For csr_read() and mstatus fields */
+#include <platform/riscv/caps.h>	/* For struct rvcaps / CAP_ZICBOZ */
+#include <platform/utils/utils.h>	/* For __hot */
+#include <platform/interfaces/irq.h>	/* For irq_nested() */
 
 /* Abstract data types to avoid casting and make
  * our intent clear when it comes to aliasing. */
@@ -60,28 +64,225 @@ union const_data {
 
 
 /*************\
-* Memory Fill *
+* RVV helpers *
 \*************/
 
-/* C23 §7.26.6.1 - The memset function
- * Copies the value of c (converted to unsigned char) into each of the first
- * len characters of the object pointed to by dst_ptr. */
-void*
-memset(void* restrict dst_ptr, int c, size_t len)
+/* The vector kernels below are written in inline assembly with
+ * ".option arch, +v" (as in hart_init_vpu), so that we can use the
+ * VPU at runtime even when the compiler targets rv64gc. Below this
+ * size the csr read + vsetvli setup isn't worth it. */
+#define RVV_MIN_LEN	(4 * WORD_SIZE)
+
+/* If the compiler is also allowed to use the VPU let it know which
+ * registers we trash, otherwise it doesn't know about them anyway.
+ * The kernels below only use v0-v23: v0-v7 for copy/fill, v8-v15
+ * and v16-v23 for loaded data when we need v0/v1 for masks. */
+#if defined(__riscv_vector)
+#define RVV_CLOBBERS	, "v0", "v1", "v2", "v3", "v4", "v5", "v6", "v7",		\
+			  "v8", "v9", "v10", "v11", "v12", "v13", "v14", "v15",		\
+			  "v16", "v17", "v18", "v19", "v20", "v21", "v22", "v23",	\
+			  "vl", "vtype"
+#else
+#define RVV_CLOBBERS
+#endif
+
+/* Set by __string_set_caps() below when the boot hart has a VPU with
+ * a valid vlenb (and hart_init_vpu has moved mstatus.VS out of Off).
+ * Also the trap handlers don't save/restore vector state, so we only
+ * use the VPU with interrupts allowed (mstatus.MIE is cleared by hw
+ * on trap entry), to avoid trashing the registers of an interrupted
+ * vector loop. Anything running with interrupts blocked will just
+ * fall back to the scalar code, and so will nested handlers / deferred
+ * work, that run inside a trap with MIE set (see irq_nest_enter()). */
+static bool string_have_rvv = false;
+
+static inline bool
+rvv_usable(void)
 {
-	/* Nothing to do */
-	if (!dst_ptr || !len)
-		return dst_ptr;
+	return string_have_rvv &&
+	       (csr_read(CSR_MSTATUS) & CSR_MSTATUS_MIE) &&
+	       !irq_nested();
+}
+
+
+/*************\
+* Zbb helpers *
+\*************/
 
+/* Same approach as with RVV, use ".option arch, +zbb" so that the
+ * rv64gc build can still use orc.b / ctz / clz on harts that have
+ * Zbb. orc.b sets each byte to 0xFF if it's non-zero and to 0x00 if
+ * it's zero, so for a word with a null byte ~orc.b(x) only has the
+ * bits of the null bytes set, and ctz (or clz on big-endian) gives
+ * us the first one of them, instead of scanning byte by byte. */
+static inline unsigned long
+zbb_orc_b(unsigned long x)
+{
+	unsigned long ret;
+	__asm__ (".option push\n"
+		 ".option arch, +zbb\n"
+		 "orc.b	%0, %1\n"
+		 ".option pop\n"
+		 : "=r"(ret) : "r"(x));
+	return ret;
+}
+
+/* Index of the first (lowest addressed) byte of x that has any bits
+ * set, x must be non-zero. */
+static inline unsigned int
+zbb_first_byte(unsigned long x)
+{
+	/* If the compiler targets Zbb let it see what we are doing */
+#if defined(__riscv_zbb)
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+	return (unsigned int) __builtin_ctzl(x) / 8;
+#else
+	return (unsigned int) __builtin_clzl(x) / 8;
+#endif
+#else
+	unsigned long ret;
+	__asm__ (".option push\n"
+		 ".option arch, +zbb\n"
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+		 "ctz	%0, %1\n"
+#else
+		 "clz	%0, %1\n"
+#endif
+		 ".option pop\n"
+		 : "=r"(ret) : "r"(x));
+	return (unsigned int) (ret / 8);
+#endif
+}
+
+
+/**********\
+* Dispatch *
+\**********/
+
+/* Kernels we route through the dispatch table below, the scalar
+ * ones are always there, the rest are selected at boot from the
+ * hart's capabilities via __string_set_caps(). */
+static void fill_words(void* restrict dst_ptr, unsigned char byte, size_t len);
+static void fill_rvv(void* restrict dst_ptr, unsigned char byte, size_t len);
+static const char* strend_words(const char *str_ptr);
+static const char* strend_zbb(const char *str_ptr);
+static const char* strend_rvv(const char *str_ptr);
+static const char* strchrnul_words(const char *str_ptr, unsigned char byte);
+static const char* strchrnul_zbb(const char *str_ptr, unsigned char byte);
+static const char* strchrnul_rvv(const char *str_ptr, unsigned char byte);
+static void copy_fw(void* restrict dst_ptr, const void* restrict src_ptr, size_t len);
+static void copy_bw(void* restrict dst_ptr, const void* restrict src_ptr, size_t len);
+static void copy_fw_rvv(void* restrict dst_ptr, const void* restrict src_ptr, size_t len);
+static void copy_bw_rvv(void* restrict dst_ptr, const void* restrict src_ptr, size_t len);
+static int memcmp_scalar(const unsigned char *a, const unsigned char *b, size_t len);
+static int memcmp_zbb(const unsigned char *a, const unsigned char *b, size_t len);
+static int memcmp_rvv(const unsigned char *a, const unsigned char *b, size_t len);
+static int strncmp_bytes(const unsigned char *a, const unsigned char *b, size_t len);
+static int strncmp_zbb(const unsigned char *a, const unsigned char *b, size_t len);
+static int strncmp_rvv(const unsigned char *a, const unsigned char *b, size_t len);
+
+struct string_ops {
+	void (*fill)(void* restrict dst_ptr, unsigned char byte, size_t len);
+	const char* (*strend)(const char *str_ptr);
+	const char* (*strchrnul)(const char *str_ptr, unsigned char byte);
+	void (*copy_fw)(void* restrict dst_ptr, const void* restrict src_ptr, size_t len);
+	void (*copy_bw)(void* restrict dst_ptr, const void* restrict src_ptr, size_t len);
+	int (*memcmp)(const unsigned char *a, const unsigned char *b, size_t len);
+	int (*strncmp)(const unsigned char *a, const unsigned char *b, size_t len);
+};
+
+static const struct string_ops scalar_ops = {
+	.fill = fill_words,
+	.strend = strend_words,
+	.strchrnul = strchrnul_words,
+	.copy_fw = copy_fw,
+	.copy_bw = copy_bw,
+	.memcmp = memcmp_scalar,
+	.strncmp = strncmp_bytes,
+};
+
+/* Zbb doesn't help with copy/fill, only with finding bytes in words */
+static const struct string_ops zbb_ops = {
+	.fill = fill_words,
+	.strend = strend_zbb,
+	.strchrnul = strchrnul_zbb,
+	.copy_fw = copy_fw,
+	.copy_bw = copy_bw,
+	.memcmp = memcmp_zbb,
+	.strncmp = strncmp_zbb,
+};
+
+static const struct string_ops rvv_ops = {
+	.fill = fill_rvv,
+	.strend = strend_rvv,
+	.strchrnul = strchrnul_rvv,
+	.copy_fw = copy_fw_rvv,
+	.copy_bw = copy_bw_rvv,
+	.memcmp = memcmp_rvv,
+	.strncmp = strncmp_rvv,
+};
+
+/* The non-vector kernels to use, if the compiler already targets
+ * Zbb there is no point in waiting for the probe. */
+#if defined(__riscv_zbb)
+static const struct string_ops *string_ops = &zbb_ops;
+#else
+static const struct string_ops *string_ops = &scalar_ops;
+#endif
+
+/* Since the RVV kernels also depend on mstatus.MIE we can't just
+ * swap string_ops, pick them per call instead. For string functions
+ * we don't know len in advance, so callers pass SIZE_MAX. */
+static inline const struct string_ops*
+string_get_ops(size_t len)
+{
+	if (len >= RVV_MIN_LEN && rvv_usable())
+		return &rvv_ops;
+	return string_ops;
+}
+
+/* Block size used by cbo.zero, 0 if Zicboz is not available. It's
+ * not something we can know at compile time (it comes from the
+ * device tree), so it's also set through __string_set_caps(). */
+static size_t cboz_block_size = 0;
+
+/* Called once by the boot hart from hart_init (through
+ * hart_probe_isa_caps), and again each time someone calls
+ * hart_probe_priv_caps(). Note that we assume all harts have
+ * the same capabilities as the boot hart. */
+void
+__string_set_caps(const struct rvcaps *caps)
+{
+	if ((caps->z_caps & CAP_ZICBOZ) && caps->cboz_block_shift)
+		cboz_block_size = 1UL << caps->cboz_block_shift;
+	else
+		cboz_block_size = 0;
+
+#if !defined(__riscv_zbb)
+	string_ops = (caps->r_caps & CAP_B) ? &zbb_ops : &scalar_ops;
+#endif
+
+	string_have_rvv = (caps->r_caps & CAP_V) && caps->vlenb_shift &&
+			  (csr_read(CSR_MSTATUS) & FIELD_GET_MASK(CSR_MSTATUS_VS));
+}
+
+
+/*************\
+* Memory Fill *
+\*************/
+
+/* Fill len bytes of dst_ptr with byte, one word at a time */
+static void __hot
+fill_words(void* restrict dst_ptr, unsigned char byte, size_t len)
+{
 	union data dst = { .as_bytes = dst_ptr };
-	unsigned char byte = (unsigned char) c;
 
 	/* Broadcast byte to all positions in word */
-	unsigned long bytes = (unsigned long) c * ONES;
+	unsigned long bytes = (unsigned long) byte * ONES;
 	size_t remaining = len;
 
 	/* Fill up dst up to the alignment boundary */
-	for(; dst.as_uptr & WORD_MASK; remaining--)
+	for(; (dst.as_uptr & WORD_MASK) && remaining > 0; remaining--)
 		*dst.as_bytes++ = byte;
 
 	/* Fill up remaining words */
@@ -90,7 +291,77 @@ memset(void* restrict dst_ptr, int c, size_t len)
 
 	while(remaining-- > 0)
 		*dst.as_bytes++ = byte;
+}
+
+/* Vector fill, broadcast byte to v0-v7 once, with the first vl being
+ * the largest one we'll get, and then just store it.
+ * Note: len must be non-zero. */
+static void
+fill_rvv(void* restrict dst_ptr, unsigned char byte, size_t len)
+{
+	size_t vl;
+	__asm__ __volatile__(
+		".option push\n"
+		".option arch, +v\n"
+		"vsetvli	%[vl], %[len], e8, m8, ta, ma\n"
+		"vmv.v.x	v0, %[byte]\n"
+		"1:\n"
+		"vsetvli	%[vl], %[len], e8, m8, ta, ma\n"
+		"vse8.v	v0, (%[dst])\n"
+		"sub	%[len], %[len], %[vl]\n"
+		"add	%[dst], %[dst], %[vl]\n"
+		"bnez	%[len], 1b\n"
+		".option pop\n"
+		: [vl] "=&r"(vl), [dst] "+r"(dst_ptr), [len] "+r"(len)
+		: [byte] "r"((unsigned long)byte)
+		: "memory" RVV_CLOBBERS);
+}
+
+static inline void
+fill(void* restrict dst_ptr, unsigned char byte, size_t len)
+{
+	if (len)
+		string_get_ops(len)->fill(dst_ptr, byte, len);
+}
+
+/* C23 §7.26.6.1 - The memset function
+ * Copies the value of c (converted to unsigned char) into each of the first
+ * len characters of the object pointed to by dst_ptr. */
+void* __hot
+memset(void* restrict dst_ptr, int c, size_t len)
+{
+	/* Nothing to do */
+	if (!dst_ptr || !len)
+		return dst_ptr;
 
+	unsigned char byte = (unsigned char) c;
+	size_t block_size = cboz_block_size;
+
+	/* When zeroing at least a couple of cache blocks (e.g. calloc or
+	 * page tables), clear the cache-block-aligned interior with cbo.zero,
+	 * that zeroes a whole block in one go without fetching it from
+	 * memory first, and fill the unaligned head/tail as usual.
+	 * Note: cbo.zero needs a cacheable region, so don't use memset
+	 * on MMIO regions (which you shouldn't be doing anyway). */
+	if (!byte && block_size && len >= 2 * block_size) {
+		uintptr_t start = (uintptr_t)dst_ptr;
+		uintptr_t end = start + len;
+		uintptr_t block = (start + block_size - 1) & ~(block_size - 1);
+		uintptr_t blocks_end = end & ~(block_size - 1);
+
+		fill(dst_ptr, 0, block - start);
+		for (; block < blocks_end; block += block_size)
+			__asm__ __volatile__(
+				".option push\n"
+				".option arch, +zicboz\n"
+				"cbo.zero (%0)\n"
+				".option pop\n"
+				: : "r"(block) : "memory");
+		fill((void*)blocks_end, 0, end - blocks_end);
+		return dst_ptr;
+	}
+
+	fill(dst_ptr, byte, len);
 	return dst_ptr;
 }
 
@@ -111,6 +382,240 @@ memset_explicit(void *dst_ptr, int c, size_t n)
 * Memory / String Search *
 \************************/
 
+/*
+ * Vector search kernels, they compare a whole register group against the
+ * byte we are looking for (vmseq) and use vfirst.m to get the index of
+ * the first match in the resulting mask (or -1 if there is none).
+ *
+ * When we know the length (memchr/memrchr) we never read past the end
+ * of the buffer so we can use regular loads. When we don't (strlen/strchr)
+ * we use fault-only-first loads instead, the word versions are safe because
+ * an aligned word never crosses a page (or PMP / PMA region) boundary, so
+ * if its first byte is accessible so are the rest. With vle8ff.v only a
+ * fault on the first element traps, if any of the following elements
+ * would fault, the load stops there and vl gets trimmed accordingly, so
+ * we get the same guarantee without caring about alignment. Note that
+ * the hart may also trim vl for other reasons, so we always re-read it.
+ */
+
+static void*
+memchr_rvv(const void *src_ptr, unsigned char byte, size_t len)
+{
+	const unsigned char *src = src_ptr;
+	size_t vl;
+	long idx;
+	__asm__ __volatile__(
+		".option push\n"
+		".option arch, +v\n"
+		"1:\n"
+		"vsetvli	%[vl], %[len], e8, m8, ta, ma\n"
+		"vle8.v	v8, (%[src])\n"
+		"vmseq.vx	v0, v8, %[byte]\n"
+		"vfirst.m	%[idx], v0\n"
+		"bgez	%[idx], 2f\n"
+		"add	%[src], %[src], %[vl]\n"
+		"sub	%[len], %[len], %[vl]\n"
+		"bnez	%[len], 1b\n"
+		"2:\n"
+		".option pop\n"
+		: [vl] "=&r"(vl), [idx] "=&r"(idx),
+		  [src] "+r"(src), [len] "+r"(len)
+		: [byte] "r"((unsigned long)byte)
+		: "memory" RVV_CLOBBERS);
+
+	return (idx < 0) ? NULL : (void*)(src + idx);
+}
+
+/* Same but backwards, since there is no "vlast" we use the vector
+ * unit to find the chunk with the last match and then scan that
+ * backwards, like we do for the word version. */
+static void*
+memrchr_rvv(const void *src_ptr, unsigned char byte, size_t len)
+{
+	const unsigned char *src = (const unsigned char*)src_ptr + len;
+	size_t vl;
+	long idx;
+	__asm__ __volatile__(
+		".option push\n"
+		".option arch, +v\n"
+		"1:\n"
+		"vsetvli	%[vl], %[len], e8, m8, ta, ma\n"
+		"sub	%[src], %[src], %[vl]\n"
+		"vle8.v	v8, (%[src])\n"
+		"vmseq.vx	v0, v8, %[byte]\n"
+		"vfirst.m	%[idx], v0\n"
+		"bgez	%[idx], 2f\n"
+		"sub	%[len], %[len], %[vl]\n"
+		"bnez	%[len], 1b\n"
+		"2:\n"
+		".option pop\n"
+		: [vl] "=&r"(vl), [idx] "=&r"(idx),
+		  [src] "+r"(src), [len] "+r"(len)
+		: [byte] "r"((unsigned long)byte)
+		: "memory" RVV_CLOBBERS);
+
+	if (idx < 0)
+		return NULL;
+
+	/* There is at least one match at src + idx */
+	src += vl;
+	while (*--src != byte);
+	return (void*)src;
+}
+
+/* Returns a pointer to the first null byte of str_ptr */
+static const char*
+strend_rvv(const char *str_ptr)
+{
+	const char *str = str_ptr;
+	size_t vl;
+	long idx;
+	__asm__ __volatile__(
+		".option push\n"
+		".option arch, +v\n"
+		"1:\n"
+		"vsetvli	%[vl], zero, e8, m8, ta, ma\n"
+		"vle8ff.v	v8, (%[str])\n"
+		"csrr	%[vl], vl\n"
+		"vmseq.vi	v0, v8, 0\n"
+		"vfirst.m	%[idx], v0\n"
+		"add	%[str], %[str], %[vl]\n"
+		"bltz	%[idx], 1b\n"
+		"sub	%[str], %[str], %[vl]\n"
+		"add	%[str], %[str], %[idx]\n"
+		".option pop\n"
+		: [vl] "=&r"(vl), [idx] "=&r"(idx), [str] "+r"(str)
+		:
+		: "memory" RVV_CLOBBERS);
+	return str;
+}
+
+/* Scalar / Zbb versions of strend_rvv, both check a word at a time,
+ * HAS_ZERO only tells us that there is a null byte in the word so we
+ * still need to find it, with Zbb we get its index directly. */
+static const char*
+strend_words(const char *str_ptr)
+{
+	union const_data str = { .as_bytes = (const unsigned char *)str_ptr };
+
+	while (str.as_uptr & WORD_MASK) {
+		if (*str.as_bytes == '\0')
+			return (const char *)str.as_bytes;
+		str.as_bytes++;
+	}
+
+	while (!HAS_ZERO(*str.as_ulong))
+		str.as_ulong++;
+
+	while (*str.as_bytes != '\0')
+		str.as_bytes++;
+
+	return (const char *)str.as_bytes;
+}
+
+static const char*
+strend_zbb(const char *str_ptr)
+{
+	union const_data str = { .as_bytes = (const unsigned char *)str_ptr };
+	size_t offt = str.as_uptr & WORD_MASK;
+	unsigned long nulls;
+
+	/* Start from the aligned word that contains str_ptr (it's on the
+	 * same page so it's safe to read), and mark the bytes before
+	 * str_ptr as non-zero so that we skip them. */
+	str.as_bytes -= offt;
+	unsigned long val = *str.as_ulong | ~(~0UL SHIFT_HIGH (offt * 8));
+
+	while (!(nulls = ~zbb_orc_b(val)))
+		val = *++str.as_ulong;
+
+	return (const char *)str.as_bytes + zbb_first_byte(nulls);
+}
+
+/* Returns a pointer to the first occurence of byte or the null
+ * terminator, whichever comes first (scalar / Zbb versions). */
+static const char*
+strchrnul_words(const char *str_ptr, unsigned char byte)
+{
+	union const_data str = { .as_bytes = (const unsigned char *)str_ptr };
+	unsigned long mask = ONES * byte;
+
+	/* Search by byte up to the str's alignment boundary */
+	while (str.as_uptr & WORD_MASK) {
+		if (*str.as_bytes == '\0' || *str.as_bytes == byte)
+			return (const char *)str.as_bytes;
+		str.as_bytes++;
+	}
+
+	/* Search word by word, checking for both null terminator and target char.
+	 * HAS_ZERO(*str.as_ulong) detects null bytes.
+	 * HAS_ZERO(*str.as_ulong ^ mask) detects bytes matching our target. */
+	unsigned long word = *str.as_ulong;
+	while (!HAS_ZERO(word) && !HAS_ZERO(word ^ mask)) {
+		str.as_ulong++;
+		word = *str.as_ulong;
+	}
+
+	/* Found either null or target char in current word, scan byte-by-byte */
+	while (*str.as_bytes != '\0' && *str.as_bytes != byte)
+		str.as_bytes++;
+
+	return (const char *)str.as_bytes;
+}
+
+static const char*
+strchrnul_zbb(const char *str_ptr, unsigned char byte)
+{
+	union const_data str = { .as_bytes = (const unsigned char *)str_ptr };
+	size_t offt = str.as_uptr & WORD_MASK;
+	unsigned long mask = ONES * byte;
+	unsigned long hits;
+
+	/* As in strend_zbb, start from the aligned word and make sure the
+	 * bytes before str_ptr are neither null nor match byte. */
+	str.as_bytes -= offt;
+	unsigned long skip = ~(~0UL SHIFT_HIGH (offt * 8));
+	unsigned long val = *str.as_ulong;
+
+	/* Bytes that are null in either val or val ^ mask */
+	while (!(hits = ~(zbb_orc_b(val | skip) & zbb_orc_b((val ^ mask) | skip)))) {
+		val = *++str.as_ulong;
+		skip = 0;
+	}
+
+	return (const char *)str.as_bytes + zbb_first_byte(hits);
+}
+
+/* Returns a pointer to the first occurence of byte or the null
+ * terminator, whichever comes first. */
+static const char*
+strchrnul_rvv(const char *str_ptr, unsigned char byte)
+{
+	const char *str = str_ptr;
+	size_t vl;
+	long idx;
+	__asm__ __volatile__(
+		".option push\n"
+		".option arch, +v\n"
+		"1:\n"
+		"vsetvli	%[vl], zero, e8, m8, ta, ma\n"
+		"vle8ff.v	v8, (%[str])\n"
+		"csrr	%[vl], vl\n"
+		"vmseq.vx	v0, v8, %[byte]\n"
+		"vmseq.vi	v1, v8, 0\n"
+		"vmor.mm	v0, v0, v1\n"
+		"vfirst.m	%[idx], v0\n"
+		"add	%[str], %[str], %[vl]\n"
+		"bltz	%[idx], 1b\n"
+		"sub	%[str], %[str], %[vl]\n"
+		"add	%[str], %[str], %[idx]\n"
+		".option pop\n"
+		: [vl] "=&r"(vl), [idx] "=&r"(idx), [str] "+r"(str)
+		: [byte] "r"((unsigned long)byte)
+		: "memory" RVV_CLOBBERS);
+	return str;
+}
+
 /* C23 §7.26.5.1 - The memchr function
  * Locates the first occurrence of c (converted to unsigned char) in the
  * initial len characters of the object pointed to by src_ptr. */
@@ -123,6 +628,9 @@ memchr(const void *src_ptr, int c, size_t len)
 
 	union const_data src = { .as_bytes = src_ptr };
 	unsigned char byte = (unsigned char) c;
+
+	if (len >= RVV_MIN_LEN && rvv_usable())
+		return memchr_rvv(src_ptr, byte, len);
 	unsigned long mask = ONES * byte;
 	size_t remaining = len;
 
@@ -161,6 +669,9 @@ memrchr(const void *src_ptr, int c, size_t len)
 	union const_data src = { .as_bytes = (const unsigned char *)src_ptr + len };
 	unsigned long mask = ONES * byte;
 
+	if (len >= RVV_MIN_LEN && rvv_usable())
+		return memrchr_rvv(src_ptr, byte, len);
+
 	/* Search backwards byte-by-byte until we're word-aligned */
 	while ((src.as_uptr & WORD_MASK) && src.as_bytes > (const unsigned char *)src_ptr) {
 		src.as_bytes--;
@@ -205,35 +716,8 @@ strchr(const char* str_ptr, int c)
 	if (byte == '\0')
 		return (char *)(str_ptr + strlen(str_ptr));
 
-	union const_data str = { .as_bytes = (const unsigned char *)str_ptr };
-	unsigned long mask = ONES * byte;
-
-	/* Search by byte up to the str's alignment boundary */
-	while (str.as_uptr & WORD_MASK) {
-		if (*str.as_bytes == '\0')
-			return NULL;
-		if (*str.as_bytes == byte)
-			return (char *)str.as_bytes;
-		str.as_bytes++;
-	}
-
-	/* Search word by word, checking for both null terminator and target char.
-	 * HAS_ZERO(*str.as_ulong) detects null bytes.
-	 * HAS_ZERO(*str.as_ulong ^ mask) detects bytes matching our target. */
-	unsigned long word = *str.as_ulong;
-	while (!HAS_ZERO(word) && !HAS_ZERO(word ^ mask)) {
-		str.as_ulong++;
-		word = *str.as_ulong;
-	}
-
-	/* Found either null or target char in current word, scan byte-by-byte */
-	while (*str.as_bytes != '\0') {
-		if (*str.as_bytes == byte)
-			return (char *)str.as_bytes;
-		str.as_bytes++;
-	}
-
-	return NULL;
+	const char *res = string_get_ops(SIZE_MAX)->strchrnul(str_ptr, byte);
+	return (*res == (char)byte) ? (char *)res : NULL;
 }
 
 /* C23 §7.26.5.5 - The strrchr function
@@ -265,27 +749,13 @@ size_t strnlen(const char *str_ptr, size_t maxlen) __attribute__((alias("strnlen
 /* C23 §7.26.6.3 - The strlen function
  * Computes the length of the string pointed to by str_ptr.
  * Note: Unbounded strlen is inherently unsafe. Use strnlen where possible. */
-size_t
+size_t __hot
 strlen(const char *str_ptr)
 {
-	union const_data str = { .as_bytes = (const unsigned char *)str_ptr };
-
 	if (!str_ptr)
 		return 0;
 
-	while (str.as_uptr & WORD_MASK) {
-		if (*str.as_bytes == '\0')
-			return (size_t) (str.as_bytes - (const unsigned char *)str_ptr);
-		str.as_bytes++;
-	}
-
-	while (!HAS_ZERO(*str.as_ulong))
-		str.as_ulong++;
-
-	while (*str.as_bytes != '\0')
-		str.as_bytes++;
-
-	return (size_t) (str.as_bytes - (const unsigned char *)str_ptr);
+	return (size_t) (string_get_ops(SIZE_MAX)->strend(str_ptr) - str_ptr);
 }
 
 /* C23 §7.26.5.6 - The strspn function
@@ -405,7 +875,7 @@ strtok(char *restrict str, const char *restrict delim_set)
 \**********************/
 
 /* Forward copy data from src_ptr to dst_ptr */
-static void
+static void __hot
 copy_fw(void* restrict dst_ptr, const void* restrict src_ptr, size_t len)
 {
 	union const_data src = { .as_bytes = src_ptr };
@@ -465,7 +935,7 @@ copy_fw(void* restrict dst_ptr, const void* restrict src_ptr, size_t len)
 /* Same but backwards
  * Note: Restrict is still valid here because we're copying from high addresses
  * down, so we never read from memory we've already written. */
-static void
+static void __hot
 copy_bw(void* restrict dst_ptr, const void* restrict src_ptr, size_t len)
 {
 	union const_data src = { .as_bytes = src_ptr + len };
@@ -502,11 +972,65 @@ copy_bw(void* restrict dst_ptr, const void* restrict src_ptr, size_t len)
 		*--dst.as_bytes = *--src.as_bytes;
 }
 
+/* Vector forward copy, vsetvli gives us up to 8 * vlenb bytes
+ * per iteration (LMUL=8, so v0-v7) and since vle8/vse8 are
+ * element-aligned we don't care about src/dst alignment at all.
+ * Note: len must be non-zero. */
+static void
+copy_fw_rvv(void* restrict dst_ptr, const void* restrict src_ptr, size_t len)
+{
+	size_t vl;
+	__asm__ __volatile__(
+		".option push\n"
+		".option arch, +v\n"
+		"1:\n"
+		"vsetvli	%[vl], %[len], e8, m8, ta, ma\n"
+		"vle8.v	v0, (%[src])\n"
+		"sub	%[len], %[len], %[vl]\n"
+		"add	%[src], %[src], %[vl]\n"
+		"vse8.v	v0, (%[dst])\n"
+		"add	%[dst], %[dst], %[vl]\n"
+		"bnez	%[len], 1b\n"
+		".option pop\n"
+		: [vl] "=&r"(vl), [dst] "+r"(dst_ptr),
+		  [src] "+r"(src_ptr), [len] "+r"(len)
+		:
+		: "memory" RVV_CLOBBERS);
+}
+
+/* Same but backwards, each chunk is loaded in full before it's
+ * stored, and the next chunk comes from lower addresses than the
+ * one we just wrote, so this is safe for overlapping regions with
+ * dst > src. */
+static void
+copy_bw_rvv(void* restrict dst_ptr, const void* restrict src_ptr, size_t len)
+{
+	size_t vl;
+	dst_ptr = (unsigned char*)dst_ptr + len;
+	src_ptr = (const unsigned char*)src_ptr + len;
+	__asm__ __volatile__(
+		".option push\n"
+		".option arch, +v\n"
+		"1:\n"
+		"vsetvli	%[vl], %[len], e8, m8, ta, ma\n"
+		"sub	%[src], %[src], %[vl]\n"
+		"sub	%[dst], %[dst], %[vl]\n"
+		"vle8.v	v0, (%[src])\n"
+		"sub	%[len], %[len], %[vl]\n"
+		"vse8.v	v0, (%[dst])\n"
+		"bnez	%[len], 1b\n"
+		".option pop\n"
+		: [vl] "=&r"(vl), [dst] "+r"(dst_ptr),
+		  [src] "+r"(src_ptr), [len] "+r"(len)
+		:
+		: "memory" RVV_CLOBBERS);
+}
+
 /* C23 §7.26.2.2 - The memmove function
  * Copies len characters from the object pointed to by src into the object
  * pointed to by dst. Copying takes place as if via an intermediate buffer,
  * so the objects may overlap. */
-void*
+void* __hot
 memmove(void *dst, const void *src, size_t len)
 {
 	/* Nothing to do */
@@ -517,10 +1041,11 @@ memmove(void *dst, const void *src, size_t len)
 	 * order to prevent overwriting the source while copying,
 	 * copy backwards when we move a region to the left and
 	 * forward when we copy it to the right. */
+	const struct string_ops *ops = string_get_ops(len);
 	if (src > dst)
-		copy_fw(dst, src, len);
+		ops->copy_fw(dst, src, len);
 	else
-		copy_bw(dst, src, len);
+		ops->copy_bw(dst, src, len);
 
 	return dst;
 }
@@ -528,13 +1053,13 @@ memmove(void *dst, const void *src, size_t len)
 /* C23 §7.26.2.1 - The memcpy function
  * Copies len characters from the object pointed to by src into the object pointed
  * to by dst. The objects shall not overlap (use memmove if they might). */
-void*
+void* __hot
 memcpy(void* restrict dst, const void* restrict src, size_t len)
 {
 	if (!src || !dst || dst == src || !len)
 		return dst;
 
-	copy_fw(dst, src, len);
+	string_get_ops(len)->copy_fw(dst, src, len);
 	return dst;
 }
 
@@ -650,16 +1175,111 @@ compare_word_bytes(unsigned long a, unsigned long b)
 	return 0;
 }
 
-/* C23 §7.26.4.1 - The memcmp function
- * Compares the first len characters of the object pointed to by s1 to the first
- * len characters of the object pointed to by s2. */
-int
-memcmp(const void *s1, const void *s2, size_t len)
+/* Same with Zbb, the lowest addressed byte with bits set in a ^ b is
+ * the first differing one. */
+static inline int
+compare_word_bytes_zbb(unsigned long a, unsigned long b)
 {
-	/* Nothing to do */
-	if (!s1 || !s2 || s1 == s2 || !len)
+	unsigned long diff = a ^ b;
+	if (!diff)
 		return 0;
 
+	unsigned int i = zbb_first_byte(diff);
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+	unsigned int shift = i * 8;
+#else
+	unsigned int shift = (WORD_SIZE - 1 - i) * 8;
+#endif
+	return (int)((a >> shift) & 0xFF) - (int)((b >> shift) & 0xFF);
+}
+
+/*
+ * Vector compare kernels, load a register group from each side, mark
+ * the bytes that differ (vmsne) and for strings also the null bytes
+ * of s1 (if s2 has a null there too they're equal so s1 is enough),
+ * and let vfirst.m find the first one. They return the index of the
+ * first differing / null byte relative to the updated pointers, or -1
+ * if there is none within len. As with strlen, string loads are
+ * fault-only-first, and since the second load may trim vl further,
+ * we re-read it after each one.
+ */
+
+static int
+memcmp_rvv(const unsigned char *a, const unsigned char *b, size_t len)
+{
+	size_t vl;
+	long idx;
+	__asm__ __volatile__(
+		".option push\n"
+		".option arch, +v\n"
+		"1:\n"
+		"vsetvli	%[vl], %[len], e8, m8, ta, ma\n"
+		"vle8.v	v8, (%[a])\n"
+		"vle8.v	v16, (%[b])\n"
+		"vmsne.vv	v0, v8, v16\n"
+		"vfirst.m	%[idx], v0\n"
+		"bgez	%[idx], 2f\n"
+		"add	%[a], %[a], %[vl]\n"
+		"add	%[b], %[b], %[vl]\n"
+		"sub	%[len], %[len], %[vl]\n"
+		"bnez	%[len], 1b\n"
+		"2:\n"
+		".option pop\n"
+		: [vl] "=&r"(vl), [idx] "=&r"(idx),
+		  [a] "+r"(a), [b] "+r"(b), [len] "+r"(len)
+		:
+		: "memory" RVV_CLOBBERS);
+
+	if (idx < 0)
+		return 0;
+	return (int)a[idx] - (int)b[idx];
+}
+
+/* Used for both strcmp and strncmp, for strcmp we pass SIZE_MAX
+ * as len, which we'll never reach (we'd run out of address space
+ * before that). */
+static int
+strncmp_rvv(const unsigned char *a, const unsigned char *b, size_t len)
+{
+	size_t vl;
+	long idx;
+	__asm__ __volatile__(
+		".option push\n"
+		".option arch, +v\n"
+		"1:\n"
+		"vsetvli	%[vl], %[len], e8, m8, ta, ma\n"
+		"vle8ff.v	v8, (%[a])\n"
+		"csrr	%[vl], vl\n"
+		"vle8ff.v	v16, (%[b])\n"
+		"csrr	%[vl], vl\n"
+		"vmsne.vv	v0, v8, v16\n"
+		"vmseq.vi	v1, v8, 0\n"
+		"vmor.mm	v0, v0, v1\n"
+		"vfirst.m	%[idx], v0\n"
+		"bgez	%[idx], 2f\n"
+		"add	%[a], %[a], %[vl]\n"
+		"add	%[b], %[b], %[vl]\n"
+		"sub	%[len], %[len], %[vl]\n"
+		"bnez	%[len], 1b\n"
+		"2:\n"
+		".option pop\n"
+		: [vl] "=&r"(vl), [idx] "=&r"(idx),
+		  [a] "+r"(a), [b] "+r"(b), [len] "+r"(len)
+		:
+		: "memory" RVV_CLOBBERS);
+
+	if (idx < 0)
+		return 0;
+	return (int)a[idx] - (int)b[idx];
+}
+
+/* Word-at-a-time memcmp, with use_zbb being a constant this gets
+ * inlined in the two versions below, that only differ on how they
+ * find the first differing byte in a word. */
+static inline __attribute__((always_inline)) int
+memcmp_words(const unsigned char *s1, const unsigned char *s2, size_t len,
+	     bool use_zbb)
+{
 	union const_data a = { .as_bytes = s1 };
 	union const_data b = { .as_bytes = s2 };
 	unsigned long a_val;
@@ -712,17 +1332,100 @@ memcmp(const void *s1, const void *s2, size_t len)
 	return 0;
 
  compare_words:
+	if (use_zbb)
+		return compare_word_bytes_zbb(a_val, b_val);
 	return compare_word_bytes(a_val, b_val);
 }
 
+static int
+memcmp_scalar(const unsigned char *a, const unsigned char *b, size_t len)
+{
+	return memcmp_words(a, b, len, false);
+}
+
+static int
+memcmp_zbb(const unsigned char *a, const unsigned char *b, size_t len)
+{
+	return memcmp_words(a, b, len, true);
+}
+
+/* C23 §7.26.4.1 - The memcmp function
+ * Compares the first len characters of the object pointed to by s1 to the first
+ * len characters of the object pointed to by s2. */
+int __hot
+memcmp(const void *s1, const void *s2, size_t len)
+{
+	/* Nothing to do */
+	if (!s1 || !s2 || s1 == s2 || !len)
+		return 0;
+
+	return string_get_ops(len)->memcmp(s1, s2, len);
+}
+
 /*
  * strncmp: Compare strings up to len bytes or first null.
  *
- * Unlike memcmp, word-at-a-time optimization isn't worthwhile here:
- * we'd need to check each word for both differences AND null bytes,
- * adding complexity. Most strncmp calls involve short strings or
- * find differences early, so the setup overhead would dominate.
+ * Unlike memcmp, the classic word-at-a-time approach isn't worthwhile
+ * here: we'd need to check each word for both differences AND null
+ * bytes and then scan it again byte by byte, and most strncmp calls
+ * involve short strings or find differences early, so the setup
+ * overhead would dominate. With Zbb it's cheap to find the exact byte
+ * though, so we do it there when both strings share the same alignment.
+ * Both kernels are also used for strcmp, with len set to SIZE_MAX.
  */
+static int
+strncmp_bytes(const unsigned char *a, const unsigned char *b, size_t len)
+{
+	while (len--) {
+		unsigned char c1 = *a++;
+		unsigned char c2 = *b++;
+		if (c1 != c2)
+			return (int)c1 - (int)c2;
+		if (c1 == '\0')
+			return 0;
+	}
+
+	return 0;
+}
+
+static int
+strncmp_zbb(const unsigned char *a, const unsigned char *b, size_t len)
+{
+	union const_data sa = { .as_bytes = a };
+	union const_data sb = { .as_bytes = b };
+
+	/* If they don't get aligned at the same time we'd need to shift
+	 * words around and check both sides for nulls, don't bother. */
+	if ((sa.as_uptr ^ sb.as_uptr) & WORD_MASK)
+		return strncmp_bytes(a, b, len);
+
+	for (; (sa.as_uptr & WORD_MASK) && len > 0; len--) {
+		unsigned char c1 = *sa.as_bytes++;
+		unsigned char c2 = *sb.as_bytes++;
+		if (c1 != c2)
+			return (int)c1 - (int)c2;
+		if (c1 == '\0')
+			return 0;
+	}
+
+	/* Stop at the first byte that differs or is null on a (if
+	 * it's also null on b they're equal anyway). Reading the
+	 * rest of the word past the null is fine, it's aligned. */
+	for (; len >= WORD_SIZE; len -= WORD_SIZE) {
+		unsigned long a_val = *sa.as_ulong;
+		unsigned long b_val = *sb.as_ulong;
+		unsigned long stop = (a_val ^ b_val) | ~zbb_orc_b(a_val);
+		if (stop) {
+			unsigned int i = zbb_first_byte(stop);
+			return (int)sa.as_bytes[i] - (int)sb.as_bytes[i];
+		}
+		sa.as_ulong++;
+		sb.as_ulong++;
+	}
+
+	return strncmp_bytes(sa.as_bytes, sb.as_bytes, len);
+}
+
 /* C23 §7.26.4.3 - The strncmp function
  * Compares not more than len characters from the string pointed to by s1 to
  * the string pointed to by s2. */
@@ -733,16 +1436,8 @@ strncmp(const char *s1, const char *s2, size_t len)
 	if (!s1 || !s2 || s1 == s2 || !len)
 		return 0;
 
-	while (len--) {
-		unsigned char c1 = *s1++;
-		unsigned char c2 = *s2++;
-		if (c1 != c2)
-			return (int)c1 - (int)c2;
-		if (c1 == '\0')
-			return 0;
-	}
-
-	return 0;
+	return string_get_ops(len)->strncmp((const unsigned char *)s1,
+					    (const unsigned char *)s2, len);
 }
 
 /* C23 §7.26.4.2 - The strcmp function
@@ -755,14 +1450,8 @@ strcmp(const char *s1, const char *s2)
 	if (!s1 || !s2 || s1 == s2)
 		return 0;
 
-	for (;;) {
-		unsigned char c1 = *s1++;
-		unsigned char c2 = *s2++;
-		if (c1 != c2)
-			return (int)c1 - (int)c2;
-		if (c1 == '\0')
-			return 0;
-	}
+	return string_get_ops(SIZE_MAX)->strncmp((const unsigned char *)s1,
+						 (const unsigned char *)s2, SIZE_MAX);
 }
 
 /*
@@ -875,8 +1564,18 @@ small_needle_search(const char *haystack, const char *needle)
  * number of times, guaranteeing linear-time behavior even for highly repetitive
  * or noise-like inputs.
  */
-static char*
-twoway_strstr(const unsigned char *h, const unsigned char *n)
+/* Needle info for the two-way search, shared between strstr and memmem */
+struct twoway_needle {
+	size_t byteset[32 / sizeof(size_t)];	/* 256bits = 32 bytes */
+	size_t shift[256];
+	size_t len;
+	size_t max_suffix;
+	size_t period;
+	size_t mem_period;
+};
+
+static void
+twoway_prepare(struct twoway_needle *tw, const unsigned char *n, size_t needle_len)
 {
 	/* Shift table: stores rightmost position + 1 for each byte value.
 	 * When we see a character at position needle_len-1 in the haystack window,
@@ -885,19 +1584,12 @@ twoway_strstr(const unsigned char *h, const unsigned char *n)
 	 * that character in the haystack with its last occurrence in the needle.
 	 * This step comes from the Boyer-Moore-Horspool algorithm as an optimization
 	 * step (or in our PLL analogy as a pre-filter). */
-	size_t byteset[32 / sizeof(size_t)] = {0};	/* 256bits = 32 bytes */
-	size_t shift[256];
-
-	/* While there also calculate needle_len */
-	size_t needle_len = 0;
-	for (; n[needle_len] && h[needle_len]; needle_len++) {
-		BITMAP_SLOT(n[needle_len], byteset) |= BITMAP_BIT(n[needle_len]);
-		shift[n[needle_len]] = needle_len + 1;
+	memset(tw->byteset, 0, sizeof(tw->byteset));
+	for (size_t i = 0; i < needle_len; i++) {
+		BITMAP_SLOT(n[i], tw->byteset) |= BITMAP_BIT(n[i]);
+		tw->shift[n[i]] = i + 1;
 	}
-
-	/* If needle is longer than haystack (we hit end of haystack first), no match */
-	if (n[needle_len])
-		return NULL;
+	tw->len = needle_len;
 
 	/* Find the critical factorization position by computing the maximal suffix.
 	 * We do this twice with opposite comparisons to find the optimal split point. */
@@ -970,13 +1662,36 @@ twoway_strstr(const unsigned char *h, const unsigned char *n)
 		mem_period = needle_len - period;
 	}
 
-	/* Main search loop */
-	const unsigned char* haystack_end = h;
+	tw->max_suffix = max_suffix;
+	tw->period = period;
+	tw->mem_period = mem_period;
+}
+
+/* The main two-way search loop, starting at h. For memmem we know
+ * where the haystack ends (haystack_end), for strstr we pass NULL
+ * and find it incrementally as we go. */
+static const unsigned char*
+twoway_search(const struct twoway_needle *tw, const unsigned char *n,
+	      const unsigned char *h, const unsigned char *haystack_end)
+{
+	size_t needle_len = tw->len;
+	size_t max_suffix = tw->max_suffix;
+	size_t period = tw->period;
+	size_t mem_period = tw->mem_period;
+	bool is_string = (haystack_end == NULL);
+	size_t match_pos;
+
+	if (is_string)
+		haystack_end = h;
+
 	size_t mem = 0;
 	for (;;) {
 		/* Update our estimate of where the haystack ends.
 		 * We incrementally scan forward to find the null terminator. */
 		if ((size_t)(haystack_end - h) < needle_len) {
+			if (!is_string)
+				return NULL;
+
 			/* Round up to next 64-byte boundary (cache line size) */
 			size_t grow = needle_len | 63;
 			const unsigned char *null_pos = memchr(haystack_end, 0, grow);
@@ -992,10 +1707,10 @@ twoway_strstr(const unsigned char *h, const unsigned char *n)
 
 		/* Spectral filter: check if last byte of needle appears in current window.
 		 * If not in byteset, we can skip the entire needle length. */
-		if (BITMAP_SLOT(h[needle_len - 1], byteset) & BITMAP_BIT(h[needle_len - 1])) {
+		if (BITMAP_SLOT(h[needle_len - 1], tw->byteset) & BITMAP_BIT(h[needle_len - 1])) {
 			/* Last byte matches - check shift table to realign
 			 * acquisition window. */
-			match_pos = needle_len - shift[h[needle_len - 1]];
+			match_pos = needle_len - tw->shift[h[needle_len - 1]];
 
 			if (match_pos) {
 				/* We can skip forward, but respect
@@ -1019,10 +1734,10 @@ twoway_strstr(const unsigned char *h, const unsigned char *n)
 		/* Compare the right part, after critical point
 		 * (coarse phase discrimitator) */
 		for (match_pos = (max_suffix + 1 > mem) ? (max_suffix + 1) : mem;
-		     n[match_pos] && n[match_pos] == h[match_pos];
+		     match_pos < needle_len && n[match_pos] == h[match_pos];
 		     match_pos++);
 
-		if (n[match_pos]) {
+		if (match_pos < needle_len) {
 			/* Right half mismatch - shift past critical position */
 			h += match_pos - max_suffix;
 			mem = 0;
@@ -1038,7 +1753,7 @@ twoway_strstr(const unsigned char *h, const unsigned char *n)
 		if (match_pos <= mem) {
 			/* Full match !
 			 * (haystack/needle are phase-locked) */
-			return (char *)h;
+			return h;
 		}
 
 		/* Partial match - shift by period
@@ -1048,6 +1763,159 @@ twoway_strstr(const unsigned char *h, const unsigned char *n)
 	}
 }
 
+static char*
+twoway_strstr(const unsigned char *h, const unsigned char *n)
+{
+	struct twoway_needle tw;
+
+	/* While there also calculate needle_len */
+	size_t needle_len = 0;
+	for (; n[needle_len] && h[needle_len]; needle_len++);
+
+	/* If needle is longer than haystack (we hit end of haystack first), no match */
+	if (n[needle_len])
+		return NULL;
+
+	twoway_prepare(&tw, n, needle_len);
+	return (char *)twoway_search(&tw, n, h, NULL);
+}
+
+/*
+ * RVV prefilter for memmem / strstr, as in Wojciech Muła's "SIMD-friendly
+ * algorithms for substring searching": for a whole register group of
+ * candidate positions at once, check if the haystack has the needle's
+ * first byte at the position and its last byte at position + len - 1,
+ * and only verify the positions that pass both. That's VLEN * 8 bytes
+ * per iteration (m8) instead of one. Returns the first candidate within
+ * count positions from h, or NULL.
+ */
+static const unsigned char*
+prefilter_rvv(const unsigned char *h, size_t count, unsigned char first,
+	      unsigned char last, size_t last_offt)
+{
+	const unsigned char *h_last;
+	size_t vl;
+	long idx;
+	__asm__ __volatile__(
+		".option push\n"
+		".option arch, +v\n"
+		"1:\n"
+		"vsetvli	%[vl], %[count], e8, m8, ta, ma\n"
+		"add	%[h_last], %[h], %[last_offt]\n"
+		"vle8.v	v8, (%[h])\n"
+		"vle8.v	v16, (%[h_last])\n"
+		"vmseq.vx	v0, v8, %[first]\n"
+		"vmseq.vx	v1, v16, %[last]\n"
+		"vmand.mm	v0, v0, v1\n"
+		"vfirst.m	%[idx], v0\n"
+		"bgez	%[idx], 2f\n"
+		"add	%[h], %[h], %[vl]\n"
+		"sub	%[count], %[count], %[vl]\n"
+		"bnez	%[count], 1b\n"
+		"2:\n"
+		".option pop\n"
+		: [vl] "=&r"(vl), [idx] "=&r"(idx), [h_last] "=&r"(h_last),
+		  [h] "+r"(h), [count] "+r"(count)
+		: [first] "r"((unsigned long)first), [last] "r"((unsigned long)last),
+		  [last_offt] "r"(last_offt)
+		: "memory" RVV_CLOBBERS);
+
+	if (idx < 0)
+		return NULL;
+	return h + idx;
+}
+
+/* Search using the prefilter, verifying candidates with memcmp. On
+ * inputs with lots of false positives (e.g. repetitive ones) that'd
+ * go quadratic, so once verifying costs more than the bytes we've
+ * skipped, switch over to the two-way search from where we are. */
+static const unsigned char*
+memmem_rvv(const unsigned char *h, size_t hlen, const unsigned char *n,
+	   size_t nlen)
+{
+	const unsigned char *start = h;
+	const unsigned char *h_end = h + hlen;
+	size_t verified = 0;
+
+	while ((size_t)(h_end - h) >= nlen) {
+		const unsigned char *cand = prefilter_rvv(h, h_end - h - nlen + 1,
+							  n[0], n[nlen - 1], nlen - 1);
+		if (!cand)
+			return NULL;
+		if (!memcmp(cand + 1, n + 1, nlen - 2))
+			return cand;
+
+		h = cand + 1;
+		verified += nlen;
+		if (verified > (size_t)(h - start) + 16 * nlen) {
+			struct twoway_needle tw;
+			twoway_prepare(&tw, n, nlen);
+			return twoway_search(&tw, n, h, h_end);
+		}
+	}
+
+	return NULL;
+}
+
+/* GNU / POSIX.1-2024 - The memmem function
+ * Locates the first occurrence of the needle_len bytes pointed to by needle
+ * in the haystack_len bytes pointed to by haystack, both may contain nulls. */
+void*
+memmem(const void *haystack, size_t haystack_len, const void *needle, size_t needle_len)
+{
+	const unsigned char *h = haystack;
+	const unsigned char *n = needle;
+
+	/* Empty needle matches at the start (same as strstr) */
+	if (!needle_len)
+		return (void *)haystack;
+
+	if (!haystack || !needle || needle_len > haystack_len)
+		return NULL;
+
+	if (needle_len == 1)
+		return memchr(haystack, n[0], haystack_len);
+
+	if (haystack_len >= RVV_MIN_LEN && rvv_usable())
+		return (void *)memmem_rvv(h, haystack_len, n, needle_len);
+
+	struct twoway_needle tw;
+	twoway_prepare(&tw, n, needle_len);
+	return (void *)twoway_search(&tw, n, h, h + haystack_len);
+}
+
+/* How much more of the haystack strstr_rvv() looks at on each pass,
+ * doubling up to the max, so that an early match doesn't need to find
+ * the end of a long haystack first. */
+#define STRSTR_RVV_CHUNK	256
+#define STRSTR_RVV_CHUNK_MAX	4096
+
+/* Find the haystack's end a chunk at a time (at least a needle long,
+ * so that the overlap between passes doesn't dominate), and search
+ * each chunk through memmem (and the prefilter), starting from the
+ * first position the previous pass couldn't check. */
+static const unsigned char*
+strstr_rvv(const unsigned char *h, const unsigned char *n, size_t nlen)
+{
+	const unsigned char *h_end = h;
+	size_t chunk = (nlen > STRSTR_RVV_CHUNK) ? nlen : STRSTR_RVV_CHUNK;
+
+	while (1) {
+		const size_t len = strnlen((const char *)h_end, chunk);
+		h_end += len;
+		if ((size_t)(h_end - h) >= nlen) {
+			const unsigned char *match = memmem(h, h_end - h, n, nlen);
+			if (match)
+				return match;
+			h = h_end - nlen + 1;
+		}
+		if (len < chunk)
+			return NULL;
+		if (chunk < STRSTR_RVV_CHUNK_MAX)
+			chunk *= 2;
+	}
+}
+
 /* C23 §7.26.5.7 - The strstr function
  * Locates the first occurrence in the string pointed to by haystack of the
  * sequence of characters (excluding the terminating null character) in the
@@ -1067,6 +1935,13 @@ strstr(const char *haystack, const char *needle)
 	if (needle[1] == '\0')
 		return strchr((char *)haystack, needle[0]);
 
+	/* With the VPU use the prefilter through memmem, on chunks of the
+	 * haystack (this also covers needles that would otherwise go
+	 * through small_needle_search). */
+	if (rvv_usable())
+		return (char *)strstr_rvv((const unsigned char *)haystack,
+					  (const unsigned char *)needle, strlen(needle));
+
 	/* Try first for small needles that can fit in a word */
 	char* match_ptr = small_needle_search(haystack, needle);
 	if (match_ptr)
@@ -8,18 +8,350 @@
  */
 
 #include <platform/interfaces/timer.h>
+#include <platform/riscv/csr.h>	/* For pause() / wfi() */
 #include <threads.h>
+#include <stdbool.h>	/* For bool */
+#include <stdint.h>	/* For typed integers */
+#include <stddef.h>	/* For NULL */
+#include <stdlib.h>	/* For calloc() */
+#include <malloc.h>	/* For page_alloc/free() */
 
 #define NSECS_IN_SEC 1000000000
 
+/*
+ * Each thread gets a run of pages from the page-frame allocator (so that
+ * it may be joined and freed from any hart), with its control block at
+ * the bottom and its stack growing down from the top. Override with
+ * -DTHRD_STACK_PAGES=<n> in CFLAGS.
+ */
+#ifndef THRD_STACK_PAGES
+#define THRD_STACK_PAGES	4
+#endif
+
+/* Callee-saved registers, the rest are saved by the
+ * caller of thrd_switch() as usual */
+struct thrd_ctx {
+	uint64_t ra;
+	uint64_t sp;
+	uint64_t s[12];
+#if defined(__riscv_flen)
+	uint64_t fs[12];
+#endif
+};
+
+enum thrd_state {
+	THRD_RUNNING = 0,	/* Running, runnable or blocked */
+	THRD_DETACHED,		/* Same, but nobody will join it */
+	THRD_DONE,		/* Exited, waiting to be joined */
+};
+
+struct __thrd {
+	struct thrd_ctx ctx;
+	struct __thrd *next;	/* Run queue */
+	thrd_start_t func;
+	void *arg;
+	uint64_t wake_nsecs;	/* Sleeping until then, 0 if not sleeping */
+	atomic_int state;
+	int res;
+};
+
+/*
+ * Per-hart scheduler, the run queue only holds the threads that
+ * are not running, so with a single thread it's empty and yielding
+ * is a no-op. Sleeping threads stay on the queue with their wakeup
+ * time set and get skipped until then, if everyone on the queue is
+ * sleeping the hart sleeps until the first one is due.
+ */
+struct thrd_sched {
+	struct __thrd *current;
+	struct __thrd *head;
+	struct __thrd *tail;
+	struct __thrd *exited;	/* Switched away from for good */
+	unsigned int num_sleeping;
+	struct __thrd initial;
+};
+
+/* Per-hart slot for the scheduler, from the platform layer */
+extern void **__thrd_sched_location(void);
+
+/* In the asm below */
+extern void thrd_switch(struct thrd_ctx *from, struct thrd_ctx *to);
+extern void thrd_entry(void);
+
+#if defined(__riscv_flen) && (__riscv_flen == 64)
+#define THRD_FS_SAVE(_n, _off)	"	fsd	fs" #_n ", " #_off "(a0)\n"
+#define THRD_FS_LOAD(_n, _off)	"	fld	fs" #_n ", " #_off "(a1)\n"
+#elif defined(__riscv_flen)
+#define THRD_FS_SAVE(_n, _off)	"	fsw	fs" #_n ", " #_off "(a0)\n"
+#define THRD_FS_LOAD(_n, _off)	"	flw	fs" #_n ", " #_off "(a1)\n"
+#else
+#define THRD_FS_SAVE(_n, _off)
+#define THRD_FS_LOAD(_n, _off)
+#endif
+
+/*
+ * thrd_switch(from, to): save the callee-saved registers to from, load
+ * them from to, and return to wherever to left off. A new thread starts
+ * at thrd_entry, with its control block in s0.
+ */
+__asm__(
+	".pushsection .text.thrd_switch, \"ax\", @progbits\n"
+	".align 2\n"
+	".globl thrd_switch\n"
+	".type thrd_switch, @function\n"
+	"thrd_switch:\n"
+	"	sd	ra, 0(a0)\n"
+	"	sd	sp, 8(a0)\n"
+	"	sd	s0, 16(a0)\n"
+	"	sd	s1, 24(a0)\n"
+	"	sd	s2, 32(a0)\n"
+	"	sd	s3, 40(a0)\n"
+	"	sd	s4, 48(a0)\n"
+	"	sd	s5, 56(a0)\n"
+	"	sd	s6, 64(a0)\n"
+	"	sd	s7, 72(a0)\n"
+	"	sd	s8, 80(a0)\n"
+	"	sd	s9, 88(a0)\n"
+	"	sd	s10, 96(a0)\n"
+	"	sd	s11, 104(a0)\n"
+	THRD_FS_SAVE(0, 112) THRD_FS_SAVE(1, 120) THRD_FS_SAVE(2, 128)
+	THRD_FS_SAVE(3, 136) THRD_FS_SAVE(4, 144) THRD_FS_SAVE(5, 152)
+	THRD_FS_SAVE(6, 160) THRD_FS_SAVE(7, 168) THRD_FS_SAVE(8, 176)
+	THRD_FS_SAVE(9, 184) THRD_FS_SAVE(10, 192) THRD_FS_SAVE(11, 200)
+	"	ld	ra, 0(a1)\n"
+	"	ld	sp, 8(a1)\n"
+	"	ld	s0, 16(a1)\n"
+	"	ld	s1, 24(a1)\n"
+	"	ld	s2, 32(a1)\n"
+	"	ld	s3, 40(a1)\n"
+	"	ld	s4, 48(a1)\n"
+	"	ld	s5, 56(a1)\n"
+	"	ld	s6, 64(a1)\n"
+	"	ld	s7, 72(a1)\n"
+	"	ld	s8, 80(a1)\n"
+	"	ld	s9, 88(a1)\n"
+	"	ld	s10, 96(a1)\n"
+	"	ld	s11, 104(a1)\n"
+	THRD_FS_LOAD(0, 112) THRD_FS_LOAD(1, 120) THRD_FS_LOAD(2, 128)
+	THRD_FS_LOAD(3, 136) THRD_FS_LOAD(4, 144) THRD_FS_LOAD(5, 152)
+	THRD_FS_LOAD(6, 160) THRD_FS_LOAD(7, 168) THRD_FS_LOAD(8, 176)
+	THRD_FS_LOAD(9, 184) THRD_FS_LOAD(10, 192) THRD_FS_LOAD(11, 200)
+	"	ret\n"
+	".size thrd_switch, . - thrd_switch\n"
+
+	".globl thrd_entry\n"
+	".type thrd_entry, @function\n"
+	"thrd_entry:\n"
+	"	mv	a0, s0\n"
+	"	call	thrd_run\n"
+	".size thrd_entry, . - thrd_entry\n"
+	".popsection\n"
+);
+
+/*********\
+* Helpers *
+\*********/
+
+static inline uint64_t
+thrd_now(void)
+{
+	return timer_get_nsecs(PLAT_TIMER_RTC);	/* Equivalent to TIME_UTC */
+}
+
+static int
+thrd_ts_to_nsecs(const struct timespec *ts, uint64_t *nsecs)
+{
+	/* Both fields are unsigned, only the upper bound can be off */
+	if (!ts || ts->tv_nsec > 999999999)
+		return thrd_error;
+	*nsecs = ((uint64_t) ts->tv_sec * NSECS_IN_SEC) + ts->tv_nsec;
+	return thrd_success;
+}
+
+/* Get this hart's scheduler, allocating it on first use if asked to */
+static struct thrd_sched *
+thrd_get_sched(bool alloc)
+{
+	void **slot = __thrd_sched_location();
+	struct thrd_sched *sc = *slot;
+	if (sc || !alloc)
+		return sc;
+
+	sc = calloc(1, sizeof(struct thrd_sched));
+	if (!sc)
+		return NULL;
+	sc->current = &sc->initial;
+	*slot = sc;
+	return sc;
+}
+
+static void
+thrd_enqueue(struct thrd_sched *sc, struct __thrd *thr)
+{
+	thr->next = NULL;
+	if (sc->tail)
+		sc->tail->next = thr;
+	else
+		sc->head = thr;
+	sc->tail = thr;
+}
+
+/* Take the first thread on the queue that's not sleeping,
+ * if they are all sleeping, sleep until the first one is due */
+static struct __thrd *
+thrd_dequeue(struct thrd_sched *sc)
+{
+	while (1) {
+		const uint64_t now = sc->num_sleeping ? thrd_now() : 0;
+		uint64_t first_wake = UINT64_MAX;
+		struct __thrd *prev = NULL;
+
+		for (struct __thrd *thr = sc->head; thr; prev = thr, thr = thr->next) {
+			if (thr->wake_nsecs && thr->wake_nsecs > now) {
+				if (thr->wake_nsecs < first_wake)
+					first_wake = thr->wake_nsecs;
+				continue;
+			}
+			if (prev)
+				prev->next = thr->next;
+			else
+				sc->head = thr->next;
+			if (sc->tail == thr)
+				sc->tail = prev;
+			if (thr->wake_nsecs) {
+				thr->wake_nsecs = 0;
+				sc->num_sleeping--;
+			}
+			return thr;
+		}
+		timer_nanosleep(PLAT_TIMER_RTC, first_wake - now);
+	}
+}
+
+/* Called on the new thread's stack after every switch, we are
+ * now done with the previous thread's stack if it exited */
+static void
+thrd_finish_switch(struct thrd_sched *sc)
+{
+	struct __thrd *thr = sc->exited;
+	if (!thr)
+		return;
+	sc->exited = NULL;
+
+	int expected = THRD_RUNNING;
+	if (!atomic_compare_exchange_strong_explicit(&thr->state, &expected, THRD_DONE,
+						     memory_order_release, memory_order_acquire))
+		page_free(thr, THRD_STACK_PAGES);	/* Detached */
+}
+
+/* Switch to the next runnable thread, putting the current
+ * one back on the queue unless it has exited */
+static void
+thrd_schedule(struct thrd_sched *sc, bool requeue)
+{
+	struct __thrd *self = sc->current;
+	if (requeue) {
+		/* Nothing else to run */
+		if (!sc->head && !self->wake_nsecs)
+			return;
+		thrd_enqueue(sc, self);
+	}
+
+	struct __thrd *next = thrd_dequeue(sc);
+	if (next == self)
+		return;
+	sc->current = next;
+	thrd_switch(&self->ctx, &next->ctx);
+	thrd_finish_switch(sc);
+}
+
+/* Let other threads run while waiting for something, or
+ * if there are none just back off for a bit */
+static void
+thrd_relax(void)
+{
+	struct thrd_sched *sc = thrd_get_sched(false);
+	if (sc && sc->head)
+		thrd_schedule(sc, true);
+	else
+		pause();
+}
+
+/* First thing a new thread runs, through thrd_entry */
+void __attribute__((noreturn, used))
+thrd_run(struct __thrd *thr)
+{
+	thrd_finish_switch(thrd_get_sched(false));
+	thrd_exit(thr->func(thr->arg));
+}
+
+/**********************\
+* C STANDARD FUNCTIONS *
+\**********************/
+
+/* C11 thrd_create()
+ * Creates a new thread executing func(arg), it'll run on this
+ * hart, the next time the current thread yields / blocks. */
+int
+thrd_create(thrd_t *thr, thrd_start_t func, void *_Nullable arg)
+{
+	if (!thr || !func)
+		return thrd_error;
+
+	struct thrd_sched *sc = thrd_get_sched(true);
+	if (!sc)
+		return thrd_nomem;
+
+	struct __thrd *new_thr = page_alloc(THRD_STACK_PAGES, 0);
+	if (!new_thr)
+		return thrd_nomem;
+
+	*new_thr = (struct __thrd) { 0 };
+	new_thr->func = func;
+	new_thr->arg = arg;
+	new_thr->ctx.ra = (uintptr_t) thrd_entry;
+	new_thr->ctx.sp = ((uintptr_t) new_thr + THRD_STACK_PAGES * PAGE_FRAME_SIZE) & ~15UL;
+	new_thr->ctx.s[0] = (uintptr_t) new_thr;
+	atomic_init(&new_thr->state, THRD_RUNNING);
+
+	thrd_enqueue(sc, new_thr);
+	*thr = new_thr;
+	return thrd_success;
+}
+
+/* C11 thrd_equal() */
+int
+thrd_equal(thrd_t thr0, thrd_t thr1)
+{
+	return thr0 == thr1;
+}
+
+/* C11 thrd_current() */
+thrd_t
+thrd_current(void)
+{
+	struct thrd_sched *sc = thrd_get_sched(true);
+	return sc ? sc->current : NULL;
+}
+
+/* C11 thrd_sleep()
+ * With other threads on this hart, the calling thread is parked
+ * until it's due and they get to run in the meantime, otherwise
+ * the whole hart sleeps. */
 int
 thrd_sleep(const struct timespec *req, struct timespec *_Nullable rem)
 {
-	if (!req || req->tv_sec < 0 || req->tv_nsec < 0 || req->tv_nsec > 999999999)
+	uint64_t nsecs = 0;
+	if (thrd_ts_to_nsecs(req, &nsecs) != thrd_success)
 		return thrd_error;
 
-	uint64_t nsecs = ((uint64_t) req->tv_sec * NSECS_IN_SEC) + req->tv_nsec;
-	timer_nanosleep(PLAT_TIMER_RTC, nsecs);	/* Equivalent to TIME_UTC */
+	struct thrd_sched *sc = thrd_get_sched(false);
+	if (sc && sc->head && nsecs) {
+		sc->current->wake_nsecs = thrd_now() + nsecs;
+		sc->num_sleeping++;
+		thrd_schedule(sc, true);
+	} else
+		timer_nanosleep(PLAT_TIMER_RTC, nsecs);
 
 	/* Not interruptible, so remaining time is always 0 */
 	if (rem) {
@@ -28,4 +360,236 @@ thrd_sleep(const struct timespec *req, struct timespec *_Nullable rem)
 	}
 
 	return thrd_success;
-}
\ No newline at end of file
+}
+
+/* C11 thrd_yield() */
+void
+thrd_yield(void)
+{
+	struct thrd_sched *sc = thrd_get_sched(false);
+	if (sc)
+		thrd_schedule(sc, true);
+}
+
+/* C11 thrd_exit()
+ * For the initial thread there is nothing to return to, so we
+ * let the other threads on this hart finish and then hang, as
+ * if main() returned. */
+_Noreturn void
+thrd_exit(int res)
+{
+	struct thrd_sched *sc = thrd_get_sched(false);
+	if (!sc || sc->current == &sc->initial) {
+		while (sc && sc->head)
+			thrd_schedule(sc, true);
+		while (1)
+			wfi();
+	}
+
+	struct __thrd *self = sc->current;
+	self->res = res;
+	sc->exited = self;
+	/* There's always at least the initial thread to switch to */
+	thrd_schedule(sc, false);
+	__builtin_unreachable();
+}
+
+/* C11 thrd_detach() */
+int
+thrd_detach(thrd_t thr)
+{
+	if (!thr)
+		return thrd_error;
+
+	int expected = THRD_RUNNING;
+	if (atomic_compare_exchange_strong_explicit(&thr->state, &expected, THRD_DETACHED,
+						    memory_order_relaxed, memory_order_acquire))
+		return thrd_success;
+	if (expected != THRD_DONE)
+		return thrd_error;
+	page_free(thr, THRD_STACK_PAGES);
+	return thrd_success;
+}
+
+/* C11 thrd_join()
+ * May be called from any hart. */
+int
+thrd_join(thrd_t thr, int *_Nullable res)
+{
+	if (!thr || thr == thrd_current())
+		return thrd_error;
+
+	int state;
+	while ((state = atomic_load_explicit(&thr->state, memory_order_acquire)) == THRD_RUNNING)
+		thrd_relax();
+	if (state != THRD_DONE)
+		return thrd_error;
+
+	if (res)
+		*res = thr->res;
+	page_free(thr, THRD_STACK_PAGES);
+	return thrd_success;
+}
+
+/* C11 mtx_init() */
+int
+mtx_init(mtx_t *mtx, int type)
+{
+	if (!mtx)
+		return thrd_error;
+	atomic_init(&mtx->owner, NULL);
+	mtx->count = 0;
+	mtx->type = type;
+	return thrd_success;
+}
+
+/* C11 mtx_trylock() */
+int
+mtx_trylock(mtx_t *mtx)
+{
+	struct __thrd *self = thrd_current();
+	struct __thrd *expected = NULL;
+	if (!mtx || !self)
+		return thrd_error;
+
+	if ((mtx->type & mtx_recursive) &&
+	    atomic_load_explicit(&mtx->owner, memory_order_relaxed) == self) {
+		mtx->count++;
+		return thrd_success;
+	}
+	if (!atomic_compare_exchange_strong_explicit(&mtx->owner, &expected, self,
+						     memory_order_acquire, memory_order_relaxed))
+		return thrd_busy;
+	mtx->count = 1;
+	return thrd_success;
+}
+
+/* C11 mtx_timedlock()
+ * ts is an absolute TIME_UTC time point. */
+int
+mtx_timedlock(mtx_t *restrict mtx, const struct timespec *restrict ts)
+{
+	uint64_t deadline = 0;
+	if (thrd_ts_to_nsecs(ts, &deadline) != thrd_success)
+		return thrd_error;
+
+	int ret;
+	while ((ret = mtx_trylock(mtx)) == thrd_busy) {
+		if (thrd_now() >= deadline)
+			return thrd_timedout;
+		thrd_relax();
+	}
+	return ret;
+}
+
+/* C11 mtx_lock() */
+int
+mtx_lock(mtx_t *mtx)
+{
+	int ret;
+	while ((ret = mtx_trylock(mtx)) == thrd_busy)
+		thrd_relax();
+	return ret;
+}
+
+/* C11 mtx_unlock() */
+int
+mtx_unlock(mtx_t *mtx)
+{
+	if (!mtx || atomic_load_explicit(&mtx->owner, memory_order_relaxed) != thrd_current())
+		return thrd_error;
+	if (--mtx->count)
+		return thrd_success;
+	atomic_store_explicit(&mtx->owner, NULL, memory_order_release);
+	return thrd_success;
+}
+
+/* C11 mtx_destroy() */
+void
+mtx_destroy(mtx_t *mtx)
+{
+	(void) mtx;
+}
+
+/*
+ * Condition variables are just a sequence number, waiters wait for it
+ * to change, so cnd_signal() may wake up more than one waiter (which
+ * the standard allows, as spurious wakeups).
+ */
+
+/* C11 cnd_init() */
+int
+cnd_init(cnd_t *cond)
+{
+	if (!cond)
+		return thrd_error;
+	atomic_init(&cond->seq, 0);
+	return thrd_success;
+}
+
+/* C11 cnd_signal() */
+int
+cnd_signal(cnd_t *cond)
+{
+	if (!cond)
+		return thrd_error;
+	atomic_fetch_add_explicit(&cond->seq, 1, memory_order_release);
+	return thrd_success;
+}
+
+/* C11 cnd_broadcast() */
+int
+cnd_broadcast(cnd_t *cond)
+{
+	return cnd_signal(cond);
+}
+
+static int
+cnd_wait_until(cnd_t *cond, mtx_t *mtx, uint64_t deadline)
+{
+	if (!cond || !mtx)
+		return thrd_error;
+
+	const unsigned int seq = atomic_load_explicit(&cond->seq, memory_order_relaxed);
+	if (mtx_unlock(mtx) != thrd_success)
+		return thrd_error;
+
+	int ret = thrd_success;
+	while (atomic_load_explicit(&cond->seq, memory_order_acquire) == seq) {
+		if (deadline && thrd_now() >= deadline) {
+			ret = thrd_timedout;
+			break;
+		}
+		thrd_relax();
+	}
+
+	if (mtx_lock(mtx) != thrd_success)
+		return thrd_error;
+	return ret;
+}
+
+/* C11 cnd_wait() */
+int
+cnd_wait(cnd_t *cond, mtx_t *mtx)
+{
+	return cnd_wait_until(cond, mtx, 0);
+}
+
+/* C11 cnd_timedwait()
+ * ts is an absolute TIME_UTC time point. */
+int
+cnd_timedwait(cnd_t *restrict cond, mtx_t *restrict mtx,
+	      const struct timespec *restrict ts)
+{
+	uint64_t deadline = 0;
+	if (thrd_ts_to_nsecs(ts, &deadline) != thrd_success)
+		return thrd_error;
+	return cnd_wait_until(cond, mtx, deadline ? deadline : 1);
+}
+
+/* C11 cnd_destroy() */
+void
+cnd_destroy(cnd_t *cond)
+{
+	(void) cond;
+}